@@ -21,13 +21,17 @@
 
 #include "csgeom/tri.h"
 #include "csgeom/vector3.h"
+#include "csgfx/shadervarcontext.h"
+#include "csplugincommon/rendermanager/svarrayholder.h"
 #include "cstool/csview.h"
 #include "cstool/initapp.h"
 #include "cstool/genmeshbuilder.h"
 #include "cstool/simplestaticlighter.h"
 #include "csutil/cmdhelp.h"
 #include "csutil/cscolor.h"
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/event.h"
+#include "csutil/randomgen.h"
 #include "csutil/sysfunc.h"
 #include "csutil/xmltiny.h"
 #include "iengine/camera.h"
@@ -41,8 +45,11 @@
 #include "iengine/sector.h"
 #include "igraphic/image.h"
 #include "igraphic/imageio.h"
+#include "igeom/trimesh.h"
 #include "imesh/genmesh.h"
+#include "imesh/terrain2.h"
 #include "imesh/object.h"
+#include "imesh/objmodel.h"
 #include "iutil/cmdline.h"
 #include "iutil/comp.h"
 #include "iutil/databuff.h"
@@ -54,6 +61,7 @@
 #include "iutil/plugin.h"
 #include "iutil/vfs.h"
 #include "iutil/virtclk.h"
+#include "ivaria/collider.h"
 #include "ivaria/conout.h"
 #include "ivaria/reporter.h"
 #include "ivaria/view.h"
@@ -517,6 +525,263 @@ void CsBench::PerformShaderTest (const char* shaderPath, const char* shtype,
   }
 }
 
+void CsBench::PerformCollisionTest ()
+{
+  Report ("================================================================");
+  Report ("Benchmark collision (segments against the big object)...");
+
+  csRef<iCollideSystem> cdsys = csLoadPluginCheck<iCollideSystem> (
+    object_reg, "crystalspace.collisiondetection.opcode");
+  if (!cdsys) return;
+  iTriangleMesh* trimesh = meshObject->GetObjectModel ()->GetTriangleData (
+    cdsys->GetBaseDataID ());
+  if (!trimesh)
+  {
+    ReportError ("Big object has no triangle data!");
+    return;
+  }
+  csRef<iCollider> collider = cdsys->CreateCollider (trimesh);
+
+  // Vertical segments through the lattice, partly missing it.
+  csReversibleTransform trans;
+  trans.SetOrigin (csVector3 (0, 0, 10));
+  csRandomGen rng;
+  csDirtyAccessArray<csVector3> starts, ends;
+  for (int i = 0 ; i < COLLISION_SEGMENTS ; i++)
+  {
+    float x = rng.Get () * 6.0f - 0.5f;
+    float y = rng.Get () * 6.0f - 0.5f;
+    starts.Push (csVector3 (x, y, 5));
+    ends.Push (csVector3 (x + rng.Get () - 0.5f, y + rng.Get () - 0.5f, 15));
+  }
+
+  csMicroTicks single_time = csGetMicroTicks ();
+  int single_hits = 0;
+  for (int i = 0 ; i < COLLISION_SEGMENTS ; i++)
+    if (cdsys->CollideSegment (collider, &trans, starts[i], ends[i]))
+      single_hits++;
+  single_time = csGetMicroTicks () - single_time;
+
+  csDirtyAccessArray<float> hits;
+  hits.SetSize (COLLISION_SEGMENTS);
+  csMicroTicks batch_time = csGetMicroTicks ();
+  size_t batch_hits = cdsys->CollideSegments (collider, &trans,
+    starts.GetArray (), ends.GetArray (), hits.GetArray (),
+    COLLISION_SEGMENTS);
+  batch_time = csGetMicroTicks () - batch_time;
+
+  float single_rate = float (COLLISION_SEGMENTS) * 1000000.0f
+    / float (csMax (single_time, csMicroTicks (1)));
+  float batch_rate = float (COLLISION_SEGMENTS) * 1000000.0f
+    / float (csMax (batch_time, csMicroTicks (1)));
+  Report ("PERF:collision_single:%d:%g: (%d hits, %g segments/s)",
+    COLLISION_SEGMENTS, single_rate, single_hits, single_rate);
+  Report ("PERF:collision_batch:%d:%g: (%zu hits, %g segments/s)",
+    COLLISION_SEGMENTS, batch_rate, batch_hits, batch_rate);
+}
+
+void CsBench::PerformTerrainCollisionTest ()
+{
+  Report ("================================================================");
+  Report ("Benchmark collision (rays against a terrain)...");
+
+  csRef<iCollideSystem> cdsys = csLoadPluginCheck<iCollideSystem> (
+    object_reg, "crystalspace.collisiondetection.opcode");
+  if (!cdsys) return;
+  csRef<iMeshObjectType> type = csLoadPluginCheck<iMeshObjectType> (
+    object_reg, "crystalspace.mesh.object.terrain2");
+  csRef<iTerrainRenderer> renderer = csLoadPluginCheck<iTerrainRenderer> (
+    object_reg, "crystalspace.mesh.object.terrain2.bruteblockrenderer");
+  csRef<iTerrainCollider> terrainCollider =
+    csLoadPluginCheck<iTerrainCollider> (
+    object_reg, "crystalspace.mesh.object.terrain2.collider");
+  csRef<iTerrainDataFeeder> feeder = csLoadPluginCheck<iTerrainDataFeeder> (
+    object_reg, "crystalspace.mesh.object.terrain2.simpledatafeeder");
+  if (!type || !renderer || !terrainCollider || !feeder) return;
+
+  csRef<iMeshObjectFactory> factory = type->NewFactory ();
+  csRef<iTerrainFactory> terrainFactory =
+    scfQueryInterface<iTerrainFactory> (factory);
+  terrainFactory->SetRenderer (renderer);
+  terrainFactory->SetCollider (terrainCollider);
+  terrainFactory->SetFeeder (feeder);
+  // 256x256 units around the origin, heights between 0 and 15
+  iTerrainFactoryCell* cell = terrainFactory->AddCell ("0", 257, 257, 16, 16,
+    false, csVector2 (-128, -128), csVector3 (256, 15, 256));
+  cell->GetFeederProperties ()->SetParameter ("heightmap source",
+    "/lev/terrain/heightmap.png");
+  csRef<iMeshObject> terrainObject = factory->NewInstance ();
+  csRef<iTerrainSystem> terrain = scfQueryInterface<iTerrainSystem> (
+    terrainObject);
+  // Load the heights up front
+  for (size_t c = 0 ; c < terrain->GetCellCount () ; c++)
+    terrain->GetCell (c, true);
+  csRef<iCollider> collider = scfQueryInterface<iCollider> (terrainObject);
+
+  /* Downward segments ending above the highest point: they only hit as
+     rays, with a hit fraction beyond the end. */
+  csRandomGen rng;
+  csDirtyAccessArray<csVector3> starts, ends;
+  for (int i = 0 ; i < TERRAIN_RAYS ; i++)
+  {
+    float x = rng.Get () * 200.0f - 100.0f;
+    float z = rng.Get () * 200.0f - 100.0f;
+    starts.Push (csVector3 (x, 30, z));
+    ends.Push (csVector3 (x + rng.Get () - 0.5f, 20, z + rng.Get () - 0.5f));
+  }
+
+  csDirtyAccessArray<float> hits;
+  hits.SetSize (TERRAIN_RAYS);
+  size_t segment_hits = cdsys->CollideSegments (collider, 0,
+    starts.GetArray (), ends.GetArray (), hits.GetArray (), TERRAIN_RAYS);
+  if (segment_hits != 0)
+    ReportError ("%zu terrain segments hit beyond their end!", segment_hits);
+
+  csMicroTicks ray_time = csGetMicroTicks ();
+  size_t ray_hits = cdsys->CollideSegments (collider, 0,
+    starts.GetArray (), ends.GetArray (), hits.GetArray (), TERRAIN_RAYS,
+    true);
+  ray_time = csGetMicroTicks () - ray_time;
+  size_t short_hits = 0;
+  for (int i = 0 ; i < TERRAIN_RAYS ; i++)
+    if ((hits[i] >= 0) && (hits[i] <= 1.0f)) short_hits++;
+  if (ray_hits != TERRAIN_RAYS)
+    ReportError ("Only %zu of %d terrain rays hit!", ray_hits, TERRAIN_RAYS);
+  if (short_hits != 0)
+    ReportError ("%zu terrain rays hit before their end!", short_hits);
+
+  float ray_rate = float (TERRAIN_RAYS) * 1000000.0f
+    / float (csMax (ray_time, csMicroTicks (1)));
+  Report ("PERF:collision_terrain_rays:%d:%g: (%zu hits, %g rays/s)",
+    TERRAIN_RAYS, ray_rate, ray_hits, ray_rate);
+}
+
+namespace
+{
+  struct SVSetupScene
+  {
+    csRef<csShaderVariableContext> base;
+    csRefArray<csShaderVariableContext> materials;
+    csRefArray<csShaderVariable> o2w;
+    CS::ShaderVarStringID o2wName;
+    CS::ShaderVarStringID readNames[4];
+  };
+
+  /* Set up the SVs of all meshes like the render manager does for a context,
+     return the number of variables read back. */
+  size_t SetupMeshSVs (const SVSetupScene& scene,
+    CS::Graphics::ShaderVarSlotMap* slotMap, size_t numNames)
+  {
+    CS::RenderManager::SVArrayHolder svArrays;
+    if (slotMap)
+      svArrays.Setup (1, slotMap, SVSETUP_MESHES + 1);
+    else
+      svArrays.Setup (1, numNames, SVSETUP_MESHES + 1);
+
+    csShaderVariableStack stack;
+    svArrays.SetupSVStack (stack, 0, 0);
+    scene.base->PushVariables (stack);
+    svArrays.ReplicateSet (0, 0, 1);
+
+    size_t found = 0;
+    for (size_t m = 0; m < SVSETUP_MESHES; m++)
+    {
+      svArrays.SetupSVStack (stack, 0, m + 1);
+      stack.Set (scene.o2wName, scene.o2w[m]);
+      scene.materials[m % SVSETUP_MATERIALS]->PushVariables (stack);
+
+      const csShaderVariableStack& readStack = stack;
+      for (size_t r = 0; r < 4; r++)
+        if (readStack[scene.readNames[r]]) found++;
+    }
+    return found;
+  }
+}
+
+void CsBench::PerformSVSetupTest ()
+{
+  Report ("================================================================");
+  Report ("Benchmark shader variable setup (%d meshes, %d SV names)...",
+    SVSETUP_MESHES, SVSETUP_NAMES);
+
+  // Lots of names, like a level with many shaders, few of them used here.
+  csDirtyAccessArray<CS::ShaderVarStringID> names;
+  for (int i = 0 ; i < SVSETUP_NAMES ; i++)
+  {
+    csString name;
+    name.Format ("svsetup bench var %d", i);
+    names.Push (stringsSvName->Request (name));
+  }
+  const size_t numNames = stringsSvName->GetSize ();
+
+  SVSetupScene scene;
+  csRandomGen rng (0);
+  scene.base.AttachNew (new csShaderVariableContext);
+  for (int i = 0 ; i < 20 ; i++)
+    scene.base->AddVariable (new csShaderVariable (
+      names[rng.Get (SVSETUP_NAMES)]));
+  for (int i = 0 ; i < SVSETUP_MATERIALS ; i++)
+  {
+    csRef<csShaderVariableContext> mat;
+    mat.AttachNew (new csShaderVariableContext);
+    for (int v = 0 ; v < 6 ; v++)
+      mat->AddVariable (new csShaderVariable (
+        names[rng.Get (SVSETUP_NAMES)]));
+    scene.materials.Push (mat);
+  }
+  scene.o2wName = stringsSvName->Request ("object2world transform");
+  for (int i = 0 ; i < SVSETUP_MESHES ; i++)
+  {
+    csRef<csShaderVariable> sv;
+    sv.AttachNew (new csShaderVariable (scene.o2wName));
+    scene.o2w.Push (sv);
+  }
+  scene.readNames[0] = scene.o2wName;
+  for (int r = 1 ; r < 4 ; r++)
+    scene.readNames[r] = names[rng.Get (SVSETUP_NAMES)];
+
+  csMicroTicks names_time = csGetMicroTicks ();
+  size_t names_found = 0, names_first = 0;
+  for (int f = 0 ; f < SVSETUP_FRAMES ; f++)
+  {
+    size_t found = SetupMeshSVs (scene, 0, numNames);
+    if (f == 0) names_first = found;
+    names_found += found;
+  }
+  names_time = csGetMicroTicks () - names_time;
+
+  /* Start with a fresh map, like the persistent render manager map: slots
+     are given out while the first frame is set up, which must not lose any
+     variables either. */
+  CS::Graphics::ShaderVarSlotMap slotMap;
+  slotMap.Reserve (numNames);
+  csMicroTicks slots_time = csGetMicroTicks ();
+  size_t slots_found = 0, slots_first = 0;
+  for (int f = 0 ; f < SVSETUP_FRAMES ; f++)
+  {
+    size_t found = SetupMeshSVs (scene, &slotMap, numNames);
+    if (f == 0) slots_first = found;
+    slots_found += found;
+  }
+  slots_time = csGetMicroTicks () - slots_time;
+
+  if (names_first != slots_first)
+    ReportError ("SV setup with slots found %zu variables instead of %zu "
+      "in the first frame!", slots_first, names_first);
+  if (names_found != slots_found)
+    ReportError ("SV setup with slots found %zu variables instead of %zu!",
+      slots_found, names_found);
+
+  float names_rate = float (SVSETUP_FRAMES) * 1000000.0f
+    / float (csMax (names_time, csMicroTicks (1)));
+  float slots_rate = float (SVSETUP_FRAMES) * 1000000.0f
+    / float (csMax (slots_time, csMicroTicks (1)));
+  Report ("PERF:svsetup_names:%d:%g: (%zu SV names, %g frames/s)",
+    SVSETUP_MESHES, names_rate, numNames, names_rate);
+  Report ("PERF:svsetup_slots:%d:%g: (%zu SV slots, %g frames/s)",
+    SVSETUP_MESHES, slots_rate, slotMap.GetSlotCount (), slots_rate);
+}
+
 void CsBench::PerformTests ()
 {
   Report ("================================================================");
@@ -567,6 +832,10 @@ void CsBench::PerformTests ()
   PerformShaderTest ("/shader/light_bumpmap.xml", "diffuse", 
     "/shader/ambient.xml", "ambient", meshObject);
   vfs->PopDir ();
+
+  PerformCollisionTest ();
+  PerformTerrainCollisionTest ();
+  PerformSVSetupTest ();
 }
 
 /*---------------------------------------------------------------------*
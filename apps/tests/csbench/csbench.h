@@ -41,6 +41,12 @@ struct iStringSet;
 #define SMALLOBJECT_DIM 17
 #define SMALLOBJECT_NUM 100
 #define BENCHTIME 3000
+#define COLLISION_SEGMENTS 100000
+#define TERRAIN_RAYS 10000
+#define SVSETUP_NAMES 4000
+#define SVSETUP_MATERIALS 50
+#define SVSETUP_MESHES 2000
+#define SVSETUP_FRAMES 100
 
 class CsBench
 {
@@ -81,6 +87,9 @@ private:
   void PerformShaderTest (const char* shaderPath, const char* shtype, 
     const char* shaderPath2, const char* shtype2, 
     iMeshObject* mesh);
+  void PerformCollisionTest ();
+  void PerformTerrainCollisionTest ();
+  void PerformSVSetupTest ();
 
 public:
   CsBench ();
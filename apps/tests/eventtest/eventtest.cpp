@@ -243,8 +243,85 @@ void EventTest::OnExit()
 {
 }
 
+namespace
+{
+  /// Posts events to the queue as fast as it can
+  class EventPoster : public CS::Threading::Runnable
+  {
+    csRef<iEventQueue> queue;
+    csEventID name;
+    int count;
+  public:
+    EventPoster (iEventQueue* queue, csEventID name, int count)
+      : queue (queue), name (name), count (count) {}
+
+    void Run ()
+    {
+      for (int i = 0; i < count; i++)
+      {
+        csRef<iEvent> ev = queue->CreateEvent (name);
+        queue->Post (ev);
+      }
+    }
+
+    const char* GetName () const { return "event poster"; }
+  };
+}
+
+void EventTest::RunPostBenchmark ()
+{
+  csRef<iEventQueue> q = csQueryRegistry<iEventQueue> (GetObjectRegistry ());
+  csRef<iEventNameRegistry> namereg = csEventNameRegistry::GetRegistry (
+    GetObjectRegistry ());
+  csEventID name = namereg->GetID ("application.eventtest.benchmark");
+  const int postsPerThread = 200000;
+
+  int maxThreads = csMax (int (CS::Platform::GetProcessorCount ()), 2);
+  for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+  {
+    CS::Threading::ThreadGroup threads;
+    for (int t = 0; t < numThreads; t++)
+    {
+      csRef<EventPoster> poster;
+      poster.AttachNew (new EventPoster (q, name, postsPerThread));
+      csRef<CS::Threading::Thread> thread;
+      thread.AttachNew (new CS::Threading::Thread (poster));
+      threads.Add (thread);
+    }
+
+    int total = numThreads * postsPerThread;
+    csMicroTicks start = csGetMicroTicks ();
+    threads.StartAll ();
+    // Take the events out concurrently, like the main loop would
+    int received = 0;
+    while (received < total)
+    {
+      csRef<iEvent> ev = q->Get ();
+      if (ev.IsValid ())
+        received++;
+      else
+        csSleep (0);
+    }
+    threads.WaitAll ();
+    csMicroTicks time = csGetMicroTicks () - start;
+
+    csPrintf ("%d posting thread(s): %d events in %.3f s, %.0f posts/s\n",
+      numThreads, total, time / 1000000.0, total * 1000000.0 / time);
+    fflush (stdout);
+  }
+}
+
 bool EventTest::Application()
 {
+  // eventtest -postbenchmark: measure event posting and exit
+  csRef<iCommandLineParser> cmdline =
+    csQueryRegistry<iCommandLineParser> (GetObjectRegistry ());
+  if (cmdline->GetBoolOption ("postbenchmark"))
+  {
+    RunPostBenchmark ();
+    return true;
+  }
+
   // Open the main system. This will open all the previously loaded plug-ins.
   // i.e. all windows will be opened.
   if (!OpenApplication(GetObjectRegistry()))
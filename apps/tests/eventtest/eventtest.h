@@ -69,6 +69,12 @@ public:
   
   void Frame ();
   bool SetupModules ();
+
+  /**
+   * Measure how many events per second can be posted to the event queue
+   * by a number of threads at once while the main thread takes them out.
+   */
+  void RunPostBenchmark ();
   
   // Declare the name of this event handler.
   CS_EVENTHANDLER_NAMES("application.eventtest")
@@ -21,6 +21,7 @@
 
 #include "cssysdef.h"
 #include <errno.h>
+#include <math.h>
 #include <string.h>
 
 #include "csgfx/bakekeycolor.h"
@@ -35,6 +36,7 @@
 #include "csutil/cmdhelp.h"
 #include "csutil/getopt.h"
 #include "csutil/platformfile.h"
+#include "csutil/sysfunc.h"
 #include "csutil/util.h"
 #include "igraphic/imageio.h"
 #include "iutil/comp.h"
@@ -78,6 +80,7 @@ static struct option long_options[] =
   {"suffix", required_argument, 0, 'U'},
   {"display", optional_argument, 0, 'D'},
   {"info", no_argument, 0, 'I'},
+  {"benchmark", optional_argument, 0, 'B'},
   {0, no_argument, 0, 0}
 };
 
@@ -101,6 +104,7 @@ static struct
   bool mipmaps;
   bool makeCube;
   bool splitSubImg;
+  int benchmarkRuns;
 } opt =
 {
   false,
@@ -120,7 +124,8 @@ static struct
   0,
   false,
   false,
-  false
+  false,
+  5
 };
 // Dont move inside the struct!
 static csRGBpixel transpcolor;
@@ -163,6 +168,9 @@ static int display_help ()
   csPrintf ("  -D   --display=#,#   Display the image in ASCII format :-)\n");
   csPrintf ("                       An optional scale argument may be specified\n");
   csPrintf ("  -I   --info          Display image info (and don't do anything more)\n");
+  csPrintf ("  -B   --benchmark[=#] Decode the image and save it with the given mime\n");
+  csPrintf ("                       type and options # times (default: 5), report\n");
+  csPrintf ("                       throughput and PSNR\n");
   return 1;
 }
 
@@ -248,6 +256,72 @@ static bool output_picture (const char *fname, const char *suffix, iImage* ifile
   return true;
 }
 
+static bool benchmark_picture (const char *fname, iImage* ifile)
+{
+  csRef<iImage> image (ifile);
+  if ((image->GetFormat () & CS_IMGFMT_MASK) != CS_IMGFMT_TRUECOLOR)
+  {
+    image.AttachNew (new csImageMemory (image,
+      (image->GetFormat () & ~CS_IMGFMT_MASK) | CS_IMGFMT_TRUECOLOR));
+  }
+  const int width = image->GetWidth ();
+  const int height = image->GetHeight ();
+  size_t pixels = 0;
+  for (uint m = 0; m <= image->HasMipmaps (); m++)
+  {
+    csRef<iImage> mip (image->GetMipmap (m));
+    pixels += mip->GetWidth () * mip->GetHeight ();
+  }
+
+  csRef<iDataBuffer> db;
+  csMicroTicks start = csGetMicroTicks ();
+  for (int i = 0; i < opt.benchmarkRuns; i++)
+    db = ImageLoader->Save (image, output_mime, output_opts);
+  csMicroTicks elapsed = csGetMicroTicks () - start;
+  if (!db)
+  {
+    csPrintf ("Failed to save %s. Plugin returned no data.\n", fname);
+    return false;
+  }
+  const double seconds = elapsed / (1000000.0 * opt.benchmarkRuns);
+
+  // Compare the saved image with the original
+  const bool alpha = (image->GetFormat () & CS_IMGFMT_ALPHA) != 0;
+  csRef<iImage> loaded (ImageLoader->Load (db,
+    CS_IMGFMT_TRUECOLOR | (image->GetFormat () & CS_IMGFMT_ALPHA)));
+  if (!loaded.IsValid () || (loaded->GetWidth () != width)
+    || (loaded->GetHeight () != height))
+  {
+    csPrintf ("Could not load the saved data of %s\n", fname);
+    return false;
+  }
+  const csRGBpixel* orig = (const csRGBpixel*)image->GetImageData ();
+  const csRGBpixel* saved = (const csRGBpixel*)loaded->GetImageData ();
+  double sqError = 0;
+  for (int i = 0; i < width * height; i++)
+  {
+    int d;
+    d = orig[i].red - saved[i].red;     sqError += d * d;
+    d = orig[i].green - saved[i].green; sqError += d * d;
+    d = orig[i].blue - saved[i].blue;   sqError += d * d;
+    if (alpha)
+    {
+      d = orig[i].alpha - saved[i].alpha; sqError += d * d;
+    }
+  }
+  const double mse = sqError / (width * height * (alpha ? 4 : 3));
+
+  csPrintf ("%s: %dx%d, %s %s, %zu bytes\n", fname, width, height,
+    output_mime, output_opts, db->GetSize ());
+  csPrintf ("  %.2f ms per save, %.2f MPixels/s, ", seconds * 1000.0,
+    seconds > 0 ? pixels / (seconds * 1000000.0) : 0.0);
+  if (mse > 0)
+    csPrintf ("PSNR %.2f dB\n", 10.0 * log10 (255.0 * 255.0 / mse));
+  else
+    csPrintf ("lossless\n");
+  return true;
+}
+
 static bool display_picture (csRef<iImage> ifile)
 {
   static char imgchr [] = " .,;+*oO";
@@ -451,6 +525,22 @@ static csRef<iImage> open_file (const char *fname)
     	programname, fname);
     return 0;
   }
+  if (opt.outputmode == 3)
+  {
+    // Decoding may happen in the background; getting the data waits for it.
+    csMicroTicks start = csGetMicroTicks ();
+    for (int i = 0; i < opt.benchmarkRuns; i++)
+    {
+      csRef<iImage> img (ImageLoader->Load (buf, fmt | CS_IMGFMT_ALPHA));
+      img->GetImageData ();
+    }
+    csMicroTicks elapsed = csGetMicroTicks () - start;
+    const double seconds = elapsed / (1000000.0 * opt.benchmarkRuns);
+    csPrintf ("%s: %.2f ms per decode, %.2f MPixels/s\n", fname,
+      seconds * 1000.0, seconds > 0
+      ? ifile->GetWidth () * ifile->GetHeight () / (seconds * 1000000.0)
+      : 0.0);
+  }
   return ifile;
 }
 
@@ -475,6 +565,9 @@ static bool process_file (const char *fname, csRef<iImage>* outImage = 0)
       case 2:
 	success = true;
 	break;
+      case 3:
+	success = benchmark_picture (fname, ifile);
+	break;
     }
   }
   else
@@ -494,7 +587,7 @@ int gfxtest_main (iObjectRegistry* object_reg, int argc, char *argv[])
   /* getopt_long 101: one colon follows - required argument, 
                       two colons - optional arg. */
   while ((c = getopt_long (argc, argv, 
-      "8cdaAs:m:t:p:D::S::EM:O:P:U:IhvVFTNC", long_options, 0)) != EOF)
+      "8cdaAs:m:t:p:D::S::EM:O:P:U:IB::hvVFTNC", long_options, 0)) != EOF)
     switch (c)
     {
       case '?':
@@ -612,6 +705,16 @@ int gfxtest_main (iObjectRegistry* object_reg, int argc, char *argv[])
         opt.outputmode = 2;
         opt.info = true;
         break;
+      case 'B':
+        opt.outputmode = 3;
+        if (optarg && 
+            ((sscanf (optarg, "%d", &opt.benchmarkRuns) != 1) 
+            || (opt.benchmarkRuns < 1)))
+        {
+          csPrintf ("%s: expecting <runs> which is >=1 after -B\n", programname);
+          return -1;
+        }
+        break;
       case 'h':
 	return display_help ();
       case 'v':
@@ -30,21 +30,56 @@
 
 #include "csextern.h"
 #include "igraphic/image.h"
+#include "iutil/job.h"
 #include "csutil/cscolor.h"
 
 /**
  * Helper class to manipulate iImage objects.
  * The methods in this class generally return new images.
+ *
+ * If a job queue was set with SetJobQueue(), large images are processed in
+ * bands of rows in parallel. The results don't depend on that.
  */
 class CS_CRYSTALSPACE_EXPORT csImageManipulate
 {
   static csRef<iImage> Mipmap2D (iImage* source, int step, 
     csRGBpixel* transp = 0);
+  static csRef<iImage> Mipmap2DFiltered (iImage* source, int step,
+    uint flags);
   static csRef<iImage> Mipmap3D (iImage* source, int step, 
     csRGBpixel* transp = 0);
   static csRef<iImage> Rescale2D (iImage* source, int NewWidth, 
     int NewHeight);
 public:
+  /// Flags for Mipmap().
+  enum
+  {
+    /// Average blocks of 2x2 pixels. This is the default filter.
+    mipFilterBox = 0,
+    /**
+     * Use a Kaiser windowed sinc filter over 8x8 pixels. Keeps more
+     * detail than the box filter.
+     */
+    mipFilterKaiser = 1,
+    /// Mask for the filter type.
+    mipFilterMask = 0xf,
+    /// Filter in linear space, treating the color channels as sRGB.
+    mipGammaCorrect = 0x10,
+    /**
+     * Weight the colors by alpha while filtering. This keeps the colors of
+     * transparent pixels from bleeding into visible ones.
+     */
+    mipPremultipliedAlpha = 0x20
+  };
+
+  /**
+   * Set the job queue used to process large images in parallel. Pass 0 to
+   * do all work on the calling thread.
+   */
+  static void SetJobQueue (iJobQueue* queue);
+  /// Get the job queue used to process large images in parallel.
+  static iJobQueue* GetJobQueue ();
+
   /// Rescale an image to the given size.
   static csRef<iImage> Rescale (iImage* source, int NewWidth, 
     int NewHeight, int NewDepth = 1);
@@ -57,9 +92,12 @@ public:
    * The new image will have same format as the original one. If you pass
    * a pointer to a transparent color, the texels of that color are handled
    * differently.
+   * \a flags select the filter and its options, see mipFilterBox etc. They
+   * are only used for 2D truecolor images without a transparent color,
+   * other images always use the box filter.
    */
   static csRef<iImage> Mipmap (iImage* source, int step, 
-    csRGBpixel* transp = 0);
+    csRGBpixel* transp = 0, uint flags = mipFilterBox);
   /**
    * Return a blurred version of the image.
    */
@@ -741,15 +741,15 @@ private:
   AccessorValues* accessor;
 
   CS_DECLARE_STATIC_CLASSVAR (matrixAlloc, MatrixAlloc,
-    CS::Memory::BlockAllocatorSafe<csMatrix3>)
+    CS::Memory::BlockAllocatorCached<csMatrix3>)
   CS_DECLARE_STATIC_CLASSVAR (matrix4Alloc, Matrix4Alloc,
-    CS::Memory::BlockAllocatorSafe<CS::Math::Matrix4>)
+    CS::Memory::BlockAllocatorCached<CS::Math::Matrix4>)
   CS_DECLARE_STATIC_CLASSVAR (transformAlloc, TransformAlloc,
-    CS::Memory::BlockAllocatorSafe<csReversibleTransform>)
+    CS::Memory::BlockAllocatorCached<csReversibleTransform>)
   CS_DECLARE_STATIC_CLASSVAR (arrayAlloc, ShaderVarArrayAlloc,
-    CS::Memory::BlockAllocatorSafe<SvArrayType>)
+    CS::Memory::BlockAllocatorCached<SvArrayType>)
   CS_DECLARE_STATIC_CLASSVAR (accessorAlloc, AccessorValuesAlloc,
-    CS::Memory::BlockAllocatorSafe<AccessorValues>)
+    CS::Memory::BlockAllocatorCached<AccessorValues>)
 
   virtual void NewType (VariableType nt);
   virtual void AllocAccessor (const AccessorValues& other = AccessorValues());
@@ -0,0 +1,290 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSGFX_SHADERVARSLOTMAP_H__
+#define __CS_CSGFX_SHADERVARSLOTMAP_H__
+
+/**\file
+ * Mapping of shader variable names to compact stack slots.
+ */
+
+#include "csgfx/shadervar.h"
+#include "csutil/array.h"
+#include "csutil/noncopyable.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/mutex.h"
+
+namespace CS
+{
+namespace Graphics
+{
+  /**
+   * Storage for the slots of shader variable stacks using a
+   * ShaderVarSlotMap. Stacks set up on the same storage share the variables,
+   * also after it grew.
+   */
+  struct ShaderVarSlots
+  {
+    /// Variables, by slot
+    csShaderVariable** vars;
+    /// Number of slots
+    size_t size;
+    /// Whether \a vars was allocated by Grow() and must be freed by Free()
+    bool grown;
+
+    ShaderVarSlots () : vars (0), size (0), grown (false) {}
+    ShaderVarSlots (csShaderVariable** vars, size_t size)
+      : vars (vars), size (size), grown (false) {}
+
+    /// Make room for at least \a minSize slots, keeping the variables.
+    void Grow (size_t minSize)
+    {
+      if (minSize <= size) return;
+      const size_t newSize = (minSize > size * 2) ? minSize : size * 2;
+      csShaderVariable** newVars = static_cast<csShaderVariable**> (
+        cs_malloc (newSize * sizeof (csShaderVariable*)));
+      if (size > 0)
+        memcpy (newVars, vars, size * sizeof (csShaderVariable*));
+      memset (newVars + size, 0, (newSize - size) * sizeof (csShaderVariable*));
+      Free ();
+      vars = newVars;
+      size = newSize;
+      grown = true;
+    }
+
+    /// Free the storage allocated by Grow() and reset to no slots.
+    void Free ()
+    {
+      if (grown) cs_free (vars);
+      vars = 0;
+      size = 0;
+      grown = false;
+    }
+
+    /// Copy the variables of \a other, growing if needed.
+    void CopyFrom (const ShaderVarSlots& other)
+    {
+      if (&other == this) return;
+      Grow (other.size);
+      if (other.size > 0)
+        memcpy (vars, other.vars, other.size * sizeof (csShaderVariable*));
+      if (size > other.size)
+        memset (vars + other.size, 0,
+          (size - other.size) * sizeof (csShaderVariable*));
+    }
+  };
+
+  /**
+   * Maps shader variable names to slots of a compact shader variable stack.
+   *
+   * A stack indexed by name needs a pointer for every shader variable name
+   * ever used, although only names that are actually set on stacks matter.
+   * A stack set up with a slot map (see csShaderVariableStack::Setup()) is
+   * still accessed by name, but stores the variables in slots which are only
+   * given to names when they are first set. Slot 0 is never given out; names
+   * without a slot read as null. The storage of the slots (see
+   * ShaderVarSlots) grows when a name gets a slot beyond its size.
+   *
+   * Looking up slots doesn't lock, so stacks using the same map can be set up
+   * from multiple threads.
+   */
+  class ShaderVarSlotMap : private CS::NonCopyable
+  {
+  public:
+    /// Slots of all names, indexed by name; 0 if a name has no slot
+    struct Table
+    {
+      size_t numNames;
+      uint32 slots[1];
+    };
+  private:
+    typedef CS::Threading::AtomicOperations AtomicOps;
+
+    /// Names of all slots given out, indexed by slot
+    struct NameTable
+    {
+      size_t numSlots;
+      uint32 names[1];
+    };
+
+    /// Current table
+    Table* table;
+    /// Tables replaced by a larger one; freed on destruction
+    csArray<Table*> oldTables;
+    /// Current name table
+    NameTable* nameTable;
+    /// Name tables replaced by a larger one; freed on destruction
+    csArray<NameTable*> oldNameTables;
+    /// Number of slots given out, including slot 0
+    int32 numSlots;
+    /// Taken when assigning slots
+    CS::Threading::Mutex lock;
+
+    static Table* NewTable (size_t numNames)
+    {
+      Table* t = static_cast<Table*> (cs_malloc (
+        sizeof (Table) + (numNames - 1) * sizeof (uint32)));
+      t->numNames = numNames;
+      memset (t->slots, 0, numNames * sizeof (uint32));
+      return t;
+    }
+
+    static NameTable* NewNameTable (size_t numSlots)
+    {
+      NameTable* t = static_cast<NameTable*> (cs_malloc (
+        sizeof (NameTable) + (numSlots - 1) * sizeof (uint32)));
+      t->numSlots = numSlots;
+      for (size_t i = 0; i < numSlots; i++)
+        t->names[i] = uint32 (InvalidShaderVarStringID);
+      return t;
+    }
+
+    /// Publish a name table with room for slot \a slot. Caller locks.
+    void GrowNames (size_t slot)
+    {
+      NameTable* newTable = NewNameTable (
+        csMax (slot + 1, nameTable->numSlots * 2));
+      memcpy (newTable->names, nameTable->names,
+        nameTable->numSlots * sizeof (uint32));
+      oldNameTables.Push (nameTable);
+      AtomicOps::Set ((void**)&nameTable, newTable);
+    }
+
+    /// Publish a table with room for at least \a numNames. Caller locks.
+    void Grow (size_t numNames)
+    {
+      Table* newTable = NewTable (csMax (numNames, table->numNames * 2));
+      memcpy (newTable->slots, table->slots,
+        table->numNames * sizeof (uint32));
+      oldTables.Push (table);
+      AtomicOps::Set ((void**)&table, newTable);
+    }
+  public:
+    /// Construct with room for \a numNames names.
+    ShaderVarSlotMap (size_t numNames = 256) : numSlots (1)
+    {
+      table = NewTable (csMax (numNames, size_t (1)));
+      nameTable = NewNameTable (64);
+    }
+    ~ShaderVarSlotMap ()
+    {
+      cs_free (table);
+      for (size_t i = 0; i < oldTables.GetSize (); i++)
+        cs_free (oldTables[i]);
+      cs_free (nameTable);
+      for (size_t i = 0; i < oldNameTables.GetSize (); i++)
+        cs_free (oldNameTables[i]);
+    }
+
+    /**
+     * Get the current table. It stays valid as long as the map exists, but
+     * slots given to names later may be missing from it.
+     */
+    const Table* GetTable () const
+    {
+#ifdef CS_PROCESSOR_X86
+      // Loads aren't reordered with other loads on x86
+      return *const_cast<Table* const volatile*> (&table);
+#else
+      return static_cast<const Table*> (AtomicOps::Read ((void* const*)&table));
+#endif
+    }
+
+    /// Get the slot of a name from \a table, 0 if it has none.
+    static size_t GetSlot (const Table* table, ShaderVarStringID name)
+    {
+      return (size_t (name) < table->numNames) ? table->slots[name] : 0;
+    }
+
+    /// Get the slot of a name, 0 if it has none.
+    size_t GetSlot (ShaderVarStringID name) const
+    { return GetSlot (GetTable (), name); }
+
+    /**
+     * Get the name a slot was given to, or the invalid name for slot 0 and
+     * slots not given out. Use with slots taken from a stack or returned by
+     * GetSlot() or Request().
+     */
+    ShaderVarStringID GetSlotName (size_t slot) const
+    {
+#ifdef CS_PROCESSOR_X86
+      const NameTable* t = *const_cast<NameTable* const volatile*> (&nameTable);
+#else
+      const NameTable* t = static_cast<const NameTable*> (
+        AtomicOps::Read ((void* const*)&nameTable));
+#endif
+      return (slot < t->numSlots) ? ShaderVarStringID (t->names[slot])
+        : InvalidShaderVarStringID;
+    }
+
+    /**
+     * Get the slot of a name, giving it a new one if it has none.
+     * Returns 0 for the invalid name.
+     */
+    size_t Request (ShaderVarStringID name)
+    {
+      size_t slot = GetSlot (name);
+      if ((slot != 0) || (name == InvalidShaderVarStringID)) return slot;
+
+      CS::Threading::MutexScopedLock scopedLock (lock);
+      if (size_t (name) >= table->numNames)
+        Grow (size_t (name) + 1);
+      slot = table->slots[name];
+      if (slot == 0)
+      {
+        slot = size_t (numSlots);
+        // The name must be found before anyone can see the slot
+        if (slot >= nameTable->numSlots)
+          GrowNames (slot);
+        nameTable->names[slot] = uint32 (name);
+        AtomicOps::Set (&numSlots, int32 (slot + 1));
+        AtomicOps::Set ((int32*)&table->slots[name], int32 (slot));
+      }
+      return slot;
+    }
+
+    /**
+     * Make room for names up to \a numNames, so GetNameCount() covers them.
+     * Call with the size of the shader variable name set before setting up
+     * stacks.
+     */
+    void Reserve (size_t numNames)
+    {
+      if (numNames <= GetTable ()->numNames) return;
+      CS::Threading::MutexScopedLock scopedLock (lock);
+      if (numNames > table->numNames) Grow (numNames);
+    }
+
+    /// Number of names which can be looked up without growing.
+    size_t GetNameCount () const
+    { return GetTable ()->numNames; }
+
+    /// Number of slots given out so far, including the unused slot 0.
+    size_t GetSlotCount () const
+    {
+#ifdef CS_PROCESSOR_X86
+      return size_t (*const_cast<const volatile int32*> (&numSlots));
+#else
+      return size_t (AtomicOps::Read (&numSlots));
+#endif
+    }
+  };
+} // namespace Graphics
+} // namespace CS
+
+#endif // __CS_CSGFX_SHADERVARSLOTMAP_H__
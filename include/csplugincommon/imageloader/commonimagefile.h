@@ -30,6 +30,7 @@
 #include "csutil/scf_interface.h"
 #include "csutil/scf_implementation.h"
 #include "csutil/weakref.h"
+#include "igraphic/deferredimage.h"
 #include "iutil/databuff.h"
 #include "iutil/job.h"
 
@@ -57,13 +58,59 @@ enum csLoaderDataType
 
 class csCommonImageFile;
 
+/**
+ * Queue on which images are decoded in the background.
+ * Jobs are run by a number of worker threads in the order of their priority.
+ * A shared instance is registered in the object registry with the tag
+ * <tt>crystalspace.graphic.image.decodequeue</tt>.
+ */
+struct iImageDecodeQueue : public virtual iBase
+{
+  SCF_INTERFACE(iImageDecodeQueue, 0,0,1);
+
+  /**
+   * Add a job to the queue. Jobs with a higher \a priority are run first,
+   * jobs with the same priority in the order they were added.
+   */
+  virtual void Enqueue (iJob* job, int priority) = 0;
+  /**
+   * Change the priority of a job that is still waiting in the queue.
+   * Returns whether the job was found.
+   */
+  virtual bool SetPriority (iJob* job, int priority) = 0;
+  /**
+   * Remove a job from the queue. If it is currently running, wait for it to
+   * finish if \a waitForCompletion is \c true.
+   * \sa iJobQueue::Dequeue
+   */
+  virtual iJobQueue::JobStatus Dequeue (iJob* job,
+    bool waitForCompletion) = 0;
+  /**
+   * If a job is still in the queue, remove it and run it immediately.
+   * If it is currently running, wait for it to finish.
+   * \sa iJobQueue::PullAndRun
+   */
+  virtual iJobQueue::JobStatus PullAndRun (iJob* job) = 0;
+  /// Get the number of worker threads.
+  virtual size_t GetWorkerCount () = 0;
+
+  /// Record that an image of \a pixels pixels was decoded in \a time.
+  virtual void RecordDecode (size_t pixels, csMicroTicks time) = 0;
+  /**
+   * Get the number of decoded images, their total number of pixels and
+   * the total time (summed over all threads) spent decoding them.
+   */
+  virtual void GetStatistics (size_t& images, uint64& pixels,
+    csMicroTicks& time) = 0;
+};
+
 /**
  * An image file loader.
  * Handles the decoding of an image.
  */
 struct iImageFileLoader : public virtual iBase
 {
-  SCF_INTERFACE(iImageFileLoader, 2,0,0);
+  SCF_INTERFACE(iImageFileLoader, 2,1,0);
   /// Do the loading.
   virtual bool LoadData () = 0;
   /// Return "raw data" (if supported)
@@ -82,6 +129,18 @@ struct iImageFileLoader : public virtual iBase
   virtual bool HasKeyColor() const = 0;
   /// Query keycolor
   virtual void GetKeyColor (int &r, int &g, int &b) const = 0;
+  /**
+   * Decode the image at a reduced size, with the width and height halved
+   * \a levels times. Called before LoadData(). Returns the number of levels
+   * the size was actually reduced, the dimensions must be updated
+   * accordingly.
+   */
+  virtual int ReduceSize (int levels) = 0;
+  /**
+   * Set a queue on which ApplyTo() can distribute the conversion of large
+   * images.
+   */
+  virtual void SetConversionQueue (iImageDecodeQueue* queue) = 0;
 };
 
 /**
@@ -117,6 +176,8 @@ protected:
   csRGBcolor keycolor;
   /// Image dimensions.
   int Width, Height;
+  /// Queue for converting large images.
+  csRef<iImageDecodeQueue> conversionQueue;
 public:
   csCommonImageFileLoader (int format);
   virtual ~csCommonImageFileLoader();
@@ -134,6 +195,10 @@ public:
   { 
     r = keycolor.red; g = keycolor.green; b = keycolor.blue; 
   }
+  /// Default implementation does not support reduced sizes.
+  virtual int ReduceSize (int levels) { return 0; }
+  virtual void SetConversionQueue (iImageDecodeQueue* queue)
+  { conversionQueue = queue; }
 };
 
 #define CSCOMMONIMAGEFILE_THREADED_LOADING
@@ -142,7 +207,8 @@ public:
  * A base class for image loader plugin iImage implementations.
  */
 class CS_CRYSTALSPACE_EXPORT csCommonImageFile : 
-  public scfImplementationExt0<csCommonImageFile, csImageMemory>
+  public scfImplementationExt1<csCommonImageFile, csImageMemory,
+                               iDeferredImage>
 {
 protected:
   friend class csCommonImageFileLoader;
@@ -170,7 +236,9 @@ protected:
   // This and jobQueue are mutable so MakeImageData() can be called.
   mutable csRef<LoaderJob> loadJob;
   /// Reference to job queue.
-  mutable csRef<iJobQueue> jobQueue;
+  mutable csRef<iImageDecodeQueue> jobQueue;
+  /// Priority of the loading job.
+  int decodePriority;
 #endif
   // This is mutable so MakeImageData() can be called.
   mutable csRef<iImageFileLoader> currentLoader;
@@ -231,6 +299,12 @@ protected:
   static const char* DataTypeString (csLoaderDataType dataType);
   virtual const char* GetRawFormat() const;
   virtual csRef<iDataBuffer> GetRawData() const;
+
+  /**\name iDeferredImage implementation
+   * @{ */
+  virtual void SetDecodePriority (int priority);
+  virtual int ReduceDecodeSize (int levels);
+  /** @} */
 };
 
 /** @} */
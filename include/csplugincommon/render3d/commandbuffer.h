@@ -0,0 +1,201 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSPLUGINCOMMON_RENDER3D_COMMANDBUFFER_H__
+#define __CS_CSPLUGINCOMMON_RENDER3D_COMMANDBUFFER_H__
+
+/**\file
+ * Storage for recorded graphics commands
+ */
+
+#include "csextern.h"
+#include "csgfx/shadervar.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/hash.h"
+#include "csutil/noncopyable.h"
+#include "csutil/refarr.h"
+#include "ivideo/shader/shader.h"
+
+struct iGraphics3D;
+
+namespace CS
+{
+  namespace Graphics
+  {
+    /**
+     * A list of recorded commands, typically calls to iGraphics3D, which can
+     * be replayed later.
+     * Commands and the data they reference are stored in blocks of memory
+     * which are reused after Clear(), so recording a frame usually doesn't
+     * allocate any memory once the buffer has grown to the frame's size.
+     *
+     * Commands are derived from CommandBuffer::Command and constructed in
+     * memory obtained from AllocateCommand():
+     * \code
+     * MyCommand* cmd = new (buffer.AllocateCommand (sizeof (MyCommand)))
+     *   MyCommand (...);
+     * buffer.Append (cmd);
+     * \endcode
+     */
+    class CS_CRYSTALSPACE_EXPORT CommandBuffer : private CS::NonCopyable
+    {
+    public:
+      class ReplayContext;
+
+      /// Base class for recorded commands
+      class Command
+      {
+        friend class CommandBuffer;
+        Command* next;
+      public:
+        Command () : next (0) {}
+        /// Called when the buffer is cleared
+        virtual ~Command () {}
+
+        /// Execute the command
+        virtual void Execute (iGraphics3D* g3d, ReplayContext& context) = 0;
+      };
+
+      /**
+       * Shader variables of a stack, captured at recording time.
+       * Only the occupied slots of the stack are stored, and each variable
+       * is a copy of the variable's value at the time it was captured.
+       */
+      struct StackSnapshot
+      {
+        struct Entry
+        {
+          size_t index;
+          csShaderVariable* variable;
+        };
+        /// Number of names the stack needs to hold the entries
+        size_t stackSize;
+        /// Number of occupied slots
+        size_t numEntries;
+        /// Occupied slots
+        const Entry* entries;
+      };
+
+      /// State used by commands while a buffer is replayed
+      class CS_CRYSTALSPACE_EXPORT ReplayContext : private CS::NonCopyable
+      {
+        csDirtyAccessArray<csShaderVariable*> stackStorage;
+        csShaderVariableStack stack;
+      public:
+        /**
+         * Whether the last shader pass was activated successfully.
+         * Meshes drawn with a pass that failed to activate are skipped.
+         */
+        bool passActive;
+
+        ReplayContext () : passActive (false) {}
+
+        /**
+         * Get a full shader variable stack for a snapshot. The stack is
+         * valid until Release() is called.
+         */
+        const csShaderVariableStack& Expand (const StackSnapshot& snapshot);
+        /// Done using the stack returned by Expand()
+        void Release (const StackSnapshot& snapshot);
+      };
+
+      /**
+       * Construct.
+       * \param blockSize Size of the memory blocks commands are stored in.
+       */
+      CommandBuffer (size_t blockSize = 64*1024);
+      ~CommandBuffer ();
+
+      /**
+       * Allocate memory for data referenced by a command. The memory is
+       * released when the buffer is cleared.
+       */
+      void* Allocate (size_t size);
+      /// Allocate memory for a command object.
+      void* AllocateCommand (size_t size) { return Allocate (size); }
+      /// Copy \a num elements of plain data into the buffer
+      template<typename T>
+      T* CopyArray (const T* src, size_t num)
+      {
+        if (!src || (num == 0)) return 0;
+        T* dst = static_cast<T*> (Allocate (num * sizeof (T)));
+        memcpy (dst, src, num * sizeof (T));
+        return dst;
+      }
+
+      /// Append a command constructed in memory from AllocateCommand().
+      void Append (Command* command);
+
+      /**
+       * Capture the shader variables of a stack.
+       * Recording a variable again refers to the last copy made of it, as
+       * long as its value didn't change since; otherwise a new copy is made.
+       * Variables with an accessor are evaluated while capturing.
+       */
+      StackSnapshot Snapshot (const csShaderVariableStack& stack);
+      /**
+       * Capture a single shader variable, eg one referenced by instancing
+       * parameters. Returns the copy used during replay.
+       */
+      csShaderVariable* Capture (csShaderVariable* var);
+
+      /// Execute all commands, in the order they were recorded.
+      void Replay (iGraphics3D* g3d, ReplayContext& context);
+
+      /// Remove all commands and free all data referenced by them.
+      void Clear ();
+
+      /// Whether no command was recorded
+      bool IsEmpty () const { return firstCommand == 0; }
+      /// Number of commands recorded
+      size_t GetCommandCount () const { return numCommands; }
+      /// Number of bytes used by the recorded commands and their data
+      size_t GetUsedMemory () const { return usedMemory; }
+      /// Number of shader variables copied for snapshots
+      size_t GetCapturedVariableCount () const
+      { return svCopyRefs.GetSize (); }
+    private:
+      struct Block
+      {
+        Block* next;
+        size_t size;
+      };
+      size_t blockSize;
+      /// Chain of all blocks
+      Block* firstBlock;
+      /// Block memory is currently allocated from
+      Block* currentBlock;
+      /// Next free byte in the current block
+      size_t currentOffset;
+
+      Command* firstCommand;
+      Command* lastCommand;
+      size_t numCommands;
+      size_t usedMemory;
+
+      /// Last copy of each captured shader variable, by original variable
+      csHash<csShaderVariable*, csPtrKey<csShaderVariable> > svCopies;
+      /// All copies; earlier copies of a variable are used by earlier commands
+      csRefArray<csShaderVariable> svCopyRefs;
+
+      Block* NewBlock (size_t minSize);
+    };
+  } // namespace Graphics
+} // namespace CS
+
+#endif // __CS_CSPLUGINCOMMON_RENDER3D_COMMANDBUFFER_H__
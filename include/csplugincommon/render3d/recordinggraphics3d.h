@@ -0,0 +1,338 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSPLUGINCOMMON_RENDER3D_RECORDINGGRAPHICS3D_H__
+#define __CS_CSPLUGINCOMMON_RENDER3D_RECORDINGGRAPHICS3D_H__
+
+/**\file
+ * iGraphics3D implementation recording calls for later submission
+ */
+
+#include "csextern.h"
+#include "csgeom/csrect.h"
+#include "csgeom/matrix4.h"
+#include "csgeom/plane3.h"
+#include "csgeom/transfrm.h"
+#include "csplugincommon/render3d/commandbuffer.h"
+#include "csutil/scf_implementation.h"
+#include "csutil/threading/condition.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/threading/thread.h"
+#include "ivideo/graph3d.h"
+#include "ivideo/rendermesh.h"
+
+struct iShader;
+
+namespace CS
+{
+  namespace Graphics
+  {
+    /// Counters of a graphics command recorder
+    struct RecorderStatistics
+    {
+      /// Number of command buffers submitted
+      uint submits;
+      /// Number of calls that had to wait for all commands to be replayed
+      uint syncs;
+      /// Number of commands recorded
+      uint64 commands;
+      /// Memory used by recorded commands, in bytes
+      uint64 commandBytes;
+      /// Number of shader variables copied for snapshots
+      uint64 capturedVariables;
+      /// Time spent replaying commands, in microseconds
+      csMicroTicks replayTime;
+      /**
+       * Time the recording thread waited for the submission thread, in
+       * microseconds
+       */
+      csMicroTicks waitTime;
+
+      RecorderStatistics () : submits (0), syncs (0), commands (0),
+        commandBytes (0), capturedVariables (0), replayTime (0), waitTime (0)
+      {}
+    };
+  } // namespace Graphics
+} // namespace CS
+
+/**
+ * Interface to a graphics command recorder.
+ * Shaders talk to the hardware directly, so drawing meshes with shader passes
+ * needs to be recorded through this interface for the pass setup to happen
+ * at the right time.
+ */
+struct iGraphics3DRecorder : public virtual iBase
+{
+  SCF_INTERFACE (iGraphics3DRecorder, 0, 0, 1);
+
+  //@{
+  /**
+   * Record shader pass activation and drawing of a mesh with a shader pass.
+   * Equivalent to calling iShader::ActivatePass(),
+   * iShader::SetupPass() + iGraphics3D::DrawMesh() + iShader::TeardownPass()
+   * for each mesh, and iShader::DeactivatePass(). If activating the pass
+   * fails all meshes drawn until the pass is deactivated are skipped; if
+   * setting up the pass for a mesh fails the mesh is skipped.
+   * \a zmode overrides the Z mode in the modes returned by SetupPass().
+   */
+  virtual void ActivatePass (iShader* shader, size_t ticket, size_t pass) = 0;
+  virtual void DrawMeshPass (iShader* shader, size_t ticket,
+    const CS::Graphics::RenderMesh* mesh,
+    const CS::Graphics::RenderMeshModes& modes, csZBufMode zmode,
+    const csShaderVariableStack& stack) = 0;
+  virtual void DeactivatePass (iShader* shader, size_t ticket) = 0;
+  //@}
+
+  /// Hand all commands recorded so far to the submission thread.
+  virtual void Submit () = 0;
+  /// Submit recorded commands and wait until they were replayed.
+  virtual void Sync () = 0;
+
+  /// Get the statistics counters
+  virtual void GetStatistics (CS::Graphics::RecorderStatistics& stats) = 0;
+  /// Reset the statistics counters
+  virtual void ResetStatistics () = 0;
+};
+
+// SetPerspective*, EnableZOffset etc. are deprecated but still need wrapping
+#include "csutil/deprecated_warn_off.h"
+
+namespace CS
+{
+  namespace Graphics
+  {
+    /**
+     * iGraphics3D wrapper which records all calls changing the render state
+     * or drawing into command buffers and replays them on another
+     * iGraphics3D (the "backend"), optionally on a dedicated submission
+     * thread. Thus, the render manager can traverse the next frame while
+     * the backend is still busy with the last one.
+     *
+     * A buffer is submitted at the end of each frame (Print()). Calls which
+     * return results from the backend, like occlusion queries or
+     * GetZBuffValue(), wait until all recorded commands were replayed and
+     * are then forwarded to the backend on the calling thread. Getters for
+     * the render state return the recorded state. While 2D graphics are
+     * drawn (BeginDraw() with #CSDRAW_2DGRAPHICS) all calls are forwarded
+     * immediately, as drawing to the canvas isn't recorded. Calls made by
+     * the submission thread itself, e.g. by shaders during replay, are
+     * forwarded immediately as well.
+     *
+     * Shader variables used for drawing are captured when recorded.
+     * The contents of render buffers and textures are not, so those must not
+     * be changed while they are still in use by a submitted frame.
+     * A threaded recorder needs a backend that can be used from a thread
+     * other than the one that created it; this is the case for the null
+     * renderer.
+     *
+     * Replay calls iShader::ActivatePass(), SetupPass() and the other pass
+     * methods on the submission thread. The main thread may meanwhile
+     * record the next frame and call iShader::GetTicket() on the same
+     * shaders, so shaders used with a threaded recorder must allow that.
+     */
+    class CS_CRYSTALSPACE_EXPORT RecordingGraphics3D :
+      public scfImplementation2<RecordingGraphics3D,
+                                iGraphics3D,
+                                iGraphics3DRecorder>
+    {
+    public:
+      /**
+       * Construct.
+       * \param backend The iGraphics3D recorded calls are replayed on.
+       * \param threaded Whether commands are replayed on a dedicated
+       *   thread. Otherwise, they are replayed when submitted.
+       */
+      RecordingGraphics3D (iGraphics3D* backend, bool threaded = true);
+      virtual ~RecordingGraphics3D ();
+
+      /// Get the backend
+      iGraphics3D* GetBackend () const { return backend; }
+
+      /**\name iGraphics3DRecorder implementation
+       * @{ */
+      void ActivatePass (iShader* shader, size_t ticket, size_t pass);
+      void DrawMeshPass (iShader* shader, size_t ticket,
+        const CS::Graphics::RenderMesh* mesh,
+        const CS::Graphics::RenderMeshModes& modes, csZBufMode zmode,
+        const csShaderVariableStack& stack);
+      void DeactivatePass (iShader* shader, size_t ticket);
+      void Submit ();
+      void Sync ();
+      void GetStatistics (RecorderStatistics& stats);
+      void ResetStatistics ();
+      /** @} */
+
+      /**\name iGraphics3D implementation
+       * @{ */
+      bool Open ();
+      void Close ();
+      iGraphics2D* GetDriver2D ();
+      iTextureManager* GetTextureManager ();
+      void SetDimensions (int width, int height);
+      int GetWidth () const;
+      int GetHeight () const;
+      const csGraphics3DCaps* GetCaps () const;
+      void SetPerspectiveCenter (int x, int y);
+      void GetPerspectiveCenter (int& x, int& y) const;
+      void SetPerspectiveAspect (float aspect);
+      float GetPerspectiveAspect () const;
+      bool SetRenderTarget (iTextureHandle* handle, bool persistent = false,
+        int subtexture = 0, csRenderTargetAttachment attachment = rtaColor0);
+      bool ValidateRenderTargets ();
+      bool CanSetRenderTarget (const char* format,
+        csRenderTargetAttachment attachment = rtaColor0);
+      iTextureHandle* GetRenderTarget (
+        csRenderTargetAttachment attachment = rtaColor0,
+        int* subtexture = 0) const;
+      void UnsetRenderTargets ();
+      bool BeginDraw (int drawFlags);
+      void FinishDraw ();
+      void Print (csRect const* area);
+      void DrawMesh (const CoreRenderMesh* mymesh,
+        const RenderMeshModes& modes, const csShaderVariableStack& stack);
+      void DrawSimpleMesh (const csSimpleRenderMesh& mesh, uint flags = 0);
+      void DrawPixmap (iTextureHandle* hTex, int sx, int sy, int sw, int sh,
+        int tx, int ty, int tw, int th, uint8 Alpha = 0);
+      void DrawLine (const csVector3& v1, const csVector3& v2, float fov,
+        int color);
+      bool ActivateBuffers (csRenderBufferHolder* holder,
+        csRenderBufferName mapping[CS_VATTRIB_SPECIFIC_LAST+1]);
+      bool ActivateBuffers (csVertexAttrib* attribs, iRenderBuffer** buffers,
+        unsigned int count);
+      void DeactivateBuffers (csVertexAttrib* attribs, unsigned int count);
+      void SetTextureState (int* units, iTextureHandle** textures,
+        int count);
+      void SetClipper (iClipper2D* clipper, int cliptype);
+      iClipper2D* GetClipper ();
+      int GetClipType () const;
+      void SetNearPlane (const csPlane3& pl);
+      void ResetNearPlane ();
+      const csPlane3& GetNearPlane () const;
+      bool HasNearPlane () const;
+      bool SetRenderState (G3D_RENDERSTATEOPTION op, long val);
+      long GetRenderState (G3D_RENDERSTATEOPTION op) const;
+      bool SetOption (const char* name, const char* value);
+      void SetWriteMask (bool red, bool green, bool blue, bool alpha);
+      void GetWriteMask (bool& red, bool& green, bool& blue,
+        bool& alpha) const;
+      void SetZMode (csZBufMode mode);
+      csZBufMode GetZMode ();
+      void EnableZOffset ();
+      void DisableZOffset ();
+      void SetShadowState (int state);
+      float GetZBuffValue (int x, int y);
+      void OpenPortal (size_t numVertices, const csVector2* vertices,
+        const csPlane3& normal, csFlags flags);
+      void ClosePortal ();
+      iHalo* CreateHalo (float iR, float iG, float iB, unsigned char* iAlpha,
+        int iWidth, int iHeight);
+      void SetWorldToCamera (const csReversibleTransform& w2c);
+      bool PerformExtensionV (char const* command, va_list args);
+      const csReversibleTransform& GetWorldToCamera ();
+      int GetCurrentDrawFlags () const;
+      const CS::Math::Matrix4& GetProjectionMatrix ();
+      void SetProjectionMatrix (const CS::Math::Matrix4& m);
+      void SetTextureComparisonModes (int* units,
+        TextureComparisonMode* texCompare, int count);
+      void CopyFromRenderTargets (size_t num,
+        csRenderTargetAttachment* attachments, iTextureHandle** textures,
+        int* subtextures = 0);
+      void DrawSimpleMeshes (const csSimpleRenderMesh* meshes,
+        size_t numMeshes, uint flags = 0);
+      void OQInitQueries (unsigned int* queries, int num_queries);
+      void OQDelQueries (unsigned int* queries, int num_queries);
+      bool OQueryFinished (unsigned int occlusion_query);
+      bool OQIsVisible (unsigned int occlusion_query,
+        unsigned int sampleLimit = 0);
+      void OQBeginQuery (unsigned int occlusion_query);
+      void OQEndQuery ();
+      void DrawMeshBasic (const CoreRenderMesh* mymesh,
+        const RenderMeshModes& modes);
+      void SetEdgeDrawing (bool flag);
+      bool GetEdgeDrawing ();
+      void SetTessellation (bool flag);
+      bool GetTessellation ();
+      /** @} */
+    private:
+      class SubmissionThread;
+      friend class SubmissionThread;
+
+      csRef<iGraphics3D> backend;
+      bool threaded;
+
+      CommandBuffer buffers[2];
+      /// Buffer commands are recorded to
+      CommandBuffer* recordBuffer;
+      /// Buffer being replayed by the submission thread, if any
+      CommandBuffer* pendingBuffer;
+      CommandBuffer::ReplayContext replayContext;
+      /// Thread currently replaying commands
+      CS::Threading::ThreadID replayThreadID;
+      /// Forward calls immediately while 2D graphics are drawn
+      bool immediateMode;
+
+      CS::Threading::Mutex submitMutex;
+      CS::Threading::Condition submitCondition;
+      csRef<CS::Threading::Thread> submitThread;
+      bool stopThread;
+
+      RecorderStatistics stats;
+
+      /**\name Recorded render state
+       * @{ */
+      iTextureHandle* renderTargets[rtaNumAttachments];
+      int renderTargetSubtex[rtaNumAttachments];
+      int drawFlags;
+      csRef<iClipper2D> clipper;
+      int clipType;
+      csPlane3 nearPlane;
+      bool hasNearPlane;
+      bool writeMask[4];
+      csZBufMode zmode;
+      csReversibleTransform worldToCamera;
+      CS::Math::Matrix4 projectionMatrix;
+      int perspectiveCenterX, perspectiveCenterY;
+      float perspectiveAspect;
+      bool edgeDrawing;
+      bool tessellation;
+      /** @} */
+
+      /// Whether calls are to be forwarded to the backend immediately
+      bool IsImmediate () const
+      {
+        return immediateMode
+          || (CS::Threading::Thread::GetThreadID () == replayThreadID);
+      }
+      /// Append a command constructed in memory from AllocateCommand()
+      void Record (CommandBuffer::Command* command)
+      {
+        recordBuffer->Append (command);
+      }
+      /// Replay a buffer on the backend
+      void ReplayBuffer (CommandBuffer* buffer);
+      /// Wait for the submission thread to finish the pending buffer
+      void WaitForPending ();
+      /// Main loop of the submission thread
+      void RunSubmission ();
+    };
+  } // namespace Graphics
+} // namespace CS
+
+#include "csutil/deprecated_warn_on.h"
+
+#endif // __CS_CSPLUGINCOMMON_RENDER3D_RECORDINGGRAPHICS3D_H__
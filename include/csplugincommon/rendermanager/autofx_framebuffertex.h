@@ -188,14 +188,14 @@ namespace CS
 		}
 	      
 		persist.svKeeper.Push (svFBCoordXform);
-		localStack[persist.svFramebufferCoordXform] = svFBCoordXform;
+		localStack.Set (persist.svFramebufferCoordXform, svFBCoordXform);
 	      }
 	      
 	      csRef<csShaderVariable> svFramebufferTex;
 	      svFramebufferTex.AttachNew (new csShaderVariable (svName));
 	      persist.svKeeper.Push (svFramebufferTex);
 	      svFramebufferTex->SetValue (tex);
-	      localStack[svName] = svFramebufferTex;
+	      localStack.Set (svName, svFramebufferTex);
 	      
 	      n++;
 	    }
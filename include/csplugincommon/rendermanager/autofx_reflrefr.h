@@ -575,9 +575,9 @@ namespace CS
 	    }
 	    
 	    // Attach reflection texture to mesh
-	    localStack[persist.svTexPlaneRefl] = svReflection;
-	    localStack[persist.svTexPlaneReflDepth] = svReflectionDepth;
-	    localStack[persist.svReflXform] = persist.reflXformSV;
+	    localStack.Set (persist.svTexPlaneRefl, svReflection);
+	    localStack.Set (persist.svTexPlaneReflDepth, svReflectionDepth);
+	    localStack.Set (persist.svReflXform, persist.reflXformSV);
 	  }
 	  
 	  if (usesRefrTex || usesRefrDepthTex)
@@ -675,9 +675,9 @@ namespace CS
 	    }
 	    
 	    // Attach refraction texture to mesh
-	    localStack[persist.svTexPlaneRefr] = svRefraction;
-	    localStack[persist.svTexPlaneRefrDepth] = svRefractionDepth;
-	    localStack[persist.svRefrXform] = persist.refrXformSV;
+	    localStack.Set (persist.svTexPlaneRefr, svRefraction);
+	    localStack.Set (persist.svTexPlaneRefrDepth, svRefractionDepth);
+	    localStack.Set (persist.svRefrXform, persist.refrXformSV);
 	  }
 	  if ((needReflTex || needRefrTex) && doRender)
 	  {
@@ -582,8 +582,16 @@ namespace RenderManager
 	  }
 	}
 	
+	// The stacks only live for this call, take them from the frame arena
+	const size_t numLocalStacks = shadows.GetLightLayerSpread();
 	csShaderVariableStack* localStacks =
-	  new csShaderVariableStack[shadows.GetLightLayerSpread()];
+	  static_cast<csShaderVariableStack*> (
+	    node->GetOwner().owner.GetPersistentData().frameArena.Alloc (
+	      numLocalStacks * sizeof (csShaderVariableStack)));
+#include "csutil/custom_new_disable.h"
+	for (size_t s = 0; s < numLocalStacks; s++)
+	  new (localStacks + s) csShaderVariableStack;
+#include "csutil/custom_new_enable.h"
   
 	// Now render lights for each light type
 	remainingLights = firstLight;
@@ -712,7 +720,8 @@ namespace RenderManager
 	  totalLayers = neededLayers;
 	}
 	
-	delete[] localStacks;
+	for (size_t s = 0; s < numLocalStacks; s++)
+	  localStacks[s].~csShaderVariableStack ();
 	
 	return firstLight;
       }
@@ -738,7 +747,8 @@ namespace RenderManager
     }
   public:
     struct PersistentData;
-    typedef csArray<iShader*> ShaderArrayType;
+    typedef csArray<iShader*, csArrayElementHandler<iShader*>,
+      TreeArrayAllocator> ShaderArrayType;
     typedef ShadowHandler ShadowHandlerType;
     typedef typename ShadowHandler::ShadowParameters ShadowParamType;
 
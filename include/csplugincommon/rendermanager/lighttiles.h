@@ -0,0 +1,219 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSPLUGINCOMMON_RENDERMANAGER_LIGHTTILES_H__
+#define __CS_CSPLUGINCOMMON_RENDERMANAGER_LIGHTTILES_H__
+
+/**\file
+ * Culling of lights into screen tiles
+ */
+
+#include "csextern.h"
+#include "csgeom/math.h"
+#include "csgeom/matrix4.h"
+#include "csgeom/plane3.h"
+#include "csgeom/vector2.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/noncopyable.h"
+
+struct iJobQueue;
+
+namespace CS
+{
+  namespace RenderManager
+  {
+    /**
+     * Sorts spherical light volumes into screen space tiles.
+     * The screen is split into square tiles of a given size in pixels. For
+     * each tile a list of the lights whose volume intersects the tile's
+     * frustum is computed; the lists of all tiles are packed into a single
+     * array. The culling runs entirely on the CPU, so it doesn't need a
+     * renderer.
+     *
+     * Tiles are numbered row by row, starting with the bottom left tile.
+     * Tile bounds are given in normalized device coordinates of the
+     * projection passed to Setup(), so the rows are in the same order as
+     * the window coordinates of iGraphics3D, with y=0 at the bottom.
+     *
+     * Usage:
+     * \code
+     * culler.Setup (g3d->GetWidth (), g3d->GetHeight (),
+     *   g3d->GetProjectionMatrix ());
+     * culler.ClearLights ();
+     * for (...) culler.AddLight (viewSpaceCenter, radius);
+     * culler.Cull (jobQueue);
+     * for (size_t t = 0; t < culler.GetTileCount (); t++)
+     * {
+     *   const uint* lights = culler.GetTileLights (t);
+     *   ...
+     * }
+     * \endcode
+     */
+    class CS_CRYSTALSPACE_EXPORT LightTileCuller : private CS::NonCopyable
+    {
+    public:
+      enum
+      {
+        /**
+         * Number of tile classes. Tiles are classified by the number of
+         * lights affecting them: class 0 are tiles without lights, class 1
+         * tiles with 1 to 4 lights, class 2 with 5 to 16 lights and so on,
+         * the last class takes all tiles with more lights.
+         */
+        numTileClasses = 5
+      };
+
+      /// Statistics about the last culling run
+      struct Statistics
+      {
+        /// Number of lights added
+        uint lights;
+        /// Number of lights that are in at least one tile
+        uint visibleLights;
+        /// Number of tiles
+        uint tiles;
+        /// Number of tiles with at least one light
+        uint occupiedTiles;
+        /// Sum of the lights over all tiles
+        uint entries;
+        /// Largest number of lights in a tile
+        uint maxTileLights;
+        /// Number of tiles in each class
+        uint tileClasses[numTileClasses];
+        /// Time taken by Cull(), in microseconds
+        csMicroTicks cullTime;
+
+        Statistics ();
+      };
+
+      /// Construct with the given tile size, in pixels
+      LightTileCuller (uint tileSize = 32);
+
+      /// Set the size of tiles, in pixels. Takes effect with Setup().
+      void SetTileSize (uint size) { tileSize = csMax (size, 1u); }
+      /// Get the size of tiles, in pixels.
+      uint GetTileSize () const { return tileSize; }
+
+      /**
+       * Set up the tiles for a viewport of the given size. Light volumes
+       * are tested against the planes of the tile frustums, which are
+       * extracted from \a projection.
+       */
+      void Setup (int width, int height, const CS::Math::Matrix4& projection);
+
+      /// Remove all lights.
+      void ClearLights ();
+      /**
+       * Add a light with a volume given as a sphere in view space. Returns
+       * the index of the light used in the tile light lists.
+       */
+      size_t AddLight (const csVector3& center, float radius);
+      /// Number of lights added
+      size_t GetLightCount () const { return numLights; }
+
+      /**
+       * Sort the lights into the tiles. If a job queue is given the tiles
+       * are processed in parallel on it.
+       */
+      void Cull (iJobQueue* queue = 0);
+
+      /// Number of tile columns
+      uint GetTilesX () const { return tilesX; }
+      /// Number of tile rows
+      uint GetTilesY () const { return tilesY; }
+      /// Number of tiles
+      size_t GetTileCount () const { return size_t (tilesX) * tilesY; }
+      /// Get the bounds of a tile in normalized device coordinates
+      void GetTileBounds (size_t tile, csVector2& min, csVector2& max) const;
+
+      /// Number of lights in a tile
+      size_t GetTileLightCount (size_t tile) const
+      { return tileOffsets[tile + 1] - tileOffsets[tile]; }
+      /// Indices of the lights in a tile, in ascending order
+      const uint* GetTileLights (size_t tile) const
+      { return lightList.GetArray () + tileOffsets[tile]; }
+      /**
+       * Light lists of all tiles, packed one after the other. The list of
+       * tile \c t starts at GetTileOffsets()[t] and ends before
+       * GetTileOffsets()[t+1].
+       */
+      const uint* GetLightList () const { return lightList.GetArray (); }
+      /// Start of each tile's list in GetLightList(), plus the total size
+      const uint* GetTileOffsets () const { return tileOffsets.GetArray (); }
+
+      /// Number of tiles a light is in
+      size_t GetLightTileCount (size_t light) const
+      { return lightTileOffsets[light + 1] - lightTileOffsets[light]; }
+      /// Indices of the tiles a light is in, in ascending order
+      const uint* GetLightTiles (size_t light) const
+      { return lightTiles.GetArray () + lightTileOffsets[light]; }
+
+      /// Get the class of a tile with the given number of lights
+      static uint GetTileClass (size_t numLights);
+
+      /**
+       * Test a single light against a single tile, without any of the
+       * acceleration used by Cull().
+       */
+      bool TestLightTile (size_t light, size_t tile) const;
+
+      /// Get the statistics of the last Cull()
+      const Statistics& GetStatistics () const { return stats; }
+    private:
+      uint tileSize;
+      int width, height;
+      uint tilesX, tilesY;
+
+      /* Planes bounding the tile columns and rows: column c lies between
+         planes 2c and 2c+1 of colPlanes, similar for the rows. All planes
+         face inwards and are normalized. */
+      csDirtyAccessArray<csPlane3> colPlanes;
+      csDirtyAccessArray<csPlane3> rowPlanes;
+      /* Plane through the eye, facing the view direction; the near plane
+         for orthographic projections */
+      csPlane3 eyePlane;
+
+      // Light spheres, as separate arrays for the SIMD tests
+      size_t numLights;
+      csDirtyAccessArray<float> lightX, lightY, lightZ, lightR;
+
+      // Bit masks of the lights in each column and row
+      size_t maskWords;
+      csDirtyAccessArray<uint32> visibleMask;
+      csDirtyAccessArray<uint32> colMasks;
+      csDirtyAccessArray<uint32> rowMasks;
+
+      // Output
+      csDirtyAccessArray<uint> tileOffsets;
+      csDirtyAccessArray<uint> lightList;
+      csDirtyAccessArray<uint> lightTileOffsets;
+      csDirtyAccessArray<uint> lightTiles;
+
+      Statistics stats;
+
+      static void CullSlabs (void* data, size_t first, size_t num);
+      static void CountTileRows (void* data, size_t first, size_t num);
+      static void FillTileRows (void* data, size_t first, size_t num);
+
+      void TestSlab (const csPlane3& p0, const csPlane3& p1,
+        uint32* mask) const;
+    };
+  } // namespace RenderManager
+} // namespace CS
+
+#endif // __CS_CSPLUGINCOMMON_RENDERMANAGER_LIGHTTILES_H__
@@ -27,6 +27,9 @@
 #include "csplugincommon/rendermanager/rendertree.h"
 #include "csutil/set.h"
 #include "csutil/compositefunctor.h"
+#include "csutil/dirtyaccessarray.h"
+
+struct iJobQueue;
 
 namespace CS
 {
@@ -113,6 +116,18 @@ namespace RenderManager
       csSet<IterationObject>& objectSet;
     };
 
+    /// Function calling an operation on \a num collected objects from \a first
+    typedef void (*OperationRangeFunc) (void* data, size_t first, size_t num);
+
+    /**
+     * Call \a func for \a num objects. If a job queue is given and there are
+     * enough objects the range is split into batches which are run on the
+     * queue, the first one on the calling thread. Returns when all objects
+     * were processed.
+     */
+    CS_CRYSTALSPACE_EXPORT void RunOperationParallel (iJobQueue* queue,
+      size_t num, OperationRangeFunc func, void* data);
+
     /**
      * Helper for dispatching the actual function call in ForEach methods below.
      * Split into two-level hierarchy to avoid partial specialization when that is needed     
@@ -145,6 +160,8 @@ namespace RenderManager
             function (context);
         }
 
+        void Finish (iJobQueue*) {}
+
         Fn& function;
         OperationBlock block;
       };
@@ -167,6 +184,8 @@ namespace RenderManager
           index++;
         }
 
+        void Finish (iJobQueue*) {}
+
         Fn& function;
         OperationBlock block;
         size_t index;
@@ -191,6 +210,8 @@ namespace RenderManager
             function (context);
         }
 
+        void Finish (iJobQueue*) {}
+
         Fn& function;
         OperationBlock block;
       };
@@ -213,6 +234,8 @@ namespace RenderManager
           index++;
         }
 
+        void Finish (iJobQueue*) {}
+
         Fn& function;
         OperationBlock block;
         size_t index;
@@ -254,6 +277,8 @@ namespace RenderManager
           function (context);
       }
 
+      void Finish (iJobQueue*) {}
+
       Fn& function;
       OperationBlock block;
     };
@@ -276,53 +301,106 @@ namespace RenderManager
         index++;
       }
 
+      void Finish (iJobQueue*) {}
+
       Fn& function;
       OperationBlock block;
       size_t index;
     };
 
     /**
-     * Executor for unordered calls
+     * Executor for unordered parallel calls.
+     * Objects are only collected; the function is called on them in Finish(),
+     * split into batches run on a job queue. The function must be safe to
+     * call on different objects from multiple threads at the same time.
      */
     template<typename Fn, typename OperationBlock>
     struct OperationCaller<Fn, OperationBlock, OperationUnorderedParallel>
     {
       OperationCaller (Fn& fn, OperationBlock& block)
-        : function (fn), block (block)
+        : function (fn), block (block), callRange (0)
       {}
 
       template<typename ObjectType>
       void operator() (const ObjectType& context)
       {
         if (!block (context))
-          function (context);
+        {
+          objects.Push (context);
+          callRange = &CallRange<ObjectType>;
+        }
+      }
+
+      /// Call the function on all collected objects
+      void Finish (iJobQueue* queue)
+      {
+        if (objects.GetSize () == 0) return;
+        RunOperationParallel (queue, objects.GetSize (), callRange, this);
+        objects.Empty ();
+      }
+
+      template<typename ObjectType>
+      static void CallRange (void* data, size_t first, size_t num)
+      {
+        OperationCaller* caller = static_cast<OperationCaller*> (data);
+        for (size_t i = first; i < first + num; i++)
+          caller->function (static_cast<ObjectType> (caller->objects[i]));
       }
 
       Fn& function;
       OperationBlock block;
+      csDirtyAccessArray<void*> objects;
+      OperationRangeFunc callRange;
     };
 
     /**
-     * Executor for numbered calls
+     * Executor for numbered parallel calls.
+     * Like the unordered parallel executor, but each object is passed the
+     * number it would have gotten in a sequential run.
      */
     template<typename Fn, typename OperationBlock>
     struct OperationCaller<Fn, OperationBlock, OperationNumberedParallel>
     {
       OperationCaller (Fn& fn, OperationBlock& block)
-        : function (fn), block (block), index (0)
+        : function (fn), block (block), index (0), callRange (0)
       {}
 
       template<typename ObjectType>
       void operator() (const ObjectType& context)
       {          
         if (!block (context))
-          function (index, context);
+        {
+          objects.Push (context);
+          indices.Push (index);
+          callRange = &CallRange<ObjectType>;
+        }
         index++;
       }
 
+      /// Call the function on all collected objects
+      void Finish (iJobQueue* queue)
+      {
+        if (objects.GetSize () == 0) return;
+        RunOperationParallel (queue, objects.GetSize (), callRange, this);
+        objects.Empty ();
+        indices.Empty ();
+      }
+
+      template<typename ObjectType>
+      static void CallRange (void* data, size_t first, size_t num)
+      {
+        OperationCaller* caller = static_cast<OperationCaller*> (data);
+        for (size_t i = first; i < first + num; i++)
+          caller->function (caller->indices[i],
+            static_cast<ObjectType> (caller->objects[i]));
+      }
+
       Fn& function;
       OperationBlock block;
       size_t index;
+      csDirtyAccessArray<void*> objects;
+      csDirtyAccessArray<size_t> indices;
+      OperationRangeFunc callRange;
     };
 
 #endif
@@ -447,6 +525,8 @@ namespace RenderManager
 
       caller (context);
     }
+
+    caller.Finish (tree.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -473,6 +553,8 @@ namespace RenderManager
 
       caller (context);
     }
+
+    caller.Finish (tree.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -500,6 +582,8 @@ namespace RenderManager
 
       caller (context);
     }
+
+    caller.Finish (tree.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -526,6 +610,8 @@ namespace RenderManager
 
       caller (context);
     }
+
+    caller.Finish (tree.GetPersistentData ().operationQueue);
   }
 
   //@}
@@ -555,6 +641,8 @@ namespace RenderManager
 
       caller (node);
     }
+
+    caller.Finish (context.owner.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -580,6 +668,8 @@ namespace RenderManager
 
       caller (node);
     }
+
+    caller.Finish (context.owner.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -606,6 +696,8 @@ namespace RenderManager
 
       caller (node);
     }
+
+    caller.Finish (context.owner.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -631,6 +723,8 @@ namespace RenderManager
 
       caller (node);
     }
+
+    caller.Finish (context.owner.GetPersistentData ().operationQueue);
   }
 
   namespace Implementation
@@ -28,6 +28,7 @@
 #include "csplugincommon/rendermanager/rendertree.h"
 #include "csplugincommon/rendermanager/svarrayholder.h"
 #include "csplugincommon/rendermanager/occluvis.h"
+#include "csplugincommon/render3d/recordinggraphics3d.h"
 
 #include "ivideo/graph2d.h"
 #include "iengine/sector.h"
@@ -118,9 +119,39 @@ namespace RenderManager
     iGraphics3D* g3d;
     iShaderManager* shaderMgr;
     size_t currentLayer;
+    /**
+     * Set if \a g3d records its commands. Shader passes are then applied
+     * when the commands are replayed.
+     */
+    csRef<iGraphics3DRecorder> recorder;
 
     RenderCommon (iGraphics3D* g3d, iShaderManager* shaderMgr)
-     : g3d (g3d), shaderMgr (shaderMgr), currentLayer (0) {}
+     : g3d (g3d), shaderMgr (shaderMgr), currentLayer (0),
+       recorder (scfQueryInterfaceSafe<iGraphics3DRecorder> (g3d)) {}
+
+    void RenderMeshesRecorded (typename RenderTree::ContextNode& context, 
+		               const typename RenderTree::MeshNode::MeshArrayType& meshes,
+		               iShader* shader, size_t ticket,
+		               size_t firstMesh, size_t lastMesh,
+		               csShaderVariableStack& svStack)
+    {
+      const size_t numPasses = shader->GetNumberOfPasses (ticket);
+
+      for (size_t p = 0; p < numPasses; ++p)
+      {
+        recorder->ActivatePass (shader, ticket, p);
+
+        for (size_t m = firstMesh; m < lastMesh; ++m)
+        {
+          const typename RenderTree::MeshNode::SingleMesh& mesh = meshes.Get (m);
+          context.svArrays.SetupSVStack (svStack, currentLayer, mesh.contextLocalId);
+
+          recorder->DrawMeshPass (shader, ticket, mesh.renderMesh,
+            *mesh.renderMesh, mesh.zmode, svStack);
+        }
+        recorder->DeactivatePass (shader, ticket);
+      }
+    }
 
     void RenderMeshes (typename RenderTree::ContextNode& context, 
 		       const typename RenderTree::MeshNode::MeshArrayType& meshes,
@@ -136,6 +167,13 @@ namespace RenderManager
 
       csShaderVariableStack& svStack = shaderMgr->GetShaderVariableStack ();
 
+      if (recorder)
+      {
+        RenderMeshesRecorded (context, meshes, shader, ticket, firstMesh,
+          lastMesh, svStack);
+        return;
+      }
+
       const size_t numPasses = shader->GetNumberOfPasses (ticket);
 
       for (size_t p = 0; p < numPasses; ++p)
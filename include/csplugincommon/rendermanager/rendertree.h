@@ -24,8 +24,13 @@
  */
 
 #include "iengine/camera.h"
+#include "iutil/job.h"
+#include "iutil/objreg.h"
+#include "ivaria/reporter.h"
+#include "csgfx/shadervarslotmap.h"
 #include "csplugincommon/rendermanager/standardtreetraits.h"
 #include "csutil/dirtyaccessarray.h"
+#include "csutil/framearena.h"
 #include "csutil/metautils.h"
 #include "csutil/redblacktree.h"
 #include "cstool/rendermeshholder.h"
@@ -38,6 +43,12 @@ namespace CS
 namespace RenderManager
 {
   class PostEffectManager;
+
+  /**
+   * Allocator for arrays of the render tree that only live for a frame.
+   * The memory is taken from the frame arena in RenderTree::PersistentData.
+   */
+  typedef CS::Memory::AllocatorFrameArena TreeArrayAllocator;
   
   /**
    * Helper class containing stuff which doesn't require any of the template
@@ -239,7 +250,8 @@ namespace RenderManager
     typedef csRedBlackTreeMap<typename TreeTraitsType::MeshNodeKeyType, MeshNode*,
       MeshNodeTreeBlockRefAlloc> MeshNodeTreeType;
     typedef typename MeshNodeTreeType::Iterator MeshNodeTreeIteratorType;
-    typedef csArray<ContextNode*> ContextNodeArrayType;
+    typedef csArray<ContextNode*, csArrayElementHandler<ContextNode*>,
+      TreeArrayAllocator> ContextNodeArrayType;
     typedef typename ContextNodeArrayType::Iterator ContextNodeArrayIteratorType;
     typedef typename ContextNodeArrayType::ReverseIterator ContextNodeArrayReverseIteratorType;
 
@@ -259,6 +271,16 @@ namespace RenderManager
        */
       void Initialize (iShaderManager* shmgr)
       {
+        Initialize (0, shmgr);
+      }
+
+      /**
+       * Initialize data. Also makes the statistics enabled with the
+       * "stats.framearena" debug flag get reported to \a objectReg.
+       */
+      void Initialize (iObjectRegistry* objectReg, iShaderManager* shmgr)
+      {
+        this->objectReg = objectReg;
         svObjectToWorldName = 
           shmgr->GetSVNameStringset()->Request ("object2world transform");
         svObjectToWorldInvName = 
@@ -267,6 +289,29 @@ namespace RenderManager
           shmgr->GetSVNameStringset()->Request ("fogplane");
           
         dbgDebugClearScreen = debugPersist.RegisterDebugFlag ("debugclear");
+        dbgFrameArenaStats = debugPersist.RegisterDebugFlag ("stats.framearena");
+      }
+
+      /**
+       * Do per-frame house keeping - \b MUST be called every frame/
+       * RenderView() execution, before the render tree is created.
+       * Releases the memory of the last frame from the frame arena.
+       */
+      void UpdateNewFrame ()
+      {
+        frameArena.NewFrame ();
+        if (debugPersist.IsDebugFlagEnabled (dbgFrameArenaStats))
+        {
+          const CS::Memory::FrameArena::Statistics& frameStats =
+            frameArena.GetStatistics ();
+          arenaStats.allocations += frameStats.allocations;
+          arenaStats.mallocs += frameStats.mallocs;
+          arenaStats.used += frameStats.used;
+          if (++arenaStats.frames >= arenaStatsReportFrames)
+            ReportArenaStatistics ();
+        }
+        else if (arenaStats.frames > 0)
+          arenaStats = ArenaStatistics ();
       }
 
       void Clear ()
@@ -289,6 +334,64 @@ namespace RenderManager
       
       DebugPersistent debugPersist;
       uint dbgDebugClearScreen;
+      uint dbgFrameArenaStats;
+
+      /**
+       * Arena for the transient data of a frame, like the arrays in the
+       * context and mesh nodes. Reset by UpdateNewFrame().
+       */
+      CS::Memory::FrameArena frameArena;
+
+      /**
+       * Slots of the shader variables set on the stacks of the contexts.
+       * Shared by all frames, so the SV arrays of a context only need room
+       * for the names actually used.
+       */
+      CS::Graphics::ShaderVarSlotMap svSlotMap;
+
+      /**
+       * Job queue used to run operations declared as parallel (see
+       * OperationTraits). If not set, all operations run on the calling
+       * thread.
+       */
+      csRef<iJobQueue> operationQueue;
+
+      PersistentData () : objectReg (0), dbgDebugClearScreen (0),
+        dbgFrameArenaStats (0) {}
+    protected:
+      iObjectRegistry* objectReg;
+
+      // frame arena statistics, summed over frames while enabled
+      struct ArenaStatistics
+      {
+        uint frames;
+        uint64 allocations;
+        uint64 mallocs;
+        uint64 used;
+
+        ArenaStatistics () : frames (0), allocations (0), mallocs (0),
+          used (0) {}
+      };
+      ArenaStatistics arenaStats;
+      static const uint arenaStatsReportFrames = 100;
+
+      // Report the gathered statistics and start over
+      void ReportArenaStatistics ()
+      {
+        const CS::Memory::FrameArena::Statistics& frameStats =
+          frameArena.GetStatistics ();
+        const float frames = (float)arenaStats.frames;
+        csReport (objectReg, CS_REPORTER_SEVERITY_NOTIFY,
+          "crystalspace.rendermanager.rendertree",
+          "frame arena: %u frames, %.1f allocations/frame, "
+          "%.2f mallocs/frame, %.1f KB/frame, high water %.1f KB, "
+          "reserved %.1f KB in %u threads",
+          arenaStats.frames, arenaStats.allocations / frames,
+          arenaStats.mallocs / frames, arenaStats.used / (1024.0f * frames),
+          frameStats.highWater / 1024.0f, frameStats.reserved / 1024.0f,
+          frameStats.threads);
+        arenaStats = ArenaStatistics ();
+      }
     };
 
     /**
@@ -342,7 +445,8 @@ namespace RenderManager
       typedef typename TreeType::ContextNode ContextNodeType;
 
       //-- Some local types
-      typedef csArray<SingleMesh> MeshArrayType;
+      typedef csArray<SingleMesh, csArrayElementHandler<SingleMesh>,
+        TreeArrayAllocator> MeshArrayType;
       typedef typename MeshArrayType::Iterator MeshArrayIteratorType;
 
       /// Owner
@@ -358,7 +462,10 @@ namespace RenderManager
       MeshArrayType meshes;
 
       MeshNode (ContextNode& owner)
-        : owner (&owner)
+        : meshes (0, TreeArrayAllocator (
+            &owner.owner.GetPersistentData ().frameArena),
+            CS::Container::ArrayCapacityDefault ()),
+          owner (&owner)
       {}
     protected:
       ContextNode* owner;
@@ -434,15 +541,18 @@ namespace RenderManager
       MeshNodeTreeType meshNodes;
 
       /// All portals within context
-      csArray<PortalHolder> allPortals;
+      csArray<PortalHolder, csArrayElementHandler<PortalHolder>,
+        TreeArrayAllocator> allPortals;
 
       /// The SVs themselves
       SVArrayHolder svArrays;
 
       /// Arrays of per-mesh shader
-      csDirtyAccessArray<iShader*> shaderArray;
+      csDirtyAccessArray<iShader*, csArrayElementHandler<iShader*>,
+        TreeArrayAllocator> shaderArray;
       /// Arrays of per-mesh ticket info
-      csArray<size_t> ticketArray;
+      csArray<size_t, csArrayElementHandler<size_t>,
+        TreeArrayAllocator> ticketArray;
 
       /// Total number of render meshes within the context
       size_t totalRenderMeshes;
@@ -451,9 +561,23 @@ namespace RenderManager
         : owner (owner), drawFlags (0),
 	  renderGrouping (CS::rpgByLayer),
           meshNodes (MeshNodeTreeBlockRefAlloc (meshNodeAlloc)),
+          allPortals (0, GetArrayAllocator (owner),
+            CS::Container::ArrayCapacityDefault ()),
+          shaderArray (0, GetArrayAllocator (owner),
+            CS::Container::ArrayCapacityDefault ()),
+          ticketArray (0, GetArrayAllocator (owner),
+            CS::Container::ArrayCapacityDefault ()),
           totalRenderMeshes (0) 
-      {}
+      {
+        svArrays.SetFrameArena (&owner.GetPersistentData ().frameArena);
+      }
       
+    private:
+      static TreeArrayAllocator GetArrayAllocator (TreeType& owner)
+      {
+        return TreeArrayAllocator (&owner.GetPersistentData ().frameArena);
+      }
+    public:
       /**
        * Add a rendermesh to context, putting it in the right meshnode etc.
        */
@@ -569,7 +693,9 @@ namespace RenderManager
 
     //---- Methods
     RenderTree (PersistentData& dataStorage)
-      : RenderTreeBase (dataStorage.debugPersist), persistentData (dataStorage)
+      : RenderTreeBase (dataStorage.debugPersist), persistentData (dataStorage),
+        contexts (0, TreeArrayAllocator (&dataStorage.frameArena),
+          CS::Container::ArrayCapacityDefault ())
     {
     }
 
@@ -34,8 +34,10 @@ namespace CS
 namespace RenderManager
 {
 
-  typedef csArray<size_t> TicketArrayType;
-  typedef csArray<iShader*> ShaderArrayType;
+  typedef csArray<size_t, csArrayElementHandler<size_t>,
+    TreeArrayAllocator> TicketArrayType;
+  typedef csArray<iShader*, csArrayElementHandler<iShader*>,
+    TreeArrayAllocator> ShaderArrayType;
 
   /**
    * Default shader setup functor.
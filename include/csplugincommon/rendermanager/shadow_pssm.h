@@ -27,6 +27,8 @@
 #include "ivideo/shader/shader.h"
 
 #include "csutil/cfgacc.h"
+#include "csutil/sysfunc.h"
+#include "ivaria/reporter.h"
 
 #include "cstool/meshfilter.h"
 
@@ -436,6 +438,38 @@ namespace RenderManager
         settings.AdvanceFrame(time);
         lightVarsPersist.UpdateNewFrame();
 	portalPersist.UpdateNewFrame();
+
+	// statistics are gathered while the debug flag is set
+	if(dbgPersist && dbgPersist->IsDebugFlagEnabled(dbgStats))
+	{
+	  if(stats.frames >= statsReportFrames)
+	    ReportStatistics();
+	  ++stats.frames;
+	}
+	else if(stats.frames > 0)
+	{
+	  stats = Statistics();
+	}
+      }
+
+      // Report the gathered statistics and start over
+      void ReportStatistics()
+      {
+	const float frames = (float)stats.frames;
+	csString splitTimes;
+	for(size_t s = 0; s < stats.sliceTime.GetSize(); ++s)
+	{
+	  splitTimes.AppendFmt(" %.3f", stats.sliceTime[s] / (1000.0f * frames));
+	}
+
+	csReport(objectReg, CS_REPORTER_SEVERITY_NOTIFY,
+	  "crystalspace.rendermanager.shadow.pssm",
+	  "Per frame over %u frames: %.1f static and %.1f dynamic casters, "
+	  "%.3f ms collecting casters, per split ms:%s",
+	  stats.frames, stats.staticCasters / frames, stats.dynamicCasters / frames,
+	  stats.castersTime / (1000.0f * frames), splitTimes.GetDataSafe());
+
+	stats = Statistics();
       }
 
       // Set the prefix for configuration settings
@@ -447,6 +481,9 @@ namespace RenderManager
       // Called upon plugin initialization
       void Initialize(iObjectRegistry* objectReg, RenderTreeBase::DebugPersistent& dbgPersist)
       {
+	this->objectReg = objectReg;
+	this->dbgPersist = &dbgPersist;
+
 	// get shader manager and graphics3d handles
 	graphics3D = csQueryRegistry<iGraphics3D>(objectReg);
 	shaderManager = csQueryRegistry<iShaderManager>(objectReg);
@@ -490,6 +527,7 @@ namespace RenderManager
 	  // read debug settings
 	  dbgSplit = dbgPersist.RegisterDebugFlag("draw.pssm.split.frustum");
 	  dbgShadowTex = dbgPersist.RegisterDebugFlag("textures.shadow");
+	  dbgStats = dbgPersist.RegisterDebugFlag("stats.pssm");
 	}
 
 	// create and initalize empty SMs
@@ -619,10 +657,32 @@ namespace RenderManager
       // debug settings
       uint dbgSplit;
       uint dbgShadowTex;
+      uint dbgStats;
+
+      // statistics gathered while dbgStats is enabled, summed over frames
+      struct Statistics
+      {
+	uint frames;
+	// casters reused from the cache
+	uint staticCasters;
+	// casters collected again because they moved
+	uint dynamicCasters;
+	// time spent collecting casters
+	csMicroTicks castersTime;
+	// time spent setting up each split
+	csArray<csMicroTicks> sliceTime;
+
+	Statistics() : frames(0), staticCasters(0), dynamicCasters(0), castersTime(0) {}
+      };
+      Statistics stats;
+      // number of frames statistics are reported for
+      static const uint statsReportFrames = 100;
 
       // runtime data
 
       // object refs
+      iObjectRegistry* objectReg;
+      RenderTreeBase::DebugPersistent* dbgPersist;
       csRef<iShaderManager> shaderManager;
       csRef<iGraphics3D> graphics3D;
 
@@ -778,6 +838,33 @@ namespace RenderManager
 	csArray<Slice> slices;
       };
 
+      // cached data for a mesh found in a frustum
+      struct CachedCaster
+      {
+	// world space bounding box the data was computed with
+	csBox3 boxWorld;
+
+	// frame at which the mesh was last found in the frustum
+	uint seenFrame;
+
+	// bounding box of the mesh in projection space
+	csBox3 boxPS;
+
+	// whether the mesh casts shadows
+	bool casting;
+
+	// whether the mesh was added to the filter
+	bool filtered;
+
+	// whether the mesh changed since it was first found - dynamic casters
+	// are collected every frame, static ones are kept in the cache
+	bool dynamic;
+      };
+
+      typedef csHash<CachedCaster, csWeakRef<iMeshWrapper>, CS::Memory::AllocatorMalloc,
+	csArraySafeCopyElementHandler<CS::Container::HashElement<CachedCaster,
+	  csWeakRef<iMeshWrapper> > > > CasterHash;
+
       // structure that represents a view frustum for our light
       // for point lights we have 6 of those, else just 1
       struct Frustum
@@ -800,6 +887,28 @@ namespace RenderManager
 
 	// hash with the slice arrays for various views
 	csHash<Slices, csWeakRef<CS::RenderManager::RenderView> > slicesHash;
+
+	// caster cache - only valid for the light transform and frustum box
+	// above, so it's thrown away together with the light data when the
+	// light moves
+
+	// all meshes found in this frustum, static and dynamic
+	CasterHash casters;
+
+	// sector the cache was built for
+	csWeakRef<iSector> castersSector;
+
+	// bounding box of static casters in projection space
+	csBox3 staticCastersPS;
+
+	// number of static meshes and static casters in the cache
+	size_t numStatic;
+	size_t numStaticCasters;
+
+	// dynamic meshes added to the filter this frame
+	csArray<csWeakRef<iMeshWrapper> > dynamicFiltered;
+
+	Frustum() : numStatic(0), numStaticCasters(0) {}
       };
 
       // actual light data
@@ -984,6 +1093,9 @@ namespace RenderManager
 	// get current frame
 	uint currentFrame = rview->GetCurrentFrameNumber();
 
+	// check whether to gather statistics
+	bool gatherStats = renderTree.IsDebugFlagEnabled(persist.dbgStats);
+
 	// go over all lights and get the frustums
 	typename PersistentData::LightHash::GlobalIterator it = persist.lightHash.GetIterator();
 	while(it.HasNext())
@@ -1029,7 +1141,10 @@ namespace RenderManager
 	      frustum.setupFrame = currentFrame;
 
 	      // update casters bounding box and filter
+	      csMicroTicks start = gatherStats ? csGetMicroTicks() : 0;
 	      SetupFrustum(lightData, frustum);
+	      if(gatherStats)
+		persist.stats.castersTime += csGetMicroTicks() - start;
 	    }
 
 	    // @@@TODO: could we use cubemaps for point lights?
@@ -1045,7 +1160,15 @@ namespace RenderManager
 		continue;
 
 	      // set up SVs and create the target
+	      csMicroTicks start = gatherStats ? csGetMicroTicks() : 0;
 	      SetupTarget(light, lightData, frustum, slice, persist.doFixedCloseShadow && s == 0);
+	      if(gatherStats)
+	      {
+		csArray<csMicroTicks>& sliceTime = persist.stats.sliceTime;
+		if(sliceTime.GetSize() <= s)
+		  sliceTime.SetSize(s + 1, 0);
+		sliceTime[s] += csGetMicroTicks() - start;
+	      }
 
 	      // set clipping range
 	      slice.clipSV->SetValue(csVector2(persist.splitDists[s], persist.splitDists[s+1]));
@@ -1057,11 +1180,43 @@ namespace RenderManager
     protected:
       void SetupFrustum(LightData& lightData, typename LightData::Frustum& frustum)
       {
-	// clear casters box
-	frustum.castersPS.StartBoundingBox();
+	typedef typename LightData::CachedCaster CachedCaster;
+	typedef typename LightData::CasterHash CasterHash;
+
+	// get current frame
+	uint currentFrame = rview->GetCurrentFrameNumber();
+
+	// a different sector sees different meshes - start over
+	if(frustum.castersSector != sector)
+	{
+	  frustum.casters.DeleteAll();
+	  frustum.meshFilter.Clear();
+	  frustum.dynamicFiltered.Empty();
+	  frustum.staticCastersPS.StartBoundingBox();
+	  frustum.numStatic = 0;
+	  frustum.numStaticCasters = 0;
+	  frustum.castersSector = sector;
+	}
+
+	// dynamic meshes are filtered again below if they still need to be
+	for(size_t i = 0; i < frustum.dynamicFiltered.GetSize(); ++i)
+	{
+	  if(frustum.dynamicFiltered[i].IsValid())
+	    frustum.meshFilter.RemoveFilterMesh(frustum.dynamicFiltered[i]);
+	}
+	frustum.dynamicFiltered.Empty();
 
-	// clear filter
-	frustum.meshFilter.Clear();
+	// bounding box of the dynamic casters
+	csBox3 dynamicCastersPS;
+	dynamicCastersPS.StartBoundingBox();
+
+	// whether static casters moved or left the frustum, so their box
+	// needs to be rebuilt
+	bool rebuildStatic = false;
+
+	size_t numStaticSeen = 0;
+	size_t numDynamic = 0;
+	size_t numDynamicCasters = 0;
 
 	// get all meshes in the frustum box
 	iVisibilityCuller* culler = sector->GetVisibilityCuller();
@@ -1089,21 +1244,131 @@ namespace RenderManager
 	  // check whether we want this mesh filtered:
 	  //   for limited casting casters are included
 	  //   for normal casting non-casters are excluded
-	  if(casting ^ !persist.limitedShadow)
+	  bool filtered = casting ^ !persist.limitedShadow;
+
+	  // world space box - changes whenever the mesh moves or animates
+	  const csBox3& boxWorld = object->GetBBox();
+
+	  // check whether we already know this mesh
+	  CachedCaster* cached = frustum.casters.GetElementPointer(meshWrapper);
+	  if(cached && !cached->dynamic)
+	  {
+	    if(cached->boxWorld == boxWorld && cached->casting == casting)
+	    {
+	      // unchanged static mesh - its box and filter entry are still valid
+	      cached->seenFrame = currentFrame;
+	      ++numStaticSeen;
+	      continue;
+	    }
+
+	    // the mesh changed, so from now on treat it as dynamic
+	    if(cached->filtered)
+	      frustum.meshFilter.RemoveFilterMesh(meshWrapper);
+	    cached->dynamic = true;
+	    --frustum.numStatic;
+	    if(cached->casting)
+	    {
+	      --frustum.numStaticCasters;
+	      rebuildStatic = true;
+	    }
+	  }
+
+	  if(!cached)
+	  {
+	    // new mesh - assume it's static until it moves
+	    CachedCaster newCaster;
+	    newCaster.dynamic = false;
+	    cached = &frustum.casters.Put(meshWrapper, newCaster);
+	    ++frustum.numStatic;
+	    ++numStaticSeen;
+	  }
+
+	  cached->boxWorld = boxWorld;
+	  cached->seenFrame = currentFrame;
+	  cached->casting = casting;
+	  cached->filtered = filtered;
+
+	  if(cached->dynamic)
+	    ++numDynamic;
+
+	  if(filtered)
 	  {
 	    frustum.meshFilter.AddFilterMesh(meshWrapper);
+	    if(cached->dynamic)
+	      frustum.dynamicFiltered.Push(meshWrapper);
 	  }
 
 	  // if this mesh is a caster add it's bounding box to the caster box
 	  if(casting)
 	  {
 	    // project bounding box
-	    csBox3 meshBoxPS(ProjectBox(frust2world * object->GetBBox(), lightData.project, lightData.projectInverse));
+	    cached->boxPS = ProjectBox(frust2world * boxWorld, lightData.project, lightData.projectInverse);
+
+	    if(cached->dynamic)
+	    {
+	      dynamicCastersPS += cached->boxPS;
+	      ++numDynamicCasters;
+	    }
+	    else
+	    {
+	      // new static caster, grow static box
+	      frustum.staticCastersPS += cached->boxPS;
+	      ++frustum.numStaticCasters;
+	    }
+	  }
+	}
+
+	// drop meshes that left the frustum (or were removed)
+	if(numStaticSeen + numDynamic != frustum.casters.GetSize())
+	{
+	  typename CasterHash::GlobalIterator it = frustum.casters.GetIterator();
+	  while(it.HasNext())
+	  {
+	    csWeakRef<iMeshWrapper> mesh;
+	    CachedCaster& cached = it.NextNoAdvance(mesh);
+	    if(cached.seenFrame == currentFrame)
+	    {
+	      it.Advance();
+	      continue;
+	    }
+
+	    if(!cached.dynamic)
+	    {
+	      if(cached.filtered && mesh.IsValid())
+		frustum.meshFilter.RemoveFilterMesh(mesh);
+	      --frustum.numStatic;
+	      if(cached.casting)
+	      {
+		--frustum.numStaticCasters;
+		rebuildStatic = true;
+	      }
+	    }
+	    frustum.casters.DeleteElement(it);
+	  }
+	}
 
-	    // add box to casters bounding box
-	    frustum.castersPS += meshBoxPS;
+	// rebuild static casters box from the cache if casters left it
+	if(rebuildStatic)
+	{
+	  frustum.staticCastersPS.StartBoundingBox();
+	  typename CasterHash::GlobalIterator it = frustum.casters.GetIterator();
+	  while(it.HasNext())
+	  {
+	    const CachedCaster& cached = it.Next();
+	    if(!cached.dynamic && cached.casting)
+	      frustum.staticCastersPS += cached.boxPS;
 	  }
 	}
+
+	// casters box is made up of static and dynamic casters
+	frustum.castersPS = frustum.staticCastersPS;
+	frustum.castersPS += dynamicCastersPS;
+
+	if(renderTree.IsDebugFlagEnabled(persist.dbgStats))
+	{
+	  persist.stats.staticCasters += (uint)frustum.numStaticCasters;
+	  persist.stats.dynamicCasters += (uint)numDynamicCasters;
+	}
       }
 
       void SetupTarget(iLight* light, LightData& lightData, typename LightData::Frustum& frustum, typename LightData::Slice& slice, bool fixed)
@@ -1509,8 +1774,8 @@ namespace RenderManager
 	svHelper.MergeAsArrayItem(lightStacks[index], slice.unscaleSV, l);
 	svHelper.MergeAsArrayItem(lightStacks[index], slice.dimSV, l);
 	// @@@TODO: why this if?
-	if(lightStacks[index].GetSize() > slice.clipSV->GetName())
-	  lightStacks[index][slice.clipSV->GetName()] = slice.clipSV;
+	if(lightStacks[index].GetSlotMap() || (lightStacks[index].GetSize() > slice.clipSV->GetName()))
+	  lightStacks[index].Set(slice.clipSV->GetName(), slice.clipSV);
 
 	const ShadowSettings::TargetArray& targets = persist.settings.targets;
 	for(size_t t = 0; t < targets.GetSize(); ++t)
@@ -58,13 +58,15 @@ namespace RenderManager
     StandardMeshSorter (iEngine* engine)
       : engine (engine), cameraOrigin (0,0,0)
     {
-      // Build table of sorting options
+      /* Build table of sorting options. Filled up front so sorting mesh
+       * nodes doesn't modify any shared state and can be done in parallel. */
       renderPriorityCount = uint (engine->GetRenderPriorityCount ());
       sortingTypeTable = new int[renderPriorityCount];
       
       for (uint i = 0; i < renderPriorityCount; ++i)
       {       
-        sortingTypeTable[i] = -1;
+        sortingTypeTable[i] = engine->GetRenderPrioritySorting (
+          CS::Graphics::RenderPriority (i));
       }      
     }
 
@@ -180,15 +182,10 @@ namespace RenderManager
       const float scaleFactor;
     };
   
-    csRenderPrioritySorting GetSorting (CS::Graphics::RenderPriority renderPrio)
+    csRenderPrioritySorting GetSorting (CS::Graphics::RenderPriority renderPrio) const
     {
       CS_ASSERT(renderPrio.IsValid() && renderPrio < renderPriorityCount);
 
-      if (sortingTypeTable[renderPrio] < 0)
-      {
-        sortingTypeTable[renderPrio] = engine->GetRenderPrioritySorting (renderPrio);
-      }
-
       return (csRenderPrioritySorting)sortingTypeTable[renderPrio];
     }
 
@@ -198,11 +195,11 @@ namespace RenderManager
     csVector3 cameraOrigin;
   };
   
-  /// The sorter is currently non-parallel safe due to how the caching is implemented.
+  /// Each mesh node is sorted independently, so nodes can be sorted in parallel.
   template<typename RenderTree>  
   struct OperationTraits<StandardMeshSorter<RenderTree> >
   {
-    typedef OperationUnordered Ordering;
+    typedef OperationUnorderedParallel Ordering;
   };
 
 }
@@ -22,6 +22,10 @@
 /**\file
  * Holder for shader variable arrays.
  */
+
+#include "csgfx/shadervarslotmap.h"
+#include "csutil/framearena.h"
+
 class csShaderVariable;
 
 namespace CS
@@ -39,6 +43,14 @@ namespace RenderManager
    *
    * The 3d array is flattened into a 1d one and indexed as:
    * index = (layer*numSets + set)*numSVs + SV
+   *
+   * If a frame arena is set with SetFrameArena() the arrays are allocated
+   * from it instead of an own memory pool.
+   *
+   * When set up with a CS::Graphics::ShaderVarSlotMap, each set only holds
+   * the slots given out by the map instead of all SV names, and the stacks
+   * set up with SetupSVStack() use the map. A set grows on its own when a
+   * name gets a slot beyond it.
    */
   class SVArrayHolder
   {
@@ -49,48 +61,58 @@ namespace RenderManager
      */
     SVArrayHolder (size_t numLayers = 1, size_t numSVNames = 0, size_t numSets = 0)
       : numLayers (numLayers), numSVNames (numSVNames), numSets (numSets), svArray (0),
-        memAllocSetUp (false)
+        slotMap (0), frameArena (0), memAllocSetUp (false)
     {
       if (numSVNames && numSets && numLayers)
         Setup (numLayers, numSVNames, numSets);
     }
 
     SVArrayHolder (const SVArrayHolder& other)
-      : svArray (0), memAllocSetUp (false)
+      : svArray (0), slotMap (0), frameArena (0), memAllocSetUp (false)
     {
       *this = other;
     }
 
     ~SVArrayHolder ()
     {
+      FreeSetSlots ();
       if (memAllocSetUp) GetMemAlloc().~csMemoryPool();
     }
 
     SVArrayHolder& operator= (const SVArrayHolder& other)
     {
+      FreeSetSlots ();
+      svArray.Empty ();
       if (memAllocSetUp) GetMemAlloc().~csMemoryPool();
+      memAllocSetUp = false;
 
       numLayers = other.numLayers;
       numSVNames = other.numSVNames;
       numSets = other.numSets;
+      slotMap = other.slotMap;
 
       const size_t sliceSVs = numSVNames*numSets;
       const size_t sliceSize = sizeof(csShaderVariable*)*sliceSVs;
-#include "csutil/custom_new_disable.h"
-      new (&memAlloc) csMemoryPool (sliceSize * 4);
-#include "csutil/custom_new_enable.h"
-      memAllocSetUp = true;
+      SetupMemAlloc (sliceSize);
 
-      csShaderVariable** superSlice = reinterpret_cast<csShaderVariable**> (
-        GetMemAlloc().Alloc (numLayers * sliceSize));
+      csShaderVariable** superSlice = AllocSlices (numLayers * sliceSize);
 
       for (size_t l = 0; l < numLayers; l++)
       {
         csShaderVariable** slice = superSlice + l * sliceSVs;
         svArray.Push (slice);
-        memcpy (slice, other.svArray[l], sliceSize);
+        if (slotMap)
+        {
+          CS::Graphics::ShaderVarSlots* slots = AllocSetSlots (slice);
+          setSlots.Push (slots);
+          for (size_t s = 0; s < numSets; s++)
+            slots[s].CopyFrom (other.setSlots[l][s]);
+        }
+        else
+          memcpy (slice, other.svArray[l], sliceSize);
       }
       svArray.ShrinkBestFit();
+      setSlots.ShrinkBestFit();
 
       return *this;
     }
@@ -101,32 +123,22 @@ namespace RenderManager
      */
     void Setup (size_t numLayers, size_t numSVNames, size_t numSets)
     {
-      this->numLayers = numLayers;
-      this->numSVNames = numSVNames;
-      this->numSets = numSets;
-
-      const size_t sliceSVs = numSVNames*numSets;
-      const size_t sliceSize = sizeof(csShaderVariable*)*sliceSVs;
-#ifndef DOXYGEN_RUN
-#include "csutil/custom_new_disable.h"
-#endif
-      new (&memAlloc) csMemoryPool (sliceSize * 4);
-#ifndef DOXYGEN_RUN
-#include "csutil/custom_new_enable.h"
-#endif
-      memAllocSetUp = true;
-
-      csShaderVariable** superSlice = reinterpret_cast<csShaderVariable**> (
-        GetMemAlloc().Alloc (numLayers * sliceSize));
-      memset (superSlice, 0, numLayers * sliceSize);
-
-      for (size_t l = 0; l < numLayers; l++)
-      {
-        csShaderVariable** slice = superSlice + l * sliceSVs;
-        svArray.Push (slice);
-      }
-      svArray.ShrinkBestFit();
+      slotMap = 0;
+      SetupArrays (numLayers, numSVNames, numSets);
+    }
 
+    /**
+     * Initialize storage for SVs stored in the slots of \a slotMap, given a
+     * number of layers and sets. Each set has room for the slots given out so
+     * far and some more, for names which get a slot while the stacks are set
+     * up; a set only needs to grow if a name gets a slot beyond that.
+     */
+    void Setup (size_t numLayers, CS::Graphics::ShaderVarSlotMap* slotMap,
+      size_t numSets)
+    {
+      this->slotMap = slotMap;
+      const size_t numSlots = slotMap->GetSlotCount ();
+      SetupArrays (numLayers, numSlots + numSlots/4 + 32, numSets);
     }
 
     /**
@@ -138,7 +150,10 @@ namespace RenderManager
       CS_ASSERT (layer < numLayers);
       CS_ASSERT (set < numSets);
 
-      stack.Setup (svArray[layer] + set*numSVNames, numSVNames);
+      if (slotMap)
+        stack.Setup (setSlots[layer][set], slotMap);
+      else
+        stack.Setup (svArray[layer] + set*numSVNames, numSVNames);
     }
 
     /**
@@ -157,6 +172,13 @@ namespace RenderManager
       CS_ASSERT (from < numSets && start < numSets && end < numSets);
       CS_ASSERT (from < start || from > end);
 
+      if (slotMap)
+      {
+        for (size_t i = start; i <= end; ++i)
+          setSlots[layer][i].CopyFrom (setSlots[layer][from]);
+        return;
+      }
+
       for (size_t i = start; i <= end; ++i)
       {
         memcpy (svArray[layer] + i*numSVNames, 
@@ -173,6 +195,13 @@ namespace RenderManager
       if (numLayers == 1)
         return;
 
+      if (slotMap)
+      {
+        for (size_t layer = 1; layer < numLayers; ++layer)
+          CopySetSlots (0, layer);
+        return;
+      }
+
       size_t layerSize = numSets*numSVNames;
 
       for (size_t layer = 1; layer < numLayers; ++layer)
@@ -186,6 +215,12 @@ namespace RenderManager
      */
     void ReplicateLayer (size_t from, size_t to)
     {
+      if (slotMap)
+      {
+        CopySetSlots (from, to);
+        return;
+      }
+
       size_t layerSize = numSets*numSVNames;
 
       memcpy (svArray[to], svArray[from], sizeof(csShaderVariable*)*layerSize);
@@ -198,32 +233,138 @@ namespace RenderManager
     {
       const size_t sliceSize = sizeof(csShaderVariable*)*numSVNames*numSets;
 
-      csShaderVariable** slice = reinterpret_cast<csShaderVariable**> (
-        GetMemAlloc().Alloc (sliceSize));
+      csShaderVariable** slice = AllocSlices (sliceSize);
       svArray.Insert (after+1, slice);
 
-      memcpy (slice, svArray[replicateFrom], sliceSize);
+      if (slotMap)
+      {
+        setSlots.Insert (after+1, AllocSetSlots (slice));
+        CopySetSlots (replicateFrom, after+1);
+      }
+      else
+        memcpy (slice, svArray[replicateFrom], sliceSize);
 
       numLayers++;
     }
 
-    /// Get the number of shader variables stored per layer.
+    /**
+     * Get the number of shader variables stored per layer. With a slot map,
+     * this is the initial number of slots of each set.
+     */
     size_t GetNumSVNames () const
     {
       return numSVNames;
     }
 
+    /// Get the slot map used by the stacks, if any.
+    CS::Graphics::ShaderVarSlotMap* GetSlotMap () const
+    {
+      return slotMap;
+    }
+
     /// Get the number of layers.
     size_t GetNumLayers () const
     {
       return numLayers;
     }
 
+    /**
+     * Set the frame arena to allocate the arrays from. Must be called before
+     * Setup(); the holder must then not be used after the frame ended.
+     */
+    void SetFrameArena (CS::Memory::FrameArena* arena)
+    {
+      frameArena = arena;
+    }
+
   private:
     size_t numLayers;
     size_t numSVNames;
     size_t numSets;
     csArray<csShaderVariable**> svArray;
+    /// With a slot map: the slot storage of the sets, per layer
+    csArray<CS::Graphics::ShaderVarSlots*> setSlots;
+    CS::Graphics::ShaderVarSlotMap* slotMap;
+    CS::Memory::FrameArena* frameArena;
+
+    void SetupArrays (size_t numLayers, size_t numSVNames, size_t numSets)
+    {
+      FreeSetSlots ();
+      svArray.Empty ();
+
+      this->numLayers = numLayers;
+      this->numSVNames = numSVNames;
+      this->numSets = numSets;
+
+      const size_t sliceSVs = numSVNames*numSets;
+      const size_t sliceSize = sizeof(csShaderVariable*)*sliceSVs;
+      SetupMemAlloc (sliceSize);
+
+      csShaderVariable** superSlice = AllocSlices (numLayers * sliceSize);
+      memset (superSlice, 0, numLayers * sliceSize);
+
+      for (size_t l = 0; l < numLayers; l++)
+      {
+        csShaderVariable** slice = superSlice + l * sliceSVs;
+        svArray.Push (slice);
+        if (slotMap) setSlots.Push (AllocSetSlots (slice));
+      }
+      svArray.ShrinkBestFit();
+      setSlots.ShrinkBestFit();
+    }
+
+    /// Set up the slot storage of all sets of a layer on \a slice
+    CS::Graphics::ShaderVarSlots* AllocSetSlots (csShaderVariable** slice)
+    {
+      const size_t size = sizeof (CS::Graphics::ShaderVarSlots) * numSets;
+      void* p = frameArena ? frameArena->Alloc (size)
+        : GetMemAlloc().Alloc (size);
+      CS::Graphics::ShaderVarSlots* slots =
+        reinterpret_cast<CS::Graphics::ShaderVarSlots*> (p);
+      for (size_t s = 0; s < numSets; s++)
+      {
+        slots[s] = CS::Graphics::ShaderVarSlots (slice + s*numSVNames,
+          numSVNames);
+      }
+      return slots;
+    }
+
+    void CopySetSlots (size_t from, size_t to)
+    {
+      for (size_t s = 0; s < numSets; s++)
+        setSlots[to][s].CopyFrom (setSlots[from][s]);
+    }
+
+    /// Free the storage of sets which grew
+    void FreeSetSlots ()
+    {
+      for (size_t l = 0; l < setSlots.GetSize (); l++)
+      {
+        for (size_t s = 0; s < numSets; s++)
+          setSlots[l][s].Free ();
+      }
+      setSlots.Empty ();
+    }
+
+    void SetupMemAlloc (size_t sliceSize)
+    {
+      if (frameArena) return;
+#ifndef DOXYGEN_RUN
+#include "csutil/custom_new_disable.h"
+#endif
+      new (&memAlloc) csMemoryPool (sliceSize * 4);
+#ifndef DOXYGEN_RUN
+#include "csutil/custom_new_enable.h"
+#endif
+      memAllocSetUp = true;
+    }
+
+    csShaderVariable** AllocSlices (size_t size)
+    {
+      void* p = frameArena ? frameArena->Alloc (size)
+        : GetMemAlloc().Alloc (size);
+      return reinterpret_cast<csShaderVariable**> (p);
+    }
 
     csMemoryPool& GetMemAlloc()
     { 
@@ -84,8 +84,8 @@ namespace RenderManager
 
           // Push all contexts here 
           // @@TODO: get more of them        
-          localStack[svO2wName] = mesh.svObjectToWorld;
-          localStack[svO2wIName] = mesh.svObjectToWorldInv;
+          localStack.Set (svO2wName, mesh.svObjectToWorld);
+          localStack.Set (svO2wIName, mesh.svObjectToWorldInv);
           iShaderVariableContext* layerContext =
             layerConfig.GetSVContext (layer);
           if (layerContext) layerContext->PushVariables (localStack);
@@ -105,10 +105,12 @@ namespace RenderManager
     const LayerConfigType& layerConfig;
   };  
 
+  /* Only writes to the node's own SV array slots, through a stack local to
+   * each call, so nodes can be set up in parallel. */
   template<typename RenderTree, typename LayerConfigType>
   struct OperationTraits<StandardSVSetup<RenderTree, LayerConfigType> >
   {
-    typedef OperationUnordered Ordering;
+    typedef OperationUnorderedParallel Ordering;
   };
 
   
@@ -122,15 +124,17 @@ namespace RenderManager
   class ShaderSVSetup
   {
   public:    
-    typedef csArray<iShader*> ShaderArrayType;
-    typedef csArray<size_t> TicketArrayType;
+    typedef csArray<iShader*, csArrayElementHandler<iShader*>,
+      TreeArrayAllocator> ShaderArrayType;
+    typedef csArray<size_t, csArrayElementHandler<size_t>,
+      TreeArrayAllocator> TicketArrayType;
 
     ShaderSVSetup (SVArrayHolder& svArrays, const ShaderArrayType& shaderArray,
       const TicketArrayType& tickets, const LayerConfigType& layerConfig)
       : svArrays (svArrays), shaderArray (shaderArray),
       ticketArray (tickets), layerConfig (layerConfig)
     {
-      tempStack.Setup (svArrays.GetNumSVNames ());
+      tempStack.Setup (svArrays.GetNumSVNames (), svArrays.GetSlotMap ());
     }
 
     void operator() (typename RenderTree::MeshNode* node)
@@ -195,9 +199,12 @@ namespace RenderManager
     if (context.totalRenderMeshes == 0) return;
 
     // Setup SV arrays
+    CS::Graphics::ShaderVarSlotMap& svSlotMap =
+      context.owner.GetPersistentData().svSlotMap;
+    svSlotMap.Reserve (shaderManager->GetSVNameStringset ()->GetSize ());
     context.svArrays.Setup (
       layerConfig.GetLayerCount(), 
-      shaderManager->GetSVNameStringset ()->GetSize (),
+      &svSlotMap,
       context.totalRenderMeshes);
 
     // Push the default stuff
@@ -234,8 +241,8 @@ namespace RenderManager
 	}
 	context.svFogplane->SetValue (fogPlane);
 	
-	svStack[context.owner.GetPersistentData().svFogplaneName]
-	 = context.svFogplane;
+	svStack.Set (context.owner.GetPersistentData().svFogplaneName,
+	  context.svFogplane);
       }
 
       // Replicate
@@ -134,7 +134,9 @@ namespace RenderManager
 	csShaderVariableStack varStack;
 	context.svArrays.SetupSVStack (varStack, layer, mesh.contextLocalId);
   
-	size_t lastName = csMin (names.GetSize(), varStack.GetSize());
+	// A stack with a slot map can hold any name
+	size_t lastName = varStack.GetSlotMap () ? names.GetSize()
+	  : csMin (names.GetSize(), varStack.GetSize());
   
 	csBitArray::SetBitIterator it = names.GetSetBitIterator ();
 	while (it.HasNext ())
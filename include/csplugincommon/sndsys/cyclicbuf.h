@@ -30,6 +30,11 @@ namespace SndSys
 
 /** 
  * An implementation of a cyclic buffer oriented for sound functionality.
+ *
+ * One thread may add bytes while another one reads data and advances the
+ * start value, without locking.  Data becomes visible to readers only after
+ * it was completely copied into the buffer.  Clear() and advancing the start
+ * value beyond the end value need exclusive access.
  */
 class CS_CRYSTALSPACE_EXPORT SoundCyclicBuffer
 {
@@ -66,7 +71,7 @@ public:
   /** 
    * Clear the buffer and reset the start and end values to the provided value.
    */
-  void Clear (long value=0);
+  void Clear (size_t value=0);
 
   /**
    * Get data pointers to copy data out of the cyclic buffer.
@@ -87,19 +92,18 @@ private:
   /** 
    * Values associated with the start and end of the buffer.  
    * end_value - start_value = size of valid data in buffer.
+   * The start value is only changed by the reading thread, the end value
+   * only by the writing thread.
    */
   size_t start_value;
   size_t end_value;
   //@}
 
-  //@{
-  /**
-   * Pointers to the base of the buffer and the write pointer into the buffer 
-   * respectively.
-   */
+  /// The value associated with the first byte of buffer_base
+  size_t base_value;
+
+  /// Pointer to the base of the buffer
   uint8 *buffer_base;
-  uint8 *write_ptr;
-  //@}
 };
 
 } // namespace SndSys
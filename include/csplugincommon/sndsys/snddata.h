@@ -23,6 +23,8 @@
 #include "iutil/databuff.h"
 #include "isndsys/ss_structs.h"
 #include "isndsys/ss_data.h"
+#include "iutil/job.h"
+#include "csutil/ref.h"
 #include "csutil/scf_implementation.h"
 
 namespace CS
@@ -88,6 +90,13 @@ namespace CS
     //   This may return 0 if no description is set.
     virtual const char *GetDescription() { return m_pDescription; }
 
+    /**
+    * Let streams created from this data decode \a time milliseconds ahead
+    * of playback using the jobs of \a pQueue.  Only used by sound elements
+    * whose streams support it.
+    */
+    void SetDecodeAhead (iJobQueue *pQueue, size_t time);
+
     ////
     //  Member variables
     ////
@@ -106,6 +115,12 @@ namespace CS
 
     /// An optional brief description of the sound data
     char *m_pDescription;
+
+    /// Queue of the decoder threads, if streams decode ahead
+    csRef<iJobQueue> m_DecodeQueue;
+
+    /// How far streams decode ahead in milliseconds
+    size_t m_DecodeAheadTime;
   };
 
 
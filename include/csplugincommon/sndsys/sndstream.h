@@ -22,6 +22,7 @@
 #define SNDSTREAM_H
 
 #include "iutil/databuff.h"
+#include "iutil/job.h"
 #include "isndsys/ss_structs.h"
 #include "isndsys/ss_stream.h"
 #include "csplugincommon/sndsys/convert.h"
@@ -29,15 +30,28 @@
 #include "csplugincommon/sndsys/queue.h"
 #include "csutil/refarr.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/mutex.h"
 
+struct iObjectRegistry;
 
 namespace CS
 {
   namespace SndSys
   {
 
+  /**
+   * Base class for sound streams which decode their data into a cyclic
+   * buffer.
+   *
+   * Streams of compressed data can decode ahead of playback on a pool of
+   * decoder threads shared by all streams, see EnableDecodeAhead().  The
+   * renderer then only copies the decoded data, unless the decoders fall
+   * behind.
+   */
   class CS_CRYSTALSPACE_EXPORT SndSysBasicStream :
-    public scfImplementation1<SndSysBasicStream, iSndSysStream>
+    public scfImplementation2<SndSysBasicStream, iSndSysStream,
+                              iSndSysStreamDecodeStats>
   {
   public:
     SndSysBasicStream(csSndSysSoundFormat *pRenderFormat, int Mode3D);
@@ -250,8 +264,12 @@ namespace CS
     *  
     * This function is not necessarily thread safe and must be called ONLY
     * from the Sound System's main processing thread.
+    *
+    * The default implementation handles pending seeks through Seek() and
+    * obtains the data through DecodeFrames(), either directly or from the
+    * decoder threads.
     */
-    virtual void AdvancePosition(size_t frame_delta) = 0;
+    virtual void AdvancePosition(size_t frame_delta);
 
     /**
     * Used to retrieve pointers to properly formatted sound data.  
@@ -323,6 +341,48 @@ namespace CS
     /// Whether this stream always needs to be treated as a stream regardless of size.
     virtual bool AlwaysStream() const { return false; }
 
+    //------------------------
+    // iSndSysStreamDecodeStats
+    //------------------------
+  public:
+    /// Whether this stream is decoded ahead by the decoder threads
+    virtual bool IsDecodingAhead() { return m_DecodeJob.IsValid(); }
+
+    /// Number of times the renderer had to decode data itself
+    virtual size_t GetUnderrunCount() { return m_UnderrunCount; }
+
+    /// Total time spent decoding this stream, in microseconds
+    virtual csMicroTicks GetDecodeTime()
+    {
+      CS::Threading::MutexScopedLock lock (m_DecodeTimeLock);
+      return m_DecodeTime;
+    }
+
+    ////
+    // Decode-ahead support
+    ////
+  public:
+    /**
+    * Get the job queue of the decoder threads shared by all sound streams.
+    * It's created on first use with the number of threads set by the
+    * SndSys.DecoderThreads configuration key.
+    */
+    static csPtr<iJobQueue> GetDecoderQueue (iObjectRegistry *pObjectReg);
+
+    /**
+    * Decode \a time milliseconds of audio ahead of the playback position
+    * using the jobs of \a pQueue.  The stream must implement Seek() and
+    * DecodeFrames().  Must be called before playback starts.
+    */
+    void EnableDecodeAhead (iJobQueue *pQueue, size_t time);
+
+    /**
+    * Decode until the look-ahead is filled.  Called from the decoder
+    * threads.
+    * \remarks Not intended to be called by an application.
+    */
+    void DecodeAhead ();
+
     ////
     // Internal functions
     ////
@@ -335,6 +395,48 @@ namespace CS
     /// Called to queue a notification event
     void QueueNotificationEvent(StreamNotificationType NotifyType, size_t FrameNum);
 
+    /**
+    * Decode \a frame_delta frames of audio into the cyclic buffer, making
+    * room by advancing the start of the buffer if necessary.  Does nothing
+    * unless the stream is unpaused and reading is not complete.
+    *
+    * When decoding ahead this is called from the decoder threads, but never
+    * concurrently for the same stream.  The requested data will then always
+    * fit into the free space of the cyclic buffer.
+    */
+    virtual void DecodeFrames (size_t /*frame_delta*/) {}
+
+    /**
+    * Move the decoder to the frame \a position and drop any data that was
+    * decoded but not yet added to the cyclic buffer.  Called from the main
+    * processing thread while the decoder threads don't work on this stream.
+    */
+    virtual void Seek (size_t /*position*/) {}
+
+    /**
+    * Wait until the decoder threads don't work on this stream anymore and
+    * remove it from their queue.  Streams decoding ahead must call this
+    * before they destroy the state used by DecodeFrames().
+    */
+    void WaitForDecoder ();
+
+    /// Set whether reading the underlying data is complete
+    void SetPlaybackReadComplete (bool complete)
+    {
+      CS::Threading::AtomicOperations::Set (&m_PlaybackReadComplete,
+        complete ? 1 : 0);
+    }
+
+    /// Whether reading the underlying data is complete
+    bool IsPlaybackReadComplete () const
+    {
+      return CS::Threading::AtomicOperations::Read (&m_PlaybackReadComplete)
+        != 0;
+    }
+
+    /// Add time spent in DecodeFrames()
+    void AddDecodeTime (csMicroTicks time);
+
 
     ////
     //  Member variables
@@ -369,7 +471,9 @@ namespace CS
     //  This is set to true once we have completed reading the underlying data
     //   only if we are not looping. If we are looping, then we'll just start
     //   back at the beginning of the data and we will never be finished reading.
-    bool m_bPlaybackReadComplete;
+    //  Written by the decoder threads when decoding ahead, so only access it
+    //   through SetPlaybackReadComplete() and IsPlaybackReadComplete().
+    int32 m_PlaybackReadComplete;
 
     /// Holds our integer representation of the position of the source which is
     //   furthest ahead in reading.
@@ -439,6 +543,40 @@ namespace CS
 
     /// Threadsafe queue of pending notification events
     Queue<StreamNotificationEvent> m_NotificationQueue;
+
+    /// Queue of the decoder threads, if decoding ahead
+    csRef<iJobQueue> m_DecodeQueue;
+
+    /// The job decoding this stream ahead, if decoding ahead
+    csRef<iJob> m_DecodeJob;
+
+    /// Non-zero while the decode job is queued or running
+    int32 m_DecodeJobQueued;
+
+    /// Set once the decode job had a chance to decode ahead
+    bool m_bDecoderPrimed;
+
+    /// Number of bytes to decode ahead of the playback position
+    size_t m_DecodeAheadBytes;
+
+    /// Number of bytes kept in the cyclic buffer behind the playback position
+    size_t m_HistoryBytes;
+
+    /**
+    * Cyclic buffer value up to which data may be read by sources when
+    * decoding ahead.  Set by the main processing thread, read by the decoder
+    * threads.
+    */
+    size_t m_PlayPosition;
+
+    /// Number of times AdvancePosition() had to decode data itself
+    size_t m_UnderrunCount;
+
+    /// Time spent in DecodeFrames() in microseconds
+    csMicroTicks m_DecodeTime;
+
+    /// Serializes accesses to m_DecodeTime, updated by the decoder threads
+    CS::Threading::Mutex m_DecodeTimeLock;
   };
 
 
@@ -1141,6 +1141,17 @@ namespace CS
   #define CS_ALIGNED_STRUCT(Kind, Align)	        Kind
 #endif
 
+/**\def CS_SUPPORTS_SSE2
+ * Defined if the compiler targets a processor that always has SSE2, so the
+ * SSE2 intrinsics from <emmintrin.h> can be used without any additional
+ * compiler flags or run time checks. This is the case for all x86-64
+ * builds and for 32 bit builds with SSE2 code generation enabled.
+ */
+#if !defined(CS_SUPPORTS_SSE2) && (defined(__SSE2__) || defined(_M_X64) \
+  || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+  #define CS_SUPPORTS_SSE2
+#endif
+
 // Macro used to define static implicit pointer conversion function.
 // Only use within a class declaration.
 #ifndef _CS_IMPLICITPTRCAST_NAME
@@ -1266,6 +1277,16 @@ namespace CS
 # define CS_DEPRECATION_WARNINGS_ENABLE
 #endif
 
+/**\def CS_HAS_RVALUE_REFERENCES
+ * Defined if the compiler supports rvalue references, which are needed to
+ * implement move constructors and move assignment operators.
+ */
+#if !defined(CS_HAS_RVALUE_REFERENCES) \
+  && ((__cplusplus >= 201103L) || defined(__GXX_EXPERIMENTAL_CXX0X__) \
+    || (defined(CS_COMPILER_MSVC) && defined(_MSC_VER) && (_MSC_VER >= 1600)))
+# define CS_HAS_RVALUE_REFERENCES
+#endif
+
 namespace CS
 {
   namespace deprecated
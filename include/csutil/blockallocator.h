@@ -137,6 +137,8 @@ struct csBlockAllocatorSizeObjectAlign
  * \sa csArray
  * \sa csMemoryPool
  * \sa CS::Memory::BlockAllocatorSafe for a thread-safe version
+ * \sa CS::Memory::BlockAllocatorCached for a thread-safe version with
+ *   per-thread caches
  */
 template <class T,
   typename Allocator = CS::Memory::AllocatorMalloc, 
@@ -361,6 +363,131 @@ namespace CS
         return WrappedAllocatorType::TryFree (p);
       }
     };
+
+    /**
+     * Thread-safe allocator for objects of a class, with per-thread caches
+     * of free blocks.
+     * Has the same purpose and interface as csBlockAllocator and
+     * BlockAllocatorSafe, but Alloc() and Free() usually don't need to lock.
+     * Better suited than BlockAllocatorSafe for allocators used heavily from
+     * multiple threads. See FixedSizeAllocatorCached for details and
+     * restrictions.
+     */
+    template <class T,
+      typename Allocator = AllocatorMalloc, 
+      typename ObjectDispose = csBlockAllocatorDisposeDelete<T>,
+      typename SizeComputer = csBlockAllocatorSizeObject<T>
+    >
+    class BlockAllocatorCached : 
+      public FixedSizeAllocatorCached<SizeComputer::value, Allocator>
+    {
+    public:
+      typedef T ValueType;
+      typedef Allocator AllocatorType;
+    protected:
+      typedef FixedSizeAllocatorCached<SizeComputer::value, Allocator>
+        superclass;
+    private:
+      void* Alloc (size_t /*n*/) { return 0; }                       // Illegal
+      void SetMemTrackerInfo (const char* /*info*/) { }             // Illegal
+    public:
+      /**
+       * Construct a new block allocator.
+       * \param nelem Number of elements to store in each allocation unit.
+       */
+      BlockAllocatorCached (size_t nelem = 32) : superclass (nelem)
+      {
+#ifdef CS_MEMORY_TRACKER
+        superclass::blocks.SetMemTrackerInfo (typeid(*this).name());
+#endif
+      }
+
+      /**
+       * Destroy all allocated objects and release memory.
+       */
+      ~BlockAllocatorCached ()
+      {
+        ObjectDispose dispose (*this, false);
+        this->DisposeAll (dispose);
+      }
+
+      /**
+       * Destroy all objects allocated by the pool without releasing the
+       * memory.
+       */
+      void Empty ()
+      {
+        ObjectDispose dispose (*this, true);
+        this->FreeAll (dispose);
+      }
+
+      /**
+       * Destroy all objects allocated by the pool and release the memory.
+       */
+      void DeleteAll ()
+      {
+        ObjectDispose dispose (*this, true);
+        this->DisposeAll (dispose);
+      }
+
+      /**
+       * Allocate a new object. 
+       * The default (no-argument) constructor of \a T is invoked. 
+       */
+      T* Alloc ()
+      {
+        return new (superclass::Alloc()) T;
+      }
+
+      /**
+       * Allocate a new object. 
+       * The two-argument constructor of \a T is invoked. 
+       */
+      template<typename A1, typename A2>
+      T* Alloc (A1& a1, A2& a2)
+      {
+        return new (superclass::Alloc()) T (a1, a2);
+      }
+
+      /**
+       * Allocate a new object. 
+       * The three-argument constructor of \a T is invoked. 
+       */
+      template<typename A1, typename A2, typename A3>
+      T* Alloc (A1& a1, A2& a2, A3& a3)
+      {
+        return new (superclass::Alloc()) T (a1, a2, a3);
+      }
+
+      /**
+       * Allocate a new object. 
+       * The one-argument constructor of \a T is invoked. 
+       */
+      template<typename A1>
+      T* Alloc (A1& a1)
+      {
+        return new (superclass::Alloc()) T (a1);
+      }
+
+      /**
+       * Deallocate an object. It is safe to provide a null pointer.
+       * \param p Pointer to deallocate.
+       */
+      void Free (T* p)
+      {
+        ObjectDispose dispose (*this, true);
+        superclass::Free (dispose, p);
+      }
+      /**
+       * Try to delete an object. Usage is the same as Free(), the difference
+       * being that \c false is returned if the deallocation failed.
+       */
+      bool TryFree (T* p)
+      {
+        ObjectDispose dispose (*this, true);
+        return superclass::TryFree (dispose, p);
+      }
+    };
   } // namespace Memory
 } // namespace CS
   
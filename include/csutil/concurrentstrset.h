@@ -0,0 +1,390 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_CONCURRENTSTRSET_H__
+#define __CS_CSUTIL_CONCURRENTSTRSET_H__
+
+/**\file
+ * String-to-ID table with lock-free lookups.
+ */
+
+#include "csextern.h"
+#include "csutil/array.h"
+#include "csutil/hashcomputer.h"
+#include "csutil/mempool.h"
+#include "csutil/noncopyable.h"
+#include "csutil/util.h"
+#include "csutil/threading/atomicops.h"
+#include "csutil/threading/mutex.h"
+#include "iutil/strset.h"
+
+namespace CS
+{
+namespace Utility
+{
+/**
+ * A string set (see StringSet) which can be used concurrently from multiple
+ * threads, with lookups that don't lock.
+ *
+ * Strings are kept in an open addressing hash table. A slot is filled
+ * completely before its string pointer is published atomically, so readers
+ * either see a complete entry or an empty slot. When the table grows, a new
+ * table is built and published; the old one stays valid for readers still
+ * using it. IDs are mapped back to strings with an array that only grows.
+ *
+ * Requesting the ID of a known string and requesting the string of an ID
+ * never lock. Adding or deleting strings takes a mutex, so only writers
+ * contend with each other.
+ *
+ * \remarks Deleted strings and old tables are only released when the set is
+ *   destroyed. The set is therefore intended for long-lived sets of strings
+ *   which mostly grow, like the shader variable name set.
+ * \sa StringSet
+ */
+template<typename Tag>
+class ConcurrentStringSet : private CS::NonCopyable
+{
+private:
+  typedef CS::Threading::AtomicOperations AtomicOps;
+
+  struct Slot
+  {
+    /// Published last; null means the slot is empty
+    void* str;
+    uint hash;
+    /// ID of the string, ~0 if the string was deleted
+    int32 id;
+  };
+  struct Table
+  {
+    size_t mask;
+    Slot slots[1];
+  };
+  /// Number of IDs in the first chunk of the reverse mapping
+  static const StringIDValue reverseBase = 256;
+  /// Each chunk is twice as large as the previous one
+  static const int reverseChunks = 24;
+
+  /// Current table
+  Table* table;
+  /// Tables replaced by a larger one; freed on destruction
+  csArray<Table*> oldTables;
+  /// Number of slots used in the current table
+  size_t slotsUsed;
+  /// Number of strings with a valid ID
+  int32 numStrings;
+  /// Next ID to assign
+  int32 nextID;
+  /// ID to string chunks
+  void* reverse[reverseChunks];
+  csMemoryPool pool;
+  /// Taken by all writers
+  mutable CS::Threading::Mutex writeLock;
+
+  /* Read a value published by a writer. Loads aren't reordered with other
+     loads on x86, so a volatile load suffices there and readers don't need
+     to write to shared cache lines; elsewhere use an atomic read. */
+  static void* ReadPublished (void* const* p)
+  {
+#ifdef CS_PROCESSOR_X86
+    return *const_cast<void* const volatile*> (p);
+#else
+    return AtomicOps::Read (p);
+#endif
+  }
+  static int32 ReadPublished (const int32* p)
+  {
+#ifdef CS_PROCESSOR_X86
+    return *const_cast<const volatile int32*> (p);
+#else
+    return AtomicOps::Read (p);
+#endif
+  }
+
+  static Table* NewTable (size_t size)
+  {
+    Table* t = static_cast<Table*> (cs_malloc (
+      sizeof (Table) + (size - 1) * sizeof (Slot)));
+    t->mask = size - 1;
+    memset (t->slots, 0, size * sizeof (Slot));
+    return t;
+  }
+
+  static const char* ReadString (const Slot& slot)
+  {
+    return static_cast<const char*> (ReadPublished (&slot.str));
+  }
+
+  /// Find the slot with a string, or the empty slot where it belongs
+  static const Slot* FindSlot (const Table* t, const char* s, uint hash)
+  {
+    size_t i = hash & t->mask;
+    while (true)
+    {
+      const Slot& slot = t->slots[i];
+      const char* str = ReadString (slot);
+      if (!str || ((slot.hash == hash) && (strcmp (str, s) == 0)))
+        return &slot;
+      i = (i + 1) & t->mask;
+    }
+  }
+
+  const Slot* FindSlot (const char* s, uint hash) const
+  {
+    const Table* t = static_cast<const Table*> (
+      ReadPublished ((void* const*)&table));
+    return FindSlot (t, s, hash);
+  }
+
+  /// Get the reverse mapping entry of an ID; allocate its chunk if asked to
+  void** GetReverse (StringIDValue id, bool create) const
+  {
+    StringIDValue x = id / reverseBase + 1;
+    int chunk = csLog2 (int (x));
+    void** entries = static_cast<void**> (
+      ReadPublished (&reverse[chunk]));
+    if (!entries)
+    {
+      if (!create) return 0;
+      size_t n = size_t (reverseBase) << chunk;
+      entries = static_cast<void**> (cs_calloc (n, sizeof (void*)));
+      AtomicOps::Set (const_cast<void**> (&reverse[chunk]), entries);
+    }
+    return entries + (id - reverseBase * ((1u << chunk) - 1));
+  }
+
+  /// Move the live strings to a table twice as large. Caller holds the lock.
+  void Grow ()
+  {
+    Table* newTable = NewTable ((table->mask + 1) * 2);
+    slotsUsed = 0;
+    for (size_t i = 0; i <= table->mask; i++)
+    {
+      const Slot& slot = table->slots[i];
+      if (!slot.str || (slot.id == int32 (~0))) continue;
+      Slot* newSlot = const_cast<Slot*> (FindSlot (newTable,
+        static_cast<const char*> (slot.str), slot.hash));
+      *newSlot = slot;
+      slotsUsed++;
+    }
+    oldTables.Push (table);
+    AtomicOps::Set ((void**)&table, newTable);
+  }
+
+  /// Give a string a new ID. Caller holds the lock.
+  StringID<Tag> Assign (Slot* slot, const char* str)
+  {
+    int32 id = nextID;
+    *GetReverse (StringIDValue (id), true) = const_cast<char*> (str);
+    AtomicOps::Set (&nextID, id + 1);
+    AtomicOps::Set (&slot->id, id);
+    AtomicOps::Increment (&numStrings);
+    return StringIDValue (id);
+  }
+
+  /// Remove a string. Caller holds the lock.
+  bool DeleteString (const char* s)
+  {
+    Slot* slot = const_cast<Slot*> (FindSlot (table, s, csHashCompute (s)));
+    if (!slot->str || (slot->id == int32 (~0))) return false;
+    AtomicOps::Set (GetReverse (StringIDValue (slot->id), false), 0);
+    AtomicOps::Set (&slot->id, int32 (~0));
+    AtomicOps::Decrement (&numStrings);
+    return true;
+  }
+
+  void FreeAll ()
+  {
+    cs_free (table);
+    for (size_t i = 0; i < oldTables.GetSize (); i++)
+      cs_free (oldTables[i]);
+    oldTables.Empty ();
+    for (int i = 0; i < reverseChunks; i++)
+    {
+      cs_free (reverse[i]);
+      reverse[i] = 0;
+    }
+  }
+public:
+  /// Iterator over all strings in the set
+  class GlobalIterator
+  {
+    const Table* table;
+    size_t index;
+
+    void Skip ()
+    {
+      while ((index <= table->mask)
+        && (!ReadString (table->slots[index])
+          || (table->slots[index].id == int32 (~0))))
+        index++;
+    }
+  public:
+    GlobalIterator (const Table* table) : table (table), index (0)
+    { Skip (); }
+
+    /// Whether there are more strings
+    bool HasNext () const { return index <= table->mask; }
+    /// Return the ID of the next string and the string itself in \a str
+    StringID<Tag> Next (const char*& str)
+    {
+      const Slot& slot = table->slots[index++];
+      str = ReadString (slot);
+      StringID<Tag> id (StringIDValue (slot.id));
+      Skip ();
+      return id;
+    }
+  };
+
+  /// Constructor.
+  ConcurrentStringSet (size_t size = 23) : slotsUsed (0), numStrings (0),
+    nextID (0)
+  {
+    size_t tableSize = 16;
+    while (tableSize < size * 2) tableSize *= 2;
+    table = NewTable (tableSize);
+    memset (reverse, 0, sizeof (reverse));
+  }
+  /// Destructor.
+  ~ConcurrentStringSet () { FreeAll (); }
+
+  /**
+   * Request the numeric ID for the given string.
+   * \return The ID of the string.
+   * \remarks Creates a new ID if the string is not yet present in the set,
+   *   else returns the previously assigned ID.
+   */
+  StringID<Tag> Request (const char* s)
+  {
+    uint hash = csHashCompute (s);
+    const Slot* slot = FindSlot (s, hash);
+    if (slot->str)
+    {
+      int32 id = ReadPublished (&slot->id);
+      if (id != int32 (~0)) return StringIDValue (id);
+    }
+
+    CS::Threading::MutexScopedLock lock (writeLock);
+    Slot* found = const_cast<Slot*> (FindSlot (table, s, hash));
+    if (found->str)
+    {
+      // Added by another thread meanwhile, or deleted before
+      if (found->id != int32 (~0)) return StringIDValue (found->id);
+      return Assign (found, static_cast<const char*> (found->str));
+    }
+    if ((slotsUsed + 1) * 2 > table->mask + 1)
+    {
+      Grow ();
+      found = const_cast<Slot*> (FindSlot (table, s, hash));
+    }
+    const char* str = pool.Store (s);
+    found->hash = hash;
+    found->id = int32 (~0);
+    AtomicOps::Set (&found->str, const_cast<char*> (str));
+    slotsUsed++;
+    return Assign (found, str);
+  }
+
+  /**
+   * Request the string corresponding to the given ID.
+   * \return Null if the string has not been requested (yet), else the string
+   *   corresponding to the ID.
+   */
+  char const* Request (StringID<Tag> id) const
+  {
+    if (StringIDValue (id) >= StringIDValue (ReadPublished (&nextID)))
+      return 0;
+    void** entry = GetReverse (id, false);
+    return static_cast<const char*> (ReadPublished (entry));
+  }
+
+  /**
+   * Check if the set contains a particular string.
+   */
+  bool Contains (char const* s) const
+  {
+    const Slot* slot = FindSlot (s, csHashCompute (s));
+    return slot->str && (ReadPublished (&slot->id) != int32 (~0));
+  }
+
+  /**
+   * Check if the set contains a string with a particular ID.
+   */
+  bool Contains (StringID<Tag> id) const
+  { return Request (id) != 0; }
+
+  /**
+   * Remove specified string.
+   * \return True if a matching string was in the set; else false.
+   */
+  bool Delete (char const* s)
+  {
+    CS::Threading::MutexScopedLock lock (writeLock);
+    return DeleteString (s);
+  }
+
+  /**
+   * Remove a string with the specified ID.
+   * \return True if a matching string was in the set; else false.
+   */
+  bool Delete (StringID<Tag> id)
+  {
+    CS::Threading::MutexScopedLock lock (writeLock);
+    const char* s = Request (id);
+    return s ? DeleteString (s) : false;
+  }
+
+  /**
+   * Remove all stored strings. When new strings are registered again, new
+   * ID values will be used; the old ID's will not be re-used.
+   */
+  void Empty ()
+  {
+    CS::Threading::MutexScopedLock lock (writeLock);
+    for (size_t i = 0; i <= table->mask; i++)
+    {
+      Slot& slot = table->slots[i];
+      if (!slot.str || (slot.id == int32 (~0))) continue;
+      AtomicOps::Set (GetReverse (StringIDValue (slot.id), false), 0);
+      AtomicOps::Set (&slot.id, int32 (~0));
+    }
+    AtomicOps::Set (&numStrings, 0);
+  }
+
+  /// Get the number of elements in the set.
+  size_t GetSize () const
+  { return size_t (ReadPublished (&numStrings)); }
+
+  /// Return true if the set is empty.
+  bool IsEmpty () const
+  { return GetSize () == 0; }
+
+  /**
+   * Return an iterator for the set which iterates over all strings.
+   * \warning Strings added while iterating may or may not be returned.
+   */
+  GlobalIterator GetIterator () const
+  {
+    return GlobalIterator (static_cast<const Table*> (
+      ReadPublished ((void* const*)&table)));
+  }
+};
+} // namespace Utility
+} // namespace CS
+
+#endif // __CS_CSUTIL_CONCURRENTSTRSET_H__
@@ -320,9 +320,6 @@ private:
   // into the pool when users are done with it.
   csWeakRef<csEventQueue> pool;
 
-  // The next event in the pool, or null if the event is in use.
-  csPoolEvent *next;
-
   // The 'real' DecRef() call that deletes the event, should in theory only be
   // called from csEventQueue.
   void Free () { csEvent::DecRef(); }
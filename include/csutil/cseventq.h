@@ -37,6 +37,7 @@
 #include "csutil/ref.h"
 #include "csutil/refarr.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/threading/mutex.h"
 #include "csutil/threading/rwmutex.h"
 #include "csutil/weakref.h"
 #include "csutil/eventhandlers.h"
@@ -51,11 +52,16 @@ class csEventOutlet;
 class csPoolEvent;
 
 /**\internal
- * Default event queue size: the queue will automatically grow
- * when the queue will overflow.
+ * Default event queue size: events posted while the queue is full are
+ * kept in a (slower) overflow list.
  */
 #define DEF_EVENT_QUEUE_LENGTH  256
 
+/**\internal
+ * Maximum number of unused events kept for reuse.
+ */
+#define EVENT_POOL_SIZE  128
+
 template<>
 class csHashComputer<iEventHandler *> : public csHashComputerIntegral<iEventHandler *> {};
 
@@ -79,31 +85,55 @@ private:
   csRef<iEventNameRegistry> NameRegistry;
   // Event handler registry
   csRef<iEventHandlerRegistry> HandlerRegistry;
-  // The queue itself (technically, a ring buffer)
-  volatile iEvent** EventQueue;
-  // Queue head and tail pointers
-  volatile size_t evqHead, evqTail;
-  // The maximum queue length
-  volatile size_t Length;  
+  /* The queue itself: a bounded ring buffer which any number of threads
+     can post to without locking. A slot's sequence number tells whether
+     it's free to post to (== position) or holds an event (== position+1). */
+  struct PostSlot
+  {
+    int32 sequence;
+    iEvent* event;
+  };
+  PostSlot* EventQueue;
+  int32 EventQueueMask;
+  // Next position to post to, claimed by the posting threads
+  int32 evqHead;
+  // Next position to get from; only used by the thread processing events
+  int32 evqTail;
+  // Events posted while the ring buffer was full, in posting order
+  csArray<iEvent*> OverflowEvents;
+  size_t OverflowHead;
+  // Number of events in OverflowEvents, readable without the lock
+  int32 OverflowCount;
+  CS::Threading::Mutex OverflowMutex;
   // Event tree.  All subscription PO graphs and delivery queues hang off
   // of this.
   csEventTree *EventTree;
   // Shortcut to per-event-name delivery queues.
   csHash<csEventTree *,csEventID> EventHash;
+  /* Copy of EventHash for Dispatch(), filled as events are dispatched, so
+     it doesn't have to lock etreeMutex. Valid as long as the event tree
+     isn't recreated (tracked by EventTreeVersion). */
+  csHash<csEventTree *,csEventID> DispatchNodes;
+  int32 DispatchNodesVersion;
+  int32 EventTreeVersion;
   // Array of allocated event outlets.
   csArray<csEventOutlet*> EventOutlets;
   // Array of allocated event cords.
   csHash<csEventCord *, csEventID> EventCords;
-  // Pool of event objects
-  csPoolEvent* EventPool;
+  // Pool of event objects; free slots are null
+  void* EventPool[EVENT_POOL_SIZE];
+  // Number of events in the pool
+  int32 EventPoolCount;
   /// Registered event handler (used for proper cleanup in RemoveAllListeners())
   csRefArray<iEventHandler> handlers;
   /// Mutex for thread safety.
   CS::Threading::ReadWriteMutex mutex;
   CS::Threading::ReadWriteMutex etreeMutex;
 
-  // Enlarge the queue size.
-  void Resize (size_t iLength);  
+  // Put an event into the pool. Returns false if the pool is full.
+  bool RecycleEvent (csPoolEvent* event);
+  // Look up the event tree node for an event name.
+  csEventTree* GetDispatchNode (const csEventID &name);
   // Send broadcast pseudo-events (bypassing event queue).
   void Notify (const csEventID &name);
 
@@ -217,14 +247,14 @@ public:
   virtual csPtr<iEvent> CreateEvent (const char *name);
   virtual csPtr<iEvent> CreateBroadcastEvent (const csEventID &name);
   virtual csPtr<iEvent> CreateBroadcastEvent (const char *name);
-  /// Place an event into queue.
+  /// Place an event into queue. Can be called from any thread.
   virtual void Post (iEvent*);
   /// Get next event from queue or a null references if no event.
   virtual csPtr<iEvent> Get ();
   /// Clear event queue
   virtual void Clear ();
-  /// Query if queue is empty (@@@ Not thread safe!)
-  virtual bool IsEmpty () { return evqHead == evqTail; }
+  /// Query if queue is empty
+  virtual bool IsEmpty ();
 
   csEventID Frame;
 };
@@ -65,8 +65,10 @@ protected:
   /// Size in bytes of allocated string buffer.
   size_t MaxSize;
   /**
-   * Size in bytes by which allocated buffer is increased when needed. If this
-   * value is zero, then growth occurs exponentially by doubling the size.
+   * Size in bytes by which allocated buffer is increased when needed. The
+   * buffer also grows by at least half of its size, so repeated appending
+   * needs a logarithmic number of allocations. If this value is zero, then
+   * growth occurs exponentially by doubling the size.
    */
   size_t GrowBy;
 
@@ -86,6 +88,24 @@ protected:
   /// Compute a new buffer size. Takes GrowBy into consideration.
   size_t ComputeNewSize (size_t NewSize);
 
+  /**
+   * Take over the dynamically allocated buffer of \a other, which is left
+   * representing a null-pointer.
+   * \return False if \a other has no dynamically allocated buffer, in which
+   *   case neither string is changed.
+   */
+  bool StealBuffer (csStringBase& other)
+  {
+    if ((other.Data == 0) || (&other == this)) return false;
+    Free ();
+    Data = other.Data;
+    Size = other.Size;
+    MaxSize = other.MaxSize;
+    other.Data = 0;
+    other.Free ();
+    return true;
+  }
+
   /**
    * Get a pointer to the null-terminated character array.
    * \return A C-string pointer to the null-terminated character array; or zero
@@ -212,6 +232,18 @@ public:
     GrowBy (DEFAULT_GROW_BY)
   { Append (copy); }
 
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  /**
+   * Move constructor. Takes over the buffer of \a other if it was
+   * dynamically allocated, otherwise copies it.
+   * \remarks \a other is left representing a null-pointer if its buffer
+   *   was taken over.
+   */
+  csStringBase (csStringBase&& other) : Data (0), Size (0), MaxSize (0),
+    GrowBy (DEFAULT_GROW_BY)
+  { if (!StealBuffer (other)) Append (other); }
+#endif
+
   /**
    * Create a csStringBase object from a null-terminated C string.
    * \remarks The newly constructed string will represent a null-pointer if and
@@ -829,6 +861,12 @@ public:
   const csStringBase& operator = (const csStringBase& copy)
   { Replace(copy); return *this; }
 
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  /// Move another string into this one
+  const csStringBase& operator = (csStringBase&& other)
+  { if (!StealBuffer (other)) Replace (other); return *this; }
+#endif
+
   /**
    * Append a formatted value to this string.
    */
@@ -1063,6 +1101,14 @@ public:
    */
   csStringFast (const csStringFast& copy) : csStringBase (), miniused(0)
   { Append (copy); }
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  /**
+   * Move constructor. Takes over the buffer of \a other if it was
+   * dynamically allocated, otherwise copies the internal buffer.
+   */
+  csStringFast (csStringFast&& other) : csStringBase (), miniused(0)
+  { if (!StealBuffer (other)) Append (other); }
+#endif
   /**
    * Create a csStringFast object from a null-terminated C string.
    */
@@ -1093,6 +1139,17 @@ public:
   /// Assign a value to this string.
   const csStringFast& operator = (const csStringBase& copy)
   { Replace(copy); return *this; }
+  /// Assign a value to this string.
+  const csStringFast& operator = (const csStringFast& copy)
+  { Replace (static_cast<const csStringBase&> (copy)); return *this; }
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  /// Move a value into this string.
+  const csStringFast& operator = (csStringFast&& other)
+  {
+    if (!StealBuffer (other)) Replace (static_cast<const csStringBase&> (other));
+    return *this;
+  }
+#endif
 
   /// Assign a formatted value to this string.
   template<typename T>
@@ -1153,6 +1210,15 @@ public:
   csStringFast () : csStringBase() { }
   csStringFast (size_t Length) : csStringBase(Length) { }
   csStringFast (const csStringBase& copy) : csStringBase (copy) { }
+  csStringFast (const csStringFast& copy) : csStringBase (copy) { }
+  const csStringFast& operator = (const csStringFast& copy)
+  { Replace (static_cast<const csStringBase&> (copy)); return *this; }
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  csStringFast (csStringFast&& other)
+    : csStringBase (static_cast<csStringBase&&> (other)) { }
+  const csStringFast& operator = (csStringFast&& other)
+  { csStringBase::operator= (static_cast<csStringBase&&> (other)); return *this; }
+#endif
   csStringFast (const char* src) : csStringBase(src) { }
   csStringFast (const char* src, size_t _length) : csStringBase(src, _length)
   { }
@@ -1225,6 +1291,14 @@ public:
     csStringFast<> ((const csStringBase&)copy) { }
   csString (const csStringBase& copy) : csStringFast<> (copy) { }
   /** @} */
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  /**
+   * Move constructor. Takes over the buffer of \a other if it was
+   * dynamically allocated.
+   */
+  csString (csString&& other)
+    : csStringFast<> (static_cast<csStringFast<>&&> (other)) { }
+#endif
   /// Create a csString object from a null-terminated C string.
   csString (const char* src) : csStringFast<> (src) { }
   /// Create a csString object from a C string, given the length.
@@ -1243,6 +1317,13 @@ public:
   /// Assign a value to this string.
   const csString& operator = (const csString& copy)
   { Replace(copy); return *this; }
+#if defined(CS_HAS_RVALUE_REFERENCES) && !defined(SWIG)
+  const csString& operator = (csString&& other)
+  {
+    csStringFast<>::operator= (static_cast<csStringFast<>&&> (other));
+    return *this;
+  }
+#endif
   const csString& operator = (const csStringBase& copy)
   { Replace(copy); return *this; }
   const csString& operator = (const char* copy)
@@ -257,14 +257,18 @@ private:
      */
     SubscriberIterator (iEventHandlerRegistry* r, csEventTree *t, 
       csEventID bevent) : handler_reg(r), record(t->fatRecord), 
-        baseevent(bevent), mode(SI_LIST), qit(0)
+        baseevent(bevent), mode(SI_LIST), hasQueue(false)
     {
       CS_ASSERT(record->iterator == 0);
       record->iterator = this;
       record->iterating_for = t;
       if (t->fatRecord->SubscriberQueue)
-        qit = new csList<iEventHandler *>::Iterator (
+      {
+        // Iterator lives on the stack: no allocation per dispatched event
+        qit = csList<iEventHandler *>::Iterator (
           *t->fatRecord->SubscriberQueue);
+        hasQueue = true;
+      }
       else
         GraphMode();
     }
@@ -277,7 +281,6 @@ private:
       CS_ASSERT(record->iterator == this);
       record->iterator = 0;
       record->iterating_for = 0;
-      delete qit;
     }
 
     /// Test if there is another available handler
@@ -286,7 +289,7 @@ private:
       switch(mode) 
       {
       case SI_LIST:
-        return qit->HasNext ();
+        return qit.HasNext ();
         
       case SI_GRAPH:
         do 
@@ -317,7 +320,7 @@ private:
       {
       case SI_LIST:
 	/* DOME : see if the current element has been deleted. */
-        return qit->Next ();
+        return qit.Next ();
         
       case SI_GRAPH:
 	/* see if the current element has been flagged for deletion. */
@@ -352,7 +355,8 @@ private:
     friend class csEventTree;
     friend class csEventQueueTest;
 
-    csRef<iEventHandlerRegistry> handler_reg;
+    // Kept alive by the event tree
+    iEventHandlerRegistry* handler_reg;
     FatRecordObject *record;
     csEventID baseevent;
     enum
@@ -362,7 +366,8 @@ private:
     } mode;
     
     /* SI_LIST mode data structures */
-    csList<iEventHandler *>::Iterator* qit;
+    csList<iEventHandler *>::Iterator qit;
+    bool hasQueue;
   };
   friend class SubscriberIterator;
   friend class csEventQueueTest;
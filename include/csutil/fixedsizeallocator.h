@@ -28,6 +28,8 @@
 #include "csutil/array.h"
 #include "csutil/bitarray.h"
 #include "csutil/sysfunc.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/threading/tls.h"
 
 #ifdef CS_DEBUG
 #include <typeinfo>
@@ -56,6 +58,8 @@
  * \sa csArray
  * \sa csMemoryPool
  * \sa CS::Memory::FixedSizeAllocatorSafe for a thread-safe version
+ * \sa CS::Memory::FixedSizeAllocatorCached for a thread-safe version with
+ *   per-thread caches
  */
 template <size_t Size, class Allocator = CS::Memory::AllocatorMalloc>
 class csFixedSizeAllocator
@@ -576,6 +580,346 @@ namespace CS
         return WrappedAllocatorType::GetBlockElements();
       }
     };
+
+    /**
+     * Thread-safe allocator for blocks of the same size, with per-thread
+     * caches of free blocks.
+     * Has the same purpose and interface as csFixedSizeAllocator and can be
+     * used concurrently from different threads, like FixedSizeAllocatorSafe.
+     * However, each thread keeps two "magazines" of up to \a MagazineSize
+     * free blocks. Alloc() and Free() only work on the magazines of the
+     * calling thread and don't lock; a lock is only taken to exchange a full
+     * or empty magazine with a central depot, or to fill a magazine from the
+     * underlying allocator.
+     *
+     * \remarks Blocks freed by a thread go into the cache of that thread,
+     *   even if they were allocated by another thread.
+     * \remarks Compact() can only release blocks that are free in the depot
+     *   or the cache of the calling thread; blocks cached by other threads
+     *   count as used. Empty() and destroying the allocator return the caches
+     *   of all threads, so they must not be called while other threads use
+     *   the allocator (which would be wrong anyway, as they invalidate all
+     *   allocations).
+     * \remarks Every instance uses a thread local storage slot. Since only a
+     *   limited number of those is available, this allocator is intended for
+     *   long-lived allocators shared by many objects.
+     */
+    template <size_t Size, class Allocator = CS::Memory::AllocatorMalloc,
+      size_t MagazineSize = 32>
+    class FixedSizeAllocatorCached :
+      protected csFixedSizeAllocator<Size, Allocator>
+    {
+    protected:
+      typedef csFixedSizeAllocator<Size, Allocator> WrappedAllocatorType;
+      typedef typename WrappedAllocatorType::FreeNode FreeNode;
+
+      /// Free blocks cached by a thread
+      struct ThreadCache
+      {
+        FixedSizeAllocatorCached* owner;
+        /// Magazine allocated from and freed to
+        FreeNode* loaded;
+        size_t loadedCount;
+        /// Second magazine, either full or empty
+        FreeNode* previous;
+        size_t previousCount;
+        /// Whether a thread uses this cache
+        bool inUse;
+
+        ThreadCache (FixedSizeAllocatorCached* owner) : owner (owner),
+          loaded (0), loadedCount (0), previous (0), previousCount (0),
+          inUse (true) {}
+      };
+
+      /// Lock for the depot, the underlying allocator and the cache list
+      mutable CS::Threading::RecursiveMutex mutex;
+      /// Full magazines, each a chain of MagazineSize free nodes
+      csArray<FreeNode*> depot;
+      /// Caches of all threads
+      csArray<ThreadCache*> caches;
+      /// Slot with the cache of the current thread
+      CS::Threading::ThreadLocalBase threadCache;
+
+      /// Called when a thread exits: return its blocks
+      static void ThreadExit (void* p)
+      {
+        ThreadCache* cache = static_cast<ThreadCache*> (p);
+        FixedSizeAllocatorCached* owner = cache->owner;
+        CS::Threading::RecursiveMutexScopedLock lock (owner->mutex);
+        owner->ReturnCache (*cache);
+        cache->inUse = false;
+      }
+
+      /// Get the cache of the current thread, creating it if needed
+      ThreadCache& GetCache ()
+      {
+        ThreadCache* cache = static_cast<ThreadCache*> (
+          threadCache.GetValue ());
+        if (!cache)
+        {
+          CS::Threading::RecursiveMutexScopedLock lock (mutex);
+          for (size_t i = 0; i < caches.GetSize (); i++)
+          {
+            if (!caches[i]->inUse)
+            {
+              cache = caches[i];
+              cache->inUse = true;
+              break;
+            }
+          }
+          if (!cache)
+          {
+            cache = new ThreadCache (this);
+            caches.Push (cache);
+          }
+          threadCache.SetValue (cache);
+        }
+        return *cache;
+      }
+
+      /// Put a chain of nodes onto the free list of the wrapped allocator
+      void ReturnChain (FreeNode* chain)
+      {
+        while (chain)
+        {
+          FreeNode* next = chain->next;
+          chain->next = this->freenode;
+          this->freenode = chain;
+          chain = next;
+        }
+      }
+
+      /// Return the blocks of a cache to the wrapped allocator
+      void ReturnCache (ThreadCache& cache)
+      {
+        ReturnChain (cache.loaded);
+        ReturnChain (cache.previous);
+        cache.loaded = cache.previous = 0;
+        cache.loadedCount = cache.previousCount = 0;
+      }
+
+      /// Return the blocks of the depot to the wrapped allocator
+      void ReturnDepot ()
+      {
+        for (size_t i = 0; i < depot.GetSize (); i++)
+          ReturnChain (depot[i]);
+        depot.Empty ();
+      }
+
+      /// Return all cached blocks to the wrapped allocator
+      void ReturnAll ()
+      {
+        for (size_t i = 0; i < caches.GetSize (); i++)
+          ReturnCache (*caches[i]);
+        ReturnDepot ();
+      }
+
+      /// Refill the empty loaded magazine of a cache
+      void Refill (ThreadCache& cache)
+      {
+        CS::Threading::RecursiveMutexScopedLock lock (mutex);
+        if (depot.GetSize () > 0)
+        {
+          cache.loaded = depot.Pop ();
+          cache.loadedCount = MagazineSize;
+          return;
+        }
+        for (size_t i = 0; i < MagazineSize; i++)
+        {
+          FreeNode* node = static_cast<FreeNode*> (
+            WrappedAllocatorType::AllocCommon ());
+          node->next = cache.loaded;
+          cache.loaded = node;
+        }
+        cache.loadedCount = MagazineSize;
+      }
+
+      /**
+       * Deallocate a chunk of memory. It is safe to provide a null pointer.
+       * \param disposer Disposer object that is passed to DestroyObject().
+       * \param p Pointer to deallocate.
+       */
+      template<typename Disposer>
+      void Free (Disposer& disposer, void* p)
+      {
+        if (p == 0 || this->insideDisposeAll) return;
+        this->DestroyObject (disposer, p);
+
+        ThreadCache& cache = GetCache ();
+        if (cache.loadedCount == MagazineSize)
+        {
+          if (cache.previousCount == MagazineSize)
+          {
+            // Both magazines are full, hand one to the depot
+            CS::Threading::RecursiveMutexScopedLock lock (mutex);
+            depot.Push (cache.previous);
+          }
+          cache.previous = cache.loaded;
+          cache.previousCount = MagazineSize;
+          cache.loaded = 0;
+          cache.loadedCount = 0;
+        }
+        FreeNode* node = static_cast<FreeNode*> (p);
+        node->next = cache.loaded;
+        cache.loaded = node;
+        cache.loadedCount++;
+      }
+
+      /**
+       * Try to delete a chunk of memory. Usage is the same as Free(), the
+       * difference being that \c false is returned if the deallocation failed.
+       */
+      template<typename Disposer>
+      bool TryFree (Disposer& disposer, void* p)
+      {
+        if (p == 0) return true;
+        {
+          CS::Threading::RecursiveMutexScopedLock lock (mutex);
+          if (this->FindBlock (p) == csArrayItemNotFound) return false;
+        }
+        Free (disposer, p);
+        return true;
+      }
+
+      /**
+       * Destroy all living objects and release all memory.
+       */
+      template<typename Disposer>
+      void DisposeAll (Disposer& disposer)
+      {
+        CS::Threading::RecursiveMutexScopedLock lock (mutex);
+        ReturnAll ();
+        WrappedAllocatorType::DisposeAll (disposer);
+      }
+
+      /**
+       * Destroy all living objects without releasing the memory.
+       */
+      template<typename Disposer>
+      void FreeAll (Disposer& disposer)
+      {
+        CS::Threading::RecursiveMutexScopedLock lock (mutex);
+        ReturnAll ();
+        WrappedAllocatorType::FreeAll (disposer);
+      }
+    public:
+      FixedSizeAllocatorCached (size_t nelem = 32) :
+        WrappedAllocatorType (nelem), threadCache (ThreadExit)
+      {
+      }
+      FixedSizeAllocatorCached (size_t nelem, const Allocator& alloc) :
+        WrappedAllocatorType (nelem, alloc), threadCache (ThreadExit)
+      {
+      }
+      FixedSizeAllocatorCached (FixedSizeAllocatorCached const& other) :
+        WrappedAllocatorType (other), threadCache (ThreadExit)
+      {
+      }
+
+      ~FixedSizeAllocatorCached ()
+      {
+        CS::Threading::RecursiveMutexScopedLock lock (mutex);
+        ReturnAll ();
+        for (size_t i = 0; i < caches.GetSize (); i++)
+          delete caches[i];
+      }
+
+      /// Destroy all chunks allocated.
+      void Empty ()
+      {
+        typename WrappedAllocatorType::DefaultDisposer disposer (*this, true);
+        DisposeAll (disposer);
+      }
+
+      /**
+       * Compact the allocator so that all blocks that are completely unused
+       * are removed.
+       */
+      void Compact ()
+      {
+        CS::Threading::RecursiveMutexScopedLock lock (mutex);
+        ReturnDepot ();
+        ReturnCache (GetCache ());
+        WrappedAllocatorType::Compact ();
+      }
+
+      /**
+       * Return number of allocated elements (potentially slow). Only exact
+       * if no other thread allocates or frees concurrently.
+       */
+      size_t GetAllocatedElems () const
+      {
+        CS::Threading::RecursiveMutexScopedLock lock (mutex);
+        size_t cached = depot.GetSize () * MagazineSize;
+        for (size_t i = 0; i < caches.GetSize (); i++)
+          cached += caches[i]->loadedCount + caches[i]->previousCount;
+        return WrappedAllocatorType::GetAllocatedElems () - cached;
+      }
+
+      /// Allocate a chunk of memory.
+      void* Alloc ()
+      {
+        ThreadCache& cache = GetCache ();
+        if (cache.loadedCount == 0)
+        {
+          if (cache.previousCount > 0)
+          {
+            // The previous magazine is full, use it
+            cache.loaded = cache.previous;
+            cache.loadedCount = cache.previousCount;
+            cache.previous = 0;
+            cache.previousCount = 0;
+          }
+          else
+            Refill (cache);
+        }
+        union
+        {
+          FreeNode* a;
+          void* b;
+        } pun;
+        pun.a = cache.loaded;
+        cache.loaded = cache.loaded->next;
+        cache.loadedCount--;
+#ifdef CS_FIXEDSIZEALLOC_DEBUG
+        memset (pun.b, 0xfa, this->elsize);
+#endif
+        return pun.b;
+      }
+
+      /**
+       * Deallocate a chunk of memory. It is safe to provide a null pointer.
+       */
+      void Free (void* p)
+      {
+        typename WrappedAllocatorType::DefaultDisposer disposer (*this, true);
+        Free (disposer, p);
+      }
+      /**
+       * Try to delete a chunk of memory. Usage is the same as Free(), the
+       * difference being that \c false is returned if the deallocation failed
+       * (the reason is most likely that the memory was not allocated by the
+       * allocator).
+       */
+      bool TryFree (void* p)
+      {
+        typename WrappedAllocatorType::DefaultDisposer disposer (*this, true);
+        return TryFree (disposer, p);
+      }
+      /// Query number of elements per block.
+      size_t GetBlockElements () const { return this->elcount; }
+
+      /**\name Functions for useability as a allocator template parameter
+       * @{ */
+      void* Alloc (size_t n)
+      {
+        CS_ASSERT (n == Size);
+        (void)n;
+        return Alloc ();
+      }
+      void SetMemTrackerInfo (const char* /*info*/) { }
+      /** @} */
+    };
   } // namespace Memory
 } // namespace CS
 
@@ -0,0 +1,792 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_FLATHASH_H__
+#define __CS_CSUTIL_FLATHASH_H__
+
+/**\file
+ * Open addressing hash table with the interface of csHash.
+ */
+
+#include "csextern.h"
+#include "csutil/bitops.h"
+#include "csutil/hash.h"
+
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
+/**\addtogroup util_containers
+ * @{ */
+
+namespace CS
+{
+  namespace Container
+  {
+    /**
+     * A hash table with the same interface as csHash, which stores its
+     * elements in one flat array (open addressing) instead of an array of
+     * buckets. Lookups touch fewer cache lines and inserting doesn't allocate
+     * unless the table grows, so it is usually faster than csHash, and code
+     * using csHash can switch to it by changing a typedef.
+     *
+     * The slots are divided into groups of 16. Each slot has a control byte
+     * which holds 7 bits of the hash of its key, or marks the slot empty. A
+     * lookup compares the control bytes of a whole group at once (with SSE2
+     * where available) and only compares keys of slots with the same 7 bits.
+     * Keys which don't fit into the group of their hash go into the next
+     * groups; each group counts the keys which went past it while it was
+     * full. A lookup stops at the first group with a count of 0, and deleting
+     * decrements the counts again, so deleted slots are simply empty and no
+     * "deleted" markers accumulate.
+     *
+     * Like csHash, multiple values can be stored for a key with Put().
+     * Elements don't move unless the table grows, but pointers to values are
+     * invalidated by growing.
+     */
+    template <class T, class K = unsigned int,
+      class ArrayMemoryAlloc = CS::Memory::AllocatorMalloc>
+    class FlatHash
+    {
+    public:
+      typedef FlatHash<T, K, ArrayMemoryAlloc> ThisType;
+      typedef T ValueType;
+      typedef K KeyType;
+      typedef ArrayMemoryAlloc AllocatorType;
+
+    protected:
+      typedef HashElement<T, K> Element;
+
+      /// Number of slots in a group
+      static const size_t GroupSize = 16;
+      /// Control byte of an empty slot; full slots have the high bit clear
+      static const uint8 EmptySlot = 0x80;
+
+      /// Control bytes, followed by the overflow count of each group
+      uint8* Control;
+      Element* Elements;
+      /// Number of groups minus 1; number of groups is a power of 2
+      size_t GroupMask;
+      size_t Size;
+      /// Number of elements after which the table grows
+      size_t MaxLoad;
+      /// Number of groups allocated on the first insertion
+      size_t InitGroups;
+      ArrayMemoryAlloc Allocator;
+
+      size_t NumSlots () const
+      { return Control ? (GroupMask + 1) * GroupSize : 0; }
+
+      uint32* Overflow () const
+      {
+        return reinterpret_cast<uint32*> (Control
+          + (GroupMask + 1) * GroupSize);
+      }
+
+      /* Mix the hash of a key: csHashComputer results of pointers and
+         integers have few significant low bits. The result selects the first
+         group with its low bits and the control byte with its top 7 bits. */
+      static uint32 HashKey (const K& key)
+      {
+        uint64 m = uint64 (csHashComputer<K>::ComputeHash (key))
+          * CONST_UINT64 (0x9E3779B97F4A7C15);
+        return uint32 (m >> 32) ^ uint32 (m);
+      }
+      static uint8 Tag (uint32 hash)
+      { return uint8 (hash >> 25); }
+
+      /// Bit mask of the slots in a group with the given control byte
+      uint32 Match (size_t group, uint8 tag) const
+      {
+        const uint8* ctrl = Control + group * GroupSize;
+      #ifdef CS_SUPPORTS_SSE2
+        __m128i bytes = _mm_loadu_si128 ((const __m128i*)ctrl);
+        return uint32 (_mm_movemask_epi8 (_mm_cmpeq_epi8 (bytes,
+          _mm_set1_epi8 (char (tag)))));
+      #else
+        uint32 mask = 0;
+        for (size_t i = 0; i < GroupSize; i++)
+          if (ctrl[i] == tag) mask |= 1 << i;
+        return mask;
+      #endif
+      }
+
+      /// Bit mask of the empty slots in a group
+      uint32 MatchEmpty (size_t group) const
+      {
+        const uint8* ctrl = Control + group * GroupSize;
+      #ifdef CS_SUPPORTS_SSE2
+        return uint32 (_mm_movemask_epi8 (_mm_loadu_si128 (
+          (const __m128i*)ctrl)));
+      #else
+        uint32 mask = 0;
+        for (size_t i = 0; i < GroupSize; i++)
+          if (ctrl[i] & EmptySlot) mask |= 1 << i;
+        return mask;
+      #endif
+      }
+
+      static size_t LowestBit (uint32 mask)
+      {
+        unsigned long index;
+        CS::Utility::BitOps::ScanBitForward (mask, index);
+        return size_t (index);
+      }
+
+      /**
+       * Find the next slot with the key, starting at slot \a start of
+       * \a group. Updates \a group, \a start and \a probes (the number of
+       * groups visited) so the search can be continued.
+       */
+      size_t Seek (const K& key, uint8 tag, size_t& group, size_t& start,
+        size_t& probes) const
+      {
+        if (!Control) return csArrayItemNotFound;
+        const uint32* overflow = Overflow ();
+        while (probes <= GroupMask)
+        {
+          uint32 m = Match (group, tag) & (0xffffffff << start);
+          while (m != 0)
+          {
+            size_t i = LowestBit (m);
+            size_t slot = group * GroupSize + i;
+            if (csComparator<K, K>::Compare (Elements[slot].GetKey (),
+                key) == 0)
+            {
+              start = i + 1;
+              return slot;
+            }
+            m &= m - 1;
+          }
+          if (overflow[group] == 0) break;
+          group = (group + 1) & GroupMask;
+          start = 0;
+          probes++;
+        }
+        return csArrayItemNotFound;
+      }
+
+      /// Find the first slot with the key
+      size_t FindSlot (const K& key) const
+      {
+        if (!Control) return csArrayItemNotFound;
+        uint32 hash = HashKey (key);
+        size_t group = hash & GroupMask, start = 0, probes = 0;
+        return Seek (key, Tag (hash), group, start, probes);
+      }
+
+      /// Allocate tables with \a numGroups groups
+      void Allocate (size_t numGroups)
+      {
+        size_t ctrlSize = numGroups * (GroupSize + sizeof (uint32));
+        Control = (uint8*)Allocator.Alloc (ctrlSize);
+        memset (Control, EmptySlot, numGroups * GroupSize);
+        GroupMask = numGroups - 1;
+        memset (Overflow (), 0, numGroups * sizeof (uint32));
+        Elements = (Element*)Allocator.Alloc (
+          numGroups * GroupSize * sizeof (Element));
+        MaxLoad = numGroups * GroupSize * 7 / 8;
+      }
+
+      /// Store an element in a free slot. The table must have room for it.
+      size_t Insert (uint32 hash, const K& key, const T& value)
+      {
+        uint32* overflow = Overflow ();
+        size_t group = hash & GroupMask;
+        while (true)
+        {
+          uint32 empty = MatchEmpty (group);
+          if (empty != 0)
+          {
+            size_t slot = group * GroupSize + LowestBit (empty);
+            new (Elements + slot) Element (key, value);
+            Control[slot] = Tag (hash);
+            return slot;
+          }
+          overflow[group]++;
+          group = (group + 1) & GroupMask;
+        }
+      }
+
+      /// Double the number of groups and move all elements
+      void Grow ()
+      {
+        uint8* oldControl = Control;
+        Element* oldElements = Elements;
+        size_t oldSlots = NumSlots ();
+        Allocate (Control ? (GroupMask + 1) * 2 : InitGroups);
+        for (size_t i = 0; i < oldSlots; i++)
+        {
+          if (oldControl[i] & EmptySlot) continue;
+          Element& e = oldElements[i];
+          Insert (HashKey (e.GetKey ()), e.GetKey (), e.GetValue ());
+          e.~Element ();
+        }
+        if (oldControl)
+        {
+          Allocator.Free (oldControl);
+          Allocator.Free (oldElements);
+        }
+      }
+
+      /// Add an element, growing the table if needed
+      T& Add (const K& key, const T& value)
+      {
+        size_t slot;
+        if (Size >= MaxLoad)
+        {
+          // The key or value may be in the table, copy before growing
+          Element e (key, value);
+          Grow ();
+          slot = Insert (HashKey (e.GetKey ()), e.GetKey (), e.GetValue ());
+        }
+        else
+          slot = Insert (HashKey (key), key, value);
+        Size++;
+        return Elements[slot].GetValue ();
+      }
+
+      /// Remove the element in a slot
+      void Remove (size_t slot)
+      {
+        Element& e = Elements[slot];
+        uint32* overflow = Overflow ();
+        const size_t slotGroup = slot / GroupSize;
+        for (size_t group = HashKey (e.GetKey ()) & GroupMask;
+             group != slotGroup; group = (group + 1) & GroupMask)
+          overflow[group]--;
+        e.~Element ();
+        Control[slot] = EmptySlot;
+        Size--;
+      }
+
+      /// Skip empty slots starting at \a slot
+      size_t SkipEmpty (size_t slot) const
+      {
+        const size_t numSlots = NumSlots ();
+        while ((slot < numSlots) && (Control[slot] & EmptySlot)) slot++;
+        return slot;
+      }
+
+      void Copy (const FlatHash& o)
+      {
+        if (!o.Control) return;
+        Allocate (o.GroupMask + 1);
+        memcpy (Control, o.Control,
+          (GroupMask + 1) * (GroupSize + sizeof (uint32)));
+        const size_t numSlots = NumSlots ();
+        for (size_t i = 0; i < numSlots; i++)
+        {
+          if (!(Control[i] & EmptySlot))
+            new (Elements + i) Element (o.Elements[i]);
+        }
+        Size = o.Size;
+      }
+
+      void Free ()
+      {
+        if (!Control) return;
+        const size_t numSlots = NumSlots ();
+        for (size_t i = 0; i < numSlots; i++)
+        {
+          if (!(Control[i] & EmptySlot)) Elements[i].~Element ();
+        }
+        Allocator.Free (Control);
+        Allocator.Free (Elements);
+        Control = 0;
+        Elements = 0;
+        GroupMask = 0;
+        Size = 0;
+        MaxLoad = 0;
+      }
+
+    public:
+      /**
+       * Construct a hash table with room for \a size elements before it
+       * grows. Memory is only allocated when the first element is added.
+       * \remarks \a grow_rate and \a max_size are accepted for compatibility
+       *   with csHash and ignored: the table grows when it is 7/8 full.
+       */
+      FlatHash (size_t size = 23, size_t grow_rate = 5,
+        size_t max_size = 20000)
+        : Control (0), Elements (0), GroupMask (0), Size (0), MaxLoad (0),
+          InitGroups (1)
+      {
+        (void)grow_rate; (void)max_size;
+        while (InitGroups * GroupSize * 7 / 8 < size) InitGroups *= 2;
+      }
+
+      /// Copy constructor.
+      FlatHash (const FlatHash& o)
+        : Control (0), Elements (0), GroupMask (0), Size (0), MaxLoad (0),
+          InitGroups (o.InitGroups), Allocator (o.Allocator)
+      {
+        Copy (o);
+      }
+
+      /// Assignment operator.
+      FlatHash& operator= (const FlatHash& o)
+      {
+        if (&o == this) return *this;
+        Free ();
+        InitGroups = o.InitGroups;
+        Copy (o);
+        return *this;
+      }
+
+      ~FlatHash () { Free (); }
+
+      /**
+       * Add an element to the hash table.
+       * \remarks If \a key is already present, does NOT replace the existing
+       *   value, but merely adds \a value as an additional value of \a key.
+       *   To replace an existing value use PutUnique().
+       */
+      T& Put (const K& key, const T &value)
+      {
+        return Add (key, value);
+      }
+
+      /// Get all the elements, or empty if there are none.
+      csArray<T> GetAll () const
+      {
+        csArray<T> ret (Size);
+        ConstGlobalIterator itr = GetIterator ();
+        while (itr.HasNext ()) ret.Push (itr.Next ());
+        return ret;
+      }
+
+      /// Get all the elements with the given key, or empty if there are none.
+      csArray<T> GetAll (const K& key) const
+      {
+        return GetAll<typename csArray<T>::ElementHandlerType,
+          typename csArray<T>::AllocatorType> (key);
+      }
+
+      /// Get all the elements with the given key, or empty if there are none.
+      template<typename H, typename M>
+      csArray<T, H, M> GetAll (const K& key) const
+      {
+        csArray<T, H, M> ret;
+        ConstIterator itr = GetIterator (key);
+        while (itr.HasNext ()) ret.Push (itr.Next ());
+        return ret;
+      }
+
+      /// Add an element to the hash table, overwriting if the key exists.
+      T& PutUnique (const K& key, const T &value)
+      {
+        size_t slot = FindSlot (key);
+        if (slot != csArrayItemNotFound)
+        {
+          T& v = Elements[slot].GetValue ();
+          v = value;
+          return v;
+        }
+        return Add (key, value);
+      }
+
+      /// Returns whether at least one element matches the given key.
+      bool Contains (const K& key) const
+      { return FindSlot (key) != csArrayItemNotFound; }
+
+      /**
+       * Returns whether at least one element matches the given key.
+       * \remarks Equivalent to Contains(key).
+       */
+      bool In (const K& key) const
+      { return Contains (key); }
+
+      /**
+       * Get a pointer to the first element matching the given key,
+       * or 0 if there is none.
+       */
+      const T* GetElementPointer (const K& key) const
+      {
+        size_t slot = FindSlot (key);
+        return (slot != csArrayItemNotFound) ? &Elements[slot].GetValue () : 0;
+      }
+
+      /**
+       * Get a pointer to the first element matching the given key,
+       * or 0 if there is none.
+       */
+      T* GetElementPointer (const K& key)
+      {
+        size_t slot = FindSlot (key);
+        return (slot != csArrayItemNotFound) ? &Elements[slot].GetValue () : 0;
+      }
+
+      /// h["key"] shorthand notation for h.GetElementPointer ("key")
+      T* operator[] (const K& key)
+      { return GetElementPointer (key); }
+
+      /**
+       * Get the first element matching the given key, or \a fallback if
+       * there is none.
+       */
+      const T& Get (const K& key, const T& fallback) const
+      {
+        size_t slot = FindSlot (key);
+        return (slot != csArrayItemNotFound) ? Elements[slot].GetValue ()
+          : fallback;
+      }
+
+      /**
+       * Get the first element matching the given key, or \a fallback if
+       * there is none.
+       */
+      T& Get (const K& key, T& fallback)
+      {
+        size_t slot = FindSlot (key);
+        return (slot != csArrayItemNotFound) ? Elements[slot].GetValue ()
+          : fallback;
+      }
+
+      /**
+       * Get the first element matching the given key, or, if there is
+       * none, insert \a default and return a reference to the new entry.
+       */
+      T& GetOrCreate (const K& key, const T& defaultValue = T())
+      {
+        size_t slot = FindSlot (key);
+        if (slot != csArrayItemNotFound) return Elements[slot].GetValue ();
+        return Add (key, defaultValue);
+      }
+
+      /// Delete all the elements.
+      void DeleteAll () { Free (); }
+
+      /// Delete all the elements. (Idiomatic alias for DeleteAll().)
+      void Empty () { DeleteAll (); }
+
+      /// Delete all the elements matching the given key.
+      bool DeleteAll (const K& key)
+      {
+        bool ret = false;
+        size_t slot;
+        /* Elements don't move when one is deleted, so searching again from
+           the start finds the remaining ones. */
+        while ((slot = FindSlot (key)) != csArrayItemNotFound)
+        {
+          Remove (slot);
+          ret = true;
+        }
+        return ret;
+      }
+
+      /// Delete all the elements matching the given key and value.
+      bool Delete (const K& key, const T &value)
+      {
+        if (!Control) return false;
+        bool ret = false;
+        uint32 hash = HashKey (key);
+        size_t group = hash & GroupMask, start = 0, probes = 0;
+        size_t slot;
+        while ((slot = Seek (key, Tag (hash), group, start, probes))
+          != csArrayItemNotFound)
+        {
+          if (csComparator<T, T>::Compare (Elements[slot].GetValue (),
+              value) == 0)
+          {
+            /* Removing only changes counts of groups before the slot, the
+               search continues with the count of the slot's group. */
+            Remove (slot);
+            ret = true;
+          }
+        }
+        return ret;
+      }
+
+      /// Get the number of elements in the hash.
+      size_t GetSize () const
+      { return Size; }
+
+      /**
+       * Return true if the hash is empty.
+       * \remarks Rigidly equivalent to <tt>return GetSize() == 0</tt>, but
+       *   more idiomatic.
+       */
+      bool IsEmpty () const
+      { return GetSize () == 0; }
+
+      /// An iterator over the elements with a given key.
+      class Iterator
+      {
+      private:
+        FlatHash* hash;
+        K key;
+        uint8 tag;
+        size_t group, start, probes, slot;
+
+      protected:
+        Iterator (FlatHash* hash0, const K& key0) : hash (hash0), key (key0)
+        { Reset (); }
+
+        friend class FlatHash;
+      public:
+        /// Returns whether the hash has more elements with the key.
+        bool HasNext () const
+        { return slot != csArrayItemNotFound; }
+
+        /// Get the next element's value.
+        T& Next ()
+        {
+          T& ret = hash->Elements[slot].GetValue ();
+          slot = hash->Seek (key, tag, group, start, probes);
+          return ret;
+        }
+
+        /// Move the iterator back to the first element.
+        void Reset ()
+        {
+          uint32 h = HashKey (key);
+          tag = Tag (h);
+          group = h & hash->GroupMask;
+          start = probes = 0;
+          slot = hash->Seek (key, tag, group, start, probes);
+        }
+      };
+      friend class Iterator;
+
+      /// An iterator over all elements.
+      class GlobalIterator
+      {
+      private:
+        FlatHash* hash;
+        size_t slot;
+
+      protected:
+        GlobalIterator (FlatHash* hash0) : hash (hash0)
+        { Reset (); }
+
+        friend class FlatHash;
+      public:
+        /// Empty constructor.
+        GlobalIterator () : hash (0), slot (0) {}
+
+        /// Returns whether the hash has more elements.
+        bool HasNext () const
+        { return hash && (slot < hash->NumSlots ()); }
+
+        /// Advance the iterator of one step
+        void Advance ()
+        { slot = hash->SkipEmpty (slot + 1); }
+
+        /// Get the next element's value, don't move the iterator.
+        T& NextNoAdvance ()
+        { return hash->Elements[slot].GetValue (); }
+
+        /// Get the next element's value.
+        T& Next ()
+        {
+          T& ret = NextNoAdvance ();
+          Advance ();
+          return ret;
+        }
+
+        /// Get the next element's value and key, don't move the iterator.
+        T& NextNoAdvance (K& key)
+        {
+          key = hash->Elements[slot].GetKey ();
+          return NextNoAdvance ();
+        }
+
+        /// Get the next element's value and key.
+        T& Next (K& key)
+        {
+          key = hash->Elements[slot].GetKey ();
+          return Next ();
+        }
+
+        /// Return a tuple of the value and key.
+        const csTuple2<T, K> NextTuple ()
+        {
+          csTuple2<T, K> t (NextNoAdvance (),
+            hash->Elements[slot].GetKey ());
+          Advance ();
+          return t;
+        }
+
+        /// Move the iterator back to the first element.
+        void Reset ()
+        { slot = hash->SkipEmpty (0); }
+      };
+      friend class GlobalIterator;
+
+      /// A const iterator over the elements with a given key.
+      class ConstIterator
+      {
+      private:
+        const FlatHash* hash;
+        K key;
+        uint8 tag;
+        size_t group, start, probes, slot;
+
+      protected:
+        ConstIterator (const FlatHash* hash0, const K& key0)
+          : hash (hash0), key (key0)
+        { Reset (); }
+
+        friend class FlatHash;
+      public:
+        /// Returns whether the hash has more elements with the key.
+        bool HasNext () const
+        { return slot != csArrayItemNotFound; }
+
+        /// Get the next element's value.
+        const T& Next ()
+        {
+          const T& ret = hash->Elements[slot].GetValue ();
+          slot = hash->Seek (key, tag, group, start, probes);
+          return ret;
+        }
+
+        /// Move the iterator back to the first element.
+        void Reset ()
+        {
+          uint32 h = HashKey (key);
+          tag = Tag (h);
+          group = h & hash->GroupMask;
+          start = probes = 0;
+          slot = hash->Seek (key, tag, group, start, probes);
+        }
+      };
+      friend class ConstIterator;
+
+      /// A const iterator over all elements.
+      class ConstGlobalIterator
+      {
+      private:
+        const FlatHash* hash;
+        size_t slot;
+
+      protected:
+        ConstGlobalIterator (const FlatHash* hash0) : hash (hash0)
+        { Reset (); }
+
+        friend class FlatHash;
+      public:
+        /// Empty constructor.
+        ConstGlobalIterator () : hash (0), slot (0) {}
+
+        /// Returns whether the hash has more elements.
+        bool HasNext () const
+        { return hash && (slot < hash->NumSlots ()); }
+
+        /// Advance the iterator of one step
+        void Advance ()
+        { slot = hash->SkipEmpty (slot + 1); }
+
+        /// Get the next element's value, don't move the iterator.
+        const T& NextNoAdvance ()
+        { return hash->Elements[slot].GetValue (); }
+
+        /// Get the next element's value.
+        const T& Next ()
+        {
+          const T& ret = NextNoAdvance ();
+          Advance ();
+          return ret;
+        }
+
+        /// Get the next element's value and key, don't move the iterator.
+        const T& NextNoAdvance (K& key)
+        {
+          key = hash->Elements[slot].GetKey ();
+          return NextNoAdvance ();
+        }
+
+        /// Get the next element's value and key.
+        const T& Next (K& key)
+        {
+          key = hash->Elements[slot].GetKey ();
+          return Next ();
+        }
+
+        /// Return a tuple of the value and key.
+        const csTuple2<T, K> NextTuple ()
+        {
+          csTuple2<T, K> t (NextNoAdvance (),
+            hash->Elements[slot].GetKey ());
+          Advance ();
+          return t;
+        }
+
+        /// Move the iterator back to the first element.
+        void Reset ()
+        { slot = hash->SkipEmpty (0); }
+      };
+      friend class ConstGlobalIterator;
+
+      /// Delete the element pointed by the iterator. This is safe for this
+      /// iterator, not for the others.
+      void DeleteElement (GlobalIterator& iterator)
+      {
+        Remove (iterator.slot);
+        iterator.slot = SkipEmpty (iterator.slot);
+      }
+
+      /// Delete the element pointed by the iterator. This is safe for this
+      /// iterator, not for the others.
+      void DeleteElement (ConstGlobalIterator& iterator)
+      {
+        Remove (iterator.slot);
+        iterator.slot = SkipEmpty (iterator.slot);
+      }
+
+      /**
+       * Return an iterator for the hash, to iterate only over the elements
+       * with the given key.
+       * \warning Modifying the hash (except with DeleteElement()) while you
+       *   have open iterators will result in undefined behaviour.
+       */
+      Iterator GetIterator (const K& key)
+      { return Iterator (this, key); }
+
+      /**
+       * Return an iterator for the hash, to iterate over all elements.
+       * \warning Modifying the hash (except with DeleteElement()) while you
+       *   have open iterators will result in undefined behaviour.
+       */
+      GlobalIterator GetIterator ()
+      { return GlobalIterator (this); }
+
+      /**
+       * Return a const iterator for the hash, to iterate only over the
+       * elements with the given key.
+       * \warning Modifying the hash (except with DeleteElement()) while you
+       *   have open iterators will result in undefined behaviour.
+       */
+      ConstIterator GetIterator (const K& key) const
+      { return ConstIterator (this, key); }
+
+      /**
+       * Return a const iterator for the hash, to iterate over all elements.
+       * \warning Modifying the hash (except with DeleteElement()) while you
+       *   have open iterators will result in undefined behaviour.
+       */
+      ConstGlobalIterator GetIterator () const
+      { return ConstGlobalIterator (this); }
+    };
+  } // namespace Container
+} // namespace CS
+
+/** @} */
+
+#endif // __CS_CSUTIL_FLATHASH_H__
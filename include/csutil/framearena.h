@@ -0,0 +1,195 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_CSUTIL_FRAMEARENA_H__
+#define __CS_CSUTIL_FRAMEARENA_H__
+
+/**\file
+ * Linear allocator for data living only for a frame.
+ */
+
+#include "csextern.h"
+#include "csutil/array.h"
+#include "csutil/noncopyable.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/threading/tls.h"
+
+/**\addtogroup util_memory
+ * @{ */
+
+namespace CS
+{
+  namespace Memory
+  {
+    /**
+     * Linear ("bump") allocator for transient per-frame data.
+     * Allocations are taken from large blocks by just advancing an offset;
+     * individual allocations are never freed. Instead, all memory is
+     * released in bulk by NewFrame(). The blocks are kept for reuse, so
+     * after a few frames no more system allocations are needed.
+     *
+     * Every thread allocates from its own set of blocks, so Alloc() can be
+     * used from the threads of a job queue without locking.
+     *
+     * Two lifetimes are supported:
+     * - Memory from Alloc() is valid until the next NewFrame().
+     * - Memory from AllocDoubleBuffered() is valid until the NewFrame()
+     *   after the next one, so data created in one frame can still be used
+     *   while the next frame is set up.
+     *
+     * \remarks NewFrame() must not be called while other threads allocate
+     *   from the arena.
+     * \remarks The blocks of a thread are kept until the arena is destroyed,
+     *   so the threads using an arena should be long-lived ones.
+     */
+    class CS_CRYSTALSPACE_EXPORT FrameArena : private CS::NonCopyable
+    {
+    public:
+      /// Statistics about the allocations of a frame
+      struct Statistics
+      {
+        /// Number of threads that allocated from the arena so far
+        uint threads;
+        /// Number of allocations made in the frame
+        uint allocations;
+        /// Number of blocks that had to be obtained from the system heap
+        uint mallocs;
+        /// Bytes allocated in the frame
+        size_t used;
+        /// Largest number of bytes allocated in any single frame
+        size_t highWater;
+        /// Bytes held in blocks by all threads
+        size_t reserved;
+
+        Statistics ();
+      };
+
+      /**
+       * Construct. \a blockSize is the size of the blocks obtained from the
+       * system heap; larger allocations get blocks of their own.
+       */
+      FrameArena (size_t blockSize = 64*1024);
+      ~FrameArena ();
+
+      /// Allocate memory valid until the next NewFrame().
+      CS_ATTRIBUTE_MALLOC void* Alloc (size_t size);
+      /// Allocate memory valid until the second NewFrame() from now.
+      CS_ATTRIBUTE_MALLOC void* AllocDoubleBuffered (size_t size);
+
+      /**
+       * Start a new frame: release memory allocated with Alloc() in the last
+       * frame and with AllocDoubleBuffered() in the frame before that.
+       * The statistics of the frame that ended are available with
+       * GetStatistics() afterwards.
+       */
+      void NewFrame ();
+
+      /// Get the number of NewFrame() calls so far.
+      uint GetFrameNumber () const { return frameNumber; }
+
+      /// Get the statistics of the last frame ended by NewFrame().
+      const Statistics& GetStatistics () const { return stats; }
+    private:
+      struct Block
+      {
+        Block* next;
+        size_t size;
+      };
+      // A chain of blocks allocated from linearly
+      struct Pool
+      {
+        Block* first;
+        Block* current;
+        size_t offset;
+
+        Pool () : first (0), current (0), offset (0) {}
+        void Reset ();
+        void FreeBlocks ();
+      };
+      // The blocks and counters of one thread
+      struct ThreadData
+      {
+        Pool frame;
+        Pool doubleBuffered[2];
+        uint allocations;
+        uint mallocs;
+        size_t used;
+        size_t reserved;
+
+        ThreadData () : allocations (0), mallocs (0), used (0), reserved (0) {}
+      };
+
+      size_t blockSize;
+      uint frameNumber;
+      CS::Threading::ThreadLocalBase threadData;
+      CS::Threading::Mutex threadsLock;
+      csArray<ThreadData*> threads;
+      Statistics stats;
+
+      ThreadData& GetThreadData ();
+      void* Alloc (ThreadData& thread, Pool& pool, size_t size);
+    };
+
+    /**
+     * Memory allocator taking memory from a FrameArena, for use with
+     * containers like csArray. Freeing memory does nothing; it is reclaimed
+     * by FrameArena::NewFrame(), so containers using this allocator must not
+     * live longer than the current frame.
+     *
+     * A default constructed allocator isn't associated with an arena and
+     * uses the normal heap instead.
+     */
+    class AllocatorFrameArena
+    {
+      FrameArena* arena;
+    public:
+      AllocatorFrameArena (FrameArena* arena = 0) : arena (arena) {}
+
+      /// Allocate a block of memory of size \p n.
+      CS_ATTRIBUTE_MALLOC void* Alloc (const size_t n)
+      {
+        return arena ? arena->Alloc (n) : cs_malloc (n);
+      }
+      /// Free the block \p p.
+      void Free (void* p)
+      {
+        if (!arena) cs_free (p);
+      }
+      /**
+       * Resize the allocated block \p p to size \p newSize. Fails for memory
+       * from an arena, as the old size isn't known; containers fall back to
+       * allocating a new block then.
+       */
+      void* Realloc (void* p, size_t newSize)
+      {
+        return arena ? 0 : cs_realloc (p, newSize);
+      }
+      /// Set the information used for memory tracking.
+      void SetMemTrackerInfo (const char* info)
+      {
+        (void)info;
+      }
+      /// Get the arena allocated from
+      FrameArena* GetArena () const { return arena; }
+    };
+  } // namespace Memory
+} // namespace CS
+
+/** @} */
+
+#endif // __CS_CSUTIL_FRAMEARENA_H__
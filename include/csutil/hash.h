@@ -120,7 +120,8 @@ namespace CS
  * compared using csComparator<>. You need to provide appropriate 
  * specializations of those templates if you want use non-integral types 
  * (other than const char* and csString for which appropriate specializations
- * are already provided) or special hash algorithms. 
+ * are already provided) or special hash algorithms.
+ * \sa CS::Container::FlatHash, a faster variant with the same interface
  */
 template <class T, class K = unsigned int, 
   class ArrayMemoryAlloc = CS::Memory::AllocatorMalloc,
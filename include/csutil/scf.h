@@ -275,6 +275,7 @@ enum
   SCF_VERBOSE_PLUGIN_LOAD     = 1 << 1, ///< Plugins loaded and unloaded.
   SCF_VERBOSE_PLUGIN_REGISTER = 1 << 2, ///< Plugins discovered and registered.
   SCF_VERBOSE_CLASS_REGISTER  = 1 << 3, ///< Classes registered within plugins.
+  SCF_VERBOSE_PLUGIN_TIMING   = 1 << 4, ///< Time spent scanning for plugins.
   SCF_VERBOSE_ALL             = ~0      ///< All diagnostic information.
 };
 
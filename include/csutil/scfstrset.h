@@ -25,6 +25,7 @@
 
 #include "csextern.h"
 #include "csutil/scf_implementation.h"
+#include "csutil/concurrentstrset.h"
 #include "csutil/strset.h"
 #include "iutil/strset.h"
 
@@ -41,14 +42,16 @@ namespace CS
  * performance characteristics of simple numeric comparisons.  Rather than
  * performing string comparisons, you instead compare the numeric string ID's.
  *
- * Instances of the set are locked are for concurrent accesses.
+ * Instances of the set can be used concurrently from multiple threads.
+ * Looking up strings and IDs that are already known doesn't lock; see
+ * CS::Utility::ConcurrentStringSet.
  */
 
 template<typename IF>
 class ScfStringSet : public scfImplementation1<ScfStringSet<IF>, IF>
 {
 private:
-  Utility::StringSet<typename IF::TagType, true> set;
+  Utility::ConcurrentStringSet<typename IF::TagType> set;
   typedef StringID<typename IF::TagType> StringIDType;
 
   typedef scfImplementation1<ScfStringSet<IF>, IF> scfImplementationType_;
@@ -134,11 +137,10 @@ public:
 
   /**
    * Return an iterator for the set which iterates over all strings.
-   * \warning Modifying the set while you have open iterators will result
-   *   undefined behaviour.
-   * \warning The iterator will <b>not</b> respect locking of the string set!
+   * \warning Strings added while iterating may or may not be returned.
    */
-  typename Utility::StringSet<typename IF::TagType, true>::GlobalIterator GetIterator () const
+  typename Utility::ConcurrentStringSet<typename IF::TagType>::GlobalIterator
+  GetIterator () const
   { return set.GetIterator(); }
 };
 } // namespace CS
@@ -39,9 +39,11 @@ namespace Utility
  * performing string comparisons, you instead compare the numeric string ID's.
  *
  * If \a Locked is true operations on an instance of the set are locked are
- * for concurrent accesses.
+ * for concurrent accesses. For sets used heavily from multiple threads
+ * ConcurrentStringSet, which doesn't lock lookups, is better suited.
  *
  * \sa csStringHash
+ * \sa ConcurrentStringSet
  * \sa iStringSet
  */
 template<typename Tag, bool Locked = false>
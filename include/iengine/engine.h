@@ -181,7 +181,7 @@ struct iEngineSectorCallback : public virtual iBase
  */
 struct iEngine : public virtual iBase
 {
-  SCF_INTERFACE(iEngine, 8, 0, 1);
+  SCF_INTERFACE(iEngine, 8, 1, 0);
   
   /// Get the iObject for the engine.
   virtual iObject *QueryObject() = 0;
@@ -1369,6 +1369,26 @@ struct iEngine : public virtual iBase
   /// Set default near plane clipping distance for perspective cameras
   virtual void SetDefaultNearClipDistance (float dist) = 0;
   /**@} */
+
+  /**\name Movable updates
+   * @{ */
+  /**
+   * Enable or disable deferred movable updates. When enabled,
+   * iMovable::UpdateMove() only marks a movable as changed. The changes are
+   * processed by FlushMovableUpdates(), which updates the movables in
+   * hierarchy order and calls iMovableListener::MovableChanged() once per
+   * changed movable, no matter how often it was moved.
+   * FlushMovableUpdates() is called by UpdateNewFrame(), so render managers
+   * see all changes before culling.
+   * Can also be enabled with the "Engine.DeferredMovableUpdates"
+   * configuration option. Disabled by default.
+   */
+  virtual void SetDeferredMovableUpdates (bool enable) = 0;
+  /// Get whether movable updates are deferred.
+  virtual bool GetDeferredMovableUpdates () const = 0;
+  /// Process all deferred movable updates now.
+  virtual void FlushMovableUpdates () = 0;
+  /**@} */
 };
 
 /** @} */
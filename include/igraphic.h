@@ -23,6 +23,7 @@
  */
 #include "cssysdef.h"
 #include "igraphic/animimg.h"
+#include "igraphic/deferredimage.h"
 #include "igraphic/dxtcompress.h"
 #include "igraphic/image.h"
 #include "igraphic/imageio.h"
@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_IGRAPHIC_DEFERREDIMAGE_H__
+#define __CS_IGRAPHIC_DEFERREDIMAGE_H__
+
+/**\file
+ * Interface to images decoded in the background
+ */
+
+/**
+ * \addtogroup gfx2d
+ * @{
+ */
+
+#include "csutil/scf.h"
+
+/**
+ * Image loaders that decode the image data in the background implement
+ * this interface on the returned images. It allows to influence the
+ * decoding while it hasn't started yet.
+ * Accessing the image data waits for decoding to finish (or decodes
+ * right away if it hasn't started yet).
+ */
+struct iDeferredImage : public virtual iBase
+{
+  SCF_INTERFACE (iDeferredImage, 0, 0, 1);
+
+  /**
+   * Set the priority with which the image is decoded. Images with a higher
+   * priority are decoded first; images with the same priority in the order
+   * they were loaded. The default priority is 0.
+   */
+  virtual void SetDecodePriority (int priority) = 0;
+
+  /**
+   * Request the image to be decoded at a reduced size, with the width and
+   * height halved (rounding up) \a levels times. This is only possible
+   * if decoding hasn't started yet and the image format supports it.
+   * \return The number of levels the image was actually reduced. The
+   *   dimensions of the image are changed accordingly.
+   */
+  virtual int ReduceDecodeSize (int levels) = 0;
+};
+
+/** @} */
+
+#endif // __CS_IGRAPHIC_DEFERREDIMAGE_H__
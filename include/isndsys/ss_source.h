@@ -66,7 +66,7 @@ struct iSndSysSource : public virtual iBase
  */
 struct iSndSysSourceSoftware : public iSndSysSource
 {
-  SCF_INTERFACE(iSndSysSourceSoftware,2,0,0);
+  SCF_INTERFACE(iSndSysSourceSoftware,2,1,0);
 
   /**
    * Renderer convenience interface - requests the source to fill the
@@ -99,6 +99,22 @@ struct iSndSysSourceSoftware : public iSndSysSource
   //
   // Returns FALSE if the filter is not in the list at the time of the call.
   virtual bool RemoveOutputFilter(SndSysFilterLocation Location, iSndSysSoftwareOutputFilter *pFilter) = 0;
+
+  /**
+   * Renderer convenience interface - estimate how loud the source currently
+   * is at the listener, without mixing anything.
+   *
+   * @return - The volume after distance attenuation, or 0 if the source can
+   *           not be heard (muted, paused or beyond its maximum distance).
+   */
+  virtual float GetAudibility() = 0;
+
+  /**
+   * Renderer convenience interface - advance the source by the given number
+   * of frames without mixing it, used for sources which are not audible
+   * enough to be worth mixing.  The source keeps its place in the stream.
+   */
+  virtual void SkipFrames(size_t frame_count) = 0;
 };
 
 /**
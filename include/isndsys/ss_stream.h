@@ -307,6 +307,28 @@ struct iSndSysStream : public virtual iBase
 
 };
 
+/**
+ * Decoding statistics of a sound stream.
+ *
+ * Streams of compressed sound data may be decoded ahead of playback by a pool
+ * of decoder threads.  If the decoders fall behind, the missing data is
+ * decoded by the sound renderer itself, which counts as an underrun.
+ * Query this interface from an iSndSysStream.
+ */
+struct iSndSysStreamDecodeStats : public virtual iBase
+{
+  SCF_INTERFACE(iSndSysStreamDecodeStats,0,1,0);
+
+  /// Whether this stream is decoded ahead by the decoder threads
+  virtual bool IsDecodingAhead() = 0;
+
+  /// Number of times the renderer had to decode data itself
+  virtual size_t GetUnderrunCount() = 0;
+
+  /// Total time spent decoding this stream, in microseconds
+  virtual csMicroTicks GetDecodeTime() = 0;
+};
+
 /// Sound System stream interface for callback notification
 //
 //  A component wishing to receive notification of Sound Stream events
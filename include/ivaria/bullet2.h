@@ -168,7 +168,7 @@ struct iSoftBody : public virtual iBase
  */
 struct iPhysicalSector : public virtual iBase
 {
-  SCF_INTERFACE (CS::Physics::Bullet2::iPhysicalSector, 1, 0, 0);
+  SCF_INTERFACE (CS::Physics::Bullet2::iPhysicalSector, 1, 1, 0);
 
   /**
    * Save the current state of the dynamic world in a file.
@@ -213,6 +213,35 @@ struct iPhysicalSector : public virtual iBase
    * the dumping.
    */
   virtual void DumpProfile (bool resetProfile = true) = 0;
+
+  /**
+   * Set whether or not the simulation is stepped asynchronously. In this mode,
+   * Step() only starts the simulation of the elapsed time in a background
+   * thread, in fixed steps of the time step defined by
+   * CS::Physics::iPhysicalSector::SetStepParameters(), then returns
+   * immediately. The simulation runs while the frame is rendered and is
+   * finished at the end of the frame, so the physical objects can be accessed
+   * and modified again from the logic phase of the next frame on.
+   *
+   * The attached movables and cameras are interpolated between the states of
+   * the last two simulation steps, which hides the difference between the
+   * fixed simulation rate and the frame rate at the cost of one step of
+   * latency. The default value is false.
+   * \remark Asynchronous stepping is not available in worlds with soft bodies
+   * enabled.
+   */
+  virtual void SetAsynchronousStepping (bool enabled) = 0;
+
+  /// Get whether or not the simulation is stepped asynchronously.
+  virtual bool GetAsynchronousStepping () const = 0;
+
+  /**
+   * Wait until the simulation started by the last asynchronous Step() is
+   * finished. This is only needed in order to read the physical objects
+   * before the end of the current frame; the methods changing the rigid
+   * bodies wait for the simulation on their own.
+   */
+  virtual void WaitForStep () = 0;
 };
 }
 }
@@ -112,7 +112,7 @@ struct iCollider : public virtual iBase
  */
 struct iCollideSystem : public virtual iBase
 {
-  SCF_INTERFACE (iCollideSystem, 2, 2, 1);
+  SCF_INTERFACE (iCollideSystem, 2, 3, 0);
 
   /**
    * Get the ID that the collision detection system prefers for getting
@@ -235,6 +235,30 @@ struct iCollideSystem : public virtual iBase
   	iCollider* collider, const csReversibleTransform* trans,
 	const csVector3& start, const csVector3& end) = 0;
 
+  /**
+   * Collide a collider with many world space segments (or rays) at once.
+   * This is considerably faster than calling CollideSegment() for each
+   * segment when lots of queries are done against the same object, e.g. for
+   * visibility or line of sight tests.
+   * \param collider is the collider to test with.
+   * \param trans is the transform for the object represented by the
+   * collider.
+   * \param starts are the starts of the segments.
+   * \param ends are the ends of the segments (or points on the rays).
+   * \param hits receives, for every segment, the position of the closest
+   *   hit as a fraction of the distance from start to end, or a negative
+   *   value if the segment does not hit the collider.
+   * \param count is the number of segments.
+   * \param rays whether to treat the segments as infinite rays.
+   * \return the number of segments that hit the collider.
+   * \remarks Unlike CollideSegment() this does not update the array with
+   *   intersecting triangles.
+   */
+  virtual size_t CollideSegments (
+  	iCollider* collider, const csReversibleTransform* trans,
+	const csVector3* starts, const csVector3* ends, float* hits,
+	size_t count, bool rays = false) = 0;
+
   /**
    * Get the array of intersection points as returned by CollideRay().
    * Note that the coordinates in the array of triangles is in object
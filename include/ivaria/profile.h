@@ -28,20 +28,43 @@
 #include "csutil/sysfunc.h"
 #include "csutil/threading/atomicops.h"
 
+#if defined(CS_PROCESSOR_X86) && defined(CS_COMPILER_MSVC)
+#include <intrin.h>
+#endif
+
 struct iObjectRegistry;
 
 //#define CS_USE_PROFILER
 
+struct iProfiler;
+
 namespace CS
 {
 namespace Debug
 {
+  /**
+   * Get a profiler timestamp. Uses the CPU time stamp counter where
+   * available, otherwise microseconds. The profiler takes care of converting
+   * the timestamps to real time.
+   */
+  CS_FORCEINLINE uint64 GetProfileTimestamp ()
+  {
+#if defined(CS_PROCESSOR_X86) && defined(CS_COMPILER_GCC)
+    return __builtin_ia32_rdtsc ();
+#elif defined(CS_PROCESSOR_X86) && defined(CS_COMPILER_MSVC)
+    return __rdtsc ();
+#else
+    return csGetMicroTicks ();
+#endif
+  }
+
   class ProfileZone
   {
   public:
     // Methods
     ProfileZone ()
-      : zoneName (0), parentZone (0), totalTime (0), enterCount (0)
+      : zoneName (0), parentZone (0), totalTime (0), enterCount (0),
+      zoneIndex (0), profiler (0)
     {}
 
     ~ProfileZone ()
@@ -52,8 +75,16 @@ namespace Debug
     // Data
     const char* zoneName;
     ProfileZone* parentZone;
+    /**
+     * Time spent in the zone by all threads, in microseconds. Updated by
+     * iProfiler::GetProfileZones().
+     */
     uint64 totalTime;
+    /// Number of times the zone was entered, see \a totalTime.
     uint32 enterCount;
+    /// Index of the zone in the per-thread statistics.
+    size_t zoneIndex;
+    iProfiler* profiler;
   };
 
 
@@ -77,27 +108,91 @@ namespace Debug
     uint64 counterValue;
   };
 
-  class ProfilerZoneScope
+  /// A zone entry or exit recorded by the profiler.
+  struct ProfileEvent
+  {
+    enum Type
+    {
+      /// A zone was entered.
+      Begin,
+      /// A zone was left.
+      End,
+      /// A frame marker, \a zone is null.
+      Frame
+    };
+
+    const ProfileZone* zone;
+    /// Time as returned by GetProfileTimestamp().
+    uint64 time;
+    uint32 type;
+    /// Nesting depth of the zone in its thread.
+    uint32 depth;
+  };
+
+  /**
+   * Profiling data of a single thread. Only ever written by the thread it
+   * belongs to, so no synchronization is needed when entering or leaving
+   * zones.
+   */
+  class ProfileThreadData
   {
   public:
-    ProfilerZoneScope (ProfileZone* zone)
+    /// Accumulated statistics of a zone.
+    struct ZoneStats
+    {
+      /// In timestamp units.
+      uint64 totalTime;
+      uint32 enterCount;
+    };
+
+    /// Statistics indexed by ProfileZone::zoneIndex.
+    ZoneStats* zoneStats;
+    size_t numZoneStats;
+    /// Ring buffer of events, the size is a power of two.
+    ProfileEvent* events;
+    size_t eventMask;
+    /// Number of events ever recorded.
+    size_t eventCount;
+    /// Whether events are recorded. Points to a flag of the profiler.
+    const int32* recording;
+    /// Current nesting depth.
+    uint32 depth;
+    iProfiler* profiler;
+
+    ProfileThreadData ()
+      : zoneStats (0), numZoneStats (0), events (0), eventMask (0),
+      eventCount (0), recording (0), depth (0), profiler (0)
+    {}
+
+    void AddEvent (const ProfileZone* zone, uint64 time, uint32 type)
     {
-      this->zone = zone;
-      startTime = csGetMicroTicks ();
+      ProfileEvent& event = events[eventCount & eventMask];
+      event.zone = zone;
+      event.time = time;
+      event.type = type;
+      event.depth = depth;
+      eventCount++;
     }
 
+    inline void Enter (ProfileZone* zone, uint64 time);
+    inline void Leave (ProfileZone* zone, uint64 startTime, uint64 stopTime);
+  };
+
+  class ProfilerZoneScope
+  {
+  public:
+    inline ProfilerZoneScope (ProfileZone* zone);
+
     ~ProfilerZoneScope ()
     {
-      csMicroTicks stopTime = csGetMicroTicks ();
-
-      zone->enterCount++;
-      zone->totalTime += (stopTime - startTime);
+      thread->Leave (zone, startTime, GetProfileTimestamp ());
     }
 
 
   private:
-    csMicroTicks startTime;
+    uint64 startTime;
     ProfileZone* zone;
+    ProfileThreadData* thread;
   };
 
   inline void ProfilerCounterAdd (ProfileCounter* counter)
@@ -113,7 +208,7 @@ namespace Debug
  */
 struct iProfiler : public virtual iBase
 {
-  SCF_INTERFACE (iProfiler, 3,0,1);
+  SCF_INTERFACE (iProfiler, 3,1,0);
   
   /**\name Deprecated methods
    * \deprecated These methods are present solely for source code 
@@ -147,7 +242,8 @@ struct iProfiler : public virtual iBase
   virtual void Reset () = 0;
 
   /**
-   * Get all profiler zones.
+   * Get all profiler zones. The times and counts of the zones are updated
+   * with the statistics of all threads.
    */
   virtual const csArray<CS::Debug::ProfileZone*>& GetProfileZones () = 0;
   
@@ -171,8 +267,84 @@ struct iProfiler : public virtual iBase
    * Stop logging.
    */
   virtual void StopLogging () = 0;
+
+  /**
+   * Get the profiling data of the calling thread, creating it if needed.
+   * Used by CS::Debug::ProfilerZoneScope.
+   */
+  virtual CS::Debug::ProfileThreadData* GetThreadData () = 0;
+
+  /**
+   * Make room for the statistics of all zones in \a data. Used by
+   * CS::Debug::ProfileThreadData when a zone is left for the first time.
+   */
+  virtual void GrowThreadData (CS::Debug::ProfileThreadData* data) = 0;
+
+  /// Set the name the calling thread is shown with in exported traces.
+  virtual void SetThreadName (const char* name) = 0;
+
+  /**
+   * Enable or disable the recording of zone events. Every thread keeps the
+   * last \a eventsPerThread events in a ring buffer, older events are
+   * overwritten.
+   */
+  virtual void SetEventRecording (bool enable,
+    size_t eventsPerThread = 65536) = 0;
+
+  /// Get whether zone events are recorded.
+  virtual bool GetEventRecording () const = 0;
+
+  /**
+   * Mark the start of a new frame. Recorded as an event for the calling
+   * thread.
+   */
+  virtual void MarkFrame () = 0;
+
+  /**
+   * Write the recorded events of all threads to a file in the Chrome trace
+   * event format (as read by chrome://tracing). Best done while the other
+   * threads are not entering or leaving zones, or the most recent events of
+   * these may be missing.
+   * \param filenamebase Path and basic portion of filename, see
+   *  StartLogging().
+   * \param objreg Object registry, see StartLogging().
+   * \return Whether the file could be written.
+   */
+  virtual bool ExportTrace (const char* filenamebase,
+    iObjectRegistry* objreg) = 0;
 };
 
+namespace CS
+{
+namespace Debug
+{
+  void ProfileThreadData::Enter (ProfileZone* zone, uint64 time)
+  {
+    if (*recording) AddEvent (zone, time, ProfileEvent::Begin);
+    depth++;
+  }
+
+  void ProfileThreadData::Leave (ProfileZone* zone, uint64 startTime,
+                                 uint64 stopTime)
+  {
+    depth--;
+    if (zone->zoneIndex >= numZoneStats)
+      profiler->GrowThreadData (this);
+    ZoneStats& stats = zoneStats[zone->zoneIndex];
+    stats.totalTime += stopTime - startTime;
+    stats.enterCount++;
+    if (*recording) AddEvent (zone, stopTime, ProfileEvent::End);
+  }
+
+  ProfilerZoneScope::ProfilerZoneScope (ProfileZone* zone)
+    : zone (zone), thread (zone->profiler->GetThreadData ())
+  {
+    startTime = GetProfileTimestamp ();
+    thread->Enter (zone, startTime);
+  }
+}
+}
+
 /**
  * Interface to profile factory.
  */
@@ -233,6 +405,15 @@ CS::Debug::ProfilerCounterAdd (CS_DEBUG_Profiler_GetProfileCounter ## name());
   CS_DEBUG_Profiler_GetProfiler ()->StopLogging ();
 #define CS_PROFILER_RESET() \
   CS_DEBUG_Profiler_GetProfiler ()->Reset ();
+#define CS_PROFILER_FRAME_MARKER() \
+  CS_DEBUG_Profiler_GetProfiler ()->MarkFrame ();
+#define CS_PROFILER_SET_THREAD_NAME(name) \
+  CS_DEBUG_Profiler_GetProfiler ()->SetThreadName (name);
+#define CS_PROFILER_START_TRACE() \
+  CS_DEBUG_Profiler_GetProfiler ()->SetEventRecording (true);
+#define CS_PROFILER_STOP_TRACE(filebase, objectreg) \
+  CS_DEBUG_Profiler_GetProfiler ()->SetEventRecording (false); \
+  CS_DEBUG_Profiler_GetProfiler ()->ExportTrace (filebase, objectreg);
 #else
 
 #define CS_DECLARE_PROFILER 
@@ -244,6 +425,10 @@ CS::Debug::ProfilerCounterAdd (CS_DEBUG_Profiler_GetProfileCounter ## name());
 #define CS_PROFILER_START_LOGGING(filebase, objectreg)
 #define CS_PROFILER_STOP_LOGGING()
 #define CS_PROFILER_RESET()
+#define CS_PROFILER_FRAME_MARKER()
+#define CS_PROFILER_SET_THREAD_NAME(name)
+#define CS_PROFILER_START_TRACE()
+#define CS_PROFILER_STOP_TRACE(filebase, objectreg)
 #endif
 
 
@@ -30,6 +30,7 @@
 #include "iutil/array.h"
 
 #include "csgfx/shadervar.h"
+#include "csgfx/shadervarslotmap.h"
 #include "csutil/array.h"
 #include "csutil/bitarray.h"
 #include "csutil/refarr.h"
@@ -61,13 +62,24 @@ struct iShaderManager;
 /**
  * A "shader variable stack".
  * Stores a list of shader variables, indexed by it's name.
+ *
+ * A stack can optionally use a CS::Graphics::ShaderVarSlotMap. It is still
+ * indexed by name, but the variables are stored compactly in the slots the
+ * map gives to the names, so storage only needs to be as large as the number
+ * of slots instead of the number of all shader variable names. The storage
+ * grows when a name gets a slot beyond it; no variable set is ever lost.
+ * Names only get a slot when set with Set(): reading, also through the
+ * non-const operator[], never changes the map.
+ *
+ * To visit all variables of a stack without going over all names, iterate
+ * the slots up to GetSlotCount() with GetSlotVariable() and GetSlotName().
  */
 class csShaderVariableStack
 {
 public:
   /// Construct an empty stack
   csShaderVariableStack ()
-    : varArray (0), size (0), ownArray (false)
+    : varArray (0), size (0), ownArray (false), slotMap (0), slots (0)
   {}
 
   /**
@@ -77,28 +89,19 @@ public:
    * new stack will allocate it's own internal array and copy over the contents.
    */
   csShaderVariableStack (const csShaderVariableStack& other)
-    : size (other.size), ownArray (false)
+    : varArray (0), size (0), ownArray (false), slotMap (0), slots (0)
   {
-    if (other.ownArray)
-    {
-      Setup (size);
-      memcpy (varArray, other.varArray, size * sizeof (csShaderVariable*));
-    }
-    else
-    {
-      varArray = other.varArray;
-    }
+    *this = other;
   }
 
   /// Construct a stack from a preallocated array of shader variables
   csShaderVariableStack (csShaderVariable** va, size_t size)
-    : varArray (va), size (size), ownArray (false)
+    : varArray (va), size (size), ownArray (false), slotMap (0), slots (0)
   {}
   
   ~csShaderVariableStack ()
   {
-    if (ownArray)
-      cs_free (varArray);
+    Release ();
   }
 
   /**
@@ -110,30 +113,45 @@ public:
    */
   csShaderVariableStack& operator= (const csShaderVariableStack& other)
   {
-    if (other.ownArray)
+    if (&other == this) return *this;
+    if (other.slotMap && (other.slots == &other.ownSlots))
+    {
+      Release ();
+      ownSlots.CopyFrom (other.ownSlots);
+      slots = &ownSlots;
+      slotMap = other.slotMap;
+    }
+    else if (other.ownArray)
     {
-      Setup (size);
+      Setup (other.size);
       memcpy (varArray, other.varArray, size * sizeof (csShaderVariable*));
     }
     else
     {
-      if (ownArray)
-	cs_free (varArray);
-      ownArray = false;
-      varArray = other.varArray;
+      Setup (other);
     }
     return *this;
   }
   
-  /// Initialize stack internal storage
-  void Setup (size_t size)
+  /**
+   * Initialize stack internal storage.
+   * \param size Number of names or, if \a slotMap is given, initial number
+   *   of slots.
+   * \param slotMap Optional map to store variables in compact slots.
+   */
+  void Setup (size_t size, CS::Graphics::ShaderVarSlotMap* slotMap = 0)
   {
-    if (ownArray)
-      cs_free (varArray);
+    Release ();
 
-    csShaderVariableStack::size = size;
-    varArray = 0;
+    if (slotMap)
+    {
+      csShaderVariableStack::slotMap = slotMap;
+      ownSlots.Grow (size);
+      slots = &ownSlots;
+      return;
+    }
 
+    csShaderVariableStack::size = size;
     if (size > 0)
     {      
       varArray = (csShaderVariable**)cs_malloc (size * sizeof(csShaderVariable*));
@@ -146,28 +164,47 @@ public:
   /// Initialize stack with external storage
   void Setup (csShaderVariable** stack, size_t size)
   {
-    if (ownArray)
-      cs_free (varArray);
+    Release ();
 
     varArray = stack;
     csShaderVariableStack::size = size;
-    ownArray = false;
+  }
+
+  /**
+   * Initialize stack with external storage for compact slots.
+   * The storage is grown when needed; stacks set up on the same \a slots
+   * share the variables.
+   */
+  void Setup (CS::Graphics::ShaderVarSlots& slots,
+    CS::Graphics::ShaderVarSlotMap* slotMap)
+  {
+    Release ();
+
+    csShaderVariableStack::slots = &slots;
+    csShaderVariableStack::slotMap = slotMap;
   }
 
   /// Initialize stack with external storage taken from another stack
   void Setup (const csShaderVariableStack& stack)
   {
-    if (ownArray)
-      cs_free (varArray);
+    Release ();
 
     varArray = stack.varArray;
     size = stack.size;
-    ownArray = false;
+    slotMap = stack.slotMap;
+    slots = stack.slots;
   }
 
   /// Make a local copy if the array was preallocated.
   void MakeOwnArray ()
   {
+    if (slotMap)
+    {
+      if (slots == &ownSlots) return;
+      ownSlots.CopyFrom (*slots);
+      slots = &ownSlots;
+      return;
+    }
     if (ownArray) return;
     csShaderVariable** newArray =
       (csShaderVariable**)cs_malloc (size * sizeof(csShaderVariable*));
@@ -176,28 +213,115 @@ public:
     ownArray = true;
   }
 
-  /// Get the number of variable slots in the stack
+  /**
+   * Get the number of variable slots in the stack.
+   * For a stack with a slot map this is the number of names the map can
+   * look up; use GetSlotCount() for the size of the storage.
+   */
   inline size_t GetSize () const
   {
-    return size;
+    return slotMap ? slotMap->GetNameCount () : size;
   }
 
-  /// Access a single element in the stack
+  /// Get the number of entries in the storage of the stack
+  inline size_t GetSlotCount () const
+  {
+    return slotMap ? slots->size : size;
+  }
+
+  /// Get the slot map used by the stack, if any
+  CS::Graphics::ShaderVarSlotMap* GetSlotMap () const
+  {
+    return slotMap;
+  }
+
+  /**
+   * Access a single element in the stack.
+   * On a stack with a slot map, this doesn't give a name a slot: the
+   * reference returned for a name without a slot is a scratch copy of null,
+   * so use Set() to set variables on such stacks.
+   */
   csShaderVariable*& operator[] (size_t index)
   {
+    if (slotMap)
+    {
+      size_t slot = slotMap->GetSlot (CS::ShaderVarStringID (
+        CS::StringIDValue (index)));
+      if ((slot != 0) && (slot < slots->size)) return slots->vars[slot];
+      noSlotVar = 0;
+      return noSlotVar;
+    }
     CS_ASSERT(index < size);
     return varArray[index];
   }
 
   csShaderVariable* const& operator[] (size_t index) const
   {
+    if (slotMap)
+    {
+      static csShaderVariable* const noVar = 0;
+      size_t slot = slotMap->GetSlot (CS::ShaderVarStringID (
+        CS::StringIDValue (index)));
+      return ((slot != 0) && (slot < slots->size)) ? slots->vars[slot] : noVar;
+    }
     CS_ASSERT(index < size);
     return varArray[index];
   }
 
+  /**
+   * Set the variable of a name. On a stack with a slot map this gives the
+   * name a slot if needed and grows the storage, so nothing is ever dropped.
+   */
+  void Set (CS::ShaderVarStringID name, csShaderVariable* var)
+  {
+    if (slotMap)
+    {
+      SetSlot (slotMap->Request (name), var);
+      return;
+    }
+    CS_ASSERT(size_t (name) < size);
+    varArray[name] = var;
+  }
+
+  /**
+   * Get the variable in a slot, for iterating the slots up to
+   * GetSlotCount(). Without a slot map the slots are the names.
+   */
+  csShaderVariable* GetSlotVariable (size_t slot) const
+  {
+    if (slotMap) return slots->vars[slot];
+    return varArray[slot];
+  }
+
+  /// Get the name of a slot, see GetSlotVariable().
+  CS::ShaderVarStringID GetSlotName (size_t slot) const
+  {
+    if (slotMap) return slotMap->GetSlotName (slot);
+    return CS::ShaderVarStringID (CS::StringIDValue (slot));
+  }
+
+  /**
+   * Set the variable in a slot of a stack with a slot map, growing the
+   * storage if needed. This is for code which looked up the slots itself,
+   * see CS::Graphics::ShaderVarSlotMap::GetSlot().
+   */
+  void SetSlot (size_t slot, csShaderVariable* var)
+  {
+    CS_ASSERT(slotMap);
+    if (slot == 0) return;
+    if (slot >= slots->size) slots->Grow (slot + 1);
+    slots->vars[slot] = var;
+  }
+
   /// Clear the current array
   void Clear ()
   {
+    if (slotMap)
+    {
+      if (slots->size > 0)
+        memset (slots->vars, 0, sizeof(csShaderVariable*)*slots->size);
+      return;
+    }
     if(varArray && size > 0)
       memset (varArray, 0, sizeof(csShaderVariable*)*size);
   }
@@ -205,6 +329,22 @@ public:
   /// Merge one stack onto the "front" of this one
   void MergeFront (const csShaderVariableStack& other)
   {
+    if (slotMap != other.slotMap)
+    {
+      MergeByName (other, true);
+      return;
+    }
+    if (slotMap)
+    {
+      if (slots == other.slots) return;
+      slots->Grow (other.slots->size);
+      for (size_t i = 1; i < other.slots->size; ++i)
+      {
+        if (!slots->vars[i])
+          slots->vars[i] = other.slots->vars[i];
+      }
+      return;
+    }
     CS_ASSERT(other.size >= size);
     for (size_t i = 0; i < size; ++i)
     {
@@ -216,6 +356,22 @@ public:
   /// Merge one stack onto the "back" of this one
   void MergeBack (const csShaderVariableStack& other)
   {
+    if (slotMap != other.slotMap)
+    {
+      MergeByName (other, false);
+      return;
+    }
+    if (slotMap)
+    {
+      if (slots == other.slots) return;
+      slots->Grow (other.slots->size);
+      for (size_t i = 1; i < other.slots->size; ++i)
+      {
+        if (other.slots->vars[i])
+          slots->vars[i] = other.slots->vars[i];
+      }
+      return;
+    }
     CS_ASSERT(other.size >= size);
     for (size_t i = 0; i < size; ++i)
     {
@@ -233,6 +389,18 @@ public:
    */
   bool Copy (const csShaderVariableStack& other)
   {
+    if (slotMap != other.slotMap)
+    {
+      Clear ();
+      MergeByName (other, false);
+      return true;
+    }
+    if (slotMap)
+    {
+      if (slots == other.slots) return false;
+      slots->CopyFrom (*other.slots);
+      return true;
+    }
     CS_ASSERT(other.size == size);
     if (varArray == other.varArray) return false;
     memcpy (varArray, other.varArray, sizeof(csShaderVariable*)*size);
@@ -242,6 +410,42 @@ private:
   csShaderVariable** varArray;
   size_t size;
   bool ownArray;
+  CS::Graphics::ShaderVarSlotMap* slotMap;
+  /// Slot storage if \a slotMap is set; either external or \a ownSlots
+  CS::Graphics::ShaderVarSlots* slots;
+  /// Internal slot storage
+  CS::Graphics::ShaderVarSlots ownSlots;
+  /// Returned by operator[] for names without a slot
+  csShaderVariable* noSlotVar;
+
+  /// Free internal storage and detach from external storage
+  void Release ()
+  {
+    if (ownArray)
+      cs_free (varArray);
+    varArray = 0;
+    size = 0;
+    ownArray = false;
+    ownSlots.Free ();
+    slots = 0;
+    slotMap = 0;
+  }
+
+  /// Merge a stack with a different layout, going over the slots of \a other
+  void MergeByName (const csShaderVariableStack& other, bool front)
+  {
+    const csShaderVariableStack& self = *this;
+    const size_t numSlots = other.GetSlotCount ();
+    for (size_t s = 0; s < numSlots; ++s)
+    {
+      csShaderVariable* var = other.GetSlotVariable (s);
+      if (!var) continue;
+      CS::ShaderVarStringID name (other.GetSlotName (s));
+      if (!slotMap && (size_t (name) >= size)) continue;
+      if (!front || !self[name])
+        Set (name, var);
+    }
+  }
 };
 //@}
 
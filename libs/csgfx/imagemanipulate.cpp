@@ -18,8 +18,10 @@
 */
 
 #include "cssysdef.h"
+#include <math.h>
 #include "csqint.h"
 #include "csutil/refarr.h"
+#include "csutil/scf_implementation.h"
 #include "csgeom/math.h"
 #include "csgeom/vector3.h"
 #include "csgfx/imageautoconvert.h"
@@ -27,6 +29,83 @@
 
 #include "csgfx/imagemanipulate.h"
 
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
+//---------------------- Parallel processing --------------------------------
+
+namespace
+{
+  /// Queue used to process row bands in parallel, if any
+  iJobQueue* manipJobQueue = 0;
+
+  typedef void (*RowBandFunc) (void* data, uint firstRow, uint numRows);
+
+  /// Runs an operation on a band of rows
+  class RowBandJob : public scfImplementation1<RowBandJob, iJob>
+  {
+    RowBandFunc func;
+    void* data;
+    uint firstRow;
+    uint numRows;
+  public:
+    RowBandJob (RowBandFunc func, void* data, uint firstRow, uint numRows)
+      : scfImplementationType (this), func (func), data (data),
+        firstRow (firstRow), numRows (numRows) {}
+
+    virtual void Run () { func (data, firstRow, numRows); }
+  };
+
+  // Images with fewer pixels than this per band aren't worth splitting
+  static const size_t minBandPixels = 16384;
+  static const uint maxBands = 16;
+
+  /**
+   * Run \a func over \a numRows rows of \a rowPixels pixels each. With a
+   * job queue the rows are split into bands and processed in parallel, the
+   * first band on the calling thread.
+   */
+  static void ProcessRowBands (uint numRows, size_t rowPixels,
+                               RowBandFunc func, void* data)
+  {
+    size_t bands = (size_t (numRows) * rowPixels) / minBandPixels;
+    if (bands > maxBands) bands = maxBands;
+    if (bands > numRows) bands = numRows;
+    if (!manipJobQueue || (bands <= 1))
+    {
+      func (data, 0, numRows);
+      return;
+    }
+
+    const uint bandRows = uint ((numRows + bands - 1) / bands);
+    csRef<RowBandJob> jobs[maxBands];
+    uint numJobs = 0;
+    for (uint row = bandRows; row < numRows; row += bandRows)
+    {
+      jobs[numJobs].AttachNew (new RowBandJob (func, data, row,
+        csMin (bandRows, numRows - row)));
+      manipJobQueue->Enqueue (jobs[numJobs]);
+      numJobs++;
+    }
+    func (data, 0, csMin (bandRows, numRows));
+    for (uint j = 0; j < numJobs; j++)
+      manipJobQueue->PullAndRun (jobs[j]);
+  }
+}
+
+void csImageManipulate::SetJobQueue (iJobQueue* queue)
+{
+  if (queue) queue->IncRef ();
+  if (manipJobQueue) manipJobQueue->DecRef ();
+  manipJobQueue = queue;
+}
+
+iJobQueue* csImageManipulate::GetJobQueue ()
+{
+  return manipJobQueue;
+}
+
 
 csRef<iImage> csImageManipulate::Rescale2D (iImage* source, int newwidth, 
   int newheight)
@@ -246,6 +325,440 @@ csRef<iImage> csImageManipulate::Rescale (iImage* source, int newwidth,
 #define MIPMAP_ALPHA
 #include "mipmap.inc"
 
+//---------------------- Truecolor kernels ----------------------------------
+
+/* These give the same results as the generic functions above for truecolor
+ * images without a key color, but process whole rows, several pixels at a
+ * time with SSE2 if available, and can be run on bands of rows in parallel.
+ */
+
+namespace
+{
+  /// Box filter: every output pixel is the average of 2x2 source pixels.
+  struct BoxMipmapData
+  {
+    const uint32* src;
+    uint w;
+    uint32* dst;
+    uint nw;
+  };
+
+  static inline uint32 AverageOf4 (uint32 p0, uint32 p1, uint32 p2, uint32 p3)
+  {
+    uint32 result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+      uint32 sum = ((p0 >> shift) & 0xff) + ((p1 >> shift) & 0xff)
+        + ((p2 >> shift) & 0xff) + ((p3 >> shift) & 0xff);
+      result |= (sum >> 2) << shift;
+    }
+    return result;
+  }
+
+  static void BoxMipmapRows (void* data, uint firstRow, uint numRows)
+  {
+    const BoxMipmapData& d = *(const BoxMipmapData*)data;
+    for (uint y = firstRow; y < firstRow + numRows; y++)
+    {
+      const uint32* s0 = d.src + 2 * y * d.w;
+      const uint32* s1 = s0 + d.w;
+      uint32* dst = d.dst + y * d.nw;
+      uint x = 0;
+#ifdef CS_SUPPORTS_SSE2
+      const __m128i zero = _mm_setzero_si128 ();
+      for (; x + 4 <= d.nw; x += 4)
+      {
+        __m128 a0 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*)(s0 + 2*x)));
+        __m128 a1 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*)(s0 + 2*x + 4)));
+        __m128 b0 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*)(s1 + 2*x)));
+        __m128 b1 = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*)(s1 + 2*x + 4)));
+        // Separate the left and right pixel of each pair
+        __m128i aEven = _mm_castps_si128 (_mm_shuffle_ps (a0, a1, _MM_SHUFFLE (2, 0, 2, 0)));
+        __m128i aOdd = _mm_castps_si128 (_mm_shuffle_ps (a0, a1, _MM_SHUFFLE (3, 1, 3, 1)));
+        __m128i bEven = _mm_castps_si128 (_mm_shuffle_ps (b0, b1, _MM_SHUFFLE (2, 0, 2, 0)));
+        __m128i bOdd = _mm_castps_si128 (_mm_shuffle_ps (b0, b1, _MM_SHUFFLE (3, 1, 3, 1)));
+        // Sum in 16 bit per channel
+        __m128i lo = _mm_add_epi16 (
+          _mm_add_epi16 (_mm_unpacklo_epi8 (aEven, zero), _mm_unpacklo_epi8 (aOdd, zero)),
+          _mm_add_epi16 (_mm_unpacklo_epi8 (bEven, zero), _mm_unpacklo_epi8 (bOdd, zero)));
+        __m128i hi = _mm_add_epi16 (
+          _mm_add_epi16 (_mm_unpackhi_epi8 (aEven, zero), _mm_unpackhi_epi8 (aOdd, zero)),
+          _mm_add_epi16 (_mm_unpackhi_epi8 (bEven, zero), _mm_unpackhi_epi8 (bOdd, zero)));
+        _mm_storeu_si128 ((__m128i*)(dst + x), _mm_packus_epi16 (
+          _mm_srli_epi16 (lo, 2), _mm_srli_epi16 (hi, 2)));
+      }
+#endif
+      for (; x < d.nw; x++)
+        dst[x] = AverageOf4 (s0[2*x], s0[2*x + 1], s1[2*x], s1[2*x + 1]);
+    }
+  }
+
+  /**
+   * Blur filter: every output pixel is the weighted average of the 3x3
+   * source pixels around it (weights 1-2-1, 2-4-2, 1-2-1). The image
+   * wraps around at the borders.
+   */
+  struct BlurData
+  {
+    const uint32* src;
+    uint w;
+    uint h;
+    uint32* dst;
+  };
+
+  static inline uint32 BlurPixel (const uint32* r1, const uint32* r2,
+    const uint32* r3, uint xl, uint x, uint xr)
+  {
+    uint32 result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+#define C(r, i)   ((r[i] >> shift) & 0xff)
+      uint32 sum = C(r1, xl) + 2*C(r1, x) + C(r1, xr)
+        + 2*(C(r2, xl) + 2*C(r2, x) + C(r2, xr))
+        + C(r3, xl) + 2*C(r3, x) + C(r3, xr);
+#undef C
+      result |= (sum >> 4) << shift;
+    }
+    return result;
+  }
+
+#ifdef CS_SUPPORTS_SSE2
+  /// Sum of left + 2*center + right for 2 pixels in 16 bit per channel
+  static inline __m128i BlurRow (__m128i l, __m128i c, __m128i r)
+  {
+    return _mm_add_epi16 (_mm_add_epi16 (l, r), _mm_slli_epi16 (c, 1));
+  }
+#endif
+
+  static void BlurRows (void* data, uint firstRow, uint numRows)
+  {
+    const BlurData& d = *(const BlurData*)data;
+    const uint w = d.w;
+    for (uint y = firstRow; y < firstRow + numRows; y++)
+    {
+      const uint32* r1 = d.src + ((y == 0) ? d.h - 1 : y - 1) * w;
+      const uint32* r2 = d.src + y * w;
+      const uint32* r3 = d.src + ((y == d.h - 1) ? 0 : y + 1) * w;
+      uint32* dst = d.dst + y * w;
+
+      dst[0] = BlurPixel (r1, r2, r3, w - 1, 0, (w > 1) ? 1 : 0);
+      uint x = 1;
+#ifdef CS_SUPPORTS_SSE2
+      const __m128i zero = _mm_setzero_si128 ();
+      for (; x + 5 <= w; x += 4)
+      {
+        __m128i lo = zero, hi = zero;
+        const uint32* rows[3] = { r1, r2, r3 };
+        for (int r = 0; r < 3; r++)
+        {
+          __m128i pl = _mm_loadu_si128 ((const __m128i*)(rows[r] + x - 1));
+          __m128i pc = _mm_loadu_si128 ((const __m128i*)(rows[r] + x));
+          __m128i pr = _mm_loadu_si128 ((const __m128i*)(rows[r] + x + 1));
+          __m128i rowLo = BlurRow (_mm_unpacklo_epi8 (pl, zero),
+            _mm_unpacklo_epi8 (pc, zero), _mm_unpacklo_epi8 (pr, zero));
+          __m128i rowHi = BlurRow (_mm_unpackhi_epi8 (pl, zero),
+            _mm_unpackhi_epi8 (pc, zero), _mm_unpackhi_epi8 (pr, zero));
+          // The center row has twice the weight
+          if (r == 1)
+          {
+            rowLo = _mm_slli_epi16 (rowLo, 1);
+            rowHi = _mm_slli_epi16 (rowHi, 1);
+          }
+          lo = _mm_add_epi16 (lo, rowLo);
+          hi = _mm_add_epi16 (hi, rowHi);
+        }
+        _mm_storeu_si128 ((__m128i*)(dst + x), _mm_packus_epi16 (
+          _mm_srli_epi16 (lo, 4), _mm_srli_epi16 (hi, 4)));
+      }
+#endif
+      for (; x < w; x++)
+        dst[x] = BlurPixel (r1, r2, r3, x - 1, x, (x == w - 1) ? 0 : x + 1);
+    }
+  }
+
+  /// Unsharp mask: original + strength/256 * (original - blurred)
+  struct SharpenData
+  {
+    const uint8* original;
+    const uint8* blurred;
+    uint8* dst;
+    size_t rowBytes;
+    int strength;
+  };
+
+  static void SharpenRows (void* data, uint firstRow, uint numRows)
+  {
+    const SharpenData& d = *(const SharpenData*)data;
+    const size_t start = firstRow * d.rowBytes;
+    const size_t end = start + numRows * d.rowBytes;
+    const uint8* o = d.original;
+    const uint8* b = d.blurred;
+    uint8* dst = d.dst;
+    size_t i = start;
+#ifdef CS_SUPPORTS_SSE2
+    // The products need 32 bit, which is done with 16 bit multiplications
+    if (d.strength <= 0x7fff)
+    {
+      const __m128i zero = _mm_setzero_si128 ();
+      const __m128i strength = _mm_set1_epi16 ((short)d.strength);
+      for (; i + 16 <= end; i += 16)
+      {
+        __m128i vo = _mm_loadu_si128 ((const __m128i*)(o + i));
+        __m128i vb = _mm_loadu_si128 ((const __m128i*)(b + i));
+        __m128i result[2];
+        for (int half = 0; half < 2; half++)
+        {
+          __m128i o16 = half ? _mm_unpackhi_epi8 (vo, zero) : _mm_unpacklo_epi8 (vo, zero);
+          __m128i b16 = half ? _mm_unpackhi_epi8 (vb, zero) : _mm_unpacklo_epi8 (vb, zero);
+          __m128i diff = _mm_sub_epi16 (o16, b16);
+          __m128i prodLo = _mm_mullo_epi16 (diff, strength);
+          __m128i prodHi = _mm_mulhi_epi16 (diff, strength);
+          __m128i v0 = _mm_add_epi32 (
+            _mm_srai_epi32 (_mm_unpacklo_epi16 (prodLo, prodHi), 8),
+            _mm_unpacklo_epi16 (o16, zero));
+          __m128i v1 = _mm_add_epi32 (
+            _mm_srai_epi32 (_mm_unpackhi_epi16 (prodLo, prodHi), 8),
+            _mm_unpackhi_epi16 (o16, zero));
+          // Saturation clamps to 0..255 in the end
+          result[half] = _mm_packs_epi32 (v0, v1);
+        }
+        _mm_storeu_si128 ((__m128i*)(dst + i),
+          _mm_packus_epi16 (result[0], result[1]));
+      }
+    }
+#endif
+    for (; i < end; i++)
+    {
+      int v = o[i] + ((d.strength * (o[i] - b[i])) >> 8);
+      dst[i] = (v > 255) ? 255 : ((v < 0) ? 0 : v);
+    }
+  }
+}
+
+//---------------------- Filtered mipmaps -----------------------------------
+
+namespace
+{
+  /// Half the number of taps of the Kaiser filter
+  static const int kaiserRadius = 4;
+
+  /// Lookup tables for filtering in linear space and the Kaiser weights.
+  struct FilterTables
+  {
+    float srgbToLinear[256];
+    enum { linearSteps = 4096 };
+    uint8 linearToSrgb[linearSteps + 1];
+    float kaiser[2 * kaiserRadius];
+
+    static float BesselI0 (float x)
+    {
+      float sum = 1.0f, term = 1.0f;
+      for (int k = 1; k < 32; k++)
+      {
+        term *= (x * 0.5f / k) * (x * 0.5f / k);
+        sum += term;
+      }
+      return sum;
+    }
+
+    FilterTables ()
+    {
+      for (int i = 0; i < 256; i++)
+      {
+        float c = i / 255.0f;
+        srgbToLinear[i] = (c <= 0.04045f) ? c / 12.92f
+          : powf ((c + 0.055f) / 1.055f, 2.4f);
+      }
+      for (int i = 0; i <= linearSteps; i++)
+      {
+        float l = float (i) / linearSteps;
+        float c = (l <= 0.0031308f) ? l * 12.92f
+          : 1.055f * powf (l, 1.0f / 2.4f) - 0.055f;
+        linearToSrgb[i] = uint8 (csClamp (int (c * 255.0f + 0.5f), 255, 0));
+      }
+
+      /* Source pixels are 0.5, 1.5, ... from the center of the output
+       * pixel, which is 0.25, 0.75, ... output pixels. */
+      const float alpha = 4.0f;
+      float total = 0;
+      for (int t = 0; t < 2 * kaiserRadius; t++)
+      {
+        float x = (t - kaiserRadius + 0.5f) * 0.5f;
+        float sinc = sinf (PI * x) / (PI * x);
+        float r = x / (kaiserRadius * 0.5f);
+        float window = BesselI0 (alpha * sqrtf (1.0f - r * r))
+          / BesselI0 (alpha);
+        kaiser[t] = sinc * window;
+        total += kaiser[t];
+      }
+      for (int t = 0; t < 2 * kaiserRadius; t++)
+        kaiser[t] /= total;
+    }
+  };
+  static const FilterTables filterTables;
+
+  /// Four float channels of a pixel, red, green, blue and alpha.
+  struct Pixel4f
+  {
+    float c[4];
+  };
+
+  struct FilterData
+  {
+    uint flags;
+    // Conversion to and from float
+    const csRGBpixel* srcPixels;
+    csRGBpixel* dstPixels;
+    // Filtering passes
+    const Pixel4f* src;
+    Pixel4f* dst;
+    uint w, h;
+    uint nw, nh;
+  };
+
+  static void ToFloatRows (void* data, uint firstRow, uint numRows)
+  {
+    const FilterData& d = *(const FilterData*)data;
+    const bool gamma = (d.flags & csImageManipulate::mipGammaCorrect) != 0;
+    const bool premul = (d.flags & csImageManipulate::mipPremultipliedAlpha) != 0;
+    for (size_t i = firstRow * d.w; i < (firstRow + numRows) * d.w; i++)
+    {
+      const csRGBpixel& p = d.srcPixels[i];
+      Pixel4f& f = d.dst[i];
+      if (gamma)
+      {
+        f.c[0] = filterTables.srgbToLinear[p.red];
+        f.c[1] = filterTables.srgbToLinear[p.green];
+        f.c[2] = filterTables.srgbToLinear[p.blue];
+      }
+      else
+      {
+        f.c[0] = p.red * (1.0f / 255.0f);
+        f.c[1] = p.green * (1.0f / 255.0f);
+        f.c[2] = p.blue * (1.0f / 255.0f);
+      }
+      f.c[3] = p.alpha * (1.0f / 255.0f);
+      if (premul)
+      {
+        f.c[0] *= f.c[3];
+        f.c[1] *= f.c[3];
+        f.c[2] *= f.c[3];
+      }
+    }
+  }
+
+  static inline uint8 ToByte (float v)
+  {
+    return uint8 (csClamp (int (v * 255.0f + 0.5f), 255, 0));
+  }
+
+  static void FromFloatRows (void* data, uint firstRow, uint numRows)
+  {
+    const FilterData& d = *(const FilterData*)data;
+    const bool gamma = (d.flags & csImageManipulate::mipGammaCorrect) != 0;
+    const bool premul = (d.flags & csImageManipulate::mipPremultipliedAlpha) != 0;
+    for (size_t i = firstRow * d.w; i < (firstRow + numRows) * d.w; i++)
+    {
+      Pixel4f f = d.src[i];
+      float a = csClamp (f.c[3], 1.0f, 0.0f);
+      for (int c = 0; c < 3; c++)
+      {
+        if (premul) f.c[c] = (a > 0) ? f.c[c] / a : 0;
+        f.c[c] = csClamp (f.c[c], 1.0f, 0.0f);
+      }
+      csRGBpixel& p = d.dstPixels[i];
+      if (gamma)
+      {
+        const int steps = FilterTables::linearSteps;
+        p.red = filterTables.linearToSrgb[int (f.c[0] * steps + 0.5f)];
+        p.green = filterTables.linearToSrgb[int (f.c[1] * steps + 0.5f)];
+        p.blue = filterTables.linearToSrgb[int (f.c[2] * steps + 0.5f)];
+      }
+      else
+      {
+        p.red = ToByte (f.c[0]);
+        p.green = ToByte (f.c[1]);
+        p.blue = ToByte (f.c[2]);
+      }
+      p.alpha = ToByte (a);
+    }
+  }
+
+  /**
+   * Get the weights and source positions for output pixel \a x when
+   * halving a line of \a size pixels. Returns the number of taps.
+   */
+  static inline int GetTaps (uint flags, uint x, uint size, const float*& weights,
+    int* pos)
+  {
+    static const float boxWeights[2] = { 0.5f, 0.5f };
+    int first, numTaps;
+    if ((flags & csImageManipulate::mipFilterMask)
+      == csImageManipulate::mipFilterKaiser)
+    {
+      weights = filterTables.kaiser;
+      numTaps = 2 * kaiserRadius;
+      first = int (2 * x) + 1 - kaiserRadius;
+    }
+    else
+    {
+      weights = boxWeights;
+      numTaps = 2;
+      first = int (2 * x);
+    }
+    // Clamp to the edges
+    for (int t = 0; t < numTaps; t++)
+      pos[t] = csClamp (first + t, int (size) - 1, 0);
+    return numTaps;
+  }
+
+  static void FilterHorizontalRows (void* data, uint firstRow, uint numRows)
+  {
+    const FilterData& d = *(const FilterData*)data;
+    const float* weights;
+    int pos[2 * kaiserRadius];
+    for (uint y = firstRow; y < firstRow + numRows; y++)
+    {
+      const Pixel4f* src = d.src + y * d.w;
+      Pixel4f* dst = d.dst + y * d.nw;
+      for (uint x = 0; x < d.nw; x++)
+      {
+        int numTaps = GetTaps (d.flags, x, d.w, weights, pos);
+        float sum[4] = { 0, 0, 0, 0 };
+        for (int t = 0; t < numTaps; t++)
+          for (int c = 0; c < 4; c++)
+            sum[c] += weights[t] * src[pos[t]].c[c];
+        for (int c = 0; c < 4; c++)
+          dst[x].c[c] = sum[c];
+      }
+    }
+  }
+
+  static void FilterVerticalRows (void* data, uint firstRow, uint numRows)
+  {
+    const FilterData& d = *(const FilterData*)data;
+    const float* weights;
+    int pos[2 * kaiserRadius];
+    for (uint y = firstRow; y < firstRow + numRows; y++)
+    {
+      int numTaps = GetTaps (d.flags, y, d.h, weights, pos);
+      Pixel4f* dst = d.dst + y * d.w;
+      for (uint x = 0; x < d.w; x++)
+      {
+        float sum[4] = { 0, 0, 0, 0 };
+        for (int t = 0; t < numTaps; t++)
+        {
+          const Pixel4f& s = d.src[pos[t] * d.w + x];
+          for (int c = 0; c < 4; c++)
+            sum[c] += weights[t] * s.c[c];
+        }
+        for (int c = 0; c < 4; c++)
+          dst[x].c[c] = sum[c];
+      }
+    }
+  }
+}
+
 //-----------------------------------------------------------------------------
 
 csRef<iImage> csImageManipulate::Mipmap2D (iImage* source, int steps, 
@@ -299,7 +812,16 @@ csRef<iImage> csImageManipulate::Mipmap2D (iImage* source, int steps,
         }
       break;
       case CS_IMGFMT_TRUECOLOR:
-        if (!transp)
+        if (!transp && (cur_w > 1) && (cur_h > 1))
+        {
+          BoxMipmapData data;
+          data.src = (const uint32*)simg->GetImageData ();
+          data.w = cur_w;
+          data.dst = (uint32*)mipmap;
+          data.nw = newW;
+          ProcessRowBands (newH, cur_w * 2, BoxMipmapRows, &data);
+        }
+        else if (!transp)
           mipmap_1 (cur_w, cur_h, (csRGBpixel*)simg->GetImageData (), mipmap);
         else
           mipmap_1_t (cur_w, cur_h, (csRGBpixel*)simg->GetImageData (),
@@ -317,6 +839,67 @@ csRef<iImage> csImageManipulate::Mipmap2D (iImage* source, int steps,
   return nimg;
 }
 
+csRef<iImage> csImageManipulate::Mipmap2DFiltered (iImage* source, int steps,
+  uint flags)
+{
+  uint w = source->GetWidth ();
+  uint h = source->GetHeight ();
+
+  if ((w == 1) && (h == 1)) return source;
+
+  // Filter in float so rounding doesn't add up over several steps
+  FilterData data;
+  data.flags = flags;
+  Pixel4f* buf = new Pixel4f[w * h];
+  data.srcPixels = (const csRGBpixel*)source->GetImageData ();
+  data.dst = buf;
+  data.w = w;
+  ProcessRowBands (h, w, ToFloatRows, &data);
+
+  while (steps && !((w == 1) && (h == 1)))
+  {
+    if (w > 1)
+    {
+      const uint nw = w >> 1;
+      Pixel4f* newBuf = new Pixel4f[nw * h];
+      data.src = buf;
+      data.dst = newBuf;
+      data.w = w;
+      data.nw = nw;
+      ProcessRowBands (h, w, FilterHorizontalRows, &data);
+      delete[] buf;
+      buf = newBuf;
+      w = nw;
+    }
+    if (h > 1)
+    {
+      const uint nh = h >> 1;
+      Pixel4f* newBuf = new Pixel4f[w * nh];
+      data.src = buf;
+      data.dst = newBuf;
+      data.w = w;
+      data.h = h;
+      ProcessRowBands (nh, w * 2, FilterVerticalRows, &data);
+      delete[] buf;
+      buf = newBuf;
+      h = nh;
+    }
+    steps--;
+  }
+
+  csRGBpixel* pixels = new csRGBpixel[w * h];
+  data.src = buf;
+  data.dstPixels = pixels;
+  data.w = w;
+  ProcessRowBands (h, w, FromFloatRows, &data);
+  delete[] buf;
+
+  csRef<csImageMemory> nimg;
+  nimg.AttachNew (new csImageMemory (w, h, source->GetFormat ()));
+  nimg->ConvertFromRGBA (pixels);
+  return nimg;
+}
+
 csRef<iImage> csImageManipulate::Mipmap3D (iImage* source, int step, 
   csRGBpixel* /*transp*/)
 {
@@ -328,13 +911,16 @@ csRef<iImage> csImageManipulate::Mipmap3D (iImage* source, int step,
 }
 
 csRef<iImage> csImageManipulate::Mipmap (iImage* source, int steps, 
-  csRGBpixel* transp)
+  csRGBpixel* transp, uint flags)
 {
   if (steps == 0)
     return source;
 
   if (source->GetImageType () == csimg3D)
     return Mipmap3D (source, steps, transp);
+  else if ((flags != mipFilterBox) && !transp
+      && ((source->GetFormat () & CS_IMGFMT_MASK) == CS_IMGFMT_TRUECOLOR))
+    return Mipmap2DFiltered (source, steps, flags);
   else
     return Mipmap2D (source, steps, transp);
 }
@@ -497,8 +1083,14 @@ csRef<iImage> csImageManipulate::Blur (iImage* source, csRGBpixel* transp)
     case CS_IMGFMT_TRUECOLOR:
     {
       if (!transp)
-        mipmap_0 (source->GetWidth (), source->GetHeight (), 
-          (csRGBpixel*)source->GetImageData (), mipmap);
+      {
+        BlurData data;
+        data.src = (const uint32*)source->GetImageData ();
+        data.w = Width;
+        data.h = Height;
+        data.dst = (uint32*)mipmap;
+        ProcessRowBands (Height, Width * 3, BlurRows, &data);
+      }
       else
         mipmap_0_t (source->GetWidth (), source->GetHeight (), 
           (csRGBpixel*)source->GetImageData (), mipmap, *transp);
@@ -602,28 +1194,14 @@ csRef<iImage> csImageManipulate::Sharpen (iImage* source, int strength,
   csRef<iImage> blurry = Blur (original, transp);
   
   csRGBpixel* result = new csRGBpixel [Width * Height];
-  csRGBpixel* src_o = (csRGBpixel*)original->GetImageData ();
-  csRGBpixel* src_b = (csRGBpixel*)blurry->GetImageData ();
-  csRGBpixel* dest = result;
- 
-  for (int n = Width * Height; n > 0; n--)
-  {
-    int v;
-    #define DO(comp)  \
-      v = src_o->comp + ((strength * (src_o->comp - src_b->comp)) >> 8);  \
-      dest->comp = (v > 255) ? 255 : ((v < 0) ? 0 : v)
-
-    DO (red);
-    DO (green);
-    DO (blue);
-    DO (alpha);
-
-    #undef DO
 
-    dest++;
-    src_o++;
-    src_b++;
-  }
+  SharpenData data;
+  data.original = (const uint8*)original->GetImageData ();
+  data.blurred = (const uint8*)blurry->GetImageData ();
+  data.dst = (uint8*)result;
+  data.rowBytes = Width * sizeof (csRGBpixel);
+  data.strength = strength;
+  ProcessRowBands (Height, Width, SharpenRows, &data);
 
   csRef<csImageMemory> resimg;
   resimg.AttachNew (new csImageMemory (source->GetWidth (),
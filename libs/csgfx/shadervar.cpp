@@ -23,15 +23,15 @@
 //CS_LEAKGUARD_IMPLEMENT (csShaderVariable);
 
 CS_IMPLEMENT_STATIC_CLASSVAR (csShaderVariable, matrixAlloc, MatrixAlloc,
-    CS::Memory::BlockAllocatorSafe<csMatrix3>, (1024));
+    CS::Memory::BlockAllocatorCached<csMatrix3>, (1024));
 CS_IMPLEMENT_STATIC_CLASSVAR (csShaderVariable, matrix4Alloc, Matrix4Alloc,
-    CS::Memory::BlockAllocatorSafe<CS::Math::Matrix4>, (1024));
+    CS::Memory::BlockAllocatorCached<CS::Math::Matrix4>, (1024));
 CS_IMPLEMENT_STATIC_CLASSVAR (csShaderVariable, transformAlloc, TransformAlloc,
-    CS::Memory::BlockAllocatorSafe<csReversibleTransform>, (1024));
+    CS::Memory::BlockAllocatorCached<csReversibleTransform>, (1024));
 CS_IMPLEMENT_STATIC_CLASSVAR (csShaderVariable, arrayAlloc,
-    ShaderVarArrayAlloc, CS::Memory::BlockAllocatorSafe<csShaderVariable::SvArrayType>, (1024));
+    ShaderVarArrayAlloc, CS::Memory::BlockAllocatorCached<csShaderVariable::SvArrayType>, (1024));
 CS_IMPLEMENT_STATIC_CLASSVAR (csShaderVariable, accessorAlloc,
-    AccessorValuesAlloc, CS::Memory::BlockAllocatorSafe<csShaderVariable::AccessorValues>, (1024));
+    AccessorValuesAlloc, CS::Memory::BlockAllocatorCached<csShaderVariable::AccessorValues>, (1024));
 
 
 csShaderVariable::csShaderVariable () :
@@ -101,7 +101,7 @@ csShaderVariable::csShaderVariable (const csShaderVariable& other)
     break;
 
   case MATRIX4X4:
-    Matrix4ValuePtr = Matrix4Alloc()->Alloc ();
+    Matrix4ValuePtr = Matrix4Alloc()->Alloc (*other.Matrix4ValuePtr);
     break;
 
   case TRANSFORM:
@@ -72,6 +72,20 @@ csShaderVariable* ShaderVariableContextImpl::GetVariable (
 void ShaderVariableContextImpl::PushVariables (
   csShaderVariableStack& stack) const
 {
+  ShaderVarSlotMap* slotMap = stack.GetSlotMap ();
+  if (slotMap)
+  {
+    // Look up slots in one table, only lock for names without a slot yet
+    const ShaderVarSlotMap::Table* table = slotMap->GetTable ();
+    for (size_t i = 0; i < variables.GetSize (); ++i)
+    {
+      ShaderVarStringID name = variables[i]->GetName ();
+      size_t slot = ShaderVarSlotMap::GetSlot (table, name);
+      if (slot == 0) slot = slotMap->Request (name);
+      stack.SetSlot (slot, variables[i]);
+    }
+    return;
+  }
   for (size_t i = 0; i < variables.GetSize (); ++i)
   {
     ShaderVarStringID name = variables[i]->GetName ();
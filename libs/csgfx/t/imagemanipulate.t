@@ -0,0 +1,214 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csgfx/imagemanipulate.h"
+#include "csgfx/imagememory.h"
+#include "csutil/threadjobqueue.h"
+
+/**
+ * Test csImageManipulate filters against straightforward per-pixel
+ * implementations.
+ */
+class csImageManipulateTest : public CppUnit::TestFixture
+{
+private:
+  csRef<iImage> MakeImage (int w, int h, uint seed);
+  static const csRGBpixel& Pixel (iImage* img, int x, int y)
+  {
+    return ((const csRGBpixel*)img->GetImageData ())[y * img->GetWidth () + x];
+  }
+  static int Channel (const csRGBpixel& p, int c)
+  {
+    return (c == 0) ? p.red : ((c == 1) ? p.green : ((c == 2) ? p.blue : p.alpha));
+  }
+  static bool SameImage (iImage* a, iImage* b);
+
+  void CheckMipmap (int w, int h);
+  void CheckBlur (int w, int h);
+public:
+  void testMipmap();
+  void testBlur();
+  void testSharpen();
+  void testFiltered();
+  void testParallel();
+
+  CPPUNIT_TEST_SUITE(csImageManipulateTest);
+    CPPUNIT_TEST(testMipmap);
+    CPPUNIT_TEST(testBlur);
+    CPPUNIT_TEST(testSharpen);
+    CPPUNIT_TEST(testFiltered);
+    CPPUNIT_TEST(testParallel);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+csRef<iImage> csImageManipulateTest::MakeImage (int w, int h, uint seed)
+{
+  csRef<csImageMemory> img;
+  img.AttachNew (new csImageMemory (w, h,
+    CS_IMGFMT_TRUECOLOR | CS_IMGFMT_ALPHA));
+  csRGBpixel* p = (csRGBpixel*)img->GetImagePtr ();
+  for (int i = 0; i < w * h; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    p[i].red = seed >> 24;
+    p[i].green = seed >> 16;
+    p[i].blue = seed >> 8;
+    p[i].alpha = (seed >> 20) ^ 0x5a;
+  }
+  return img;
+}
+
+bool csImageManipulateTest::SameImage (iImage* a, iImage* b)
+{
+  if ((a->GetWidth () != b->GetWidth ())
+    || (a->GetHeight () != b->GetHeight ()))
+    return false;
+  return memcmp (a->GetImageData (), b->GetImageData (),
+    a->GetWidth () * a->GetHeight () * sizeof (csRGBpixel)) == 0;
+}
+
+void csImageManipulateTest::CheckMipmap (int w, int h)
+{
+  csRef<iImage> src = MakeImage (w, h, w * 31 + h);
+  csRef<iImage> mip = csImageManipulate::Mipmap (src, 1);
+  CPPUNIT_ASSERT_EQUAL(w / 2, mip->GetWidth ());
+  CPPUNIT_ASSERT_EQUAL(h / 2, mip->GetHeight ());
+  for (int y = 0; y < h / 2; y++)
+    for (int x = 0; x < w / 2; x++)
+      for (int c = 0; c < 4; c++)
+      {
+        int sum = Channel (Pixel (src, 2*x, 2*y), c)
+          + Channel (Pixel (src, 2*x + 1, 2*y), c)
+          + Channel (Pixel (src, 2*x, 2*y + 1), c)
+          + Channel (Pixel (src, 2*x + 1, 2*y + 1), c);
+        CPPUNIT_ASSERT_EQUAL(sum / 4, Channel (Pixel (mip, x, y), c));
+      }
+}
+
+void csImageManipulateTest::testMipmap()
+{
+  CheckMipmap (2, 2);
+  CheckMipmap (16, 16);
+  CheckMipmap (37, 22);
+  CheckMipmap (65, 9);
+}
+
+void csImageManipulateTest::CheckBlur (int w, int h)
+{
+  static const int weights[3] = { 1, 2, 1 };
+  csRef<iImage> src = MakeImage (w, h, w * 17 + h);
+  csRef<iImage> blur = csImageManipulate::Blur (src);
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+      for (int c = 0; c < 4; c++)
+      {
+        int sum = 0;
+        for (int dy = -1; dy <= 1; dy++)
+          for (int dx = -1; dx <= 1; dx++)
+            sum += weights[dx + 1] * weights[dy + 1] * Channel (
+              Pixel (src, (x + dx + w) % w, (y + dy + h) % h), c);
+        CPPUNIT_ASSERT_EQUAL(sum / 16, Channel (Pixel (blur, x, y), c));
+      }
+}
+
+void csImageManipulateTest::testBlur()
+{
+  CheckBlur (1, 1);
+  CheckBlur (2, 5);
+  CheckBlur (16, 16);
+  CheckBlur (41, 13);
+}
+
+void csImageManipulateTest::testSharpen()
+{
+  const int w = 29, h = 18;
+  csRef<iImage> src = MakeImage (w, h, 7);
+  csRef<iImage> blur = csImageManipulate::Blur (src);
+  const int strengths[] = { 64, 256, 40000 };
+  for (size_t s = 0; s < sizeof (strengths) / sizeof (int); s++)
+  {
+    csRef<iImage> sharp = csImageManipulate::Sharpen (src, strengths[s]);
+    for (int y = 0; y < h; y++)
+      for (int x = 0; x < w; x++)
+        for (int c = 0; c < 4; c++)
+        {
+          int o = Channel (Pixel (src, x, y), c);
+          int v = o + ((strengths[s] * (o - Channel (Pixel (blur, x, y), c))) >> 8);
+          v = csClamp (v, 255, 0);
+          CPPUNIT_ASSERT_EQUAL(v, Channel (Pixel (sharp, x, y), c));
+        }
+  }
+}
+
+void csImageManipulateTest::testFiltered()
+{
+  // A flat image stays flat with any filter
+  csRef<csImageMemory> flat;
+  flat.AttachNew (new csImageMemory (20, 12,
+    CS_IMGFMT_TRUECOLOR | CS_IMGFMT_ALPHA));
+  csRGBpixel* p = (csRGBpixel*)flat->GetImagePtr ();
+  for (int i = 0; i < 20 * 12; i++)
+    p[i].Set (200, 100, 30, 128);
+  const uint flags[] = {
+    csImageManipulate::mipFilterKaiser,
+    csImageManipulate::mipFilterBox | csImageManipulate::mipGammaCorrect,
+    csImageManipulate::mipFilterKaiser | csImageManipulate::mipPremultipliedAlpha
+  };
+  for (size_t f = 0; f < sizeof (flags) / sizeof (uint); f++)
+  {
+    csRef<iImage> mip = csImageManipulate::Mipmap (flat, 2, 0, flags[f]);
+    CPPUNIT_ASSERT_EQUAL(5, mip->GetWidth ());
+    CPPUNIT_ASSERT_EQUAL(3, mip->GetHeight ());
+    for (int y = 0; y < 3; y++)
+      for (int x = 0; x < 5; x++)
+        CPPUNIT_ASSERT(Pixel (mip, x, y) == csRGBpixel (200, 100, 30, 128));
+  }
+
+  // Averaging black and white gives a lighter gray in linear space
+  csRef<csImageMemory> checker;
+  checker.AttachNew (new csImageMemory (2, 2));
+  p = (csRGBpixel*)checker->GetImagePtr ();
+  p[0].Set (0, 0, 0); p[1].Set (255, 255, 255);
+  p[2].Set (255, 255, 255); p[3].Set (0, 0, 0);
+  csRef<iImage> mip = csImageManipulate::Mipmap (checker, 1, 0,
+    csImageManipulate::mipGammaCorrect);
+  CPPUNIT_ASSERT(Pixel (mip, 0, 0).red > 180);
+  CPPUNIT_ASSERT(Pixel (mip, 0, 0).red < 195);
+}
+
+void csImageManipulateTest::testParallel()
+{
+  csRef<iImage> src = MakeImage (512, 300, 3);
+  csRef<iImage> mip = csImageManipulate::Mipmap (src, 1);
+  csRef<iImage> sharp = csImageManipulate::Sharpen (src, 300);
+  csRef<iImage> kaiser = csImageManipulate::Mipmap (src, 2, 0,
+    csImageManipulate::mipFilterKaiser | csImageManipulate::mipGammaCorrect);
+
+  csRef<iJobQueue> queue;
+  queue.AttachNew (new CS::Threading::ThreadedJobQueue (4));
+  csImageManipulate::SetJobQueue (queue);
+  csRef<iImage> mipParallel = csImageManipulate::Mipmap (src, 1);
+  csRef<iImage> sharpParallel = csImageManipulate::Sharpen (src, 300);
+  csRef<iImage> kaiserParallel = csImageManipulate::Mipmap (src, 2, 0,
+    csImageManipulate::mipFilterKaiser | csImageManipulate::mipGammaCorrect);
+  csImageManipulate::SetJobQueue (0);
+
+  CPPUNIT_ASSERT(SameImage (mip, mipParallel));
+  CPPUNIT_ASSERT(SameImage (sharp, sharpParallel));
+  CPPUNIT_ASSERT(SameImage (kaiser, kaiserParallel));
+}
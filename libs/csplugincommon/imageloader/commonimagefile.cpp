@@ -20,10 +20,271 @@
 #include "cssysdef.h"
 #include "csgfx/packrgb.h"
 #include "csplugincommon/imageloader/commonimagefile.h"
+#include "csutil/cfgacc.h"
+#include "csutil/platform.h"
 #include "csutil/scopedlock.h"
+#include "csutil/sysfunc.h"
 #include "csutil/threadjobqueue.h"
+#include "csutil/threading/condition.h"
 #include "iutil/objreg.h"
 
+namespace
+{
+  /**
+   * Image decode queue. Jobs wait in a list sorted by priority; for each
+   * enqueued job a worker of a threaded job queue is told to run the job
+   * that is first in that list at that time.
+   */
+  class ImageDecodeQueue :
+    public scfImplementation1<ImageDecodeQueue, iImageDecodeQueue>
+  {
+    struct PendingJob
+    {
+      csRef<iJob> job;
+      int priority;
+      uint serial;
+    };
+    struct RunningJob
+    {
+      iJob* job;
+      CS::Threading::ThreadID thread;
+    };
+    /* Sorted so the job to run next is the last one: ascending by priority,
+       descending by serial number. */
+    csArray<PendingJob> pending;
+    csArray<RunningJob> running;
+    uint nextSerial;
+    CS::Threading::Mutex lock;
+    CS::Threading::Condition jobFinished;
+    csRef<iJobQueue> workers;
+    size_t numWorkers;
+
+    size_t statImages;
+    uint64 statPixels;
+    csMicroTicks statTime;
+
+    class RunNextJob : public scfImplementation1<RunNextJob, iJob>
+    {
+      ImageDecodeQueue* owner;
+    public:
+      RunNextJob (ImageDecodeQueue* owner) : scfImplementationType (this),
+        owner (owner) {}
+      void Run () { owner->RunNext (); }
+    };
+
+    static int ComparePending (const PendingJob& a, const PendingJob& b)
+    {
+      if (a.priority != b.priority) return (a.priority < b.priority) ? -1 : 1;
+      if (a.serial != b.serial) return (a.serial > b.serial) ? -1 : 1;
+      return 0;
+    }
+    size_t FindPending (iJob* job) const
+    {
+      for (size_t i = 0; i < pending.GetSize (); i++)
+      {
+        if (pending[i].job == job) return i;
+      }
+      return csArrayItemNotFound;
+    }
+    size_t FindRunning (iJob* job) const
+    {
+      for (size_t i = 0; i < running.GetSize (); i++)
+      {
+        if (running[i].job == job) return i;
+      }
+      return csArrayItemNotFound;
+    }
+    /// Run a job. It must have been added to the running list.
+    void RunJob (iJob* job)
+    {
+      job->Run ();
+      CS::Threading::MutexScopedLock l (lock);
+      running.DeleteIndexFast (FindRunning (job));
+      jobFinished.NotifyAll ();
+    }
+    /**
+     * Wait for a running job to finish. Returns \c false if the job runs on
+     * the calling thread (ie the wait was requested from within the job).
+     * Must be called with the lock held.
+     */
+    bool WaitForRunning (iJob* job)
+    {
+      size_t index;
+      while ((index = FindRunning (job)) != csArrayItemNotFound)
+      {
+        if (running[index].thread
+            == CS::Threading::Thread::GetThreadID ())
+          return false;
+        jobFinished.Wait (lock);
+      }
+      return true;
+    }
+    void RunNext ()
+    {
+      csRef<iJob> job;
+      {
+        CS::Threading::MutexScopedLock l (lock);
+        if (pending.IsEmpty ()) return;
+        job = pending.Pop ().job;
+        RunningJob rj = { job, CS::Threading::Thread::GetThreadID () };
+        running.Push (rj);
+      }
+      RunJob (job);
+    }
+  public:
+    ImageDecodeQueue (size_t numWorkers) : scfImplementationType (this),
+      nextSerial (0), numWorkers (numWorkers), statImages (0),
+      statPixels (0), statTime (0)
+    {
+      workers.AttachNew (new CS::Threading::ThreadedJobQueue (numWorkers,
+        CS::Threading::THREAD_PRIO_NORMAL, "image load"));
+    }
+    ~ImageDecodeQueue ()
+    {
+      {
+        CS::Threading::MutexScopedLock l (lock);
+        pending.DeleteAll ();
+      }
+      // Waits for the worker threads to finish
+      workers.Invalidate ();
+    }
+
+    void Enqueue (iJob* job, int priority)
+    {
+      {
+        CS::Threading::MutexScopedLock l (lock);
+        PendingJob pj;
+        pj.job = job;
+        pj.priority = priority;
+        pj.serial = nextSerial++;
+        pending.InsertSorted (pj, ComparePending);
+      }
+      csRef<RunNextJob> runNext;
+      runNext.AttachNew (new RunNextJob (this));
+      workers->Enqueue (runNext);
+    }
+    bool SetPriority (iJob* job, int priority)
+    {
+      CS::Threading::MutexScopedLock l (lock);
+      size_t index = FindPending (job);
+      if (index == csArrayItemNotFound) return false;
+      PendingJob pj (pending[index]);
+      pending.DeleteIndex (index);
+      pj.priority = priority;
+      pending.InsertSorted (pj, ComparePending);
+      return true;
+    }
+    iJobQueue::JobStatus Dequeue (iJob* job, bool waitForCompletion)
+    {
+      CS::Threading::MutexScopedLock l (lock);
+      size_t index = FindPending (job);
+      if (index != csArrayItemNotFound)
+      {
+        pending.DeleteIndex (index);
+        return iJobQueue::Dequeued;
+      }
+      if (FindRunning (job) == csArrayItemNotFound)
+        return iJobQueue::NotEnqueued;
+      if (waitForCompletion && WaitForRunning (job))
+        return iJobQueue::NotEnqueued;
+      return iJobQueue::Pending;
+    }
+    iJobQueue::JobStatus PullAndRun (iJob* job)
+    {
+      {
+        CS::Threading::MutexScopedLock l (lock);
+        size_t index = FindPending (job);
+        if (index == csArrayItemNotFound)
+        {
+          if (FindRunning (job) == csArrayItemNotFound)
+            return iJobQueue::NotEnqueued;
+          return WaitForRunning (job) ? iJobQueue::NotEnqueued
+            : iJobQueue::Pending;
+        }
+        pending.DeleteIndex (index);
+        RunningJob rj = { job, CS::Threading::Thread::GetThreadID () };
+        running.Push (rj);
+      }
+      RunJob (job);
+      return iJobQueue::Dequeued;
+    }
+    size_t GetWorkerCount () { return numWorkers; }
+
+    void RecordDecode (size_t pixels, csMicroTicks time)
+    {
+      CS::Threading::MutexScopedLock l (lock);
+      statImages++;
+      statPixels += pixels;
+      statTime += time;
+    }
+    void GetStatistics (size_t& images, uint64& pixels, csMicroTicks& time)
+    {
+      CS::Threading::MutexScopedLock l (lock);
+      images = statImages;
+      pixels = statPixels;
+      time = statTime;
+    }
+  };
+
+  /// Unpacks a part of an RGB image
+  class UnpackRGBJob : public scfImplementation1<UnpackRGBJob, iJob>
+  {
+    csRGBpixel* dst;
+    uint8* src;
+    size_t numPixels;
+  public:
+    UnpackRGBJob (csRGBpixel* dst, uint8* src, size_t numPixels)
+      : scfImplementationType (this), dst (dst), src (src),
+        numPixels (numPixels) {}
+    void Run ()
+    {
+      csPackRGB::UnpackRGBtoRGBpixelBuffer (dst, src, numPixels);
+    }
+  };
+
+  /* Images are split into at most that many bands, each with at least
+     minBandPixels pixels. */
+  static const size_t minBandPixels = 65536;
+  static const size_t maxBands = 16;
+  // Conversion is waited for, so it goes before any image decoding
+  static const int conversionPriority = INT_MAX;
+
+  /**
+   * Unpack RGB pixels. If a queue is given, large images are split into
+   * bands which are distributed on it, the first band is processed on the
+   * calling thread.
+   */
+  static void UnpackRGB (iImageDecodeQueue* queue, csRGBpixel* dst,
+                         uint8* src, size_t numPixels)
+  {
+    size_t bands = numPixels / minBandPixels;
+    if (queue)
+      bands = csMin (bands, queue->GetWorkerCount () + 1);
+    else
+      bands = 1;
+    bands = csMin (bands, maxBands);
+    if (bands <= 1)
+    {
+      csPackRGB::UnpackRGBtoRGBpixelBuffer (dst, src, numPixels);
+      return;
+    }
+
+    const size_t bandPixels = (numPixels + bands - 1) / bands;
+    csRef<UnpackRGBJob> jobs[maxBands];
+    size_t numJobs = 0;
+    for (size_t p = bandPixels; p < numPixels; p += bandPixels)
+    {
+      jobs[numJobs].AttachNew (new UnpackRGBJob (dst + p, src + p * 3,
+        csMin (bandPixels, numPixels - p)));
+      queue->Enqueue (jobs[numJobs], conversionPriority);
+      numJobs++;
+    }
+    csPackRGB::UnpackRGBtoRGBpixelBuffer (dst, src, bandPixels);
+    for (size_t j = 0; j < numJobs; j++)
+      queue->PullAndRun (jobs[j]);
+  }
+}
+
 
 csCommonImageFileLoader::csCommonImageFileLoader (int format)
   : scfImplementationType (this), 
@@ -59,8 +320,8 @@ void csCommonImageFileLoader::ApplyTo (csImageMemory* image)
     const size_t numPix = rawData->GetSize() / 3;
     if ((Format & CS_IMGFMT_MASK) == CS_IMGFMT_TRUECOLOR)
     {
-      csPackRGB::UnpackRGBtoRGBpixelBuffer (
-	(csRGBpixel*)image->GetImagePtr(), rawData->GetUint8(), numPix);
+      UnpackRGB (conversionQueue, (csRGBpixel*)image->GetImagePtr(),
+        rawData->GetUint8(), numPix);
     }
     else
     {
@@ -90,6 +351,9 @@ csCommonImageFile::LoaderJob::~LoaderJob()
 void csCommonImageFile::LoaderJob::Run()
 {
   csRef<iImageFileLoader> currentLoader;
+  /* Not a reference: if the job runs on a worker the queue waits for it
+     on destruction, otherwise the image holds a reference. */
+  iImageDecodeQueue* queue;
   {
     csRef<csCommonImageFile> fileToLoad;
     {
@@ -102,8 +366,16 @@ void csCommonImageFile::LoaderJob::Run()
     }
     currentLoader = fileToLoad->currentLoader;
     if (!currentLoader.IsValid()) return;
+    queue = fileToLoad->jobQueue;
   }
+  const csMicroTicks start = csGetMicroTicks ();
   loadResult = currentLoader->LoadData ();
+  if (loadResult)
+  {
+    queue->RecordDecode (
+      size_t (currentLoader->GetWidth()) * currentLoader->GetHeight(),
+      csGetMicroTicks () - start);
+  }
 }
 
 void csCommonImageFile::LoaderJob::ClearFileToLoad ()
@@ -119,12 +391,19 @@ csCommonImageFile::csCommonImageFile (iObjectRegistry* object_reg, int format)
   : scfImplementationType (this, format), object_reg (object_reg) 
 {
 #ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
-  static const char queueTag[] = "crystalspace.jobqueue.imageload";
-  jobQueue = csQueryRegistryTagInterface<iJobQueue> (object_reg, queueTag);
+  decodePriority = 0;
+  static const char queueTag[] = "crystalspace.graphic.image.decodequeue";
+  static CS::Threading::Mutex queueCreateLock;
+  CS::Threading::MutexScopedLock lock (queueCreateLock);
+  jobQueue = csQueryRegistryTagInterface<iImageDecodeQueue> (object_reg,
+    queueTag);
   if (!jobQueue.IsValid())
   {
-    jobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (1,
-      CS::Threading::THREAD_PRIO_NORMAL, "image load"));
+    csConfigAccess config (object_reg);
+    int numThreads = config->GetInt ("Video.ImageLoad.Threads", 0);
+    if (numThreads <= 0)
+      numThreads = csMax (int (CS::Platform::GetProcessorCount ()) - 1, 1);
+    jobQueue.AttachNew (new ImageDecodeQueue (numThreads));
     object_reg->Register (jobQueue, queueTag);
   }
 #endif
@@ -136,6 +415,8 @@ csCommonImageFile::~csCommonImageFile()
 #ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
   if (loadJob.IsValid())
   {
+    /* Drops the job if decoding hasn't started yet, which effectively
+       cancels it. */
     loadJob->ClearFileToLoad ();
     jobQueue->Dequeue (loadJob, true);
   }
@@ -155,8 +436,9 @@ bool csCommonImageFile::Load (csRef<iDataBuffer> source)
   CS_ASSERT ((w != 0) && (h != 0));
   SetDimensions (w, h);
 #ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
+  currentLoader->SetConversionQueue (jobQueue);
   loadJob.AttachNew (new LoaderJob (this));
-  jobQueue->Enqueue (loadJob);
+  jobQueue->Enqueue (loadJob, decodePriority);
   return true;
 #else
   return currentLoader->LoadData();
@@ -255,3 +537,29 @@ csRef<iDataBuffer> csCommonImageFile::GetRawData() const
   MakeImageData();
   return csImageMemory::GetRawData ();
 }
+
+void csCommonImageFile::SetDecodePriority (int priority)
+{
+#ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
+  decodePriority = priority;
+  if (loadJob.IsValid()) jobQueue->SetPriority (loadJob, priority);
+#endif
+}
+
+int csCommonImageFile::ReduceDecodeSize (int levels)
+{
+#ifdef CSCOMMONIMAGEFILE_THREADED_LOADING
+  if ((levels <= 0) || !loadJob.IsValid()) return 0;
+  /* Take the job out of the queue so it can't start while the loader is
+     changed. Fails if decoding already started. */
+  if (jobQueue->Dequeue (loadJob, false) != iJobQueue::Dequeued) return 0;
+  const int reduced = currentLoader->ReduceSize (levels);
+  if (reduced > 0)
+    SetDimensions (currentLoader->GetWidth(), currentLoader->GetHeight());
+  jobQueue->Enqueue (loadJob, decodePriority);
+  return reduced;
+#else
+  (void)levels;
+  return 0;
+#endif
+}
@@ -0,0 +1,293 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csplugincommon/render3d/commandbuffer.h"
+
+namespace CS
+{
+  namespace Graphics
+  {
+    // All allocations are aligned to this
+    static const size_t allocAlign = 16;
+
+    static inline size_t AlignSize (size_t size)
+    {
+      return (size + allocAlign - 1) & ~(allocAlign - 1);
+    }
+
+    // Offset of the first usable byte in a block
+    static const size_t blockHeaderSize = (sizeof (void*) + sizeof (size_t)
+      + allocAlign - 1) & ~(allocAlign - 1);
+
+    //-----------------------------------------------------------------------
+
+    const csShaderVariableStack& CommandBuffer::ReplayContext::Expand (
+      const StackSnapshot& snapshot)
+    {
+      if (stackStorage.GetSize () < snapshot.stackSize)
+        stackStorage.SetSize (snapshot.stackSize, (csShaderVariable*)0);
+      for (size_t i = 0; i < snapshot.numEntries; i++)
+      {
+        const StackSnapshot::Entry& entry = snapshot.entries[i];
+        stackStorage[entry.index] = entry.variable;
+      }
+      stack.Setup (stackStorage.GetArray (), snapshot.stackSize);
+      return stack;
+    }
+
+    void CommandBuffer::ReplayContext::Release (const StackSnapshot& snapshot)
+    {
+      for (size_t i = 0; i < snapshot.numEntries; i++)
+        stackStorage[snapshot.entries[i].index] = 0;
+    }
+
+    //-----------------------------------------------------------------------
+
+    CommandBuffer::CommandBuffer (size_t blockSize)
+      : blockSize (blockSize), firstBlock (0), currentBlock (0),
+        currentOffset (0), firstCommand (0), lastCommand (0),
+        numCommands (0), usedMemory (0)
+    {
+    }
+
+    CommandBuffer::~CommandBuffer ()
+    {
+      Clear ();
+      Block* block = firstBlock;
+      while (block)
+      {
+        Block* next = block->next;
+        cs_free (block);
+        block = next;
+      }
+    }
+
+    CommandBuffer::Block* CommandBuffer::NewBlock (size_t minSize)
+    {
+      size_t size = csMax (blockSize, blockHeaderSize + minSize);
+      Block* block = static_cast<Block*> (cs_malloc (size));
+      block->size = size;
+      block->next = 0;
+      return block;
+    }
+
+    void* CommandBuffer::Allocate (size_t size)
+    {
+      size = AlignSize (size);
+      if (!currentBlock)
+      {
+        firstBlock = currentBlock = NewBlock (size);
+        currentOffset = blockHeaderSize;
+      }
+      else if (currentOffset + size > currentBlock->size)
+      {
+        /* Continue with the next block if it's large enough, otherwise put a
+           new one in front of it */
+        Block* next = currentBlock->next;
+        if (!next || (next->size - blockHeaderSize < size))
+        {
+          Block* newBlock = NewBlock (size);
+          newBlock->next = next;
+          currentBlock->next = newBlock;
+          next = newBlock;
+        }
+        currentBlock = next;
+        currentOffset = blockHeaderSize;
+      }
+      void* p = reinterpret_cast<uint8*> (currentBlock) + currentOffset;
+      currentOffset += size;
+      usedMemory += size;
+      return p;
+    }
+
+    void CommandBuffer::Append (Command* command)
+    {
+      if (lastCommand)
+        lastCommand->next = command;
+      else
+        firstCommand = command;
+      lastCommand = command;
+      numCommands++;
+    }
+
+    // Whether a variable still has the value of a copy made of it
+    static bool SameValue (csShaderVariable* var, csShaderVariable* copy)
+    {
+      const csShaderVariable::VariableType type = copy->GetType ();
+      if (var->GetType () != type) return false;
+      switch (type)
+      {
+        case csShaderVariable::INT:
+          {
+            int a, b;
+            var->GetValue (a);
+            copy->GetValue (b);
+            return a == b;
+          }
+        case csShaderVariable::FLOAT:
+        case csShaderVariable::VECTOR2:
+        case csShaderVariable::VECTOR3:
+        case csShaderVariable::VECTOR4:
+          {
+            csVector4 a, b;
+            var->GetValue (a);
+            copy->GetValue (b);
+            return a == b;
+          }
+        case csShaderVariable::TEXTURE:
+          {
+            iTextureWrapper* wa;
+            iTextureWrapper* wb;
+            var->GetValue (wa);
+            copy->GetValue (wb);
+            if (wa != wb) return false;
+            iTextureHandle* ha;
+            iTextureHandle* hb;
+            var->GetValue (ha);
+            copy->GetValue (hb);
+            return ha == hb;
+          }
+        case csShaderVariable::RENDERBUFFER:
+          {
+            iRenderBuffer* a;
+            iRenderBuffer* b;
+            var->GetValue (a);
+            copy->GetValue (b);
+            return a == b;
+          }
+        case csShaderVariable::MATRIX3X3:
+          {
+            csMatrix3 a, b;
+            var->GetValue (a);
+            copy->GetValue (b);
+            return a == b;
+          }
+        case csShaderVariable::TRANSFORM:
+          {
+            csReversibleTransform a, b;
+            var->GetValue (a);
+            copy->GetValue (b);
+            return (a.GetO2T () == b.GetO2T ())
+              && (a.GetO2TTranslation () == b.GetO2TTranslation ());
+          }
+        case csShaderVariable::MATRIX4X4:
+          {
+            CS::Math::Matrix4 a, b;
+            var->GetValue (a);
+            copy->GetValue (b);
+            return memcmp (&a, &b, sizeof (a)) == 0;
+          }
+        case csShaderVariable::ARRAY:
+          {
+            const size_t arraySize = var->GetArraySize ();
+            if (copy->GetArraySize () != arraySize) return false;
+            for (size_t i = 0; i < arraySize; i++)
+            {
+              csShaderVariable* a = var->GetArrayElement (i);
+              csShaderVariable* b = copy->GetArrayElement (i);
+              if ((a == 0) != (b == 0)) return false;
+              if (a && !SameValue (a, b)) return false;
+            }
+            return true;
+          }
+        default:
+          return true;
+      }
+    }
+
+    csShaderVariable* CommandBuffer::Capture (csShaderVariable* var)
+    {
+      csShaderVariable** copy = svCopies.GetElementPointer (var);
+      // Variables may change between draws, eg for each light
+      if (copy && SameValue (var, *copy)) return *copy;
+
+      iShaderVariableAccessor* accessor = var->GetAccessor ();
+      if (accessor) accessor->PreGetValue (var);
+      csRef<csShaderVariable> newCopy;
+      newCopy.AttachNew (new csShaderVariable (*var));
+      if (accessor) newCopy->SetAccessor (0);
+      svCopies.PutUnique (var, newCopy);
+      svCopyRefs.Push (newCopy);
+
+      // Array elements can change as well
+      const size_t arraySize = var->GetArraySize ();
+      for (size_t i = 0; i < arraySize; i++)
+      {
+        csShaderVariable* element = var->GetArrayElement (i);
+        if (element) newCopy->SetArrayElement (i, Capture (element));
+      }
+      return newCopy;
+    }
+
+    CommandBuffer::StackSnapshot CommandBuffer::Snapshot (
+      const csShaderVariableStack& stack)
+    {
+      // Go over the slots, a stack with a slot map only has a few of them
+      const size_t numSlots = stack.GetSlotCount ();
+      StackSnapshot snapshot;
+      snapshot.stackSize = stack.GetSize ();
+      snapshot.numEntries = 0;
+      for (size_t s = 0; s < numSlots; s++)
+      {
+        if (stack.GetSlotVariable (s)) snapshot.numEntries++;
+      }
+      StackSnapshot::Entry* entries = static_cast<StackSnapshot::Entry*> (
+        Allocate (snapshot.numEntries * sizeof (StackSnapshot::Entry)));
+      size_t n = 0;
+      for (size_t s = 0; s < numSlots; s++)
+      {
+        csShaderVariable* var = stack.GetSlotVariable (s);
+        if (!var) continue;
+        entries[n].index = stack.GetSlotName (s);
+        entries[n].variable = Capture (var);
+        // Names given a slot after the map was sized are beyond GetSize()
+        snapshot.stackSize = csMax (snapshot.stackSize, entries[n].index + 1);
+        n++;
+      }
+      snapshot.entries = entries;
+      return snapshot;
+    }
+
+    void CommandBuffer::Replay (iGraphics3D* g3d, ReplayContext& context)
+    {
+      for (Command* cmd = firstCommand; cmd != 0; cmd = cmd->next)
+        cmd->Execute (g3d, context);
+    }
+
+    void CommandBuffer::Clear ()
+    {
+      Command* cmd = firstCommand;
+      while (cmd)
+      {
+        Command* next = cmd->next;
+        cmd->~Command ();
+        cmd = next;
+      }
+      firstCommand = lastCommand = 0;
+      numCommands = 0;
+      usedMemory = 0;
+      svCopies.DeleteAll ();
+      svCopyRefs.Empty ();
+
+      currentBlock = firstBlock;
+      currentOffset = blockHeaderSize;
+    }
+  } // namespace Graphics
+} // namespace CS
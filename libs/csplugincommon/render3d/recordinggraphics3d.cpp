@@ -0,0 +1,1291 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csplugincommon/render3d/recordinggraphics3d.h"
+
+#include "csutil/sysfunc.h"
+#include "igeom/clip2d.h"
+#include "ivideo/halo.h"
+#include "ivideo/rndbuf.h"
+#include "ivideo/shader/shader.h"
+#include "ivideo/texture.h"
+
+#include "csutil/deprecated_warn_off.h"
+
+namespace CS
+{
+  namespace Graphics
+  {
+    namespace
+    {
+      typedef CommandBuffer::Command Command;
+      typedef CommandBuffer::ReplayContext ReplayContext;
+
+      /// Array of objects referenced for the lifetime of a command
+      template<typename T>
+      struct RefArray
+      {
+        T** items;
+        size_t num;
+
+        RefArray (CommandBuffer& buffer, T* const* src, size_t n)
+          : items (buffer.CopyArray (src, n)), num (items ? n : 0)
+        {
+          for (size_t i = 0; i < num; i++)
+            if (items[i]) items[i]->IncRef ();
+        }
+        ~RefArray ()
+        {
+          for (size_t i = 0; i < num; i++)
+            if (items[i]) items[i]->DecRef ();
+        }
+      };
+
+      //@{
+      /// Commands calling an iGraphics3D method with stored arguments
+      template<void (iGraphics3D::*Method) ()>
+      struct CmdCall0 : public Command
+      {
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { (g3d->*Method) (); }
+      };
+
+      template<typename Stored, typename Param,
+        void (iGraphics3D::*Method) (Param)>
+      struct CmdCall1 : public Command
+      {
+        Stored a;
+
+        CmdCall1 (Param a) : a (a) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { (g3d->*Method) (a); }
+      };
+      //@}
+
+      struct CmdSetPerspectiveCenter : public Command
+      {
+        int x, y;
+
+        CmdSetPerspectiveCenter (int x, int y) : x (x), y (y) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->SetPerspectiveCenter (x, y); }
+      };
+
+      struct CmdSetRenderTarget : public Command
+      {
+        csRef<iTextureHandle> handle;
+        bool persistent;
+        int subtexture;
+        csRenderTargetAttachment attachment;
+
+        CmdSetRenderTarget (iTextureHandle* handle, bool persistent,
+          int subtexture, csRenderTargetAttachment attachment)
+          : handle (handle), persistent (persistent), subtexture (subtexture),
+            attachment (attachment) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->SetRenderTarget (handle, persistent, subtexture, attachment); }
+      };
+
+      struct CmdBeginDraw : public Command
+      {
+        int drawFlags;
+
+        CmdBeginDraw (int drawFlags) : drawFlags (drawFlags) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->BeginDraw (drawFlags); }
+      };
+
+      struct CmdPrint : public Command
+      {
+        bool hasArea;
+        csRect area;
+
+        CmdPrint (const csRect* area) : hasArea (area != 0)
+        {
+          if (area) this->area = *area;
+        }
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->Print (hasArea ? &area : 0); }
+      };
+
+      /// Copy the arrays referenced by mesh modes into a command buffer
+      static void CopyModesData (CommandBuffer& buffer, RenderMeshModes& modes)
+      {
+        if (!modes.doInstancing) return;
+        modes.instParamsTargets = buffer.CopyArray (modes.instParamsTargets,
+          modes.instParamNum);
+        modes.instParamBuffers = buffer.CopyArray (modes.instParamBuffers,
+          modes.instParamNum);
+        if (modes.instParams)
+        {
+          csShaderVariable*** instances = static_cast<csShaderVariable***> (
+            buffer.Allocate (modes.instanceNum * sizeof (csShaderVariable**)));
+          for (size_t i = 0; i < modes.instanceNum; i++)
+          {
+            csShaderVariable** params = static_cast<csShaderVariable**> (
+              buffer.Allocate (modes.instParamNum * sizeof (csShaderVariable*)));
+            for (size_t p = 0; p < modes.instParamNum; p++)
+            {
+              csShaderVariable* sv = modes.instParams[i][p];
+              params[p] = sv ? buffer.Capture (sv) : 0;
+            }
+            instances[i] = params;
+          }
+          modes.instParams = instances;
+        }
+      }
+
+      struct CmdDrawMesh : public Command
+      {
+        CoreRenderMesh mesh;
+        RenderMeshModes modes;
+        CommandBuffer::StackSnapshot stack;
+
+        CmdDrawMesh (CommandBuffer& buffer, const CoreRenderMesh* mesh,
+          const RenderMeshModes& modes, const csShaderVariableStack& stack)
+          : mesh (*mesh), modes (modes), stack (buffer.Snapshot (stack))
+        {
+          this->mesh.multiRanges = buffer.CopyArray (mesh->multiRanges,
+            mesh->rangesNum);
+          CopyModesData (buffer, this->modes);
+        }
+        void Execute (iGraphics3D* g3d, ReplayContext& context)
+        {
+          g3d->DrawMesh (&mesh, modes, context.Expand (stack));
+          context.Release (stack);
+        }
+      };
+
+      struct CmdDrawMeshBasic : public Command
+      {
+        CoreRenderMesh mesh;
+        RenderMeshModes modes;
+
+        CmdDrawMeshBasic (CommandBuffer& buffer, const CoreRenderMesh* mesh,
+          const RenderMeshModes& modes) : mesh (*mesh), modes (modes)
+        {
+          this->mesh.multiRanges = buffer.CopyArray (mesh->multiRanges,
+            mesh->rangesNum);
+          CopyModesData (buffer, this->modes);
+        }
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->DrawMeshBasic (&mesh, modes); }
+      };
+
+      struct CmdDrawSimpleMeshes : public Command
+      {
+        csSimpleRenderMesh* meshes;
+        size_t numMeshes;
+        uint flags;
+
+        CmdDrawSimpleMeshes (CommandBuffer& buffer,
+          const csSimpleRenderMesh* src, size_t numMeshes, uint flags)
+          : numMeshes (numMeshes), flags (flags)
+        {
+          meshes = static_cast<csSimpleRenderMesh*> (
+            buffer.Allocate (numMeshes * sizeof (csSimpleRenderMesh)));
+          for (size_t i = 0; i < numMeshes; i++)
+          {
+            csSimpleRenderMesh& mesh = *new (meshes + i) csSimpleRenderMesh (
+              src[i]);
+            mesh.indices = buffer.CopyArray (mesh.indices, mesh.indexCount);
+            mesh.vertices = buffer.CopyArray (mesh.vertices, mesh.vertexCount);
+            mesh.texcoords = buffer.CopyArray (mesh.texcoords,
+              mesh.vertexCount);
+            mesh.colors = buffer.CopyArray (mesh.colors, mesh.vertexCount);
+            if (mesh.texture) mesh.texture->IncRef ();
+            if (mesh.shader) mesh.shader->IncRef ();
+            if (mesh.dynDomain) mesh.dynDomain->IncRef ();
+          }
+        }
+        ~CmdDrawSimpleMeshes ()
+        {
+          for (size_t i = 0; i < numMeshes; i++)
+          {
+            csSimpleRenderMesh& mesh = meshes[i];
+            if (mesh.texture) mesh.texture->DecRef ();
+            if (mesh.shader) mesh.shader->DecRef ();
+            if (mesh.dynDomain) mesh.dynDomain->DecRef ();
+            mesh.~csSimpleRenderMesh ();
+          }
+        }
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->DrawSimpleMeshes (meshes, numMeshes, flags); }
+      };
+
+      struct CmdDrawPixmap : public Command
+      {
+        csRef<iTextureHandle> hTex;
+        int sx, sy, sw, sh, tx, ty, tw, th;
+        uint8 alpha;
+
+        CmdDrawPixmap (iTextureHandle* hTex, int sx, int sy, int sw, int sh,
+          int tx, int ty, int tw, int th, uint8 alpha)
+          : hTex (hTex), sx (sx), sy (sy), sw (sw), sh (sh), tx (tx), ty (ty),
+            tw (tw), th (th), alpha (alpha) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->DrawPixmap (hTex, sx, sy, sw, sh, tx, ty, tw, th, alpha); }
+      };
+
+      struct CmdDrawLine : public Command
+      {
+        csVector3 v1, v2;
+        float fov;
+        int color;
+
+        CmdDrawLine (const csVector3& v1, const csVector3& v2, float fov,
+          int color) : v1 (v1), v2 (v2), fov (fov), color (color) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->DrawLine (v1, v2, fov, color); }
+      };
+
+      struct CmdActivateBufferHolder : public Command
+      {
+        csRef<csRenderBufferHolder> holder;
+        csRenderBufferName mapping[CS_VATTRIB_SPECIFIC_LAST+1];
+
+        CmdActivateBufferHolder (csRenderBufferHolder* holder,
+          const csRenderBufferName* mapping) : holder (holder)
+        {
+          memcpy (this->mapping, mapping, sizeof (this->mapping));
+        }
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->ActivateBuffers (holder, mapping); }
+      };
+
+      struct CmdActivateBuffers : public Command
+      {
+        csVertexAttrib* attribs;
+        RefArray<iRenderBuffer> buffers;
+
+        CmdActivateBuffers (CommandBuffer& buffer, csVertexAttrib* attribs,
+          iRenderBuffer** buffers, unsigned int count)
+          : attribs (buffer.CopyArray (attribs, count)),
+            buffers (buffer, buffers, count) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        {
+          g3d->ActivateBuffers (attribs, buffers.items,
+            (unsigned int)buffers.num);
+        }
+      };
+
+      struct CmdDeactivateBuffers : public Command
+      {
+        csVertexAttrib* attribs;
+        unsigned int count;
+
+        CmdDeactivateBuffers (CommandBuffer& buffer, csVertexAttrib* attribs,
+          unsigned int count)
+          : attribs (buffer.CopyArray (attribs, count)), count (count) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->DeactivateBuffers (attribs, count); }
+      };
+
+      struct CmdSetTextureState : public Command
+      {
+        int* units;
+        RefArray<iTextureHandle> textures;
+
+        CmdSetTextureState (CommandBuffer& buffer, int* units,
+          iTextureHandle** textures, int count)
+          : units (buffer.CopyArray (units, count)),
+            textures (buffer, textures, count) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->SetTextureState (units, textures.items, (int)textures.num); }
+      };
+
+      struct CmdSetTextureComparisonModes : public Command
+      {
+        int* units;
+        TextureComparisonMode* modes;
+        int count;
+
+        CmdSetTextureComparisonModes (CommandBuffer& buffer, int* units,
+          TextureComparisonMode* modes, int count)
+          : units (buffer.CopyArray (units, count)),
+            modes (buffer.CopyArray (modes, count)), count (count) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->SetTextureComparisonModes (units, modes, count); }
+      };
+
+      struct CmdSetClipper : public Command
+      {
+        csRef<iClipper2D> clipper;
+        int clipType;
+
+        CmdSetClipper (iClipper2D* clipper, int clipType)
+          : clipper (clipper), clipType (clipType) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->SetClipper (clipper, clipType); }
+      };
+
+      struct CmdSetWriteMask : public Command
+      {
+        bool red, green, blue, alpha;
+
+        CmdSetWriteMask (bool red, bool green, bool blue, bool alpha)
+          : red (red), green (green), blue (blue), alpha (alpha) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->SetWriteMask (red, green, blue, alpha); }
+      };
+
+      struct CmdOpenPortal : public Command
+      {
+        size_t numVertices;
+        csVector2* vertices;
+        csPlane3 normal;
+        csFlags flags;
+
+        CmdOpenPortal (CommandBuffer& buffer, size_t numVertices,
+          const csVector2* vertices, const csPlane3& normal, csFlags flags)
+          : numVertices (numVertices),
+            vertices (buffer.CopyArray (vertices, numVertices)),
+            normal (normal), flags (flags) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        { g3d->OpenPortal (numVertices, vertices, normal, flags); }
+      };
+
+      struct CmdCopyFromRenderTargets : public Command
+      {
+        csRenderTargetAttachment* attachments;
+        RefArray<iTextureHandle> textures;
+        int* subtextures;
+
+        CmdCopyFromRenderTargets (CommandBuffer& buffer, size_t num,
+          csRenderTargetAttachment* attachments, iTextureHandle** textures,
+          int* subtextures)
+          : attachments (buffer.CopyArray (attachments, num)),
+            textures (buffer, textures, num),
+            subtextures (buffer.CopyArray (subtextures, num)) {}
+        void Execute (iGraphics3D* g3d, ReplayContext&)
+        {
+          g3d->CopyFromRenderTargets (textures.num, attachments,
+            textures.items, subtextures);
+        }
+      };
+
+      struct CmdActivatePass : public Command
+      {
+        csRef<iShader> shader;
+        size_t ticket;
+        size_t pass;
+
+        CmdActivatePass (iShader* shader, size_t ticket, size_t pass)
+          : shader (shader), ticket (ticket), pass (pass) {}
+        void Execute (iGraphics3D*, ReplayContext& context)
+        { context.passActive = shader->ActivatePass (ticket, pass); }
+      };
+
+      struct CmdDrawMeshPass : public Command
+      {
+        csRef<iShader> shader;
+        size_t ticket;
+        RenderMesh mesh;
+        RenderMeshModes modes;
+        csZBufMode zmode;
+        CommandBuffer::StackSnapshot stack;
+
+        CmdDrawMeshPass (CommandBuffer& buffer, iShader* shader,
+          size_t ticket, const RenderMesh* mesh,
+          const RenderMeshModes& modes, csZBufMode zmode,
+          const csShaderVariableStack& stack)
+          : shader (shader), ticket (ticket), mesh (*mesh), modes (modes),
+            zmode (zmode), stack (buffer.Snapshot (stack))
+        {
+          this->mesh.multiRanges = buffer.CopyArray (mesh->multiRanges,
+            mesh->rangesNum);
+          CopyModesData (buffer, this->mesh);
+          CopyModesData (buffer, this->modes);
+        }
+        void Execute (iGraphics3D* g3d, ReplayContext& context)
+        {
+          if (!context.passActive) return;
+          const csShaderVariableStack& svStack (context.Expand (stack));
+          RenderMeshModes passModes (modes);
+          if (shader->SetupPass (ticket, &mesh, passModes, svStack))
+          {
+            passModes.z_buf_mode = zmode;
+            g3d->DrawMesh (&mesh, passModes, svStack);
+            shader->TeardownPass (ticket);
+          }
+          context.Release (stack);
+        }
+      };
+
+      struct CmdDeactivatePass : public Command
+      {
+        csRef<iShader> shader;
+        size_t ticket;
+
+        CmdDeactivatePass (iShader* shader, size_t ticket)
+          : shader (shader), ticket (ticket) {}
+        void Execute (iGraphics3D*, ReplayContext& context)
+        {
+          if (context.passActive) shader->DeactivatePass (ticket);
+          context.passActive = false;
+        }
+      };
+    } // anonymous namespace
+
+    //-----------------------------------------------------------------------
+
+    class RecordingGraphics3D::SubmissionThread :
+      public CS::Threading::Runnable
+    {
+      RecordingGraphics3D* owner;
+    public:
+      SubmissionThread (RecordingGraphics3D* owner) : owner (owner) {}
+
+      void Run ()
+      {
+        owner->RunSubmission ();
+      }
+      const char* GetName () const
+      {
+        return "graphics submission";
+      }
+    };
+
+    RecordingGraphics3D::RecordingGraphics3D (iGraphics3D* backend,
+                                              bool threaded)
+      : scfImplementationType (this), backend (backend), threaded (threaded),
+        pendingBuffer (0), replayThreadID (0), immediateMode (false),
+        stopThread (false), drawFlags (0), clipType (0), hasNearPlane (false),
+        zmode (CS_ZBUF_NONE), perspectiveCenterX (0), perspectiveCenterY (0),
+        perspectiveAspect (0), edgeDrawing (false), tessellation (false)
+    {
+      recordBuffer = &buffers[0];
+      for (int a = 0; a < rtaNumAttachments; a++)
+      {
+        renderTargets[a] = 0;
+        renderTargetSubtex[a] = 0;
+      }
+      for (int i = 0; i < 4; i++) writeMask[i] = true;
+
+      // Start out with the state of the backend
+      backend->GetWriteMask (writeMask[0], writeMask[1], writeMask[2],
+        writeMask[3]);
+      zmode = backend->GetZMode ();
+      drawFlags = backend->GetCurrentDrawFlags ();
+      clipper = backend->GetClipper ();
+      clipType = backend->GetClipType ();
+      hasNearPlane = backend->HasNearPlane ();
+      if (hasNearPlane) nearPlane = backend->GetNearPlane ();
+      worldToCamera = backend->GetWorldToCamera ();
+      projectionMatrix = backend->GetProjectionMatrix ();
+      backend->GetPerspectiveCenter (perspectiveCenterX, perspectiveCenterY);
+      perspectiveAspect = backend->GetPerspectiveAspect ();
+      edgeDrawing = backend->GetEdgeDrawing ();
+      tessellation = backend->GetTessellation ();
+
+      if (threaded)
+      {
+        csRef<SubmissionThread> runnable;
+        runnable.AttachNew (new SubmissionThread (this));
+        submitThread.AttachNew (new CS::Threading::Thread (runnable, true));
+      }
+    }
+
+    RecordingGraphics3D::~RecordingGraphics3D ()
+    {
+      Sync ();
+      if (submitThread)
+      {
+        {
+          CS::Threading::MutexScopedLock lock (submitMutex);
+          stopThread = true;
+          submitCondition.NotifyAll ();
+        }
+        submitThread->Wait ();
+      }
+    }
+
+    void RecordingGraphics3D::ReplayBuffer (CommandBuffer* buffer)
+    {
+      csMicroTicks start = csGetMicroTicks ();
+      buffer->Replay (backend, replayContext);
+      const csMicroTicks replayTime = csGetMicroTicks () - start;
+      // Runs on the submission thread while the statistics may be queried
+      CS::Threading::MutexScopedLock lock (submitMutex);
+      stats.replayTime += replayTime;
+    }
+
+    void RecordingGraphics3D::RunSubmission ()
+    {
+      replayThreadID = CS::Threading::Thread::GetThreadID ();
+      CS::Threading::MutexScopedLock lock (submitMutex);
+      while (true)
+      {
+        while (!pendingBuffer && !stopThread)
+          submitCondition.Wait (submitMutex);
+        if (!pendingBuffer) break;
+
+        CommandBuffer* buffer = pendingBuffer;
+        submitMutex.Unlock ();
+        ReplayBuffer (buffer);
+        submitMutex.Lock ();
+        pendingBuffer = 0;
+        submitCondition.NotifyAll ();
+      }
+    }
+
+    void RecordingGraphics3D::WaitForPending ()
+    {
+      // Must be called with submitMutex locked
+      if (!pendingBuffer) return;
+      csMicroTicks start = csGetMicroTicks ();
+      while (pendingBuffer)
+        submitCondition.Wait (submitMutex);
+      stats.waitTime += csGetMicroTicks () - start;
+    }
+
+    void RecordingGraphics3D::Submit ()
+    {
+      if (IsImmediate () || recordBuffer->IsEmpty ()) return;
+
+      {
+        CS::Threading::MutexScopedLock lock (submitMutex);
+        stats.submits++;
+        stats.commands += recordBuffer->GetCommandCount ();
+        stats.commandBytes += recordBuffer->GetUsedMemory ();
+        stats.capturedVariables += recordBuffer->GetCapturedVariableCount ();
+      }
+      if (threaded)
+      {
+        {
+          CS::Threading::MutexScopedLock lock (submitMutex);
+          WaitForPending ();
+          pendingBuffer = recordBuffer;
+          submitCondition.NotifyAll ();
+        }
+        // The other buffer was replayed completely, reuse it
+        recordBuffer = (recordBuffer == &buffers[0]) ? &buffers[1]
+          : &buffers[0];
+      }
+      else
+      {
+        replayThreadID = CS::Threading::Thread::GetThreadID ();
+        ReplayBuffer (recordBuffer);
+        replayThreadID = 0;
+      }
+      recordBuffer->Clear ();
+    }
+
+    void RecordingGraphics3D::Sync ()
+    {
+      if (IsImmediate ()) return;
+      Submit ();
+      if (threaded)
+      {
+        CS::Threading::MutexScopedLock lock (submitMutex);
+        if (pendingBuffer) stats.syncs++;
+        WaitForPending ();
+      }
+    }
+
+    void RecordingGraphics3D::GetStatistics (RecorderStatistics& stats)
+    {
+      CS::Threading::MutexScopedLock lock (submitMutex);
+      stats = this->stats;
+    }
+
+    void RecordingGraphics3D::ResetStatistics ()
+    {
+      CS::Threading::MutexScopedLock lock (submitMutex);
+      stats = RecorderStatistics ();
+    }
+
+    //-- Shader passes
+
+    void RecordingGraphics3D::ActivatePass (iShader* shader, size_t ticket,
+                                            size_t pass)
+    {
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdActivatePass)))
+        CmdActivatePass (shader, ticket, pass));
+    }
+
+    void RecordingGraphics3D::DrawMeshPass (iShader* shader, size_t ticket,
+      const RenderMesh* mesh, const RenderMeshModes& modes, csZBufMode zmode,
+      const csShaderVariableStack& stack)
+    {
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdDrawMeshPass)))
+        CmdDrawMeshPass (*recordBuffer, shader, ticket, mesh, modes, zmode,
+          stack));
+    }
+
+    void RecordingGraphics3D::DeactivatePass (iShader* shader, size_t ticket)
+    {
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdDeactivatePass)))
+        CmdDeactivatePass (shader, ticket));
+    }
+
+    //-- Calls forwarded directly
+
+    bool RecordingGraphics3D::Open ()
+    {
+      Sync ();
+      return backend->Open ();
+    }
+
+    void RecordingGraphics3D::Close ()
+    {
+      Sync ();
+      backend->Close ();
+    }
+
+    iGraphics2D* RecordingGraphics3D::GetDriver2D ()
+    {
+      return backend->GetDriver2D ();
+    }
+
+    iTextureManager* RecordingGraphics3D::GetTextureManager ()
+    {
+      return backend->GetTextureManager ();
+    }
+
+    void RecordingGraphics3D::SetDimensions (int width, int height)
+    {
+      Sync ();
+      backend->SetDimensions (width, height);
+    }
+
+    int RecordingGraphics3D::GetWidth () const
+    {
+      return backend->GetWidth ();
+    }
+
+    int RecordingGraphics3D::GetHeight () const
+    {
+      return backend->GetHeight ();
+    }
+
+    const csGraphics3DCaps* RecordingGraphics3D::GetCaps () const
+    {
+      return backend->GetCaps ();
+    }
+
+    bool RecordingGraphics3D::ValidateRenderTargets ()
+    {
+      Sync ();
+      return backend->ValidateRenderTargets ();
+    }
+
+    bool RecordingGraphics3D::CanSetRenderTarget (const char* format,
+      csRenderTargetAttachment attachment)
+    {
+      Sync ();
+      return backend->CanSetRenderTarget (format, attachment);
+    }
+
+    bool RecordingGraphics3D::SetRenderState (G3D_RENDERSTATEOPTION op,
+                                              long val)
+    {
+      Sync ();
+      bool result = backend->SetRenderState (op, val);
+      edgeDrawing = backend->GetEdgeDrawing ();
+      return result;
+    }
+
+    long RecordingGraphics3D::GetRenderState (G3D_RENDERSTATEOPTION op) const
+    {
+      if (op == G3DRENDERSTATE_EDGES) return edgeDrawing;
+      return backend->GetRenderState (op);
+    }
+
+    bool RecordingGraphics3D::SetOption (const char* name, const char* value)
+    {
+      Sync ();
+      return backend->SetOption (name, value);
+    }
+
+    float RecordingGraphics3D::GetZBuffValue (int x, int y)
+    {
+      Sync ();
+      return backend->GetZBuffValue (x, y);
+    }
+
+    iHalo* RecordingGraphics3D::CreateHalo (float iR, float iG, float iB,
+      unsigned char* iAlpha, int iWidth, int iHeight)
+    {
+      Sync ();
+      return backend->CreateHalo (iR, iG, iB, iAlpha, iWidth, iHeight);
+    }
+
+    bool RecordingGraphics3D::PerformExtensionV (char const* command,
+                                                 va_list args)
+    {
+      Sync ();
+      return backend->PerformExtensionV (command, args);
+    }
+
+    void RecordingGraphics3D::OQInitQueries (unsigned int* queries,
+                                             int num_queries)
+    {
+      Sync ();
+      backend->OQInitQueries (queries, num_queries);
+    }
+
+    void RecordingGraphics3D::OQDelQueries (unsigned int* queries,
+                                            int num_queries)
+    {
+      Sync ();
+      backend->OQDelQueries (queries, num_queries);
+    }
+
+    bool RecordingGraphics3D::OQueryFinished (unsigned int occlusion_query)
+    {
+      Sync ();
+      return backend->OQueryFinished (occlusion_query);
+    }
+
+    bool RecordingGraphics3D::OQIsVisible (unsigned int occlusion_query,
+                                           unsigned int sampleLimit)
+    {
+      Sync ();
+      return backend->OQIsVisible (occlusion_query, sampleLimit);
+    }
+
+    //-- Recorded calls
+
+    void RecordingGraphics3D::SetPerspectiveCenter (int x, int y)
+    {
+      perspectiveCenterX = x;
+      perspectiveCenterY = y;
+      if (IsImmediate ())
+      {
+        backend->SetPerspectiveCenter (x, y);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdSetPerspectiveCenter))) CmdSetPerspectiveCenter (x, y));
+    }
+
+    void RecordingGraphics3D::GetPerspectiveCenter (int& x, int& y) const
+    {
+      x = perspectiveCenterX;
+      y = perspectiveCenterY;
+    }
+
+    void RecordingGraphics3D::SetPerspectiveAspect (float aspect)
+    {
+      perspectiveAspect = aspect;
+      if (IsImmediate ())
+      {
+        backend->SetPerspectiveAspect (aspect);
+        return;
+      }
+      typedef CmdCall1<float, float, &iGraphics3D::SetPerspectiveAspect> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (aspect));
+    }
+
+    float RecordingGraphics3D::GetPerspectiveAspect () const
+    {
+      return perspectiveAspect;
+    }
+
+    bool RecordingGraphics3D::SetRenderTarget (iTextureHandle* handle,
+      bool persistent, int subtexture, csRenderTargetAttachment attachment)
+    {
+      if (IsImmediate ())
+      {
+        if (!backend->SetRenderTarget (handle, persistent, subtexture,
+            attachment))
+          return false;
+      }
+      else
+      {
+        Record (new (recordBuffer->AllocateCommand (
+          sizeof (CmdSetRenderTarget))) CmdSetRenderTarget (handle,
+            persistent, subtexture, attachment));
+      }
+      renderTargets[attachment] = handle;
+      renderTargetSubtex[attachment] = subtexture;
+      return true;
+    }
+
+    iTextureHandle* RecordingGraphics3D::GetRenderTarget (
+      csRenderTargetAttachment attachment, int* subtexture) const
+    {
+      if (subtexture) *subtexture = renderTargetSubtex[attachment];
+      return renderTargets[attachment];
+    }
+
+    void RecordingGraphics3D::UnsetRenderTargets ()
+    {
+      for (int a = 0; a < rtaNumAttachments; a++)
+      {
+        renderTargets[a] = 0;
+        renderTargetSubtex[a] = 0;
+      }
+      if (IsImmediate ())
+      {
+        backend->UnsetRenderTargets ();
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::UnsetRenderTargets> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    bool RecordingGraphics3D::BeginDraw (int drawFlags)
+    {
+      if ((drawFlags & CSDRAW_2DGRAPHICS) && !IsImmediate ())
+      {
+        // Canvas drawing isn't recorded, so catch up and forward everything
+        Sync ();
+        immediateMode = true;
+      }
+      this->drawFlags = drawFlags;
+      if (IsImmediate ()) return backend->BeginDraw (drawFlags);
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdBeginDraw)))
+        CmdBeginDraw (drawFlags));
+      return true;
+    }
+
+    void RecordingGraphics3D::FinishDraw ()
+    {
+      drawFlags = 0;
+      for (int a = 0; a < rtaNumAttachments; a++)
+      {
+        renderTargets[a] = 0;
+        renderTargetSubtex[a] = 0;
+      }
+      if (IsImmediate ())
+      {
+        backend->FinishDraw ();
+        immediateMode = false;
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::FinishDraw> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    void RecordingGraphics3D::Print (csRect const* area)
+    {
+      if (IsImmediate ())
+      {
+        backend->Print (area);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdPrint)))
+        CmdPrint (area));
+      // End of frame: let the submission thread work on it
+      Submit ();
+    }
+
+    void RecordingGraphics3D::DrawMesh (const CoreRenderMesh* mymesh,
+      const RenderMeshModes& modes, const csShaderVariableStack& stack)
+    {
+      if (IsImmediate ())
+      {
+        backend->DrawMesh (mymesh, modes, stack);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdDrawMesh)))
+        CmdDrawMesh (*recordBuffer, mymesh, modes, stack));
+    }
+
+    void RecordingGraphics3D::DrawMeshBasic (const CoreRenderMesh* mymesh,
+      const RenderMeshModes& modes)
+    {
+      if (IsImmediate ())
+      {
+        backend->DrawMeshBasic (mymesh, modes);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdDrawMeshBasic)))
+        CmdDrawMeshBasic (*recordBuffer, mymesh, modes));
+    }
+
+    void RecordingGraphics3D::DrawSimpleMesh (const csSimpleRenderMesh& mesh,
+                                              uint flags)
+    {
+      DrawSimpleMeshes (&mesh, 1, flags);
+    }
+
+    void RecordingGraphics3D::DrawSimpleMeshes (
+      const csSimpleRenderMesh* meshes, size_t numMeshes, uint flags)
+    {
+      if (IsImmediate ())
+      {
+        backend->DrawSimpleMeshes (meshes, numMeshes, flags);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdDrawSimpleMeshes))) CmdDrawSimpleMeshes (*recordBuffer,
+          meshes, numMeshes, flags));
+    }
+
+    void RecordingGraphics3D::DrawPixmap (iTextureHandle* hTex, int sx,
+      int sy, int sw, int sh, int tx, int ty, int tw, int th, uint8 Alpha)
+    {
+      if (IsImmediate ())
+      {
+        backend->DrawPixmap (hTex, sx, sy, sw, sh, tx, ty, tw, th, Alpha);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdDrawPixmap)))
+        CmdDrawPixmap (hTex, sx, sy, sw, sh, tx, ty, tw, th, Alpha));
+    }
+
+    void RecordingGraphics3D::DrawLine (const csVector3& v1,
+      const csVector3& v2, float fov, int color)
+    {
+      if (IsImmediate ())
+      {
+        backend->DrawLine (v1, v2, fov, color);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdDrawLine)))
+        CmdDrawLine (v1, v2, fov, color));
+    }
+
+    bool RecordingGraphics3D::ActivateBuffers (csRenderBufferHolder* holder,
+      csRenderBufferName mapping[CS_VATTRIB_SPECIFIC_LAST+1])
+    {
+      if (IsImmediate ()) return backend->ActivateBuffers (holder, mapping);
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdActivateBufferHolder))) CmdActivateBufferHolder (holder,
+          mapping));
+      return true;
+    }
+
+    bool RecordingGraphics3D::ActivateBuffers (csVertexAttrib* attribs,
+      iRenderBuffer** buffers, unsigned int count)
+    {
+      if (IsImmediate ())
+        return backend->ActivateBuffers (attribs, buffers, count);
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdActivateBuffers))) CmdActivateBuffers (*recordBuffer,
+          attribs, buffers, count));
+      return true;
+    }
+
+    void RecordingGraphics3D::DeactivateBuffers (csVertexAttrib* attribs,
+                                                 unsigned int count)
+    {
+      if (IsImmediate ())
+      {
+        backend->DeactivateBuffers (attribs, count);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdDeactivateBuffers))) CmdDeactivateBuffers (*recordBuffer,
+          attribs, count));
+    }
+
+    void RecordingGraphics3D::SetTextureState (int* units,
+      iTextureHandle** textures, int count)
+    {
+      if (IsImmediate ())
+      {
+        backend->SetTextureState (units, textures, count);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdSetTextureState))) CmdSetTextureState (*recordBuffer,
+          units, textures, count));
+    }
+
+    void RecordingGraphics3D::SetTextureComparisonModes (int* units,
+      TextureComparisonMode* texCompare, int count)
+    {
+      if (IsImmediate ())
+      {
+        backend->SetTextureComparisonModes (units, texCompare, count);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdSetTextureComparisonModes))) CmdSetTextureComparisonModes (
+          *recordBuffer, units, texCompare, count));
+    }
+
+    void RecordingGraphics3D::SetClipper (iClipper2D* clipper, int cliptype)
+    {
+      this->clipper = clipper;
+      clipType = cliptype;
+      if (IsImmediate ())
+      {
+        backend->SetClipper (clipper, cliptype);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdSetClipper)))
+        CmdSetClipper (clipper, cliptype));
+    }
+
+    iClipper2D* RecordingGraphics3D::GetClipper ()
+    {
+      return clipper;
+    }
+
+    int RecordingGraphics3D::GetClipType () const
+    {
+      return clipType;
+    }
+
+    void RecordingGraphics3D::SetNearPlane (const csPlane3& pl)
+    {
+      nearPlane = pl;
+      hasNearPlane = true;
+      if (IsImmediate ())
+      {
+        backend->SetNearPlane (pl);
+        return;
+      }
+      typedef CmdCall1<csPlane3, const csPlane3&,
+        &iGraphics3D::SetNearPlane> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (pl));
+    }
+
+    void RecordingGraphics3D::ResetNearPlane ()
+    {
+      hasNearPlane = false;
+      if (IsImmediate ())
+      {
+        backend->ResetNearPlane ();
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::ResetNearPlane> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    const csPlane3& RecordingGraphics3D::GetNearPlane () const
+    {
+      return nearPlane;
+    }
+
+    bool RecordingGraphics3D::HasNearPlane () const
+    {
+      return hasNearPlane;
+    }
+
+    void RecordingGraphics3D::SetWriteMask (bool red, bool green, bool blue,
+                                            bool alpha)
+    {
+      writeMask[0] = red;
+      writeMask[1] = green;
+      writeMask[2] = blue;
+      writeMask[3] = alpha;
+      if (IsImmediate ())
+      {
+        backend->SetWriteMask (red, green, blue, alpha);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdSetWriteMask)))
+        CmdSetWriteMask (red, green, blue, alpha));
+    }
+
+    void RecordingGraphics3D::GetWriteMask (bool& red, bool& green,
+      bool& blue, bool& alpha) const
+    {
+      red = writeMask[0];
+      green = writeMask[1];
+      blue = writeMask[2];
+      alpha = writeMask[3];
+    }
+
+    void RecordingGraphics3D::SetZMode (csZBufMode mode)
+    {
+      zmode = mode;
+      if (IsImmediate ())
+      {
+        backend->SetZMode (mode);
+        return;
+      }
+      typedef CmdCall1<csZBufMode, csZBufMode, &iGraphics3D::SetZMode> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (mode));
+    }
+
+    csZBufMode RecordingGraphics3D::GetZMode ()
+    {
+      return zmode;
+    }
+
+    void RecordingGraphics3D::EnableZOffset ()
+    {
+      if (IsImmediate ())
+      {
+        backend->EnableZOffset ();
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::EnableZOffset> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    void RecordingGraphics3D::DisableZOffset ()
+    {
+      if (IsImmediate ())
+      {
+        backend->DisableZOffset ();
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::DisableZOffset> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    void RecordingGraphics3D::SetShadowState (int state)
+    {
+      if (IsImmediate ())
+      {
+        backend->SetShadowState (state);
+        return;
+      }
+      typedef CmdCall1<int, int, &iGraphics3D::SetShadowState> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (state));
+    }
+
+    void RecordingGraphics3D::OpenPortal (size_t numVertices,
+      const csVector2* vertices, const csPlane3& normal, csFlags flags)
+    {
+      if (IsImmediate ())
+      {
+        backend->OpenPortal (numVertices, vertices, normal, flags);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (sizeof (CmdOpenPortal)))
+        CmdOpenPortal (*recordBuffer, numVertices, vertices, normal, flags));
+    }
+
+    void RecordingGraphics3D::ClosePortal ()
+    {
+      if (IsImmediate ())
+      {
+        backend->ClosePortal ();
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::ClosePortal> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    void RecordingGraphics3D::SetWorldToCamera (
+      const csReversibleTransform& w2c)
+    {
+      worldToCamera = w2c;
+      if (IsImmediate ())
+      {
+        backend->SetWorldToCamera (w2c);
+        return;
+      }
+      typedef CmdCall1<csReversibleTransform, const csReversibleTransform&,
+        &iGraphics3D::SetWorldToCamera> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (w2c));
+    }
+
+    const csReversibleTransform& RecordingGraphics3D::GetWorldToCamera ()
+    {
+      return worldToCamera;
+    }
+
+    int RecordingGraphics3D::GetCurrentDrawFlags () const
+    {
+      return drawFlags;
+    }
+
+    const CS::Math::Matrix4& RecordingGraphics3D::GetProjectionMatrix ()
+    {
+      return projectionMatrix;
+    }
+
+    void RecordingGraphics3D::SetProjectionMatrix (const CS::Math::Matrix4& m)
+    {
+      projectionMatrix = m;
+      if (IsImmediate ())
+      {
+        backend->SetProjectionMatrix (m);
+        return;
+      }
+      typedef CmdCall1<CS::Math::Matrix4, const CS::Math::Matrix4&,
+        &iGraphics3D::SetProjectionMatrix> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (m));
+    }
+
+    void RecordingGraphics3D::CopyFromRenderTargets (size_t num,
+      csRenderTargetAttachment* attachments, iTextureHandle** textures,
+      int* subtextures)
+    {
+      if (IsImmediate ())
+      {
+        backend->CopyFromRenderTargets (num, attachments, textures,
+          subtextures);
+        return;
+      }
+      Record (new (recordBuffer->AllocateCommand (
+        sizeof (CmdCopyFromRenderTargets))) CmdCopyFromRenderTargets (
+          *recordBuffer, num, attachments, textures, subtextures));
+    }
+
+    void RecordingGraphics3D::OQBeginQuery (unsigned int occlusion_query)
+    {
+      if (IsImmediate ())
+      {
+        backend->OQBeginQuery (occlusion_query);
+        return;
+      }
+      typedef CmdCall1<unsigned int, unsigned int,
+        &iGraphics3D::OQBeginQuery> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd)))
+        Cmd (occlusion_query));
+    }
+
+    void RecordingGraphics3D::OQEndQuery ()
+    {
+      if (IsImmediate ())
+      {
+        backend->OQEndQuery ();
+        return;
+      }
+      typedef CmdCall0<&iGraphics3D::OQEndQuery> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd);
+    }
+
+    void RecordingGraphics3D::SetEdgeDrawing (bool flag)
+    {
+      edgeDrawing = flag;
+      if (IsImmediate ())
+      {
+        backend->SetEdgeDrawing (flag);
+        return;
+      }
+      typedef CmdCall1<bool, bool, &iGraphics3D::SetEdgeDrawing> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (flag));
+    }
+
+    bool RecordingGraphics3D::GetEdgeDrawing ()
+    {
+      return edgeDrawing;
+    }
+
+    void RecordingGraphics3D::SetTessellation (bool flag)
+    {
+      tessellation = flag;
+      if (IsImmediate ())
+      {
+        backend->SetTessellation (flag);
+        return;
+      }
+      typedef CmdCall1<bool, bool, &iGraphics3D::SetTessellation> Cmd;
+      Record (new (recordBuffer->AllocateCommand (sizeof (Cmd))) Cmd (flag));
+    }
+
+    bool RecordingGraphics3D::GetTessellation ()
+    {
+      return tessellation;
+    }
+  } // namespace Graphics
+} // namespace CS
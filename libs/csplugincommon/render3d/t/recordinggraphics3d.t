@@ -0,0 +1,346 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csplugincommon/render3d/recordinggraphics3d.h"
+#include "cstool/initapp.h"
+#include "csutil/stringarray.h"
+#include "ivideo/rendermesh.h"
+
+/**
+ * Test CS::Graphics::RecordingGraphics3D replays what was recorded.
+ */
+class RecordingGraphics3DTest : public CppUnit::TestFixture
+{
+private:
+  /**
+   * Renderer logging the calls relevant for the tests, then passing them on
+   * to the null renderer.
+   */
+  class LoggingGraphics3D : public CS::Graphics::RecordingGraphics3D
+  {
+  public:
+    csStringArray log;
+
+    LoggingGraphics3D (iGraphics3D* backend)
+      : CS::Graphics::RecordingGraphics3D (backend, false) {}
+
+    bool BeginDraw (int drawFlags)
+    {
+      log.Push (csString().Format ("BeginDraw %d", drawFlags));
+      return GetBackend()->BeginDraw (drawFlags);
+    }
+    void FinishDraw ()
+    {
+      log.Push ("FinishDraw");
+      GetBackend()->FinishDraw ();
+    }
+    void Print (csRect const* area)
+    {
+      log.Push ("Print");
+      GetBackend()->Print (area);
+    }
+    void SetZMode (csZBufMode mode)
+    {
+      log.Push (csString().Format ("SetZMode %d", int (mode)));
+      GetBackend()->SetZMode (mode);
+    }
+    void SetWorldToCamera (const csReversibleTransform& w2c)
+    {
+      const csVector3& o (w2c.GetOrigin ());
+      log.Push (csString().Format ("SetWorldToCamera %g %g %g",
+        o.x, o.y, o.z));
+      GetBackend()->SetWorldToCamera (w2c);
+    }
+    void DrawMesh (const CS::Graphics::CoreRenderMesh* mymesh,
+      const CS::Graphics::RenderMeshModes& modes,
+      const csShaderVariableStack& stack)
+    {
+      float value = -1;
+      if ((stack.GetSize () > 0) && stack[0]) stack[0]->GetValue (value);
+      log.Push (csString().Format ("DrawMesh %s %u-%u %d %g",
+        mymesh->db_mesh_name, mymesh->indexstart, mymesh->indexend,
+        int (modes.z_buf_mode), value));
+      GetBackend()->DrawMesh (mymesh, modes, stack);
+    }
+    void DrawSimpleMeshes (const csSimpleRenderMesh* meshes,
+      size_t numMeshes, uint flags)
+    {
+      for (size_t i = 0; i < numMeshes; i++)
+      {
+        const csSimpleRenderMesh& mesh = meshes[i];
+        log.Push (csString().Format ("DrawSimpleMesh %u %g %g %g",
+          mesh.vertexCount, mesh.vertices[0].x, mesh.vertices[1].y,
+          mesh.vertices[2].z));
+      }
+      GetBackend()->DrawSimpleMeshes (meshes, numMeshes, flags);
+    }
+  };
+
+  iObjectRegistry* object_reg;
+  csRef<LoggingGraphics3D> logger;
+
+  csRef<csShaderVariable> vars[3];
+  csShaderVariable* stackStorage[1];
+  csShaderVariableStack stack;
+  CS::Graphics::CoreRenderMesh meshes[3];
+
+  void Render (iGraphics3D* g3d);
+  void CheckReplay (bool threaded);
+public:
+  void setUp();
+  void tearDown();
+
+  void testReplayDirect();
+  void testReplayThreaded();
+  void testSnapshot();
+  void testSnapshotChanged();
+  void testSnapshotSlotMap();
+  void testStateQueries();
+  void testStatistics();
+
+  CPPUNIT_TEST_SUITE(RecordingGraphics3DTest);
+    CPPUNIT_TEST(testReplayDirect);
+    CPPUNIT_TEST(testReplayThreaded);
+    CPPUNIT_TEST(testSnapshot);
+    CPPUNIT_TEST(testSnapshotChanged);
+    CPPUNIT_TEST(testSnapshotSlotMap);
+    CPPUNIT_TEST(testStateQueries);
+    CPPUNIT_TEST(testStatistics);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void RecordingGraphics3DTest::setUp()
+{
+  const char* const fake_argv[] = { "", 0 };
+  object_reg = csInitializer::CreateEnvironment (0, fake_argv);
+  CS_ASSERT (object_reg);
+  bool status = csInitializer::SetupConfigManager (object_reg, 0);
+  CS_ASSERT (status);
+  status = csInitializer::RequestPlugins (object_reg,
+    CS_REQUEST_NULL3D,
+    // The plugins below aren't really required but present to quell warnings
+    CS_REQUEST_FONTSERVER,
+    CS_REQUEST_ENGINE,
+    CS_REQUEST_LEVELLOADER,
+    CS_REQUEST_IMAGELOADER,
+    CS_REQUEST_END);
+  CS_ASSERT (status);
+  status = csInitializer::OpenApplication (object_reg);
+  CS_ASSERT (status);
+
+  csRef<iGraphics3D> g3d (csQueryRegistry<iGraphics3D> (object_reg));
+  CS_ASSERT (g3d);
+  logger.AttachNew (new LoggingGraphics3D (g3d));
+
+  static const char* const meshNames[3] = { "first", "second", "third" };
+  for (int i = 0; i < 3; i++)
+  {
+    vars[i].AttachNew (new csShaderVariable (CS::ShaderVarStringID (0)));
+    vars[i]->SetValue (float (i + 1));
+    meshes[i].db_mesh_name = meshNames[i];
+    meshes[i].indexstart = i * 3;
+    meshes[i].indexend = i * 3 + 3;
+  }
+  stackStorage[0] = 0;
+  stack.Setup (stackStorage, 1);
+}
+
+void RecordingGraphics3DTest::tearDown()
+{
+  logger.Invalidate ();
+  for (int i = 0; i < 3; i++) vars[i].Invalidate ();
+  csInitializer::DestroyApplication (object_reg);
+  object_reg = 0;
+}
+
+/* Render a "frame" with some representative calls */
+void RecordingGraphics3DTest::Render (iGraphics3D* g3d)
+{
+  g3d->BeginDraw (CSDRAW_3DGRAPHICS | CSDRAW_CLEARZBUFFER);
+  g3d->SetWorldToCamera (csReversibleTransform (csMatrix3 (),
+    csVector3 (1, 2, 3)));
+  for (int i = 0; i < 3; i++)
+  {
+    g3d->SetZMode ((i & 1) ? CS_ZBUF_TEST : CS_ZBUF_USE);
+    stackStorage[0] = vars[i];
+    CS::Graphics::RenderMeshModes modes;
+    modes.z_buf_mode = CS_ZBUF_MESH;
+    g3d->DrawMesh (&meshes[i], modes, stack);
+  }
+  stackStorage[0] = 0;
+
+  csVector3 vertices[3] = { csVector3 (1, 0, 0), csVector3 (0, 2, 0),
+    csVector3 (0, 0, 3) };
+  csSimpleRenderMesh simpleMesh;
+  simpleMesh.vertexCount = 3;
+  simpleMesh.vertices = vertices;
+  g3d->DrawSimpleMesh (simpleMesh);
+  // Change the data after recording; the replay must not see this
+  vertices[0].x = 10;
+
+  g3d->FinishDraw ();
+  g3d->Print (0);
+}
+
+void RecordingGraphics3DTest::CheckReplay (bool threaded)
+{
+  Render (logger);
+  csStringArray directLog (logger->log);
+  logger->log.Empty ();
+
+  {
+    csRef<CS::Graphics::RecordingGraphics3D> recorder;
+    recorder.AttachNew (new CS::Graphics::RecordingGraphics3D (logger,
+      threaded));
+    Render (recorder);
+    recorder->Sync ();
+  }
+
+  CPPUNIT_ASSERT_EQUAL (directLog.GetSize (), logger->log.GetSize ());
+  for (size_t i = 0; i < directLog.GetSize (); i++)
+  {
+    CPPUNIT_ASSERT_EQUAL (std::string (directLog[i]),
+      std::string (logger->log[i]));
+  }
+}
+
+/* Test replaying on the recording thread issues the same calls */
+void RecordingGraphics3DTest::testReplayDirect()
+{
+  CheckReplay (false);
+}
+
+/* Test replaying on the submission thread issues the same calls */
+void RecordingGraphics3DTest::testReplayThreaded()
+{
+  CheckReplay (true);
+}
+
+/* Test shader variables are replayed with their value at recording time */
+void RecordingGraphics3DTest::testSnapshot()
+{
+  csRef<CS::Graphics::RecordingGraphics3D> recorder;
+  recorder.AttachNew (new CS::Graphics::RecordingGraphics3D (logger, true));
+  recorder->BeginDraw (CSDRAW_3DGRAPHICS);
+  stackStorage[0] = vars[0];
+  recorder->DrawMesh (&meshes[0], CS::Graphics::RenderMeshModes (), stack);
+  stackStorage[0] = 0;
+  vars[0]->SetValue (42.0f);
+  recorder->FinishDraw ();
+  recorder->Sync ();
+
+  CPPUNIT_ASSERT_EQUAL (size_t (3), logger->log.GetSize ());
+  csString drawMesh (logger->log[1]);
+  CPPUNIT_ASSERT (drawMesh.StartsWith ("DrawMesh first"));
+  CPPUNIT_ASSERT (drawMesh.EndsWith (" 1"));
+}
+
+/* Test a variable changed between two draws of a frame replays with the
+   value of each draw, like the parameters of the lights in a light pass */
+void RecordingGraphics3DTest::testSnapshotChanged()
+{
+  csRef<CS::Graphics::RecordingGraphics3D> recorder;
+  recorder.AttachNew (new CS::Graphics::RecordingGraphics3D (logger, true));
+  recorder->BeginDraw (CSDRAW_3DGRAPHICS);
+  stackStorage[0] = vars[0];
+  recorder->DrawMesh (&meshes[0], CS::Graphics::RenderMeshModes (), stack);
+  vars[0]->SetValue (7.0f);
+  recorder->DrawMesh (&meshes[1], CS::Graphics::RenderMeshModes (), stack);
+  // Unchanged, so the copy of the second draw is reused
+  recorder->DrawMesh (&meshes[2], CS::Graphics::RenderMeshModes (), stack);
+  stackStorage[0] = 0;
+  recorder->FinishDraw ();
+  recorder->Sync ();
+
+  CPPUNIT_ASSERT_EQUAL (size_t (5), logger->log.GetSize ());
+  CPPUNIT_ASSERT (csString (logger->log[1]).EndsWith (" 1"));
+  CPPUNIT_ASSERT (csString (logger->log[2]).EndsWith (" 7"));
+  CPPUNIT_ASSERT (csString (logger->log[3]).EndsWith (" 7"));
+
+  CS::Graphics::RecorderStatistics stats;
+  recorder->GetStatistics (stats);
+  CPPUNIT_ASSERT_EQUAL (uint64 (2), stats.capturedVariables);
+}
+
+/* Test a stack using a slot map replays its variables by name */
+void RecordingGraphics3DTest::testSnapshotSlotMap()
+{
+  CS::Graphics::ShaderVarSlotMap slotMap (16);
+  csShaderVariableStack mappedStack;
+  mappedStack.Setup (0, &slotMap);
+  // Give a name beyond the size of the map a slot before name 0
+  mappedStack.Set (CS::ShaderVarStringID (100), vars[2]);
+  mappedStack.Set (CS::ShaderVarStringID (0), vars[1]);
+
+  csRef<CS::Graphics::RecordingGraphics3D> recorder;
+  recorder.AttachNew (new CS::Graphics::RecordingGraphics3D (logger, true));
+  recorder->BeginDraw (CSDRAW_3DGRAPHICS);
+  recorder->DrawMesh (&meshes[0], CS::Graphics::RenderMeshModes (),
+    mappedStack);
+  recorder->FinishDraw ();
+  recorder->Sync ();
+
+  CPPUNIT_ASSERT_EQUAL (size_t (3), logger->log.GetSize ());
+  CPPUNIT_ASSERT (csString (logger->log[1]).EndsWith (" 2"));
+}
+
+/* Test state set on the recorder can be queried before it's replayed */
+void RecordingGraphics3DTest::testStateQueries()
+{
+  csRef<CS::Graphics::RecordingGraphics3D> recorder;
+  recorder.AttachNew (new CS::Graphics::RecordingGraphics3D (logger, true));
+  recorder->BeginDraw (CSDRAW_3DGRAPHICS);
+  recorder->SetZMode (CS_ZBUF_EQUAL);
+  recorder->SetWorldToCamera (csReversibleTransform (csMatrix3 (),
+    csVector3 (4, 5, 6)));
+  recorder->SetWriteMask (true, false, true, false);
+
+  CPPUNIT_ASSERT_EQUAL (CS_ZBUF_EQUAL, recorder->GetZMode ());
+  CPPUNIT_ASSERT (recorder->GetWorldToCamera ().GetOrigin ()
+    == csVector3 (4, 5, 6));
+  CPPUNIT_ASSERT_EQUAL (int (CSDRAW_3DGRAPHICS),
+    recorder->GetCurrentDrawFlags ());
+  bool r, g, b, a;
+  recorder->GetWriteMask (r, g, b, a);
+  CPPUNIT_ASSERT (r && !g && b && !a);
+
+  recorder->FinishDraw ();
+  CPPUNIT_ASSERT_EQUAL (0, recorder->GetCurrentDrawFlags ());
+}
+
+/* Test the statistics count submitted frames */
+void RecordingGraphics3DTest::testStatistics()
+{
+  csRef<CS::Graphics::RecordingGraphics3D> recorder;
+  recorder.AttachNew (new CS::Graphics::RecordingGraphics3D (logger, true));
+  Render (recorder);
+  Render (recorder);
+  recorder->Sync ();
+
+  CS::Graphics::RecorderStatistics stats;
+  recorder->GetStatistics (stats);
+  CPPUNIT_ASSERT_EQUAL (2u, stats.submits);
+  CPPUNIT_ASSERT (stats.commands >= 2 * 10);
+  CPPUNIT_ASSERT (stats.commandBytes > 0);
+  CPPUNIT_ASSERT_EQUAL (uint64 (2 * 3), stats.capturedVariables);
+
+  recorder->ResetStatistics ();
+  recorder->GetStatistics (stats);
+  CPPUNIT_ASSERT_EQUAL (0u, stats.submits);
+  CPPUNIT_ASSERT_EQUAL (uint64 (0), stats.commands);
+}
@@ -133,10 +133,15 @@ namespace RenderManager
   {
     CS::ShaderVarStringID name = sv->GetName();
     
-    if (name >= dst.GetSize()) return false;
-    csShaderVariable*& dstVar = dst[name];
+    // Stacks with a slot map can take any name
+    if (!dst.GetSlotMap() && (name >= dst.GetSize())) return false;
+    csShaderVariable* dstVar = dst[name];
 
-    if (dstVar == 0) dstVar = CreateTempSV (name);
+    if (dstVar == 0)
+    {
+      dstVar = CreateTempSV (name);
+      dst.Set (name, dstVar);
+    }
     if ((dstVar->GetType() != csShaderVariable::UNKNOWN)
 	  && (dstVar->GetType() != csShaderVariable::ARRAY)) return true;
     dstVar->SetArrayElement (index, sv);
@@ -165,7 +170,7 @@ namespace RenderManager
     csShaderVariableStack& stack)
   {
     csShaderVariable* var = CreateTempSV (name);
-    stack[name] = var;
+    stack.Set (name, var);
     return var;
   }
   
@@ -0,0 +1,367 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csplugincommon/rendermanager/lighttiles.h"
+#include "csplugincommon/rendermanager/operations.h"
+#include "csutil/bitops.h"
+#include "csutil/sysfunc.h"
+
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace CS
+{
+  namespace RenderManager
+  {
+    // Radius of the spheres padding the light arrays; never intersects
+    static const float paddingRadius = -1e30f;
+
+    // Make a plane from a 4D vector and normalize it
+    static csPlane3 MakePlane (const csVector4& v)
+    {
+      csPlane3 p (v.x, v.y, v.z, v.w);
+      p.Normalize ();
+      return p;
+    }
+
+    static inline bool SphereInside (const csPlane3& p, float x, float y,
+                                     float z, float r)
+    {
+      return p.Classify (csVector3 (x, y, z)) >= -r;
+    }
+
+    LightTileCuller::Statistics::Statistics ()
+      : lights (0), visibleLights (0), tiles (0), occupiedTiles (0),
+        entries (0), maxTileLights (0), cullTime (0)
+    {
+      for (int c = 0; c < numTileClasses; c++)
+        tileClasses[c] = 0;
+    }
+
+    LightTileCuller::LightTileCuller (uint tileSize)
+      : tileSize (csMax (tileSize, 1u)), width (0), height (0), tilesX (0),
+        tilesY (0), numLights (0), maskWords (0)
+    {
+      tileOffsets.Push (0);
+      lightTileOffsets.Push (0);
+    }
+
+    void LightTileCuller::Setup (int width, int height,
+                                 const CS::Math::Matrix4& projection)
+    {
+      this->width = csMax (width, 1);
+      this->height = csMax (height, 1);
+      tilesX = (this->width + tileSize - 1) / tileSize;
+      tilesY = (this->height + tileSize - 1) / tileSize;
+
+      /* A point p in view space lies right of x = s in normalized device
+         coordinates if Row1.p - s * Row4.p >= 0, and similar for the other
+         boundaries; the planes of the columns and rows follow from that. */
+      const csVector4 rowX (projection.Row1 ());
+      const csVector4 rowY (projection.Row2 ());
+      const csVector4 rowW (projection.Row4 ());
+      colPlanes.SetSize (tilesX * 2);
+      for (uint c = 0; c < tilesX; c++)
+      {
+        float x0 = 2.0f * (c * tileSize) / this->width - 1.0f;
+        float x1 = 2.0f * csMin (int ((c + 1) * tileSize), this->width)
+          / this->width - 1.0f;
+        colPlanes[c * 2] = MakePlane (rowX - rowW * x0);
+        colPlanes[c * 2 + 1] = MakePlane (rowW * x1 - rowX);
+      }
+      rowPlanes.SetSize (tilesY * 2);
+      for (uint r = 0; r < tilesY; r++)
+      {
+        float y0 = 2.0f * (r * tileSize) / this->height - 1.0f;
+        float y1 = 2.0f * csMin (int ((r + 1) * tileSize), this->height)
+          / this->height - 1.0f;
+        rowPlanes[r * 2] = MakePlane (rowY - rowW * y0);
+        rowPlanes[r * 2 + 1] = MakePlane (rowW * y1 - rowY);
+      }
+      /* Orthographic projections have no eye point (Row4 has no normal),
+         so the near plane, where z in normalized device coordinates is -1,
+         culls the lights behind the view instead. */
+      if (csVector3 (rowW.x, rowW.y, rowW.z).SquaredNorm () > SMALL_EPSILON)
+        eyePlane = MakePlane (rowW);
+      else
+        eyePlane = MakePlane (csVector4 (projection.Row3 ()) + rowW);
+
+      tileOffsets.SetSize (GetTileCount () + 1, 0);
+      lightList.Empty ();
+    }
+
+    void LightTileCuller::ClearLights ()
+    {
+      numLights = 0;
+      lightX.Empty ();
+      lightY.Empty ();
+      lightZ.Empty ();
+      lightR.Empty ();
+    }
+
+    size_t LightTileCuller::AddLight (const csVector3& center, float radius)
+    {
+      lightX.Push (center.x);
+      lightY.Push (center.y);
+      lightZ.Push (center.z);
+      lightR.Push (radius);
+      return numLights++;
+    }
+
+    void LightTileCuller::TestSlab (const csPlane3& p0, const csPlane3& p1,
+                                    uint32* mask) const
+    {
+      const float* xs = lightX.GetArray ();
+      const float* ys = lightY.GetArray ();
+      const float* zs = lightZ.GetArray ();
+      const float* rs = lightR.GetArray ();
+      // The light arrays are padded to a multiple of 4
+      const size_t num = lightX.GetSize ();
+
+      for (size_t w = 0; w < maskWords; w++)
+        mask[w] = 0;
+#ifdef CS_SUPPORTS_SSE2
+      const __m128 a0 = _mm_set1_ps (p0.norm.x);
+      const __m128 b0 = _mm_set1_ps (p0.norm.y);
+      const __m128 c0 = _mm_set1_ps (p0.norm.z);
+      const __m128 d0 = _mm_set1_ps (p0.DD);
+      const __m128 a1 = _mm_set1_ps (p1.norm.x);
+      const __m128 b1 = _mm_set1_ps (p1.norm.y);
+      const __m128 c1 = _mm_set1_ps (p1.norm.z);
+      const __m128 d1 = _mm_set1_ps (p1.DD);
+      const __m128 zero = _mm_setzero_ps ();
+      for (size_t i = 0; i < num; i += 4)
+      {
+        const __m128 x = _mm_loadu_ps (xs + i);
+        const __m128 y = _mm_loadu_ps (ys + i);
+        const __m128 z = _mm_loadu_ps (zs + i);
+        const __m128 negR = _mm_sub_ps (zero, _mm_loadu_ps (rs + i));
+        // Same order of operations as csPlane3::Classify()
+        __m128 dist0 = _mm_add_ps (_mm_add_ps (_mm_add_ps (
+          _mm_mul_ps (a0, x), _mm_mul_ps (b0, y)), _mm_mul_ps (c0, z)), d0);
+        __m128 dist1 = _mm_add_ps (_mm_add_ps (_mm_add_ps (
+          _mm_mul_ps (a1, x), _mm_mul_ps (b1, y)), _mm_mul_ps (c1, z)), d1);
+        __m128 inside = _mm_and_ps (_mm_cmpge_ps (dist0, negR),
+          _mm_cmpge_ps (dist1, negR));
+        uint32 bits = uint32 (_mm_movemask_ps (inside));
+        mask[i / 32] |= bits << (i % 32);
+      }
+#else
+      for (size_t i = 0; i < num; i++)
+      {
+        if (SphereInside (p0, xs[i], ys[i], zs[i], rs[i])
+            && SphereInside (p1, xs[i], ys[i], zs[i], rs[i]))
+          mask[i / 32] |= 1u << (i % 32);
+      }
+#endif
+    }
+
+    void LightTileCuller::CullSlabs (void* data, size_t first, size_t num)
+    {
+      LightTileCuller* culler = static_cast<LightTileCuller*> (data);
+      const size_t words = culler->maskWords;
+      const uint32* visible = culler->visibleMask.GetArray ();
+      for (size_t s = first; s < first + num; s++)
+      {
+        uint32* mask;
+        if (s < culler->tilesX)
+        {
+          mask = culler->colMasks.GetArray () + s * words;
+          culler->TestSlab (culler->colPlanes[s * 2],
+            culler->colPlanes[s * 2 + 1], mask);
+        }
+        else
+        {
+          const size_t r = s - culler->tilesX;
+          mask = culler->rowMasks.GetArray () + r * words;
+          culler->TestSlab (culler->rowPlanes[r * 2],
+            culler->rowPlanes[r * 2 + 1], mask);
+        }
+        // Lights behind the eye don't need to be checked for each tile
+        for (size_t w = 0; w < words; w++)
+          mask[w] &= visible[w];
+      }
+    }
+
+    void LightTileCuller::CountTileRows (void* data, size_t first, size_t num)
+    {
+      LightTileCuller* culler = static_cast<LightTileCuller*> (data);
+      const size_t words = culler->maskWords;
+      uint* counts = culler->tileOffsets.GetArray () + 1;
+      for (size_t r = first; r < first + num; r++)
+      {
+        const uint32* rowMask = culler->rowMasks.GetArray () + r * words;
+        for (size_t c = 0; c < culler->tilesX; c++)
+        {
+          const uint32* colMask = culler->colMasks.GetArray () + c * words;
+          uint count = 0;
+          for (size_t w = 0; w < words; w++)
+            count += CS::Utility::BitOps::ComputeBitsSet (rowMask[w]
+              & colMask[w]);
+          counts[r * culler->tilesX + c] = count;
+        }
+      }
+    }
+
+    void LightTileCuller::FillTileRows (void* data, size_t first, size_t num)
+    {
+      LightTileCuller* culler = static_cast<LightTileCuller*> (data);
+      const size_t words = culler->maskWords;
+      for (size_t r = first; r < first + num; r++)
+      {
+        const uint32* rowMask = culler->rowMasks.GetArray () + r * words;
+        for (size_t c = 0; c < culler->tilesX; c++)
+        {
+          const uint32* colMask = culler->colMasks.GetArray () + c * words;
+          uint* out = culler->lightList.GetArray ()
+            + culler->tileOffsets[r * culler->tilesX + c];
+          for (size_t w = 0; w < words; w++)
+          {
+            uint32 bits = rowMask[w] & colMask[w];
+            unsigned long bit;
+            while (CS::Utility::BitOps::ScanBitForward (bits, bit))
+            {
+              *out++ = uint (w * 32 + bit);
+              bits &= bits - 1;
+            }
+          }
+        }
+      }
+    }
+
+    void LightTileCuller::Cull (iJobQueue* queue)
+    {
+      const csMicroTicks startTime = csGetMicroTicks ();
+      const size_t numTiles = GetTileCount ();
+
+      // Pad the light arrays for the SIMD tests
+      while ((lightX.GetSize () % 4) != 0)
+      {
+        lightX.Push (0);
+        lightY.Push (0);
+        lightZ.Push (0);
+        lightR.Push (paddingRadius);
+      }
+      maskWords = (lightX.GetSize () + 31) / 32;
+      visibleMask.SetSize (maskWords);
+      colMasks.SetSize (tilesX * maskWords);
+      rowMasks.SetSize (tilesY * maskWords);
+
+      /* A tile's frustum is the intersection of the slabs of its column and
+         row, so the lights in a tile are the ones in both slabs. Testing the
+         slabs once saves testing each light against all planes of each
+         tile. */
+      TestSlab (eyePlane, eyePlane, visibleMask.GetArray ());
+      Implementation::RunOperationParallel (queue, tilesX + tilesY,
+        &CullSlabs, this);
+
+      tileOffsets.SetSize (numTiles + 1);
+      tileOffsets[0] = 0;
+      Implementation::RunOperationParallel (queue, tilesY, &CountTileRows,
+        this);
+      stats = Statistics ();
+      for (size_t t = 0; t < numTiles; t++)
+      {
+        const uint count = tileOffsets[t + 1];
+        stats.tileClasses[GetTileClass (count)]++;
+        if (count > 0) stats.occupiedTiles++;
+        stats.maxTileLights = csMax (stats.maxTileLights, count);
+        tileOffsets[t + 1] += tileOffsets[t];
+      }
+      lightList.SetSize (tileOffsets[numTiles]);
+      Implementation::RunOperationParallel (queue, tilesY, &FillTileRows,
+        this);
+
+      // Tile lists of the lights
+      lightTileOffsets.SetSize (numLights + 1);
+      for (size_t l = 0; l <= numLights; l++)
+        lightTileOffsets[l] = 0;
+      for (size_t i = 0; i < lightList.GetSize (); i++)
+        lightTileOffsets[lightList[i] + 1]++;
+      for (size_t l = 0; l < numLights; l++)
+      {
+        if (lightTileOffsets[l + 1] > 0) stats.visibleLights++;
+        lightTileOffsets[l + 1] += lightTileOffsets[l];
+      }
+      lightTiles.SetSize (lightList.GetSize ());
+      /* Use the offsets as insertion points; afterwards each one points to
+         the start of the next light's list, so shift them back */
+      for (size_t t = 0; t < numTiles; t++)
+      {
+        for (uint i = tileOffsets[t]; i < tileOffsets[t + 1]; i++)
+          lightTiles[lightTileOffsets[lightList[i]]++] = uint (t);
+      }
+      for (size_t l = numLights; l > 0; l--)
+        lightTileOffsets[l] = lightTileOffsets[l - 1];
+      lightTileOffsets[0] = 0;
+
+      // Drop the padding again so more lights can be added
+      lightX.SetSize (numLights);
+      lightY.SetSize (numLights);
+      lightZ.SetSize (numLights);
+      lightR.SetSize (numLights);
+
+      stats.lights = uint (numLights);
+      stats.tiles = uint (numTiles);
+      stats.entries = uint (lightList.GetSize ());
+      stats.cullTime = csGetMicroTicks () - startTime;
+    }
+
+    void LightTileCuller::GetTileBounds (size_t tile, csVector2& min,
+                                         csVector2& max) const
+    {
+      const int c = int (tile % tilesX);
+      const int r = int (tile / tilesX);
+      const int ts = int (tileSize);
+      min.Set (2.0f * (c * ts) / width - 1.0f,
+        2.0f * (r * ts) / height - 1.0f);
+      max.Set (2.0f * csMin ((c + 1) * ts, width) / width - 1.0f,
+        2.0f * csMin ((r + 1) * ts, height) / height - 1.0f);
+    }
+
+    uint LightTileCuller::GetTileClass (size_t numLights)
+    {
+      uint tileClass = 0;
+      size_t limit = 0;
+      while ((numLights > limit) && (tileClass < numTileClasses - 1))
+      {
+        tileClass++;
+        limit = limit ? limit * 4 : 4;
+      }
+      return tileClass;
+    }
+
+    bool LightTileCuller::TestLightTile (size_t light, size_t tile) const
+    {
+      const size_t c = tile % tilesX;
+      const size_t r = tile / tilesX;
+      const float x = lightX[light];
+      const float y = lightY[light];
+      const float z = lightZ[light];
+      const float radius = lightR[light];
+      return SphereInside (eyePlane, x, y, z, radius)
+        && SphereInside (colPlanes[c * 2], x, y, z, radius)
+        && SphereInside (colPlanes[c * 2 + 1], x, y, z, radius)
+        && SphereInside (rowPlanes[r * 2], x, y, z, radius)
+        && SphereInside (rowPlanes[r * 2 + 1], x, y, z, radius);
+    }
+  } // namespace RenderManager
+} // namespace CS
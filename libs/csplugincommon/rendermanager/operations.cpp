@@ -0,0 +1,87 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csplugincommon/rendermanager/operations.h"
+
+#include "csutil/scf_implementation.h"
+#include "iutil/job.h"
+
+namespace CS
+{
+  namespace RenderManager
+  {
+    namespace Implementation
+    {
+      /* Operations on a single object are usually cheap, so don't bother
+       * the job queue for less than this many objects per batch. */
+      static const size_t minObjectsPerBatch = 16;
+      // Maximum number of batches a range is split into
+      static const size_t maxBatches = 16;
+
+      namespace
+      {
+        class OperationBatchJob :
+          public scfImplementation1<OperationBatchJob, iJob>
+        {
+          OperationRangeFunc func;
+          void* data;
+          size_t first;
+          size_t num;
+        public:
+          OperationBatchJob (OperationRangeFunc func, void* data,
+                             size_t first, size_t num)
+            : scfImplementationType (this), func (func), data (data),
+              first (first), num (num) {}
+
+          void Run ()
+          {
+            func (data, first, num);
+          }
+        };
+      } // anonymous namespace
+
+      void RunOperationParallel (iJobQueue* queue, size_t num,
+                                 OperationRangeFunc func, void* data)
+      {
+        size_t batches = num / minObjectsPerBatch;
+        if (batches > maxBatches) batches = maxBatches;
+        if (!queue || (batches <= 1))
+        {
+          func (data, 0, num);
+          return;
+        }
+
+        const size_t batchSize = (num + batches - 1) / batches;
+        csRef<OperationBatchJob> jobs[maxBatches];
+        size_t numJobs = 0;
+        for (size_t first = batchSize; first < num; first += batchSize)
+        {
+          jobs[numJobs].AttachNew (new OperationBatchJob (func, data, first,
+            csMin (batchSize, num - first)));
+          queue->Enqueue (jobs[numJobs]);
+          numJobs++;
+        }
+        func (data, 0, batchSize);
+        for (size_t j = 0; j < numJobs; j++)
+          queue->PullAndRun (jobs[j]);
+      }
+    } // namespace Implementation
+  } // namespace RenderManager
+} // namespace CS
@@ -356,7 +356,7 @@ void PostEffectManager::GetLayerRenderSVs (const Layer* layer,
     csRef<csShaderVariable> sv;
     if (input.manualInput.IsValid())
     {
-      svStack[input.manualInput->GetName()] = input.manualInput;
+      svStack.Set (input.manualInput->GetName(), input.manualInput);
     }
     else
     {
@@ -365,7 +365,7 @@ void PostEffectManager::GetLayerRenderSVs (const Layer* layer,
       {
         sv.AttachNew (new csShaderVariable (svName));
         sv->SetType (csShaderVariable::TEXTURE);
-        svStack[svName] = sv;
+        svStack.Set (svName, sv);
       }
     }
     
@@ -378,7 +378,7 @@ void PostEffectManager::GetLayerRenderSVs (const Layer* layer,
       {
         sv.AttachNew (new csShaderVariable (svName));
         sv->SetType (csShaderVariable::RENDERBUFFER);
-        svStack[svName] = sv;
+        svStack.Set (svName, sv);
       }
     }
   }
@@ -0,0 +1,258 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csplugincommon/rendermanager/lighttiles.h"
+#include "csgeom/projections.h"
+#include "csutil/randomgen.h"
+#include "csutil/threadjobqueue.h"
+
+/**
+ * Test CS::RenderManager::LightTileCuller sorts lights into the right tiles.
+ */
+class LightTileCullerTest : public CppUnit::TestFixture
+{
+private:
+  static const int width = 640;
+  static const int height = 480;
+
+  static CS::Math::Matrix4 Projection ()
+  {
+    return CS::Math::Projections::CSPerspective (width, height,
+      width / 2, height / 2, 1.0f / (width / 2));
+  }
+  static void AddRandomLights (CS::RenderManager::LightTileCuller& culler,
+    size_t num);
+  static void CheckAgainstReference (
+    const CS::RenderManager::LightTileCuller& culler);
+public:
+  void testReference();
+  void testReferenceUnevenSize();
+  void testSingleLight();
+  void testOrthographic();
+  void testParallel();
+  void testStatistics();
+
+  CPPUNIT_TEST_SUITE(LightTileCullerTest);
+    CPPUNIT_TEST(testReference);
+    CPPUNIT_TEST(testReferenceUnevenSize);
+    CPPUNIT_TEST(testSingleLight);
+    CPPUNIT_TEST(testOrthographic);
+    CPPUNIT_TEST(testParallel);
+    CPPUNIT_TEST(testStatistics);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+void LightTileCullerTest::AddRandomLights (
+  CS::RenderManager::LightTileCuller& culler, size_t num)
+{
+  csRandomGen rng (1234);
+  for (size_t i = 0; i < num; i++)
+  {
+    // Some lights end up behind the eye or outside the view
+    csVector3 center ((rng.Get () - 0.5f) * 40.0f,
+      (rng.Get () - 0.5f) * 30.0f, (rng.Get () - 0.1f) * 50.0f);
+    culler.AddLight (center, 0.2f + rng.Get () * 3.0f);
+  }
+}
+
+/* Compare the lists of all tiles and lights with testing each light against
+   each tile */
+void LightTileCullerTest::CheckAgainstReference (
+  const CS::RenderManager::LightTileCuller& culler)
+{
+  for (size_t t = 0; t < culler.GetTileCount (); t++)
+  {
+    const uint* lights = culler.GetTileLights (t);
+    const size_t numLights = culler.GetTileLightCount (t);
+    size_t n = 0;
+    for (size_t l = 0; l < culler.GetLightCount (); l++)
+    {
+      if (!culler.TestLightTile (l, t)) continue;
+      CPPUNIT_ASSERT (n < numLights);
+      CPPUNIT_ASSERT_EQUAL (uint (l), lights[n]);
+      n++;
+    }
+    CPPUNIT_ASSERT_EQUAL (n, numLights);
+  }
+
+  for (size_t l = 0; l < culler.GetLightCount (); l++)
+  {
+    const uint* tiles = culler.GetLightTiles (l);
+    const size_t numTiles = culler.GetLightTileCount (l);
+    size_t n = 0;
+    for (size_t t = 0; t < culler.GetTileCount (); t++)
+    {
+      if (!culler.TestLightTile (l, t)) continue;
+      CPPUNIT_ASSERT (n < numTiles);
+      CPPUNIT_ASSERT_EQUAL (uint (t), tiles[n]);
+      n++;
+    }
+    CPPUNIT_ASSERT_EQUAL (n, numTiles);
+  }
+}
+
+/* Test the culled lists match testing each light against each tile */
+void LightTileCullerTest::testReference()
+{
+  CS::RenderManager::LightTileCuller culler (32);
+  culler.Setup (width, height, Projection ());
+  CPPUNIT_ASSERT_EQUAL (20u, culler.GetTilesX ());
+  CPPUNIT_ASSERT_EQUAL (15u, culler.GetTilesY ());
+  AddRandomLights (culler, 203);
+  culler.Cull ();
+  CheckAgainstReference (culler);
+}
+
+/* Test tiles at the border which are smaller than the tile size */
+void LightTileCullerTest::testReferenceUnevenSize()
+{
+  CS::RenderManager::LightTileCuller culler (100);
+  culler.Setup (width, height, Projection ());
+  CPPUNIT_ASSERT_EQUAL (7u, culler.GetTilesX ());
+  CPPUNIT_ASSERT_EQUAL (5u, culler.GetTilesY ());
+
+  csVector2 min, max;
+  culler.GetTileBounds (culler.GetTileCount () - 1, min, max);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL (1.0, max.x, 1e-5);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL (1.0, max.y, 1e-5);
+
+  AddRandomLights (culler, 61);
+  culler.Cull ();
+  CheckAgainstReference (culler);
+}
+
+/* Test a small light ahead only lands in the tiles at the center, and a
+   light behind the eye in no tile */
+void LightTileCullerTest::testSingleLight()
+{
+  CS::RenderManager::LightTileCuller culler (32);
+  culler.Setup (width, height, Projection ());
+  culler.AddLight (csVector3 (0, 0, 10), 0.1f);
+  culler.AddLight (csVector3 (0, 0, -10), 1.0f);
+  culler.Cull ();
+
+  // The center of the screen is on the border of two tiles in row 7
+  CPPUNIT_ASSERT_EQUAL (size_t (2), culler.GetLightTileCount (0));
+  const uint* tiles = culler.GetLightTiles (0);
+  CPPUNIT_ASSERT_EQUAL (7u * 20 + 9, tiles[0]);
+  CPPUNIT_ASSERT_EQUAL (7u * 20 + 10, tiles[1]);
+
+  CPPUNIT_ASSERT_EQUAL (size_t (0), culler.GetLightTileCount (1));
+}
+
+/* Test an orthographic projection: lights are culled by the near plane
+   instead of the eye */
+void LightTileCullerTest::testOrthographic()
+{
+  // View space x in [-20, 20], y in [-15, 15], z ahead in [0.1, 100]
+  CS::RenderManager::LightTileCuller culler (32);
+  culler.Setup (width, height, CS::Math::Projections::Ortho (-20, 20,
+    -15, 15, -0.1f, -100.0f));
+  culler.AddLight (csVector3 (0, 0, 10), 0.1f);
+  culler.AddLight (csVector3 (0, 0, -10), 1.0f);
+  culler.AddLight (csVector3 (15, 0, 50), 0.1f);
+  culler.Cull ();
+
+  CPPUNIT_ASSERT_EQUAL (size_t (2), culler.GetLightTileCount (0));
+  const uint* tiles = culler.GetLightTiles (0);
+  CPPUNIT_ASSERT_EQUAL (7u * 20 + 9, tiles[0]);
+  CPPUNIT_ASSERT_EQUAL (7u * 20 + 10, tiles[1]);
+  CPPUNIT_ASSERT_EQUAL (size_t (0), culler.GetLightTileCount (1));
+  // x = 15 is at 7/8 of the width, in the middle of column 17
+  CPPUNIT_ASSERT_EQUAL (size_t (1), culler.GetLightTileCount (2));
+  CPPUNIT_ASSERT_EQUAL (7u * 20 + 17, culler.GetLightTiles (2)[0]);
+
+  culler.ClearLights ();
+  AddRandomLights (culler, 203);
+  culler.Cull ();
+  CheckAgainstReference (culler);
+  CPPUNIT_ASSERT (culler.GetStatistics ().visibleLights > 0);
+}
+
+/* Test culling on a job queue gives the same result */
+void LightTileCullerTest::testParallel()
+{
+  csRef<iJobQueue> queue;
+  queue.AttachNew (new CS::Threading::ThreadedJobQueue (4));
+
+  CS::RenderManager::LightTileCuller serial (16);
+  serial.Setup (width, height, Projection ());
+  AddRandomLights (serial, 517);
+  serial.Cull ();
+
+  CS::RenderManager::LightTileCuller parallel (16);
+  parallel.Setup (width, height, Projection ());
+  AddRandomLights (parallel, 517);
+  parallel.Cull (queue);
+
+  const uint* serialOffsets = serial.GetTileOffsets ();
+  const uint* parallelOffsets = parallel.GetTileOffsets ();
+  for (size_t t = 0; t <= serial.GetTileCount (); t++)
+    CPPUNIT_ASSERT_EQUAL (serialOffsets[t], parallelOffsets[t]);
+  const size_t numEntries = serialOffsets[serial.GetTileCount ()];
+  for (size_t i = 0; i < numEntries; i++)
+  {
+    CPPUNIT_ASSERT_EQUAL (serial.GetLightList ()[i],
+      parallel.GetLightList ()[i]);
+  }
+}
+
+/* Test the statistics describe the culled lists */
+void LightTileCullerTest::testStatistics()
+{
+  CS::RenderManager::LightTileCuller culler (32);
+  culler.Setup (width, height, Projection ());
+  AddRandomLights (culler, 100);
+  culler.AddLight (csVector3 (0, 0, -10), 1.0f);
+  culler.Cull ();
+
+  const CS::RenderManager::LightTileCuller::Statistics& stats =
+    culler.GetStatistics ();
+  CPPUNIT_ASSERT_EQUAL (101u, stats.lights);
+  CPPUNIT_ASSERT_EQUAL (300u, stats.tiles);
+
+  uint visible = 0;
+  for (size_t l = 0; l < culler.GetLightCount (); l++)
+    if (culler.GetLightTileCount (l) > 0) visible++;
+  CPPUNIT_ASSERT_EQUAL (visible, stats.visibleLights);
+  CPPUNIT_ASSERT (stats.visibleLights < stats.lights);
+
+  uint occupied = 0, entries = 0, maxLights = 0, classTotal = 0;
+  for (size_t t = 0; t < culler.GetTileCount (); t++)
+  {
+    uint n = uint (culler.GetTileLightCount (t));
+    if (n > 0) occupied++;
+    entries += n;
+    maxLights = csMax (maxLights, n);
+  }
+  for (int c = 0; c < CS::RenderManager::LightTileCuller::numTileClasses; c++)
+    classTotal += stats.tileClasses[c];
+  CPPUNIT_ASSERT_EQUAL (occupied, stats.occupiedTiles);
+  CPPUNIT_ASSERT_EQUAL (entries, stats.entries);
+  CPPUNIT_ASSERT_EQUAL (maxLights, stats.maxTileLights);
+  CPPUNIT_ASSERT_EQUAL (stats.tiles, classTotal);
+
+  CPPUNIT_ASSERT_EQUAL (0u,
+    CS::RenderManager::LightTileCuller::GetTileClass (0));
+  CPPUNIT_ASSERT_EQUAL (1u,
+    CS::RenderManager::LightTileCuller::GetTileClass (4));
+  CPPUNIT_ASSERT_EQUAL (2u,
+    CS::RenderManager::LightTileCuller::GetTileClass (5));
+  CPPUNIT_ASSERT_EQUAL (4u,
+    CS::RenderManager::LightTileCuller::GetTileClass (1000));
+}
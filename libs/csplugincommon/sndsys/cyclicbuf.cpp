@@ -17,16 +17,29 @@
 */
 
 #include "cssysdef.h"
+#include "csutil/threading/atomicops.h"
 #include "csplugincommon/sndsys/cyclicbuf.h"
 
 using namespace CS::SndSys;
+using namespace CS::Threading;
+
+// The start and end values are shared between the reading and writing thread
+static inline size_t AtomicRead (size_t* value)
+{
+  return (size_t)AtomicOperations::Read ((void**)(void*)value);
+}
+
+static inline void AtomicSet (size_t* value, size_t new_value)
+{
+  AtomicOperations::Set ((void**)(void*)value, (void*)new_value);
+}
 
 SoundCyclicBuffer::SoundCyclicBuffer(size_t buffer_size)
 {
   buffer_base = new uint8[buffer_size];
-  write_ptr=buffer_base;
   start_value=0;
   end_value=0;
+  base_value=0;
   length=buffer_size;
 }
 
@@ -37,67 +50,65 @@ SoundCyclicBuffer::~SoundCyclicBuffer()
 
 size_t SoundCyclicBuffer::GetFreeBytes()
 {
-  return (length - (end_value-start_value));
+  return (length - (AtomicRead (&end_value) - AtomicRead (&start_value)));
 }
 
 void SoundCyclicBuffer::AddBytes(void *bytes_ptr,size_t bytes_length)
 {
-  size_t pass_bytes;
-  uint8 *end_ptr, *read_ptr;
-  CS_ASSERT(bytes_length <= (length - (end_value-start_value)));
+  size_t pass_bytes, write_offset;
+  uint8 *read_ptr;
+  CS_ASSERT(bytes_length <= GetFreeBytes());
 
   read_ptr=(uint8 *)bytes_ptr;
 
+  // Only this thread changes end_value
+  write_offset=(end_value - base_value) % length;
+
   // Potential 2-pass copying
-  end_ptr=(buffer_base+length);
-  pass_bytes=end_ptr-write_ptr;
-  if (bytes_length < (size_t)pass_bytes)
+  pass_bytes=length-write_offset;
+  if (bytes_length < pass_bytes)
     pass_bytes=bytes_length;
 
-  memcpy(write_ptr,read_ptr,pass_bytes);
-  write_ptr+=pass_bytes;
-  end_value+=pass_bytes;
-  if (write_ptr >= end_ptr)
-    write_ptr=buffer_base;
+  memcpy(buffer_base+write_offset,read_ptr,pass_bytes);
 
-  if (bytes_length > (size_t)pass_bytes)
+  if (bytes_length > pass_bytes)
   {
     // Second pass
-    read_ptr+=pass_bytes;
-    bytes_length-=pass_bytes;
-
-    memcpy(write_ptr,read_ptr,bytes_length);
-    write_ptr+=bytes_length;
-    end_value+=bytes_length;
+    memcpy(buffer_base,read_ptr+pass_bytes,bytes_length-pass_bytes);
   }
+
+  // Make the data available to readers once it's in place
+  AtomicSet (&end_value, end_value+bytes_length);
 }
 
 size_t SoundCyclicBuffer::GetStartValue()
 {
-  return start_value;
+  return AtomicRead (&start_value);
 }
 
 size_t SoundCyclicBuffer::GetEndValue()
 {
-  return end_value;
+  return AtomicRead (&end_value);
 }
 
-void SoundCyclicBuffer::Clear(long value)
+void SoundCyclicBuffer::Clear(size_t value)
 {
-  start_value=value;
-  end_value=value;
-  write_ptr=buffer_base;
+  base_value=value;
+  AtomicSet (&end_value, value);
+  AtomicSet (&start_value, value);
 }
 
 void SoundCyclicBuffer::AdvanceStartValue (size_t advance_amount)
 {
-  start_value+=advance_amount;
+  size_t new_start=start_value+advance_amount;
 
   /* end_value must always be greater than or equal to start value.
    * If start value is advanced past the end, the buffer still cannot get any 
    * more empty than empty. */
-  if (end_value < start_value)
-    end_value=start_value;
+  if (AtomicRead (&end_value) < new_start)
+    AtomicSet (&end_value, new_start);
+
+  AtomicSet (&start_value, new_start);
 }
 
 void SoundCyclicBuffer::GetDataPointersFromPosition(size_t *position_value, 
@@ -107,18 +118,15 @@ void SoundCyclicBuffer::GetDataPointersFromPosition(size_t *position_value,
 						    uint8 **buffer2, 
 						    size_t *buffer2_length)
 {
-  uint8 *read_ptr, *end_ptr;
-  size_t copy_length, available_length;
+  uint8 *read_ptr;
+  size_t copy_length, available_length, read_offset;
 
   if (*position_value < start_value)
     *position_value=start_value; /* Cannot read data we don't have.  
                                   * This likely means a source isn't keeping 
 				  * up */
 
-  //size_t filled_length;
-  //filled_length=end_value-start_value;
-  end_ptr=(buffer_base+length);
-  available_length=end_value - *position_value;
+  available_length=AtomicRead (&end_value) - *position_value;
 
   // More data requested than available, reduce to available amount
   if (max_length > available_length)
@@ -134,14 +142,11 @@ void SoundCyclicBuffer::GetDataPointersFromPosition(size_t *position_value,
 
   // First buffer
   // Calculate read position
-  
-  //read_ptr=(write_ptr-filled_length)+((*position_value)-start_value);
-  read_ptr = (write_ptr-end_value) + *position_value;
-  if (read_ptr < buffer_base)
-    read_ptr+=length;
+  read_offset=(*position_value - base_value) % length;
+  read_ptr=buffer_base+read_offset;
 
   // Calculate first buffer size
-  copy_length=end_ptr-read_ptr;
+  copy_length=length-read_offset;
   if (copy_length > max_length)
     copy_length=max_length;
 
@@ -161,4 +166,3 @@ void SoundCyclicBuffer::GetDataPointersFromPosition(size_t *position_value,
   *buffer2=buffer_base;
   *buffer2_length=max_length-copy_length;
 }
-
@@ -26,7 +26,7 @@ using namespace CS::SndSys;
 
 SndSysBasicData::SndSysBasicData(iBase *pParent) :
   scfImplementationType(this, pParent),
-  m_bInfoReady(false), m_pDescription(0)
+  m_bInfoReady(false), m_pDescription(0), m_DecodeAheadTime(0)
 {
 
 
@@ -58,6 +58,12 @@ void SndSysBasicData::SetDescription(const char *pDescription)
   m_pDescription = csStrNew (pDescription);
 }
 
+void SndSysBasicData::SetDecodeAhead (iJobQueue *pQueue, size_t time)
+{
+  m_DecodeQueue = pQueue;
+  m_DecodeAheadTime = time;
+}
+
 
 
 
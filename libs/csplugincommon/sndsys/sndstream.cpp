@@ -20,8 +20,43 @@
 #include "cssysdef.h"
 
 #include "csplugincommon/sndsys/sndstream.h"
+#include "csutil/cfgacc.h"
+#include "csutil/platform.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threadjobqueue.h"
+#include "csutil/threading/atomicops.h"
+#include "iutil/objreg.h"
 
 using namespace CS::SndSys;
+using namespace CS::Threading;
+
+namespace
+{
+  /// Decodes a stream ahead of its playback position
+  class SndSysStreamDecodeJob : public scfImplementation1<SndSysStreamDecodeJob, iJob>
+  {
+  public:
+    SndSysStreamDecodeJob (SndSysBasicStream *pStream) :
+      scfImplementationType (this), m_pStream (pStream) {}
+
+    virtual void Run () { m_pStream->DecodeAhead (); }
+
+  private:
+    /// The stream waits for this job before it goes away
+    SndSysBasicStream *m_pStream;
+  };
+}
+
+// The play position is shared with the decoder threads
+static inline size_t AtomicRead (size_t* value)
+{
+  return (size_t)AtomicOperations::Read ((void**)(void*)value);
+}
+
+static inline void AtomicSet (size_t* value, size_t new_value)
+{
+  AtomicOperations::Set ((void**)(void*)value, (void*)new_value);
+}
 
 SndSysBasicStream::SndSysBasicStream(csSndSysSoundFormat *pRenderFormat, int Mode3D) : 
  scfImplementationType(this),
@@ -79,13 +114,22 @@ SndSysBasicStream::SndSysBasicStream(csSndSysSoundFormat *pRenderFormat, int Mod
   m_bAutoUnregisterReady=false;
 
   // Playback not complete
-  m_bPlaybackReadComplete=false;
-
+  m_PlaybackReadComplete=0;
+
+  // Decode on demand unless EnableDecodeAhead() is called
+  m_DecodeJobQueued=0;
+  m_bDecoderPrimed=false;
+  m_DecodeAheadBytes=0;
+  m_HistoryBytes=0;
+  m_PlayPosition=0;
+  m_UnderrunCount=0;
+  m_DecodeTime=0;
 }
 
 
 SndSysBasicStream::~SndSysBasicStream()
 {
+  WaitForDecoder();
   delete m_pCyclicBuffer;
   delete m_pPCMConverter;
   delete[] m_pPreparedDataBuffer;
@@ -261,19 +305,36 @@ void SndSysBasicStream::GetDataPointers (size_t* position_marker,
                                             void **buffer2,
                                             size_t *buffer2_length)
 {
+  size_t max_length=max_requested_length;
+  bool all_read=true;
+
+  // Data decoded ahead is not available before its time
+  if (m_DecodeJob)
+  {
+    size_t read_position=*position_marker;
+    if (read_position < m_pCyclicBuffer->GetStartValue())
+      read_position=m_pCyclicBuffer->GetStartValue();
+    size_t available=(m_PlayPosition > read_position) ?
+      m_PlayPosition - read_position : 0;
+    if (max_length > available)
+      max_length=available;
+    all_read=(m_PlayPosition >= m_pCyclicBuffer->GetEndValue());
+  }
+
   m_pCyclicBuffer->GetDataPointersFromPosition (position_marker,
-    max_requested_length, (uint8 **)buffer1, buffer1_length, 
+    max_length, (uint8 **)buffer1, buffer1_length, 
     (uint8 **)buffer2,buffer2_length);
 
   /* If read is finished and we've underbuffered here, then we can mark the 
   * stream as paused so no further advancement takes place */
-  if ((m_PauseState == CS_SNDSYS_STREAM_UNPAUSED) && (m_bPlaybackReadComplete) 
+  if ((m_PauseState == CS_SNDSYS_STREAM_UNPAUSED) && IsPlaybackReadComplete() 
+    && all_read
     && ((*buffer1_length + *buffer2_length) < max_requested_length))
   {
     m_PauseState=CS_SNDSYS_STREAM_COMPLETED;
     if (m_bAutoUnregisterRequested)
       m_bAutoUnregisterReady=true;
-    m_bPlaybackReadComplete=false;
+    SetPlaybackReadComplete (false);
   }
 
   if (*position_marker > m_MostAdvancedReadPointer)
@@ -282,6 +343,160 @@ void SndSysBasicStream::GetDataPointers (size_t* position_marker,
 
 
 
+void SndSysBasicStream::AdvancePosition(size_t frame_delta)
+{
+  if (!m_DecodeJob)
+  {
+    if (m_NewPosition != InvalidPosition)
+    {
+      Seek (m_NewPosition);
+      m_NewPosition = InvalidPosition;
+      SetPlaybackReadComplete (false);
+
+      // Signal a full cyclic buffer flush
+      if (frame_delta > 0)
+        frame_delta=m_pCyclicBuffer->GetLength() / m_RenderFrameSize;
+    }
+    DecodeFrames (frame_delta);
+    return;
+  }
+
+  if (m_NewPosition != InvalidPosition)
+  {
+    WaitForDecoder();
+    Seek (m_NewPosition);
+    m_NewPosition = InvalidPosition;
+    SetPlaybackReadComplete (false);
+
+    // Drop the data decoded ahead of the old position
+    m_pCyclicBuffer->Clear (m_PlayPosition);
+    m_bDecoderPrimed=false;
+  }
+
+  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || frame_delta==0)
+    return;
+
+  size_t target=m_PlayPosition + frame_delta * m_RenderFrameSize;
+  size_t end=m_pCyclicBuffer->GetEndValue();
+  if ((end < target) && !IsPlaybackReadComplete())
+  {
+    // The decoder threads did not keep up, decode the rest here
+    WaitForDecoder();
+    end=m_pCyclicBuffer->GetEndValue();
+    if ((end < target) && !IsPlaybackReadComplete())
+    {
+      if (m_bDecoderPrimed)
+        m_UnderrunCount++;
+
+      csMicroTicks decode_start=csGetMicroTicks();
+      DecodeFrames ((target - end) / m_RenderFrameSize);
+      AddDecodeTime (csGetMicroTicks() - decode_start);
+      end=m_pCyclicBuffer->GetEndValue();
+    }
+  }
+
+  // Playback can't advance beyond the end of the data
+  if (target > end)
+    target=end;
+  AtomicSet (&m_PlayPosition, target);
+
+  // Release data which sources won't read anymore
+  if (target > m_HistoryBytes)
+  {
+    size_t keep_start=target - m_HistoryBytes;
+    size_t start=m_pCyclicBuffer->GetStartValue();
+    if (keep_start > start)
+      m_pCyclicBuffer->AdvanceStartValue (keep_start - start);
+  }
+
+  /* Top up the look-ahead once half of it is used.  Custom loop ends are 
+   * handled while decoding relative to the read position, so these streams 
+   * are decoded here. */
+  if (m_endLoopFrame != 0)
+    m_bDecoderPrimed=false;
+  else if (!IsPlaybackReadComplete()
+    && (end - target < m_DecodeAheadBytes / 2)
+    && (AtomicOperations::CompareAndSet (&m_DecodeJobQueued, 1, 0) == 0))
+  {
+    m_DecodeQueue->Enqueue (m_DecodeJob);
+    m_bDecoderPrimed=true;
+  }
+}
+
+csPtr<iJobQueue> SndSysBasicStream::GetDecoderQueue (iObjectRegistry *pObjectReg)
+{
+  static const char queueTag[] = "crystalspace.jobqueue.sounddecode";
+  csRef<iJobQueue> queue (
+    csQueryRegistryTagInterface<iJobQueue> (pObjectReg, queueTag));
+  if (!queue.IsValid())
+  {
+    csConfigAccess config (pObjectReg, "/config/sound.cfg");
+    int threads=config->GetInt ("SndSys.DecoderThreads", 2);
+    if (threads <= 0)
+      threads=CS::Platform::GetProcessorCount();
+    if (threads <= 0)
+      threads=1;
+    queue.AttachNew (new ThreadedJobQueue (threads, THREAD_PRIO_NORMAL,
+      "sound decode"));
+    pObjectReg->Register (queue, queueTag);
+  }
+  return csPtr<iJobQueue> (queue);
+}
+
+void SndSysBasicStream::EnableDecodeAhead (iJobQueue *pQueue, size_t time)
+{
+  if (!pQueue || (time == 0) || m_DecodeJob)
+    return;
+
+  m_DecodeAheadBytes=(m_RenderFormat.Freq * time / 1000) * m_RenderFrameSize;
+  if (m_DecodeAheadBytes == 0)
+    return;
+
+  // Sources may still read as much as the stream kept without decoding ahead
+  m_HistoryBytes=m_pCyclicBuffer->GetLength();
+  delete m_pCyclicBuffer;
+  m_pCyclicBuffer=new SoundCyclicBuffer (m_HistoryBytes + m_DecodeAheadBytes);
+  m_PlayPosition=0;
+
+  m_DecodeQueue=pQueue;
+  m_DecodeJob.AttachNew (new SndSysStreamDecodeJob (this));
+}
+
+void SndSysBasicStream::DecodeAhead ()
+{
+  size_t target=AtomicRead (&m_PlayPosition) + m_DecodeAheadBytes;
+  size_t end=m_pCyclicBuffer->GetEndValue();
+  if (end < target)
+  {
+    // Only fill free space, the sources may still read the rest
+    size_t needed_bytes=target - end;
+    size_t free_bytes=m_pCyclicBuffer->GetFreeBytes();
+    if (needed_bytes > free_bytes)
+      needed_bytes=free_bytes;
+
+    csMicroTicks decode_start=csGetMicroTicks();
+    DecodeFrames (needed_bytes / m_RenderFrameSize);
+    AddDecodeTime (csGetMicroTicks() - decode_start);
+  }
+
+  AtomicOperations::Set (&m_DecodeJobQueued, 0);
+}
+
+void SndSysBasicStream::AddDecodeTime (csMicroTicks time)
+{
+  CS::Threading::MutexScopedLock lock (m_DecodeTimeLock);
+  m_DecodeTime+=time;
+}
+
+void SndSysBasicStream::WaitForDecoder ()
+{
+  if (!m_DecodeJob)
+    return;
+
+  m_DecodeQueue->Dequeue (m_DecodeJob, true);
+  AtomicOperations::Set (&m_DecodeJobQueued, 0);
+}
+
 void SndSysBasicStream::InitializeSourcePositionMarker (
   size_t *position_marker)
 {
@@ -468,26 +468,26 @@ const char* csEventAttributeIterator::Next()
 csPoolEvent::csPoolEvent(csEventQueue *q)
 {
   pool = q;
-  next = 0;
 }
 
 void csPoolEvent::DecRef()
 {
-  if (scfRefCount == 1)
+  if (CS::Threading::AtomicOperations::Decrement (&scfRefCount) == 0)
   {
-    if (!pool.IsValid())
-      return;
-
-    next = pool->EventPool;
-    pool->EventPool = this;
-    RemoveAll();
-    Name = csInvalidStringID;
-    Time = ~0;
-    Broadcast = false;
-  }
-  else
-  {
-    scfRefCount--;
+    // Keep the reference the pool holds
+    scfRefCount = 1;
+    csEventQueue* queue = pool;
+    if (queue)
+    {
+      // Reset before the event is visible to other threads
+      RemoveAll();
+      Name = csInvalidStringID;
+      Time = ~0;
+      Broadcast = false;
+      if (queue->RecycleEvent (this))
+        return;
+    }
+    Free();
   }
 }
 
@@ -30,6 +30,7 @@
 #include "csutil/cseventq.h"
 #include "csutil/evoutlet.h"
 #include "csutil/sysfunc.h"
+#include "csutil/util.h"
 #include "iutil/eventh.h"
 #include "csutil/eventnames.h"
 #include "csutil/eventhandlers.h"
@@ -38,15 +39,30 @@
 #include <iostream>
 #endif
 
+using namespace CS::Threading;
+
 csEventQueue::csEventQueue (iObjectRegistry* r, size_t iLength) : 
   scfImplementationType (this),
   Registry(r), 
   NameRegistry(csEventNameRegistry::GetRegistry(r)),
   HandlerRegistry(csEventHandlerRegistry::GetRegistry(r)),
-  EventQueue(0), evqHead(0), evqTail(0), Length(0),
-  EventTree(0), EventPool(0)
+  EventQueue(0), evqHead(0), evqTail(0), OverflowHead(0), OverflowCount(0),
+  EventTree(0), DispatchNodesVersion(0), EventTreeVersion(0),
+  EventPoolCount(0)
 {
-  Resize (iLength);
+  if (iLength <= 0)
+    iLength = DEF_EVENT_QUEUE_LENGTH;
+  // Power of two, and at least 2 so a full slot is never mistaken as free
+  int32 queueLength = csFindNearestPowerOf2 ((iLength < 2) ? 2 : int (iLength));
+  EventQueue = new PostSlot[queueLength];
+  EventQueueMask = queueLength - 1;
+  for (int32 i = 0; i < queueLength; i++)
+  {
+    EventQueue[i].sequence = i;
+    EventQueue[i].event = 0;
+  }
+  memset (EventPool, 0, sizeof (EventPool));
+
   // Create the default event outlet.
   EventOutlets.Push (new csEventOutlet (0, this, Registry));
   EventTree = csEventTree::CreateRootNode(HandlerRegistry, NameRegistry, this);
@@ -58,44 +74,56 @@ csEventQueue::~csEventQueue ()
 {
   // We don't allow deleting the event queue from within an event handler.
   Clear();
-  if (EventQueue)
-    delete[] EventQueue;
+  delete[] EventQueue;
   EventOutlets.Get(0)->DecRef(); // The default event outlet which we created.
-  while (EventPool) 
+  for (size_t i = 0; i < EVENT_POOL_SIZE; i++)
   {
-    csPoolEvent *e = EventPool->next;
-    EventPool->Free();
-    EventPool = e;
+    if (EventPool[i])
+      static_cast<csPoolEvent*> (EventPool[i])->Free();
   }
   RemoveAllListeners (false);
 }
 
 uint32 csEventQueue::CountPool()
 {
-  if (!EventPool) return 0;
-  csPoolEvent *e = EventPool;
-  uint32 count = 0;
-  while (e)
-  {
-    count++;
-    e = e->next;
-  }
-  return count;
+  return uint32 (AtomicOperations::Read (&EventPoolCount));
 }
 
 iEvent *csEventQueue::CreateRawEvent ()
 {
-  csPoolEvent *e;
-  if (EventPool) 
+  /* Slots are taken and filled with single atomic operations, so the pool
+     can be used from any thread without locking. */
+  if (AtomicOperations::Read (&EventPoolCount) > 0)
   {
-    e = EventPool;
-    EventPool = e->next;
+    for (size_t i = 0; i < EVENT_POOL_SIZE; i++)
+    {
+      if (!EventPool[i]) continue;
+      csPoolEvent* e = static_cast<csPoolEvent*> (
+        AtomicOperations::Set (&EventPool[i], 0));
+      if (e)
+      {
+        AtomicOperations::Decrement (&EventPoolCount);
+        return e;
+      }
+    }
   }
-  else 
+  return new csPoolEvent(this);
+}
+
+bool csEventQueue::RecycleEvent (csPoolEvent* event)
+{
+  if (AtomicOperations::Read (&EventPoolCount) >= EVENT_POOL_SIZE)
+    return false;
+  for (size_t i = 0; i < EVENT_POOL_SIZE; i++)
   {
-    e = new csPoolEvent(this);
+    if (EventPool[i]) continue;
+    if (AtomicOperations::CompareAndSet (&EventPool[i], event, 0) == 0)
+    {
+      AtomicOperations::Increment (&EventPoolCount);
+      return true;
+    }
   }
-  return e;
+  return false;
 }
 
 csPtr<iEvent> csEventQueue::CreateEvent ()
@@ -144,31 +172,67 @@ void csEventQueue::Post (iEvent *Event)
 	    << " (" << Event->Time << ")"
 	    << std::endl;
 #endif
-again:
-  size_t newHead = evqHead + 1;
-  if (newHead == Length)
-    newHead = 0;
-
-  if (newHead == evqTail) // Queue full?
-  {    
-    Resize (Length * 2); // Normally queue should not be more than half full.
-    goto again;
+  Event->IncRef ();
+
+  // Once events overflow, later ones have to queue up behind them
+  if (AtomicOperations::Read (&OverflowCount) == 0)
+  {
+    int32 pos = AtomicOperations::Read (&evqHead);
+    while (true)
+    {
+      PostSlot& slot = EventQueue[pos & EventQueueMask];
+      int32 seq = AtomicOperations::Read (&slot.sequence);
+      int32 diff = int32 (uint32 (seq) - uint32 (pos));
+      if (diff == 0)
+      {
+        // Slot is free: claim it
+        int32 next = int32 (uint32 (pos) + 1);
+        if (AtomicOperations::CompareAndSet (&evqHead, next, pos) == pos)
+        {
+          slot.event = Event;
+          AtomicOperations::Set (&slot.sequence, next);
+          return;
+        }
+        pos = AtomicOperations::Read (&evqHead);
+      }
+      else if (diff < 0)
+        // Slot still holds an event from the previous round: queue is full
+        break;
+      else
+        // Another thread claimed the slot first
+        pos = AtomicOperations::Read (&evqHead);
+    }
   }
 
-  EventQueue [evqHead] = Event;
-  Event->IncRef ();
-  evqHead = newHead;
+  MutexScopedLock lock (OverflowMutex);
+  OverflowEvents.Push (Event);
+  AtomicOperations::Increment (&OverflowCount);
 }
 
 csPtr<iEvent> csEventQueue::Get ()
 {
   iEvent* ev = 0;
-  if (!IsEmpty ())
+  PostSlot& slot = EventQueue[evqTail & EventQueueMask];
+  int32 next = int32 (uint32 (evqTail) + 1);
+  if (AtomicOperations::Read (&slot.sequence) == next)
+  {
+    ev = slot.event;
+    slot.event = 0;
+    // Free the slot for the next round
+    AtomicOperations::Set (&slot.sequence,
+      int32 (uint32 (evqTail) + uint32 (EventQueueMask) + 1));
+    evqTail = next;
+  }
+  else if (AtomicOperations::Read (&OverflowCount) > 0)
   {
-    size_t oldTail = evqTail++;
-    if (evqTail == Length)
-      evqTail = 0;
-    ev = (iEvent*)EventQueue [oldTail];
+    MutexScopedLock lock (OverflowMutex);
+    ev = OverflowEvents[OverflowHead++];
+    if (OverflowHead == OverflowEvents.GetSize ())
+    {
+      OverflowEvents.Empty ();
+      OverflowHead = 0;
+    }
+    AtomicOperations::Decrement (&OverflowCount);
   }
 #ifdef ADB_DEBUG
   if (ev != 0)
@@ -182,44 +246,36 @@ csPtr<iEvent> csEventQueue::Get ()
   return ev;
 }
 
+bool csEventQueue::IsEmpty ()
+{
+  PostSlot& slot = EventQueue[evqTail & EventQueueMask];
+  return (AtomicOperations::Read (&slot.sequence) != int32 (uint32 (evqTail) + 1))
+    && (AtomicOperations::Read (&OverflowCount) == 0);
+}
+
 void csEventQueue::Clear ()
 {
   csRef<iEvent> ev;
   for (ev = Get(); ev.IsValid(); ev = Get()) /* empty */;
 }
 
-void csEventQueue::Resize (size_t iLength)
+csEventTree* csEventQueue::GetDispatchNode (const csEventID &name)
 {
-  if (iLength <= 0)
-    iLength = DEF_EVENT_QUEUE_LENGTH;
-
-  if (iLength == Length)
+  int32 treeVersion = AtomicOperations::Read (&EventTreeVersion);
+  if (DispatchNodesVersion != treeVersion)
   {
-    return;
+    DispatchNodes.Empty ();
+    DispatchNodesVersion = treeVersion;
   }
-
-  // Remember old event queue and allocate a new one
-  volatile iEvent **oldEventQueue = EventQueue;
-  EventQueue = (volatile iEvent**) new iEvent *[iLength];
-  // Remember old values of head & tail and set both to 0
-  size_t oldHead = evqHead, oldTail = evqTail;
-  evqHead = evqTail = 0;
-  // Remember old queue length and set new one
-  size_t oldLength = Length;
-  Length = iLength;
-
-  // Copy old events into the new queue until its full
-  if (oldEventQueue)
+  csEventTree *epoint = DispatchNodes.Get (name, 0);
+  if (!epoint)
   {
-    while ((oldTail != oldHead) && (evqHead < Length - 1))
-    {
-      EventQueue [evqHead++] = oldEventQueue [oldTail++];
-      if (oldTail == oldLength)
-        oldTail = 0;
-    }
+    // May add nodes to the tree
+    CS::Threading::ScopedWriteLock lock(etreeMutex);
+    epoint = EventTree->FindNode (name, this);
+    DispatchNodes.Put (name, epoint);
   }
-
-  delete[] oldEventQueue; 
+  return epoint;
 }
 
 void csEventQueue::Notify (const csEventID &name)
@@ -229,12 +285,7 @@ void csEventQueue::Notify (const csEventID &name)
   	NameRegistry->GetString(name) << std::endl;
 #endif
 
-  csEventTree *epoint = EventHash.Get(name, 0);
-  if (!epoint)
-  {
-    /* Expensive exception, build the tree out to include "name". */
-    epoint = EventTree->FindNode(name, this);
-  }
+  csEventTree *epoint = GetDispatchNode (name);
   CS_ASSERT(epoint);
   epoint->Notify();
 }
@@ -267,12 +318,7 @@ void csEventQueue::Dispatch (iEvent& e)
 	    << " into event tree"
 	    << std::endl;
 #endif
-  csEventTree *epoint = EventHash.Get(e.Name, 0);
-  if (!epoint)
-  {
-    CS::Threading::ScopedReadLock lock(etreeMutex);
-    epoint = EventTree->FindNode(e.Name, this);
-  }
+  csEventTree *epoint = GetDispatchNode (e.Name);
   CS_ASSERT(epoint);
 
   epoint->Dispatch(e);
@@ -431,6 +477,7 @@ void csEventQueue::RemoveAllListeners (bool recreateEventTree)
   handlers.DeleteAll();
   mutex.WriteUnlock();
   CS::Threading::ScopedWriteLock lock(etreeMutex);
+  AtomicOperations::Increment (&EventTreeVersion);
   csEventTree::DeleteRootNode (EventTree); // Magic!
   if (recreateEventTree)
     EventTree = csEventTree::CreateRootNode (HandlerRegistry, NameRegistry, this);
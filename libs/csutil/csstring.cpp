@@ -68,7 +68,14 @@ size_t csStringBase::ComputeNewSize (size_t NewSize)
 {
   size_t n;
   if (GrowBy != 0)
-    n = (NewSize + GrowBy - 1) & ~(GrowBy - 1);
+  {
+    /* Grow by at least half the current size, so appending to a string
+       piece by piece doesn't reallocate every GrowBy bytes */
+    n = NewSize;
+    if (n < MaxSize + (MaxSize >> 1))
+      n = MaxSize + (MaxSize >> 1);
+    n = (n + GrowBy - 1) & ~(GrowBy - 1);
+  }
   else
   {
     n = MaxSize != 0 ? MaxSize << 1 : size_t(DEFAULT_GROW_BY);
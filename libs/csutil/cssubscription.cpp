@@ -616,7 +616,7 @@ void csEventTree::SubscriberIterator::GraphMode()
       iEventHandler *h = zit.Next();
       csHandlerID hid = handler_reg->GetID(h);
       record->SubscriberGraph->Mark(hid);
-      if (qit && (h == qit->FetchCurrent()))
+      if (hasQueue && (h == qit.FetchCurrent()))
         break;
     }
   }
@@ -0,0 +1,171 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csgeom/math.h"
+#include "csutil/framearena.h"
+
+namespace CS
+{
+  namespace Memory
+  {
+    // All allocations are aligned to this
+    static const size_t allocAlign = 16;
+
+    static inline size_t AlignSize (size_t size)
+    {
+      return (size + allocAlign - 1) & ~(allocAlign - 1);
+    }
+
+    // Offset of the first usable byte in a block
+    static const size_t blockHeaderSize = (sizeof (void*) + sizeof (size_t)
+      + allocAlign - 1) & ~(allocAlign - 1);
+
+    //-----------------------------------------------------------------------
+
+    FrameArena::Statistics::Statistics () : threads (0), allocations (0),
+      mallocs (0), used (0), highWater (0), reserved (0)
+    {
+    }
+
+    //-----------------------------------------------------------------------
+
+    void FrameArena::Pool::Reset ()
+    {
+      current = first;
+      offset = blockHeaderSize;
+    }
+
+    void FrameArena::Pool::FreeBlocks ()
+    {
+      Block* block = first;
+      while (block)
+      {
+        Block* next = block->next;
+        cs_free (block);
+        block = next;
+      }
+      first = current = 0;
+      offset = 0;
+    }
+
+    //-----------------------------------------------------------------------
+
+    FrameArena::FrameArena (size_t blockSize) : blockSize (blockSize),
+      frameNumber (0)
+    {
+    }
+
+    FrameArena::~FrameArena ()
+    {
+      for (size_t i = 0; i < threads.GetSize (); i++)
+      {
+        ThreadData* thread = threads[i];
+        thread->frame.FreeBlocks ();
+        thread->doubleBuffered[0].FreeBlocks ();
+        thread->doubleBuffered[1].FreeBlocks ();
+        delete thread;
+      }
+    }
+
+    FrameArena::ThreadData& FrameArena::GetThreadData ()
+    {
+      ThreadData* thread = static_cast<ThreadData*> (threadData.GetValue ());
+      if (!thread)
+      {
+        thread = new ThreadData;
+        threadData.SetValue (thread);
+        CS::Threading::MutexScopedLock lock (threadsLock);
+        threads.Push (thread);
+      }
+      return *thread;
+    }
+
+    void* FrameArena::Alloc (ThreadData& thread, Pool& pool, size_t size)
+    {
+      size = AlignSize (size);
+      if (!pool.current || (pool.offset + size > pool.current->size))
+      {
+        /* Continue with the next block if it's large enough, otherwise put a
+           new one in front of it */
+        Block* next = pool.current ? pool.current->next : pool.first;
+        if (!next || (next->size - blockHeaderSize < size))
+        {
+          size_t newSize = csMax (blockSize, blockHeaderSize + size);
+          Block* newBlock = static_cast<Block*> (cs_malloc (newSize));
+          newBlock->size = newSize;
+          newBlock->next = next;
+          if (pool.current)
+            pool.current->next = newBlock;
+          else
+            pool.first = newBlock;
+          next = newBlock;
+          thread.mallocs++;
+          thread.reserved += newSize;
+        }
+        pool.current = next;
+        pool.offset = blockHeaderSize;
+      }
+      void* p = reinterpret_cast<uint8*> (pool.current) + pool.offset;
+      pool.offset += size;
+      thread.allocations++;
+      thread.used += size;
+      return p;
+    }
+
+    void* FrameArena::Alloc (size_t size)
+    {
+      ThreadData& thread = GetThreadData ();
+      return Alloc (thread, thread.frame, size);
+    }
+
+    void* FrameArena::AllocDoubleBuffered (size_t size)
+    {
+      ThreadData& thread = GetThreadData ();
+      return Alloc (thread, thread.doubleBuffered[frameNumber & 1], size);
+    }
+
+    void FrameArena::NewFrame ()
+    {
+      CS::Threading::MutexScopedLock lock (threadsLock);
+
+      Statistics frameStats;
+      frameStats.threads = uint (threads.GetSize ());
+      frameStats.highWater = stats.highWater;
+      frameNumber++;
+      for (size_t i = 0; i < threads.GetSize (); i++)
+      {
+        ThreadData* thread = threads[i];
+        frameStats.allocations += thread->allocations;
+        frameStats.mallocs += thread->mallocs;
+        frameStats.used += thread->used;
+        frameStats.reserved += thread->reserved;
+        thread->allocations = 0;
+        thread->mallocs = 0;
+        thread->used = 0;
+
+        thread->frame.Reset ();
+        // The other buffer still holds the data of the frame that just ended
+        thread->doubleBuffered[frameNumber & 1].Reset ();
+      }
+      frameStats.highWater = csMax (frameStats.highWater, frameStats.used);
+      stats = frameStats;
+    }
+  } // namespace Memory
+} // namespace CS
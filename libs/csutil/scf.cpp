@@ -56,6 +56,7 @@
 #ifdef CS_REF_TRACKER
 #include "reftrack.h"
 #endif
+#include "scfplugincache.h"
 
 #if (defined(CS_EXTENSIVE_MEMDEBUG) && defined(CS_COMPILER_MSVC)) || \
   defined(CS_MEMORY_TRACKER) || defined(CS_REF_TRACKER)
@@ -90,6 +91,8 @@ private:
   csStringSet contexts;
   csStringID staticContextID;
   csStringSet scannedDirs;
+  /// Cache of plugin metadata, created on first scan
+  csPluginMetadataCache* pluginCache;
 
 #ifdef CS_REF_TRACKER
   csRefTracker* refTracker;
@@ -99,8 +102,12 @@ private:
   { return s != csInvalidStringID ? contexts.Request(s) : "{none}"; }
   char const* GetContextName(char const* s)
   { return s != 0 ? s : "{none}"; }
+  csRef<iDocumentNode> GetSCFNode (char const* pluginPath, iDocument* doc,
+    const char* context);
   void RegisterClassesInt (char const* pluginPath, iDocumentNode* scfnode, 
     const char* context = 0);
+  void RegisterClassesInt (char const* pluginPath,
+    const csArray<csPluginClassInfo>& classes, const char* context);
   void ScanPluginsInt(csPathsList const*, char const* context);
 
   friend void scfInitialize (csPathsList const*, unsigned int);
@@ -625,14 +632,26 @@ void* csSCF::QueryInterface (scfInterfaceID iInterfaceID,
   return scfImplementation<csSCF>::QueryInterface (iInterfaceID, iVersion);
 }
 
+static void ParseClasses (iDocumentNode* scfnode,
+			  csArray<csPluginClassInfo>& classes);
+
 void csSCF::ScanPluginsInt (csPathsList const* pluginPaths,
                             const char* context)
 {
   if (pluginPaths)
   {
+    CS::Threading::RecursiveMutexScopedLock lock (mutex);
+    if (!pluginCache)
+      pluginCache = new csPluginMetadataCache (
+        csGetPlatformConfigPath ("scfplugins.cache", true));
+
     // Search plugins in pluginpaths
     csRef<iStringArray> plugins;
 
+    // Startup timing breakdown
+    csMicroTicks scanTime = 0, metadataTime = 0, registerTime = 0;
+    size_t numPlugins = 0, numCached = 0;
+
     size_t i, j;
     for (i = 0; i < pluginPaths->Length(); i++)
     {
@@ -649,9 +668,11 @@ void csSCF::ScanPluginsInt (csPathsList const* pluginPaths,
       if (plugins)
         plugins->Empty();
 
+      csMicroTicks startTime = csGetMicroTicks ();
       csRef<iStringArray> messages =
         csScanPluginDir (pathrec.path, plugins, pathrec.scanRecursive);
       scannedDirs.Request(pathrec.path);
+      scanTime += csGetMicroTicks () - startTime;
 
       if ((messages != 0) && (messages->GetSize () > 0))
       {
@@ -661,11 +682,32 @@ void csSCF::ScanPluginsInt (csPathsList const* pluginPaths,
           csPrintfErr(" %s\n", messages->Get (j));
       }
 
+      char const* pathContext = context ? context : pathrec.type.GetData();
       csRef<iDocument> metadata;
       csRef<iString> msg;
       for (j = 0; j < plugins->GetSize (); j++)
       {
         char const* plugin = plugins->Get(j);
+        numPlugins++;
+
+        startTime = csGetMicroTicks ();
+        csPluginMetadataCache::FileStamp moduleStamp, metaFileStamp;
+        bool const haveStamps = csPluginMetadataCache::GetStamps (plugin,
+          moduleStamp, metaFileStamp);
+        const csPluginMetadataCache::Entry* cached = haveStamps ?
+          pluginCache->Lookup (plugin, moduleStamp, metaFileStamp) : 0;
+        if (cached)
+        {
+          // No need to open the module or to parse anything
+          numCached++;
+          csMicroTicks registerStart = csGetMicroTicks ();
+          metadataTime += registerStart - startTime;
+          if (cached->hasMetadata)
+            RegisterClassesInt (plugin, cached->classes, pathContext);
+          registerTime += csGetMicroTicks () - registerStart;
+          continue;
+        }
+
         msg = csGetPluginMetadata (plugin, metadata);
         if (msg != 0)
         {
@@ -682,11 +724,50 @@ void csSCF::ScanPluginsInt (csPathsList const* pluginPaths,
         // metadata.  This is a valid case, which we simply ignore since it is
         // legal for non-CS libraries to exist alongside CS plugins in the
         // scanned directories.
+        csPluginMetadataCache::Entry entry;
+        entry.path = plugin;
+        entry.moduleStamp = moduleStamp;
+        entry.metaFileStamp = metaFileStamp;
+        entry.hasMetadata = false;
+        // Don't cache failures, so the errors are reported again
+        bool cacheable = haveStamps && (msg == 0);
+
+        csMicroTicks registerStart = csGetMicroTicks ();
+        metadataTime += registerStart - startTime;
         if (metadata)
-          RegisterClasses(plugin, metadata, 
-          context ? context : pathrec.type.GetData());
+        {
+          csRef<iDocumentNode> scfnode = GetSCFNode (plugin, metadata,
+            pathContext);
+          if (scfnode.IsValid())
+          {
+            ParseClasses (scfnode, entry.classes);
+            entry.hasMetadata = true;
+            RegisterClassesInt (plugin, entry.classes, pathContext);
+          }
+          else
+            cacheable = false;
+        }
+        registerTime += csGetMicroTicks () - registerStart;
+
+        if (cacheable)
+          pluginCache->Store (entry);
       }
     }
+
+    csMicroTicks saveStart = csGetMicroTicks ();
+    pluginCache->Save ();
+    csMicroTicks saveTime = csGetMicroTicks () - saveStart;
+
+    if (IsVerbose(SCF_VERBOSE_PLUGIN_TIMING))
+    {
+      csPrintfErr("SCF_NOTIFY: plugin scan: %zu plugins (%zu from cache) in "
+        "%.1f ms; directory scan %.1f ms, metadata %.1f ms, "
+        "registration %.1f ms, cache update %.1f ms\n",
+        numPlugins, numCached,
+        (scanTime + metadataTime + registerTime + saveTime) / 1000.0,
+        scanTime / 1000.0, metadataTime / 1000.0, registerTime / 1000.0,
+        saveTime / 1000.0);
+    }
   }
 }
 
@@ -698,6 +779,7 @@ static unsigned int parse_verbosity(int argc, const char* const argv[])
   if (p.Enabled("scf.plugin.load"    )) v |= SCF_VERBOSE_PLUGIN_LOAD;
   if (p.Enabled("scf.plugin.register")) v |= SCF_VERBOSE_PLUGIN_REGISTER;
   if (p.Enabled("scf.class.register" )) v |= SCF_VERBOSE_CLASS_REGISTER;
+  if (p.Enabled("scf.plugin.timing"  )) v |= SCF_VERBOSE_PLUGIN_TIMING;
   return v;
 }
 
@@ -795,7 +877,8 @@ void scfRegisterStaticFactoryFunc (scfFactoryFunc func, const char *FactClass)
   staticFactoryFuncs.Push (ff);
 }
 
-csSCF::csSCF (unsigned int v) : scfImplementation<csSCF> (this), verbose(v)
+csSCF::csSCF (unsigned int v) : scfImplementation<csSCF> (this), verbose(v),
+  pluginCache (0)
 #ifdef CS_REF_TRACKER
   ,refTracker(0)
 #endif  
@@ -842,6 +925,7 @@ csSCF::csSCF (unsigned int v) : scfImplementation<csSCF> (this), verbose(v)
 
 csSCF::~csSCF ()
 {
+  delete pluginCache;
   delete ClassRegistry;
   ClassRegistry = 0;
   SortClassRegistry = false;
@@ -881,27 +965,35 @@ void csSCF::RegisterClasses (char const* pluginPath,
 {
   if (doc)
   {
-    csRef<iDocumentNode> rootnode = doc->GetRoot();
-    if (rootnode != 0)
+    csRef<iDocumentNode> scfnode = GetSCFNode (pluginPath, doc, context);
+    if (scfnode.IsValid())
+      RegisterClassesInt (pluginPath, scfnode, context);
+  }
+}
+
+csRef<iDocumentNode> csSCF::GetSCFNode (char const* pluginPath,
+    iDocument* doc, const char* context)
+{
+  csRef<iDocumentNode> scfnode;
+  csRef<iDocumentNode> rootnode = doc->GetRoot();
+  if (rootnode != 0)
+  {
+    csRef<iDocumentNode> pluginnode = rootnode->GetNode("plugin");
+    if (pluginnode)
     {
-      csRef<iDocumentNode> pluginnode = rootnode->GetNode("plugin");
-      if (pluginnode)
-      {
-	csRef<iDocumentNode> scfnode = pluginnode->GetNode("scf");
-	if (scfnode.IsValid())
-	  RegisterClassesInt (pluginPath, scfnode, context);
-	else
-	  csPrintfErr("SCF_ERROR: missing <scf> node in metadata for %s "
-	    "in context %s\n", pluginPath != 0 ? pluginPath : "{unknown}",
-	    CS::Quote::Single (GetContextName(context)));
-      }
-      else
-        csPrintfErr("SCF_ERROR: missing root <plugin> node in metadata "
-	  "for %s in context %s\n",
-	  pluginPath != 0 ? pluginPath : "{unknown}",
+      scfnode = pluginnode->GetNode("scf");
+      if (!scfnode.IsValid())
+	csPrintfErr("SCF_ERROR: missing <scf> node in metadata for %s "
+	  "in context %s\n", pluginPath != 0 ? pluginPath : "{unknown}",
 	  CS::Quote::Single (GetContextName(context)));
     }
+    else
+      csPrintfErr("SCF_ERROR: missing root <plugin> node in metadata "
+	"for %s in context %s\n",
+	pluginPath != 0 ? pluginPath : "{unknown}",
+	CS::Quote::Single (GetContextName(context)));
   }
+  return scfnode;
 }
 
 static char const* get_node_value(csRef<iDocumentNode> parent, char const* key)
@@ -910,25 +1002,9 @@ static char const* get_node_value(csRef<iDocumentNode> parent, char const* key)
   return node.IsValid() ? node->GetContentsValue() : "";
 }
 
-void csSCF::RegisterClassesInt(char const* pluginPath, iDocumentNode* scfnode, 
-			       const char* context)
+static void ParseClasses (iDocumentNode* scfnode,
+			  csArray<csPluginClassInfo>& classes)
 {
-  bool const seen = pluginPath != 0 && libraryNames->Contains(pluginPath);
-
-  if (IsVerbose(SCF_VERBOSE_PLUGIN_REGISTER))
-  {
-    char const* s = pluginPath != 0 ? pluginPath : "{unknown}";
-    char const* c = GetContextName(context);
-    if (!seen)
-      csPrintfErr("SCF_NOTIFY: registering plugin %s in context %s\n", s, CS::Quote::Single (c));
-    else
-      csPrintfErr("SCF_NOTIFY: ignoring duplicate plugin registration %s "
-        "in context %s\n", s, CS::Quote::Single (c));
-  }
-
-  if (seen)
-    return;			// *** RETURN: Do not re-register ***
-
   csRef<iDocumentNode> classesnode = scfnode->GetNode("classes");
   if (classesnode)
   {
@@ -936,15 +1012,15 @@ void csSCF::RegisterClassesInt(char const* pluginPath, iDocumentNode* scfnode,
     csRef<iDocumentNode> classnode;
     while ((classnode = classiter->Next()))
     {
-      csString classname = get_node_value(classnode, "name");
-      csString imp = get_node_value(classnode, "implementation");
-      csString desc = get_node_value(classnode, "description");
+      csPluginClassInfo& info = classes.GetExtend (classes.GetSize ());
+      info.name = get_node_value(classnode, "name");
+      info.implementation = get_node_value(classnode, "implementation");
+      info.description = get_node_value(classnode, "description");
 
       // For backward compatibility, we build a comma-delimited dependency
       // string from the individual dependency nodes.  In the future,
       // iSCF::GetClassDependencies() should be updated to return an
       // iStringArray, rather than a simple comma-delimited string.
-      csString depend;
       csRef<iDocumentNode> depnode = classnode->GetNode("requires");
       if (depnode)
       {
@@ -952,17 +1028,52 @@ void csSCF::RegisterClassesInt(char const* pluginPath, iDocumentNode* scfnode,
 	csRef<iDocumentNode> depclassnode;
 	while ((depclassnode = depiter->Next()))
 	{
-	  if (!depend.IsEmpty()) depend << ", ";
-	  depend << depclassnode->GetContentsValue();
+	  if (!info.dependencies.IsEmpty()) info.dependencies << ", ";
+	  info.dependencies << depclassnode->GetContentsValue();
 	}
       }
-
-      char const* pdepend = (depend.IsEmpty() ? 0 : depend.GetData());
-      RegisterClass(classname, pluginPath, imp, desc, pdepend, context);
     }
   }
 }
 
+void csSCF::RegisterClassesInt(char const* pluginPath, iDocumentNode* scfnode, 
+			       const char* context)
+{
+  csArray<csPluginClassInfo> classes;
+  ParseClasses (scfnode, classes);
+  RegisterClassesInt (pluginPath, classes, context);
+}
+
+void csSCF::RegisterClassesInt(char const* pluginPath,
+			       const csArray<csPluginClassInfo>& classes,
+			       const char* context)
+{
+  bool const seen = pluginPath != 0 && libraryNames->Contains(pluginPath);
+
+  if (IsVerbose(SCF_VERBOSE_PLUGIN_REGISTER))
+  {
+    char const* s = pluginPath != 0 ? pluginPath : "{unknown}";
+    char const* c = GetContextName(context);
+    if (!seen)
+      csPrintfErr("SCF_NOTIFY: registering plugin %s in context %s\n", s, CS::Quote::Single (c));
+    else
+      csPrintfErr("SCF_NOTIFY: ignoring duplicate plugin registration %s "
+        "in context %s\n", s, CS::Quote::Single (c));
+  }
+
+  if (seen)
+    return;			// *** RETURN: Do not re-register ***
+
+  for (size_t i = 0; i < classes.GetSize (); i++)
+  {
+    const csPluginClassInfo& info = classes[i];
+    char const* pdepend = (info.dependencies.IsEmpty() ? 0 :
+      info.dependencies.GetData());
+    RegisterClass(info.name, pluginPath, info.implementation,
+      info.description, pdepend, context);
+  }
+}
+
 uint64 scfImplementationHelper::stats[scfImplementationHelper::scfstatsNum];
 CS::Threading::Mutex scfImplementationHelper::statsLock;
 
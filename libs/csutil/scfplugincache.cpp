@@ -0,0 +1,288 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include <sys/stat.h>
+
+#include "csutil/platformfile.h"
+#include "csutil/syspath.h"
+#include "scfplugincache.h"
+
+// Bump when changing the file format
+static const char cacheMagic[8] = { 'C', 'S', 'P', 'L', 'G', 'C', '0', '1' };
+
+namespace
+{
+  /* Reader for the cache file contents. Any read past the end marks the
+     reader as failed. */
+  class CacheReader
+  {
+    const char* pos;
+    const char* end;
+  public:
+    bool ok;
+
+    CacheReader (const char* data, size_t size)
+      : pos (data), end (data + size), ok (true) {}
+
+    bool Read (void* dest, size_t size)
+    {
+      if (!ok || (size_t (end - pos) < size))
+      {
+        ok = false;
+        return false;
+      }
+      memcpy (dest, pos, size);
+      pos += size;
+      return true;
+    }
+
+    int64 ReadInt ()
+    {
+      int64 v = 0;
+      Read (&v, sizeof (v));
+      return v;
+    }
+
+    void ReadString (csString& str)
+    {
+      uint32 len = 0;
+      if (!Read (&len, sizeof (len))) return;
+      if (size_t (end - pos) < len)
+      {
+        ok = false;
+        return;
+      }
+      str.Replace (pos, len);
+      pos += len;
+    }
+
+    void ReadStamp (csPluginMetadataCache::FileStamp& stamp)
+    {
+      stamp.mtime = ReadInt ();
+      stamp.size = ReadInt ();
+    }
+  };
+
+  class CacheWriter
+  {
+    FILE* file;
+  public:
+    bool ok;
+
+    CacheWriter (FILE* file) : file (file), ok (true) {}
+
+    void Write (const void* data, size_t size)
+    {
+      if (ok && (size > 0))
+        ok = fwrite (data, 1, size, file) == size;
+    }
+
+    void WriteInt (int64 v) { Write (&v, sizeof (v)); }
+
+    void WriteString (const csString& str)
+    {
+      uint32 len = uint32 (str.Length ());
+      Write (&len, sizeof (len));
+      Write (str.GetData (), len);
+    }
+
+    void WriteStamp (const csPluginMetadataCache::FileStamp& stamp)
+    {
+      WriteInt (stamp.mtime);
+      WriteInt (stamp.size);
+    }
+  };
+}
+
+csPluginMetadataCache::csPluginMetadataCache (const char* filename)
+  : filename (filename), loaded (false), dirty (false), loadedCount (0)
+{
+}
+
+csPluginMetadataCache::~csPluginMetadataCache ()
+{
+}
+
+static void GetStamp (const char* path,
+                      csPluginMetadataCache::FileStamp& stamp)
+{
+  struct stat st;
+  if (CS::Platform::Stat (path, &st) == 0)
+  {
+    stamp.mtime = int64 (st.st_mtime);
+    stamp.size = int64 (st.st_size);
+  }
+  else
+  {
+    stamp.mtime = 0;
+    stamp.size = -1;
+  }
+}
+
+bool csPluginMetadataCache::GetStamps (const char* path,
+                                       FileStamp& moduleStamp,
+                                       FileStamp& metaFileStamp)
+{
+  GetStamp (path, moduleStamp);
+  if (moduleStamp.size < 0) return false;
+
+  // Same name as looked for by csGetPluginMetadata()
+  csString metaPath (path);
+  size_t dot = metaPath.FindLast ('.');
+  if (dot != (size_t)-1) metaPath.Truncate (dot);
+  metaPath << ".csplugin";
+  GetStamp (metaPath, metaFileStamp);
+  return true;
+}
+
+void csPluginMetadataCache::Load ()
+{
+  loaded = true;
+
+  FILE* file = CS::Platform::File::Open (filename, "rb");
+  if (!file) return;
+
+  csString data;
+  char buf[4096];
+  size_t n;
+  while ((n = fread (buf, 1, sizeof (buf), file)) > 0)
+    data.Append (buf, n);
+  fclose (file);
+
+  CacheReader reader (data.GetData (), data.Length ());
+  char magic[sizeof (cacheMagic)];
+  if (!reader.Read (magic, sizeof (magic))
+    || (memcmp (magic, cacheMagic, sizeof (magic)) != 0))
+    return;
+
+  csArray<Entry> newEntries;
+  int64 numEntries = reader.ReadInt ();
+  for (int64 i = 0; reader.ok && (i < numEntries); i++)
+  {
+    Entry& entry = newEntries.GetExtend (newEntries.GetSize ());
+    reader.ReadString (entry.path);
+    reader.ReadStamp (entry.moduleStamp);
+    reader.ReadStamp (entry.metaFileStamp);
+    entry.hasMetadata = reader.ReadInt () != 0;
+    int64 numClasses = reader.ReadInt ();
+    for (int64 c = 0; reader.ok && (c < numClasses); c++)
+    {
+      csPluginClassInfo& info =
+        entry.classes.GetExtend (entry.classes.GetSize ());
+      reader.ReadString (info.name);
+      reader.ReadString (info.implementation);
+      reader.ReadString (info.description);
+      reader.ReadString (info.dependencies);
+    }
+  }
+  // Rather use nothing than a partial cache
+  if (!reader.ok) return;
+
+  for (size_t i = 0; i < newEntries.GetSize (); i++)
+    Store (newEntries[i]);
+  dirty = false;
+  loadedCount = newEntries.GetSize ();
+}
+
+const csPluginMetadataCache::Entry* csPluginMetadataCache::Lookup (
+  const char* path, const FileStamp& moduleStamp,
+  const FileStamp& metaFileStamp)
+{
+  if (!loaded) Load ();
+
+  const size_t* index = entryIndices.GetElementPointer (path);
+  if (!index) return 0;
+  const Entry& entry = entries[*index];
+  if (!(entry.moduleStamp == moduleStamp)
+    || !(entry.metaFileStamp == metaFileStamp))
+    return 0;
+  return &entry;
+}
+
+void csPluginMetadataCache::Store (const Entry& entry)
+{
+  if (!loaded) Load ();
+
+  const size_t* index = entryIndices.GetElementPointer (entry.path);
+  if (index)
+    entries[*index] = entry;
+  else
+    entryIndices.Put (entry.path, entries.Push (entry));
+  dirty = true;
+}
+
+bool csPluginMetadataCache::Save ()
+{
+  if (!dirty) return true;
+
+  // Make sure the directory exists
+  csString dir (filename);
+  size_t sep = dir.FindLast (CS_PATH_SEPARATOR);
+  if (sep != (size_t)-1)
+  {
+    dir.Truncate (sep);
+    if (!CS::Platform::IsDirectory (dir))
+      CS::Platform::CreateDirectory (dir);
+  }
+
+  // Write to a temporary file first so readers never see a partial cache
+  csString tmpName (filename);
+  tmpName << ".tmp";
+  FILE* file = CS::Platform::File::Open (tmpName, "wb");
+  if (!file) return false;
+
+  CacheWriter writer (file);
+  writer.Write (cacheMagic, sizeof (cacheMagic));
+  writer.WriteInt (int64 (entries.GetSize ()));
+  for (size_t i = 0; i < entries.GetSize (); i++)
+  {
+    const Entry& entry = entries[i];
+    writer.WriteString (entry.path);
+    writer.WriteStamp (entry.moduleStamp);
+    writer.WriteStamp (entry.metaFileStamp);
+    writer.WriteInt (entry.hasMetadata ? 1 : 0);
+    writer.WriteInt (int64 (entry.classes.GetSize ()));
+    for (size_t c = 0; c < entry.classes.GetSize (); c++)
+    {
+      const csPluginClassInfo& info = entry.classes[c];
+      writer.WriteString (info.name);
+      writer.WriteString (info.implementation);
+      writer.WriteString (info.description);
+      writer.WriteString (info.dependencies);
+    }
+  }
+  bool ok = writer.ok;
+  ok &= fclose (file) == 0;
+
+  if (ok)
+  {
+#ifdef CS_PLATFORM_WIN32
+    // rename() doesn't replace existing files there
+    remove (filename);
+#endif
+    ok = rename (tmpName, filename) == 0;
+  }
+  if (!ok)
+  {
+    remove (tmpName);
+    return false;
+  }
+  dirty = false;
+  return true;
+}
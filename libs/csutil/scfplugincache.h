@@ -0,0 +1,104 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_LIBS_CSUTIL_SCFPLUGINCACHE_H__
+#define __CS_LIBS_CSUTIL_SCFPLUGINCACHE_H__
+
+#include "csutil/array.h"
+#include "csutil/csstring.h"
+#include "csutil/hash.h"
+
+/// SCF information about a class provided by a plugin.
+struct csPluginClassInfo
+{
+  csString name;
+  csString implementation;
+  csString description;
+  /// Comma-delimited list of dependencies.
+  csString dependencies;
+};
+
+/**
+ * Binary cache of the SCF metadata of plugin modules, so they don't have
+ * to be opened and their metadata parsed on every startup.
+ *
+ * Entries are keyed by the path of a plugin and are only used if the
+ * modification time and size of the module (and of a separate .csplugin
+ * file, if any) are still the same as when the entry was stored.
+ */
+class csPluginMetadataCache
+{
+public:
+  /// Modification time and size of a file.
+  struct FileStamp
+  {
+    int64 mtime;
+    /// -1 if the file doesn't exist.
+    int64 size;
+
+    bool operator== (const FileStamp& other) const
+    { return (mtime == other.mtime) && (size == other.size); }
+  };
+
+  struct Entry
+  {
+    csString path;
+    FileStamp moduleStamp;
+    /// Stamp of the .csplugin file next to the module.
+    FileStamp metaFileStamp;
+    /// False for modules which turned out not to be CS plugins.
+    bool hasMetadata;
+    csArray<csPluginClassInfo> classes;
+  };
+
+  /// Create a cache stored in \a filename. Nothing is read yet.
+  csPluginMetadataCache (const char* filename);
+  ~csPluginMetadataCache ();
+
+  /// Get the stamps of a plugin module and its .csplugin file.
+  static bool GetStamps (const char* path, FileStamp& moduleStamp,
+    FileStamp& metaFileStamp);
+
+  /**
+   * Get the cached entry for a plugin, or 0 if there is none or it is
+   * outdated. Reads the cache file on first use.
+   */
+  const Entry* Lookup (const char* path, const FileStamp& moduleStamp,
+    const FileStamp& metaFileStamp);
+
+  /// Add or replace an entry.
+  void Store (const Entry& entry);
+
+  /// Write the cache file if anything changed.
+  bool Save ();
+
+  /// Number of entries read from the cache file.
+  size_t GetLoadedCount () const { return loadedCount; }
+
+private:
+  csString filename;
+  bool loaded;
+  bool dirty;
+  size_t loadedCount;
+  csArray<Entry> entries;
+  csHash<size_t, csString> entryIndices;
+
+  void Load ();
+};
+
+#endif // __CS_LIBS_CSUTIL_SCFPLUGINCACHE_H__
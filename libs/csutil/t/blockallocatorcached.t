@@ -0,0 +1,257 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/blockallocator.h"
+#include "csutil/set.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threading/thread.h"
+
+/**
+ * Test CS::Memory::BlockAllocatorCached operations and compare its
+ * multi-threaded performance with CS::Memory::BlockAllocatorSafe.
+ */
+class BlockAllocatorCachedTest : public CppUnit::TestFixture
+{
+private:
+  class SideEffect
+  {
+  private:
+    int id;
+    csSet<int>* registry;
+  public:
+    SideEffect() : id(0), registry(0) {}
+    ~SideEffect() { if (registry != 0) registry->Delete(id); }
+    void Register(int i, csSet<int>* r) { id = i, registry = r; r->Add(i); }
+  };
+
+  template <typename T>
+  class Allocator : public CS::Memory::BlockAllocatorCached<T>
+  {
+  private:
+    typedef CS::Memory::BlockAllocatorCached<T> S;
+  public:
+    Allocator(size_t granularity) : S(granularity) {}
+    size_t get_block_count() const { return S::blocks.b.GetSize(); }
+  };
+
+  struct Payload
+  {
+    uint owner;
+    uint data[7];
+  };
+
+  /* Allocates and frees objects in batches. Half of each batch is freed
+     right away, the rest with the next batch, so objects also move between
+     the magazines of a thread. Every object is tagged with the thread to
+     detect blocks handed out twice. */
+  template<typename AllocatorType>
+  class AllocFreeRunnable : public CS::Threading::Runnable
+  {
+  public:
+    AllocatorType& alloc;
+    uint id;
+    uint rounds;
+    bool ok;
+
+    AllocFreeRunnable (AllocatorType& alloc, uint id, uint rounds)
+      : alloc (alloc), id (id), rounds (rounds), ok (true) {}
+    void Run ()
+    {
+      static const size_t batchSize = 100;
+      Payload* kept[batchSize/2];
+      Payload* batch[batchSize];
+      size_t numKept = 0;
+      for (uint r = 0; r < rounds; r++)
+      {
+        for (size_t i = 0; i < batchSize; i++)
+        {
+          batch[i] = alloc.Alloc ();
+          batch[i]->owner = id;
+        }
+        for (size_t i = 0; i < numKept; i++)
+        {
+          if (kept[i]->owner != id) ok = false;
+          alloc.Free (kept[i]);
+        }
+        numKept = 0;
+        for (size_t i = 0; i < batchSize; i++)
+        {
+          if (batch[i]->owner != id) ok = false;
+          if (i & 1)
+            kept[numKept++] = batch[i];
+          else
+            alloc.Free (batch[i]);
+        }
+      }
+      for (size_t i = 0; i < numKept; i++)
+        alloc.Free (kept[i]);
+    }
+  };
+
+  static const uint numThreads = 4;
+
+  /// Run the alloc/free loop on some threads, return time in microseconds
+  template<typename AllocatorType>
+  static csMicroTicks RunThreads (AllocatorType& alloc, uint rounds);
+public:
+  void testAllocFree();
+  void testDisposer();
+  void testCompact();
+  void testTryFree();
+  void testThreads();
+  void testBenchmark();
+
+  CPPUNIT_TEST_SUITE(BlockAllocatorCachedTest);
+    CPPUNIT_TEST(testAllocFree);
+    CPPUNIT_TEST(testDisposer);
+    CPPUNIT_TEST(testCompact);
+    CPPUNIT_TEST(testTryFree);
+    CPPUNIT_TEST(testThreads);
+    CPPUNIT_TEST(testBenchmark);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+template<typename AllocatorType>
+csMicroTicks BlockAllocatorCachedTest::RunThreads (AllocatorType& alloc,
+  uint rounds)
+{
+  csRef<AllocFreeRunnable<AllocatorType> > runnables[numThreads];
+  CS::Threading::Thread* threads[numThreads];
+  for (uint t = 0; t < numThreads; t++)
+  {
+    runnables[t].AttachNew (new AllocFreeRunnable<AllocatorType> (alloc, t,
+      rounds));
+    threads[t] = new CS::Threading::Thread (runnables[t], false);
+  }
+  const csMicroTicks start = csGetMicroTicks ();
+  for (uint t = 0; t < numThreads; t++) threads[t]->Start ();
+  for (uint t = 0; t < numThreads; t++) threads[t]->Wait ();
+  const csMicroTicks time = csGetMicroTicks () - start;
+  for (uint t = 0; t < numThreads; t++)
+  {
+    CPPUNIT_ASSERT (runnables[t]->ok);
+    delete threads[t];
+  }
+  return time;
+}
+
+/* Test freed objects are reused and the number of live objects is right */
+void BlockAllocatorCachedTest::testAllocFree()
+{
+  Allocator<int> a (16);
+  int* p[100];
+  for (int i = 0; i < 100; i++) { p[i] = a.Alloc (); *p[i] = i; }
+  for (int i = 0; i < 100; i++) CPPUNIT_ASSERT_EQUAL (i, *p[i]);
+  CPPUNIT_ASSERT_EQUAL (size_t (100), a.GetAllocatedElems ());
+  const size_t blocks = a.get_block_count ();
+
+  for (int i = 0; i < 100; i++) a.Free (p[i]);
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.GetAllocatedElems ());
+  for (int i = 0; i < 100; i++) p[i] = a.Alloc ();
+  CPPUNIT_ASSERT_EQUAL (blocks, a.get_block_count ());
+  for (int i = 0; i < 100; i++)
+    for (int j = i + 1; j < 100; j++) CPPUNIT_ASSERT (p[i] != p[j]);
+
+  a.Free (0);
+  a.DeleteAll ();
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.get_block_count ());
+}
+
+/* Test objects are destroyed by Free(), DeleteAll() and the destructor */
+void BlockAllocatorCachedTest::testDisposer()
+{
+  csSet<int> registry;
+  {
+    Allocator<SideEffect> a (8);
+    SideEffect* p[50];
+    for (int i = 0; i < 50; i++)
+    {
+      p[i] = a.Alloc ();
+      p[i]->Register (i, &registry);
+    }
+    CPPUNIT_ASSERT_EQUAL (size_t (50), registry.GetSize ());
+    for (int i = 0; i < 50; i += 2) a.Free (p[i]);
+    CPPUNIT_ASSERT_EQUAL (size_t (25), registry.GetSize ());
+    CPPUNIT_ASSERT (!registry.Contains (0));
+    CPPUNIT_ASSERT (registry.Contains (1));
+
+    a.DeleteAll ();
+    CPPUNIT_ASSERT_EQUAL (size_t (0), registry.GetSize ());
+
+    for (int i = 0; i < 10; i++) a.Alloc ()->Register (i, &registry);
+  }
+  CPPUNIT_ASSERT_EQUAL (size_t (0), registry.GetSize ());
+}
+
+/* Test Compact() releases blocks cached by the calling thread */
+void BlockAllocatorCachedTest::testCompact()
+{
+  Allocator<int> a (16);
+  int* p[200];
+  for (int i = 0; i < 200; i++) p[i] = a.Alloc ();
+  CPPUNIT_ASSERT (a.get_block_count () >= 200 / 16);
+  for (int i = 0; i < 200; i++) a.Free (p[i]);
+  a.Compact ();
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.get_block_count ());
+
+  // Still usable afterwards
+  int* q = a.Alloc ();
+  *q = 1;
+  CPPUNIT_ASSERT_EQUAL (size_t (1), a.GetAllocatedElems ());
+  a.Free (q);
+}
+
+/* Test TryFree() rejects pointers not from the allocator */
+void BlockAllocatorCachedTest::testTryFree()
+{
+  Allocator<int> a (16);
+  int* p = a.Alloc ();
+  int foreign;
+  CPPUNIT_ASSERT (!a.TryFree (&foreign));
+  CPPUNIT_ASSERT (a.TryFree (p));
+  CPPUNIT_ASSERT (a.TryFree (0));
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.GetAllocatedElems ());
+}
+
+/* Test concurrent allocations never hand out a block twice, and that blocks
+   cached by exited threads are returned */
+void BlockAllocatorCachedTest::testThreads()
+{
+  Allocator<Payload> a (64);
+  RunThreads (a, 200);
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.GetAllocatedElems ());
+  RunThreads (a, 200);
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.GetAllocatedElems ());
+  a.Compact ();
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.get_block_count ());
+}
+
+/* Compare the time for the multi-threaded alloc/free loop with the locking
+   and the caching allocator */
+void BlockAllocatorCachedTest::testBenchmark()
+{
+  const uint rounds = 20000;
+  CS::Memory::BlockAllocatorSafe<Payload> safe (256);
+  const csMicroTicks safeTime = RunThreads (safe, rounds);
+  CS::Memory::BlockAllocatorCached<Payload> cached (256);
+  const csMicroTicks cachedTime = RunThreads (cached, rounds);
+  csPrintf ("\n%u threads, %u alloc/free pairs each: "
+    "BlockAllocatorSafe %" PRId64 " us, "
+    "BlockAllocatorCached %" PRId64 " us\n",
+    numThreads, rounds * 100, safeTime, cachedTime);
+}
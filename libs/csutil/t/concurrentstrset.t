@@ -0,0 +1,272 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/concurrentstrset.h"
+#include "csutil/csstring.h"
+#include "csutil/strset.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threading/thread.h"
+
+/**
+ * Test CS::Utility::ConcurrentStringSet operations and compare its
+ * performance with a locked CS::Utility::StringSet.
+ */
+class ConcurrentStringSetTest : public CppUnit::TestFixture
+{
+private:
+  typedef CS::Utility::ConcurrentStringSet<CS::StringSetTag::General> SetType;
+  typedef CS::Utility::StringSet<CS::StringSetTag::General, true>
+    LockedSetType;
+
+  static const uint numThreads = 8;
+  static const uint numNames = 2048;
+
+  static csString Name (uint n)
+  {
+    csString s;
+    s.Format ("name%u", n);
+    return s;
+  }
+
+  /* Requests names in a thread-specific order (numNames is a power of two,
+     so each odd step visits all names) and checks the IDs stay the same.
+     Every thread also adds names of its own and maps their IDs back. */
+  template<typename Set>
+  class InternRunnable : public CS::Threading::Runnable
+  {
+  public:
+    Set& set;
+    uint id;
+    uint rounds;
+    csStringID ids[numNames];
+    bool ok;
+
+    InternRunnable (Set& set, uint id, uint rounds)
+      : set (set), id (id), rounds (rounds), ok (true) {}
+    void Run ()
+    {
+      csString names[numNames];
+      for (uint n = 0; n < numNames; n++) names[n] = Name (n);
+      csString own;
+      for (uint r = 0; r < rounds; r++)
+      {
+        for (uint i = 0; i < numNames; i++)
+        {
+          uint n = (i * (2 * id + 1) + r) % numNames;
+          csStringID sid = set.Request (names[n]);
+          if (r == 0)
+            ids[n] = sid;
+          else if (ids[n] != sid)
+            ok = false;
+        }
+        own.Format ("thread%u_%u", id, r);
+        csStringID ownID = set.Request (own);
+        const char* s = set.Request (ownID);
+        if (!s || (own != s)) ok = false;
+      }
+    }
+  };
+
+  /// Intern names from some threads, return time in microseconds
+  template<typename Set>
+  static csMicroTicks RunThreads (Set& set, uint rounds);
+public:
+  void testRequest();
+  void testContains();
+  void testDelete();
+  void testSizing();
+  void testIterator();
+  void testGrow();
+  void testThreads();
+  void testBenchmark();
+
+  CPPUNIT_TEST_SUITE(ConcurrentStringSetTest);
+    CPPUNIT_TEST(testRequest);
+    CPPUNIT_TEST(testContains);
+    CPPUNIT_TEST(testDelete);
+    CPPUNIT_TEST(testSizing);
+    CPPUNIT_TEST(testIterator);
+    CPPUNIT_TEST(testGrow);
+    CPPUNIT_TEST(testThreads);
+    CPPUNIT_TEST(testBenchmark);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+template<typename Set>
+csMicroTicks ConcurrentStringSetTest::RunThreads (Set& set, uint rounds)
+{
+  csRef<InternRunnable<Set> > runnables[numThreads];
+  CS::Threading::Thread* threads[numThreads];
+  for (uint t = 0; t < numThreads; t++)
+  {
+    runnables[t].AttachNew (new InternRunnable<Set> (set, t, rounds));
+    threads[t] = new CS::Threading::Thread (runnables[t], false);
+  }
+  const csMicroTicks start = csGetMicroTicks ();
+  for (uint t = 0; t < numThreads; t++) threads[t]->Start ();
+  for (uint t = 0; t < numThreads; t++) threads[t]->Wait ();
+  const csMicroTicks time = csGetMicroTicks () - start;
+  for (uint t = 0; t < numThreads; t++)
+  {
+    CPPUNIT_ASSERT (runnables[t]->ok);
+    delete threads[t];
+  }
+  // All threads must have got the same IDs
+  for (uint t = 1; t < numThreads; t++)
+  {
+    for (uint n = 0; n < numNames; n++)
+      CPPUNIT_ASSERT_EQUAL (runnables[0]->ids[n], runnables[t]->ids[n]);
+  }
+  return time;
+}
+
+void ConcurrentStringSetTest::testRequest()
+{
+  SetType s;
+  CPPUNIT_ASSERT_EQUAL(s.Request(34), (char const*)0);
+  CPPUNIT_ASSERT_EQUAL(s.Request(csInvalidStringID), (char const*)0);
+  csStringID const bar = s.Request("bar");
+  CPPUNIT_ASSERT(bar != csInvalidStringID);
+  csStringID const foo1 = s.Request("foo");
+  CPPUNIT_ASSERT(foo1 != bar);
+  csStringID const foo2 = s.Request("foo");
+  CPPUNIT_ASSERT_EQUAL(foo1, foo2);
+  CPPUNIT_ASSERT_EQUAL(std::string("foo"), std::string(s.Request(foo1)));
+}
+
+void ConcurrentStringSetTest::testContains()
+{
+  SetType s;
+  CPPUNIT_ASSERT(!s.Contains("foo"));
+  CPPUNIT_ASSERT(!s.Contains(34));
+  CPPUNIT_ASSERT(!s.Contains(csInvalidStringID));
+  csStringID const foo = s.Request("foo");
+  CPPUNIT_ASSERT(s.Contains("foo"));
+  CPPUNIT_ASSERT(s.Contains(foo));
+  CPPUNIT_ASSERT(!s.Contains("bar"));
+  CPPUNIT_ASSERT(!s.Contains(34));
+}
+
+void ConcurrentStringSetTest::testDelete()
+{
+  SetType s;
+  csStringID const foo = s.Request("foo");
+  csStringID const bar = s.Request("bar");
+  CPPUNIT_ASSERT(s.Delete("foo"));
+  CPPUNIT_ASSERT(!s.Delete(foo));
+  CPPUNIT_ASSERT(!s.Contains("foo"));
+  CPPUNIT_ASSERT_EQUAL(s.Request(foo), (char const*)0);
+  CPPUNIT_ASSERT(s.Delete(bar));
+  CPPUNIT_ASSERT(!s.Delete("bar"));
+  CPPUNIT_ASSERT(s.IsEmpty());
+
+  // Deleted strings get a new ID
+  csStringID const foo2 = s.Request("foo");
+  CPPUNIT_ASSERT(foo2 != foo);
+  CPPUNIT_ASSERT(foo2 != bar);
+  CPPUNIT_ASSERT_EQUAL(std::string("foo"), std::string(s.Request(foo2)));
+}
+
+void ConcurrentStringSetTest::testSizing()
+{
+  SetType s;
+  CPPUNIT_ASSERT(s.IsEmpty());
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)0);
+  s.Request("foo");
+  s.Request("bar");
+  CPPUNIT_ASSERT(!s.IsEmpty());
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)2);
+  s.Delete("cow");
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)2);
+  s.Delete("bar");
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)1);
+  s.Delete("foo");
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)0);
+  csStringID const foo = s.Request("foo");
+  s.Request("bar");
+  CPPUNIT_ASSERT(!s.IsEmpty());
+  s.Empty();
+  CPPUNIT_ASSERT(s.IsEmpty());
+  CPPUNIT_ASSERT(s.Request("foo") != foo);
+}
+
+void ConcurrentStringSetTest::testIterator()
+{
+  SetType s;
+  csStringID const foo = s.Request("foo");
+  csStringID const bar = s.Request("bar");
+  csStringID const cow = s.Request("cow");
+  s.Request("moo");
+  s.Delete("moo");
+  SetType::GlobalIterator iter = s.GetIterator();
+  int n = 0;
+  while (iter.HasNext())
+  {
+    n++;
+    char const* t;
+    csStringID i = iter.Next(t);
+    std::string x(t);
+    if (x == "foo")
+      CPPUNIT_ASSERT_EQUAL(i, foo);
+    else if (x == "bar")
+      CPPUNIT_ASSERT_EQUAL(i, bar);
+    else
+    {
+      CPPUNIT_ASSERT_EQUAL(std::string("cow"), x);
+      CPPUNIT_ASSERT_EQUAL(i, cow);
+    }
+  }
+  CPPUNIT_ASSERT_EQUAL(n, 3);
+}
+
+/* Test the table and the reverse mapping grow past their initial sizes */
+void ConcurrentStringSetTest::testGrow()
+{
+  SetType s (4);
+  csStringID ids[5000];
+  for (uint n = 0; n < 5000; n++) ids[n] = s.Request (Name (n));
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)5000);
+  for (uint n = 0; n < 5000; n++)
+  {
+    CPPUNIT_ASSERT_EQUAL(ids[n], s.Request (Name (n)));
+    CPPUNIT_ASSERT(Name (n) == s.Request (ids[n]));
+  }
+}
+
+/* Test concurrent requests return consistent IDs */
+void ConcurrentStringSetTest::testThreads()
+{
+  SetType s;
+  RunThreads (s, 10);
+  CPPUNIT_ASSERT_EQUAL(s.GetSize(), (size_t)(numNames + numThreads * 10));
+}
+
+/* Compare the time for interning from 8 threads with the locked set. Most
+   requests are for known names, as with shader variable names. */
+void ConcurrentStringSetTest::testBenchmark()
+{
+  const uint rounds = 100;
+  LockedSetType locked;
+  const csMicroTicks lockedTime = RunThreads (locked, rounds);
+  SetType concurrent;
+  const csMicroTicks concurrentTime = RunThreads (concurrent, rounds);
+  csPrintf ("\n%u threads, %u requests each: "
+    "locked StringSet %" PRId64 " us, "
+    "ConcurrentStringSet %" PRId64 " us\n",
+    numThreads, rounds * (numNames + 1), lockedTime, concurrentTime);
+}
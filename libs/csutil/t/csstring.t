@@ -0,0 +1,250 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/csstring.h"
+#include "csutil/sysfunc.h"
+
+/**
+ * Test csString buffer management: the internal buffer, moving and growth.
+ * Also counts the allocations of a loader-like workload.
+ */
+class csStringTest : public CppUnit::TestFixture
+{
+private:
+  /* String counting the allocations of dynamic buffers. All strings of the
+     workload have this type, including temporaries and return values. */
+  template<typename Base>
+  class Counting : public Base
+  {
+  public:
+    static size_t allocs;
+
+    Counting () {}
+    Counting (const char* s) { this->Append (s); }
+    Counting (const Counting& other) : Base () { this->Append (other); }
+    const Counting& operator= (const Counting& other)
+    { this->Replace (static_cast<const csStringBase&> (other)); return *this; }
+#ifdef CS_HAS_RVALUE_REFERENCES
+    Counting (Counting&& other) : Base ()
+    { if (!this->StealBuffer (other)) this->Append (other); }
+    const Counting& operator= (Counting&& other)
+    {
+      if (!this->StealBuffer (other))
+        this->Replace (static_cast<const csStringBase&> (other));
+      return *this;
+    }
+#endif
+  protected:
+    virtual void SetCapacityInternal (size_t NewSize, bool soft)
+    {
+      const char* old = this->Data;
+      Base::SetCapacityInternal (NewSize, soft);
+      if (this->Data != old) allocs++;
+    }
+  };
+
+  template<typename S>
+  static S JoinPath (const S& dir, const char* name)
+  {
+    S path (dir);
+    if (!path.IsEmpty () && (path.GetAt (path.Length () - 1) != '/'))
+      path << '/';
+    path << name;
+    return path;
+  }
+
+  /// Build names and paths like the loader does; return a checksum
+  template<typename S>
+  static size_t LoaderWorkload (uint iterations);
+public:
+  void testInternalBuffer();
+  void testMove();
+  void testMoveInternalBuffer();
+  void testCopy();
+  void testGrowth();
+  void testAllocations();
+
+  CPPUNIT_TEST_SUITE(csStringTest);
+    CPPUNIT_TEST(testInternalBuffer);
+    CPPUNIT_TEST(testMove);
+    CPPUNIT_TEST(testMoveInternalBuffer);
+    CPPUNIT_TEST(testCopy);
+    CPPUNIT_TEST(testGrowth);
+    CPPUNIT_TEST(testAllocations);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+template<typename Base>
+size_t csStringTest::Counting<Base>::allocs = 0;
+
+template<typename S>
+size_t csStringTest::LoaderWorkload (uint iterations)
+{
+  static const char* const dirs[] = { "/lev/castle", "/lib/std",
+    "/data/shader-snippets/lighting/directional" };
+  size_t check = 0;
+  S names[16];
+  // List of all files, like a generated document
+  S fileList;
+  for (uint i = 0; i < iterations; i++)
+  {
+    // Shader variable and mesh names
+    S svName;
+    svName.Format ("light position world[%u]", i % 8);
+    S meshName ("mesh_");
+    meshName.Append (i).Append ("_lod").Append (i % 3);
+
+    // Paths from a directory and a file name
+    S dir (dirs[i % 3]);
+    S file;
+    file.Format ("texture_%u.png", i);
+    S path = JoinPath (dir, file);
+    names[i % 16] = JoinPath (JoinPath (dir, "materials"), meshName);
+    fileList << path << '\n';
+
+    check += svName.Length () + path.Length () + names[i % 16].Length ();
+  }
+  return check + fileList.Length ();
+}
+
+/* Test short strings don't allocate and long ones spill to the heap */
+void csStringTest::testInternalBuffer()
+{
+  typedef Counting<csString> S;
+  S::allocs = 0;
+  S s ("short");
+  s.Append (" string");
+  CPPUNIT_ASSERT_EQUAL (size_t (0), S::allocs);
+  CPPUNIT_ASSERT_EQUAL (std::string ("short string"),
+    std::string (s.GetData ()));
+
+  s.Append (" which is long enough to spill to the heap");
+  CPPUNIT_ASSERT_EQUAL (size_t (1), S::allocs);
+  CPPUNIT_ASSERT_EQUAL (std::string (
+    "short string which is long enough to spill to the heap"),
+    std::string (s.GetData ()));
+
+  csString empty;
+  CPPUNIT_ASSERT (empty.GetData () == 0);
+  CPPUNIT_ASSERT (csString ("").GetData () != 0);
+}
+
+/* Test moving takes over a dynamic buffer */
+void csStringTest::testMove()
+{
+#ifdef CS_HAS_RVALUE_REFERENCES
+  csString a ("a string which is too long for the internal buffer");
+  const char* data = a.GetData ();
+  csString b (static_cast<csString&&> (a));
+  CPPUNIT_ASSERT_EQUAL (data, b.GetData ());
+  CPPUNIT_ASSERT (a.GetData () == 0);
+  CPPUNIT_ASSERT_EQUAL (size_t (0), a.Length ());
+
+  csString c ("short");
+  c = static_cast<csString&&> (b);
+  CPPUNIT_ASSERT_EQUAL (data, c.GetData ());
+  CPPUNIT_ASSERT (b.GetData () == 0);
+
+  // Moved-from strings are usable
+  a = "reused";
+  CPPUNIT_ASSERT_EQUAL (std::string ("reused"), std::string (a.GetData ()));
+
+  csStringBase heap ("another string which is too long for the buffer");
+  data = heap.GetData ();
+  csStringBase heap2 (static_cast<csStringBase&&> (heap));
+  CPPUNIT_ASSERT_EQUAL (data, heap2.GetData ());
+  CPPUNIT_ASSERT (heap.GetData () == 0);
+#endif
+}
+
+/* Test moving strings in the internal buffer copies them */
+void csStringTest::testMoveInternalBuffer()
+{
+#ifdef CS_HAS_RVALUE_REFERENCES
+  csString a ("short");
+  csString b (static_cast<csString&&> (a));
+  CPPUNIT_ASSERT_EQUAL (std::string ("short"), std::string (b.GetData ()));
+  CPPUNIT_ASSERT (b.GetData () != a.GetData ());
+
+  csString c ("a string which is too long for the internal buffer");
+  c = static_cast<csString&&> (b);
+  CPPUNIT_ASSERT_EQUAL (std::string ("short"), std::string (c.GetData ()));
+
+  csString nullString;
+  csString d (static_cast<csString&&> (nullString));
+  CPPUNIT_ASSERT (d.GetData () == 0);
+#endif
+}
+
+/* Test copying from lvalues, with and without an internal buffer */
+void csStringTest::testCopy()
+{
+  const csStringFast<0> heap ("a string without internal buffer");
+  csStringFast<0> heapCopy (heap);
+  CPPUNIT_ASSERT_EQUAL (std::string (heap.GetData ()),
+    std::string (heapCopy.GetData ()));
+  CPPUNIT_ASSERT (heap.GetData () != heapCopy.GetData ());
+  csStringFast<0> heapAssigned;
+  heapAssigned = heap;
+  CPPUNIT_ASSERT_EQUAL (std::string (heap.GetData ()),
+    std::string (heapAssigned.GetData ()));
+
+  const csString s ("short");
+  csString sCopy (s);
+  csString sAssigned;
+  sAssigned = s;
+  CPPUNIT_ASSERT_EQUAL (std::string ("short"), std::string (sCopy.GetData ()));
+  CPPUNIT_ASSERT_EQUAL (std::string ("short"),
+    std::string (sAssigned.GetData ()));
+}
+
+/* Test appending piece by piece needs a logarithmic number of allocations */
+void csStringTest::testGrowth()
+{
+  typedef Counting<csStringBase> S;
+  S::allocs = 0;
+  S s;
+  for (int i = 0; i < 100000; i++) s.Append ('x');
+  CPPUNIT_ASSERT_EQUAL (size_t (100000), s.Length ());
+  // 64 bytes growing by 1.5x each time
+  CPPUNIT_ASSERT (S::allocs <= 25);
+
+  S::allocs = 0;
+  S t;
+  t.SetGrowsBy (0);
+  for (int i = 0; i < 100000; i++) t.Append ('x');
+  CPPUNIT_ASSERT (S::allocs <= 12);
+}
+
+/* Count the allocations of the loader workload with and without the
+   internal buffer */
+void csStringTest::testAllocations()
+{
+  const uint iterations = 10000;
+  typedef Counting<csString> FastString;
+  typedef Counting<csStringBase> HeapString;
+  FastString::allocs = 0;
+  HeapString::allocs = 0;
+  size_t checkFast = LoaderWorkload<FastString> (iterations);
+  size_t checkHeap = LoaderWorkload<HeapString> (iterations);
+  CPPUNIT_ASSERT_EQUAL (checkHeap, checkFast);
+  CPPUNIT_ASSERT (FastString::allocs < HeapString::allocs);
+  csPrintf ("\nLoader workload, %u iterations: %zu allocations with "
+    "csString, %zu with csStringBase\n", iterations, FastString::allocs,
+    HeapString::allocs);
+}
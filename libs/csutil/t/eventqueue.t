@@ -109,11 +109,13 @@ public:
   void testPhaseHandlers ();
   void testFrameSubEvents ();
   void testMixedHandlers ();
+  void testPostOrder ();
 
   CPPUNIT_TEST_SUITE (csEventQueueTest);
     CPPUNIT_TEST (testSmokeTest);
     CPPUNIT_TEST (testPhaseHandlers);
     CPPUNIT_TEST (testMixedHandlers);
+    CPPUNIT_TEST (testPostOrder);
   CPPUNIT_TEST_SUITE_END ();
 };
 
@@ -232,3 +234,44 @@ void csEventQueueTest::testMixedHandlers ()
 {
 
 }
+
+/**
+ * Make sure events come out in posting order, also when more events are
+ * posted than fit into the queue, and that events are reused.
+ */
+void csEventQueueTest::testPostOrder ()
+{
+  csEventQueue *queue = new csEventQueue (objreg, 4);
+  CPPUNIT_ASSERT (queue->IsEmpty ());
+
+  for (int32 i = 0; i < 20; i++)
+  {
+    csRef<iEvent> ev = queue->CreateEvent ("unit.test.post");
+    ev->Add ("n", i);
+    queue->Post (ev);
+  }
+  CPPUNIT_ASSERT (!queue->IsEmpty ());
+
+  for (int32 i = 0; i < 20; i++)
+  {
+    csRef<iEvent> ev = queue->Get ();
+    CPPUNIT_ASSERT (ev.IsValid ());
+    int32 n = -1;
+    ev->Retrieve ("n", n);
+    CPPUNIT_ASSERT_EQUAL (i, n);
+  }
+  CPPUNIT_ASSERT (queue->IsEmpty ());
+  csRef<iEvent> ev = queue->Get ();
+  CPPUNIT_ASSERT (!ev.IsValid ());
+  CPPUNIT_ASSERT (queue->CountPool () > 0);
+
+  // Posting works again after the overflow was drained
+  ev = queue->CreateEvent ("unit.test.post");
+  queue->Post (ev);
+  ev = queue->Get ();
+  CPPUNIT_ASSERT (ev.IsValid ());
+  CPPUNIT_ASSERT (queue->IsEmpty ());
+  ev.Invalidate ();
+
+  queue->DecRef ();
+}
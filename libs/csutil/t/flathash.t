@@ -0,0 +1,400 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/csstring.h"
+#include "csutil/flathash.h"
+#include "csutil/hash.h"
+#include "csutil/sysfunc.h"
+
+/**
+ * Test CS::Container::FlatHash operations and compare its performance with
+ * csHash for pointer, integer and string keys.
+ */
+class FlatHashTest : public CppUnit::TestFixture
+{
+private:
+  typedef CS::Container::FlatHash<int, int> IntHash;
+
+  /// Key whose hashes collide a lot, so keys overflow into other groups
+  struct CollidingKey
+  {
+    uint v;
+    CollidingKey (uint v = 0) : v (v) {}
+    uint GetHash () const { return v % 3; }
+    bool operator< (const CollidingKey& other) const { return v < other.v; }
+  };
+
+  template<typename T, typename K>
+  class Hash : public CS::Container::FlatHash<T, K>
+  {
+  public:
+    Hash (size_t size = 23) : CS::Container::FlatHash<T, K> (size) {}
+    size_t get_slot_count () const { return this->NumSlots (); }
+  };
+
+  /// Insert, look up and erase all keys, return times in microseconds
+  template<typename HashType, typename K>
+  static void Benchmark (const K* keys, size_t numKeys, uint rounds,
+    csMicroTicks times[3]);
+  template<typename K>
+  static void CompareBenchmark (const char* name, const K* keys,
+    size_t numKeys, uint rounds);
+public:
+  void testPutGet();
+  void testMultipleValues();
+  void testDelete();
+  void testCollisions();
+  void testNoTombstones();
+  void testIterator();
+  void testDeleteElement();
+  void testCopy();
+  void testStringKeys();
+  void testRandom();
+  void testBenchmark();
+
+  CPPUNIT_TEST_SUITE(FlatHashTest);
+    CPPUNIT_TEST(testPutGet);
+    CPPUNIT_TEST(testMultipleValues);
+    CPPUNIT_TEST(testDelete);
+    CPPUNIT_TEST(testCollisions);
+    CPPUNIT_TEST(testNoTombstones);
+    CPPUNIT_TEST(testIterator);
+    CPPUNIT_TEST(testDeleteElement);
+    CPPUNIT_TEST(testCopy);
+    CPPUNIT_TEST(testStringKeys);
+    CPPUNIT_TEST(testRandom);
+    CPPUNIT_TEST(testBenchmark);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+template<typename HashType, typename K>
+void FlatHashTest::Benchmark (const K* keys, size_t numKeys, uint rounds,
+  csMicroTicks times[3])
+{
+  times[0] = times[1] = times[2] = 0;
+  size_t found = 0;
+  for (uint r = 0; r < rounds; r++)
+  {
+    HashType hash;
+    csMicroTicks start = csGetMicroTicks ();
+    for (size_t i = 0; i < numKeys; i++) hash.Put (keys[i], i);
+    csMicroTicks t1 = csGetMicroTicks ();
+    // Every key is looked up twice: once present, once with an odd offset
+    for (size_t i = 0; i < numKeys; i++)
+    {
+      if (hash.Contains (keys[i])) found++;
+      if (hash.Get (keys[(i * 7) % numKeys], 0) == (i * 7) % numKeys) found++;
+    }
+    csMicroTicks t2 = csGetMicroTicks ();
+    for (size_t i = 0; i < numKeys; i++) hash.DeleteAll (keys[i]);
+    csMicroTicks t3 = csGetMicroTicks ();
+    CPPUNIT_ASSERT (hash.IsEmpty ());
+    times[0] += t1 - start;
+    times[1] += t2 - t1;
+    times[2] += t3 - t2;
+  }
+  CPPUNIT_ASSERT_EQUAL (size_t (rounds * numKeys * 2), found);
+}
+
+template<typename K>
+void FlatHashTest::CompareBenchmark (const char* name, const K* keys,
+  size_t numKeys, uint rounds)
+{
+  csMicroTicks hashTimes[3], flatTimes[3];
+  Benchmark<csHash<size_t, K> > (keys, numKeys, rounds, hashTimes);
+  Benchmark<CS::Container::FlatHash<size_t, K> > (keys, numKeys, rounds,
+    flatTimes);
+  csPrintf ("%s keys, %u x %zu: insert/lookup/erase "
+    "csHash %" PRId64 "/%" PRId64 "/%" PRId64 " us, "
+    "FlatHash %" PRId64 "/%" PRId64 "/%" PRId64 " us\n",
+    name, rounds, numKeys, hashTimes[0], hashTimes[1], hashTimes[2],
+    flatTimes[0], flatTimes[1], flatTimes[2]);
+}
+
+void FlatHashTest::testPutGet()
+{
+  IntHash h;
+  CPPUNIT_ASSERT (h.IsEmpty ());
+  CPPUNIT_ASSERT (!h.Contains (1));
+  CPPUNIT_ASSERT (h.GetElementPointer (1) == 0);
+  CPPUNIT_ASSERT_EQUAL (-1, h.Get (1, -1));
+
+  for (int i = 0; i < 1000; i++) h.Put (i, i * 2);
+  CPPUNIT_ASSERT_EQUAL (size_t (1000), h.GetSize ());
+  for (int i = 0; i < 1000; i++)
+  {
+    CPPUNIT_ASSERT (h.Contains (i));
+    CPPUNIT_ASSERT_EQUAL (i * 2, h.Get (i, -1));
+    CPPUNIT_ASSERT_EQUAL (i * 2, *h[i]);
+  }
+  CPPUNIT_ASSERT (!h.In (1000));
+
+  CPPUNIT_ASSERT_EQUAL (7, h.PutUnique (5, 7));
+  CPPUNIT_ASSERT_EQUAL (7, h.Get (5, -1));
+  CPPUNIT_ASSERT_EQUAL (size_t (1000), h.GetSize ());
+
+  CPPUNIT_ASSERT_EQUAL (7, h.GetOrCreate (5, 3));
+  CPPUNIT_ASSERT_EQUAL (3, h.GetOrCreate (2000, 3));
+  CPPUNIT_ASSERT_EQUAL (size_t (1001), h.GetSize ());
+
+  h.Empty ();
+  CPPUNIT_ASSERT (h.IsEmpty ());
+  CPPUNIT_ASSERT (!h.Contains (5));
+  h.Put (5, 1);
+  CPPUNIT_ASSERT_EQUAL (1, h.Get (5, -1));
+}
+
+/* Test multiple values per key like csHash */
+void FlatHashTest::testMultipleValues()
+{
+  IntHash h;
+  for (int i = 0; i < 40; i++) h.Put (i % 4, i);
+  csArray<int> all = h.GetAll (1);
+  CPPUNIT_ASSERT_EQUAL (size_t (10), all.GetSize ());
+  for (size_t i = 0; i < all.GetSize (); i++)
+    CPPUNIT_ASSERT_EQUAL (1, all[i] % 4);
+  CPPUNIT_ASSERT_EQUAL (size_t (40), h.GetAll ().GetSize ());
+
+  int n = 0;
+  IntHash::Iterator it = h.GetIterator (2);
+  while (it.HasNext ())
+  {
+    CPPUNIT_ASSERT_EQUAL (2, it.Next () % 4);
+    n++;
+  }
+  CPPUNIT_ASSERT_EQUAL (10, n);
+  it.Reset ();
+  CPPUNIT_ASSERT (it.HasNext ());
+  CPPUNIT_ASSERT (!h.GetIterator (4).HasNext ());
+
+  CPPUNIT_ASSERT (h.Delete (3, 7));
+  CPPUNIT_ASSERT (!h.Delete (3, 7));
+  CPPUNIT_ASSERT_EQUAL (size_t (9), h.GetAll (3).GetSize ());
+  CPPUNIT_ASSERT (h.DeleteAll (3));
+  CPPUNIT_ASSERT (!h.Contains (3));
+  CPPUNIT_ASSERT_EQUAL (size_t (30), h.GetSize ());
+}
+
+void FlatHashTest::testDelete()
+{
+  IntHash h;
+  CPPUNIT_ASSERT (!h.DeleteAll (1));
+  CPPUNIT_ASSERT (!h.Delete (1, 1));
+  for (int i = 0; i < 1000; i++) h.Put (i, i);
+  for (int i = 0; i < 1000; i += 2) CPPUNIT_ASSERT (h.DeleteAll (i));
+  CPPUNIT_ASSERT_EQUAL (size_t (500), h.GetSize ());
+  for (int i = 0; i < 1000; i++)
+    CPPUNIT_ASSERT_EQUAL ((i & 1) != 0, h.Contains (i));
+  for (int i = 0; i < 1000; i += 2) h.Put (i, i);
+  for (int i = 0; i < 1000; i++) CPPUNIT_ASSERT_EQUAL (i, h.Get (i, -1));
+}
+
+/* Test keys with the same hash spill into other groups and are still found
+   after deleting keys before them */
+void FlatHashTest::testCollisions()
+{
+  CS::Container::FlatHash<uint, CollidingKey> h;
+  for (uint i = 0; i < 200; i++) h.Put (CollidingKey (i), i);
+  for (uint i = 0; i < 200; i++)
+    CPPUNIT_ASSERT_EQUAL (i, h.Get (CollidingKey (i), ~0u));
+  CPPUNIT_ASSERT (!h.Contains (CollidingKey (200)));
+
+  for (uint i = 0; i < 200; i += 3) h.DeleteAll (CollidingKey (i));
+  for (uint i = 0; i < 200; i++)
+    CPPUNIT_ASSERT_EQUAL ((i % 3) != 0, h.Contains (CollidingKey (i)));
+  for (uint i = 0; i < 200; i++) h.DeleteAll (CollidingKey (i));
+  CPPUNIT_ASSERT (h.IsEmpty ());
+  CPPUNIT_ASSERT (!h.Contains (CollidingKey (1)));
+}
+
+/* Test inserting and deleting repeatedly doesn't grow the table */
+void FlatHashTest::testNoTombstones()
+{
+  Hash<int, int> h;
+  for (int i = 0; i < 100; i++) h.Put (i, i);
+  const size_t slots = h.get_slot_count ();
+  for (int r = 1; r < 1000; r++)
+  {
+    for (int i = 0; i < 100; i++) h.DeleteAll ((r - 1) * 100 + i);
+    for (int i = 0; i < 100; i++) h.Put (r * 100 + i, i);
+  }
+  CPPUNIT_ASSERT_EQUAL (slots, h.get_slot_count ());
+  CPPUNIT_ASSERT_EQUAL (size_t (100), h.GetSize ());
+  for (int i = 0; i < 100; i++)
+    CPPUNIT_ASSERT_EQUAL (i, h.Get (99900 + i, -1));
+}
+
+void FlatHashTest::testIterator()
+{
+  IntHash h;
+  IntHash::GlobalIterator empty = h.GetIterator ();
+  CPPUNIT_ASSERT (!empty.HasNext ());
+
+  for (int i = 0; i < 100; i++) h.Put (i, i + 1000);
+  int sum = 0, n = 0;
+  IntHash::GlobalIterator it = h.GetIterator ();
+  while (it.HasNext ())
+  {
+    int key;
+    int value = it.Next (key);
+    CPPUNIT_ASSERT_EQUAL (key + 1000, value);
+    sum += key;
+    n++;
+  }
+  CPPUNIT_ASSERT_EQUAL (100, n);
+  CPPUNIT_ASSERT_EQUAL (99 * 50, sum);
+
+  const IntHash& c = h;
+  IntHash::ConstGlobalIterator cit = c.GetIterator ();
+  n = 0;
+  while (cit.HasNext ())
+  {
+    csTuple2<int, int> t = cit.NextTuple ();
+    CPPUNIT_ASSERT_EQUAL (t.second + 1000, t.first);
+    n++;
+  }
+  CPPUNIT_ASSERT_EQUAL (100, n);
+  IntHash::ConstIterator kit = c.GetIterator (5);
+  CPPUNIT_ASSERT (kit.HasNext ());
+  CPPUNIT_ASSERT_EQUAL (1005, kit.Next ());
+  CPPUNIT_ASSERT (!kit.HasNext ());
+}
+
+void FlatHashTest::testDeleteElement()
+{
+  IntHash h;
+  for (int i = 0; i < 100; i++) h.Put (i, i);
+  IntHash::GlobalIterator it = h.GetIterator ();
+  int n = 0;
+  while (it.HasNext ())
+  {
+    n++;
+    if (it.NextNoAdvance () & 1)
+      h.DeleteElement (it);
+    else
+      it.Advance ();
+  }
+  CPPUNIT_ASSERT_EQUAL (100, n);
+  CPPUNIT_ASSERT_EQUAL (size_t (50), h.GetSize ());
+  for (int i = 0; i < 100; i++)
+    CPPUNIT_ASSERT_EQUAL ((i & 1) == 0, h.Contains (i));
+}
+
+void FlatHashTest::testCopy()
+{
+  CS::Container::FlatHash<csString, int> h;
+  for (int i = 0; i < 50; i++) h.Put (i, csString ().Format ("%d", i));
+  CS::Container::FlatHash<csString, int> copy (h);
+  h.DeleteAll (3);
+  CPPUNIT_ASSERT (copy.Contains (3));
+  CPPUNIT_ASSERT_EQUAL (size_t (50), copy.GetSize ());
+  for (int i = 0; i < 50; i++)
+    CPPUNIT_ASSERT (copy.Get (i, csString ()) == csString ().Format ("%d", i));
+
+  CS::Container::FlatHash<csString, int> assigned;
+  assigned.Put (100, "x");
+  assigned = h;
+  CPPUNIT_ASSERT (!assigned.Contains (100));
+  CPPUNIT_ASSERT (!assigned.Contains (3));
+  CPPUNIT_ASSERT_EQUAL (size_t (49), assigned.GetSize ());
+  assigned = assigned;
+  CPPUNIT_ASSERT_EQUAL (size_t (49), assigned.GetSize ());
+}
+
+void FlatHashTest::testStringKeys()
+{
+  CS::Container::FlatHash<int, csString> h;
+  h.Put ("foo", 1);
+  h.Put ("bar", 2);
+  CPPUNIT_ASSERT_EQUAL (1, h.Get ("foo", 0));
+  CPPUNIT_ASSERT_EQUAL (2, h.Get ("bar", 0));
+  CPPUNIT_ASSERT (!h.Contains ("baz"));
+  // Growing copies the keys
+  for (int i = 0; i < 1000; i++) h.Put (csString ().Format ("key%d", i), i);
+  CPPUNIT_ASSERT_EQUAL (1, h.Get ("foo", 0));
+  CPPUNIT_ASSERT_EQUAL (500, h.Get ("key500", 0));
+}
+
+/* Test a random sequence of operations gives the same results as csHash */
+void FlatHashTest::testRandom()
+{
+  csHash<int, int> ref;
+  IntHash h;
+  uint32 seed = 1;
+  for (int i = 0; i < 100000; i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    int key = int ((seed >> 8) % 2000);
+    switch ((seed >> 28) % 4)
+    {
+      case 0:
+      case 1:
+        ref.PutUnique (key, i);
+        h.PutUnique (key, i);
+        break;
+      case 2:
+        CPPUNIT_ASSERT_EQUAL (ref.DeleteAll (key), h.DeleteAll (key));
+        break;
+      case 3:
+        CPPUNIT_ASSERT_EQUAL (ref.Get (key, -1), h.Get (key, -1));
+        break;
+    }
+    CPPUNIT_ASSERT_EQUAL (ref.GetSize (), h.GetSize ());
+  }
+  csHash<int, int>::GlobalIterator it = ref.GetIterator ();
+  while (it.HasNext ())
+  {
+    int key;
+    int value = it.Next (key);
+    CPPUNIT_ASSERT_EQUAL (value, h.Get (key, -1));
+  }
+}
+
+/* Compare insert, lookup and erase times with csHash */
+void FlatHashTest::testBenchmark()
+{
+  const size_t numKeys = 20000;
+  const uint rounds = 20;
+  csPrintf ("\n");
+
+  // Pointers of separately allocated objects, as with csPtrKey
+  int** objects = new int*[numKeys];
+  csPtrKey<int>* ptrKeys = new csPtrKey<int>[numKeys];
+  for (size_t i = 0; i < numKeys; i++)
+  {
+    objects[i] = new int;
+    ptrKeys[i] = objects[i];
+  }
+  CompareBenchmark ("Pointer", ptrKeys, numKeys, rounds);
+
+  // Sequential integers, like IDs
+  uint* intKeys = new uint[numKeys];
+  for (size_t i = 0; i < numKeys; i++) intKeys[i] = uint (i * 3);
+  CompareBenchmark ("Integer", intKeys, numKeys, rounds);
+
+  csString* stringKeys = new csString[numKeys];
+  for (size_t i = 0; i < numKeys; i++)
+    stringKeys[i].Format ("/lib/std/material_%zu", i);
+  CompareBenchmark ("String", stringKeys, numKeys, rounds);
+
+  delete[] stringKeys;
+  delete[] intKeys;
+  delete[] ptrKeys;
+  for (size_t i = 0; i < numKeys; i++) delete objects[i];
+  delete[] objects;
+}
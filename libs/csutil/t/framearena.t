@@ -0,0 +1,183 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "csutil/framearena.h"
+#include "csutil/threading/thread.h"
+
+/**
+ * Test CS::Memory::FrameArena operations.
+ */
+class FrameArenaTest : public CppUnit::TestFixture
+{
+private:
+  // Fills a number of allocations from another thread
+  class AllocRunnable : public CS::Threading::Runnable
+  {
+  public:
+    CS::Memory::FrameArena& arena;
+    uint8* blocks[64];
+
+    AllocRunnable (CS::Memory::FrameArena& arena) : arena (arena) {}
+    void Run ()
+    {
+      for (int i = 0; i < 64; i++)
+      {
+        blocks[i] = static_cast<uint8*> (arena.Alloc (100));
+        memset (blocks[i], i, 100);
+      }
+    }
+  };
+public:
+  void testAlloc();
+  void testReuse();
+  void testDoubleBuffered();
+  void testThreads();
+  void testArray();
+
+  CPPUNIT_TEST_SUITE(FrameArenaTest);
+    CPPUNIT_TEST(testAlloc);
+    CPPUNIT_TEST(testReuse);
+    CPPUNIT_TEST(testDoubleBuffered);
+    CPPUNIT_TEST(testThreads);
+    CPPUNIT_TEST(testArray);
+  CPPUNIT_TEST_SUITE_END();
+};
+
+/* Test allocations are aligned, don't overlap and are counted */
+void FrameArenaTest::testAlloc()
+{
+  CS::Memory::FrameArena arena (1024);
+  uint8* a = static_cast<uint8*> (arena.Alloc (3));
+  uint8* b = static_cast<uint8*> (arena.Alloc (100));
+  uint8* big = static_cast<uint8*> (arena.Alloc (5000));
+  uint8* c = static_cast<uint8*> (arena.Alloc (16));
+  CPPUNIT_ASSERT_EQUAL (uintptr_t (0), uintptr_t (a) & 15);
+  CPPUNIT_ASSERT_EQUAL (uintptr_t (0), uintptr_t (b) & 15);
+  CPPUNIT_ASSERT_EQUAL (uintptr_t (0), uintptr_t (big) & 15);
+  CPPUNIT_ASSERT (b >= a + 3);
+  memset (a, 1, 3);
+  memset (b, 2, 100);
+  memset (big, 3, 5000);
+  memset (c, 4, 16);
+  CPPUNIT_ASSERT_EQUAL (uint8 (1), a[2]);
+  CPPUNIT_ASSERT_EQUAL (uint8 (2), b[99]);
+  CPPUNIT_ASSERT_EQUAL (uint8 (3), big[4999]);
+
+  arena.NewFrame ();
+  const CS::Memory::FrameArena::Statistics& stats = arena.GetStatistics ();
+  CPPUNIT_ASSERT_EQUAL (1u, stats.threads);
+  CPPUNIT_ASSERT_EQUAL (4u, stats.allocations);
+  /* One block for the small allocations, one for the large one and another
+     for the allocation after it */
+  CPPUNIT_ASSERT_EQUAL (3u, stats.mallocs);
+  CPPUNIT_ASSERT_EQUAL (size_t (16 + 112 + 5008 + 16), stats.used);
+  CPPUNIT_ASSERT_EQUAL (stats.used, stats.highWater);
+  CPPUNIT_ASSERT (stats.reserved >= stats.used);
+}
+
+/* Test the blocks are reused after a new frame */
+void FrameArenaTest::testReuse()
+{
+  CS::Memory::FrameArena arena (1024);
+  void* first = 0;
+  for (int frame = 0; frame < 3; frame++)
+  {
+    void* p = arena.Alloc (64);
+    if (frame == 0)
+      first = p;
+    else
+      CPPUNIT_ASSERT_EQUAL (first, p);
+    for (int i = 0; i < 20; i++) arena.Alloc (100);
+    arena.NewFrame ();
+    CPPUNIT_ASSERT_EQUAL (frame == 0 ? 3u : 0u,
+      arena.GetStatistics ().mallocs);
+  }
+
+  const size_t highWater = arena.GetStatistics ().highWater;
+  arena.Alloc (16);
+  arena.NewFrame ();
+  CPPUNIT_ASSERT_EQUAL (size_t (16), arena.GetStatistics ().used);
+  CPPUNIT_ASSERT_EQUAL (highWater, arena.GetStatistics ().highWater);
+  CPPUNIT_ASSERT_EQUAL (3u, arena.GetFrameNumber () - 1);
+}
+
+/* Test double buffered memory survives one new frame */
+void FrameArenaTest::testDoubleBuffered()
+{
+  CS::Memory::FrameArena arena (1024);
+  int* first = static_cast<int*> (arena.AllocDoubleBuffered (sizeof (int)));
+  *first = 1;
+  arena.NewFrame ();
+
+  // Must not reuse the memory of the previous frame
+  int* second = static_cast<int*> (arena.AllocDoubleBuffered (sizeof (int)));
+  *second = 2;
+  CPPUNIT_ASSERT (second != first);
+  CPPUNIT_ASSERT_EQUAL (1, *first);
+  arena.NewFrame ();
+
+  // Now the memory of the first frame is free again
+  int* third = static_cast<int*> (arena.AllocDoubleBuffered (sizeof (int)));
+  CPPUNIT_ASSERT_EQUAL (first, third);
+  CPPUNIT_ASSERT_EQUAL (2, *second);
+}
+
+/* Test threads allocate from separate blocks */
+void FrameArenaTest::testThreads()
+{
+  CS::Memory::FrameArena arena (1024);
+  csRef<AllocRunnable> runA;
+  runA.AttachNew (new AllocRunnable (arena));
+  csRef<AllocRunnable> runB;
+  runB.AttachNew (new AllocRunnable (arena));
+  CS::Threading::Thread threadA (runA, true);
+  CS::Threading::Thread threadB (runB, true);
+  threadA.Wait ();
+  threadB.Wait ();
+
+  for (int i = 0; i < 64; i++)
+  {
+    CPPUNIT_ASSERT (runA->blocks[i] != runB->blocks[i]);
+    CPPUNIT_ASSERT_EQUAL (uint8 (i), runA->blocks[i][99]);
+    CPPUNIT_ASSERT_EQUAL (uint8 (i), runB->blocks[i][99]);
+  }
+  arena.NewFrame ();
+  CPPUNIT_ASSERT_EQUAL (2u, arena.GetStatistics ().threads);
+  CPPUNIT_ASSERT_EQUAL (128u, arena.GetStatistics ().allocations);
+}
+
+/* Test csArray can grow with memory from the arena */
+void FrameArenaTest::testArray()
+{
+  CS::Memory::FrameArena arena (1024);
+  typedef csArray<int, csArrayElementHandler<int>,
+    CS::Memory::AllocatorFrameArena> ArrayType;
+  {
+    ArrayType array (0, CS::Memory::AllocatorFrameArena (&arena),
+      CS::Container::ArrayCapacityDefault ());
+    for (int i = 0; i < 1000; i++) array.Push (i);
+    for (int i = 0; i < 1000; i++) CPPUNIT_ASSERT_EQUAL (i, array[i]);
+  }
+  arena.NewFrame ();
+  CPPUNIT_ASSERT (arena.GetStatistics ().allocations > 1);
+
+  // Without an arena the heap is used
+  ArrayType heapArray;
+  for (int i = 0; i < 1000; i++) heapArray.Push (i);
+  CPPUNIT_ASSERT_EQUAL (999, heapArray[999]);
+}
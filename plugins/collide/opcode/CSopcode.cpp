@@ -35,6 +35,9 @@
 #include "iutil/string.h"
 #include "ivaria/reporter.h"
 #include "csutil/scfarray.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
+#include "raybatch.h"
 
 
 
@@ -518,7 +521,8 @@ bool csOPCODECollideSystem::CollideRaySegment (
     s = start;
     e = end;
   }
-  csTerrainColliderCollideSegmentResult rc = terrain->CollideSegment (s, e);
+  csTerrainColliderCollideSegmentResult rc = terrain->CollideSegment (s, e,
+    use_ray);
   if (!rc.hit) return false;
   
   intersecting_triangles.SetSize (0);
@@ -677,6 +681,110 @@ bool csOPCODECollideSystem::CollideRaySegment (
   return false;
 }
 
+float csOPCODECollideSystem::HitFraction (const csVector3& start,
+  const csVector3& end)
+{
+  const csVector3 dir = end - start;
+  float closest = MAX_FLOAT;
+  for (size_t i = 0; i < intersecting_triangles.GetSize (); i++)
+  {
+    const csIntersectingTriangle& tri = intersecting_triangles[i];
+    const csVector3 n = (tri.b - tri.a) % (tri.c - tri.a);
+    const float denom = n * dir;
+    if (fabsf (denom) < SMALL_EPSILON) continue;
+    const float t = (n * (tri.a - start)) / denom;
+    if ((t >= 0.0f) && (t < closest)) closest = t;
+  }
+  // Segment lies in the plane of the triangles: the start hits already
+  return (closest == MAX_FLOAT) ? 0.0f : closest;
+}
+
+/// Batches of at least this many segments are split over several threads.
+static const size_t parallelSegmentThreshold = 1024;
+
+size_t csOPCODECollideSystem::CollideSegments (
+  	iCollider* collider, const csReversibleTransform* trans,
+	const csVector3* starts, const csVector3* ends, float* hits,
+	size_t count, bool rays)
+{
+  if (!collider || (count == 0)) return 0;
+
+  if (collider->GetColliderType () != CS_MESH_COLLIDER)
+  {
+    /* Terrains only tell whether there is a hit, so the fraction is
+       computed from the planes of the triangles that were hit. Ray hits
+       past the end give fractions above 1, as on meshes. */
+    size_t numHits = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      if (CollideRaySegment (collider, trans, starts[i], ends[i], rays))
+      {
+        csVector3 s (starts[i]), e (ends[i]);
+        if (trans)
+        {
+          s = trans->Other2This (s);
+          e = trans->Other2This (e);
+        }
+        hits[i] = HitFraction (s, e);
+        numHits++;
+      }
+      else
+        hits[i] = -1.0f;
+    }
+    return numHits;
+  }
+
+  const csOPCODECollider* col = (csOPCODECollider*) collider;
+  csDirtyAccessArray<RayBatch::Segment> segments;
+  segments.SetSize (count);
+  for (size_t i = 0; i < count; i++)
+  {
+    RayBatch::Segment& seg = segments[i];
+    if (trans)
+    {
+      seg.start = trans->Other2This (starts[i]);
+      seg.dir = trans->Other2This (ends[i]) - seg.start;
+    }
+    else
+    {
+      seg.start = starts[i];
+      seg.dir = ends[i] - starts[i];
+    }
+    seg.maxT = rays ? MAX_FLOAT : 1.0f;
+  }
+
+  if (count < parallelSegmentThreshold)
+    return RayBatch::Collide (col, segments.GetArray (), hits, count);
+
+  if (!rayJobQueue)
+  {
+    rayJobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+      CS::Platform::GetProcessorCount (), CS::Threading::THREAD_PRIO_NORMAL,
+      "opcode segments"));
+  }
+
+  // A few chunks per thread to even out differing traversal costs
+  const size_t numChunks = CS::Platform::GetProcessorCount () * 4;
+  const size_t chunkSize = (count + numChunks - 1) / numChunks;
+  csRefArray<RayBatchJob> jobs;
+  for (size_t first = 0; first < count; first += chunkSize)
+  {
+    csRef<RayBatchJob> job;
+    job.AttachNew (new RayBatchJob (col, segments.GetArray () + first,
+      hits + first, csMin (chunkSize, count - first)));
+    rayJobQueue->Enqueue (job);
+    jobs.Push (job);
+  }
+
+  size_t numHits = 0;
+  for (size_t i = 0; i < jobs.GetSize (); i++)
+  {
+    rayJobQueue->PullAndRun (jobs[i]);
+    numHits += jobs[i]->numHits;
+  }
+  return numHits;
+}
+
 bool csOPCODECollideSystem::CollideLSS (
   	csOPCODECollider* col, const csReversibleTransform* trans1,
   	const csVector3& start, const csVector3& end, float radius,
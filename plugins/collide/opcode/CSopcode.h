@@ -34,6 +34,7 @@
 #include "csgeom/vector3.h"
 #include "csutil/dirtyaccessarray.h"
 #include "csutil/scf_implementation.h"
+#include "iutil/job.h"
 #include "ivaria/collider.h"
 #include "csgeom/transfrm.h"
 #include "imesh/terrain2.h"
@@ -80,6 +81,8 @@ public:
   iObjectRegistry *object_reg;
   csStringID trianglemesh_id;
   csStringID basemesh_id;
+  /// Job queue for large CollideSegments() batches, created on demand.
+  csRef<iJobQueue> rayJobQueue;
  
   static iObjectRegistry* rep_object_reg;
   static void OpcodeReportV (int severity, const char* message, 
@@ -122,6 +125,11 @@ public:
   bool CollideRaySegment (
   	csTerraFormerCollider* terraformer, const csReversibleTransform* trans,
 	const csVector3& start, const csVector3& end, bool use_ray);
+  /**
+   * Get the fraction from \a start to \a end where the segment hits the
+   * closest of the intersecting triangles. Both are in collider space.
+   */
+  float HitFraction (const csVector3& start, const csVector3& end);
   virtual bool CollideRay (
   	iCollider* collider, const csReversibleTransform* trans,
 	const csVector3& start, const csVector3& end)
@@ -134,6 +142,10 @@ public:
   {
     return CollideRaySegment (collider, trans, start, end, false);
   }
+  virtual size_t CollideSegments (
+  	iCollider* collider, const csReversibleTransform* trans,
+	const csVector3* starts, const csVector3* ends, float* hits,
+	size_t count, bool rays);
   
   virtual bool CollideLSS (
   	iCollider* collider, const csReversibleTransform* trans1,
@@ -0,0 +1,281 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "csutil/array.h"
+#include "CSopcodecollider.h"
+#include "raybatch.h"
+
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
+CS_PLUGIN_NAMESPACE_BEGIN(csOpcode)
+{
+
+using namespace Opcode;
+
+namespace
+{
+  /// Four segments, stored as structure of arrays
+  struct SegmentPacket
+  {
+    CS_ALIGNED_MEMBER(float ox[4], 16);
+    CS_ALIGNED_MEMBER(float oy[4], 16);
+    CS_ALIGNED_MEMBER(float oz[4], 16);
+    CS_ALIGNED_MEMBER(float invX[4], 16);
+    CS_ALIGNED_MEMBER(float invY[4], 16);
+    CS_ALIGNED_MEMBER(float invZ[4], 16);
+    /// Closest hit so far (or the segment length if none)
+    CS_ALIGNED_MEMBER(float tMax[4], 16);
+    const RayBatch::Segment* segments[4];
+    bool hit[4];
+
+    void Setup (const RayBatch::Segment* segs, size_t num)
+    {
+      for (size_t i = 0; i < 4; i++)
+      {
+        // Pad incomplete packets by repeating the last segment
+        const RayBatch::Segment& s = segs[csMin (i, num-1)];
+        segments[i] = &s;
+        ox[i] = s.start.x; oy[i] = s.start.y; oz[i] = s.start.z;
+        invX[i] = SafeInverse (s.dir.x);
+        invY[i] = SafeInverse (s.dir.y);
+        invZ[i] = SafeInverse (s.dir.z);
+        tMax[i] = s.maxT;
+        hit[i] = false;
+      }
+    }
+
+    static float SafeInverse (float f)
+    {
+      // Avoid 0*inf in the slab tests
+      const float tiny = 1e-20f;
+      if (fabsf (f) < tiny) f = (f < 0) ? -tiny : tiny;
+      return 1.0f / f;
+    }
+  };
+
+  /**
+   * Slab test of all four segments against a box. Returns a bit mask of the
+   * segments that overlap the box before their current closest hit.
+   */
+#ifdef CS_SUPPORTS_SSE2
+  static inline int PacketBoxOverlap (const SegmentPacket& p,
+                                      const Point& bmin, const Point& bmax)
+  {
+    const __m128 zero = _mm_setzero_ps ();
+
+    const __m128 ox = _mm_load_ps (p.ox);
+    const __m128 ix = _mm_load_ps (p.invX);
+    __m128 t1 = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (bmin.x), ox), ix);
+    __m128 t2 = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (bmax.x), ox), ix);
+    __m128 tNear = _mm_min_ps (t1, t2);
+    __m128 tFar = _mm_max_ps (t1, t2);
+
+    const __m128 oy = _mm_load_ps (p.oy);
+    const __m128 iy = _mm_load_ps (p.invY);
+    t1 = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (bmin.y), oy), iy);
+    t2 = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (bmax.y), oy), iy);
+    tNear = _mm_max_ps (tNear, _mm_min_ps (t1, t2));
+    tFar = _mm_min_ps (tFar, _mm_max_ps (t1, t2));
+
+    const __m128 oz = _mm_load_ps (p.oz);
+    const __m128 iz = _mm_load_ps (p.invZ);
+    t1 = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (bmin.z), oz), iz);
+    t2 = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (bmax.z), oz), iz);
+    tNear = _mm_max_ps (tNear, _mm_min_ps (t1, t2));
+    tFar = _mm_min_ps (tFar, _mm_max_ps (t1, t2));
+
+    // Clip the interval to [0, tMax]
+    tNear = _mm_max_ps (tNear, zero);
+    tFar = _mm_min_ps (tFar, _mm_load_ps (p.tMax));
+    return _mm_movemask_ps (_mm_cmple_ps (tNear, tFar));
+  }
+#else
+  static inline int PacketBoxOverlap (const SegmentPacket& p,
+                                      const Point& bmin, const Point& bmax)
+  {
+    int mask = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      float t1 = (bmin.x - p.ox[i]) * p.invX[i];
+      float t2 = (bmax.x - p.ox[i]) * p.invX[i];
+      float tNear = csMin (t1, t2);
+      float tFar = csMax (t1, t2);
+      t1 = (bmin.y - p.oy[i]) * p.invY[i];
+      t2 = (bmax.y - p.oy[i]) * p.invY[i];
+      tNear = csMax (tNear, csMin (t1, t2));
+      tFar = csMin (tFar, csMax (t1, t2));
+      t1 = (bmin.z - p.oz[i]) * p.invZ[i];
+      t2 = (bmax.z - p.oz[i]) * p.invZ[i];
+      tNear = csMax (tNear, csMin (t1, t2));
+      tFar = csMin (tFar, csMax (t1, t2));
+      if (csMax (tNear, 0.0f) <= csMin (tFar, p.tMax[i])) mask |= 1 << i;
+    }
+    return mask;
+  }
+#endif
+
+  /**
+   * Ray-triangle test, same as RayCollider::RayTriOverlap() with culling
+   * disabled (as set up by the collide system). Returns the hit parameter,
+   * or a negative value if no hit.
+   */
+  static inline float SegmentTriangle (const RayBatch::Segment& s,
+    const Point& vert0, const Point& vert1, const Point& vert2)
+  {
+    const float epsilon = 0.000001f;
+    const Point dir (s.dir.x, s.dir.y, s.dir.z);
+    const Point orig (s.start.x, s.start.y, s.start.z);
+
+    const Point edge1 = vert1 - vert0;
+    const Point edge2 = vert2 - vert0;
+    const Point pvec = dir^edge2;
+    const float det = edge1|pvec;
+    if (fabsf (det) < epsilon) return -1.0f;
+    const float invDet = 1.0f / det;
+
+    const Point tvec = orig - vert0;
+    const float u = (tvec|pvec) * invDet;
+    if ((u < 0.0f) || (u > 1.0f)) return -1.0f;
+
+    const Point qvec = tvec^edge1;
+    const float v = (dir|qvec) * invDet;
+    if ((v < 0.0f) || (u + v > 1.0f)) return -1.0f;
+
+    return (edge2|qvec) * invDet;
+  }
+
+  class PacketTraverser
+  {
+    const Point* verts;
+    const unsigned int* indices;
+    csArray<const AABBQuantizedNoLeafNode*> stack;
+  public:
+    SegmentPacket packet;
+
+    PacketTraverser (const csOPCODECollider* collider)
+      : verts (collider->vertholder), indices (collider->indexholder) {}
+
+    void TestPrimitive (udword prim, int mask)
+    {
+      const unsigned int* tri = indices + prim*3;
+      const Point& v0 = verts[tri[0]];
+      const Point& v1 = verts[tri[1]];
+      const Point& v2 = verts[tri[2]];
+      for (int i = 0; i < 4; i++)
+      {
+        if (!(mask & (1 << i))) continue;
+        const float t = SegmentTriangle (*packet.segments[i], v0, v1, v2);
+        if ((t >= 0.0f) && (t <= packet.tMax[i]))
+        {
+          packet.tMax[i] = t;
+          packet.hit[i] = true;
+        }
+      }
+    }
+
+    void Traverse (const AABBQuantizedNoLeafNode* root,
+                   const Point& centerCoeff, const Point& extentsCoeff)
+    {
+      // Explicit stack, kept across packets so it only grows once
+      stack.Push (root);
+      while (stack.GetSize () > 0)
+      {
+        const AABBQuantizedNoLeafNode* node = stack.Pop ();
+
+        const QuantizedAABB& box = node->mAABB;
+        const Point center (float (box.mCenter[0]) * centerCoeff.x,
+                            float (box.mCenter[1]) * centerCoeff.y,
+                            float (box.mCenter[2]) * centerCoeff.z);
+        const Point extents (float (box.mExtents[0]) * extentsCoeff.x,
+                             float (box.mExtents[1]) * extentsCoeff.y,
+                             float (box.mExtents[2]) * extentsCoeff.z);
+
+        const int mask = PacketBoxOverlap (packet, center - extents,
+          center + extents);
+        if (!mask) continue;
+
+        if (node->HasNegLeaf ())
+          TestPrimitive (node->GetNegPrimitive (), mask);
+        else
+          stack.Push (node->GetNeg ());
+
+        if (node->HasPosLeaf ())
+          TestPrimitive (node->GetPosPrimitive (), mask);
+        else
+          stack.Push (node->GetPos ());
+      }
+    }
+  };
+}
+
+size_t RayBatch::Collide (const csOPCODECollider* collider,
+  const Segment* segments, float* hits, size_t count)
+{
+  const Model* model = collider->m_pCollisionModel;
+  if (!model || !collider->vertholder || !collider->indexholder)
+  {
+    for (size_t i = 0; i < count; i++) hits[i] = -1.0f;
+    return 0;
+  }
+
+  /* The collider always builds quantized no-leaf trees; anything else is
+   * not supported here. */
+  const AABBQuantizedNoLeafTree* tree = 0;
+  if (!model->HasSingleNode ())
+  {
+    if (model->HasLeafNodes () || !model->IsQuantized ())
+    {
+      for (size_t i = 0; i < count; i++) hits[i] = -1.0f;
+      return 0;
+    }
+    tree = static_cast<const AABBQuantizedNoLeafTree*> (model->GetTree ());
+  }
+
+  PacketTraverser traverser (collider);
+  size_t numHits = 0;
+  for (size_t first = 0; first < count; first += 4)
+  {
+    const size_t num = csMin (count - first, size_t (4));
+    traverser.packet.Setup (segments + first, num);
+
+    if (tree)
+      traverser.Traverse (tree->GetNodes (), tree->mCenterCoeff,
+        tree->mExtentsCoeff);
+    else
+      // Single triangle models have no tree, the triangle has index 0
+      traverser.TestPrimitive (0, 0xf);
+
+    for (size_t i = 0; i < num; i++)
+    {
+      if (traverser.packet.hit[i])
+      {
+        hits[first + i] = traverser.packet.tMax[i];
+        numHits++;
+      }
+      else
+        hits[first + i] = -1.0f;
+    }
+  }
+  return numHits;
+}
+
+}
+CS_PLUGIN_NAMESPACE_END(csOpcode)
@@ -0,0 +1,89 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_OPCODE_RAYBATCH_H__
+#define __CS_OPCODE_RAYBATCH_H__
+
+#include "csgeom/vector3.h"
+#include "csutil/scf_implementation.h"
+#include "iutil/job.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(csOpcode)
+{
+
+class csOPCODECollider;
+
+/**
+ * Closest hit stabbing queries for many segments against a single OPCODE
+ * model.
+ *
+ * Segments are traversed through the model's AABB tree in packets of four,
+ * with the slab tests for a packet done at once (using SSE2 if available).
+ * Each segment keeps track of its closest hit so far which is used to prune
+ * boxes further away than that.
+ */
+class RayBatch
+{
+public:
+  /// A segment in the object space of the collider.
+  struct Segment
+  {
+    csVector3 start;
+    /// Vector from start to end (or to a point on the ray).
+    csVector3 dir;
+    /// 1 for segments, FLT_MAX for rays.
+    float maxT;
+  };
+
+  /**
+   * Collide \a count segments with \a collider. \a hits receives the
+   * parameter (in units of \c dir) of the closest hit of every segment, or
+   * -1 if the segment did not hit anything. Triangles are two-sided, like
+   * with the single ray query. Returns the number of segments that hit.
+   * \remarks Only reads the collider, so multiple batches can run in
+   *   parallel on the same collider.
+   */
+  static size_t Collide (const csOPCODECollider* collider,
+    const Segment* segments, float* hits, size_t count);
+};
+
+/// Job running a part of a segment batch.
+class RayBatchJob : public scfImplementation1<RayBatchJob, iJob>
+{
+  const csOPCODECollider* collider;
+  const RayBatch::Segment* segments;
+  float* hits;
+  size_t count;
+public:
+  size_t numHits;
+
+  RayBatchJob (const csOPCODECollider* collider,
+    const RayBatch::Segment* segments, float* hits, size_t count)
+    : scfImplementationType (this), collider (collider), segments (segments),
+      hits (hits), count (count), numHits (0) {}
+
+  void Run ()
+  {
+    numHits = RayBatch::Collide (collider, segments, hits, count);
+  }
+};
+
+}
+CS_PLUGIN_NAMESPACE_END(csOpcode)
+
+#endif // __CS_OPCODE_RAYBATCH_H__
@@ -0,0 +1,107 @@
+/*
+  Copyright (C) 2012 by Crystal Space Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+#include "broadphase2.h"
+#include "collisionobject2.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
+{
+void csOpcodeBroadphase::AddObject (csOpcodeCollisionObject* object)
+{
+  // Sorted in on the next update
+  Proxy proxy;
+  proxy.object = object;
+  object->boxDirty = true;
+  proxies.Push (proxy);
+}
+
+void csOpcodeBroadphase::RemoveObject (csOpcodeCollisionObject* object)
+{
+  for (size_t i = 0; i < proxies.GetSize (); i++)
+  {
+    if (proxies[i].object == object)
+    {
+      // Keeps the remaining proxies sorted
+      proxies.DeleteIndex (i);
+      return;
+    }
+  }
+}
+
+bool csOpcodeBroadphase::Update ()
+{
+  bool moved = false;
+  for (size_t i = 0; i < proxies.GetSize (); i++)
+  {
+    csOpcodeCollisionObject* object = proxies[i].object;
+    if (object->boxDirty)
+    {
+      object->UpdateWorldBox ();
+      proxies[i].box = object->worldBox;
+      moved = true;
+    }
+  }
+  if (!moved) return false;
+
+  for (size_t i = 1; i < proxies.GetSize (); i++)
+  {
+    if (proxies[i-1].box.MinX () <= proxies[i].box.MinX ()) continue;
+    Proxy proxy = proxies[i];
+    size_t j = i;
+    for (; j > 0 && proxies[j-1].box.MinX () > proxy.box.MinX (); j--)
+      proxies[j] = proxies[j-1];
+    proxies[j] = proxy;
+  }
+  return true;
+}
+
+void csOpcodeBroadphase::FindPairs (csArray<Pair>& pairs) const
+{
+  for (size_t i = 0; i < proxies.GetSize (); i++)
+  {
+    const csBox3& box = proxies[i].box;
+    if (box.Empty ()) continue;
+    for (size_t j = i + 1; j < proxies.GetSize (); j++)
+    {
+      const csBox3& other = proxies[j].box;
+      // Everything further along starts behind this box
+      if (other.MinX () > box.MaxX ()) break;
+      if (!box.Overlap (other)) continue;
+      Pair pair;
+      pair.objectA = proxies[i].object;
+      pair.objectB = proxies[j].object;
+      pairs.Push (pair);
+    }
+  }
+}
+
+void csOpcodeBroadphase::Query (const csBox3& box,
+  csArray<csOpcodeCollisionObject*>& objects) const
+{
+  if (box.Empty ()) return;
+  for (size_t i = 0; i < proxies.GetSize (); i++)
+  {
+    const csBox3& other = proxies[i].box;
+    if (other.MinX () > box.MaxX ()) break;
+    if (box.Overlap (other))
+      objects.Push (proxies[i].object);
+  }
+}
+}
+CS_PLUGIN_NAMESPACE_END (Opcode2)
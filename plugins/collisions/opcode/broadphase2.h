@@ -0,0 +1,76 @@
+/*
+  Copyright (C) 2012 by Crystal Space Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_OPCODE_BROADPHASE_H__
+#define __CS_OPCODE_BROADPHASE_H__
+
+#include "csgeom/box.h"
+#include "csutil/array.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
+{
+class csOpcodeCollisionObject;
+
+/**
+ * Persistent sweep and prune broadphase over the world space bounding boxes
+ * of the collision objects of a sector.
+ *
+ * The proxies are kept sorted along the X axis between updates. Only the
+ * boxes of objects that moved since the last update are recomputed, and
+ * since objects usually move little between updates the list is restored
+ * with an insertion sort in close to linear time.
+ */
+class csOpcodeBroadphase
+{
+public:
+  /// A pair of objects whose bounding boxes overlap.
+  struct Pair
+  {
+    csOpcodeCollisionObject* objectA;
+    csOpcodeCollisionObject* objectB;
+  };
+
+private:
+  struct Proxy
+  {
+    csOpcodeCollisionObject* object;
+    csBox3 box;
+  };
+  csArray<Proxy> proxies;
+
+public:
+  void AddObject (csOpcodeCollisionObject* object);
+  void RemoveObject (csOpcodeCollisionObject* object);
+  size_t GetObjectCount () const { return proxies.GetSize (); }
+
+  /**
+   * Refresh the boxes of the objects that moved and restore the sort
+   * order. Returns whether any object moved.
+   */
+  bool Update ();
+
+  /// Append all pairs of objects with overlapping boxes to \a pairs.
+  void FindPairs (csArray<Pair>& pairs) const;
+
+  /// Append all objects whose boxes overlap \a box to \a objects.
+  void Query (const csBox3& box,
+    csArray<csOpcodeCollisionObject*>& objects) const;
+};
+}
+CS_PLUGIN_NAMESPACE_END (Opcode2)
+#endif
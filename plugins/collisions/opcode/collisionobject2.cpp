@@ -25,7 +25,7 @@ CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 csOpcodeCollisionObject::csOpcodeCollisionObject (csOpcodeCollisionSystem* sys)
   : scfImplementationType (this), system (sys), sector (NULL),
   collider (NULL), type (CS::Collisions::COLLISION_OBJECT_BASE),
-  collCb (NULL), isTerrain (false)
+  collCb (NULL), isTerrain (false), boxDirty (true)
 {
   transform.Identity ();
 }
@@ -42,6 +42,9 @@ void csOpcodeCollisionObject::SetObjectType (CS::Collisions::CollisionObjectType
 void csOpcodeCollisionObject::SetTransform (const csOrthoTransform& trans)
 {
   transform = trans;
+  boxDirty = true;
+  if (sector)
+    sector->contactsDirty = true;
   if (movable)
     movable->SetFullTransform (transform);
   if (camera)
@@ -62,6 +65,27 @@ void csOpcodeCollisionObject::AddCollider (CS::Collisions::iCollider* collider,
   this->collider = collider;
   if (collider->GetGeometryType () == CS::Collisions::COLLIDER_TERRAIN)
     isTerrain = true;
+  boxDirty = true;
+  if (sector)
+    sector->contactsDirty = true;
+}
+
+void csOpcodeCollisionObject::UpdateWorldBox ()
+{
+  boxDirty = false;
+  if (!collider)
+    worldBox.StartBoundingBox ();
+  else if (isTerrain)
+    // Terrains are tested against everything
+    worldBox.Set (-CS_BOUNDINGBOX_MAXVALUE, -CS_BOUNDINGBOX_MAXVALUE,
+      -CS_BOUNDINGBOX_MAXVALUE, CS_BOUNDINGBOX_MAXVALUE,
+      CS_BOUNDINGBOX_MAXVALUE, CS_BOUNDINGBOX_MAXVALUE);
+  else
+  {
+    CS::Collisions::iCollider* col = collider;
+    csOpcodeCollider* opcodeCollider = dynamic_cast<csOpcodeCollider*> (col);
+    worldBox = transform.This2Other (opcodeCollider->aabbox);
+  }
 }
 
 void csOpcodeCollisionObject::RemoveCollider (CS::Collisions::iCollider* collider)
@@ -153,11 +177,22 @@ CS::Collisions::HitBeamResult csOpcodeCollisionObject::HitBeam (const csVector3&
   return result;
 }
 
-//There's no step function now. Maybe use ContactTest is better.
-size_t csOpcodeCollisionObject::GetContactObjectsCount (){return 0;}
+//There's no step function, the contacts are updated on demand.
+size_t csOpcodeCollisionObject::GetContactObjectsCount ()
+{
+  if (!sector)
+    return 0;
+  sector->UpdateContacts ();
+  return contactObjects.GetSize ();
+}
 
 CS::Collisions::iCollisionObject* csOpcodeCollisionObject::GetContactObject (size_t index)
 {
+  if (!sector)
+    return NULL;
+  sector->UpdateContacts ();
+  if (index < contactObjects.GetSize ())
+    return contactObjects[index];
   return NULL;
 }
 }
@@ -33,6 +33,7 @@ class csOpcodeCollisionObject: public scfImplementationExt1<
   csOpcodeCollisionObject, csObject, CS::Collisions::iCollisionObject>
 {
   friend class csOpcodeCollisionSector;
+  friend class csOpcodeBroadphase;
 private:
   csOpcodeCollisionSystem* system;
   csOpcodeCollisionSector* sector;
@@ -42,11 +43,16 @@ private:
   CS::Collisions::CollisionObjectType type;
   CS::Collisions::CollisionGroup collGroup;
   csRef<CS::Collisions::iCollisionCallback> collCb;
-  csRefArray<csOpcodeCollisionObject> contactObjects;
+  csArray<csOpcodeCollisionObject*> contactObjects;
   csOrthoTransform transform;
+  csBox3 worldBox;
 
   bool insideWorld;
   bool isTerrain;
+  /// Whether worldBox needs to be recomputed (the object moved)
+  bool boxDirty;
+
+  void UpdateWorldBox ();
 
 public:
   csOpcodeCollisionObject (csOpcodeCollisionSystem* sys);
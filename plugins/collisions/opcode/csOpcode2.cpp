@@ -28,6 +28,10 @@
 #include "iutil/string.h"
 #include "ivaria/reporter.h"
 #include "csutil/scfarray.h"
+#include "csutil/platform.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threadjobqueue.h"
+#include "iutil/verbositymanager.h"
 #include "csOpcode2.h"
 #include "collisionobject2.h"
 
@@ -57,8 +61,11 @@ bool Opcode_Err (const char* msg, ...)
 }
 
 csOpcodeCollisionSector::csOpcodeCollisionSector (csOpcodeCollisionSystem* sys)
-: scfImplementationType (this), allFilter (-1), sys (sys)
+: scfImplementationType (this), allFilter (-1), sys (sys),
+  contactsDirty (true)
 {
+  memset (&stats, 0, sizeof (stats));
+
   CS::Collisions::CollisionGroup defaultGroup ("Default");
   defaultGroup.value = 1;
   defaultGroup.mask = allFilter;
@@ -87,6 +94,8 @@ void csOpcodeCollisionSector::AddCollisionObject (CS::Collisions::iCollisionObje
   collisionObjects.Push (obj);
   obj->sector = this;
   obj->collGroup = collGroups[0]; 
+  broadphase.AddObject (obj);
+  contactsDirty = true;
 
   AddMovableToSector (object);
 }
@@ -95,6 +104,9 @@ void csOpcodeCollisionSector::RemoveCollisionObject (CS::Collisions::iCollisionO
 {
   csOpcodeCollisionObject* collObject = dynamic_cast<csOpcodeCollisionObject*> (object);
   CS_ASSERT (collObject);
+  broadphase.RemoveObject (collObject);
+  collObject->contactObjects.Empty ();
+  contactsDirty = true;
   collisionObjects.Delete (collObject);
   RemoveMovableFromSector (object);
 }
@@ -215,29 +227,31 @@ bool csOpcodeCollisionSector::CollisionTest (CS::Collisions::iCollisionObject* o
 {
   size_t length = collisions.GetSize ();
   csOpcodeCollisionObject* obj = dynamic_cast<csOpcodeCollisionObject*> (object);
-  for (size_t i = 0; i < collisionObjects.GetSize (); i++)
-  {
-    if (collisionObjects[i]->QueryCollisionObject () != object)
-    {
-      bool collides = (obj->collGroup.value & collisionObjects[i]->collGroup.mask) != 0;
-      collides = collides && (collisionObjects[i]->collGroup.value & obj->collGroup.mask);
 
-      if(!collides)
-        continue;
+  // Only look at the objects whose bounding boxes overlap.
+  broadphase.Update ();
+  if (obj->boxDirty)
+    obj->UpdateWorldBox ();
+  csArray<csOpcodeCollisionObject*> candidates;
+  broadphase.Query (obj->worldBox, candidates);
 
-      if (obj->isTerrain)
-      {
-        if (collisionObjects[i]->isTerrain == false)
-          CollideTerrain (obj, collisionObjects[i], collisions);
-      }
-      else
-      {
+  for (size_t i = 0; i < candidates.GetSize (); i++)
+  {
+    csOpcodeCollisionObject* other = candidates[i];
+    if (other == obj || !GroupsCollide (obj, other))
+      continue;
 
-        if (collisionObjects[i]->isTerrain)
-          CollideTerrain (obj, collisionObjects[i], collisions);
-        else
-          CollideObject (obj, collisionObjects[i], collisions);
-      }
+    if (obj->isTerrain)
+    {
+      if (other->isTerrain == false)
+        CollideTerrain (obj, other, collisions);
+    }
+    else
+    {
+      if (other->isTerrain)
+        CollideTerrain (obj, other, collisions);
+      else
+        CollideObject (obj, other, collisions);
     }
   }
   if (length != collisions.GetSize ())
@@ -246,6 +260,13 @@ bool csOpcodeCollisionSector::CollisionTest (CS::Collisions::iCollisionObject* o
     return false;
 }
 
+bool csOpcodeCollisionSector::GroupsCollide (csOpcodeCollisionObject* objA,
+                                             csOpcodeCollisionObject* objB)
+{
+  return ((objA->collGroup.value & objB->collGroup.mask) != 0)
+    && ((objB->collGroup.value & objA->collGroup.mask) != 0);
+}
+
 void csOpcodeCollisionSector::AddCollisionActor (CS::Collisions::iCollisionActor* actor)
 {
 //TODO
@@ -339,8 +360,6 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
                                                                         const csVector3& end,
                                                                         float& depth)
 {
-  ColCache.Model0 = model;
-
   csMatrix3 m;
   m = trans.GetT2O ();
   csVector3 u;
@@ -379,7 +398,7 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
   collision_faces.SetSize (0);
 
   CS::Collisions::HitBeamResult result;
-  bool isOk = RayCol.Collide (ray, *ColCache.Model0, &transform);
+  bool isOk = RayCol.Collide (ray, *model, &transform);
   if (isOk)
   {
     bool status = (RayCol.GetContactStatus () != FALSE);
@@ -437,7 +456,8 @@ CS::Collisions::HitBeamResult csOpcodeCollisionSector::HitBeamCollider (Opcode::
 
 }
 
-bool csOpcodeCollisionSector::CollideObject (csOpcodeCollisionObject* objA,
+bool csOpcodeCollisionSector::CollideObject (NarrowphaseContext& context,
+                                             csOpcodeCollisionObject* objA,
                                              csOpcodeCollisionObject* objB, 
                                              csArray<CS::Collisions::CollisionData>& collisions)
 {
@@ -445,24 +465,25 @@ bool csOpcodeCollisionSector::CollideObject (csOpcodeCollisionObject* objA,
   csOpcodeCollider* colliderA = dynamic_cast<csOpcodeCollider*> (col);
   col = objB->collider;
   csOpcodeCollider* colliderB = dynamic_cast<csOpcodeCollider*> (col);
-  if (CollideDetect (colliderA->model, colliderB->model, 
+  if (CollideDetect (context, colliderA->model, colliderB->model, 
     objA->transform, objB->transform))
   {
-    
-    GetCollisionData (colliderA->model, colliderB->model, 
+    CS::Collisions::CollisionData data;
+    GetCollisionData (context, colliderA->model, colliderB->model, 
       colliderA->vertholder, colliderB->vertholder,
       colliderA->indexholder, colliderB->indexholder,
-      objA->transform, objB->transform);
-    curCollisionData.objectA = objA;
-    curCollisionData.objectB = objB;
-    collisions.Push (curCollisionData);
+      objA->transform, objB->transform, data);
+    data.objectA = objA;
+    data.objectB = objB;
+    collisions.Push (data);
     
     return true;
   }
   return false;
 }
 
-bool csOpcodeCollisionSector::CollideTerrain (csOpcodeCollisionObject* objA, 
+bool csOpcodeCollisionSector::CollideTerrain (NarrowphaseContext& context,
+                                              csOpcodeCollisionObject* objA, 
                                               csOpcodeCollisionObject* objB,
                                               csArray<CS::Collisions::CollisionData>& collisions)
 {
@@ -487,36 +508,37 @@ bool csOpcodeCollisionSector::CollideTerrain (csOpcodeCollisionObject* objA,
     bool isCollide;
     if (terrainIsA)
     {
-      isCollide = CollideDetect (terrainColl->GetColliderModel (i), objColl->model,
-      terrainColl->GetColliderTransform (i), objB->transform);
+      isCollide = CollideDetect (context, terrainColl->GetColliderModel (i),
+        objColl->model, terrainColl->GetColliderTransform (i), objB->transform);
       if (isCollide)
       { 
-        
-        GetCollisionData (terrainColl->GetColliderModel (i), objColl->model,
+        CS::Collisions::CollisionData data;
+        GetCollisionData (context, terrainColl->GetColliderModel (i), objColl->model,
           terrainColl->GetVertexHolder (i), objColl->vertholder,
           terrainColl->GetIndexHolder (i), objColl->indexholder,
-          terrainColl->GetColliderTransform (i), objB->transform);
-        curCollisionData.objectA = objA;
-        curCollisionData.objectB = objB;
-        collisions.Push (curCollisionData);
+          terrainColl->GetColliderTransform (i), objB->transform, data);
+        data.objectA = objA;
+        data.objectB = objB;
+        collisions.Push (data);
         
         return true;
       }
     }
     else
     {
-      isCollide = CollideDetect (objColl->model, terrainColl->GetColliderModel (i),
-      objA->transform, terrainColl->GetColliderTransform (i));
+      isCollide = CollideDetect (context, objColl->model,
+        terrainColl->GetColliderModel (i), objA->transform,
+        terrainColl->GetColliderTransform (i));
       if (isCollide)
       { 
-        
-        GetCollisionData (objColl->model, terrainColl->GetColliderModel (i),
+        CS::Collisions::CollisionData data;
+        GetCollisionData (context, objColl->model, terrainColl->GetColliderModel (i),
         objColl->vertholder, terrainColl->GetVertexHolder (i),
         objColl->indexholder, terrainColl->GetIndexHolder (i),
-        objA->transform, terrainColl->GetColliderTransform (i));
-        curCollisionData.objectA = objA;
-        curCollisionData.objectB = objB;
-        collisions.Push (curCollisionData);
+        objA->transform, terrainColl->GetColliderTransform (i), data);
+        data.objectA = objA;
+        data.objectB = objB;
+        collisions.Push (data);
         
         return true;
       }
@@ -525,13 +547,15 @@ bool csOpcodeCollisionSector::CollideTerrain (csOpcodeCollisionObject* objA,
   return false;
 }
 
-bool csOpcodeCollisionSector::CollideDetect (Opcode::Model* modelA,
+bool csOpcodeCollisionSector::CollideDetect (NarrowphaseContext& context,
+                                             Opcode::Model* modelA,
                                              Opcode::Model* modelB, 
                                              const csOrthoTransform& transA, 
                                              const csOrthoTransform& transB)
 {
-  ColCache.Model0 = modelA;
-  ColCache.Model1 = modelB;
+  Opcode::BVTCache& colCache = context.colCache;
+  colCache.Model0 = modelA;
+  colCache.Model1 = modelB;
 
   csMatrix3 m1;
   m1 = transA.GetT2O ();
@@ -585,29 +609,31 @@ bool csOpcodeCollisionSector::CollideDetect (Opcode::Model* modelA,
   transform2.m[3][1] = u.y;
   transform2.m[3][2] = u.z;
 
-  bool isOk = TreeCollider.Collide (ColCache, &transform1, &transform2);
+  bool isOk = context.treeCollider.Collide (colCache, &transform1, &transform2);
 
   if (isOk)
   {
-    bool status = (TreeCollider.GetContactStatus () != FALSE);
+    bool status = (context.treeCollider.GetContactStatus () != FALSE);
     return status;
   }
   return false;
 }
 
-void csOpcodeCollisionSector::GetCollisionData (Opcode::Model* modelA, 
+void csOpcodeCollisionSector::GetCollisionData (NarrowphaseContext& context,
+                                                Opcode::Model* modelA, 
                                                 Opcode::Model* modelB, 
                                                 Point* vertholderA, 
                                                 Point* vertholderB, 
                                                 udword* indexholderA, 
                                                 udword* indexholderB, 
                                                 const csOrthoTransform& transA,
-                                                const csOrthoTransform& transB)
+                                                const csOrthoTransform& transB,
+                                                CS::Collisions::CollisionData& data)
 {
-  int size = (int) (udword(TreeCollider.GetNbPairs ()));
+  int size = (int) (udword(context.treeCollider.GetNbPairs ()));
   if (size == 0) return;
   int N_pairs = size;
-  const Pair* colPairs=TreeCollider.GetPairs ();
+  const Pair* colPairs=context.treeCollider.GetPairs ();
   if (!vertholderA || !vertholderB
     || !indexholderA || !indexholderB) 
     return;
@@ -686,10 +712,144 @@ void csOpcodeCollisionSector::GetCollisionData (Opcode::Model* modelA,
 
   csVector3 disBetweenPoints = posi1 - posi2;
 
-  curCollisionData.normalWorldOnB = transB.This2Other (normal2);
-  curCollisionData.positionWorldOnA = transA.This2Other (posi1);
-  curCollisionData.positionWorldOnB = transB.This2Other (posi2);
-  curCollisionData.penetration = csVector3::Norm (posi1 - posi2);
+  data.normalWorldOnB = transB.This2Other (normal2);
+  data.positionWorldOnA = transA.This2Other (posi1);
+  data.positionWorldOnB = transB.This2Other (posi2);
+  data.penetration = csVector3::Norm (posi1 - posi2);
+}
+
+bool csOpcodeCollisionSector::DetectContact (NarrowphaseContext& context,
+                                             csOpcodeCollisionObject* objA,
+                                             csOpcodeCollisionObject* objB)
+{
+  if (!objA->isTerrain && !objB->isTerrain)
+  {
+    CS::Collisions::iCollider* col = objA->collider;
+    csOpcodeCollider* colliderA = dynamic_cast<csOpcodeCollider*> (col);
+    col = objB->collider;
+    csOpcodeCollider* colliderB = dynamic_cast<csOpcodeCollider*> (col);
+    return CollideDetect (context, colliderA->model, colliderB->model,
+      objA->transform, objB->transform);
+  }
+
+  csOpcodeCollisionObject* terrainObj = objA->isTerrain ? objA : objB;
+  csOpcodeCollisionObject* obj = objA->isTerrain ? objB : objA;
+  CS::Collisions::iCollider* col = terrainObj->collider;
+  csOpcodeColliderTerrain* terrainColl = dynamic_cast<csOpcodeColliderTerrain*> (col);
+  col = obj->collider;
+  csOpcodeCollider* objColl = dynamic_cast<csOpcodeCollider*> (col);
+  for (size_t i = 0; i < terrainColl->colliders.GetSize (); i++)
+  {
+    if (CollideDetect (context, terrainColl->GetColliderModel (i),
+      objColl->model, terrainColl->GetColliderTransform (i), obj->transform))
+      return true;
+  }
+  return false;
+}
+
+/// Below this number of pairs the narrowphase is not worth splitting up.
+static const size_t parallelPairThreshold = 64;
+
+void csOpcodeCollisionSector::UpdateContacts ()
+{
+  if (!contactsDirty)
+    return;
+  contactsDirty = false;
+
+  csMicroTicks startTime = csGetMicroTicks ();
+
+  broadphase.Update ();
+  contactPairs.SetSize (0);
+  broadphase.FindPairs (contactPairs);
+  size_t numPairs = 0;
+  for (size_t i = 0; i < contactPairs.GetSize (); i++)
+  {
+    csOpcodeBroadphase::Pair& pair = contactPairs[i];
+    if (pair.objectA->isTerrain && pair.objectB->isTerrain)
+      continue;
+    if (!pair.objectA->collider || !pair.objectB->collider)
+      continue;
+    if (!GroupsCollide (pair.objectA, pair.objectB))
+      continue;
+    contactPairs[numPairs++] = pair;
+  }
+  contactPairs.Truncate (numPairs);
+
+  csMicroTicks narrowphaseStart = csGetMicroTicks ();
+  pairContacts.SetSize (numPairs);
+  RunNarrowphase ();
+  csMicroTicks endTime = csGetMicroTicks ();
+
+  for (size_t i = 0; i < collisionObjects.GetSize (); i++)
+    collisionObjects[i]->contactObjects.SetSize (0);
+  size_t numContacts = 0;
+  for (size_t i = 0; i < numPairs; i++)
+  {
+    if (!pairContacts[i]) continue;
+    contactPairs[i].objectA->contactObjects.Push (contactPairs[i].objectB);
+    contactPairs[i].objectB->contactObjects.Push (contactPairs[i].objectA);
+    numContacts++;
+  }
+
+  stats.objectCount = broadphase.GetObjectCount ();
+  stats.pairCount = numPairs;
+  stats.contactCount = numContacts;
+  stats.broadphaseTime = narrowphaseStart - startTime;
+  stats.narrowphaseTime = endTime - narrowphaseStart;
+  if (sys->doVerbose)
+  {
+    csReport (sys->object_reg, CS_REPORTER_SEVERITY_NOTIFY,
+      "crystalspace.collisiondetection.opcode",
+      "%zu objects, %zu pairs, %zu contacts; broadphase %d us, "
+      "narrowphase %d us", stats.objectCount, stats.pairCount,
+      stats.contactCount, int (stats.broadphaseTime),
+      int (stats.narrowphaseTime));
+  }
+}
+
+void csOpcodeCollisionSector::RunNarrowphase ()
+{
+  size_t numPairs = contactPairs.GetSize ();
+  if (numPairs == 0)
+    return;
+
+  size_t numJobs = CS::Platform::GetProcessorCount ();
+  if ((numPairs < parallelPairThreshold) || (numJobs < 2))
+  {
+    for (size_t i = 0; i < numPairs; i++)
+      pairContacts[i] = DetectContact (mainContext,
+        contactPairs[i].objectA, contactPairs[i].objectB);
+    return;
+  }
+
+  while (narrowphaseJobs.GetSize () < numJobs)
+  {
+    csRef<csOpcodeNarrowphaseJob> job;
+    job.AttachNew (new csOpcodeNarrowphaseJob (this));
+    narrowphaseJobs.Push (job);
+  }
+
+  iJobQueue* jobQueue = sys->GetJobQueue ();
+  size_t chunkSize = (numPairs + numJobs - 1) / numJobs;
+  size_t first = 0;
+  for (size_t i = 0; i < numJobs; i++)
+  {
+    csOpcodeNarrowphaseJob* job = narrowphaseJobs[i];
+    job->pairs = contactPairs.GetArray () + first;
+    job->contacts = pairContacts.GetArray () + first;
+    job->count = csMin (chunkSize, numPairs - first);
+    first += job->count;
+    jobQueue->Enqueue (job);
+  }
+  for (size_t i = 0; i < numJobs; i++)
+    jobQueue->PullAndRun (narrowphaseJobs[i]);
+}
+
+void csOpcodeNarrowphaseJob::Run ()
+{
+  for (size_t i = 0; i < count; i++)
+    contacts[i] = sector->DetectContact (context, pairs[i].objectA,
+      pairs[i].objectB);
 }
 
 SCF_IMPLEMENT_FACTORY (csOpcodeCollisionSystem)
@@ -697,7 +857,7 @@ SCF_IMPLEMENT_FACTORY (csOpcodeCollisionSystem)
 iObjectRegistry* csOpcodeCollisionSystem::rep_object_reg = NULL;
 
 csOpcodeCollisionSystem::csOpcodeCollisionSystem (iBase* iParent)
-: scfImplementationType (this, iParent)
+: scfImplementationType (this, iParent), doVerbose (false)
 {
 }
 
@@ -715,9 +875,24 @@ bool csOpcodeCollisionSystem::Initialize (iObjectRegistry* object_reg)
     object_reg, "crystalspace.shared.stringset");
   baseID = strings->Request ("base");
   colldetID = strings->Request ("colldet");
+
+  csRef<iVerbosityManager> verbosity = csQueryRegistry<iVerbosityManager> (
+    object_reg);
+  doVerbose = verbosity && verbosity->Enabled ("collisions.opcode");
   return true;
 }
 
+iJobQueue* csOpcodeCollisionSystem::GetJobQueue ()
+{
+  if (!jobQueue)
+  {
+    jobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+      CS::Platform::GetProcessorCount (), CS::Threading::THREAD_PRIO_NORMAL,
+      "opcode2 narrowphase"));
+  }
+  return jobQueue;
+}
+
 void csOpcodeCollisionSystem::SetInternalScale (float scale)
 {
   //use internal scale?
@@ -27,21 +27,55 @@
 #include "iengine/sector.h"
 #include "iengine/movable.h"
 #include "csutil/csobject.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/refarr.h"
+#include "iutil/job.h"
 #include "Opcode.h"
+#include "broadphase2.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN (Opcode2)
 {
 class csOpcodeCollisionSystem;
 class csOpcodeCollisionObject;
+class csOpcodeCollisionSector;
+
+/**
+ * Narrowphase collider state. Every narrowphase job has its own so jobs
+ * running in parallel don't share caches.
+ */
+struct NarrowphaseContext
+{
+  Opcode::AABBTreeCollider treeCollider;
+  Opcode::BVTCache colCache;
+};
+
+/// Job testing a range of broadphase pairs for contact.
+class csOpcodeNarrowphaseJob : public scfImplementation1<
+  csOpcodeNarrowphaseJob, iJob>
+{
+  csOpcodeCollisionSector* sector;
+  NarrowphaseContext context;
+
+public:
+  const csOpcodeBroadphase::Pair* pairs;
+  bool* contacts;
+  size_t count;
+
+  csOpcodeNarrowphaseJob (csOpcodeCollisionSector* sector)
+    : scfImplementationType (this), sector (sector), pairs (0),
+    contacts (0), count (0) {}
+
+  virtual void Run ();
+};
 
 class csOpcodeCollisionSector : public scfImplementationExt1<
   csOpcodeCollisionSector, csObject, CS::Collisions::iCollisionSector>
 {
 
   friend class csOpcodeCollisionObject;
-  Opcode::AABBTreeCollider TreeCollider;
+  friend class csOpcodeNarrowphaseJob;
+  NarrowphaseContext mainContext;
   Opcode::RayCollider RayCol;
-  Opcode::BVTCache ColCache;
 
   struct CollisionPortal
   {
@@ -75,7 +109,32 @@ class csOpcodeCollisionSector : public scfImplementationExt1<
   csRefArrayObject<csOpcodeCollisionObject> collisionObjects;
   csArray<CollisionPortal> portals;
   csArray<int> collision_faces;
-  CS::Collisions::CollisionData curCollisionData;
+
+  csOpcodeBroadphase broadphase;
+  /// Set when objects were added, removed or moved since UpdateContacts()
+  bool contactsDirty;
+  csDirtyAccessArray<csOpcodeBroadphase::Pair> contactPairs;
+  csDirtyAccessArray<bool> pairContacts;
+  /// Narrowphase jobs, kept around so their collider caches are reused
+  csRefArray<csOpcodeNarrowphaseJob> narrowphaseJobs;
+
+public:
+  /// Statistics of the last contact update.
+  struct Statistics
+  {
+    size_t objectCount;
+    size_t pairCount;
+    size_t contactCount;
+    csMicroTicks broadphaseTime;
+    csMicroTicks narrowphaseTime;
+  };
+
+private:
+  Statistics stats;
+
+  static bool GroupsCollide (csOpcodeCollisionObject* objA,
+    csOpcodeCollisionObject* objB);
+  void RunNarrowphase ();
 
 public:
   csOpcodeCollisionSector (csOpcodeCollisionSystem* sys);
@@ -134,19 +193,42 @@ public:
   CS::Collisions::HitBeamResult HitBeamObject (csOpcodeCollisionObject* object,
     const csVector3& start, const csVector3& end, float& depth);
 
-  bool CollideDetect (Opcode::Model* modelA, Opcode::Model* modelB,
+  bool CollideDetect (NarrowphaseContext& context,
+    Opcode::Model* modelA, Opcode::Model* modelB,
     const csOrthoTransform& transA, const csOrthoTransform& transB);
 
-  void GetCollisionData (Opcode::Model* modelA, Opcode::Model* modelB,
+  void GetCollisionData (NarrowphaseContext& context,
+    Opcode::Model* modelA, Opcode::Model* modelB,
     Point* vertholderA, Point* vertholderB,
     udword* indexholderA, udword* indexholderB,
-    const csOrthoTransform& transA, const csOrthoTransform& transB);
+    const csOrthoTransform& transA, const csOrthoTransform& transB,
+    CS::Collisions::CollisionData& data);
 
-  bool CollideObject (csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
+  bool CollideObject (NarrowphaseContext& context,
+    csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
     csArray<CS::Collisions::CollisionData>& collisions);
+  bool CollideObject (csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
+    csArray<CS::Collisions::CollisionData>& collisions)
+  { return CollideObject (mainContext, objA, objB, collisions); }
 
-  bool CollideTerrain (csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
+  bool CollideTerrain (NarrowphaseContext& context,
+    csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
     csArray<CS::Collisions::CollisionData>& collisions);
+  bool CollideTerrain (csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB, 
+    csArray<CS::Collisions::CollisionData>& collisions)
+  { return CollideTerrain (mainContext, objA, objB, collisions); }
+
+  /// Test whether two objects touch, without computing collision data.
+  bool DetectContact (NarrowphaseContext& context,
+    csOpcodeCollisionObject* objA, csOpcodeCollisionObject* objB);
+
+  /**
+   * Update the contact objects of all objects in the sector, if anything
+   * changed since the last update. Pairs found by the broadphase are
+   * distributed over the system's job queue.
+   */
+  void UpdateContacts ();
+  const Statistics& GetStatistics () const { return stats; }
 };
 
 class csOpcodeCollisionSystem : public scfImplementation2<
@@ -154,19 +236,26 @@ class csOpcodeCollisionSystem : public scfImplementation2<
   iComponent>
 {
 friend class csOpcodeCollider;
+friend class csOpcodeCollisionSector;
 private:
   iObjectRegistry* object_reg;
   csRefArrayObject<csOpcodeCollisionSector> collSectors;
   csStringID baseID;
   csStringID colldetID;
+  csRef<iJobQueue> jobQueue;
 
 public:
+  bool doVerbose;
+
   csOpcodeCollisionSystem (iBase* iParent);
   virtual ~csOpcodeCollisionSystem ();
 
   // iComponent
   virtual bool Initialize (iObjectRegistry* object_reg);
 
+  /// Get the job queue for the narrowphase, created on first use.
+  iJobQueue* GetJobQueue ();
+
   // iCollisionSystem
   virtual void SetInternalScale (float scale);
   virtual csRef<CS::Collisions::iColliderConvexMesh> CreateColliderConvexMesh (
@@ -84,7 +84,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
   SCF_IMPLEMENT_FACTORY(csThreadedLoader)
 
   csThreadedLoader::csThreadedLoader(iBase *p)
-  : scfImplementationType (this, p), loaderFlags (CS_LOADER_NONE), listSync(false), shaderSets (this)
+  : scfImplementationType (this, p), loaderFlags (CS_LOADER_NONE), listSync(false), shaderSets (this),
+    textureCache (this)
   {
   }
 
@@ -146,6 +147,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
       ReportError("crystalspace.level.threadedloader", "Failed to find an image loader!");
       return false;
     }
+    textureCache.Initialize ();
 
     g3d = csQueryRegistry<iGraphics3D> (object_reg);
     if(!g3d)
@@ -185,6 +187,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
        to the engine. Presumably, that stuff isn't needed anyway since we
        close ... */
     ClearLoaderLists ();
+    textureCache.ReportStatistics ();
 
     return false;
   }
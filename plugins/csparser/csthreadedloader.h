@@ -45,6 +45,7 @@
 #include "ldrplug.h"
 #include "proxyimage.h"
 #include "shadersets.h"
+#include "texturecache.h"
 
 class csReversibleTransform;
 struct iCollection;
@@ -687,7 +688,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     /// Lock on pushing lib nodes and id to lists.
     CS::Threading::Mutex preParseLibsLock;
 
-    csPtr<iImage> LoadImage (iDataBuffer* buf, const char* fname, int Format, bool do_verbose);
+    /**
+     * Load an image. \a texClass is the class of the texture the image is
+     * used for, if known; only then the image can go through the texture
+     * cache.
+     */
+    csPtr<iImage> LoadImage (iDataBuffer* buf, const char* fname, int Format,
+      bool do_verbose, const char* texClass = 0);
 
     /**
      * Load a LOD control object.
@@ -918,6 +925,9 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     /// Shader sets manager
     friend class ShaderSets;
     ShaderSets shaderSets;
+    /// On-disk cache of decoded images
+    friend class TextureCache;
+    TextureCache textureCache;
 
     // Tokens
     csStringHash xmltokens;
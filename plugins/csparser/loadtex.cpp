@@ -104,7 +104,8 @@ csPtr<iImage> GenerateErrorTexture (int width, int height)
 }
 
 csPtr<iImage> csThreadedLoader::LoadImage (iDataBuffer* buf, const char* fname,
-                                           int Format, bool do_verbose)
+                                           int Format, bool do_verbose,
+                                           const char* texClass)
 {
   if (!ImageLoader)
     return 0;
@@ -127,15 +128,27 @@ csPtr<iImage> csThreadedLoader::LoadImage (iDataBuffer* buf, const char* fname,
     return 0;
   }
 
-  // we don't use csRef because we need to return an Increfed object later
-  csRef<iImage> image (ImageLoader->Load (buf, Format));
+  csString cacheKey;
+  csRef<iImage> image;
+  if (texClass && textureCache.IsCacheable (buf, Format))
+  {
+    cacheKey = textureCache.GetKey (buf, Format, texClass);
+    image = textureCache.Load (cacheKey, Format);
+  }
   if (!image)
   {
-    ReportWarning (
-      "crystalspace.maploader.parse.image",
-      "Could not load image %s. Unknown format!",
-      CS::Quote::Single (fname ? fname : "<unknown>"));
-    return 0;
+    // we don't use csRef because we need to return an Increfed object later
+    image = ImageLoader->Load (buf, Format);
+    if (!image)
+    {
+      ReportWarning (
+        "crystalspace.maploader.parse.image",
+        "Could not load image %s. Unknown format!",
+        CS::Quote::Single (fname ? fname : "<unknown>"));
+      return 0;
+    }
+    if (!cacheKey.IsEmpty ())
+      image = textureCache.Store (cacheKey, image, Format, texClass);
   }
 
   if (fname)
@@ -197,9 +210,9 @@ THREADED_CALLABLE_IMPL6(csThreadedLoader, LoadTexture, const char* cwd, const ch
     Format = CS_IMGFMT_TRUECOLOR;
   }
 
-  csRef<iThreadReturn> itr = csPtr<iThreadReturn>(new csLoaderReturn(threadman));
-  LoadImageTC (itr, false, vfs->GetCwd(), fname, Format, do_verbose);
-  csRef<iImage> Image = scfQueryInterfaceSafe<iImage>(itr->GetResultRefPtr());
+  // The texture is registered with the default class
+  csRef<iDataBuffer> buf = vfs->ReadFile (fname, false);
+  csRef<iImage> Image = LoadImage (buf, fname, Format, do_verbose, "default");
   if (!Image)
   {
     ReportWarning ("crystalspace.maploader.parse.texture",
@@ -252,7 +265,7 @@ THREADED_CALLABLE_IMPL6(csThreadedLoader, LoadTexture, const char* cwd, csRef<iD
   else
     Format = CS_IMGFMT_TRUECOLOR;
 
-  csRef<iImage> Image = LoadImage (buf, 0, Format, do_verbose);
+  csRef<iImage> Image = LoadImage (buf, 0, Format, do_verbose, "default");
   if (!Image)
   {
     ReportWarning (
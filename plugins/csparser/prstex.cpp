@@ -365,14 +365,18 @@ CS_PLUGIN_NAMESPACE_BEGIN(csparser)
     }
     else if (!filename.IsEmpty ())
     {
-      csRef<iThreadReturn> ret = csPtr<iThreadReturn>(new csLoaderReturn(threadman));
-      if(!LoadImageTC (ret, false, vfs->GetCwd(), filename, Format, false))
+      /* Cached mipmaps are built for the texture class. Key colors are only
+         set after loading, so images with one are not cached. */
+      csRef<iDataBuffer> buf = vfs->ReadFile (filename, false);
+      const char* imageClass = texClass.IsEmpty () ? "default"
+        : texClass.GetData ();
+      csRef<iImage> image = LoadImage (buf, filename, Format, false,
+        do_transp ? 0 : imageClass);
+      if (!image.IsValid ())
       {
         SyntaxService->Report("crystalspace.maploader.parse.texture",
           CS_REPORTER_SEVERITY_WARNING, node, "Could not load image %s!", filename.GetData());
       }
-
-      csRef<iImage> image = scfQueryInterfaceSafe<iImage>(ret->GetResultRefPtr());
       context.SetImage (image);
       if (image.IsValid() && type.IsEmpty ())
       {
@@ -0,0 +1,267 @@
+/*
+  Copyright (C) 2012 by Crystal Space Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "texturecache.h"
+
+#include "csgfx/imagemanipulate.h"
+#include "csgfx/imagememory.h"
+#include "csutil/cfgacc.h"
+#include "csutil/md5.h"
+#include "csutil/vfscache.h"
+#include "csver.h"
+#include "igraphic/animimg.h"
+#include "igraphic/image.h"
+#include "igraphic/imageio.h"
+#include "iutil/databuff.h"
+#include "ivaria/reporter.h"
+
+#include "csthreadedloader.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(csparser)
+{
+  /* Used as the ID of cache entries. Increase when the stored data changes,
+   * entries written by older versions are then ignored. */
+  static const uint32 cacheVersion = 2;
+  static const char cacheType[] = "texture";
+
+  /// Texture class settings read from the OpenGL texture manager config
+  struct TextureCache::ClassSettings
+  {
+    bool allowMipSharpen;
+    bool sharpenPrecomputedMipmaps;
+    MipSettings mip;
+  };
+
+  TextureCache::TextureCache (csThreadedLoader* parent) : parent (parent),
+    minSize (0), hits (0), misses (0), stores (0)
+  {
+    defaultSettings.sharpen = 0;
+    defaultSettings.renormalize = false;
+    defaultSettings.mipmapFlags = csImageManipulate::mipFilterBox;
+  }
+
+  void TextureCache::Initialize ()
+  {
+    csConfigAccess config (parent->object_reg, "/config/engine.cfg");
+    if (!config->GetBool ("Loader.TextureCache.Enable", false)) return;
+
+    const char* cachePath = config->GetStr ("Loader.TextureCache.Path",
+      "/texturecache");
+    saveOptions = config->GetStr ("Loader.TextureCache.Options", "");
+    minSize = config->GetInt ("Loader.TextureCache.MinSize", 64);
+    cache.AttachNew (new csVfsCacheManager (parent->object_reg,
+      csString().Format ("%s/" CS_VERSION_MAJOR "." CS_VERSION_MINOR,
+      cachePath)));
+
+    /* Mirror the mipmap settings of the OpenGL texture manager: the texture
+     * manager uses precomputed mipmaps as they are, so the cache has to
+     * build them the way the texture manager would have. */
+    csConfigAccess glConfig (parent->object_reg, "/config/r3dopengl.cfg");
+    const int sharpenMipmaps = glConfig->GetInt (
+      "Video.OpenGL.SharpenMipmaps", 0);
+    csHash<ClassSettings, csString> classes;
+    ClassSettings glDefaults;
+    glDefaults.allowMipSharpen = true;
+    glDefaults.sharpenPrecomputedMipmaps = false;
+    glDefaults.mip = defaultSettings;
+
+    csString extractedClass;
+    csRef<iConfigIterator> it = glConfig->Enumerate (
+      "Video.OpenGL.TextureClass.");
+    while (it->HasNext ())
+    {
+      it->Next ();
+      const char* keyName = it->GetKey (true);
+      const char* dot = strchr (keyName, '.');
+      if (dot == 0) continue;
+      extractedClass.Replace (keyName, dot - keyName);
+      ClassSettings& settings = classes.GetOrCreate (extractedClass,
+        glDefaults);
+
+      const char* optionName = dot + 1;
+      if (strcasecmp (optionName, "SharpenPrecomputedMipmaps") == 0)
+        settings.sharpenPrecomputedMipmaps = it->GetBool ();
+      else if (strcasecmp (optionName, "AllowMipSharpen") == 0)
+        settings.allowMipSharpen = it->GetBool ();
+      else if (strcasecmp (optionName, "RenormalizeGeneratedMips") == 0)
+        settings.mip.renormalize = it->GetBool ();
+      else if (strcasecmp (optionName, "MipmapFilter") == 0)
+      {
+        settings.mip.mipmapFlags &= ~csImageManipulate::mipFilterMask;
+        if (strcasecmp (it->GetStr (), "kaiser") == 0)
+          settings.mip.mipmapFlags |= csImageManipulate::mipFilterKaiser;
+      }
+      else if (strcasecmp (optionName, "GammaCorrectMips") == 0)
+      {
+        if (it->GetBool ())
+          settings.mip.mipmapFlags |= csImageManipulate::mipGammaCorrect;
+        else
+          settings.mip.mipmapFlags &= ~csImageManipulate::mipGammaCorrect;
+      }
+      else if (strcasecmp (optionName, "PremultipliedAlphaMips") == 0)
+      {
+        if (it->GetBool ())
+          settings.mip.mipmapFlags |= csImageManipulate::mipPremultipliedAlpha;
+        else
+          settings.mip.mipmapFlags &=
+            ~csImageManipulate::mipPremultipliedAlpha;
+      }
+    }
+
+    /* The texture manager sharpens precomputed mipmaps itself if the class
+     * asks for it, so only sharpen when it won't. */
+    if (glDefaults.allowMipSharpen && !glDefaults.sharpenPrecomputedMipmaps)
+      defaultSettings.sharpen = sharpenMipmaps;
+    csHash<ClassSettings, csString>::GlobalIterator classIt (
+      classes.GetIterator ());
+    while (classIt.HasNext ())
+    {
+      csString className;
+      ClassSettings& settings = classIt.Next (className);
+      if (settings.allowMipSharpen && !settings.sharpenPrecomputedMipmaps)
+        settings.mip.sharpen = sharpenMipmaps;
+      classSettings.Put (className, settings.mip);
+    }
+  }
+
+  const TextureCache::MipSettings& TextureCache::GetMipSettings (
+    const char* texClass) const
+  {
+    const MipSettings* settings = classSettings.GetElementPointer (
+      texClass ? texClass : "default");
+    return settings ? *settings : defaultSettings;
+  }
+
+  bool TextureCache::IsCacheable (iDataBuffer* source, int format) const
+  {
+    if (!cache) return false;
+    // Only truecolor images are cached
+    const int imageFormat = format & CS_IMGFMT_MASK;
+    if ((imageFormat != CS_IMGFMT_TRUECOLOR) && (imageFormat != CS_IMGFMT_ANY))
+      return false;
+    // DDS files already are what the cache would store
+    if ((source->GetSize () >= 4)
+        && (memcmp (source->GetData (), "DDS ", 4) == 0))
+      return false;
+    return true;
+  }
+
+  csString TextureCache::GetKey (iDataBuffer* source, int format,
+                                 const char* texClass)
+  {
+    CS::Utility::Checksum::MD5::Digest digest (
+      CS::Utility::Checksum::MD5::Encode (source->GetData (),
+        source->GetSize ()));
+    const MipSettings& settings = GetMipSettings (texClass);
+    csString key (digest.HexString ());
+    key.AppendFmt ("-%x-%s-%d-%d-%x", format, texClass ? texClass : "default",
+      settings.sharpen, int (settings.renormalize), settings.mipmapFlags);
+    return key;
+  }
+
+  csPtr<iImage> TextureCache::Load (const char* key, int format)
+  {
+    if (!cache) return 0;
+
+    csRef<iDataBuffer> data;
+    {
+      CS::Threading::MutexScopedLock lock (cacheLock);
+      data = cache->ReadCache (cacheType, key, cacheVersion);
+    }
+    csRef<iImage> image;
+    if (data.IsValid ())
+      image = parent->ImageLoader->Load (data, format);
+    if (!image.IsValid ())
+    {
+      CS::Threading::AtomicOperations::Increment (&misses);
+      return 0;
+    }
+    CS::Threading::AtomicOperations::Increment (&hits);
+    return csPtr<iImage> (image);
+  }
+
+  csRef<iImage> TextureCache::Store (const char* key, iImage* image,
+                                     int format, const char* texClass)
+  {
+    csRef<iImage> result (image);
+    if (!cache) return result;
+
+    /* Only plain 2D truecolor images. Key colors and texture formats that
+     * already come with mipmaps are left to the texture manager. */
+    if ((image->GetImageType () != csimg2D)
+        || ((image->GetFormat () & CS_IMGFMT_MASK) != CS_IMGFMT_TRUECOLOR)
+        || image->HasKeyColor ()
+        || (image->HasMipmaps () != 0)
+        || (image->GetRawFormat () && (*image->GetRawFormat () == '*'))
+        || ((image->GetWidth () < minSize) && (image->GetHeight () < minSize)))
+      return result;
+    csRef<iAnimatedImage> anim (scfQueryInterface<iAnimatedImage> (image));
+    if (anim.IsValid () && anim->IsAnimated ()) return result;
+
+    /* Like csGLTextureHandle::CreateMipMaps(): each level is computed from
+     * the unprocessed previous level, then post-processed. */
+    const MipSettings& settings = GetMipSettings (texClass);
+    csRef<csImageMemory> mipmapped;
+    mipmapped.AttachNew (new csImageMemory (image));
+    csRef<iImage> mip (image);
+    uint n = 0;
+    while ((mip->GetWidth () > 1) || (mip->GetHeight () > 1))
+    {
+      mip = csImageManipulate::Mipmap (mip, 1, 0, settings.mipmapFlags);
+      csRef<iImage> processed (mip);
+      if (settings.sharpen)
+        processed = csImageManipulate::Sharpen (processed, settings.sharpen);
+      if (settings.renormalize)
+        processed = csImageManipulate::RenormalizeNormals (processed);
+      mipmapped->SetMipmap (++n, processed);
+    }
+    result = mipmapped;
+
+    csRef<iDataBuffer> data (parent->ImageLoader->Save (mipmapped,
+      "image/dds", saveOptions));
+    if (data.IsValid ())
+    {
+      {
+        CS::Threading::MutexScopedLock lock (cacheLock);
+        if (cache->CacheData (data->GetData (), data->GetSize (), cacheType,
+            key, cacheVersion))
+          CS::Threading::AtomicOperations::Increment (&stores);
+      }
+      /* The saver may have compressed the image, so return the stored data
+         to get the same image as later runs loading it from the cache. */
+      csRef<iImage> stored (parent->ImageLoader->Load (data, format));
+      if (stored.IsValid ()) result = stored;
+    }
+    return result;
+  }
+
+  void TextureCache::ReportStatistics ()
+  {
+    if (!cache) return;
+    const int32 numHits = CS::Threading::AtomicOperations::Read (&hits);
+    const int32 numMisses = CS::Threading::AtomicOperations::Read (&misses);
+    if (numHits + numMisses == 0) return;
+    csReport (parent->object_reg, CS_REPORTER_SEVERITY_NOTIFY,
+      "crystalspace.level.threadedloader.texturecache",
+      "Texture cache: %d hits, %d misses, %d entries stored",
+      numHits, numMisses, CS::Threading::AtomicOperations::Read (&stores));
+  }
+}
+CS_PLUGIN_NAMESPACE_END(csparser)
@@ -0,0 +1,110 @@
+/*
+  Copyright (C) 2012 by Crystal Space Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef __CS_TEXTURECACHE_H__
+#define __CS_TEXTURECACHE_H__
+
+#include "csutil/csstring.h"
+#include "csutil/hash.h"
+#include "csutil/threading/mutex.h"
+#include "iutil/cache.h"
+
+struct iDataBuffer;
+struct iImage;
+
+CS_PLUGIN_NAMESPACE_BEGIN(csparser)
+{
+  class csThreadedLoader;
+
+  /**
+   * On-disk cache of decoded images, together with their mipmaps.
+   * Entries are keyed by a hash of the source file data, the requested
+   * image format and the mipmap settings of the texture class. They are
+   * stored as DDS files, so on a hit the image loader only has to parse a
+   * header and the texture manager can upload the data and the precomputed
+   * mipmaps as they are.
+   */
+  class TextureCache
+  {
+    /**
+     * How the OpenGL texture manager would generate the mipmaps of a
+     * texture class, as far as the cached mipmaps are concerned.
+     */
+    struct MipSettings
+    {
+      /// Sharpening strength applied to generated mipmaps, 0 for none
+      int sharpen;
+      /// Whether generated mipmaps are renormalized
+      bool renormalize;
+      /// Flags for csImageManipulate::Mipmap()
+      uint mipmapFlags;
+    };
+    struct ClassSettings;
+
+    csThreadedLoader* parent;
+    csRef<iCacheManager> cache;
+    /// Mipmap settings of the texture classes, read on initialization
+    csHash<MipSettings, csString> classSettings;
+    MipSettings defaultSettings;
+    /// Options for the DDS saver
+    csString saveOptions;
+    /// Images smaller than this in both dimensions are not cached
+    int minSize;
+    /// Serializes accesses to the cache manager
+    CS::Threading::Mutex cacheLock;
+
+    int32 hits;
+    int32 misses;
+    int32 stores;
+
+    /// Settings for a texture class; unknown classes use the defaults
+    const MipSettings& GetMipSettings (const char* texClass) const;
+  public:
+    TextureCache (csThreadedLoader* parent);
+
+    /// Set up the cache, if enabled in the configuration
+    void Initialize ();
+    bool IsEnabled () const { return cache.IsValid (); }
+    /**
+     * Whether images loaded from some source data in some format can be
+     * cached at all. Cheap; check before GetKey() and Load().
+     */
+    bool IsCacheable (iDataBuffer* source, int format) const;
+
+    /**
+     * Compute the key of the entry for some source data and image format,
+     * used for a texture of class \a texClass.
+     */
+    csString GetKey (iDataBuffer* source, int format, const char* texClass);
+    /// Look up the image for a key. Returns 0 on a miss.
+    csPtr<iImage> Load (const char* key, int format);
+    /**
+     * Compute the mipmaps for an image and store them in the cache.
+     * Returns the image as stored, like Load() returns it on later runs, or
+     * \a image if it is not suitable for caching.
+     */
+    csRef<iImage> Store (const char* key, iImage* image, int format,
+      const char* texClass);
+
+    /// Report the number of hits and misses
+    void ReportStatistics ();
+  };
+}
+CS_PLUGIN_NAMESPACE_END(csparser)
+
+#endif // __CS_TEXTURECACHE_H__
@@ -57,11 +57,13 @@
 #include "iutil/object.h"
 #include "ivaria/reporter.h"
 #include "ivaria/bugplug.h"
+#include "ivaria/profile.h"
 #include "dynavis.h"
 #include "wqueue.h"
 #include "exvis.h"
 
-
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(csDynaVis_VisTest);
 
 SCF_IMPLEMENT_FACTORY (csDynaVis)
 
@@ -1762,6 +1764,8 @@ bool csDynaVis::VisTest (iRenderView* rview,
 			 iVisibilityCullerListener* viscallback, 
 			 int renderW, int renderH)
 {
+  CS_PROFILER_ZONE(csDynaVis_VisTest);
+
   // We update the objects before testing the callback so that
   // we can use this VisTest() call to make sure the objects in the
   // culler are precached.
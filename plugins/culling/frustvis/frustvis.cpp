@@ -47,10 +47,12 @@
 #include "iengine/mesh.h"
 #include "imesh/object.h"
 #include "iutil/object.h"
+#include "ivaria/profile.h"
 #include "ivaria/reporter.h"
 #include "frustvis.h"
 
-
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(csFrustumVis_VisTest);
 
 SCF_IMPLEMENT_FACTORY (csFrustumVis)
 
@@ -509,6 +511,8 @@ void csFrustumVis::FrustTest_Traverse (csKDTree* treenode,
 bool csFrustumVis::VisTest (iRenderView* rview, 
                             iVisibilityCullerListener* viscallback, int, int)
 {
+  CS_PROFILER_ZONE(csFrustumVis_VisTest);
+
   // We update the objects before testing the callback so that
   // we can use this VisTest() call to make sure the objects in the
   // culler are precached.
@@ -522,7 +522,7 @@ csEngine::csEngine (iBase *iParent) :
   nextframePending (0), currentFrameNumber (0), 
   currentRenderContext (0), weakEventHandler(0),
   bAdaptiveLODsEnabled(false), adaptiveLODsTargetFPS(30.f), adaptiveLODsMultiplier(1.0f),
-  defaultNearClip (DEFAULT_NEAR_CLIP)
+  defaultNearClip (DEFAULT_NEAR_CLIP), deferMovableUpdates (false)
 {
   RegisterDefaultRenderPriorities ();
 }
@@ -1203,6 +1203,7 @@ void csEngine::Draw (iCamera *c, iClipper2D *view, iMeshWrapper* mesh)
 
   currentFrameNumber++;
   c->SetViewportSize (frameWidth, frameHeight);
+  FlushMovableUpdates ();
   ControlMeshes ();
   csRef<CS::RenderManager::RenderView> rview;
   rview.AttachNew (new (rviewPool) CS::RenderManager::RenderView (c, view,
@@ -1462,6 +1463,44 @@ iLight *csEngine::FindLight (const char *name, bool regionOnly) const
   return 0;
 }
 
+void csEngine::SetDeferredMovableUpdates (bool enable)
+{
+  // Don't leave anything in the queue when switching back
+  if (!enable) FlushMovableUpdates ();
+  deferMovableUpdates = enable;
+}
+
+void csEngine::FlushMovableUpdates ()
+{
+  /* Listeners may move other objects. Those are handled in another round,
+     but give up at some point in case listeners keep moving each other. */
+  for (int round = 0; (round < 4) && (queuedMovables.GetSize () > 0); round++)
+  {
+    /* Only the topmost queued movables are updated directly, as updating
+       a movable also updates all its children. */
+    csDirtyAccessArray<csMovable*> roots;
+    for (size_t i = 0; i < queuedMovables.GetSize (); i++)
+    {
+      csMovable* movable = queuedMovables[i];
+      csMovable* parent = movable->GetParent ();
+      while (parent && !parent->IsUpdateQueued ())
+        parent = parent->GetParent ();
+      if (!parent) roots.Push (movable);
+    }
+    queuedMovables.Empty ();
+
+    for (size_t i = 0; i < roots.GetSize (); i++)
+      roots[i]->PrepareDeferredUpdate (pendingMovables);
+    /* Listeners may destroy movables still pending; those are cleared from
+       the list by RemoveQueuedMovable(). */
+    for (size_t i = 0; i < pendingMovables.GetSize (); i++)
+    {
+      if (pendingMovables[i]) pendingMovables[i]->FinishDeferredUpdate ();
+    }
+    pendingMovables.Empty ();
+  }
+}
+
 void csEngine::ControlMeshes ()
 {
   nextframePending = virtualClock->GetCurrentTicks ();
@@ -1635,6 +1674,9 @@ void csEngine::ReadConfig (iConfigFile *Config)
 
   defaultNearClip = csMax (Config->GetFloat ("Engine.CameraDefault.NearClip", DEFAULT_NEAR_CLIP),
 			   SMALL_Z);
+
+  SetDeferredMovableUpdates (
+    Config->GetBool ("Engine.DeferredMovableUpdates", false));
 }
 
 struct LightAndDist
@@ -71,6 +71,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Engine)
 {
   class csLight;
   class csMeshWrapper;
+  class csMovable;
 }
 CS_PLUGIN_NAMESPACE_END(Engine)
 
@@ -494,6 +495,24 @@ public:
   virtual void SetDefaultNearClipDistance (float dist)
   { defaultNearClip = csMax (dist, float (SMALL_Z)); }
 
+  //-- Movable updates
+
+  virtual void SetDeferredMovableUpdates (bool enable);
+  virtual bool GetDeferredMovableUpdates () const
+  { return deferMovableUpdates; }
+  virtual void FlushMovableUpdates ();
+
+  /// Queue a movable for the next FlushMovableUpdates().
+  void QueueMovableUpdate (csMovable* movable)
+  { queuedMovables.Push (movable); }
+  /// Remove a movable that is destroyed from the update queue.
+  void RemoveQueuedMovable (csMovable* movable)
+  {
+    queuedMovables.Delete (movable);
+    size_t pending = pendingMovables.Find (movable);
+    if (pending != csArrayItemNotFound) pendingMovables[pending] = 0;
+  }
+
   //-- Portal handling
   
   virtual csPtr<iMeshWrapper> CreatePortal (
@@ -553,6 +572,7 @@ public:
   virtual void UpdateNewFrame ()
   { 
     currentFrameNumber++; 
+    FlushMovableUpdates ();
     envTexHolder.NextFrame ();
     ControlMeshes ();
   }
@@ -1085,6 +1105,13 @@ private:
 
   /// Default camera near clipping distance
   float defaultNearClip;
+
+  /// Whether movable updates are deferred to FlushMovableUpdates()
+  bool deferMovableUpdates;
+  /// Movables with deferred updates
+  csArray<csMovable*> queuedMovables;
+  /// Movables updated by FlushMovableUpdates() but not notified yet
+  csArray<csMovable*> pendingMovables;
 };
 
 #include "csutil/deprecated_warn_on.h"
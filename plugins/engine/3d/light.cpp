@@ -52,6 +52,7 @@ csLight::csLight (csEngine* engine,
 {
   //movable.scfParent = (iBase*)(csObject*)this; //@@MS: Look at this?
   movable.SetLight (this);
+  movable.SetEngine (engine);
   
   // Call setters explicitly since they also set SVs
   csLight::SetCenter (csVector3 (x,y,z));
@@ -54,6 +54,7 @@ csMeshWrapper::csMeshWrapper (csEngine* engine, iMeshObject *meshobj)
 //  movable.scfParent = this; //@TODO: CHECK THIS
   wor_bbox_movablenr = -1;
   movable.SetMeshWrapper (this);
+  movable.SetEngine (engine);
 
   render_priority = engine->GetObjectRenderPriority ();
 
@@ -100,13 +100,17 @@ iSector *csMovableSectorList::FindByName (const char *Name) const
 
 csMovable::csMovable ()
   : scfImplementationType (this), is_identity (true), parent (0),
-    meshobject (0), lightobject (0), cameraobject (0), updatenr (0)
+    meshobject (0), lightobject (0), cameraobject (0), updatenr (0),
+    engine (0), updateQueued (false), updatePending (false)
 {
   sectors.SetMovable (this);
 }
 
 csMovable::~csMovable ()
 {
+  if (updateQueued || updatePending)
+    engine->RemoveQueuedMovable (this);
+
   size_t i = listeners.GetSize ();
   while (i > 0)
   {
@@ -180,6 +184,21 @@ void csMovable::RemoveListener (iMovableListener *listener)
 }
 
 void csMovable::UpdateMove ()
+{
+  if (engine && engine->GetDeferredMovableUpdates ())
+  {
+    if (!updateQueued)
+    {
+      updateQueued = true;
+      engine->QueueMovableUpdate (this);
+    }
+    return;
+  }
+
+  UpdateMoveNow ();
+}
+
+void csMovable::UpdateMoveNow ()
 {
   updatenr++;
   is_identity = obj.IsIdentity ();
@@ -200,6 +219,35 @@ void csMovable::UpdateMove ()
   }
 }
 
+void csMovable::PrepareDeferredUpdate (csArray<csMovable*>& updated)
+{
+  updatenr++;
+  is_identity = obj.IsIdentity ();
+  // Children queued themselves are covered by this update
+  updateQueued = false;
+  updatePending = true;
+  updated.Push (this);
+
+  for (size_t i = 0 ; i < scene_children.GetSize () ; i++)
+    static_cast<csMovable*> (scene_children[i]->GetMovable ())
+      ->PrepareDeferredUpdate (updated);
+}
+
+void csMovable::FinishDeferredUpdate ()
+{
+  updatePending = false;
+  if (meshobject) meshobject->UpdateMove ();
+  if (lightobject) lightobject->OnSetPosition ();
+
+  size_t i = listeners.GetSize ();
+  while (i > 0)
+  {
+    i--;
+    iMovableListener *ml = listeners[i];
+    ml->MovableChanged (this);
+  }
+}
+
 iSceneNode* csMovable::GetSceneNode ()
 {
   if (meshobject)
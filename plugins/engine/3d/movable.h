@@ -30,6 +30,7 @@
 
 class csVector3;
 class csMatrix3;
+class csEngine;
 
 CS_PLUGIN_NAMESPACE_BEGIN(Engine)
 {
@@ -113,6 +114,16 @@ private:
   /// Update number.
   long updatenr;
 
+  /// Engine, if updates of this movable can be deferred.
+  csEngine* engine;
+
+  /// Whether this movable is queued for a deferred update.
+  bool updateQueued;
+  /// Whether a deferred update was prepared but not finished yet.
+  bool updatePending;
+
+  void UpdateMoveNow ();
+
 public:
   /**
    * Create a default movable.
@@ -134,6 +145,12 @@ public:
     return meshobject;
   }
 
+  /// Set the engine, allowing updates of this movable to be deferred.
+  void SetEngine (csEngine* engine)
+  {
+    this->engine = engine;
+  }
+
   csRefArray<iSceneNode>& GetChildren () { return scene_children; }
   const csRefArray<iSceneNode>& GetChildren () const { return scene_children; }
 
@@ -299,6 +316,21 @@ public:
    */
   void UpdateMove ();
 
+  /// Whether this movable is queued for a deferred update.
+  bool IsUpdateQueued () const { return updateQueued; }
+
+  /**
+   * First part of a deferred update: update the state of this movable and
+   * its children and append them to \a updated in hierarchy order.
+   */
+  void PrepareDeferredUpdate (csArray<csMovable*>& updated);
+
+  /**
+   * Second part of a deferred update: notify the object and the listeners.
+   * Must be called from the main thread.
+   */
+  void FinishDeferredUpdate ();
+
   /**
    * Add a listener to this movable. This listener will be called whenever
    * the movable changes or right before the movable is destroyed.
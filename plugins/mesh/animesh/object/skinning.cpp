@@ -22,12 +22,16 @@
 #include "csgfx/vertexlistwalker.h"
 #include "imesh/skeleton2.h"
 #include "imesh/animnode/skeleton2anim.h"
+#include "ivaria/profile.h"
 
 #include "animesh.h"
 
 
 CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
 {
+  CS_DECLARE_PROFILER
+  CS_DECLARE_PROFILER_ZONE(AnimeshObject_Skin);
+
   typedef csVertexListWalker<float, csVector3> MorphTargetOffsetsWalker;
   
 #include "csutil/custom_new_disable.h"
@@ -105,6 +109,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Animesh)
     if (!skeleton)
       return;
 
+    CS_PROFILER_ZONE(AnimeshObject_Skin);
+
     CS_ASSERT (SkinV ?
 	       skinnedVertices->GetElementCount () >= factory->vertexCount : true);
     CS_ASSERT (SkinN ?
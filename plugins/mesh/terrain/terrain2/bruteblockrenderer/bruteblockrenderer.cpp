@@ -29,6 +29,8 @@
 #include "cstool/rviewclipper.h" 
 #include "csutil/objreg.h"
 #include "ivideo/txtmgr.h"
+#include "iutil/verbositymanager.h"
+#include "ivaria/reporter.h"
 
 #include "cellrdata.h"
 
@@ -86,7 +88,8 @@ static TerrainCellBorderMatch MatchCell (iTerrainCell* cell1, iTerrainCell* cell
 
 //-- THE TERRAIN RENDERER ITSELF
 csTerrainBruteBlockRenderer::csTerrainBruteBlockRenderer (iBase* parent)
-  : scfImplementationType (this, parent), engine (nullptr), materialPalette (0)
+  : scfImplementationType (this, parent), engine (nullptr), materialPalette (0),
+  pooledBufferCount (0), statsFrame (~0), doVerbose (false)
 {  
 }
 
@@ -118,6 +121,23 @@ csRenderMesh** csTerrainBruteBlockRenderer::GetRenderMeshes (int& n,
 {
   renderMeshCache.Empty ();
 
+  const uint currentFrame = rview->GetCurrentFrameNumber ();
+  if (currentFrame != statsFrame)
+  {
+    if (doVerbose && (frameStats.blocksRebuilt || frameStats.bytesAllocated))
+    {
+      csReport (objectRegistry, CS_REPORTER_SEVERITY_NOTIFY,
+        "crystalspace.mesh.bruteblock",
+        "Frame %u: %u blocks rebuilt, %u reused, %u buffers reused, "
+        "%zu bytes allocated", statsFrame, frameStats.blocksRebuilt,
+        frameStats.blocksReused, frameStats.buffersReused,
+        frameStats.bytesAllocated);
+    }
+    lastFrameStats = frameStats;
+    frameStats.Reset ();
+    statsFrame = currentFrame;
+  }
+
   // Setup camera properties and clip planes
   const csReversibleTransform& trO2W = movable->GetFullTransform ();
   
@@ -166,6 +186,7 @@ csRenderMesh** csTerrainBruteBlockRenderer::GetRenderMeshes (int& n,
 
     renderData->rootBlock->CullRenderMeshes (rview, planes, frustum_mask, trO2C, 
       movable, renderMeshCache);
+    renderData->TrimGeometryCache (currentFrame);
   }
 
   n = (int)renderMeshCache.GetSize ();
@@ -375,13 +396,16 @@ void csTerrainBruteBlockRenderer::OnAlphaMapUpdate (iTerrainCell* cell,
 void csTerrainBruteBlockRenderer::OnHeightUpdate (iTerrainCell* cell, 
                                                   const csRect& rectangle)
 {
-  // Invalidate all data, recursively
-  // @@TODO: Make this smarter!
+  /* Invalidate all blocks, recursively. Only cached geometry touching the
+   * changed rectangle is dropped, the other blocks pick up their old data
+   * again. */
   csRef<TerrainCellRData> data = (TerrainCellRData*)cell->GetRenderData ();
 
-  if (data && data->rootBlock)
+  if (data)
   {
-    data->rootBlock->InvalidateGeometry (true);
+    data->InvalidateGeometryCache (rectangle);
+    if (data->rootBlock)
+      data->rootBlock->InvalidateGeometry (true);
   }
 }
 
@@ -404,6 +428,7 @@ void csTerrainBruteBlockRenderer::OnCellUnload (iTerrainCell* cell)
   {
     activeCellList.Delete (data);
     data->DisconnectCell ();
+    data->EmptyGeometryCache ();
   }
 
   // Clean out any renderer data in cell
@@ -453,9 +478,41 @@ bool csTerrainBruteBlockRenderer::Initialize (iObjectRegistry* objectReg)
 
   textureLodDistanceID = stringSet->Request ("texture lod distance");
 
+  csRef<iVerbosityManager> verbosity = csQueryRegistry<iVerbosityManager> (
+    objectReg);
+  doVerbose = verbosity && verbosity->Enabled ("terrain2.bruteblock");
+
   return true;
 }
 
+csRef<iRenderBuffer> csTerrainBruteBlockRenderer::GetPooledBuffer (
+  size_t numElements)
+{
+  csRefArray<iRenderBuffer>* pool = bufferPool.GetElementPointer (numElements);
+  if (pool && !pool->IsEmpty ())
+  {
+    frameStats.buffersReused++;
+    pooledBufferCount--;
+    return pool->Pop ();
+  }
+
+  frameStats.bytesAllocated += numElements * 3 * sizeof (float);
+  return csRenderBuffer::CreateRenderBuffer (numElements, CS_BUF_STATIC,
+    CS_BUFCOMP_FLOAT, 3);
+}
+
+void csTerrainBruteBlockRenderer::RecycleBuffer (iRenderBuffer* buffer)
+{
+  // Don't let the pool grow without bounds when large areas get unloaded
+  static const size_t maxPooledBuffers = 1024;
+
+  if (!buffer || pooledBufferCount >= maxPooledBuffers)
+    return;
+
+  bufferPool.GetOrCreate (buffer->GetElementCount ()).Push (buffer);
+  pooledBufferCount++;
+}
+
 template<typename T>
 static void FillEdge (bool halfres, int res, T* indices, int &indexcount,
                       int offs, int xadd, int zadd)
@@ -22,6 +22,8 @@
 
 #include "cstool/rendermeshholder.h"
 #include "csutil/dirtyaccessarray.h"
+#include "csutil/hash.h"
+#include "csutil/refarr.h"
 #include "csutil/scf_implementation.h"
 #include "imesh/terrain2.h"
 #include "iutil/comp.h"
@@ -111,6 +113,44 @@ public:
 
   // Allocate the material palette related data in cell
   void SetupCellMMArrays (iTerrainCell* cell);
+
+  // Get a 3-component float buffer, reusing a pooled one if possible
+  csRef<iRenderBuffer> GetPooledBuffer (size_t numElements);
+
+  // Give a buffer no longer referenced by any block back to the pool
+  void RecycleBuffer (iRenderBuffer* buffer);
+
+  // Geometry statistics, collected over a single frame
+  struct FrameStatistics
+  {
+    // Number of blocks whose vertex data was computed
+    uint blocksRebuilt;
+    // Number of blocks which picked up cached vertex data
+    uint blocksReused;
+    // Number of render buffers taken from the pool instead of allocated
+    uint buffersReused;
+    // Number of bytes allocated for new render buffers
+    size_t bytesAllocated;
+
+    FrameStatistics () { Reset (); }
+    void Reset ()
+    {
+      blocksRebuilt = blocksReused = buffersReused = 0;
+      bytesAllocated = 0;
+    }
+  };
+
+  // Statistics for the frame currently being set up
+  inline FrameStatistics& GetFrameStatistics ()
+  {
+    return frameStats;
+  }
+
+  // Statistics of the last completed frame
+  inline const FrameStatistics& GetLastFrameStatistics () const
+  {
+    return lastFrameStats;
+  }
   
 private:
   // Holder for render meshes while rendering
@@ -133,6 +173,14 @@ private:
   csRefArray<IndexBufferSet> indexBufferList;
 
   csRefArray<TerrainCellRData> activeCellList;
+
+  // Unused vertex buffers, keyed by element count
+  csHash<csRefArray<iRenderBuffer>, size_t> bufferPool;
+  size_t pooledBufferCount;
+
+  FrameStatistics frameStats, lastFrameStats;
+  uint statsFrame;
+  bool doVerbose;
 };
 
 }
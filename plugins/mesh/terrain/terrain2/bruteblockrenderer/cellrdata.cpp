@@ -19,6 +19,7 @@
 
 #include "cssysdef.h"
 
+#include "bruteblockrenderer.h"
 #include "cellrdata.h"
 #include "overlaidsvc.h"
 
@@ -124,5 +125,100 @@ void TerrainCellRData::DisconnectCell ()
   terrainBlockAllocator.Empty ();
 }
 
+TerrainCellRData::BlockGeometry* TerrainCellRData::GetCachedGeometry (
+  const TerrainBlock* block)
+{
+  return geometryCache.GetElementPointer (GetGeometryKey (block));
+}
+
+TerrainCellRData::BlockGeometry& TerrainCellRData::GetCachedGeometryAdd (
+  const TerrainBlock* block)
+{
+  return geometryCache.GetOrCreate (GetGeometryKey (block));
+}
+
+static void RecycleGeometry (csTerrainBruteBlockRenderer* renderer,
+                             TerrainCellRData::BlockGeometry& geom)
+{
+  // Only buffers that no block holds on to anymore can be handed out again
+  csRef<iRenderBuffer>* buffers[] = { &geom.vertices, &geom.normals,
+    &geom.texCoords, &geom.tangents, &geom.bitangents };
+
+  for (size_t i = 0; i < sizeof (buffers) / sizeof (buffers[0]); ++i)
+  {
+    csRef<iRenderBuffer>& buffer = *buffers[i];
+    if (buffer && buffer->GetRefCount () == 1)
+      renderer->RecycleBuffer (buffer);
+    buffer.Invalidate ();
+  }
+}
+
+void TerrainCellRData::InvalidateGeometryCache (const csRect& gridRect)
+{
+  csHash<BlockGeometry, uint64>::GlobalIterator it (
+    geometryCache.GetIterator ());
+
+  while (it.HasNext ())
+  {
+    uint64 key;
+    BlockGeometry& geom = it.Next (key);
+
+    const size_t left = size_t (key >> 40);
+    const size_t top = size_t ((key >> 16) & 0xffffff);
+    const size_t right = left + size_t (key & 0xffff) * blockResolution;
+    const size_t bottom = top + size_t (key & 0xffff) * blockResolution;
+
+    // Normals of border vertices depend on the adjacent grid points as well
+    if ((int)right + 1 < gridRect.xmin || (int)left > gridRect.xmax + 1 ||
+        (int)bottom + 1 < gridRect.ymin || (int)top > gridRect.ymax + 1)
+      continue;
+
+    RecycleGeometry (renderer, geom);
+    geometryCache.DeleteElement (it);
+  }
+}
+
+void TerrainCellRData::EmptyGeometryCache ()
+{
+  csHash<BlockGeometry, uint64>::GlobalIterator it (
+    geometryCache.GetIterator ());
+  while (it.HasNext ())
+    RecycleGeometry (renderer, it.Next ());
+
+  geometryCache.DeleteAll ();
+}
+
+void TerrainCellRData::TrimGeometryCache (uint currentFrame)
+{
+  const size_t maxEntries = properties->GetGeometryCacheSize ();
+  if (geometryCache.GetSize () <= maxEntries)
+    return;
+
+  // Find the frame age that has to go to get back below the limit
+  csArray<uint> ages;
+  {
+    csHash<BlockGeometry, uint64>::GlobalIterator it (
+      geometryCache.GetIterator ());
+    while (it.HasNext ())
+      ages.Push (currentFrame - it.Next ().lastUsedFrame);
+  }
+  ages.Sort ();
+  const uint minAge = ages[maxEntries];
+
+  csHash<BlockGeometry, uint64>::GlobalIterator it (
+    geometryCache.GetIterator ());
+  while (it.HasNext ())
+  {
+    BlockGeometry& geom = it.Next ();
+    // Never evict what was used this frame
+    const uint age = currentFrame - geom.lastUsedFrame;
+    if (age >= minAge && age > 0)
+    {
+      RecycleGeometry (renderer, geom);
+      geometryCache.DeleteElement (it);
+    }
+  }
+}
+
 }
 CS_PLUGIN_NAMESPACE_END(Terrain2)
@@ -20,6 +20,9 @@
 #ifndef __CELLRDATA_H__
 #define __CELLRDATA_H__
 
+#include "csgeom/csrect.h"
+#include "csutil/hash.h"
+
 #include "cellrenderproperties.h"
 #include "overlaidsvc.h"
 #include "svaccessor.h"
@@ -52,12 +55,48 @@ struct TerrainCellRData : public csRefCount
   // Disconnect cell from any neighbour cells
   void DisconnectCell ();
 
+  // Per block vertex data, kept around after blocks are merged away
+  struct BlockGeometry
+  {
+    csRef<iRenderBuffer> vertices, normals, texCoords;
+    csRef<iRenderBuffer> tangents, bitangents;
+    csBox3 boundingBox;
+    uint lastUsedFrame;
+
+    BlockGeometry () : lastUsedFrame (0) {}
+  };
+
+  // Compute the geometry cache key for a block
+  static uint64 GetGeometryKey (const TerrainBlock* block)
+  {
+    return (uint64 (block->gridLeft) << 40) | (uint64 (block->gridTop) << 16)
+      | uint64 (block->stepSize);
+  }
+
+  // Get cached geometry for a block, 0 if none is cached
+  BlockGeometry* GetCachedGeometry (const TerrainBlock* block);
+
+  // Get cached geometry for a block, adding an empty entry if needed
+  BlockGeometry& GetCachedGeometryAdd (const TerrainBlock* block);
+
+  // Drop cached geometry of all blocks touching the given grid rectangle
+  void InvalidateGeometryCache (const csRect& gridRect);
+
+  // Drop all cached geometry, returning unreferenced buffers to the pool
+  void EmptyGeometryCache ();
+
+  // Evict least recently used entries if the cache grew too large
+  void TrimGeometryCache (uint currentFrame);
+
   //-- Data
   TerrainCellRData* neighbours[4];
 
   TerrainBlock* rootBlock;
   csBlockAllocator<TerrainBlock> terrainBlockAllocator;
 
+  // Cached vertex data per (position, step size) of a block
+  csHash<BlockGeometry, uint64> geometryCache;
+
   // Per cell base material sv context
   csRef<iShaderVariableContext> commonSVContext;
 
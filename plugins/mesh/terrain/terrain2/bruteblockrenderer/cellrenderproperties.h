@@ -39,8 +39,8 @@ class TerrainBBCellRenderProperties :
 public:
   TerrainBBCellRenderProperties (iEngine* engine)
     : scfImplementationType (this), visible (true), blockResolution (32), 
-    minSteps (1), splitDistanceCoeff (128), splatDistance (100),
-    engine (engine)
+    minSteps (1), splitDistanceCoeff (128), lodHysteresis (0.1f),
+    geometryCacheSize (256), splatDistance (100), engine (engine)
   {
   }
 
@@ -48,7 +48,10 @@ public:
     : scfImplementationType (this), 
     CS::Graphics::ShaderVariableContextImpl (other), visible (other.visible), 
     blockResolution (other.blockResolution), minSteps (other.minSteps), 
-    splitDistanceCoeff (other.splitDistanceCoeff), splatDistance (other.splatDistance),
+    splitDistanceCoeff (other.splitDistanceCoeff),
+    lodHysteresis (other.lodHysteresis),
+    geometryCacheSize (other.geometryCacheSize),
+    splatDistance (other.splatDistance),
     splatPrio (other.splatPrio), engine (other.engine)
   {
 
@@ -91,6 +94,24 @@ public:
     splitDistanceCoeff = value;
   }
 
+  float GetLODHysteresis () const
+  {
+    return lodHysteresis;
+  }
+  void SetLODHysteresis (float value)
+  {
+    lodHysteresis = value > 0 ? value : 0;
+  }
+
+  size_t GetGeometryCacheSize () const
+  {
+    return geometryCacheSize;
+  }
+  void SetGeometryCacheSize (int value)
+  {
+    geometryCacheSize = value > 0 ? value : 0;
+  }
+
   float GetSplatDistance () const 
   {
     return splatDistance;
@@ -120,6 +141,10 @@ public:
       SetMinSteps (atoi (value));
     else if (strcmp (name, "lod splitcoeff") == 0)
       SetLODSplitCoeff (CS::Utility::strtof (value));
+    else if (strcmp (name, "lod hysteresis") == 0)
+      SetLODHysteresis (CS::Utility::strtof (value));
+    else if (strcmp (name, "geometry cache size") == 0)
+      SetGeometryCacheSize (atoi (value));
     else if (strcmp (name, "splat distance") == 0)
       SetSplatDistance (CS::Utility::strtof (value));
     else if (strcmp (name, "splat render priority") == 0)
@@ -127,7 +152,7 @@ public:
 
   }
 
-  virtual size_t GetParameterCount() { return 6; }
+  virtual size_t GetParameterCount() { return 8; }
 
   virtual const char* GetParameterName (size_t index)
   {
@@ -139,6 +164,8 @@ public:
       case 3: return "lod splitcoeff";
       case 4: return "splat distance";
       case 5: return "splat render priority";
+      case 6: return "lod hysteresis";
+      case 7: return "geometry cache size";
       default: return 0;
     }
   }
@@ -168,6 +195,16 @@ public:
       snprintf (scratch, sizeof (scratch), "%f", splitDistanceCoeff);
       return scratch;
     }
+    else if (strcmp (name, "lod hysteresis") == 0)
+    {
+      snprintf (scratch, sizeof (scratch), "%f", lodHysteresis);
+      return scratch;
+    }
+    else if (strcmp (name, "geometry cache size") == 0)
+    {
+      snprintf (scratch, sizeof (scratch), "%u", (uint)geometryCacheSize);
+      return scratch;
+    }
     else if (strcmp (name, "splat distance") == 0)
     {
       snprintf (scratch, sizeof (scratch), "%f", splatDistance);
@@ -203,6 +240,12 @@ private:
   // Lod splitting coefficient
   float splitDistanceCoeff;
 
+  // Fraction of the split distance a block has to move beyond before merging
+  float lodHysteresis;
+
+  // Number of blocks whose vertex data is kept after merging
+  size_t geometryCacheSize;
+
   // Splatting end distance
   float splatDistance;
   
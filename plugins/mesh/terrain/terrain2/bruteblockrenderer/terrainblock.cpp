@@ -28,6 +28,7 @@
 #include "cstool/rbuflock.h"
 #include "cstool/rviewclipper.h"
 
+#include "bruteblockrenderer.h"
 #include "cellrdata.h"
 
 CS_PLUGIN_NAMESPACE_BEGIN(Terrain2)
@@ -68,30 +69,69 @@ TerrainBlock::~TerrainBlock ()
   if (bufferHolder) bufferHolder->SetAccessor (nullptr, 0);
 }
 
-void TerrainBlock::SetupGeometry ()
+void TerrainBlock::SetupBufferHolder ()
 {
+  bufferHolder.AttachNew (new csRenderBufferHolder);
+
+  bufferHolder->SetRenderBuffer (CS_BUFFER_POSITION, meshVertices);
+  bufferHolder->SetRenderBuffer (CS_BUFFER_NORMAL, meshNormals);
+  bufferHolder->SetRenderBuffer (CS_BUFFER_TEXCOORD0, meshTexCoords);
+
+  if (tangentsBitangentsValid)
+  {
+    bufferHolder->SetRenderBuffer (CS_BUFFER_TANGENT, meshTangents);
+    bufferHolder->SetRenderBuffer (CS_BUFFER_BINORMAL, meshBitangents);
+  }
+  else
+  {
+    csRef<iRenderBufferAccessor> accessor;
+    accessor.AttachNew (new BufferAccessor (this));
+    bufferHolder->SetAccessor (accessor, CS_BUFFER_TANGENT_MASK
+                                         | CS_BUFFER_BINORMAL_MASK);
+  }
+}
+
+void TerrainBlock::SetupGeometry (uint frameNumber)
+{
+  TerrainCellRData::BlockGeometry& geom = 
+    renderData->GetCachedGeometryAdd (this);
+  geom.lastUsedFrame = frameNumber;
+
   if (dataValid)
     return;
 
+  csTerrainBruteBlockRenderer::FrameStatistics& stats = 
+    renderData->renderer->GetFrameStatistics ();
+
+  if (geom.vertices)
+  {
+    // This block was set up before and merged away since, reuse its data
+    meshVertices = geom.vertices;
+    meshNormals = geom.normals;
+    meshTexCoords = geom.texCoords;
+    meshTangents = geom.tangents;
+    meshBitangents = geom.bitangents;
+    tangentsBitangentsValid = geom.tangents.IsValid ();
+    boundingBox = geom.boundingBox;
+
+    SetupBufferHolder ();
+
+    stats.blocksReused++;
+    dataValid = true;
+    return;
+  }
+
   size_t numVerts = (renderData->blockResolution) + 1;
 
   // Allocate the standard renderbuffers
-  meshVertices = csRenderBuffer::CreateRenderBuffer (numVerts*numVerts, 
-    CS_BUF_STATIC, CS_BUFCOMP_FLOAT, 3);
-  meshNormals = csRenderBuffer::CreateRenderBuffer (numVerts*numVerts,
-    CS_BUF_STATIC, CS_BUFCOMP_FLOAT, 3);
-  meshTexCoords = csRenderBuffer::CreateRenderBuffer (numVerts*numVerts,
-    CS_BUF_STATIC, CS_BUFCOMP_FLOAT, 3);
+  meshVertices = renderData->renderer->GetPooledBuffer (numVerts*numVerts);
+  meshNormals = renderData->renderer->GetPooledBuffer (numVerts*numVerts);
+  meshTexCoords = renderData->renderer->GetPooledBuffer (numVerts*numVerts);
 
-  bufferHolder.AttachNew (new csRenderBufferHolder);
-
-  bufferHolder->SetRenderBuffer (CS_BUFFER_POSITION, meshVertices);
-  bufferHolder->SetRenderBuffer (CS_BUFFER_NORMAL, meshNormals);
-  bufferHolder->SetRenderBuffer (CS_BUFFER_TEXCOORD0, meshTexCoords);
-  csRef<iRenderBufferAccessor> accessor;
-  accessor.AttachNew (new BufferAccessor (this));
-  bufferHolder->SetAccessor (accessor, CS_BUFFER_TANGENT_MASK
-				       | CS_BUFFER_BINORMAL_MASK);
+  tangentsBitangentsValid = false;
+  meshTangents.Invalidate ();
+  meshBitangents.Invalidate ();
+  SetupBufferHolder ();
 
   const csVector2& cellPosition = renderData->cell->GetPosition ();
   const csVector3& cellSize = renderData->cell->GetSize ();
@@ -178,6 +218,12 @@ void TerrainBlock::SetupGeometry ()
     }
   }
 
+  geom.vertices = meshVertices;
+  geom.normals = meshNormals;
+  geom.texCoords = meshTexCoords;
+  geom.boundingBox = boundingBox;
+
+  stats.blocksRebuilt++;
   dataValid = true;
 }
 
@@ -189,10 +235,8 @@ void TerrainBlock::SetupTangentsBitangents ()
   size_t numVerts = (renderData->blockResolution) + 1;
 
   // Allocate the standard renderbuffers
-  meshTangents = csRenderBuffer::CreateRenderBuffer (numVerts*numVerts, 
-    CS_BUF_STATIC, CS_BUFCOMP_FLOAT, 3);
-  meshBitangents = csRenderBuffer::CreateRenderBuffer (numVerts*numVerts,
-    CS_BUF_STATIC, CS_BUFCOMP_FLOAT, 3);
+  meshTangents = renderData->renderer->GetPooledBuffer (numVerts*numVerts);
+  meshBitangents = renderData->renderer->GetPooledBuffer (numVerts*numVerts);
 
   bufferHolder->SetRenderBuffer (CS_BUFFER_TANGENT, meshTangents);
   bufferHolder->SetRenderBuffer (CS_BUFFER_BINORMAL, meshBitangents);
@@ -223,6 +267,13 @@ void TerrainBlock::SetupTangentsBitangents ()
   }
 
 
+  TerrainCellRData::BlockGeometry* geom = renderData->GetCachedGeometry (this);
+  if (geom && geom->vertices == meshVertices)
+  {
+    geom->tangents = meshTangents;
+    geom->bitangents = meshBitangents;
+  }
+
   tangentsBitangentsValid = true;
 }
 
@@ -542,15 +593,22 @@ void TerrainBlock::ComputeLOD (const csReversibleTransform& transformO2C, const
   const float splitDist = size.x * renderData->properties->GetLODSplitCoeff () / (float)blockRes;
   const float targetDistSq = splitDist*splitDist;
 
-  if (camBox.SquaredOriginDist  () < targetDistSq &&
-    stepSize > renderData->properties->GetMinSteps ())
+  // Only merge once the camera moved away a bit further to avoid LOD thrash
+  const float mergeDist = splitDist * 
+    (1.0f + renderData->properties->GetLODHysteresis ());
+  const float mergeDistSq = mergeDist*mergeDist;
+
+  const float camDistSq = camBox.SquaredOriginDist ();
+  const bool canSplit = stepSize > renderData->properties->GetMinSteps ();
+
+  if (camDistSq < targetDistSq && canSplit)
   {
     if (IsLeaf ())
     {
       Split ();
     }
   }
-  else
+  else if (camDistSq >= mergeDistSq || !canSplit)
   {
     if (!IsLeaf ())
     {
@@ -588,7 +646,7 @@ void TerrainBlock::CullRenderMeshes (iRenderView* rview, const csPlane3* cullPla
     return;
   }
 
-  SetupGeometry ();
+  SetupGeometry (rview->GetCurrentFrameNumber ());
 
   const csVector3 worldOrigin = movable->GetFullTransform ().GetOrigin () + 
     csVector3 (centerPos.x, 0, centerPos.y);  
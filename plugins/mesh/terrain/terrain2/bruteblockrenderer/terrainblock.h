@@ -60,8 +60,9 @@ struct TerrainBlock
   TerrainBlock ();
   ~TerrainBlock ();
 
-  // Setup geometry
-  void SetupGeometry ();
+  // Setup geometry, reusing cached vertex data where possible
+  void SetupGeometry (uint frameNumber);
+  void SetupBufferHolder ();
   void SetupTangentsBitangents ();
 
   // Invalidate the geometry and make it recalculate it
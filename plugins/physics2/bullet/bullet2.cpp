@@ -21,11 +21,15 @@
 #include "imesh/animesh.h"
 #include "iengine/scenenode.h"
 #include "iengine/movable.h"
+#include "csgeom/math.h"
 #include "csgeom/sphere.h"
 #include "csgeom/tri.h"
 #include "imesh/genmesh.h"
 #include "imesh/object.h"
+#include "csutil/eventnames.h"
 #include "csutil/sysfunc.h"
+#include "csutil/threadjobqueue.h"
+#include "iutil/eventq.h"
 #include "iutil/objreg.h"
 #include "ivaria/view.h"
 #include "ivaria/collisions.h"
@@ -94,7 +98,8 @@ csBulletSector::csBulletSector (csBulletSystem* sys)
   hitPortal (NULL), debugDraw (NULL), softWorldInfo (NULL),
   linearDampening (0.0f), angularDampening (0.0f),
   linearDisableThreshold (0.8f), angularDisableThreshold (1.0f),
-  timeDisableThreshold (0.0f), worldTimeStep (1.0f / 60.0f), worldMaxSteps (1)
+  timeDisableThreshold (0.0f), worldTimeStep (1.0f / 60.0f), worldMaxSteps (1),
+  asyncStepping (false), asyncStepPending (false), asyncTimeAccumulator (0.0f)
 {
   configuration = new btDefaultCollisionConfiguration ();
   dispatcher = new btCollisionDispatcher (configuration);
@@ -153,6 +158,8 @@ csBulletSector::csBulletSector (csBulletSystem* sys)
 
 csBulletSector::~csBulletSector ()
 {
+  SetAsynchronousStepping (false);
+
   for (size_t i = 0; i < portals.GetSize (); i++)
   {
     bulletWorld->removeCollisionObject (portals[i]->ghostPortal);
@@ -177,6 +184,7 @@ csBulletSector::~csBulletSector ()
 
 void csBulletSector::SetGravity (const csVector3& v)
 {
+  WaitForStep ();
   gravity = v;
   btVector3 gravity = CSToBullet (v, sys->getInternalScale ());
   bulletWorld->setGravity (gravity);
@@ -187,6 +195,7 @@ void csBulletSector::SetGravity (const csVector3& v)
 
 void csBulletSector::AddCollisionObject (CS::Collisions::iCollisionObject* object)
 {
+  WaitForStep ();
   csBulletCollisionObject* obj (dynamic_cast<csBulletCollisionObject*>(object));
 
   if (obj->GetObjectType () == CS::Collisions::COLLISION_OBJECT_PHYSICAL)
@@ -210,6 +219,7 @@ void csBulletSector::AddCollisionObject (CS::Collisions::iCollisionObject* objec
 
 void csBulletSector::RemoveCollisionObject (CS::Collisions::iCollisionObject* object)
 {
+  WaitForStep ();
   csBulletCollisionObject* collObject = dynamic_cast<csBulletCollisionObject*> (object);
   if (!collObject)
     return;
@@ -749,6 +759,22 @@ void csBulletSector::SetStepParameters (float timeStep,
 }
 
 void csBulletSector::Step (float duration)
+{
+  if (asyncStepping)
+  {
+    StepAsynchronous (duration);
+    return;
+  }
+
+  PrepareStep ();
+
+  // Step the simulation
+  bulletWorld->stepSimulation (duration, (int)worldMaxSteps, worldTimeStep);
+
+  FinishStep ();
+}
+
+void csBulletSector::PrepareStep ()
 {
   // Update the soft body anchors
   for (csWeakRefArray<csBulletSoftBody>::Iterator it = anchoredSoftBodies.GetIterator (); it.HasNext (); )
@@ -759,10 +785,10 @@ void csBulletSector::Step (float duration)
 
   // Update the state of collision collide with portals.
   UpdateCollisionPortals ();
+}
 
-  // Step the simulation
-  bulletWorld->stepSimulation (duration, (int)worldMaxSteps, worldTimeStep);
-
+void csBulletSector::FinishStep ()
+{
   // Send the collision response of copies to source object.
   for (size_t i = 0; i < collisionObjects.GetSize (); i++)
     if (collisionObjects[i]->objectOrigin)
@@ -776,6 +802,120 @@ void csBulletSector::Step (float duration)
   CheckCollisions();
 }
 
+void csBulletSector::StepAsynchronous (float duration)
+{
+  // Normally already done at the end of the last frame
+  WaitForStep ();
+
+  PrepareStep ();
+
+  // The kinematic callbacks can't be called from the simulation thread
+  for (size_t i = 0; i < rigidBodies.GetSize (); i++)
+  {
+    csBulletRigidBody* body = rigidBodies[i];
+    if (body->physicalState == CS::Physics::STATE_KINEMATIC && body->motionState)
+      static_cast<csBulletKinematicMotionState*> (body->motionState)
+        ->UpdateCachedTransform ();
+  }
+
+  // Simulate the elapsed time in fixed steps, the remainder is left for the
+  // next frame. Like stepSimulation(), drop the time that would need more
+  // than the maximum number of steps.
+  asyncTimeAccumulator += duration;
+  int numSteps = (int) (asyncTimeAccumulator / worldTimeStep);
+  asyncTimeAccumulator -= numSteps * worldTimeStep;
+  if (numSteps > (int) worldMaxSteps)
+    numSteps = (int) worldMaxSteps;
+
+  // Show the state in between the last two steps
+  float alpha = csClamp (asyncTimeAccumulator / worldTimeStep, 1.0f, 0.0f);
+  for (size_t i = 0; i < rigidBodies.GetSize (); i++)
+    if (rigidBodies[i]->motionState)
+      rigidBodies[i]->motionState->Interpolate (alpha);
+
+  if (numSteps > 0)
+  {
+    asyncJob->numSteps = numSteps;
+    asyncStepPending = true;
+    asyncQueue->Enqueue (asyncJob);
+  }
+}
+
+void csBulletSector::RunAsyncSteps (int numSteps)
+{
+  for (int i = 0; i < numSteps; i++)
+  {
+    // A single internal step of exactly worldTimeStep. Using the fixed step
+    // leaves no remaining time, so Bullet doesn't extrapolate the motion
+    // states; a maximum of 0 steps would instead make it step variably and
+    // extrapolate them a full step ahead.
+    bulletWorld->stepSimulation (worldTimeStep, 1, worldTimeStep);
+
+    for (size_t j = 0; j < rigidBodies.GetSize (); j++)
+      if (rigidBodies[j]->motionState)
+        rigidBodies[j]->motionState->PushStepTransform ();
+  }
+}
+
+void csBulletSector::WaitForStep ()
+{
+  if (!asyncStepPending)
+    return;
+
+  asyncQueue->PullAndRun (asyncJob);
+  asyncStepPending = false;
+
+  // Contacts and portal copies are processed in the main thread
+  FinishStep ();
+}
+
+void csBulletSector::SetAsynchronousStepping (bool enabled)
+{
+  if (isSoftWorld)
+    enabled = false;
+  if (enabled == asyncStepping)
+    return;
+
+  WaitForStep ();
+  asyncStepping = enabled;
+
+  csRef<iEventQueue> eventQueue = csQueryRegistry<iEventQueue> (sys->object_reg);
+  if (enabled)
+  {
+    if (!asyncQueue)
+    {
+      asyncQueue.AttachNew (new CS::Threading::ThreadedJobQueue (1,
+        CS::Threading::THREAD_PRIO_NORMAL, "bullet2 simulation"));
+      asyncJob.AttachNew (new csBulletAsyncStepJob (this));
+    }
+    asyncTimeAccumulator = 0.0f;
+    for (size_t i = 0; i < rigidBodies.GetSize (); i++)
+      if (rigidBodies[i]->motionState)
+        rigidBodies[i]->motionState->ResetStepTransforms ();
+
+    asyncFrameHandler.AttachNew (new csBulletAsyncFrameHandler (this));
+    if (eventQueue)
+      eventQueue->RegisterListener (asyncFrameHandler, csevFrame (sys->object_reg));
+  }
+  else
+  {
+    if (eventQueue && asyncFrameHandler)
+      eventQueue->RemoveListener (asyncFrameHandler);
+    asyncFrameHandler.Invalidate ();
+  }
+}
+
+void csBulletAsyncStepJob::Run ()
+{
+  sector->RunAsyncSteps (numSteps);
+}
+
+bool csBulletAsyncFrameHandler::HandleEvent (iEvent& event)
+{
+  sector->WaitForStep ();
+  return false;
+}
+
 void csBulletSector::SetLinearDampener (float d)
 {
   linearDampening = d;
@@ -796,6 +936,7 @@ void csBulletSector::SetAutoDisableParams (float linear, float angular,
 
 void csBulletSector::AddRigidBody (CS::Physics::iRigidBody* body)
 {
+  WaitForStep ();
   csRef<csBulletRigidBody> btBody (dynamic_cast<csBulletRigidBody*>(body));
   rigidBodies.Push (btBody);
 
@@ -812,6 +953,7 @@ void csBulletSector::AddRigidBody (CS::Physics::iRigidBody* body)
 
 void csBulletSector::RemoveRigidBody (CS::Physics::iRigidBody* body)
 {
+  WaitForStep ();
   csBulletRigidBody* btBody = dynamic_cast<csBulletRigidBody*> (body);
   CS_ASSERT (btBody);
 
@@ -835,6 +977,7 @@ CS::Physics::iRigidBody* csBulletSector::FindRigidBody (const char* name)
 
 void csBulletSector::AddSoftBody (CS::Physics::iSoftBody* body)
 {
+  WaitForStep ();
   csRef<csBulletSoftBody> btBody (dynamic_cast<csBulletSoftBody*>(body));
   softBodies.Push (btBody);
   btBody->sector = this;
@@ -860,6 +1003,7 @@ void csBulletSector::AddSoftBody (CS::Physics::iSoftBody* body)
 
 void csBulletSector::RemoveSoftBody (CS::Physics::iSoftBody* body)
 {
+  WaitForStep ();
   csBulletSoftBody* btBody = dynamic_cast<csBulletSoftBody*> (body);
   CS_ASSERT (btBody);
 
@@ -883,6 +1027,7 @@ CS::Physics::iSoftBody* csBulletSector::FindSoftBody (const char* name)
 
 void csBulletSector::AddJoint (CS::Physics::iJoint* joint)
 {
+  WaitForStep ();
   csBulletJoint* btJoint = dynamic_cast<csBulletJoint*> (joint);
   CS_ASSERT(btJoint);
   btJoint->sector = this;
@@ -892,6 +1037,7 @@ void csBulletSector::AddJoint (CS::Physics::iJoint* joint)
 
 void csBulletSector::RemoveJoint (CS::Physics::iJoint* joint)
 {
+  WaitForStep ();
   csBulletJoint* btJoint = dynamic_cast<csBulletJoint*> (joint);
   CS_ASSERT(btJoint);
 
@@ -914,6 +1060,10 @@ void csBulletSector::SetSoftBodyEnabled (bool enabled)
   if (enabled == isSoftWorld)
     return;
 
+  // Soft bodies are not supported by the asynchronous stepping
+  if (enabled)
+    SetAsynchronousStepping (false);
+
   isSoftWorld = enabled;
   // re-create configuration, dispatcher & dynamics world
   btVector3 gra = bulletWorld->getGravity ();
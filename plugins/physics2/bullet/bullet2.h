@@ -30,6 +30,9 @@
 #include "iengine/sector.h"
 #include "iengine/movable.h"
 #include "csutil/csobject.h"
+#include "csutil/eventhandlers.h"
+#include "iutil/eventh.h"
+#include "iutil/job.h"
 
 #include "BulletCollision/CollisionDispatch/btGhostObject.h"
 
@@ -71,6 +74,34 @@ struct CollisionPortal
   void AddObject (csRef<csBulletCollisionObject> object) {objects.Push (object);}
 };
 
+/// Job running the simulation steps of an asynchronous Step()
+class csBulletAsyncStepJob : public scfImplementation1<
+  csBulletAsyncStepJob, iJob>
+{
+  csBulletSector* sector;
+
+public:
+  int numSteps;
+
+  csBulletAsyncStepJob (csBulletSector* sector)
+    : scfImplementationType (this), sector (sector), numSteps (0) {}
+  virtual void Run ();
+};
+
+/// Finishes the asynchronous simulation at the end of each frame
+class csBulletAsyncFrameHandler : public scfImplementation1<
+  csBulletAsyncFrameHandler, iEventHandler>
+{
+  csBulletSector* sector;
+
+public:
+  csBulletAsyncFrameHandler (csBulletSector* sector)
+    : scfImplementationType (this), sector (sector) {}
+  virtual bool HandleEvent (iEvent& event);
+
+  CS_EVENTHANDLER_PHASE_FRAME ("crystalspace.physics.bullet2.asyncstep")
+};
+
 //Will also implement iPhysicalSector...
 class csBulletSector : public scfImplementationExt3<
   csBulletSector, csObject, CS::Collisions::iCollisionSector, 
@@ -127,6 +158,15 @@ class csBulletSector : public scfImplementationExt3<
   float worldTimeStep;
   size_t worldMaxSteps;
 
+  bool asyncStepping;
+  // Whether the simulation thread is running
+  bool asyncStepPending;
+  // Elapsed time not simulated yet
+  float asyncTimeAccumulator;
+  csRef<iJobQueue> asyncQueue;
+  csRef<csBulletAsyncStepJob> asyncJob;
+  csRef<csBulletAsyncFrameHandler> asyncFrameHandler;
+
   CollisionGroupVector collGroups;
   csRefArray<csBulletJoint> joints;
   csArray<CollisionPortal*> portals;
@@ -138,6 +178,9 @@ class csBulletSector : public scfImplementationExt3<
   csRef<iSector> sector;
 
   void CheckCollisions();
+  void PrepareStep ();
+  void FinishStep ();
+  void StepAsynchronous (float duration);
   void UpdateCollisionPortals ();
   void SetInformationToCopy (csBulletCollisionObject* obj, csBulletCollisionObject* cpy,
     const csOrthoTransform& warpTrans);
@@ -241,6 +284,13 @@ public:
 
   virtual void DumpProfile (bool resetProfile = true);
 
+  virtual void SetAsynchronousStepping (bool enabled);
+  virtual bool GetAsynchronousStepping () const {return asyncStepping;}
+  virtual void WaitForStep ();
+
+  /// Run simulation steps, called from the simulation thread.
+  void RunAsyncSteps (int numSteps);
+
   bool BulletCollide (btCollisionObject* objectA,
     btCollisionObject* objectB,
     csArray<CS::Collisions::CollisionData>& data);
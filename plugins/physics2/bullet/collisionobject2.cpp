@@ -61,6 +61,7 @@ void csBulletCollisionObject::SetObjectType (CS::Collisions::CollisionObjectType
 
 void csBulletCollisionObject::SetTransform (const csOrthoTransform& trans)
 {
+  WaitForStep ();
 
   //Lulu: I don't understand why remove the body from the world then set MotionState,
   //      then add it back to the world. 
@@ -49,6 +49,12 @@ protected:
   bool shapeChanged;
   bool isTerrain;
 
+  /**
+   * Wait for the asynchronous step of the sector, if any, before changing
+   * the Bullet object.
+   */
+  void WaitForStep () { if (sector) sector->WaitForStep (); }
+
 public:
   csBulletCollisionObject (csBulletSystem* sys);
   virtual ~csBulletCollisionObject ();
@@ -44,34 +44,39 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet2)
     if (body->btObject)
       body->btObject->setInterpolationWorldTransform (initialTransform);
 
-    csOrthoTransform tr = BulletToCS (initialTransform * inversePrincipalAxis,
-				      body->system->getInverseInternalScale ());
+    previousTransform = currentTransform = initialTransform;
+    UpdateAttachedObjects (initialTransform);
+  }
 
-    iMovable* movable = body->GetAttachedMovable ();
-    if (movable)
+  void csBulletMotionState::setWorldTransform (const btTransform& trans)
+  {
+    btDefaultMotionState::setWorldTransform (trans);
+
+    csBulletSector* sector = body->sector;
+    if (sector && sector->asyncStepping)
     {
-      // Update movable
-      movable->SetFullTransform (tr);
-      movable->UpdateMove ();
+      // The attached objects are interpolated from the main thread. If the
+      // simulation isn't running then the object was moved by hand.
+      if (!sector->asyncStepPending)
+        ResetStepTransforms ();
+      return;
     }
-    iCamera* camera = body->GetAttachedCamera ();
-    if (camera)
-    {
-      csOrthoTransform& cameraTrans = camera->GetTransform ();
-      if (cameraTrans.GetOrigin () == tr.GetOrigin () &&
-        cameraTrans.GetT2O () == tr.GetT2O ())
-        return;
 
-      // Update camera position
-      cameraTrans.SetOrigin (tr.GetOrigin ());
-      cameraTrans.SetT2O (tr.GetT2O ());
-    }
+    UpdateAttachedObjects (trans);
   }
 
-  void csBulletMotionState::setWorldTransform (const btTransform& trans)
+  void csBulletMotionState::Interpolate (float alpha)
   {
-    btDefaultMotionState::setWorldTransform (trans);
+    btTransform trans;
+    trans.setOrigin (previousTransform.getOrigin ().lerp (
+      currentTransform.getOrigin (), alpha));
+    trans.setRotation (previousTransform.getRotation ().slerp (
+      currentTransform.getRotation (), alpha));
+    UpdateAttachedObjects (trans);
+  }
 
+  void csBulletMotionState::UpdateAttachedObjects (const btTransform& trans)
+  {
     // update attached object
     /*if (!body->moveCb)
       return;*/
@@ -106,12 +111,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet2)
   (csBulletCollisionObject* body, const btTransform& initialTransform,
    const btTransform& principalAxis)
     : csBulletMotionState (body, initialTransform, principalAxis),
-      principalAxis (BulletToCS (principalAxis, body->system->getInverseInternalScale ()))
+      principalAxis (BulletToCS (principalAxis, body->system->getInverseInternalScale ())),
+      cachedTransform (initialTransform)
   {
   }
 
   void csBulletKinematicMotionState::getWorldTransform (btTransform& trans) const
   {
+    if (body->sector && body->sector->asyncStepping)
+    {
+      trans = cachedTransform;
+      return;
+    }
+
     csBulletRigidBody* rb = dynamic_cast<csBulletRigidBody*> (body);
     if (!rb || !rb->kinematicCb)
       return;
@@ -124,5 +136,16 @@ CS_PLUGIN_NAMESPACE_BEGIN(Bullet2)
     
   }
 
+  void csBulletKinematicMotionState::UpdateCachedTransform ()
+  {
+    csBulletRigidBody* rb = dynamic_cast<csBulletRigidBody*> (body);
+    if (!rb || !rb->kinematicCb)
+      return;
+
+    csOrthoTransform transform;
+    rb->kinematicCb->GetBodyTransform (rb, transform);
+    cachedTransform = CSToBullet (principalAxis * transform, body->system->getInternalScale ());
+  }
+
 }
 CS_PLUGIN_NAMESPACE_END(Bullet2)
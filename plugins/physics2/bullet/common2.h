@@ -227,6 +227,11 @@ public:
   csBulletCollisionObject* body;
   // we save the inverse of the principal axis for performance reasons
   btTransform inversePrincipalAxis;
+  // states of the last two simulation steps, for asynchronous stepping
+  btTransform previousTransform;
+  btTransform currentTransform;
+
+  void UpdateAttachedObjects (const btTransform& trans);
 
 public:
   csBulletMotionState (csBulletCollisionObject* body,
@@ -234,6 +239,22 @@ public:
 		       const btTransform& principalAxis);
 
   virtual void setWorldTransform (const btTransform& trans);
+
+  /// Remember the state of the last simulation step
+  void PushStepTransform ()
+  {
+    previousTransform = currentTransform;
+    currentTransform = m_graphicsWorldTrans;
+  }
+
+  /// Forget the older states, e.g. after the object has been moved by hand
+  void ResetStepTransforms ()
+  {
+    previousTransform = currentTransform = m_graphicsWorldTrans;
+  }
+
+  /// Move the attached objects between the last two simulation states
+  void Interpolate (float alpha);
 };
 
 
@@ -242,6 +263,8 @@ public:
 class csBulletKinematicMotionState : public csBulletMotionState
 {
   csOrthoTransform principalAxis;
+  // transform given by the kinematic callback, for asynchronous stepping
+  btTransform cachedTransform;
 
 public:
   csBulletKinematicMotionState (csBulletCollisionObject* body,
@@ -249,6 +272,12 @@ public:
 				const btTransform& principalAxis);
 
   virtual void getWorldTransform (btTransform& trans) const;
+
+  /**
+   * Query the kinematic callback. The callback is never invoked from the
+   * simulation thread, which uses the cached transform instead.
+   */
+  void UpdateCachedTransform ();
 };
 
 }
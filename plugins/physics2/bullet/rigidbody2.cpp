@@ -206,6 +206,8 @@ bool csBulletRigidBody::AddBulletObject ()
 
 bool csBulletRigidBody::Disable ()
 {
+ WaitForStep ();
+
  SetLinearVelocity (csVector3 (0.0f));
  SetAngularVelocity (csVector3 (0.0f));
  if (btBody)
@@ -219,6 +221,8 @@ bool csBulletRigidBody::Disable ()
 
 bool csBulletRigidBody::Enable ()
 {
+  WaitForStep ();
+
   if (btBody)
   {
     btObject->setActivationState (ACTIVE_TAG);
@@ -237,6 +241,8 @@ bool csBulletRigidBody::IsEnabled ()
 
 void csBulletRigidBody::SetMass (float mass)
 {
+  WaitForStep ();
+
   if (mass > SMALL_EPSILON)
     totalMass = mass;
 }
@@ -287,6 +293,8 @@ void csBulletRigidBody::SetElasticity (float elasticity)
 
 bool csBulletRigidBody::SetState (CS::Physics::RigidBodyState state)
 {
+  WaitForStep ();
+
   if (physicalState != state || !insideWorld)
   {
     CS::Physics::RigidBodyState previousState = physicalState;
@@ -391,6 +399,8 @@ bool csBulletRigidBody::SetState (CS::Physics::RigidBodyState state)
 
 void csBulletRigidBody::SetLinearVelocity (const csVector3& vel)
 {
+  WaitForStep ();
+
   linearVelocity = vel;
   if (!btBody)
     return;
@@ -412,6 +422,8 @@ csVector3 csBulletRigidBody::GetLinearVelocity (size_t index /* = 0 */) const
 
 void csBulletRigidBody::SetAngularVelocity (const csVector3& vel)
 {
+  WaitForStep ();
+
   angularVelocity = vel;
   if (!btBody)
     return; 
@@ -433,6 +445,8 @@ csVector3 csBulletRigidBody::GetAngularVelocity () const
 
 void csBulletRigidBody::AddForce (const csVector3& force)
 {
+  WaitForStep ();
+
   if (btBody)
   {
     btBody->applyImpulse (btVector3 (force.x * system->getInternalScale (),
@@ -445,6 +459,8 @@ void csBulletRigidBody::AddForce (const csVector3& force)
 
 void csBulletRigidBody::AddTorque (const csVector3& torque)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
 
@@ -456,6 +472,8 @@ void csBulletRigidBody::AddTorque (const csVector3& torque)
 
 void csBulletRigidBody::AddRelForce (const csVector3& force)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
 
@@ -470,6 +488,8 @@ void csBulletRigidBody::AddRelForce (const csVector3& force)
 
 void csBulletRigidBody::AddRelTorque (const csVector3& torque)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
   csOrthoTransform trans = csBulletCollisionObject::GetTransform ();
@@ -484,6 +504,8 @@ void csBulletRigidBody::AddRelTorque (const csVector3& torque)
 void csBulletRigidBody::AddForceAtPos (const csVector3& force,
     const csVector3& pos)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
 
@@ -502,6 +524,8 @@ void csBulletRigidBody::AddForceAtPos (const csVector3& force,
 void csBulletRigidBody::AddForceAtRelPos (const csVector3& force,
                                           const csVector3& pos)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
 
@@ -517,6 +541,8 @@ void csBulletRigidBody::AddForceAtRelPos (const csVector3& force,
 void csBulletRigidBody::AddRelForceAtPos (const csVector3& force,
                                           const csVector3& pos)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
 
@@ -535,6 +561,8 @@ void csBulletRigidBody::AddRelForceAtPos (const csVector3& force,
 void csBulletRigidBody::AddRelForceAtRelPos (const csVector3& force,
                                              const csVector3& pos)
 {
+  WaitForStep ();
+
   if (!btBody)
     return; 
 
@@ -574,6 +602,8 @@ csVector3 csBulletRigidBody::GetTorque () const
 
 void csBulletRigidBody::SetLinearDampener (float d)
 {
+  WaitForStep ();
+
   linearDampening = d;
 
   if (btBody)
@@ -582,6 +612,8 @@ void csBulletRigidBody::SetLinearDampener (float d)
 
 void csBulletRigidBody::SetRollingDampener (float d)
 {
+  WaitForStep ();
+
   angularDampening = d;
 
   if (btBody)
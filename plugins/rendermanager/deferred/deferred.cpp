@@ -433,11 +433,12 @@ bool RMDeferred::Initialize(iObjectRegistry *registry)
     return false;
   }
 
-  treePersistent.Initialize (shaderManager);
+  treePersistent.Initialize (registry, shaderManager);
   portalPersistent.Initialize (shaderManager, graphics3D, treePersistent.debugPersist);
   lightPersistent.shadowPersist.SetConfigPrefix ("RenderManager.Deferred");
   lightPersistent.Initialize (registry, treePersistent.debugPersist);
-  if(!lightRenderPersistent.Initialize (registry, lightPersistent.shadowPersist, doShadows, deferredFull))
+  if(!lightRenderPersistent.Initialize (registry, lightPersistent.shadowPersist,
+    treePersistent.debugPersist, doShadows, deferredFull))
   {
     return false;
   }
@@ -495,6 +496,7 @@ bool RMDeferred::RenderView(iView *view, bool recursePortals)
   rview->SetFrustum (l, r, t, b);
 
   contextsScannedForTargets.Empty ();
+  treePersistent.UpdateNewFrame ();
   portalPersistent.UpdateNewFrame ();
   lightPersistent.UpdateNewFrame ();
   lightRenderPersistent.UpdateNewFrame ();
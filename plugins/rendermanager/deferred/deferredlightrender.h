@@ -29,6 +29,10 @@
 #include "csgfx/normalmaptools.h"
 
 #include "csutil/cfgacc.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
+
+#include "csplugincommon/rendermanager/lighttiles.h"
 
 #include "igeom/trimesh.h"
 
@@ -222,7 +226,64 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
       csRef<csShaderVariable> shadowSpread;
       bool doShadows;
 
-      PersistentData() : scfImplementation1<PersistentData, iLightCallback>(this)
+      // tiled lighting - see DeferredLightRenderer::RenderTiledLights()
+      bool tiledLighting;
+      CS::RenderManager::LightTileCuller tileCuller;
+      csRef<iJobQueue> tileQueue;
+
+      // point light collected for tiled lighting
+      struct TiledLight
+      {
+	iLight* light;
+	csVector3 posView;
+	float radius;
+	// range of the light's quads in tileIndices
+	uint indexStart;
+	uint indexEnd;
+      };
+      csArray<TiledLight> tiledLights;
+
+      // geometry covering the tiles of each light
+      csDirtyAccessArray<csVector3> tileVertices;
+      csDirtyAccessArray<uint> tileIndices;
+      csRenderMesh tileMesh;
+
+      // debug flag for tiled lighting statistics
+      CS::RenderManager::RenderTreeBase::DebugPersistent* dbgPersist;
+      uint dbgTileStats;
+
+      // statistics gathered while dbgTileStats is enabled, summed over frames
+      struct TileStatistics
+      {
+	uint frames;
+	// lights culled, and the ones found in any tile
+	uint lights;
+	uint visibleLights;
+	// tiles with lights, and the sum of lights over all tiles
+	uint occupiedTiles;
+	uint entries;
+	// largest number of lights in a tile
+	uint maxTileLights;
+	// tiles in each class
+	uint tileClasses[CS::RenderManager::LightTileCuller::numTileClasses];
+	// quads drawn to resolve the lights
+	uint quads;
+	// time spent culling
+	csMicroTicks cullTime;
+
+	TileStatistics() : frames(0), lights(0), visibleLights(0), occupiedTiles(0),
+	  entries(0), maxTileLights(0), quads(0), cullTime(0)
+	{
+	  for(int c = 0; c < CS::RenderManager::LightTileCuller::numTileClasses; ++c)
+	    tileClasses[c] = 0;
+	}
+      };
+      TileStatistics tileStats;
+      // number of frames statistics are reported for
+      static const uint tileStatsReportFrames = 100;
+
+      PersistentData() : scfImplementation1<PersistentData, iLightCallback>(this),
+	tiledLighting(false), dbgPersist(nullptr), dbgTileStats(0)
       {
       }
 
@@ -411,13 +472,48 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
 
       void UpdateNewFrame()
       {
+	// statistics are gathered while the debug flag is set
+	if(dbgPersist && dbgPersist->IsDebugFlagEnabled(dbgTileStats))
+	{
+	  if(tileStats.frames >= tileStatsReportFrames)
+	    ReportTileStatistics();
+	  ++tileStats.frames;
+	}
+	else if(tileStats.frames > 0)
+	{
+	  tileStats = TileStatistics();
+	}
+      }
+
+      // Report the gathered tiled lighting statistics and start over
+      void ReportTileStatistics()
+      {
+	const float frames = (float)tileStats.frames;
+	csString classes;
+	for(int c = 0; c < CS::RenderManager::LightTileCuller::numTileClasses; ++c)
+	{
+	  classes.AppendFmt(" %.1f", tileStats.tileClasses[c] / frames);
+	}
+
+	csReport(objReg, CS_REPORTER_SEVERITY_NOTIFY, msgID,
+	  "Tiled lighting per frame over %u frames: %.1f lights, %.1f visible, "
+	  "%.1f occupied tiles, %.1f lights per occupied tile (max %u), "
+	  "%.1f quads, %.3f ms culling, tiles per class:%s",
+	  tileStats.frames, tileStats.lights / frames, tileStats.visibleLights / frames,
+	  tileStats.occupiedTiles / frames,
+	  tileStats.occupiedTiles ? (float)tileStats.entries / tileStats.occupiedTiles : 0.0f,
+	  tileStats.maxTileLights, tileStats.quads / frames,
+	  tileStats.cullTime / (1000.0f * frames), classes.GetDataSafe());
+
+	tileStats = TileStatistics();
       }
 
       /**
        * Initialize persistent data, must be called once before using the
        * light renderer.
        */
-      bool Initialize(iObjectRegistry* objRegistry, typename ShadowHandler::PersistentData& shadowPersistent, bool useShadows, bool deferredFull)
+      bool Initialize(iObjectRegistry* objRegistry, typename ShadowHandler::PersistentData& shadowPersistent,
+		      CS::RenderManager::RenderTreeBase::DebugPersistent& debugPersist, bool useShadows, bool deferredFull)
       {
 	// set our mesasge id
         msgID = "crystalspace.rendermanager.deferred.lightrender";
@@ -442,6 +538,35 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
 	// get clip ID
 	clipID = stringSet->Request("clip");
 
+	// setup tiled lighting
+	tiledLighting = cfg->GetBool("RenderManager.Deferred.TiledLighting", false);
+	tileCuller.SetTileSize(cfg->GetInt("RenderManager.Deferred.TiledLighting.TileSize", 32));
+	if(tiledLighting)
+	{
+	  // the thread rendering works on the tiles as well
+	  int threads = cfg->GetInt("RenderManager.Deferred.TiledLighting.Threads",
+	    CS::Platform::GetProcessorCount());
+	  if(threads > 1)
+	  {
+	    tileQueue.AttachNew(new CS::Threading::ThreadedJobQueue(threads - 1,
+	      CS::Threading::THREAD_PRIO_NORMAL, "light tile culling"));
+	  }
+	}
+	dbgPersist = &debugPersist;
+	dbgTileStats = debugPersist.RegisterDebugFlag("stats.lighttiles");
+
+	// setup tile mesh modes as they're constant
+	tileMesh.meshtype = CS_MESHTYPE_TRIANGLES;
+	tileMesh.mixmode = CS_FX_ADD;
+	tileMesh.alphaType = csAlphaMode::alphaNone;
+	tileMesh.do_mirror = false;
+	tileMesh.cullMode = CS::Graphics::cullDisabled;
+	tileMesh.clip_plane = CS_CLIP_NOT;
+	tileMesh.clip_portal = CS_CLIP_NOT;
+	tileMesh.clip_z_plane = CS_CLIP_NOT;
+	tileMesh.material = nullptr;
+	tileMesh.db_mesh_name = "crystalspace.rendermanager.deferred.lightrender.tiles";
+
 	// get shaders - the paths should really be configurable
 	csString basePath(deferredFull ? "/shader/deferred/full/" : "/shader/deferred/lighting/");
 	// @@@TODO: make the shaders changeable via config
@@ -612,9 +737,14 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
 
     /**
      * Renders a single light.
+     * With tiled lighting enabled, lights that can be rendered in tiles are
+     * only collected and rendered by RenderTiledLights().
      */
     void operator()(iLight* light)
     {
+      if(persistentData.tiledLighting && AddTiledLight(light))
+        return;
+
       csRenderMesh* mesh = nullptr;
       iShader* shader = nullptr;
 
@@ -642,8 +772,207 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
       RenderLight(light, mesh, shader);
     }
 
+    /**
+     * Renders the lights collected for tiled lighting.
+     * The lights are culled into screen tiles on the CPU. Each light is then
+     * drawn once, as quads covering the runs of tiles it is in, placed at
+     * the back of the light volume. This replaces drawing the light volume
+     * with stencil masking; the lights are still drawn and set up one at a
+     * time, as the point light shader evaluates a single light.
+     *
+     * The lights are collected in view space, so this must be called for
+     * each context after its lights, with the context's camera still set.
+     */
+    void RenderTiledLights()
+    {
+      csArray<typename PersistentData::TiledLight>& lights = persistentData.tiledLights;
+      if(lights.IsEmpty())
+        return;
+
+      // cull lights into tiles
+      CS::RenderManager::LightTileCuller& culler = persistentData.tileCuller;
+      const CS::Math::Matrix4& proj = graphics3D->GetProjectionMatrix();
+      culler.Setup(graphics3D->GetWidth(), graphics3D->GetHeight(), proj);
+      culler.ClearLights();
+      for(size_t l = 0; l < lights.GetSize(); ++l)
+      {
+	culler.AddLight(lights[l].posView, lights[l].radius);
+      }
+      culler.Cull(persistentData.tileQueue);
+
+      // build quads for the runs of adjacent tiles in a row
+      persistentData.tileVertices.Empty();
+      persistentData.tileIndices.Empty();
+      const uint tilesX = culler.GetTilesX();
+      for(size_t l = 0; l < lights.GetSize(); ++l)
+      {
+	typename PersistentData::TiledLight& tiled = lights[l];
+	tiled.indexStart = (uint)persistentData.tileIndices.GetSize();
+
+	const float z = tiled.posView.z + tiled.radius;
+	const uint* tiles = culler.GetLightTiles(l);
+	const size_t numTiles = culler.GetLightTileCount(l);
+	size_t first = 0;
+	while(first < numTiles)
+	{
+	  size_t last = first;
+	  while((last + 1 < numTiles) && (tiles[last + 1] == tiles[last] + 1)
+	    && ((tiles[last + 1] % tilesX) != 0))
+	  {
+	    ++last;
+	  }
+
+	  csVector2 min, max, unused;
+	  culler.GetTileBounds(tiles[first], min, unused);
+	  culler.GetTileBounds(tiles[last], unused, max);
+	  AddTileQuad(proj, min, max, z);
+
+	  first = last + 1;
+	}
+
+	tiled.indexEnd = (uint)persistentData.tileIndices.GetSize();
+      }
+
+      const size_t numQuads = persistentData.tileIndices.GetSize() / 6;
+      if(numQuads > 0)
+      {
+	csDirtyAccessArray<csVector3>& vertices = persistentData.tileVertices;
+	csDirtyAccessArray<uint>& indices = persistentData.tileIndices;
+	csRenderMesh& mesh = persistentData.tileMesh;
+
+	// fresh buffers each time as the quads change every frame
+	mesh.buffers.AttachNew(new csRenderBufferHolder);
+
+	csRef<iRenderBuffer> positions = csRenderBuffer::CreateRenderBuffer(
+	  vertices.GetSize(), CS_BUF_STREAM, CS_BUFCOMP_FLOAT, 3);
+	positions->CopyInto(vertices.GetArray(), vertices.GetSize());
+	mesh.buffers->SetRenderBuffer(CS_BUFFER_POSITION, positions);
+
+	csRef<iRenderBuffer> indexBuffer = csRenderBuffer::CreateIndexRenderBuffer(
+	  indices.GetSize(), CS_BUF_STREAM, CS_BUFCOMP_UNSIGNED_INT, 0, vertices.GetSize() - 1);
+	indexBuffer->CopyInto(indices.GetArray(), indices.GetSize());
+	mesh.buffers->SetRenderBuffer(CS_BUFFER_INDEX, indexBuffer);
+
+	// quad vertices are in view space
+	mesh.object2world = graphics3D->GetWorldToCamera().GetInverse();
+
+	iShader* shader = persistentData.pointShader;
+	csShaderVariable* lightPosSV = persistentData.lightPos;
+	csShaderVariable* shadowSpreadSV = persistentData.shadowSpread;
+	shadowSpreadSV->SetValue(0);
+
+	for(size_t l = 0; l < lights.GetSize(); ++l)
+	{
+	  const typename PersistentData::TiledLight& tiled = lights[l];
+	  if(tiled.indexStart == tiled.indexEnd)
+	    continue;
+
+	  // push shader variables
+	  csShaderVariableStack svStack = shaderMgr->GetShaderVariableStack();
+	  svStack.Clear();
+	  shader->PushVariables(svStack);
+	  shaderMgr->PushVariables(svStack);
+	  tiled.light->GetSVContext()->PushVariables(svStack);
+
+	  lightPosSV->SetValue(tiled.posView);
+	  svStack.Set(lightPosSV->GetName(), lightPosSV);
+	  svStack.Set(shadowSpreadSV->GetName(), shadowSpreadSV);
+
+	  // only geometry in front of the back of the light volume is lit
+	  mesh.indexstart = tiled.indexStart;
+	  mesh.indexend = tiled.indexEnd;
+	  DrawMesh(&mesh, shader, svStack, CS_ZBUF_INVERT);
+	}
+      }
+
+      // gather statistics
+      if(persistentData.dbgPersist->IsDebugFlagEnabled(persistentData.dbgTileStats))
+      {
+	const CS::RenderManager::LightTileCuller::Statistics& cullStats = culler.GetStatistics();
+	typename PersistentData::TileStatistics& stats = persistentData.tileStats;
+	stats.lights += cullStats.lights;
+	stats.visibleLights += cullStats.visibleLights;
+	stats.occupiedTiles += cullStats.occupiedTiles;
+	stats.entries += cullStats.entries;
+	stats.maxTileLights = csMax(stats.maxTileLights, cullStats.maxTileLights);
+	for(int c = 0; c < CS::RenderManager::LightTileCuller::numTileClasses; ++c)
+	{
+	  stats.tileClasses[c] += cullStats.tileClasses[c];
+	}
+	stats.quads += (uint)numQuads;
+	stats.cullTime += cullStats.cullTime;
+      }
+
+      lights.Empty();
+    }
+
   private:
 
+    /**
+     * Collects a light for tiled lighting. Returns false if the light can't
+     * be rendered in tiles.
+     */
+    bool AddTiledLight(iLight* light)
+    {
+      // only point lights without shadows or clip volume
+      if(light->GetType() != CS_LIGHT_POINTLIGHT)
+        return false;
+
+      if(persistentData.doShadows && !light->GetFlags().Check(CS_LIGHT_NOSHADOWS))
+        return false;
+
+      if(persistentData.GetClipVolume(light))
+        return false;
+
+      typename PersistentData::TiledLight tiled;
+      tiled.light = light;
+      tiled.posView = light->GetMovable()->GetFullPosition() / graphics3D->GetWorldToCamera();
+      tiled.radius = light->GetCutoffDistance();
+      tiled.indexStart = tiled.indexEnd = 0;
+      persistentData.tiledLights.Push(tiled);
+
+      return true;
+    }
+
+    /**
+     * Returns the view space point at depth z that is projected to the given
+     * normalized device coordinates.
+     */
+    static csVector3 UnprojectAtDepth(const CS::Math::Matrix4& proj, float nx, float ny, float z)
+    {
+      // solve (Row1 - nx*Row4).p = 0 and (Row2 - ny*Row4).p = 0 for x and y
+      const csVector4 r1(proj.Row1() - proj.Row4() * nx);
+      const csVector4 r2(proj.Row2() - proj.Row4() * ny);
+      const float c1 = -(r1.z * z + r1.w);
+      const float c2 = -(r2.z * z + r2.w);
+      const float det = r1.x * r2.y - r1.y * r2.x;
+
+      return csVector3((c1 * r2.y - r1.y * c2) / det, (r1.x * c2 - c1 * r2.x) / det, z);
+    }
+
+    /**
+     * Adds a quad covering the given rectangle in normalized device
+     * coordinates at depth z to the tile geometry.
+     */
+    void AddTileQuad(const CS::Math::Matrix4& proj, const csVector2& min, const csVector2& max, float z)
+    {
+      csDirtyAccessArray<csVector3>& vertices = persistentData.tileVertices;
+      csDirtyAccessArray<uint>& indices = persistentData.tileIndices;
+      const uint base = (uint)vertices.GetSize();
+
+      vertices.Push(UnprojectAtDepth(proj, min.x, min.y, z));
+      vertices.Push(UnprojectAtDepth(proj, max.x, min.y, z));
+      vertices.Push(UnprojectAtDepth(proj, max.x, max.y, z));
+      vertices.Push(UnprojectAtDepth(proj, min.x, max.y, z));
+
+      indices.Push(base);
+      indices.Push(base + 1);
+      indices.Push(base + 2);
+      indices.Push(base);
+      indices.Push(base + 2);
+      indices.Push(base + 3);
+    }
+
     /**
      * Sets shader variables specific to the given light.
      */
@@ -663,7 +992,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
         csVector3 lightPos(movable->GetFullPosition() / world2camera);
 
         lightPosSV->SetValue(lightPos);
-	svStack[lightPosSV->GetName()] = lightPosSV;
+	svStack.Set(lightPosSV->GetName(), lightPosSV);
       }
 
       // Transform light direction to view space.
@@ -675,7 +1004,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
         lightDir = world2camera.This2OtherRelative(lightDir);
 
         lightDirSV->SetValue(lightDir.Unit());
-	svStack[lightDirSV->GetName()] = lightDirSV;
+	svStack.Set(lightDirSV->GetName(), lightDirSV);
       }
     }
 
@@ -724,7 +1053,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
 
       // push shadow spread variable
       csShaderVariable* shadowSpreadSV = persistentData.shadowSpread;
-      svStack[shadowSpreadSV->GetName()] = shadowSpreadSV;
+      svStack.Set(shadowSpreadSV->GetName(), shadowSpreadSV);
 
       // get camera and mirroring
       iCamera* cam = rview->GetCamera();
@@ -73,6 +73,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
       if (!node->useForwardRendering)
         caller (node);
     }
+
+    caller.Finish (context.owner.GetPersistentData ().operationQueue);
   }
 
   /**
@@ -105,6 +107,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
       if (node->useForwardRendering)
         caller (node);
     }
+
+    caller.Finish (context.owner.GetPersistentData ().operationQueue);
   }
 
 }
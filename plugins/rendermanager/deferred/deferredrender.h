@@ -308,7 +308,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
 	graphics3D->SetZMode(CS_ZBUF_MESH2);
 
 	// accumulate lighting data
-	RenderLights(deferredLayer, ctxCount, lightRender);
+	RenderObjects<LightRenderType, RenderContextLights>(deferredLayer, ctxCount, lightRender);
 
 	// clear clipper
 	graphics3D->SetClipper(nullptr, CS_CLIPPER_TOPLEVEL);
@@ -389,6 +389,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMDeferred)
       RenderObjects<T, ForEachLight>(layer, ctxCount, render);
     }
 
+    // renders the lights of a context, including the ones collected for tiled lighting
+    static void RenderContextLights(ContextNodeType& context, LightRenderType& render)
+    {
+      ForEachLight(context, render);
+      render.RenderTiledLights();
+    }
+
     void RenderForwardMeshes(size_t layerCount, const size_t ctxCount)
     {
       // iterate over all layers
@@ -190,6 +190,7 @@ struct WrapShadowParams<RMOSM::ShadowType>
     float b =  invFov * (frameHeight - camera->GetShiftY ());
     rview->SetFrustum (l, r, t, b);
 
+    treePersistent.UpdateNewFrame ();
     lightPersistent.UpdateNewFrame ();
 
     iSector* startSector = rview->GetThisSector ();
@@ -270,7 +271,7 @@ struct WrapShadowParams<RMOSM::ShadowType>
     }
 
     csRef<iGraphics3D> g3d = csQueryRegistry<iGraphics3D> (objectReg);
-    treePersistent.Initialize (shaderManager);
+    treePersistent.Initialize (objectReg, shaderManager);
     dbgFlagClipPlanes =
       treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
 
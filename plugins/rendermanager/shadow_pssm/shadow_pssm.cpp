@@ -386,6 +386,7 @@ bool RMShadowedPSSM::RenderView (iView* view, bool recursePortals)
   rview->SetFrustum (leftx, rightx, topy, boty);
 
   contextsScannedForTargets.Empty ();
+  treePersistent.UpdateNewFrame ();
   portalPersistent.UpdateNewFrame ();
   lightPersistent.UpdateNewFrame ();
   lightPersistent_unshadowed.UpdateNewFrame ();
@@ -574,7 +575,7 @@ bool RMShadowedPSSM::Initialize(iObjectRegistry* objectReg)
   maxPortalRecurse = cfg->GetInt("RenderManager.ShadowPSSM.MaxPortalRecurse", 30);
   
   csRef<iGraphics3D> g3d = csQueryRegistry<iGraphics3D> (objectReg);
-  treePersistent.Initialize (shaderManager);
+  treePersistent.Initialize (objectReg, shaderManager);
   dbgFlagClipPlanes =
     treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
   PostEffectsSupport::Initialize (objectReg, "RenderManager.ShadowPSSM");
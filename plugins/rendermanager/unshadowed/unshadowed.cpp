@@ -38,9 +38,13 @@
 #include "unshadowed.h"
 
 #include "iutil/verbositymanager.h"
+#include "ivaria/profile.h"
 #include "ivaria/reporter.h"
 #include "csutil/cfgacc.h"
+#include "csutil/platform.h"
 #include "csutil/stringquote.h"
+#include "csutil/sysfunc.h"
+#include "csutil/threadjobqueue.h"
 
 using namespace CS::RenderManager;
 
@@ -49,6 +53,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMUnshadowed)
 
 SCF_IMPLEMENT_FACTORY(RMUnshadowed)
 
+CS_DECLARE_PROFILER
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_Viscull);
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_SetupRenderTree);
+CS_DECLARE_PROFILER_ZONE(RMUnshadowed_Render);
 
 template<typename RenderTreeType, typename LayerConfigType>
 class StandardContextSetup
@@ -89,8 +97,11 @@ public:
       context.owner.AddDebugClipPlanes (rview);
 
     // Do the culling
-    iVisibilityCuller* culler = sector->GetVisibilityCuller ();
-    Viscull<RenderTreeType> (context, rview, culler);
+    {
+      CS_PROFILER_ZONE(RMUnshadowed_Viscull);
+      iVisibilityCuller* culler = sector->GetVisibilityCuller ();
+      Viscull<RenderTreeType> (context, rview, culler);
+    }
 
     // Set up all portals
     if (recursePortals)
@@ -217,7 +228,8 @@ private:
 
 RMUnshadowed::RMUnshadowed (iBase* parent)
   : scfImplementationType (this, parent),
-    doHDRExposure (false), targets (*this)
+    doHDRExposure (false), setupThreads (1), setupTimeFrames (0),
+    setupTimeCount (0), setupTimeTotal (0), targets (*this)
 {
   SetTreePersistent (treePersistent);
 }
@@ -260,6 +272,7 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
   rview->SetFrustum (leftx, rightx, topy, boty);
 
   contextsScannedForTargets.Empty ();
+  treePersistent.UpdateNewFrame ();
   portalPersistent.UpdateNewFrame ();
   lightPersistent.UpdateNewFrame ();
   reflectRefractPersistent.UpdateNewFrame ();
@@ -281,8 +294,11 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
   startContext->renderTargets[rtaColor0].texHandle = postEffects.GetScreenTarget ();
   startContext->perspectiveFixup = perspectiveFixup;
 
+  csMicroTicks setupStart = setupTimeFrames ? csGetMicroTicks () : 0;
+
   // Setup the main context
   {
+    CS_PROFILER_ZONE(RMUnshadowed_SetupRenderTree);
     ContextSetupType contextSetup (this, renderLayer);
     ContextSetupType::PortalSetupType::ContextSetupData portalData (startContext);
 
@@ -303,8 +319,11 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
 
   targets.FinishRendering ();
 
+  if (setupTimeFrames) AddSetupTime (csGetMicroTicks () - setupStart);
+
   // Render all contexts, back to front
   {
+    CS_PROFILER_ZONE(RMUnshadowed_Render);
     view->GetContext()->SetZMode (CS_ZBUF_MESH);
 
     SimpleTreeRenderer<RenderTreeType> render (rview->GetGraphics3D (),
@@ -321,6 +340,20 @@ bool RMUnshadowed::RenderView (iView* view, bool recursePortals)
   return true;
 }
 
+void RMUnshadowed::AddSetupTime (csMicroTicks time)
+{
+  setupTimeTotal += time;
+  if (++setupTimeCount < setupTimeFrames) return;
+
+  csReport (objectReg, CS_REPORTER_SEVERITY_NOTIFY,
+    "crystalspace.rendermanager.unshadowed",
+    "Render tree setup: %.3f ms per frame over %u frames, %d thread(s)",
+    float (setupTimeTotal) / (1000.0f * setupTimeCount), setupTimeCount,
+    setupThreads);
+  setupTimeCount = 0;
+  setupTimeTotal = 0;
+}
+
 bool RMUnshadowed::RenderView (iView* view)
 {
   return RenderView (view, true);
@@ -449,7 +482,20 @@ bool RMUnshadowed::Initialize(iObjectRegistry* objectReg)
   maxPortalRecurse = cfg->GetInt("RenderManager.Unshadowed.MaxPortalRecurse", 30);
   
   csRef<iGraphics3D> g3d = csQueryRegistry<iGraphics3D> (objectReg);
-  treePersistent.Initialize (shaderManager);
+  treePersistent.Initialize (objectReg, shaderManager);
+  setupThreads = cfg->GetInt ("RenderManager.Unshadowed.SetupThreads",
+    CS::Platform::GetProcessorCount ());
+  if (setupThreads > 1)
+  {
+    /* The thread calling RenderView() works on the render tree as well,
+       so one thread less is needed for the queue */
+    treePersistent.operationQueue.AttachNew (
+      new CS::Threading::ThreadedJobQueue (setupThreads - 1,
+        CS::Threading::THREAD_PRIO_NORMAL, "render tree setup"));
+  }
+  else
+    setupThreads = 1;
+  setupTimeFrames = cfg->GetInt ("RenderManager.Unshadowed.ReportSetupTime", 0);
   dbgFlagClipPlanes =
     treePersistent.debugPersist.RegisterDebugFlag ("draw.clipplanes.view");
     
@@ -101,6 +101,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMUnshadowed)
     iObjectRegistry* objectReg;
 
     bool RenderView (iView* view, bool recursePortals);
+    /// Add up render tree setup times and report them periodically
+    void AddSetupTime (csMicroTicks time);
     bool HandleTarget (RenderTreeType& renderTree, 
       const TargetManagerType::TargetSettings& settings,
       bool recursePortals);
@@ -116,6 +118,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(RMUnshadowed)
     bool doHDRExposure;
     int maxPortalRecurse;
 
+    /// Number of threads setting up the render tree
+    int setupThreads;
+    /// Report setup times averaged over this many frames; 0 to disable
+    uint setupTimeFrames;
+    uint setupTimeCount;
+    csMicroTicks setupTimeTotal;
+
     csRef<iShaderVarStringSet>  svNameStringSet;
     csRef<iStringSet>           stringSet;
     csRef<iShaderManager>       shaderManager;
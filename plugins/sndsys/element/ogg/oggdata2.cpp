@@ -114,6 +114,7 @@ iSndSysStream *SndSysOggSoundData::CreateStream (
 {
   // Creating a stream from the data is a simple operation for Ogg
   SndSysOggSoundStream *pStream=new SndSysOggSoundStream(this, &m_DataStore, pRenderFormat, Mode3D);
+  pStream->EnableDecodeAhead(m_DecodeQueue, m_DecodeAheadTime);
 
   return (pStream);
 }
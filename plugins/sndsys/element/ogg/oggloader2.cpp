@@ -18,8 +18,10 @@
 */
 
 #include "cssysdef.h"
+#include "csutil/cfgacc.h"
 #include "iutil/comp.h"
 #include "isndsys/ss_loader.h"
+#include "csplugincommon/sndsys/sndstream.h"
 #include "oggdata2.h"
 
 #include "oggloader2.h"
@@ -28,4 +30,16 @@
 
 SCF_IMPLEMENT_FACTORY (SndSysOggLoader);
 
+bool SndSysOggLoader::Initialize (iObjectRegistry *object_reg)
+{
+  csConfigAccess config (object_reg, "/config/sound.cfg");
+  int decodeAhead = config->GetInt ("SndSys.DecodeAhead", 250);
+  if (decodeAhead > 0)
+  {
+    m_DecodeAheadTime = decodeAhead;
+    m_DecodeQueue = SndSysBasicStream::GetDecoderQueue (object_reg);
+  }
+  return true;
+}
+
 
@@ -21,6 +21,7 @@
 #define SNDSYS_LOADER_OGG_H
 
 #include "isndsys/ss_loader.h"
+#include "iutil/job.h"
 
 #include "csutil/scf_implementation.h"
 
@@ -37,7 +38,7 @@ class SndSysOggLoader : public
 public:
   /// A very un-busy constructor
   SndSysOggLoader (iBase *parent) :
-      scfImplementationType(this, parent)
+      scfImplementationType(this, parent), m_DecodeAheadTime(0)
   {
   }
 
@@ -54,8 +55,8 @@ public:
   // iComponent
   //------------------------
 public:
-  /// Initialize this component. Not much to do here.
-  virtual bool Initialize (iObjectRegistry *){return true;}
+  /// Initialize this component. Sets up decoding ahead.
+  virtual bool Initialize (iObjectRegistry *object_reg);
 
   //------------------------
   // iSndSysLoader
@@ -79,10 +80,19 @@ public:
       sd = new SndSysOggSoundData ((iBase*)this, Buffer);
       // Set the Data object desctiption to the passed value (may be NULL)
       sd->SetDescription(pDescription);
+      // Streams of the data decode ahead on the shared decoder threads
+      sd->SetDecodeAhead(m_DecodeQueue, m_DecodeAheadTime);
     }
 
     return csPtr<iSndSysData> (sd);
   }
+
+private:
+  /// Queue of the decoder threads, if streams decode ahead
+  csRef<iJobQueue> m_DecodeQueue;
+
+  /// How far streams decode ahead in milliseconds
+  size_t m_DecodeAheadTime;
 };
 
 #endif // #ifndef SNDSYS_LOADER_OGG_H
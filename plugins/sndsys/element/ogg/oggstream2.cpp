@@ -66,6 +66,9 @@ SndSysOggSoundStream::SndSysOggSoundStream (csRef<SndSysOggSoundData> pData,
 
 SndSysOggSoundStream::~SndSysOggSoundStream ()
 {
+  // The decoder threads may still be using the ogg file
+  WaitForDecoder();
+
   //Closes the bitstream and cleans up loose ends.
   ov_clear(&m_VorbisFile);
 }
@@ -92,15 +95,24 @@ size_t SndSysOggSoundStream::GetFrameCount()
   return framecount;
 }
 
-void SndSysOggSoundStream::AdvancePosition(size_t frame_delta)
+void SndSysOggSoundStream::Seek(size_t position)
+{
+  // Flush the prepared samples
+  m_PreparedDataBufferUsage=0;
+  m_PreparedDataBufferStart=0;
+
+  // Seek the ogg stream to the requested position
+  ov_pcm_seek(&m_VorbisFile,position);
+}
+
+void SndSysOggSoundStream::DecodeFrames(size_t frame_delta)
 {
-  size_t needed_bytes=0;
   //if loop is enabled, end loop frame is different than zero and we are at the loop ending return to the
   //start of the loop
   if(m_bLooping && m_endLoopFrame != 0 && m_MostAdvancedReadPointer+frame_delta >= m_endLoopFrame)
   {
       //first advance the decoding of the exact bound we need to reach the endloopframe
-      AdvancePosition(m_endLoopFrame-m_MostAdvancedReadPointer-1);
+      DecodeFrames(m_endLoopFrame-m_MostAdvancedReadPointer-1);
       //remove from frame_delta what we decoded already
       frame_delta -= m_endLoopFrame-m_MostAdvancedReadPointer-1;
       // Flush the prepared samples
@@ -111,22 +123,7 @@ void SndSysOggSoundStream::AdvancePosition(size_t frame_delta)
       ov_pcm_seek(&m_VorbisFile,m_startLoopFrame);
   }
 
-  if (m_NewPosition != InvalidPosition)
-  {
-    // Signal a full cyclic buffer flush
-    needed_bytes=m_pCyclicBuffer->GetLength();
-
-    // Flush the prepared samples too
-    m_PreparedDataBufferUsage=0;
-    m_PreparedDataBufferStart=0;
-
-    // Seek the ogg stream to the requested position
-    ov_pcm_seek(&m_VorbisFile,m_NewPosition);
-
-    m_NewPosition = InvalidPosition;
-    m_bPlaybackReadComplete=false;
-  }
-  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || m_bPlaybackReadComplete || frame_delta==0)
+  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || IsPlaybackReadComplete() || frame_delta==0)
     return;
 
  
@@ -134,8 +131,7 @@ void SndSysOggSoundStream::AdvancePosition(size_t frame_delta)
   
 
   // Figure out how many bytes we need to fill for this advancement
-  if (needed_bytes==0)
-    needed_bytes=frame_delta * (m_RenderFormat.Bits/8) * m_RenderFormat.Channels ;
+  size_t needed_bytes=frame_delta * (m_RenderFormat.Bits/8) * m_RenderFormat.Channels ;
 
   /* If we need more space than is available in the whole cyclic buffer, 
    * then we already underbuffered, reduce to just 1 cycle full
@@ -174,7 +170,7 @@ void SndSysOggSoundStream::AdvancePosition(size_t frame_delta)
         if (!m_bLooping)
         {
           // Seek back to the beginning for a restart.  Pause on the next call
-          m_bPlaybackReadComplete=true;
+          SetPlaybackReadComplete (true);
           ov_raw_seek(&m_VorbisFile,0);
           return;
         }
@@ -75,21 +75,15 @@ public:
   */
   virtual size_t GetFrameCount();
 
-  /**
-  * NOT AN APPLICATION CALLABLE FUNCTION!   This function advances the stream
-  * position based on the provided frame count value which is considered as an
-  * elapsed frame count.
-  *
-  * A Sound Element will usually store the last advance frame internally.
-  * When this function is called it will compare the last frame with the
-  * frame presented and retrieve more data from the associated iSndSysData
-  * container as needed.  It will then update its internal last advance
-  * frame value.
-  *  
-  * This function is not necessarily thread safe and must be called ONLY
-  * from the Sound System's main processing thread.
-  */
-  virtual void AdvancePosition(size_t frame_delta);
+  ////
+  // Decoding, see SndSysBasicStream
+  ////
+protected:
+  /// Decode frame_delta frames into the cyclic buffer
+  virtual void DecodeFrames(size_t frame_delta);
+
+  /// Move the decoder to the frame position
+  virtual void Seek(size_t position);
 
   ////
   //  Member variables
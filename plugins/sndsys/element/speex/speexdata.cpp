@@ -45,6 +45,7 @@ iSndSysStream *SndSysSpeexSoundData::CreateStream(csSndSysSoundFormat *pRenderFo
     Initialize();
 
   SndSysSpeexSoundStream *pStream = new SndSysSpeexSoundStream(this, pRenderFormat, Mode3D);
+  pStream->EnableDecodeAhead(m_DecodeQueue, m_DecodeAheadTime);
 
   return (pStream);
 }
@@ -18,12 +18,15 @@
 
 #include "cssysdef.h"
 
+#include "csutil/cfgacc.h"
+#include "csplugincommon/sndsys/sndstream.h"
 #include "speexdata.h"
 #include "speexloader.h"
 
 SCF_IMPLEMENT_FACTORY (SndSysSpeexLoader);
 
-SndSysSpeexLoader::SndSysSpeexLoader(iBase *parent) : scfImplementationType(this, parent)
+SndSysSpeexLoader::SndSysSpeexLoader(iBase *parent) : scfImplementationType(this, parent),
+  m_DecodeAheadTime(0)
 {
 }
 
@@ -31,8 +34,15 @@ SndSysSpeexLoader::~SndSysSpeexLoader()
 {
 }
 
-bool SndSysSpeexLoader::Initialize(iObjectRegistry*)
+bool SndSysSpeexLoader::Initialize(iObjectRegistry* object_reg)
 {
+  csConfigAccess config(object_reg, "/config/sound.cfg");
+  int decodeAhead = config->GetInt("SndSys.DecodeAhead", 250);
+  if (decodeAhead > 0)
+  {
+    m_DecodeAheadTime = decodeAhead;
+    m_DecodeQueue = SndSysBasicStream::GetDecoderQueue(object_reg);
+  }
   return true;
 }
 
@@ -45,6 +55,7 @@ csPtr<iSndSysData> SndSysSpeexLoader::LoadSound(iDataBuffer* Buffer, const char*
   {
     data = new SndSysSpeexSoundData((iBase*)this, Buffer);
     data->SetDescription(pDescription);
+    data->SetDecodeAhead(m_DecodeQueue, m_DecodeAheadTime);
   }
 
   return csPtr<iSndSysData> (data);
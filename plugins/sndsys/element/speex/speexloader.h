@@ -22,6 +22,7 @@
 #include "csutil/scf_implementation.h"
 #include "isndsys/ss_loader.h"
 #include "iutil/comp.h"
+#include "iutil/job.h"
 
 /**
  * iSndSysLoader interface for Speex audio data.
@@ -34,6 +35,13 @@ public:
 
   virtual bool Initialize(iObjectRegistry*);
   virtual csPtr<iSndSysData> LoadSound(iDataBuffer* Buffer, const char *pDescription);
+
+private:
+  /// Queue of the decoder threads, if streams decode ahead
+  csRef<iJobQueue> m_DecodeQueue;
+
+  /// How far streams decode ahead in milliseconds
+  size_t m_DecodeAheadTime;
 };
 
 #endif // SNDSYS_LOADER_SPEEX_H
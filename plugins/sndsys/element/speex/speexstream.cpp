@@ -44,6 +44,9 @@ SndSysBasicStream(pRenderFormat, Mode3D), m_pSoundData(pData), header(0)
 
 SndSysSpeexSoundStream::~SndSysSpeexSoundStream ()
 {
+  // The decoder threads may still be using the speex state
+  WaitForDecoder();
+
   speex_header_free(header);
   ogg_stream_clear(&os);
 }
@@ -93,9 +96,39 @@ bool SndSysSpeexSoundStream::ResetPosition(bool clear)
   return true;
 }
 
-void SndSysSpeexSoundStream::AdvancePosition(size_t frame_delta)
+void SndSysSpeexSoundStream::Seek(size_t position)
 {
-  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || m_bPlaybackReadComplete || frame_delta==0)
+  m_PreparedDataBufferUsage=0;
+  m_PreparedDataBufferStart=0;
+  ResetPosition();
+
+  // Speex has no index, so decode from the start and skip up to the position
+  size_t skip_bytes = position * m_RenderFrameSize;
+  while (skip_bytes > 0)
+  {
+    if (!DecodePacket())
+    {
+      // Past the end, the next decode finishes or loops the stream
+      m_PreparedDataBufferUsage=0;
+      m_PreparedDataBufferStart=0;
+      return;
+    }
+    if (m_PreparedDataBufferUsage > skip_bytes)
+    {
+      // Keep the rest of the packet after the position
+      m_PreparedDataBufferStart += skip_bytes;
+      m_PreparedDataBufferUsage -= skip_bytes;
+      return;
+    }
+    skip_bytes -= m_PreparedDataBufferUsage;
+    m_PreparedDataBufferUsage=0;
+    m_PreparedDataBufferStart=0;
+  }
+}
+
+void SndSysSpeexSoundStream::DecodeFrames(size_t frame_delta)
+{
+  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || IsPlaybackReadComplete() || frame_delta==0)
     return;
 
   // Figure out how many bytes we need to fill for this advancement
@@ -115,21 +148,33 @@ void SndSysSpeexSoundStream::AdvancePosition(size_t frame_delta)
 
   while (needed_bytes > 0)
   {
-    if(newPage)
+    if (!DecodePacket())
     {
-      if(ogg_sync_pageout(&oy, &og) != 1)
+      // Mark as complete if not looping.
+      if (!m_bLooping)
       {
-        // Mark as complete if not looping.
-        if (!m_bLooping)
-        {
-          m_bPlaybackReadComplete = true;
-        }
+        SetPlaybackReadComplete (true);
+      }
 
-        // Reset stream.
-        ResetPosition();
+      // Reset stream.
+      ResetPosition();
 
-        return;
-      }
+      return;
+    }
+
+    if (m_PreparedDataBufferUsage > 0)
+      needed_bytes -= CopyBufferBytes (needed_bytes);
+  }
+}
+
+bool SndSysSpeexSoundStream::DecodePacket()
+{
+  while (true)
+  {
+    if(newPage)
+    {
+      if(ogg_sync_pageout(&oy, &og) != 1)
+        return false;
 
       if (!stream_init)
       {
@@ -203,9 +248,8 @@ void SndSysSpeexSoundStream::AdvancePosition(size_t frame_delta)
     // Frame size is in shorts.
     speex_decoder_ctl(state, SPEEX_GET_FRAME_SIZE, &m_PreparedDataBufferUsage);
     m_PreparedDataBufferUsage *= sizeof(short);
-
-    if (m_PreparedDataBufferUsage > 0)
-      needed_bytes -= CopyBufferBytes (needed_bytes);
+    m_PreparedDataBufferStart = 0;
+    return true;
   }
 }
 
@@ -51,11 +51,6 @@ public:
   */
   virtual size_t GetFrameCount();
 
-  /**
-    * Not permitted (yet) operations.
-    */
-  virtual bool SetPosition (size_t newposition) { return false; }
-
   /**
     * Not permitted (yet) operations.
     */
@@ -66,26 +61,26 @@ public:
    */
   virtual bool ResetPosition(bool clear = true);
 
-  /**
-  * NOT AN APPLICATION CALLABLE FUNCTION!   This function advances the stream
-  * position based on the provided frame count value which is considered as an
-  * elapsed frame count.
-  *
-  * A Sound Element will usually store the last advance frame internally.
-  * When this function is called it will compare the last frame with the
-  * frame presented and retrieve more data from the associated iSndSysData
-  * container as needed.  It will then update its internal last advance
-  * frame value.
-  *  
-  * This function is not necessarily thread safe and must be called ONLY
-  * from the Sound System's main processing thread.
-  */
-  virtual void AdvancePosition(size_t frame_delta);
-
   /// Whether this stream always needs to be treated as a stream regardless of size.
   virtual bool AlwaysStream() const { return true; }
 
+  ////
+  // Decoding, see SndSysBasicStream
+  ////
+protected:
+  /// Decode frame_delta frames into the cyclic buffer
+  virtual void DecodeFrames(size_t frame_delta);
+
+  /// Move the decoder to the frame position
+  virtual void Seek(size_t position);
+
 private:
+  /**
+   * Decode the next audio packet into the prepared data buffer.
+   * Returns false at the end of the data.
+   */
+  bool DecodePacket();
+
   /// Holds our reference to the underlying data element
   csRef<SndSysSpeexSoundData> m_pSoundData;
 
@@ -124,9 +124,9 @@ void SndSysWavSoundStream::AdvancePosition(size_t frame_delta)
     m_WavBytesLeft=m_WavDataLength-m_NewPosition;
 
     m_NewPosition = positionInvalid;
-    m_bPlaybackReadComplete=false;
+    SetPlaybackReadComplete (false);
   }
-  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || m_bPlaybackReadComplete || frame_delta==0)
+  if (m_PauseState != CS_SNDSYS_STREAM_UNPAUSED || IsPlaybackReadComplete() || frame_delta==0)
     return;
 
 
@@ -247,7 +247,7 @@ void SndSysWavSoundStream::AdvancePosition(size_t frame_delta)
     {
       if (!m_bLooping)
       {
-        m_bPlaybackReadComplete=true;
+        SetPlaybackReadComplete (true);
         m_pWavCurrentPointer=m_pWavDataBase;
         m_WavBytesLeft=m_WavDataLength;
         break;
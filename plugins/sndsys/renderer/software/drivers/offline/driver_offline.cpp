@@ -0,0 +1,316 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include "csutil/csendian.h"
+#include "csutil/platformfile.h"
+#include "csutil/stringquote.h"
+#include "csutil/sysfunc.h"
+#include "csutil/scf_implementation.h"
+#include "iutil/objreg.h"
+#include "iutil/cmdline.h"
+#include "ivaria/reporter.h"
+
+#include "../../renderer.h"
+#include "driver_offline.h"
+
+
+// Size of the RIFF/WAVE header written in front of the sample data
+#define WAV_HEADER_SIZE 44
+
+
+CS_PLUGIN_NAMESPACE_BEGIN(SndSysOffline)
+{
+
+SCF_IMPLEMENT_FACTORY (SndSysDriverOffline)
+
+
+SndSysDriverOffline::SndSysDriverOffline(iBase* pParent) :
+  scfImplementationType(this, pParent),
+  m_pObjectReg(0), m_pAttachedRenderer(0), m_bRunning(false),
+  m_BlockFrames(0), m_Speed(0.0f), m_Duration(0.0f),
+  m_MaxFrames(0), m_pOutputFile(0),
+  m_OutputBytes(0), m_RenderedFrames(0), m_RenderTime(0), m_ElapsedTime(0)
+{
+}
+
+
+SndSysDriverOffline::~SndSysDriverOffline()
+{
+  CloseOutputFile();
+}
+
+
+bool SndSysDriverOffline::Initialize (iObjectRegistry *pObjectReg)
+{
+  /// Interface to the Configuration file
+  csConfigAccess Config;
+
+  // Store the Object registry interface pointer, we'll need it later
+  m_pObjectReg=pObjectReg;
+
+  // Get an interface for event recorder (if present)
+  m_EventRecorder = csQueryRegistry<iSndSysEventRecorder> (m_pObjectReg);
+
+  RecordEvent(SSEL_CRITICAL, "Offline driver for software sound renderer initialized.");
+
+  // Make sure sound.cfg is available
+  Config.AddConfig(m_pObjectReg, "/config/sound.cfg");
+
+  m_BlockFrames = Config->GetInt("SndSys.Driver.Offline.BlockFrames", 1024);
+  if (m_BlockFrames == 0)
+    m_BlockFrames = 1024;
+  m_Speed = Config->GetFloat("SndSys.Driver.Offline.Speed", 0.0f);
+  if (m_Speed < 0.0f)
+    m_Speed = 0.0f;
+  m_Duration = Config->GetFloat("SndSys.Driver.Offline.Duration", 0.0f);
+  m_OutputFileName = Config->GetStr("SndSys.Driver.Offline.File", "");
+
+  // Command line options override the configuration
+  csRef<iCommandLineParser> CMDLine (
+    csQueryRegistry<iCommandLineParser> (m_pObjectReg));
+  if (CMDLine)
+  {
+    const char *OutputStr = CMDLine->GetOption("soundoutput");
+    if (OutputStr) m_OutputFileName = OutputStr;
+    const char *DurationStr = CMDLine->GetOption("soundduration");
+    if (DurationStr) m_Duration = atof(DurationStr);
+  }
+  if (m_Duration < 0.0f)
+    m_Duration = 0.0f;
+
+  return true;
+}
+
+void SndSysDriverOffline::RecordEvent(SndSysEventLevel Severity, const char* msg, ...)
+{
+  if (!m_EventRecorder)
+    return;
+
+  va_list arg;
+  va_start (arg, msg);
+  m_EventRecorder->RecordEventV(SSEC_DRIVER, Severity, msg, arg);
+  va_end (arg);
+}
+
+
+bool SndSysDriverOffline::Open (csSndSysRendererSoftware* pRenderer,
+				csSndSysSoundFormat *pRequestedFormat)
+{
+  RecordEvent(SSEL_DEBUG, "Offline Driver: Open()");
+
+  // WAV files hold little endian samples
+  pRequestedFormat->Flags &= ~CSSNDSYS_SAMPLE_ENDIAN_MASK;
+  pRequestedFormat->Flags |= CSSNDSYS_SAMPLE_LITTLE_ENDIAN;
+
+  // Copy the format into local storage
+  memcpy(&m_PlaybackFormat, pRequestedFormat, sizeof(csSndSysSoundFormat));
+
+  m_pAttachedRenderer=pRenderer;
+
+  // The frame limit depends on the playback frequency
+  m_MaxFrames = (size_t)((double)m_Duration * m_PlaybackFormat.Freq);
+
+  if (!m_OutputFileName.IsEmpty() && !OpenOutputFile())
+  {
+    csReport (m_pObjectReg, CS_REPORTER_SEVERITY_ERROR,
+      "crystalspace.sndsys.software.driver.offline",
+      "Could not create output file %s", CS::Quote::Single (m_OutputFileName));
+    return false;
+  }
+
+  return true;
+}
+
+void SndSysDriverOffline::Close ()
+{
+  CloseOutputFile();
+}
+
+bool SndSysDriverOffline::StartThread()
+{
+  if (m_bRunning) return false;
+
+  m_bRunning=true;
+  SndSysDriverRunnable* runnable = new SndSysDriverRunnable (this);
+  m_pBGThread.AttachNew (new CS::Threading::Thread (runnable, false));
+  runnable->DecRef ();
+
+  m_pBGThread->Start();
+
+  return true;
+}
+
+
+void SndSysDriverOffline::StopThread()
+{
+  m_bRunning=false;
+  // Wait for the last block so the output is complete when Close() is called
+  if (m_pBGThread)
+  {
+    m_pBGThread->Wait();
+    m_pBGThread.Invalidate();
+  }
+}
+
+void SndSysDriverRunnable::Run ()
+{
+  m_pParent->Run ();
+}
+
+bool SndSysDriverOffline::OpenOutputFile()
+{
+  m_pOutputFile = CS::Platform::File::Open (m_OutputFileName, "wb");
+  if (!m_pOutputFile)
+    return false;
+
+  // Reserve space for the header, it's written once the sizes are known
+  uint8 Header[WAV_HEADER_SIZE];
+  memset (Header, 0, sizeof (Header));
+  m_OutputBytes = 0;
+  return fwrite (Header, 1, sizeof (Header), m_pOutputFile) == sizeof (Header);
+}
+
+void SndSysDriverOffline::CloseOutputFile()
+{
+  if (!m_pOutputFile)
+    return;
+
+  uint32 BytesPerFrame = m_PlaybackFormat.Channels * m_PlaybackFormat.Bits / 8;
+  uint8 Header[WAV_HEADER_SIZE];
+  memcpy (Header, "RIFF", 4);
+  csSetToAddress::UInt32 (Header + 4,
+    csLittleEndian::UInt32 (uint32 (WAV_HEADER_SIZE - 8 + m_OutputBytes)));
+  memcpy (Header + 8, "WAVEfmt ", 8);
+  csSetToAddress::UInt32 (Header + 16, csLittleEndian::UInt32 (16));
+  // PCM
+  csSetToAddress::UInt16 (Header + 20, csLittleEndian::UInt16 (1));
+  csSetToAddress::UInt16 (Header + 22,
+    csLittleEndian::UInt16 (m_PlaybackFormat.Channels));
+  csSetToAddress::UInt32 (Header + 24,
+    csLittleEndian::UInt32 (m_PlaybackFormat.Freq));
+  csSetToAddress::UInt32 (Header + 28,
+    csLittleEndian::UInt32 (m_PlaybackFormat.Freq * BytesPerFrame));
+  csSetToAddress::UInt16 (Header + 32, csLittleEndian::UInt16 (BytesPerFrame));
+  csSetToAddress::UInt16 (Header + 34,
+    csLittleEndian::UInt16 (m_PlaybackFormat.Bits));
+  memcpy (Header + 36, "data", 4);
+  csSetToAddress::UInt32 (Header + 40,
+    csLittleEndian::UInt32 (uint32 (m_OutputBytes)));
+
+  fseek (m_pOutputFile, 0, SEEK_SET);
+  fwrite (Header, 1, sizeof (Header), m_pOutputFile);
+  fclose (m_pOutputFile);
+  m_pOutputFile = 0;
+
+  RecordEvent(SSEL_DEBUG, "Wrote %zu bytes of sample data to %s",
+    m_OutputBytes, m_OutputFileName.GetData());
+}
+
+void SndSysDriverOffline::ReportStatistics()
+{
+  if (m_RenderedFrames == 0)
+    return;
+
+  double AudioSeconds = (double)m_RenderedFrames / m_PlaybackFormat.Freq;
+  double RenderSeconds = m_RenderTime / 1000000.0;
+  double ElapsedSeconds = m_ElapsedTime / 1000000.0;
+  csReport (m_pObjectReg, CS_REPORTER_SEVERITY_NOTIFY,
+    "crystalspace.sndsys.software.driver.offline",
+    "Rendered %zu frames (%.2f s of audio) in %.2f s, %.2f s of that mixing: "
+    "%.0f frames per second, %.1fx real time",
+    m_RenderedFrames, AudioSeconds, ElapsedSeconds, RenderSeconds,
+    RenderSeconds > 0.0 ? m_RenderedFrames / RenderSeconds : 0.0,
+    RenderSeconds > 0.0 ? AudioSeconds / RenderSeconds : 0.0);
+}
+
+void SndSysDriverOffline::Run()
+{
+  size_t BytesPerFrame = m_PlaybackFormat.Bits/8 * m_PlaybackFormat.Channels;
+  unsigned char *pSoundBuffer = new unsigned char [m_BlockFrames * BytesPerFrame];
+
+  m_RenderedFrames = 0;
+  m_RenderTime = 0;
+  csMicroTicks StartTime = csGetMicroTicks();
+
+  // The main loop of the background thread
+  while (m_bRunning)
+  {
+    if ((m_MaxFrames > 0) && (m_RenderedFrames >= m_MaxFrames))
+    {
+      // All requested audio is rendered, idle until stopped
+      csSleep(10);
+      continue;
+    }
+
+    size_t NeededFrames = m_BlockFrames;
+    if ((m_MaxFrames > 0) && (m_MaxFrames - m_RenderedFrames < NeededFrames))
+      NeededFrames = m_MaxFrames - m_RenderedFrames;
+
+    csMicroTicks BlockStart = csGetMicroTicks();
+    size_t Frames = m_pAttachedRenderer->FillDriverBuffer(pSoundBuffer,
+      NeededFrames, 0, 0);
+    csMicroTicks BlockEnd = csGetMicroTicks();
+    m_RenderTime += BlockEnd - BlockStart;
+
+    // The simulated clock always advances by the requested frames
+    if (Frames < NeededFrames)
+      memset (pSoundBuffer + Frames * BytesPerFrame, 0,
+        (NeededFrames - Frames) * BytesPerFrame);
+    m_RenderedFrames += NeededFrames;
+
+    if (m_pOutputFile)
+    {
+      size_t Bytes = NeededFrames * BytesPerFrame;
+      if (fwrite (pSoundBuffer, 1, Bytes, m_pOutputFile) == Bytes)
+        m_OutputBytes += Bytes;
+      else
+        RecordEvent(SSEL_ERROR, "Failed to write to %s", m_OutputFileName.GetData());
+    }
+
+    if (m_Speed > 0.0f)
+    {
+      // Wait until the wall clock catches up with the simulated clock
+      csMicroTicks Target = StartTime +
+        (csMicroTicks)(m_RenderedFrames * 1000000.0 / (m_PlaybackFormat.Freq * m_Speed));
+      csMicroTicks Now = csGetMicroTicks();
+      if (Target > Now + 1000)
+        csSleep((int)((Target - Now) / 1000));
+    }
+
+    if ((m_MaxFrames > 0) && (m_RenderedFrames >= m_MaxFrames))
+    {
+      m_ElapsedTime = csGetMicroTicks() - StartTime;
+      ReportStatistics();
+    }
+  }
+  RecordEvent(SSEL_DEBUG, "Main run loop complete.  Shutting down.");
+
+  if ((m_MaxFrames == 0) || (m_RenderedFrames < m_MaxFrames))
+  {
+    m_ElapsedTime = csGetMicroTicks() - StartTime;
+    ReportStatistics();
+  }
+
+  delete[] pSoundBuffer;
+}
+
+
+}
+CS_PLUGIN_NAMESPACE_END(SndSysOffline)
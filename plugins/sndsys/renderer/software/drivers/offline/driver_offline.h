@@ -0,0 +1,175 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+
+#ifndef SNDSYS_SOFTWARE_DRIVER_OFFLINE_H
+#define SNDSYS_SOFTWARE_DRIVER_OFFLINE_H
+
+#include "csutil/csstring.h"
+#include "csutil/threading/thread.h"
+
+#include "iutil/eventh.h"
+#include "iutil/comp.h"
+
+#include "isndsys/ss_structs.h"
+#include "isndsys/ss_driver.h"
+#include "isndsys/ss_eventrecorder.h"
+
+
+CS_PLUGIN_NAMESPACE_BEGIN(SndSysOffline)
+{
+
+class SndSysDriverOffline;
+
+class SndSysDriverRunnable : public CS::Threading::Runnable
+{
+private:
+  SndSysDriverOffline* m_pParent;
+
+public:
+  SndSysDriverRunnable (SndSysDriverOffline* pParent)
+    : m_pParent (pParent)
+  { }
+  virtual ~SndSysDriverRunnable () { }
+
+  virtual void Run ();
+};
+
+/**
+ * Offline implementation of the iSndSysSoftwareDriver interface.
+ *
+ * Instead of following the clock of a sound device, the renderer is asked
+ * for fixed size blocks as fast as it can deliver them (or at a fixed multiple
+ * of real time).  The output can be written to a WAV file, and the mixing
+ * throughput is reported when the driver stops.  The amount of audio that is
+ * rendered only depends on the configuration, which makes this driver
+ * suitable for benchmarks and batch export.
+ */
+class SndSysDriverOffline :
+  public scfImplementation2<SndSysDriverOffline, iComponent, iSndSysSoftwareDriver>
+{
+public:
+  SndSysDriverOffline(iBase *piBase);
+  virtual ~SndSysDriverOffline();
+
+  ////
+  // Interface implementation
+  ////
+
+  //------------------------
+  // iComponent
+  //------------------------
+public:
+  virtual bool Initialize (iObjectRegistry *obj_reg);
+
+  //------------------------
+  // iSndSysSoftwareDriver
+  //------------------------
+public:
+
+  /// Called to initialize the driver
+  bool Open (csSndSysRendererSoftware* pRenderer,
+    csSndSysSoundFormat *pRequestedFormat);
+
+  /// Called to shutdown the driver
+  void Close ();
+
+  /// Start the thread that will drive audio
+  bool StartThread();
+
+  /// Stop the background thread
+  void StopThread();
+
+
+  ////
+  // Member Functions
+  ////
+public:
+  /// The thread runnable procedure
+  void Run ();
+
+protected:
+  /// Send a message to the sound system event recorder as the driver
+  void RecordEvent(SndSysEventLevel Severity, const char* msg, ...);
+
+  /// Create the output file and write a WAV header with empty sizes
+  bool OpenOutputFile();
+
+  /// Fill in the sizes in the WAV header and close the output file
+  void CloseOutputFile();
+
+  /// Report the number of frames rendered and the time it took
+  void ReportStatistics();
+
+  ////
+  // Member Variables
+  ////
+protected:
+  /// Interface to the global object registry
+  iObjectRegistry *m_pObjectReg;
+
+  /// The renderer that's using this sound driver
+  csSndSysRendererSoftware *m_pAttachedRenderer;
+
+  /// The playback audio format, of course
+  csSndSysSoundFormat m_PlaybackFormat;
+
+  /// A flag used to shut down the running background thread.
+  volatile bool m_bRunning;
+
+  /// A reference to the CS interface for our background thread
+  csRef<CS::Threading::Thread> m_pBGThread;
+
+  /// The event recorder interface, if active
+  csRef<iSndSysEventRecorder> m_EventRecorder;
+
+  /// Number of frames requested from the renderer at once
+  size_t m_BlockFrames;
+
+  /// Rendering speed as a multiple of real time, 0 to render as fast as possible
+  float m_Speed;
+
+  /// Duration to render in seconds before stopping, 0 for no limit
+  float m_Duration;
+
+  /// Number of frames to render before stopping, 0 for no limit
+  size_t m_MaxFrames;
+
+  /// Native path of the WAV file to write, empty to discard the output
+  csString m_OutputFileName;
+
+  /// The WAV file being written
+  FILE *m_pOutputFile;
+
+  /// Number of bytes of sample data written to the WAV file
+  size_t m_OutputBytes;
+
+  /// Total number of frames rendered
+  size_t m_RenderedFrames;
+
+  /// Time spent inside the renderer
+  csMicroTicks m_RenderTime;
+
+  /// Wall clock time between the start and the end of rendering
+  csMicroTicks m_ElapsedTime;
+};
+
+}
+CS_PLUGIN_NAMESPACE_END(SndSysOffline)
+
+#endif // #ifndef SNDSYS_SOFTWARE_DRIVER_OFFLINE_H
@@ -33,6 +33,7 @@
 
 #include "source.h"
 #include "listener.h"
+#include "mixkernels.h"
 
 using namespace CS::SndSys;
 
@@ -233,9 +234,8 @@ public:
     {
       second_filter->Apply(second_props);
 
-      size_t i;
-      for (i=0;i<properties.buffer_samples;i++)
-        properties.work_buffer[i]+=second_buffer[i];
+      SndSysMix::Add(properties.work_buffer, second_buffer,
+        properties.buffer_samples);
     }
   }
 
@@ -280,107 +280,142 @@ protected:
 };
 
 
+/// Ring buffer holding the most recent samples passed through a filter.
+//
+//  Replaces shifting a one second history buffer on every block.  The size
+//  is a power of two so positions simply wrap with a mask.
+class SndSysSourceSoftwareDelayLine
+{
+public:
+  SndSysSourceSoftwareDelayLine() : buffer(0), size(0), write_pos(0)
+  {
+  }
+  ~SndSysSourceSoftwareDelayLine()
+  {
+    delete[] buffer;
+  }
+
+  /// Make room for at least the given number of samples.  Clears the history.
+  void Setup(size_t min_samples)
+  {
+    size_t new_size=1;
+    while (new_size < min_samples)
+      new_size<<=1;
+    delete[] buffer;
+    buffer=new csSoundSample[new_size];
+    size=new_size;
+    write_pos=0;
+    memset(buffer, 0, sizeof(csSoundSample) * size);
+  }
+
+  bool IsSetup() const { return buffer != 0; }
+
+  /// Largest delay that can be applied to a block of the given length.
+  size_t GetMaxDelay(size_t block_samples) const
+  {
+    return (block_samples < size) ? size - block_samples : 0;
+  }
+
+  /// Append a block of samples to the history.
+  void Write(const csSoundSample *src, size_t samples)
+  {
+    if (samples > size)
+    {
+      src+=samples-size;
+      samples=size;
+    }
+    size_t first=size-write_pos;
+    if (first > samples) first=samples;
+    memcpy(buffer+write_pos, src, sizeof(csSoundSample) * first);
+    memcpy(buffer, src+first, sizeof(csSoundSample) * (samples-first));
+    write_pos=(write_pos+samples) & (size-1);
+  }
+
+  /// Copy the last written block of samples delayed by \a delay samples.
+  void Read(csSoundSample *dest, size_t samples, size_t delay) const
+  {
+    size_t start=(write_pos-samples-delay) & (size-1);
+    size_t first=size-start;
+    if (first > samples) first=samples;
+    memcpy(dest, buffer+start, sizeof(csSoundSample) * first);
+    memcpy(dest+first, buffer, sizeof(csSoundSample) * (samples-first));
+  }
+
+  /// Add the last written block delayed by \a delay samples, scaled by gain.
+  void AddScaled(csSoundSample *dest, size_t samples, size_t delay,
+    float gain) const
+  {
+    size_t start=(write_pos-samples-delay) & (size-1);
+    size_t first=size-start;
+    if (first > samples) first=samples;
+    SndSysMix::AddScaled(dest, buffer+start, first, gain);
+    SndSysMix::AddScaled(dest+first, buffer, samples-first, gain);
+  }
+
+protected:
+  csSoundSample *buffer;
+  size_t size;
+  size_t write_pos;
+};
+
+/// Delay a block by a number of samples, taking the start from the history.
+static inline void SndSysApplyDelay(SndSysSourceSoftwareDelayLine &history,
+  iSndSysSoftwareFilter3DProperties &properties, float delay_time)
+{
+  size_t samples=properties.buffer_samples;
+  // Keep at least a second of history
+  size_t frequency=properties.sound_format->Freq;
+  if (!history.IsSetup() || (history.GetMaxDelay(samples) < frequency))
+    history.Setup(frequency + samples);
+
+  history.Write(properties.work_buffer, samples);
+
+  float fsamples = delay_time * frequency;
+  size_t delay_samples = (fsamples > 0.0f) ? (size_t)fsamples : 0;
+  if (delay_samples > frequency)
+    delay_samples=frequency;
+
+  if (delay_samples>0)
+    history.Read(properties.work_buffer, samples, delay_samples);
+}
+
 class SndSysSourceSoftwareFilter_ITDDelay :
   public SndSysSourceSoftwareFilter_Base
 {
 public:
   SndSysSourceSoftwareFilter_ITDDelay() :
-      SndSysSourceSoftwareFilter_Base(), history_buffer(0), history_samples(0)
+      SndSysSourceSoftwareFilter_Base()
       {
       }
       virtual ~SndSysSourceSoftwareFilter_ITDDelay()
       {
-        delete[] history_buffer;
-      }
-
-      bool SetupHistoryBuffer(int frequency)
-      {
-        delete[] history_buffer;
-        history_samples=frequency;
-        history_buffer=new csSoundSample[history_samples];
-        if (!history_buffer)
-        {
-          history_samples=0;
-          return false;
-        }
-        memset(history_buffer,0,sizeof(csSoundSample) * history_samples);
-        return true;
       }
 
-
       void Apply(iSndSysSoftwareFilter3DProperties &properties)
       {
-        if (!history_buffer && !SetupHistoryBuffer(properties.sound_format->Freq))
-          return;
-
-        // shift the history buffer
-        size_t history_shift=properties.buffer_samples;
-        if (history_shift > history_samples)
-          history_shift=history_samples;
-
-        //Report(properties.reporter, CS_REPORTER_SEVERITY_DEBUG, 
-        //"History shift is %u", history_shift);
-
-        memcpy(history_buffer, &(history_buffer[history_shift]), 
-          sizeof(csSoundSample) * (history_samples - history_shift));
-        memcpy(&(history_buffer[history_samples-history_shift]), 
-          properties.work_buffer, sizeof(csSoundSample) * history_shift);
-
         /* Calculate the delay for this channel, this is based off difference in 
         * distance between the closest channel and this channel */
         float delay_dist = 
           properties.speaker_distance[properties.channel] -
           properties.closest_speaker_distance;
-        float time = delay_dist / 331.4f;
-        float fsamples = time * properties.sound_format->Freq;
-        size_t delay_samples = (size_t)fsamples;
-
-        if (delay_samples<1)
-          delay_samples=0;
-        if (delay_samples>history_samples)
-          delay_samples=history_samples;
-        if (delay_samples>properties.buffer_samples)
-          delay_samples=properties.buffer_samples;
-
-        //Report(properties.reporter, CS_REPORTER_SEVERITY_DEBUG, 
-        //"Delay_samples is %u", delay_samples);
-
-        if (delay_samples>0)
-        {
-          if (history_shift + delay_samples > history_samples)
-            delay_samples=history_samples- history_shift;
-          if (delay_samples < properties.buffer_samples)
-          {
-            size_t idx;
-            for (idx=properties.buffer_samples-1;idx>=delay_samples;idx--)
-              properties.work_buffer[idx]=properties.work_buffer[idx-delay_samples];
-            //memcpy(&(properties.work_buffer[delay_samples]), 
-            //properties.work_buffer, 
-            //(properties.buffer_samples- delay_samples) * sizeof(csSoundSample));
-          }
-          memcpy(properties.work_buffer, 
-            &(history_buffer[history_samples-(history_shift + delay_samples)]), 
-            delay_samples * sizeof(csSoundSample));
-        }
+        SndSysApplyDelay(history, properties, delay_dist / 331.4f);
 
         if (next_filter)
           next_filter->Apply(properties);
       }
 protected:
-  csSoundSample *history_buffer;
-  size_t history_samples;
+  SndSysSourceSoftwareDelayLine history;
 };
 
 class SndSysSourceSoftwareFilter_Delay : public SndSysSourceSoftwareFilter_Base
 {
 public:
   SndSysSourceSoftwareFilter_Delay() : SndSysSourceSoftwareFilter_Base(), 
-    history_buffer(0), history_samples(0)
+    delay_time(0.0f)
   {
   }
   virtual ~SndSysSourceSoftwareFilter_Delay()
   {
-    delete[] history_buffer;
   }
 
   void SetDelayTime(float sec)
@@ -388,166 +423,48 @@ public:
     delay_time=sec;
   }
 
-  bool SetupHistoryBuffer(int frequency)
-  {
-    delete[] history_buffer;
-    history_samples=frequency;
-    history_buffer=new csSoundSample[history_samples];
-    if (!history_buffer)
-    {
-      history_samples=0;
-      return false;
-    }
-    memset(history_buffer,0,sizeof(csSoundSample) * history_samples);
-    return true;
-  }
-
-
   void Apply(iSndSysSoftwareFilter3DProperties &properties)
   {
-    if (!history_buffer && !SetupHistoryBuffer(properties.sound_format->Freq))
-      return;
-
-    // shift the history buffer
-    size_t history_shift=properties.buffer_samples;
-    if (history_shift > history_samples)
-      history_shift=history_samples;
-
-    //Report(properties.reporter, CS_REPORTER_SEVERITY_DEBUG, 
-    //"History shift is %u", history_shift);
-
-    memcpy(history_buffer, &(history_buffer[history_shift]), 
-      sizeof(csSoundSample) * (history_samples - history_shift));
-    memcpy(&(history_buffer[history_samples-history_shift]), 
-      properties.work_buffer, sizeof(csSoundSample) * history_shift);
-
-    // Calculate the delay for this channel
-    float fsamples = delay_time * properties.sound_format->Freq;
-    size_t delay_samples = (size_t)fsamples;
-
-    if (delay_samples<1)
-      delay_samples=0;
-    if (delay_samples>history_samples)
-      delay_samples=history_samples;
-    if (delay_samples>properties.buffer_samples)
-      delay_samples=properties.buffer_samples;
-
-    //Report(properties.reporter, CS_REPORTER_SEVERITY_DEBUG, 
-    //"Delay_samples is %u", delay_samples);
-
-    if (delay_samples>0)
-    {
-      if (history_shift + delay_samples > history_samples)
-        delay_samples=history_samples- history_shift;
-      if (delay_samples < properties.buffer_samples)
-      {
-        size_t idx;
-        for (idx=properties.buffer_samples-1;idx>=delay_samples;idx--)
-          properties.work_buffer[idx]=properties.work_buffer[idx-delay_samples];
-        //memcpy(&(properties.work_buffer[delay_samples]), 
-        //properties.work_buffer, 
-        //(properties.buffer_samples- delay_samples) * sizeof(csSoundSample));
-      }
-      memcpy(properties.work_buffer, 
-        &(history_buffer[history_samples-(history_shift + delay_samples)]), 
-        delay_samples * sizeof(csSoundSample));
-    }
+    SndSysApplyDelay(history, properties, delay_time);
 
     if (next_filter)
       next_filter->Apply(properties);
   }
 protected:
-  csSoundSample *history_buffer;
-  size_t history_samples;
+  SndSysSourceSoftwareDelayLine history;
   float delay_time;
 };
 
 class SndSysSourceSoftwareFilter_Reverb : public SndSysSourceSoftwareFilter_Base
 {
 public:
-  SndSysSourceSoftwareFilter_Reverb() : SndSysSourceSoftwareFilter_Base(), 
-    history_buffer(0), history_samples(0)
+  SndSysSourceSoftwareFilter_Reverb() : SndSysSourceSoftwareFilter_Base()
   {
   }
   virtual ~SndSysSourceSoftwareFilter_Reverb()
   {
-    delete[] history_buffer;
   }
 
-  bool SetupHistoryBuffer(int frequency)
-  {
-    delete[] history_buffer;
-    history_samples=frequency;
-    history_buffer=new csSoundSample[history_samples];
-    if (!history_buffer)
-    {
-      history_samples=0;
-      return false;
-    }
-    memset(history_buffer,0,sizeof(csSoundSample) * history_samples);
-    return true;
-  }
-
-
   void Apply(iSndSysSoftwareFilter3DProperties &properties)
   {
-    if (!history_buffer && !SetupHistoryBuffer(properties.sound_format->Freq))
-      return;
+    size_t samples=properties.buffer_samples;
+    size_t frequency=properties.sound_format->Freq;
+    if (!history.IsSetup() || (history.GetMaxDelay(samples) < frequency))
+      history.Setup(frequency + samples);
 
-    // shift the history buffer
-    size_t history_shift=properties.buffer_samples;
-    if (history_shift > history_samples)
-      history_shift=history_samples;
+    history.Write(properties.work_buffer, samples);
 
-    //Report(properties.reporter, CS_REPORTER_SEVERITY_DEBUG, 
-    //"History shift is %u", history_shift);
-
-    memcpy(history_buffer, &(history_buffer[history_shift]), 
-      sizeof(csSoundSample) * (history_samples - history_shift));
-    memcpy(&(history_buffer[history_samples-history_shift]), 
-      properties.work_buffer, sizeof(csSoundSample) * history_shift);
-
-    // Calculate the delay for this channel
+    // Add echoes at 10, 20, 40 and 80ms, each half as loud as the last
     float delay_time=0.01f;
     float delay_intensity_factor=0.2f;
 
     while (delay_time<0.1f)
     {
-      float fsamples=delay_time * properties.sound_format->Freq;
-      size_t delay_samples = (size_t)fsamples;
-
-      if (delay_samples<1)
-        delay_samples=0;
-      if (delay_samples>history_samples)
-        delay_samples=history_samples;
-      if (delay_samples>properties.buffer_samples)
-        delay_samples=properties.buffer_samples;
-
-      //Report(properties.reporter, CS_REPORTER_SEVERITY_DEBUG, 
-      //"Delay_samples is %u", delay_samples);
-
+      size_t delay_samples=(size_t)(delay_time * frequency);
       if (delay_samples>0)
-      {
-        if (history_shift + delay_samples > history_samples)
-          delay_samples=history_samples- history_shift;
-        if (delay_samples < properties.buffer_samples)
-        {
-          size_t idx;
-          for (idx=1;idx<properties.buffer_samples;idx++)
-          {
-            float samp_vol = 
-              history_buffer[history_samples-(delay_samples + history_shift)];
-            samp_vol*=delay_intensity_factor;
-            properties.work_buffer[idx] += (int)samp_vol;
-          }
-          //memcpy(&(properties.work_buffer[delay_samples]), 
-          //properties.work_buffer, 
-          //(properties.buffer_samples-delay_samples)*sizeof(csSoundSample));
-        }
-        //memcpy(properties.work_buffer, 
-        //&(history_buffer[history_samples-(history_shift + delay_samples)]), 
-        //delay_samples * sizeof(csSoundSample));
-      }
+        history.AddScaled(properties.work_buffer, samples, delay_samples,
+          delay_intensity_factor);
+
       delay_time=delay_time*2.0f;
       delay_intensity_factor=delay_intensity_factor/2.0f;
     }
@@ -556,8 +473,7 @@ public:
       next_filter->Apply(properties);
   }
 protected:
-  csSoundSample *history_buffer;
-  size_t history_samples;
+  SndSysSourceSoftwareDelayLine history;
 };
 
 
@@ -576,8 +492,6 @@ public:
   void Apply(iSndSysSoftwareFilter3DProperties &properties)
   {
     float vol;
-    int int_vol;
-    size_t i;
 
     // Turn distance into units based off minimum distance
     float minimum_distance=properties.source_parameters->minimum_distance;
@@ -603,7 +517,6 @@ public:
     else
       vol/=iid_distance;
 
-    int_vol = (int)(SOURCE_INTEGER_VOLUME_MULTIPLE * vol);
 
     /*
     if (debug_cycle[properties.channel]++ >=20)
@@ -616,9 +529,7 @@ public:
     }
     */
 
-    for (i=0;i<properties.buffer_samples;i++)
-      properties.work_buffer[i]=(properties.work_buffer[i] * int_vol)
-      / SOURCE_INTEGER_VOLUME_MULTIPLE;
+    SndSysMix::Scale(properties.work_buffer, properties.buffer_samples, vol);
 
     if (next_filter)
       next_filter->Apply(properties);
@@ -659,10 +570,8 @@ public:
       float vol = 
         (properties.speaker_direction_cos[properties.channel]-cos_far) / range;
 
-      size_t i;
-      for (i=0;i<properties.buffer_samples;i++)
-        properties.work_buffer[i] = 
-        (int)((float)properties.work_buffer[i] * vol);
+      SndSysMix::Scale(properties.work_buffer, properties.buffer_samples,
+        vol);
     }
 
     if (next_filter)
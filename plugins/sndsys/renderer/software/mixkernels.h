@@ -0,0 +1,127 @@
+/*
+  Copyright (C) 2012 by Crystal Space Team
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public
+  License along with this library; if not, write to the Free
+  Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef SNDSYS_RENDERER_SOFTWARE_MIXKERNELS_H
+#define SNDSYS_RENDERER_SOFTWARE_MIXKERNELS_H
+
+/*  Block mixing kernels for the Software Sound Renderer
+ *
+ *  These work on whole blocks of csSoundSample values. Gains are applied in
+ *  floating point, four samples at a time with SSE2 if available. Scaled
+ *  results are truncated towards zero, like the integer code they replace.
+ */
+
+#include "isndsys/ss_structs.h"
+
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace SndSysMix
+{
+  /// Multiply \a count samples in \a buffer by \a gain.
+  static inline void Scale (csSoundSample* buffer, size_t count, float gain)
+  {
+    size_t i = 0;
+#ifdef CS_SUPPORTS_SSE2
+    const __m128 g = _mm_set1_ps (gain);
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128i s = _mm_loadu_si128 ((const __m128i*)(buffer + i));
+      __m128 f = _mm_mul_ps (_mm_cvtepi32_ps (s), g);
+      _mm_storeu_si128 ((__m128i*)(buffer + i), _mm_cvttps_epi32 (f));
+    }
+#endif
+    for (; i < count; i++)
+      buffer[i] = (csSoundSample)((float)buffer[i] * gain);
+  }
+
+  /// Add \a count samples of \a src to \a dest.
+  static inline void Add (csSoundSample* dest, const csSoundSample* src,
+                          size_t count)
+  {
+    size_t i = 0;
+#ifdef CS_SUPPORTS_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128i d = _mm_loadu_si128 ((const __m128i*)(dest + i));
+      __m128i s = _mm_loadu_si128 ((const __m128i*)(src + i));
+      _mm_storeu_si128 ((__m128i*)(dest + i), _mm_add_epi32 (d, s));
+    }
+#endif
+    for (; i < count; i++)
+      dest[i] += src[i];
+  }
+
+  /// Add \a count samples of \a src, multiplied by \a gain, to \a dest.
+  static inline void AddScaled (csSoundSample* dest, const csSoundSample* src,
+                                size_t count, float gain)
+  {
+    size_t i = 0;
+#ifdef CS_SUPPORTS_SSE2
+    const __m128 g = _mm_set1_ps (gain);
+    for (; i + 4 <= count; i += 4)
+    {
+      __m128i d = _mm_loadu_si128 ((const __m128i*)(dest + i));
+      __m128i s = _mm_loadu_si128 ((const __m128i*)(src + i));
+      __m128i f = _mm_cvttps_epi32 (_mm_mul_ps (_mm_cvtepi32_ps (s), g));
+      _mm_storeu_si128 ((__m128i*)(dest + i), _mm_add_epi32 (d, f));
+    }
+#endif
+    for (; i < count; i++)
+      dest[i] += (csSoundSample)((float)src[i] * gain);
+  }
+
+  /// Get the largest absolute value of \a count samples in \a buffer.
+  static inline csSoundSample MaxAbs (const csSoundSample* buffer,
+                                      size_t count)
+  {
+    csSoundSample result = 0;
+    size_t i = 0;
+#ifdef CS_SUPPORTS_SSE2
+    if (count >= 4)
+    {
+      __m128i m = _mm_setzero_si128 ();
+      for (; i + 4 <= count; i += 4)
+      {
+        __m128i s = _mm_loadu_si128 ((const __m128i*)(buffer + i));
+        // abs (s) = (s ^ sign) - sign
+        __m128i sign = _mm_srai_epi32 (s, 31);
+        s = _mm_sub_epi32 (_mm_xor_si128 (s, sign), sign);
+        // No integer max in SSE2, select through a mask
+        __m128i greater = _mm_cmpgt_epi32 (s, m);
+        m = _mm_or_si128 (_mm_and_si128 (greater, s),
+          _mm_andnot_si128 (greater, m));
+      }
+      csSoundSample lanes[4];
+      _mm_storeu_si128 ((__m128i*)lanes, m);
+      for (int l = 0; l < 4; l++)
+        if (lanes[l] > result) result = lanes[l];
+    }
+#endif
+    for (; i < count; i++)
+    {
+      csSoundSample abssamp = buffer[i];
+      if (abssamp < 0) abssamp = -abssamp;
+      if (abssamp > result) result = abssamp;
+    }
+    return result;
+  }
+} // namespace SndSysMix
+
+#endif // #ifndef SNDSYS_RENDERER_SOFTWARE_MIXKERNELS_H
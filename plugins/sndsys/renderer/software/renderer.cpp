@@ -41,10 +41,13 @@
 #include "iutil/virtclk.h"
 #include "iutil/cmdline.h"
 #include "ivaria/reporter.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
 
 #include "listener.h"
 #include "source.h"
 #include "renderer.h"
+#include "mixkernels.h"
 
 
 
@@ -55,13 +58,22 @@ SCF_IMPLEMENT_FACTORY (csSndSysRendererSoftware)
 // Run garbage collection at most 2x per second (it's also always run on shutdown)
 #define SNDSYS_RENDERER_SOFTWARE_GARBAGECOLLECTION_TICKS 500
 
+// Mix on the job queue only if there are at least this many sources to mix
+#define SNDSYS_RENDERER_SOFTWARE_PARALLEL_MIX_SOURCES 16
+
+// Report mixing statistics every 5 seconds if enabled
+#define SNDSYS_RENDERER_SOFTWARE_MIXSTATS_TICKS 5000
+
 //------------------------------------
 // Construction/Destruction functions
 //------------------------------------
 
 csSndSysRendererSoftware::csSndSysRendererSoftware(iBase* pParent) :
   scfImplementationType(this, pParent),
-  m_pObjectRegistry(0), m_pSampleBuffer(0), m_SampleBufferFrames(0),
+  m_pObjectRegistry(0), m_VirtualVoiceThreshold(0.0f), m_MaxVoices(0),
+  m_ReportMixStats(false), m_LastMixStatsReport(0), m_MixStatsBlocks(0),
+  m_MixStatsMixed(0), m_MixStatsVirtual(0), m_MixStatsTime(0),
+  m_pSampleBuffer(0), m_SampleBufferFrames(0),
   m_LastGarbageCollectionTicks(0), m_LastIntensityMultiplier(0)
 {
   m_pObjectRegistry = 0;
@@ -418,6 +430,31 @@ bool csSndSysRendererSoftware::Open ()
 
   RecordEvent(SSEL_DEBUG, "Global Volume set to %.2f (0.0 - 1.0)", m_GlobalVolume);
 
+  // Voice virtualization and mixing setup
+  m_VirtualVoiceThreshold = m_Config->GetFloat("SndSys.VirtualVoiceThreshold", 0.0f);
+  int MaxVoices = m_Config->GetInt("SndSys.MaxVoices", 0);
+  m_MaxVoices = (MaxVoices > 0) ? MaxVoices : 0;
+  m_ReportMixStats = m_Config->GetBool("SndSys.ReportMixStats", false);
+
+  int MixThreads = m_Config->GetInt("SndSys.MixThreads", 1);
+  if (MixThreads <= 0)
+    MixThreads = CS::Platform::GetProcessorCount();
+  if (MixThreads > 1)
+  {
+    // The driver thread mixes too, so it takes one job itself
+    m_MixJobQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+      MixThreads - 1, CS::Threading::THREAD_PRIO_NORMAL, "sound mixer"));
+    for (int i = 0; i < MixThreads; i++)
+    {
+      csRef<SndSysMixJob> job;
+      job.AttachNew (new SndSysMixJob ());
+      m_MixJobs.Push (job);
+    }
+  }
+
+  RecordEvent(SSEL_DEBUG, "Mixing with %d thread(s), virtual voice threshold %.4f, voice limit %u",
+    MixThreads > 1 ? MixThreads : 1, m_VirtualVoiceThreshold, m_MaxVoices);
+
   return m_pSoundDriver->StartThread();
 }
 
@@ -433,6 +470,10 @@ void csSndSysRendererSoftware::Close ()
     m_pSoundDriver->Close();
   }
 
+  // Stop the mixing threads
+  m_MixJobQueue.Invalidate();
+  m_MixJobs.Empty();
+
   // Clear out all filters
   m_OutputFilterQueue.ClearFilterList();
 
@@ -857,16 +898,103 @@ size_t csSndSysRendererSoftware::FillDriverBuffer(void *buf1, size_t buf1_frames
   AdvanceStreams(needed_frames);
 
   // Mix all the sources
+  csMicroTicks mix_start=csGetMicroTicks();
+  SelectMixSources(needed_frames);
+  size_t virtual_sources=m_ActiveSources.GetSize() - m_MixSources.GetSize();
+
+  if (m_MixJobQueue && (m_MixSources.GetSize() >= SNDSYS_RENDERER_SOFTWARE_PARALLEL_MIX_SOURCES))
+    needed_frames=MixSourcesParallel(needed_frames);
+  else
+    needed_frames=MixSources(needed_frames);
+
+  MixStatsReport(virtual_sources, csGetMicroTicks() - mix_start);
+
+
+  // Normalize the sample buffer
+  NormalizeSampleBuffer(needed_frames * m_PlaybackFormat.Channels);
+//  m_pSoundCompressor->ApplyCompression(m_pSampleBuffer, needed_frames * m_PlaybackFormat.Channels);
+
+
+  if (m_OutputFilterQueue.GetOutputFilterCount()>0)
+    m_OutputFilterQueue.QueueSampleBuffer(m_pSampleBuffer, needed_frames, m_PlaybackFormat.Channels);
+
+  // Copy normalized data to the driver
+  CopySampleBufferToDriverBuffer (buf1, buf1_frames * m_PlaybackFormat.Channels * m_PlaybackFormat.Bits/8,
+    buf2, buf2_frames * m_PlaybackFormat.Channels * m_PlaybackFormat.Bits/8, needed_frames);
+
+  //csTicks end_ticks=csGetTicks();
+//  Report (CS_REPORTER_SEVERITY_DEBUG, "Processing time: %u ticks.", end_ticks-current_ticks);
+
+
+  return needed_frames;
+}
+
+namespace
+{
+  struct SourceAudibility
+  {
+    iSndSysSourceSoftware *source;
+    float audibility;
+  };
+
+  // Loudest first
+  static int CompareAudibility (SourceAudibility const& a,
+                                SourceAudibility const& b)
+  {
+    if (a.audibility > b.audibility) return -1;
+    if (a.audibility < b.audibility) return 1;
+    return 0;
+  }
+}
+
+void csSndSysRendererSoftware::SelectMixSources(size_t Frames)
+{
+  m_MixSources.Empty();
+
+  csArray<SourceAudibility> candidates;
   size_t maxidx=m_ActiveSources.GetSize();
   size_t currentidx;
   for (currentidx=0;currentidx<maxidx;currentidx++)
+  {
+    iSndSysSourceSoftware *source=m_ActiveSources.Get(currentidx);
+    float audibility=source->GetAudibility();
+
+    // Too quiet to be worth mixing, keep the source in step with its stream
+    if (audibility <= m_VirtualVoiceThreshold)
+    {
+      source->SkipFrames(Frames);
+      continue;
+    }
+    SourceAudibility entry;
+    entry.source=source;
+    entry.audibility=audibility;
+    candidates.Push(entry);
+  }
+
+  // Only mix the loudest sources if there are more than the limit
+  if ((m_MaxVoices > 0) && (candidates.GetSize() > m_MaxVoices))
+  {
+    candidates.Sort(CompareAudibility);
+    for (currentidx=m_MaxVoices;currentidx<candidates.GetSize();currentidx++)
+      candidates[currentidx].source->SkipFrames(Frames);
+    candidates.Truncate(m_MaxVoices);
+  }
+
+  for (currentidx=0;currentidx<candidates.GetSize();currentidx++)
+    m_MixSources.Push(candidates[currentidx].source);
+}
+
+size_t csSndSysRendererSoftware::MixSources(size_t Frames)
+{
+  size_t needed_frames=Frames;
+  size_t maxidx=m_MixSources.GetSize();
+  size_t currentidx;
+  for (currentidx=0;currentidx<maxidx;currentidx++)
   {
     size_t provided_frames;
-    //Report (CS_REPORTER_SEVERITY_DEBUG,
-      //"Requesting %d samples from source.", needed_samples);
 
     // The return from this function is this number of samples actually available
-    provided_frames = m_ActiveSources.Get(currentidx)->MergeIntoBuffer (m_pSampleBuffer, needed_frames);
+    provided_frames = m_MixSources.Get(currentidx)->MergeIntoBuffer (m_pSampleBuffer, Frames);
 
     if (provided_frames==0)
     {
@@ -874,10 +1002,10 @@ size_t csSndSysRendererSoftware::FillDriverBuffer(void *buf1, size_t buf1_frames
     }
     else
     {
-      CS_ASSERT (provided_frames <= needed_frames);
+      CS_ASSERT (provided_frames <= Frames);
 
       RecordEvent(SSEL_DEBUG, "Source index [%d] provided [%d] out of [%d] requested frames.", currentidx,
-        provided_frames, needed_frames);
+        provided_frames, Frames);
 
       // BUG: I think if a later source returns less samples than requested than we are throwing away samples from the earlier source
       //      that we will never get back, aren't we?  - A.M.
@@ -885,29 +1013,117 @@ size_t csSndSysRendererSoftware::FillDriverBuffer(void *buf1, size_t buf1_frames
       // FIX: (maybe) We may need a way to shift the source play cursor backwards - after we find the minimum number of available samples from
       //      all sources, if it's less than initially requested, then we iterate over the sources again, shifting the cursor back.
 
-      // Reduce the number of samples we request from future sources, as well as the number we provide to the driver
-      needed_frames=provided_frames;
+      // Reduce the number of samples we provide to the driver
+      if (provided_frames < needed_frames)
+        needed_frames=provided_frames;
     }
   }
+  return needed_frames;
+}
 
+size_t csSndSysRendererSoftware::MixSourcesParallel(size_t Frames)
+{
+  size_t job_count=m_MixJobs.GetSize();
+  size_t job_idx;
+  for (job_idx=0;job_idx<job_count;job_idx++)
+  {
+    SndSysMixJob *job=m_MixJobs[job_idx];
+    job->sources.Empty();
+    job->frames=Frames;
+    job->channels=m_PlaybackFormat.Channels;
+  }
 
-  // Normalize the sample buffer
-  NormalizeSampleBuffer(needed_frames * m_PlaybackFormat.Channels);
-//  m_pSoundCompressor->ApplyCompression(m_pSampleBuffer, needed_frames * m_PlaybackFormat.Channels);
+  // Sources playing the same stream read from it at the same time, so they
+  //  are kept on the same job.
+  size_t maxidx=m_MixSources.GetSize();
+  size_t currentidx;
+  for (currentidx=0;currentidx<maxidx;currentidx++)
+  {
+    iSndSysSourceSoftware *source=m_MixSources.Get(currentidx);
+    uintptr_t stream=(uintptr_t)(iSndSysStream *)source->GetStream();
+    m_MixJobs[(stream / 16) % job_count]->sources.Push(source);
+  }
 
+  for (job_idx=0;job_idx<job_count;job_idx++)
+    m_MixJobQueue->Enqueue(m_MixJobs[job_idx]);
 
-  if (m_OutputFilterQueue.GetOutputFilterCount()>0)
-    m_OutputFilterQueue.QueueSampleBuffer(m_pSampleBuffer, needed_frames, m_PlaybackFormat.Channels);
+  size_t needed_frames=Frames;
+  size_t samples=Frames * m_PlaybackFormat.Channels;
+  for (job_idx=0;job_idx<job_count;job_idx++)
+  {
+    SndSysMixJob *job=m_MixJobs[job_idx];
+    // Runs the job here if no mixing thread has picked it up yet
+    m_MixJobQueue->PullAndRun(job);
+    if (job->sources.GetSize() == 0)
+      continue;
+    SndSysMix::Add(m_pSampleBuffer, job->buffer.GetArray(), samples);
+    if (job->provided_frames < needed_frames)
+      needed_frames=job->provided_frames;
+  }
+  return needed_frames;
+}
 
-  // Copy normalized data to the driver
-  CopySampleBufferToDriverBuffer (buf1, buf1_frames * m_PlaybackFormat.Channels * m_PlaybackFormat.Bits/8,
-    buf2, buf2_frames * m_PlaybackFormat.Channels * m_PlaybackFormat.Bits/8, needed_frames);
+void csSndSysRendererSoftware::MixStatsReport(size_t Virtual, csMicroTicks Time)
+{
+  if (!m_ReportMixStats)
+    return;
 
-  //csTicks end_ticks=csGetTicks();
-//  Report (CS_REPORTER_SEVERITY_DEBUG, "Processing time: %u ticks.", end_ticks-current_ticks);
+  m_MixStatsBlocks++;
+  m_MixStatsMixed+=m_MixSources.GetSize();
+  m_MixStatsVirtual+=Virtual;
+  m_MixStatsTime+=Time;
 
+  csTicks CurrentTime=csGetTicks();
+  if (CurrentTime < m_LastMixStatsReport + SNDSYS_RENDERER_SOFTWARE_MIXSTATS_TICKS)
+    return;
 
-  return needed_frames;
+  double blocks=(double)m_MixStatsBlocks;
+  Report (CS_REPORTER_SEVERITY_NOTIFY,
+    "Mixed %zu blocks: %.1f sources and %.1f virtual sources per block, %.1f us per block, %.2f us per mixed source",
+    m_MixStatsBlocks, m_MixStatsMixed / blocks, m_MixStatsVirtual / blocks,
+    m_MixStatsTime / blocks,
+    m_MixStatsMixed > 0 ? (double)m_MixStatsTime / m_MixStatsMixed : 0.0);
+
+  // Decoding statistics of the streams playing now, since they started
+  size_t DecodingStreams=0, Underruns=0;
+  csMicroTicks DecodeTime=0;
+  for (size_t i=0;i<m_ActiveStreams.GetSize();i++)
+  {
+    csRef<iSndSysStreamDecodeStats> Stats=
+      scfQueryInterface<iSndSysStreamDecodeStats> (m_ActiveStreams[i]);
+    if (!Stats || !Stats->IsDecodingAhead())
+      continue;
+    DecodingStreams++;
+    Underruns+=Stats->GetUnderrunCount();
+    DecodeTime+=Stats->GetDecodeTime();
+  }
+  if (DecodingStreams > 0)
+    Report (CS_REPORTER_SEVERITY_NOTIFY,
+      "%zu streams decoding ahead: %zu underruns, %.1f ms spent decoding",
+      DecodingStreams, Underruns, DecodeTime / 1000.0);
+
+  m_LastMixStatsReport=CurrentTime;
+  m_MixStatsBlocks=0;
+  m_MixStatsMixed=0;
+  m_MixStatsVirtual=0;
+  m_MixStatsTime=0;
+}
+
+void SndSysMixJob::Run()
+{
+  size_t samples=frames * channels;
+  buffer.SetSize(samples);
+  memset(buffer.GetArray(), 0, sizeof(csSoundSample) * samples);
+
+  provided_frames=frames;
+  size_t maxidx=sources.GetSize();
+  size_t currentidx;
+  for (currentidx=0;currentidx<maxidx;currentidx++)
+  {
+    size_t provided=sources[currentidx]->MergeIntoBuffer (buffer.GetArray(), frames);
+    if ((provided > 0) && (provided < provided_frames))
+      provided_frames=provided;
+  }
 }
 
 void csSndSysRendererSoftware::NormalizeSampleBuffer(size_t used_samples)
@@ -923,12 +1139,7 @@ void csSndSysRendererSoftware::NormalizeSampleBuffer(size_t used_samples)
   desiredintensity=desiredintensity<<16;
 
   // First scan, find the max abs sample value
-  for (sample_idx=0;sample_idx<used_samples;sample_idx++)
-  {
-    csSoundSample abssamp=m_pSampleBuffer[sample_idx];
-    if (abssamp<0) abssamp=-abssamp;
-    if (abssamp > maxintensity) maxintensity=abssamp;
-  }
+  maxintensity=SndSysMix::MaxAbs(m_pSampleBuffer, used_samples);
 
   RecordEvent(SSEL_DEBUG, "Maximum sample intensity is %d", maxintensity);
 
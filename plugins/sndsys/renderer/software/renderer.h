@@ -28,6 +28,9 @@
 #include "csgeom/vector3.h"
 
 #include "csutil/array.h"
+#include "csutil/dirtyaccessarray.h"
+#include "csutil/refarr.h"
+#include "iutil/job.h"
 
 #include "isndsys/ss_structs.h"
 #include "isndsys/ss_renderer.h"
@@ -83,6 +86,26 @@ struct iReporter;
 
 using namespace CS::SndSys;
 
+/// Job mixing a group of sources into a buffer of its own
+class SndSysMixJob : public scfImplementation1<SndSysMixJob, iJob>
+{
+public:
+  SndSysMixJob() : scfImplementationType(this), frames(0), channels(0),
+    provided_frames(0) {}
+
+  /// The sources to mix
+  csArray<iSndSysSourceSoftware *> sources;
+  /// The mixed samples, laid out like the renderer sample buffer
+  csDirtyAccessArray<csSoundSample> buffer;
+  /// Number of frames to mix
+  size_t frames;
+  int channels;
+  /// Lowest number of frames provided by any of the sources
+  size_t provided_frames;
+
+  void Run();
+};
+
 class csSndSysRendererSoftware : 
   public scfImplementation4<csSndSysRendererSoftware, iComponent, iEventHandler,  iSndSysRenderer, iSndSysRendererSoftware>
 {
@@ -202,6 +225,29 @@ protected:
   csArray<iSndSysStream *> m_ActiveStreams;
 
 
+  /// The sources mixed in the current block, the others are virtual
+  csArray<iSndSysSourceSoftware *> m_MixSources;
+
+  /// Sources with an audibility at or below this are not mixed
+  float m_VirtualVoiceThreshold;
+
+  /// Maximum number of sources mixed in a block, 0 for no limit
+  size_t m_MaxVoices;
+
+  /// Job queue for mixing sources in parallel, 0 if mixing is done on the driver thread
+  csRef<iJobQueue> m_MixJobQueue;
+
+  /// One job per mixing thread
+  csRefArray<SndSysMixJob> m_MixJobs;
+
+  /// Set to true if mixing statistics should be reported
+  bool m_ReportMixStats;
+  /// The last time mixing statistics were reported
+  csTicks m_LastMixStatsReport;
+  /// Mixing statistics accumulated since the last report
+  size_t m_MixStatsBlocks, m_MixStatsMixed, m_MixStatsVirtual;
+  csMicroTicks m_MixStatsTime;
+
   /// Pointer to a buffer of sound samples used to mix data prior to sending to the driver
   csSoundSample *m_pSampleBuffer;
 
@@ -314,6 +360,18 @@ protected:
   //    which have pending notification events
   void ProcessStreamDispatch();
 
+  /// Pick the sources to mix in this block and advance the others without mixing
+  void SelectMixSources(size_t Frames);
+
+  /// Mix the selected sources into the sample buffer, returns the frames mixed
+  size_t MixSources(size_t Frames);
+
+  /// Mix the selected sources on the mixing job queue, returns the frames mixed
+  size_t MixSourcesParallel(size_t Frames);
+
+  /// Report mixing statistics if enabled
+  void MixStatsReport(size_t Virtual, csMicroTicks Time);
+
   void NormalizeSampleBuffer(size_t used_samples);
   void CopySampleBufferToDriverBuffer(void *drvbuf1,size_t drvbuf1_len,
     void *drvbuf2, size_t drvbuf2_len, size_t samples_per_channel);
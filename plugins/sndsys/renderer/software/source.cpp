@@ -36,6 +36,7 @@
 #include "renderer.h"
 #include "listener.h"
 #include "filters.h"
+#include "mixkernels.h"
 
 #include "source.h"
 
@@ -243,7 +244,7 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
     int buffer_idx;
     csSoundSample mix;
     unsigned char *src_ptr;
-    size_t second_half_offset=frame_count;
+    size_t second_half_offset=original_frame_count;
 
     buffer_idx=0;
 
@@ -308,7 +309,7 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
     int buffer_idx;
     csSoundSample mix;
     short *src_ptr;
-    size_t second_half_offset=frame_count;
+    size_t second_half_offset=original_frame_count;
 
     buffer_idx=0;
 
@@ -401,6 +402,36 @@ size_t SndSysSourceSoftwareBasic::MergeIntoBuffer(csSoundSample *channel_buffer,
 
 
 
+float SndSysSourceSoftwareBasic::GetAudibility()
+{
+  UpdateQueuedParameters();
+
+  if ((sound_stream->GetPauseState() == CS_SNDSYS_STREAM_PAUSED) && 
+      (sound_stream->GetPosition() == stream_position))
+    return 0.0f;
+  return active_parameters.volume;
+}
+
+void SndSysSourceSoftwareBasic::SkipFrames(size_t frame_count)
+{
+  void *buf1,*buf2;
+  size_t buf1_len,buf2_len;
+
+  UpdateQueuedParameters();
+
+  // A muted source isn't synchronized with the stream, see UpdateQueuedParameters()
+  if (active_parameters.volume == 0.0f)
+    return;
+
+  // Read and discard the data so the source keeps its place in the stream
+  int bytes_per_frame=renderer->m_PlaybackFormat.Bits * renderer->m_PlaybackFormat.Channels/8;
+  sound_stream->GetDataPointers (&stream_position, frame_count * bytes_per_frame,
+    &buf1, &buf1_len, &buf2, &buf2_len);
+}
+
+
+
+
 //////////////////////////////////////////////////////////////////////////
 //
 //  SndSysSourceSoftware3D
@@ -879,12 +910,12 @@ size_t SndSysSourceSoftware3D::MergeIntoBuffer (csSoundSample *channel_buffer,
     if (ProcessSoundChain(channel, frame_count))
     {
       // If ProcessSoundChain returns true, merge the samples into the renderer buffer
-      csSoundSample *channel_base=&(channel_buffer[channel * frame_count]);
+      //  Channels are laid out by the requested frame count
+      csSoundSample *channel_base=&(channel_buffer[channel * original_frame_count]);
       // If there's at least one output filter, queue samples for it
       if (pFilterSampleBuffer)
         pFilterSampleBuffer->AddSamples(working_buffer, frame_count);
-      for (size_t i=0;i<frame_count;i++)
-        channel_base[i]+=working_buffer[i];
+      SndSysMix::Add(channel_base, working_buffer, frame_count);
     }
     else
     {
@@ -945,6 +976,58 @@ size_t SndSysSourceSoftware3D::MergeIntoBuffer (csSoundSample *channel_buffer,
   return original_frame_count;
 }
 
+float SndSysSourceSoftware3D::GetAudibility()
+{
+  UpdateQueuedParameters();
+
+  if (active_parameters.volume == 0.0f)
+    return 0.0f;
+  if ((sound_stream->GetPauseState() == CS_SNDSYS_STREAM_PAUSED) && 
+    (sound_stream->GetPosition() == stream_position))
+    return 0.0f;
+
+  csVector3 listener_to_source;
+  if (sound_stream->Get3dMode() == CS_SND3D_RELATIVE)
+    listener_to_source=active_parameters.position;
+  else
+    listener_to_source=renderer->m_pListener->active_properties.world_to_listener.Other2This(active_parameters.position);
+  float distance=listener_to_source.Norm();
+
+  if ((active_parameters.maximum_distance != CS_SNDSYS_SOURCE_DISTANCE_INFINITE) &&
+    (distance > active_parameters.maximum_distance))
+    return 0.0f;
+
+  // Same rolloff as applied by the IID filter
+  float minimum_distance=active_parameters.minimum_distance;
+  if (minimum_distance < 0.000001f)
+    minimum_distance=0.000001f;
+  float rolloff_distance=distance/minimum_distance;
+  if (rolloff_distance < 1.0f)
+    return active_parameters.volume;
+  float rollofffactor=renderer->m_pListener->active_properties.rolloff_factor;
+  if (rollofffactor != 1.0f)
+    return active_parameters.volume / pow(rolloff_distance, rollofffactor);
+  return active_parameters.volume / rolloff_distance;
+}
+
+void SndSysSourceSoftware3D::SkipFrames(size_t frame_count)
+{
+  void *buf1,*buf2;
+  size_t buf1_len,buf2_len;
+
+  UpdateQueuedParameters();
+
+  // A muted source isn't synchronized with the stream, see UpdateQueuedParameters()
+  if (active_parameters.volume == 0.0f)
+    return;
+
+  // Read and discard the data so the source keeps its place in the stream.
+  //  Streams attached to 3D sources are always mono.
+  int bytes_per_frame=renderer->m_PlaybackFormat.Bits/8;
+  sound_stream->GetDataPointers (&stream_position, frame_count * bytes_per_frame,
+    &buf1, &buf1_len, &buf2, &buf2_len);
+}
+
 bool SndSysSourceSoftware3D::ProcessSoundChain(int channel, size_t buffer_samples)
 {
 
@@ -145,6 +145,12 @@ public:
   virtual size_t MergeIntoBuffer(csSoundSample *frame_buffer,
     size_t frame_count);
 
+  /// Renderer convenience interface - Estimated volume at the listener
+  virtual float GetAudibility();
+
+  /// Renderer convenience interface - Advance without mixing
+  virtual void SkipFrames(size_t frame_count);
+
   /**
    * Renderer convenience interface - Called to provide processing of
    * output filters
@@ -266,6 +272,12 @@ public:
   virtual size_t MergeIntoBuffer(csSoundSample *frame_buffer, 
     size_t frame_count);
 
+  /// Renderer convenience interface - Estimated volume at the listener
+  virtual float GetAudibility();
+
+  /// Renderer convenience interface - Advance without mixing
+  virtual void SkipFrames(size_t frame_count);
+
   /// Renderer convenience interface - Called to provide processing of output filters
   virtual void ProcessOutputFilters();
 
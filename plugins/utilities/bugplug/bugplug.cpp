@@ -186,6 +186,7 @@ csBugPlug::csBugPlug (iBase *iParent)
 
   do_profiler_reset = false;
   do_profiler_log = false;
+  do_profiler_trace = false;
 }
 
 csBugPlug::~csBugPlug ()
@@ -220,6 +221,10 @@ csBugPlug::~csBugPlug ()
   {
     CS_PROFILER_STOP_LOGGING();
   }
+  if (do_profiler_trace)
+  {
+    CS_PROFILER_STOP_TRACE(0, 0);
+  }
 }
 
 bool csBugPlug::Initialize (iObjectRegistry *object_reg)
@@ -1250,6 +1255,20 @@ bool csBugPlug::ExecCommand (int cmd, const csString& args)
         do_profiler_log = !do_profiler_log;
         break;
       }
+    case DEBUGCMD_PROFTOGGLETRACE:
+      {
+        if (do_profiler_trace)
+        {
+          CS_PROFILER_STOP_TRACE(0, 0);
+        }
+        else
+        {
+          CS_PROFILER_START_TRACE();
+        }
+
+        do_profiler_trace = !do_profiler_trace;
+        break;
+      }
     case DEBUGCMD_PROFAUTORESET:
       {
         do_profiler_reset = !do_profiler_reset;
@@ -1546,6 +1565,7 @@ bool csBugPlug::HandleStartFrame (iEvent& /*event*/)
   {
     CS_PROFILER_RESET();
   }
+  CS_PROFILER_FRAME_MARKER();
 
   return false;
 }
@@ -2279,6 +2299,7 @@ int csBugPlug::GetCommandCode (const char* cmdstr, csString& args)
   if (!strcmp (cmd, "listplugins"))	return DEBUGCMD_LISTPLUGINS;
   if (!strcmp (cmd, "prof_log"))	return DEBUGCMD_PROFTOGGLELOG;
   if (!strcmp (cmd, "prof_autoreset"))	return DEBUGCMD_PROFAUTORESET;
+  if (!strcmp (cmd, "prof_trace"))	return DEBUGCMD_PROFTOGGLETRACE;
   if (!strcmp (cmd, "uberscreenshot"))	return DEBUGCMD_UBERSCREENSHOT;
   if (!strcmp (cmd, "meshnorm"))	return DEBUGCMD_MESHNORM;
   if (!strcmp (cmd, "toggle_fps_time")) return DEBUGCMD_TOGGLEFPSTIME;
@@ -149,6 +149,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(BugPlug)
 #define DEBUGCMD_MESHSKEL       1080    // Draw skeleton of selected mesh
 #define DEBUGCMD_PRINTPORTALS   1090    // Print portal info for the current sector
 #define DEBUGCMD_PRINTPOSITION  1091    // Print current camera position in CS format
+#define DEBUGCMD_PROFTOGGLETRACE 1092   // Start/stop profiler event trace
 
 // For showing of polygon meshes.
 #define BUGPLUG_POLYMESH_NO	0
@@ -260,6 +261,7 @@ private:
   // For profiling
   bool do_profiler_reset;
   bool do_profiler_log;
+  bool do_profiler_trace;
 
   // Dump various structures.
   void Dump (iEngine* engine);
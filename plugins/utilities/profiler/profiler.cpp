@@ -62,14 +62,22 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
 
   Profiler::Profiler ()
-    : scfImplementationType (this), nativeLogfile (0),
-    logfileNameHelper ("profile_log0000.csv"), isLogging (false)
+    : scfImplementationType (this), recording (0), eventsPerThread (65536),
+    nativeLogfile (0), logfileNameHelper ("profile_log0000.csv"),
+    isLogging (false)
   {    
+    startTimestamp = GetProfileTimestamp ();
+    startTime = csGetMicroTicks ();
   }
 
   Profiler::~Profiler ()
   {
-
+    for (size_t i = 0; i < threads.GetSize (); i++)
+    {
+      delete[] threads[i]->zoneStats;
+      delete[] threads[i]->events;
+      delete threads[i];
+    }
   }
 
   static int ZoneFindFun (ProfileZone* const& zone, csString const& name)
@@ -79,6 +87,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   CS::Debug::ProfileZone* Profiler::GetProfileZone (const char* zonename)
   {
+    CS::Threading::MutexScopedLock scopedLock (lock);
     ProfileZone* zone = 0;
 
     size_t index = allZones.FindKey (csArrayCmp<ProfileZone* , csString> (zonename, ZoneFindFun));
@@ -88,7 +97,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
       //Allocate a new one
       zone = zoneAllocator.Alloc ();
       zone->zoneName = csStrNew (zonename);
+      zone->zoneIndex = allZones.GetSize ();
+      zone->profiler = this;
       allZones.Push (zone);
+      ProfileThreadData::ZoneStats noStats = { 0, 0 };
+      resetStats.Push (noStats);
     }
     else
     {
@@ -105,6 +118,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   CS::Debug::ProfileCounter* Profiler::GetProfileCounter (const char* countername)
   {
+    CS::Threading::MutexScopedLock scopedLock (lock);
     ProfileCounter* counter = 0;
     size_t index = allCounters.FindKey (csArrayCmp<ProfileCounter* , csString> (countername, CounterFindFun));
 
@@ -125,6 +139,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   void Profiler::Reset ()
   {
+    UpdateZones ();
+
     // Dump to file if we have one
     if (isLogging && allZones.GetSize () > 0)
     {
@@ -138,12 +154,25 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
       WriteLogEntry (data);
     }
 
-    // Reset
+    /* Reset. The statistics of the threads are only ever written by their
+       threads, so rather remember the current sums. */
+    CS::Threading::MutexScopedLock scopedLock (lock);
     for (size_t i = 0; i < allZones.GetSize (); ++i)
     {
       ProfileZone* zone = allZones[i];
       zone->totalTime = 0;
       zone->enterCount = 0;
+      resetStats[i].totalTime = 0;
+      resetStats[i].enterCount = 0;
+    }
+    for (size_t t = 0; t < threads.GetSize (); t++)
+    {
+      const ThreadData* data = threads[t];
+      for (size_t i = 0; i < data->numZoneStats; i++)
+      {
+        resetStats[i].totalTime += data->zoneStats[i].totalTime;
+        resetStats[i].enterCount += data->zoneStats[i].enterCount;
+      }
     }
 
     for (size_t i = 0; i < allCounters.GetSize(); ++i)
@@ -155,9 +184,221 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
   const csArray<CS::Debug::ProfileZone*>& Profiler::GetProfileZones ()
   {
+    UpdateZones ();
     return allZones;
   }
 
+  void Profiler::UpdateZones ()
+  {
+    const double scale = 1.0 / GetTimestampsPerMicrosecond ();
+
+    CS::Threading::MutexScopedLock scopedLock (lock);
+    for (size_t i = 0; i < allZones.GetSize (); ++i)
+    {
+      uint64 totalTime = 0;
+      uint32 enterCount = 0;
+      for (size_t t = 0; t < threads.GetSize (); t++)
+      {
+        const ThreadData* data = threads[t];
+        if (i >= data->numZoneStats) continue;
+        totalTime += data->zoneStats[i].totalTime;
+        enterCount += data->zoneStats[i].enterCount;
+      }
+      ProfileZone* zone = allZones[i];
+      zone->totalTime =
+        uint64 ((totalTime - resetStats[i].totalTime) * scale);
+      zone->enterCount = enterCount - resetStats[i].enterCount;
+    }
+  }
+
+  double Profiler::GetTimestampsPerMicrosecond ()
+  {
+    const csMicroTicks elapsed = csGetMicroTicks () - startTime;
+    if (elapsed <= 0) return 1.0;
+    return double (GetProfileTimestamp () - startTimestamp) / elapsed;
+  }
+
+  CS::Debug::ProfileThreadData* Profiler::GetThreadData ()
+  {
+    ThreadData* data = static_cast<ThreadData*> (threadDataSlot.GetValue ());
+    if (data) return data;
+
+    CS::Threading::MutexScopedLock scopedLock (lock);
+    data = new ThreadData;
+    data->name.Format ("Thread %zu", threads.GetSize ());
+    data->recording = &recording;
+    data->profiler = this;
+    data->numZoneStats = allZones.GetSize ();
+    data->zoneStats = new ProfileThreadData::ZoneStats[data->numZoneStats];
+    memset (data->zoneStats, 0,
+      data->numZoneStats * sizeof (ProfileThreadData::ZoneStats));
+    if (recording) AllocateEvents (data);
+    threads.Push (data);
+    threadDataSlot.SetValue (data);
+    return data;
+  }
+
+  void Profiler::GrowThreadData (CS::Debug::ProfileThreadData* data)
+  {
+    CS::Threading::MutexScopedLock scopedLock (lock);
+    const size_t newSize = allZones.GetSize ();
+    ProfileThreadData::ZoneStats* newStats =
+      new ProfileThreadData::ZoneStats[newSize];
+    memcpy (newStats, data->zoneStats,
+      data->numZoneStats * sizeof (ProfileThreadData::ZoneStats));
+    memset (newStats + data->numZoneStats, 0,
+      (newSize - data->numZoneStats) * sizeof (ProfileThreadData::ZoneStats));
+    delete[] data->zoneStats;
+    data->zoneStats = newStats;
+    data->numZoneStats = newSize;
+  }
+
+  void Profiler::SetThreadName (const char* name)
+  {
+    ThreadData* data = static_cast<ThreadData*> (GetThreadData ());
+    CS::Threading::MutexScopedLock scopedLock (lock);
+    data->name = name;
+  }
+
+  void Profiler::AllocateEvents (ThreadData* data)
+  {
+    if (data->events && (data->eventMask + 1 == eventsPerThread))
+      return;
+
+    delete[] data->events;
+    data->events = new ProfileEvent[eventsPerThread];
+    data->eventMask = eventsPerThread - 1;
+    data->eventCount = 0;
+  }
+
+  void Profiler::SetEventRecording (bool enable, size_t eventsPerThread)
+  {
+    CS::Threading::MutexScopedLock scopedLock (lock);
+    if (!enable)
+    {
+      CS::Threading::AtomicOperations::Set (&recording, 0);
+      return;
+    }
+    if (recording) return;
+
+    // The ring buffers are indexed with a mask
+    size_t size = 1;
+    while (size < eventsPerThread) size <<= 1;
+    this->eventsPerThread = size;
+
+    /* No thread writes events while not recording, so the buffers can be
+       replaced safely */
+    for (size_t t = 0; t < threads.GetSize (); t++)
+    {
+      AllocateEvents (threads[t]);
+      threads[t]->eventCount = 0;
+    }
+    CS::Threading::AtomicOperations::Set (&recording, 1);
+  }
+
+  void Profiler::MarkFrame ()
+  {
+    ProfileThreadData* data = GetThreadData ();
+    if (recording)
+      data->AddEvent (0, GetProfileTimestamp (), ProfileEvent::Frame);
+  }
+
+  static void AppendJSONString (csString& str, const char* s)
+  {
+    str.Append ('"');
+    for (; *s; s++)
+    {
+      if ((*s == '"') || (*s == '\\'))
+        str.Append ('\\');
+      str.Append (*s);
+    }
+    str.Append ('"');
+  }
+
+  bool Profiler::ExportTrace (const char* filenamebase, iObjectRegistry* objectreg)
+  {
+    const double scale = 1.0 / GetTimestampsPerMicrosecond ();
+
+    csString data;
+    data.Append ("{\"traceEvents\":[\n");
+    bool first = true;
+    {
+      CS::Threading::MutexScopedLock scopedLock (lock);
+      for (size_t t = 0; t < threads.GetSize (); t++)
+      {
+        const ThreadData* thread = threads[t];
+        if (!first) data.Append (",\n");
+        first = false;
+        data.AppendFmt ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+          "\"tid\":%zu,\"args\":{\"name\":", t);
+        AppendJSONString (data, thread->name);
+        data.Append ("}}");
+
+        if (!thread->events) continue;
+
+        // Only the most recent events are still in the ring buffer
+        const size_t eventCount = thread->eventCount;
+        const size_t bufferSize = thread->eventMask + 1;
+        size_t e = eventCount > bufferSize ? eventCount - bufferSize : 0;
+        // Number of zones begun inside the exported events
+        size_t open = 0;
+        for (; e < eventCount; e++)
+        {
+          const ProfileEvent& event = thread->events[e & thread->eventMask];
+          const double ts = (event.time - startTimestamp) * scale;
+          switch (event.type)
+          {
+            case ProfileEvent::Begin:
+              open++;
+              data.Append (",\n{\"name\":");
+              AppendJSONString (data, event.zone->zoneName);
+              data.AppendFmt (",\"ph\":\"B\",\"ts\":%.3f,\"pid\":0,\"tid\":%zu}",
+                ts, t);
+              break;
+            case ProfileEvent::End:
+              // The beginning of the zone was overwritten
+              if (open == 0) continue;
+              open--;
+              data.AppendFmt (",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":0,"
+                "\"tid\":%zu}", ts, t);
+              break;
+            case ProfileEvent::Frame:
+              data.AppendFmt (",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\","
+                "\"ts\":%.3f,\"pid\":0,\"tid\":%zu}", ts, t);
+              break;
+          }
+        }
+      }
+    }
+    data.Append ("\n]}\n");
+
+    CS::NumberedFilenameHelper filenameHelper;
+    if (filenamebase && *filenamebase)
+      filenameHelper.SetMask (filenamebase);
+    else
+      filenameHelper.SetMask ("profile_trace0000.json");
+
+    csRef<iVFS> vfs;
+    if (objectreg) 
+      vfs = csQueryRegistry<iVFS> (objectreg);
+    if (vfs)
+    {
+      csVfsDirectoryChanger dirCh (vfs);
+      dirCh.ChangeTo ("/tmp");
+      csRef<iFile> file = vfs->Open (filenameHelper.FindNextFilename (vfs),
+        VFS_FILE_WRITE);
+      return file && (file->Write (data.GetData (), data.Length ())
+        == data.Length ());
+    }
+
+    FILE* file = CS::Platform::File::Open (filenameHelper.FindNextFilename (),
+      "w");
+    if (!file) return false;
+    bool ok = fwrite (data.GetData (), 1, data.Length (), file) == data.Length ();
+    fclose (file);
+    return ok;
+  }
+
   const csArray<CS::Debug::ProfileCounter*>& Profiler::GetProfileCounters ()
   {
     return allCounters;
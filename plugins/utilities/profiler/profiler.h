@@ -23,6 +23,9 @@
 #include "csutil/scf_implementation.h"
 #include "cstool/numberedfilenamehelper.h"
 #include "csutil/csstring.h"
+#include "csutil/threading/mutex.h"
+#include "csutil/threading/thread.h"
+#include "csutil/threading/tls.h"
 
 struct iFile;
 
@@ -60,7 +63,36 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
     void StartLogging (const char* filenamebase, iObjectRegistry* objectreg);
     void StopLogging ();
 
+    CS::Debug::ProfileThreadData* GetThreadData ();
+    void GrowThreadData (CS::Debug::ProfileThreadData* data);
+    void SetThreadName (const char* name);
+
+    void SetEventRecording (bool enable, size_t eventsPerThread);
+    bool GetEventRecording () const { return recording != 0; }
+    void MarkFrame ();
+    bool ExportTrace (const char* filenamebase, iObjectRegistry* objectreg);
+
   private:
+    struct ThreadData : public CS::Debug::ProfileThreadData
+    {
+      csString name;
+    };
+
+    // Protects the zone and thread lists and the per-thread statistics arrays
+    CS::Threading::Mutex lock;
+    CS::Threading::ThreadLocalBase threadDataSlot;
+    csArray<ThreadData*> threads;
+
+    int32 recording;
+    size_t eventsPerThread;
+
+    // Timestamp and time the profiler was created at, to convert timestamps
+    uint64 startTimestamp;
+    csMicroTicks startTime;
+
+    // Sums of the statistics of all threads at the last reset
+    csArray<CS::Debug::ProfileThreadData::ZoneStats> resetStats;
+
     csArray<CS::Debug::ProfileZone*> allZones;
     csArray<CS::Debug::ProfileCounter*> allCounters;
 
@@ -75,6 +107,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(Profiler)
 
     // Helper function to write a string to the logfile (independent of type)
     void WriteLogEntry (const csString& entry, bool flush = false);
+
+    void AllocateEvents (ThreadData* data);
+    // Sum the statistics of all threads into the zones
+    void UpdateZones ();
+    double GetTimestampsPerMicrosecond ();
   };
 
 }
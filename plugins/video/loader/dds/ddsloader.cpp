@@ -19,6 +19,8 @@
 
 #include "cssysdef.h"
 #include "csutil/csendian.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
 #include "csgfx/imagemanipulate.h"
 
 #include "igraphic/dxtcompress.h"
@@ -69,6 +71,17 @@ CS::Graphics::iDXTDecompressor* csDDSImageIO::GetDXTDecompressor ()
   return dxt_decompress;
 }
 
+iJobQueue* csDDSImageIO::GetEncodeQueue ()
+{
+  if (!encodeQueue)
+  {
+    encodeQueue.AttachNew (new CS::Threading::ThreadedJobQueue (
+      CS::Platform::GetProcessorCount(), CS::Threading::THREAD_PRIO_NORMAL,
+      "DDS encode"));
+  }
+  return encodeQueue;
+}
+
 const csImageIOFileFormatDescriptions& csDDSImageIO::GetDescription ()
 {
   return formats;
@@ -108,6 +121,18 @@ csDDSRawDataType csDDSImageIO::IdentifyPixelFormat (const dds::PixelFormat& pf,
         bpp = 8; 
         break;
       }
+    case 80:
+      {
+        type = csrawBC4;
+        bpp = 4;
+        break;
+      }
+    case 83:
+      {
+        type = csrawBC5;
+        bpp = 8;
+        break;
+      }
     }
   }
   else if (pf.flags & dds::DDPF_FOURCC)
@@ -134,6 +159,16 @@ csDDSRawDataType csDDSImageIO::IdentifyPixelFormat (const dds::PixelFormat& pf,
       type = csrawDXT5;
       bpp = 8; 
       break;
+    case MakeFourCC ('A','T','I','1'):
+    case MakeFourCC ('B','C','4','U'):
+      type = csrawBC4;
+      bpp = 4; 
+      break;
+    case MakeFourCC ('A','T','I','2'):
+    case MakeFourCC ('B','C','5','U'):
+      type = csrawBC5;
+      bpp = 8; 
+      break;
     }
   }
   else
@@ -192,6 +227,8 @@ static size_t DataSize (csDDSRawDataType dataType, int bpp, int w, int h,
     case csrawDXT3:
     case csrawDXT4:
     case csrawDXT5:
+    case csrawBC4:
+    case csrawBC5:
       {
 	int minW = ((w + 3) / 4) * 4;
 	int minH = ((h + 3) / 4) * 4;
@@ -315,7 +352,7 @@ csPtr<iDataBuffer> csDDSImageIO::Save (iImage* image, const char* mime,
 {
   if (strcmp (mime, DDS_MIME) != 0) return 0;
   csImageLoaderOptionsParser optparser (options);
-  csDDSSaver saver;
+  csDDSSaver saver (GetEncodeQueue ());
   return saver.Save (image, optparser);
 }
 
@@ -473,6 +510,33 @@ void csDDSImageFile::MakeImageData ()
           dds::Loader::CorrectPremult (buf, Width * Height);
         break;
       }
+      case csrawBC4:
+      {
+        OddDimensionsDecompressor<uint8>::Decompress (
+          source, 8, &(buf->red), sizeof (csRGBpixel), Width, Height,
+          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXTUNormToUI8);
+        for (int i = 0; i < Width * Height; i++)
+          buf[i].green = buf[i].blue = buf[i].red;
+        break;
+      }
+      case csrawBC5:
+      {
+        OddDimensionsDecompressor<uint8>::Decompress (
+          source, 16, &(buf->red), sizeof (csRGBpixel), Width, Height,
+          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXTUNormToUI8);
+        OddDimensionsDecompressor<uint8>::Decompress (
+          source + 8, 16, &(buf->green), sizeof (csRGBpixel), Width, Height,
+          iio->GetDXTDecompressor(), &CS::Graphics::iDXTDecompressor::DecompressDXTUNormToUI8);
+        // Two channel normal maps: reconstruct Z
+        for (int i = 0; i < Width * Height; i++)
+        {
+          float x = buf[i].red * (2.0f / 255.0f) - 1.0f;
+          float y = buf[i].green * (2.0f / 255.0f) - 1.0f;
+          float z = sqrtf (csMax (1.0f - x * x - y * y, 0.0f));
+          buf[i].blue = int ((z + 1.0f) * 127.5f + 0.5f);
+        }
+        break;
+      }
       case csrawLum8:
 	{
 	  dds::Loader::DecompressLum (buf, source, Width, Height, Depth, 
@@ -26,6 +26,7 @@
 #include "csutil/refarr.h"
 #include "iutil/comp.h"
 #include "igraphic/imageio.h"
+#include "iutil/job.h"
 
 #include "dds.h"
 
@@ -49,6 +50,10 @@ enum csDDSRawDataType
   csrawR8G8B8,
   csrawR5G6B5,
   csrawLum8,
+  /// One compressed channel, decoded to gray
+  csrawBC4,
+  /// Two compressed channels, decoded as a normal map
+  csrawBC5,
 
   csrawUnknownAlpha,
   csrawDXT1Alpha,
@@ -84,10 +89,13 @@ public:
 
   iObjectRegistry* GetObjectReg () const { return object_reg; }
   CS::Graphics::iDXTDecompressor* GetDXTDecompressor ();
+  /// Queue to compress blocks in parallel when saving
+  iJobQueue* GetEncodeQueue ();
 private:
   csImageIOFileFormatDescriptions formats;
   iObjectRegistry* object_reg;
   csRef<CS::Graphics::iDXTDecompressor> dxt_decompress;
+  csRef<iJobQueue> encodeQueue;
 
   csDDSRawDataType IdentifyPixelFormat (const dds::PixelFormat& pf, 
     uint32 dxgiFormat, bool isDX10, uint& bpp);
@@ -19,6 +19,7 @@
 
 #include "cssysdef.h"
 #include "csgfx/imagememory.h"
+#include "csutil/dirtyaccessarray.h"
 #include "csutil/util.h"
 
 #include "ddssaver.h"
@@ -66,13 +67,84 @@ bool csDDSSaver::FmtB8G8R8A8::Save (csMemFile& out, iImage* image)
   return true;
 }
 
+csDDSSaver::FmtDXT::FmtDXT (DXTEncode::Format format, 
+  const csImageLoaderOptionsParser& options, iJobQueue* queue) : 
+  format (format), quality (DXTEncode::qualityNormal), dither (false), 
+  useImageLib (false), queue (queue)
+{
+  csString qualityStr;
+  if (options.GetString ("quality", qualityStr))
+  {
+    if (qualityStr == "fast")
+      quality = DXTEncode::qualityFast;
+    else if (qualityStr == "high")
+      quality = DXTEncode::qualityHigh;
+  }
+  options.GetBool ("dither", dither);
+  // ImageLib only knows the DXT formats
+  options.GetBool ("imagelib", useImageLib);
+  useImageLib &= (format == DXTEncode::formatBC1) 
+    || (format == DXTEncode::formatBC2) || (format == DXTEncode::formatBC3);
+}
+
 bool csDDSSaver::FmtDXT::Save (csMemFile& out, iImage* image)
+{
+  if (useImageLib) return SaveImageLib (out, image);
+
+  const int imgW = image->GetWidth();
+  const int imgH = image->GetHeight();
+  const csRGBpixel* pixels = (csRGBpixel*)image->GetImageData();
+
+  csDirtyAccessArray<csRGBpixel> ditheredPixels;
+  if (dither && (format <= DXTEncode::formatBC3))
+  {
+    // Floyd/Steinberg (modified) error diffusion, done by ImageLib
+    ImageLib::Image32 img;
+    img.SetSize (imgW, imgH);
+    ImageLib::Color* p = img.GetPixels();
+    for (int i = 0; i < imgW * imgH; i++)
+    {
+      p[i].c.r = pixels[i].red;
+      p[i].c.g = pixels[i].green;
+      p[i].c.b = pixels[i].blue;
+      p[i].c.a = pixels[i].alpha;
+    }
+    img.DiffuseError ((format == DXTEncode::formatBC2) ? 4 : 8, 5, 6, 5);
+    ditheredPixels.SetSize (imgW * imgH);
+    for (int i = 0; i < imgW * imgH; i++)
+    {
+      ditheredPixels[i].Set (p[i].c.r, p[i].c.g, p[i].c.b, p[i].c.a);
+    }
+    pixels = ditheredPixels.GetArray();
+  }
+
+  // Partial blocks at the borders are padded by the encoder
+  const size_t blocksSize = ((imgW + 3) / 4) * ((imgH + 3) / 4) 
+    * DXTEncode::GetBlockSize (format);
+  csDirtyAccessArray<uint8> blocks;
+  blocks.SetSize (blocksSize);
+  DXTEncode::EncodeImage (pixels, imgW, imgH, format, quality, 
+    blocks.GetArray(), queue);
+  out.Write ((char*)blocks.GetArray(), blocksSize);
+
+  return true;
+}
+
+bool csDDSSaver::FmtDXT::SaveImageLib (csMemFile& out, iImage* image)
 {
   const int imgW = image->GetWidth();
   if ((imgW > 4) && ((imgW & 3) != 0)) return 0;
   const int imgH = image->GetHeight();
   if ((imgH > 4) && ((imgH & 3) != 0)) return 0;
 
+  ImageLib::DXTCMethod method;
+  switch (format)
+  {
+    case DXTEncode::formatBC2: method = ImageLib::DC_DXT3; break;
+    case DXTEncode::formatBC3: method = ImageLib::DC_DXT5; break;
+    default:                   method = ImageLib::DC_DXT1; break;
+  }
+
   ImageLib::Image32* img = new ImageLib::Image32;
   img->SetSize (imgW, imgH);
   ImageLib::Color* p = img->GetPixels();
@@ -92,8 +164,7 @@ bool csDDSSaver::FmtDXT::Save (csMemFile& out, iImage* image)
   }
 
   // Floyd/Steinberg (modified) error diffusion
-  bool dither = false;
-  if (options.GetBool ("dither", dither))
+  if (dither)
   {
     img->DiffuseError((method == ImageLib::DC_DXT3) ? 4 : 8, 5, 6, 5);
   }
@@ -210,7 +281,7 @@ csPtr<iDataBuffer> csDDSSaver::Save (csRef<iImage> image,
       && (image->GetImageType() != csimgCube)) return 0;
     ddsHead.pixelformat.flags = dds::DDPF_FOURCC;
     ddsHead.pixelformat.fourcc = MakeFourCC ('D','X','T','1');
-    saver = new FmtDXT (ImageLib::DC_DXT1, options);
+    saver = new FmtDXT (DXTEncode::formatBC1, options, queue);
   }
   else if (format == "dxt3")
   {
@@ -218,7 +289,7 @@ csPtr<iDataBuffer> csDDSSaver::Save (csRef<iImage> image,
       && (image->GetImageType() != csimgCube)) return 0;
     ddsHead.pixelformat.flags = dds::DDPF_FOURCC;
     ddsHead.pixelformat.fourcc = MakeFourCC ('D','X','T','3');
-    saver = new FmtDXT (ImageLib::DC_DXT3, options);
+    saver = new FmtDXT (DXTEncode::formatBC2, options, queue);
   }
   else if (format == "dxt5")
   {
@@ -226,7 +297,23 @@ csPtr<iDataBuffer> csDDSSaver::Save (csRef<iImage> image,
       && (image->GetImageType() != csimgCube)) return 0;
     ddsHead.pixelformat.flags = dds::DDPF_FOURCC;
     ddsHead.pixelformat.fourcc = MakeFourCC ('D','X','T','5');
-    saver = new FmtDXT (ImageLib::DC_DXT5, options);
+    saver = new FmtDXT (DXTEncode::formatBC3, options, queue);
+  }
+  else if ((format == "bc4") || (format == "ati1"))
+  {
+    if ((image->GetImageType() != csimg2D) 
+      && (image->GetImageType() != csimgCube)) return 0;
+    ddsHead.pixelformat.flags = dds::DDPF_FOURCC;
+    ddsHead.pixelformat.fourcc = MakeFourCC ('A','T','I','1');
+    saver = new FmtDXT (DXTEncode::formatBC4, options, queue);
+  }
+  else if ((format == "bc5") || (format == "ati2"))
+  {
+    if ((image->GetImageType() != csimg2D) 
+      && (image->GetImageType() != csimgCube)) return 0;
+    ddsHead.pixelformat.flags = dds::DDPF_FOURCC;
+    ddsHead.pixelformat.fourcc = MakeFourCC ('A','T','I','2');
+    saver = new FmtDXT (DXTEncode::formatBC5, options, queue);
   }
   if (!saver) return 0;
 
@@ -24,9 +24,12 @@
 #include "csutil/ref.h"
 #include "csplugincommon/imageloader/optionsparser.h"
 #include "iutil/databuff.h"
+#include "iutil/job.h"
 
 #include "ImageLib/ImageDXTC.h"
 
+#include "dxtencode.h"
+
 struct iImage;
 
 CS_PLUGIN_NAMESPACE_BEGIN(DDSImageIO)
@@ -51,17 +54,27 @@ class csDDSSaver
   class FmtDXT : public Format
   {
   protected:
-    ImageLib::DXTCMethod method;
-    const csImageLoaderOptionsParser& options;
+    DXTEncode::Format format;
+    DXTEncode::Quality quality;
+    bool dither;
+    /// Compress with ImageLib instead of DXTEncode
+    bool useImageLib;
+    iJobQueue* queue;
+
+    bool SaveImageLib (csMemFile& out, iImage* image);
   public:
-    FmtDXT (ImageLib::DXTCMethod method, 
-      const csImageLoaderOptionsParser& options) : method(method), 
-      options(options) {}
+    FmtDXT (DXTEncode::Format format, 
+      const csImageLoaderOptionsParser& options, iJobQueue* queue);
     virtual bool Save (csMemFile& out, iImage* image);
   };
 
+  /// Queue used to compress blocks in parallel, may be 0
+  iJobQueue* queue;
+
   uint SaveMips (csMemFile& out, iImage* image, Format* format);
 public:
+  csDDSSaver (iJobQueue* queue = 0) : queue (queue) {}
+
   csPtr<iDataBuffer> Save (csRef<iImage> image, 
     const csImageLoaderOptionsParser& options);
 };
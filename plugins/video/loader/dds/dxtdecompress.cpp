@@ -24,6 +24,10 @@
 #include "csutil/csendian.h"
 #include "csutil/scf.h"
 
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
 CS_PLUGIN_NAMESPACE_BEGIN(DDSImageIO)
 {
   SCF_IMPLEMENT_FACTORY(DXTDecompressor)
@@ -103,6 +107,47 @@ CS_PLUGIN_NAMESPACE_BEGIN(DDSImageIO)
       colours[3].alpha = 0x00;
     }
 
+    if (outColorLayout.bytesToNextPixel == sizeof (csRGBpixel))
+    {
+      // Packed pixels: store a whole row at once
+      uint32 palette[4];
+      memcpy (palette, colours, sizeof (palette));
+      const csRGBpixel alphaPixel (0, 0, 0, 0xFF);
+      uint32 alphaMask;
+      memcpy (&alphaMask, &alphaPixel, sizeof (alphaMask));
+
+      uint8* outRow (outColor);
+      for (int j = 0; j < 4; j++)
+      {
+        const uint32 rowBits = bitmask >> (8 * j);
+#ifdef CS_SUPPORTS_SSE2
+        __m128i row = _mm_setr_epi32 (palette[rowBits & 3],
+          palette[(rowBits >> 2) & 3], palette[(rowBits >> 4) & 3],
+          palette[(rowBits >> 6) & 3]);
+        if (!withAlpha)
+        {
+          // Keep the alpha already in the output
+          const __m128i mask = _mm_set1_epi32 (alphaMask);
+          __m128i dest = _mm_loadu_si128 ((const __m128i*)outRow);
+          row = _mm_or_si128 (_mm_and_si128 (mask, dest),
+            _mm_andnot_si128 (mask, row));
+        }
+        _mm_storeu_si128 ((__m128i*)outRow, row);
+#else
+        uint32 row[4];
+        if (!withAlpha) memcpy (row, outRow, sizeof (row));
+        for (int i = 0; i < 4; i++)
+        {
+          const uint32 col = palette[(rowBits >> (2 * i)) & 3];
+          row[i] = withAlpha ? col : ((row[i] & alphaMask) | (col & ~alphaMask));
+        }
+        memcpy (outRow, row, sizeof (row));
+#endif
+        outRow += outColorLayout.bytesToNextRow;
+      }
+      return;
+    }
+
     uint8* outRow (outColor);
     for (int j = 0, k = 0; j < 4; j++)
     {
@@ -320,6 +365,27 @@ CS_PLUGIN_NAMESPACE_BEGIN(DDSImageIO)
       alphas[7] = OutputTypeTraits<OutputType>::Max (); // Bit code 111
     }
 
+    if (outDataLayout.bytesToNextPixel == sizeof (OutputType))
+    {
+      // Packed output: all 48 index bits at once, one store per row
+      uint64 bits = 0;
+      for (int b = 0; b < 6; b++)
+        bits |= uint64 (alphamask[b]) << (8 * b);
+      uint8* outAlphaRow (outAlpha);
+      for (uint j = 0; j < 4; j++)
+      {
+        OutputType row[4];
+        row[0] = alphas[bits & 0x07];
+        row[1] = alphas[(bits >> 3) & 0x07];
+        row[2] = alphas[(bits >> 6) & 0x07];
+        row[3] = alphas[(bits >> 9) & 0x07];
+        bits >>= 12;
+        memcpy (outAlphaRow, row, sizeof (row));
+        outAlphaRow += outDataLayout.bytesToNextRow;
+      }
+      return;
+    }
+
     // Upper and lower 4x2 pixel block are both decoded in the inner loop
     uint32 bits = csLittleEndian::Convert (*((uint32*)alphamask));
     uint32 bits2 = csLittleEndian::Convert (*((uint32*)&alphamask[3]));
@@ -0,0 +1,786 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "cssysdef.h"
+
+#include <math.h>
+
+#include "csgeom/math.h"
+#include "csutil/refarr.h"
+#include "csutil/scf_implementation.h"
+
+#include "dxtencode.h"
+
+#ifdef CS_SUPPORTS_SSE2
+#include <emmintrin.h>
+#endif
+
+/* The color encoder follows the usual approach: the colors of a block are
+ * projected on their principal axis, and the endpoints are chosen on or near
+ * that axis. Palettes are computed with the same integer arithmetic as in
+ * the decompressor, so the reported errors are the real errors. */
+
+CS_PLUGIN_NAMESPACE_BEGIN(DDSImageIO)
+{
+namespace DXTEncode
+{
+  namespace
+  {
+    /// Four floats, processed at once with SSE if available
+#ifdef CS_SUPPORTS_SSE2
+    struct Vec4
+    {
+      __m128 v;
+
+      Vec4 () {}
+      Vec4 (__m128 v) : v (v) {}
+      Vec4 (float x) : v (_mm_set1_ps (x)) {}
+      Vec4 (float x, float y, float z, float w) : v (_mm_setr_ps (x, y, z, w)) {}
+
+      friend Vec4 operator+ (const Vec4& a, const Vec4& b)
+      { return _mm_add_ps (a.v, b.v); }
+      friend Vec4 operator- (const Vec4& a, const Vec4& b)
+      { return _mm_sub_ps (a.v, b.v); }
+      friend Vec4 operator* (const Vec4& a, const Vec4& b)
+      { return _mm_mul_ps (a.v, b.v); }
+      friend Vec4 Min (const Vec4& a, const Vec4& b)
+      { return _mm_min_ps (a.v, b.v); }
+      friend Vec4 Max (const Vec4& a, const Vec4& b)
+      { return _mm_max_ps (a.v, b.v); }
+      /// Round towards zero
+      friend Vec4 Truncate (const Vec4& a)
+      { return _mm_cvtepi32_ps (_mm_cvttps_epi32 (a.v)); }
+
+      void Store (float* p) const { _mm_storeu_ps (p, v); }
+    };
+#else
+    struct Vec4
+    {
+      float c[4];
+
+      Vec4 () {}
+      Vec4 (float x) { c[0] = c[1] = c[2] = c[3] = x; }
+      Vec4 (float x, float y, float z, float w)
+      { c[0] = x; c[1] = y; c[2] = z; c[3] = w; }
+
+#define VEC4_OP(Op, Expr)                                       \
+      friend Vec4 Op (const Vec4& a, const Vec4& b)             \
+      {                                                         \
+        Vec4 r;                                                 \
+        for (int i = 0; i < 4; i++) r.c[i] = Expr;              \
+        return r;                                               \
+      }
+      VEC4_OP(operator+, a.c[i] + b.c[i])
+      VEC4_OP(operator-, a.c[i] - b.c[i])
+      VEC4_OP(operator*, a.c[i] * b.c[i])
+      VEC4_OP(Min, csMin (a.c[i], b.c[i]))
+      VEC4_OP(Max, csMax (a.c[i], b.c[i]))
+#undef VEC4_OP
+      friend Vec4 Truncate (const Vec4& a)
+      {
+        Vec4 r;
+        for (int i = 0; i < 4; i++) r.c[i] = float (int (a.c[i]));
+        return r;
+      }
+
+      void Store (float* p) const { for (int i = 0; i < 4; i++) p[i] = c[i]; }
+    };
+#endif
+
+    //-----------------------------------------------------------------------
+    // Color blocks
+
+    static inline int Expand5 (int v) { return (v << 3) | (v >> 2); }
+    static inline int Expand6 (int v) { return (v << 2) | (v >> 4); }
+
+    static inline uint16 Pack565 (float r, float g, float b)
+    {
+      int r5 = csClamp (int (r * (31.0f / 255.0f) + 0.5f), 31, 0);
+      int g6 = csClamp (int (g * (63.0f / 255.0f) + 0.5f), 63, 0);
+      int b5 = csClamp (int (b * (31.0f / 255.0f) + 0.5f), 31, 0);
+      return (r5 << 11) | (g6 << 5) | b5;
+    }
+
+    static inline uint16 Pack565 (const Vec4& v)
+    {
+      float c[4];
+      v.Store (c);
+      return Pack565 (c[0], c[1], c[2]);
+    }
+
+    /// Colors of a block, one array per channel.
+    struct ColorBlock
+    {
+      float r[16];
+      float g[16];
+      float b[16];
+    };
+
+    /// An encoded color block.
+    struct ColorResult
+    {
+      uint16 c0, c1;
+      uint8 indices[16];
+      /// Sum of the squared differences to the original colors
+      float error;
+    };
+
+    /**
+     * Find the closest palette entry for every pixel. Returns the sum of the
+     * squared differences.
+     */
+    static float FindIndices (const ColorBlock& block, const float pal[4][3],
+                              uint8* indices)
+    {
+#ifdef CS_SUPPORTS_SSE2
+      __m128 total = _mm_setzero_ps ();
+      for (int i = 0; i < 16; i += 4)
+      {
+        const __m128 r = _mm_loadu_ps (block.r + i);
+        const __m128 g = _mm_loadu_ps (block.g + i);
+        const __m128 b = _mm_loadu_ps (block.b + i);
+        __m128 best = _mm_set1_ps (1e30f);
+        __m128i bestIndex = _mm_setzero_si128 ();
+        for (int p = 0; p < 4; p++)
+        {
+          __m128 dr = _mm_sub_ps (r, _mm_set1_ps (pal[p][0]));
+          __m128 dg = _mm_sub_ps (g, _mm_set1_ps (pal[p][1]));
+          __m128 db = _mm_sub_ps (b, _mm_set1_ps (pal[p][2]));
+          __m128 d = _mm_add_ps (_mm_add_ps (_mm_mul_ps (dr, dr),
+            _mm_mul_ps (dg, dg)), _mm_mul_ps (db, db));
+          __m128i closer = _mm_castps_si128 (_mm_cmplt_ps (d, best));
+          best = _mm_min_ps (d, best);
+          bestIndex = _mm_or_si128 (_mm_andnot_si128 (closer, bestIndex),
+            _mm_and_si128 (closer, _mm_set1_epi32 (p)));
+        }
+        total = _mm_add_ps (total, best);
+        int32 idx[4];
+        _mm_storeu_si128 ((__m128i*)idx, bestIndex);
+        for (int k = 0; k < 4; k++) indices[i + k] = idx[k];
+      }
+      float sums[4];
+      _mm_storeu_ps (sums, total);
+      return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+      float total = 0;
+      for (int i = 0; i < 16; i++)
+      {
+        float best = 1e30f;
+        for (int p = 0; p < 4; p++)
+        {
+          float dr = block.r[i] - pal[p][0];
+          float dg = block.g[i] - pal[p][1];
+          float db = block.b[i] - pal[p][2];
+          float d = dr * dr + dg * dg + db * db;
+          if (d < best)
+          {
+            best = d;
+            indices[i] = p;
+          }
+        }
+        total += best;
+      }
+      return total;
+#endif
+    }
+
+    /**
+     * Compute indices and error for a pair of endpoints. The endpoints are
+     * ordered so the block is decoded in four color mode.
+     */
+    static void EvaluateEndpoints (const ColorBlock& block, uint16 c0,
+                                   uint16 c1, ColorResult& result)
+    {
+      if (c0 < c1)
+      {
+        uint16 t = c0; c0 = c1; c1 = t;
+      }
+      const int e0[3] = { Expand5 (c0 >> 11), Expand6 ((c0 >> 5) & 0x3f),
+        Expand5 (c0 & 0x1f) };
+      const int e1[3] = { Expand5 (c1 >> 11), Expand6 ((c1 >> 5) & 0x3f),
+        Expand5 (c1 & 0x1f) };
+      // With c0 == c1 all entries are the same, so index 0 is used
+      float pal[4][3];
+      for (int c = 0; c < 3; c++)
+      {
+        pal[0][c] = e0[c];
+        pal[1][c] = e1[c];
+        pal[2][c] = (2 * e0[c] + e1[c] + 1) / 3;
+        pal[3][c] = (e0[c] + 2 * e1[c] + 1) / 3;
+      }
+      result.c0 = c0;
+      result.c1 = c1;
+      result.error = FindIndices (block, pal, result.indices);
+    }
+
+    /// Mean and principal axis of the colors of a block.
+    static void GetPrincipalAxis (const ColorBlock& block, float mean[3],
+                                  float axis[3])
+    {
+      mean[0] = mean[1] = mean[2] = 0;
+      for (int i = 0; i < 16; i++)
+      {
+        mean[0] += block.r[i];
+        mean[1] += block.g[i];
+        mean[2] += block.b[i];
+      }
+      for (int c = 0; c < 3; c++) mean[c] *= 1.0f / 16.0f;
+
+      // Covariance: xx, xy, xz, yy, yz, zz
+      float cov[6] = { 0, 0, 0, 0, 0, 0 };
+      for (int i = 0; i < 16; i++)
+      {
+        float r = block.r[i] - mean[0];
+        float g = block.g[i] - mean[1];
+        float b = block.b[i] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+      }
+
+      // Power iteration, starting with the row of the largest variance
+      float v[3];
+      if ((cov[0] >= cov[3]) && (cov[0] >= cov[5]))
+      { v[0] = cov[0]; v[1] = cov[1]; v[2] = cov[2]; }
+      else if (cov[3] >= cov[5])
+      { v[0] = cov[1]; v[1] = cov[3]; v[2] = cov[4]; }
+      else
+      { v[0] = cov[2]; v[1] = cov[4]; v[2] = cov[5]; }
+      for (int iter = 0; iter < 8; iter++)
+      {
+        float x = cov[0] * v[0] + cov[1] * v[1] + cov[2] * v[2];
+        float y = cov[1] * v[0] + cov[3] * v[1] + cov[4] * v[2];
+        float z = cov[2] * v[0] + cov[4] * v[1] + cov[5] * v[2];
+        float m = csMax (fabsf (x), csMax (fabsf (y), fabsf (z)));
+        if (m < 1e-10f) break;
+        v[0] = x / m; v[1] = y / m; v[2] = z / m;
+      }
+      float len = sqrtf (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+      for (int c = 0; c < 3; c++)
+        axis[c] = (len > 1e-10f) ? v[c] / len : 0.0f;
+    }
+
+    /// Endpoints at the extremes of the projections on the axis.
+    static void RangeFit (const ColorBlock& block, const float mean[3],
+                          const float axis[3], ColorResult& result)
+    {
+      float tMin = 1e30f, tMax = -1e30f;
+      for (int i = 0; i < 16; i++)
+      {
+        float t = (block.r[i] - mean[0]) * axis[0]
+          + (block.g[i] - mean[1]) * axis[1]
+          + (block.b[i] - mean[2]) * axis[2];
+        tMin = csMin (tMin, t);
+        tMax = csMax (tMax, t);
+      }
+      EvaluateEndpoints (block,
+        Pack565 (mean[0] + tMax * axis[0], mean[1] + tMax * axis[1],
+          mean[2] + tMax * axis[2]),
+        Pack565 (mean[0] + tMin * axis[0], mean[1] + tMin * axis[1],
+          mean[2] + tMin * axis[2]),
+        result);
+    }
+
+    /// Weight of the first endpoint for each index.
+    static const float indexWeights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+
+    /**
+     * Improve the endpoints of a result: with the indices fixed, the best
+     * endpoints are the solution of a linear least squares problem.
+     */
+    static void Refine (const ColorBlock& block, ColorResult& result,
+                        int iterations)
+    {
+      for (int iter = 0; iter < iterations; iter++)
+      {
+        float aa = 0, bb = 0, ab = 0;
+        float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+        {
+          const float wa = indexWeights[result.indices[i]];
+          const float wb = 1.0f - wa;
+          aa += wa * wa; bb += wb * wb; ab += wa * wb;
+          ax[0] += wa * block.r[i]; bx[0] += wb * block.r[i];
+          ax[1] += wa * block.g[i]; bx[1] += wb * block.g[i];
+          ax[2] += wa * block.b[i]; bx[2] += wb * block.b[i];
+        }
+        const float det = aa * bb - ab * ab;
+        if (fabsf (det) < 1e-6f) return;
+        const float inv = 1.0f / det;
+        float a[3], b[3];
+        for (int c = 0; c < 3; c++)
+        {
+          a[c] = (bb * ax[c] - ab * bx[c]) * inv;
+          b[c] = (aa * bx[c] - ab * ax[c]) * inv;
+        }
+
+        ColorResult candidate;
+        EvaluateEndpoints (block, Pack565 (a[0], a[1], a[2]),
+          Pack565 (b[0], b[1], b[2]), candidate);
+        if (candidate.error >= result.error) return;
+        result = candidate;
+      }
+    }
+
+    /**
+     * Try all ways to split the colors, sorted along the axis, into four
+     * consecutive clusters, and compute the least squares endpoints for
+     * each. The error of a candidate can be computed from sums over the
+     * clusters, without looking at the single colors.
+     */
+    static void ClusterFit (const ColorBlock& block, const float mean[3],
+                            const float axis[3], ColorResult& result)
+    {
+      float t[16];
+      int order[16];
+      for (int i = 0; i < 16; i++)
+      {
+        t[i] = (block.r[i] - mean[0]) * axis[0]
+          + (block.g[i] - mean[1]) * axis[1]
+          + (block.b[i] - mean[2]) * axis[2];
+        order[i] = i;
+      }
+      for (int i = 1; i < 16; i++)
+      {
+        int o = order[i];
+        int j = i;
+        for (; (j > 0) && (t[order[j - 1]] > t[o]); j--)
+          order[j] = order[j - 1];
+        order[j] = o;
+      }
+
+      Vec4 prefix[17];
+      prefix[0] = Vec4 (0.0f);
+      for (int i = 0; i < 16; i++)
+      {
+        const int o = order[i];
+        prefix[i + 1] = prefix[i] + Vec4 (block.r[o], block.g[o], block.b[o],
+          0.0f);
+      }
+      const Vec4 total (prefix[16]);
+      const Vec4 zero (0.0f);
+      const Vec4 max (255.0f);
+      const Vec4 half (0.5f);
+      const Vec4 two (2.0f);
+      const Vec4 third (1.0f / 3.0f);
+      const Vec4 twoThirds (2.0f / 3.0f);
+      const Vec4 toGrid (31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f, 0.0f);
+      const Vec4 fromGrid (255.0f / 31.0f, 255.0f / 63.0f, 255.0f / 31.0f,
+        0.0f);
+
+      float bestError = 1e30f;
+      Vec4 bestA (0.0f), bestB (0.0f);
+      // [0,i) get the second endpoint, [i,j) 1/3, [j,k) 2/3, [k,16) the first
+      for (int i = 0; i <= 16; i++)
+      {
+        for (int j = i; j <= 16; j++)
+        {
+          const Vec4 thirdSum ((prefix[j] - prefix[i]) * third);
+          for (int k = j; k <= 16; k++)
+          {
+            const float n1 = float (j - i), n2 = float (k - j);
+            const float aa = n1 * (1.0f / 9.0f) + n2 * (4.0f / 9.0f) + (16 - k);
+            const float bb = i + n1 * (4.0f / 9.0f) + n2 * (1.0f / 9.0f);
+            const float ab = (n1 + n2) * (2.0f / 9.0f);
+            const float det = aa * bb - ab * ab;
+            if (det < 1e-6f) continue;
+            const float inv = 1.0f / det;
+
+            const Vec4 ax (thirdSum + (prefix[k] - prefix[j]) * twoThirds
+              + (total - prefix[k]));
+            const Vec4 bx (total - ax);
+            Vec4 a ((ax * Vec4 (bb) - bx * Vec4 (ab)) * Vec4 (inv));
+            Vec4 b ((bx * Vec4 (aa) - ax * Vec4 (ab)) * Vec4 (inv));
+            // Snap to the 565 grid, so the error is that of the stored colors
+            a = Truncate (Min (Max (a, zero), max) * toGrid + half) * fromGrid;
+            b = Truncate (Min (Max (b, zero), max) * toGrid + half) * fromGrid;
+
+            // Error, minus the sum of the squared colors which is constant
+            const Vec4 e (a * a * Vec4 (aa) + b * b * Vec4 (bb)
+              + (a * b * Vec4 (ab) - a * ax - b * bx) * two);
+            float ec[4];
+            e.Store (ec);
+            const float error = ec[0] + ec[1] + ec[2];
+            if (error < bestError)
+            {
+              bestError = error;
+              bestA = a;
+              bestB = b;
+            }
+          }
+        }
+      }
+      if (bestError >= 1e30f) return;
+
+      ColorResult candidate;
+      EvaluateEndpoints (block, Pack565 (bestA), Pack565 (bestB), candidate);
+      if (candidate.error < result.error) result = candidate;
+    }
+
+    /**
+     * For every 8 bit value, the pair of 5 resp. 6 bit endpoints for which
+     * the 2/3 interpolated value comes closest.
+     */
+    struct SingleColorTables
+    {
+      uint8 match5[256][2];
+      uint8 match6[256][2];
+
+      SingleColorTables ()
+      {
+        Build (match5, 5);
+        Build (match6, 6);
+      }
+
+      static void Build (uint8 (*table)[2], int bits)
+      {
+        const int size = 1 << bits;
+        for (int v = 0; v < 256; v++)
+        {
+          int bestError = 256;
+          for (int e0 = 0; e0 < size; e0++)
+          {
+            const int x0 = (bits == 5) ? Expand5 (e0) : Expand6 (e0);
+            for (int e1 = 0; e1 < size; e1++)
+            {
+              const int x1 = (bits == 5) ? Expand5 (e1) : Expand6 (e1);
+              const int error = abs ((2 * x0 + x1 + 1) / 3 - v);
+              if (error < bestError)
+              {
+                bestError = error;
+                table[v][0] = e0;
+                table[v][1] = e1;
+              }
+            }
+          }
+        }
+      }
+    };
+    static const SingleColorTables singleColorTables;
+
+    static void WriteColorBlock (const ColorResult& result, uint8* out)
+    {
+      out[0] = result.c0 & 0xff;
+      out[1] = result.c0 >> 8;
+      out[2] = result.c1 & 0xff;
+      out[3] = result.c1 >> 8;
+      uint32 bits = 0;
+      for (int i = 0; i < 16; i++)
+        bits |= uint32 (result.indices[i]) << (2 * i);
+      for (int i = 0; i < 4; i++)
+        out[4 + i] = (bits >> (8 * i)) & 0xff;
+    }
+
+    static void EncodeColorBlock (const csRGBpixel* block, Quality quality,
+                                  uint8* out)
+    {
+      ColorBlock colors;
+      bool singleColor = true;
+      for (int i = 0; i < 16; i++)
+      {
+        colors.r[i] = block[i].red;
+        colors.g[i] = block[i].green;
+        colors.b[i] = block[i].blue;
+        singleColor &= (block[i].red == block[0].red)
+          && (block[i].green == block[0].green)
+          && (block[i].blue == block[0].blue);
+      }
+
+      ColorResult result;
+      if (singleColor)
+      {
+        const uint8* r = singleColorTables.match5[block[0].red];
+        const uint8* g = singleColorTables.match6[block[0].green];
+        const uint8* b = singleColorTables.match5[block[0].blue];
+        EvaluateEndpoints (colors, (r[0] << 11) | (g[0] << 5) | b[0],
+          (r[1] << 11) | (g[1] << 5) | b[1], result);
+      }
+      else
+      {
+        float mean[3], axis[3];
+        GetPrincipalAxis (colors, mean, axis);
+        RangeFit (colors, mean, axis, result);
+        if (quality == qualityHigh)
+          ClusterFit (colors, mean, axis, result);
+        if (quality != qualityFast)
+          Refine (colors, result, 2);
+      }
+      WriteColorBlock (result, out);
+    }
+
+    //-----------------------------------------------------------------------
+    // Alpha and single channel blocks
+
+    static void GetAlphaPalette (int a0, int a1, int pal[8])
+    {
+      pal[0] = a0;
+      pal[1] = a1;
+      if (a0 > a1)
+      {
+        for (int i = 1; i < 7; i++)
+          pal[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+      }
+      else
+      {
+        for (int i = 1; i < 5; i++)
+          pal[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+        pal[6] = 0;
+        pal[7] = 255;
+      }
+    }
+
+    static int EvaluateAlpha (const uint8* values, int a0, int a1,
+                              uint8* indices)
+    {
+      int pal[8];
+      GetAlphaPalette (a0, a1, pal);
+      int error = 0;
+      for (int i = 0; i < 16; i++)
+      {
+        int best = 256 * 256;
+        for (int p = 0; p < 8; p++)
+        {
+          const int d = (values[i] - pal[p]) * (values[i] - pal[p]);
+          if (d < best)
+          {
+            best = d;
+            indices[i] = p;
+          }
+        }
+        error += best;
+      }
+      return error;
+    }
+
+    static void EncodeAlphaBlock (const uint8* values, Quality quality,
+                                  uint8* out)
+    {
+      int minV = 255, maxV = 0;
+      // Extremes without 0 and 255, which six value blocks store exactly
+      int minInner = 255, maxInner = 0;
+      for (int i = 0; i < 16; i++)
+      {
+        minV = csMin (minV, int (values[i]));
+        maxV = csMax (maxV, int (values[i]));
+        if ((values[i] != 0) && (values[i] != 255))
+        {
+          minInner = csMin (minInner, int (values[i]));
+          maxInner = csMax (maxInner, int (values[i]));
+        }
+      }
+
+      uint8 indices[16], bestIndices[16];
+      int bestA0 = maxV, bestA1 = minV;
+      int bestError = EvaluateAlpha (values, bestA0, bestA1, bestIndices);
+
+#define TRY_ENDPOINTS(A0, A1)                                             \
+      {                                                                   \
+        const int error = EvaluateAlpha (values, A0, A1, indices);        \
+        if (error < bestError)                                            \
+        {                                                                 \
+          bestError = error;                                              \
+          bestA0 = A0;                                                    \
+          bestA1 = A1;                                                    \
+          memcpy (bestIndices, indices, sizeof (indices));                \
+        }                                                                 \
+      }
+
+      if ((bestError > 0) && ((minV == 0) || (maxV == 255)))
+      {
+        if (minInner > maxInner) minInner = maxInner = 0;
+        TRY_ENDPOINTS(minInner, maxInner)
+      }
+      if ((quality == qualityHigh) && (bestError > 0))
+      {
+        // Narrowing the range often lowers the error of the inner values
+        for (int d0 = 0; d0 < 4; d0++)
+        {
+          for (int d1 = 0; d1 < 4; d1++)
+          {
+            const int a0 = maxV - d0, a1 = minV + d1;
+            if (a0 > a1) TRY_ENDPOINTS(a0, a1)
+          }
+        }
+      }
+#undef TRY_ENDPOINTS
+
+      out[0] = bestA0;
+      out[1] = bestA1;
+      uint64 bits = 0;
+      for (int i = 0; i < 16; i++)
+        bits |= uint64 (bestIndices[i]) << (3 * i);
+      for (int i = 0; i < 6; i++)
+        out[2 + i] = (bits >> (8 * i)) & 0xff;
+    }
+
+    /// DXT3 alpha: 4 bits per pixel, stored as is.
+    static void EncodeExplicitAlpha (const csRGBpixel* block, uint8* out)
+    {
+      for (int i = 0; i < 16; i += 2)
+      {
+        const int a0 = (block[i].alpha + 8) / 17;
+        const int a1 = (block[i + 1].alpha + 8) / 17;
+        out[i / 2] = a0 | (a1 << 4);
+      }
+    }
+
+    //-----------------------------------------------------------------------
+    // Images
+
+    struct ImageData
+    {
+      const csRGBpixel* pixels;
+      int width;
+      int height;
+      Format format;
+      Quality quality;
+      uint8* out;
+    };
+
+    static void EncodeBlockRows (const ImageData& data, int firstRow,
+                                 int numRows)
+    {
+      const int blocksX = (data.width + 3) / 4;
+      const size_t blockSize = GetBlockSize (data.format);
+      csRGBpixel block[16];
+      for (int by = firstRow; by < firstRow + numRows; by++)
+      {
+        uint8* out = data.out + by * blocksX * blockSize;
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+          const int x0 = bx * 4, y0 = by * 4;
+          if ((x0 + 4 <= data.width) && (y0 + 4 <= data.height))
+          {
+            EncodeBlock (data.pixels + y0 * data.width + x0, data.width,
+              data.format, data.quality, out);
+          }
+          else
+          {
+            // Partial block, repeat the edge pixels
+            for (int y = 0; y < 4; y++)
+            {
+              const csRGBpixel* row = data.pixels
+                + csMin (y0 + y, data.height - 1) * data.width;
+              for (int x = 0; x < 4; x++)
+                block[y * 4 + x] = row[csMin (x0 + x, data.width - 1)];
+            }
+            EncodeBlock (block, 4, data.format, data.quality, out);
+          }
+          out += blockSize;
+        }
+      }
+    }
+
+    /// Compresses a band of block rows.
+    class EncodeJob : public scfImplementation1<EncodeJob, iJob>
+    {
+      const ImageData& data;
+      int firstRow;
+      int numRows;
+    public:
+      EncodeJob (const ImageData& data, int firstRow, int numRows)
+        : scfImplementationType (this), data (data), firstRow (firstRow),
+          numRows (numRows) {}
+
+      void Run () { EncodeBlockRows (data, firstRow, numRows); }
+    };
+
+    // Bands with fewer blocks aren't worth a job
+    static const int minBandBlocks = 64;
+    static const int maxBands = 64;
+  }
+
+  size_t GetBlockSize (Format format)
+  {
+    return ((format == formatBC1) || (format == formatBC4)) ? 8 : 16;
+  }
+
+  void EncodeBlock (const csRGBpixel* pixels, size_t pitch, Format format,
+                    Quality quality, uint8* out)
+  {
+    csRGBpixel block[16];
+    for (int y = 0; y < 4; y++)
+      for (int x = 0; x < 4; x++)
+        block[y * 4 + x] = pixels[y * pitch + x];
+
+    uint8 channel[16];
+    switch (format)
+    {
+      case formatBC1:
+        EncodeColorBlock (block, quality, out);
+        break;
+      case formatBC2:
+        EncodeExplicitAlpha (block, out);
+        EncodeColorBlock (block, quality, out + 8);
+        break;
+      case formatBC3:
+        for (int i = 0; i < 16; i++) channel[i] = block[i].alpha;
+        EncodeAlphaBlock (channel, quality, out);
+        EncodeColorBlock (block, quality, out + 8);
+        break;
+      case formatBC4:
+        for (int i = 0; i < 16; i++) channel[i] = block[i].red;
+        EncodeAlphaBlock (channel, quality, out);
+        break;
+      case formatBC5:
+        for (int i = 0; i < 16; i++) channel[i] = block[i].red;
+        EncodeAlphaBlock (channel, quality, out);
+        for (int i = 0; i < 16; i++) channel[i] = block[i].green;
+        EncodeAlphaBlock (channel, quality, out + 8);
+        break;
+    }
+  }
+
+  void EncodeImage (const csRGBpixel* pixels, int width, int height,
+                    Format format, Quality quality, uint8* out,
+                    iJobQueue* queue)
+  {
+    ImageData data;
+    data.pixels = pixels;
+    data.width = width;
+    data.height = height;
+    data.format = format;
+    data.quality = quality;
+    data.out = out;
+
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    int bands = csMin (blocksY, (blocksX * blocksY) / minBandBlocks);
+    bands = csMin (bands, maxBands);
+    if (!queue || (bands <= 1))
+    {
+      EncodeBlockRows (data, 0, blocksY);
+      return;
+    }
+
+    const int bandRows = (blocksY + bands - 1) / bands;
+    csRefArray<EncodeJob> jobs;
+    for (int row = bandRows; row < blocksY; row += bandRows)
+    {
+      csRef<EncodeJob> job;
+      job.AttachNew (new EncodeJob (data, row,
+        csMin (bandRows, blocksY - row)));
+      queue->Enqueue (job);
+      jobs.Push (job);
+    }
+    EncodeBlockRows (data, 0, csMin (bandRows, blocksY));
+    for (size_t j = 0; j < jobs.GetSize (); j++)
+      queue->PullAndRun (jobs[j]);
+  }
+} // namespace DXTEncode
+}
+CS_PLUGIN_NAMESPACE_END(DDSImageIO)
@@ -0,0 +1,90 @@
+/*
+    Copyright (C) 2012 by Crystal Space Team
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public
+    License along with this library; if not, write to the Free
+    Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/**\file
+ * DXT (BC1 - BC5) block compression
+ */
+
+#ifndef __DDS_DXTENCODE_H__
+#define __DDS_DXTENCODE_H__
+
+#include "csgfx/rgbpixel.h"
+#include "iutil/job.h"
+
+CS_PLUGIN_NAMESPACE_BEGIN(DDSImageIO)
+{
+namespace DXTEncode
+{
+  /// Compressed formats
+  enum Format
+  {
+    /// DXT1 color, no alpha
+    formatBC1,
+    /// DXT3: DXT1 color and explicit 4 bit alpha
+    formatBC2,
+    /// DXT5: DXT1 color and interpolated alpha
+    formatBC3,
+    /// One interpolated channel (red), aka ATI1
+    formatBC4,
+    /// Two interpolated channels (red and green), aka ATI2 or 3Dc
+    formatBC5
+  };
+
+  /// Trade-off between compression speed and quality
+  enum Quality
+  {
+    /**
+     * Color endpoints are the extremes of the colors along their principal
+     * axis.
+     */
+    qualityFast,
+    /// Like qualityFast, but the endpoints are refined by a least squares fit.
+    qualityNormal,
+    /**
+     * Every way to split the colors, ordered along their principal axis,
+     * into four clusters is tried ("cluster fit"). Slowest, but gives the
+     * least error.
+     */
+    qualityHigh
+  };
+
+  /// Size of a compressed 4x4 block, in bytes.
+  size_t GetBlockSize (Format format);
+
+  /**
+   * Compress a block of 4x4 pixels. \a pixels points to the top left pixel,
+   * \a pitch is the distance between rows in pixels. The block is written to
+   * \a out in little endian byte order.
+   */
+  void EncodeBlock (const csRGBpixel* pixels, size_t pitch, Format format,
+    Quality quality, uint8* out);
+
+  /**
+   * Compress an image of \a width x \a height pixels. Blocks at the right and
+   * bottom border are padded by repeating the edge pixels. The blocks are
+   * written row by row to \a out, which must hold
+   * <tt>((width+3)/4) * ((height+3)/4) * GetBlockSize()</tt> bytes.
+   * If \a queue is given, rows of blocks are compressed in parallel.
+   */
+  void EncodeImage (const csRGBpixel* pixels, int width, int height,
+    Format format, Quality quality, uint8* out, iJobQueue* queue = 0);
+} // namespace DXTEncode
+}
+CS_PLUGIN_NAMESPACE_END(DDSImageIO)
+
+#endif // __DDS_DXTENCODE_H__
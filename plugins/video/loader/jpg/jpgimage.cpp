@@ -452,16 +452,8 @@ bool ImageJpgFile::JpegLoader::InitOk()
 
   // Recalculate output image dimensions
   jpeg_calc_output_dimensions (&cinfo);
-
-  /* ==== Step 5: Start decompressor */
-
-  jpeg_start_decompress (&cinfo);
-  /* We may need to do some setup of our own at this point before reading
-   * the data.  After jpeg_start_decompress() we have the correct scaled
-   * output image dimensions available, as well as the output colormap
-   * if we asked for color quantization.
-   * In this example, we need to make an output work buffer of the right size.
-   */
+  /* The decompressor is only started in LoadData(), so the output size
+   * can still be changed by ReduceSize(). */
   Width = cinfo.output_width;
   Height = cinfo.output_height;
 
@@ -472,11 +464,35 @@ bool ImageJpgFile::JpegLoader::InitOk()
   return true;
 }
 
-bool ImageJpgFile::JpegLoader::LoadData ()
+int ImageJpgFile::JpegLoader::ReduceSize (int levels)
 {
   CS_ASSERT (decompCreated);
 
-  int row_stride;		/* physical row width in output buffer */
+  // libjpeg can scale the output by 1/2, 1/4 and 1/8 while decoding.
+  if (levels > 3) levels = 3;
+  while ((levels > 0)
+      && ((cinfo.image_width < (1u << levels))
+        || (cinfo.image_height < (1u << levels))))
+    levels--;
+  if (levels <= 0) return 0;
+
+  if (setjmp (jerr.setjmp_buffer))
+  {
+    // Scaling not supported, keep the full size
+    cinfo.scale_denom = 1;
+    return 0;
+  }
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = 1 << levels;
+  jpeg_calc_output_dimensions (&cinfo);
+  Width = cinfo.output_width;
+  Height = cinfo.output_height;
+  return levels;
+}
+
+bool ImageJpgFile::JpegLoader::LoadData ()
+{
+  CS_ASSERT (decompCreated);
 
   int i;
 
@@ -494,50 +510,40 @@ bool ImageJpgFile::JpegLoader::LoadData ()
     return false;
   }
 
+  /* ==== Step 5: Start decompressor */
+  jpeg_start_decompress (&cinfo);
+  CS_ASSERT (((int)cinfo.output_width == Width)
+    && ((int)cinfo.output_height == Height));
+
   bool isGrayScale = cinfo.jpeg_color_space == JCS_GRAYSCALE;
   int pixelcount = Width * Height;
+  uint8* out;
   if (isGrayScale)
-    indexData = new uint8 [pixelcount];
+    out = indexData = new uint8 [pixelcount];
   else
+  {
     rawData.AttachNew (new csDataBuffer (pixelcount * 3));
+    out = rawData->GetUint8();
+  }
 
   /* JSAMPLEs per row in output buffer */
-  row_stride = cinfo.output_width * cinfo.output_components;
-  /* Make a one-row-high sample array that will go away when done with image */
-  JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray)
-    ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
+  const size_t row_stride = cinfo.output_width * cinfo.output_components;
 
   /* ==== Step 6: while (scan lines remain to be read) */
   /*           jpeg_read_scanlines(...); */
 
-  /* Here we use the library's state variable cinfo.output_scanline as the
-   * loop counter, so that we don't have to keep track ourselves.
+  /* Scanlines are decoded directly into the image data, as many at once as
+   * the decoder produces (rec_outbuf_height).
    */
-  int bufp = 0;
+  JSAMPROW rows[4];
   while (cinfo.output_scanline < cinfo.output_height)
   {
-    /* jpeg_read_scanlines expects an array of pointers to scanlines.
-     * Here the array is only one element long, but you could ask for
-     * more than one scanline at a time if that's more convenient.
-     */
-    (void) jpeg_read_scanlines (&cinfo, buffer, 1);
-
-    if (isGrayScale)
-    {
-      // Safety.
-      if (bufp + row_stride > pixelcount) break;
-      /* paletted image */
-      memcpy (indexData + bufp, buffer [0], row_stride);
-    }
-    else
-    {
-      // Safety.
-      if (bufp + (int)cinfo.output_width > pixelcount) break;
-      /* rgb triplets */
-      uint8* out = rawData->GetUint8() + bufp*3;
-      memcpy (out, buffer[0], cinfo.output_width * 3);
-    }
-    bufp += cinfo.output_width;
+    JDIMENSION numRows = csMin (JDIMENSION (cinfo.rec_outbuf_height),
+      JDIMENSION (sizeof (rows) / sizeof (rows[0])));
+    numRows = csMin (numRows, cinfo.output_height - cinfo.output_scanline);
+    for (JDIMENSION r = 0; r < numRows; r++)
+      rows[r] = out + (cinfo.output_scanline + r) * row_stride;
+    if (jpeg_read_scanlines (&cinfo, rows, numRows) == 0) break;
   }
 
   /* Get palette */
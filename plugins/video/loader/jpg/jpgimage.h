@@ -99,6 +99,7 @@ private:
     { object_reg = p; };
     virtual ~JpegLoader();
     bool InitOk();
+    virtual int ReduceSize (int levels);
     virtual bool LoadData ();
   };
   friend class JpegLoader;
@@ -34,6 +34,56 @@
 CS_PLUGIN_NAMESPACE_BEGIN(ImgPlex)
 {
 
+/// Signatures at the start of image files and the plugins loading them.
+static const struct
+{
+  const char* magic;
+  size_t magicLen;
+  const char* classname;
+} fileSignatures[] =
+{
+  {"\x89PNG\r\n\x1a\n", 8, "crystalspace.graphic.image.io.png"},
+  {"\xff\xd8\xff", 3, "crystalspace.graphic.image.io.jpg"},
+  {"DDS ", 4, "crystalspace.graphic.image.io.dds"},
+  {"\x8bJNG\r\n\x1a\n", 8, "crystalspace.graphic.image.io.jng"},
+  {"\x8aMNG\r\n\x1a\n", 8, "crystalspace.graphic.image.io.jng"},
+  {"GIF8", 4, "crystalspace.graphic.image.io.gif"},
+  {"BM", 2, "crystalspace.graphic.image.io.bmp"}
+};
+
+const char* csImageIOMultiplexer::IdentifyFormat (iDataBuffer* buf)
+{
+  const size_t size = buf->GetSize ();
+  const uint8* data = buf->GetUint8 ();
+  for (size_t i = 0; i < sizeof (fileSignatures) / sizeof (fileSignatures[0]);
+       i++)
+  {
+    if ((size >= fileSignatures[i].magicLen)
+        && (memcmp (data, fileSignatures[i].magic,
+          fileSignatures[i].magicLen) == 0))
+      return fileSignatures[i].classname;
+  }
+  return 0;
+}
+
+iImageIO* csImageIOMultiplexer::GetPlugin (const char* classname)
+{
+  csRef<iImageIO>* plugin = pluginsByClass.GetElementPointer (classname);
+  if (plugin) return *plugin;
+  if (!classlist) return 0;
+
+  // Not loaded yet: load it now and take it off the list of plugins to load
+  size_t index = classlist->Find (classname);
+  if (index == csArrayItemNotFound) return 0;
+  classlist->DeleteIndex (index);
+  csRef<iImageIO> newPlugin = csLoadPlugin<iImageIO> (plugin_mgr, classname);
+  if (!newPlugin) return 0;
+  list.Push (newPlugin);
+  StoreDesc (newPlugin->GetDescription ());
+  pluginsByClass.Put (classname, newPlugin);
+  return newPlugin;
+}
+
 SCF_IMPLEMENT_FACTORY(csImageIOMultiplexer)
 
 csImageIOMultiplexer::csImageIOMultiplexer (iBase *pParent) :
@@ -96,6 +146,7 @@ bool csImageIOMultiplexer::LoadNextPlugin ()
     {
       // remember the plugin
       list.Push (plugin);
+      pluginsByClass.Put (classname, plugin);
       // and load its description, since we gonna return it on request
       StoreDesc (plugin->GetDescription ());
     }
@@ -113,6 +164,24 @@ const csImageIOFileFormatDescriptions& csImageIOMultiplexer::GetDescription ()
 
 csPtr<iImage> csImageIOMultiplexer::Load (iDataBuffer* buf, int iFormat)
 {
+  /* Most files can be identified by their first bytes; hand those directly
+     to the right plugin, without holding the lock while it loads. */
+  const char* classname = IdentifyFormat (buf);
+  if (classname)
+  {
+    csRef<iImageIO> pIO;
+    {
+      CS::Threading::MutexScopedLock slock(lock);
+      pIO = GetPlugin (classname);
+    }
+    if (pIO)
+    {
+      csRef<iImage> img (pIO->Load(buf, iFormat));
+      if (img) return csPtr<iImage> (img);
+    }
+  }
+
+  // Unknown signature (or the plugin failed): ask the plugins in turn
   CS::Threading::MutexScopedLock slock(lock);
   bool consecutive = false; // set to true if we searched the list completely.
   do
@@ -25,6 +25,7 @@
 #include "iutil/databuff.h"
 #include "iutil/plugin.h"
 #include "csutil/cfgacc.h"
+#include "csutil/hash.h"
 #include "csutil/refarr.h"
 #include "csutil/scf_implementation.h"
 #include "csutil/weakref.h"
@@ -43,6 +44,8 @@ class csImageIOMultiplexer :
 {
  protected:
   csRefArray<iImageIO> list;
+  /// Loaded plugins by class name
+  csHash<csRef<iImageIO>, csString> pluginsByClass;
   csImageIOFileFormatDescriptions formats;
   csConfigAccess config;
   csRef<iStringArray> classlist;
@@ -55,6 +58,10 @@ class csImageIOMultiplexer :
    * returns true if more plugins are in the list
    */
   bool LoadNextPlugin ();
+  /// Determine the plugin class for a file from its signature
+  static const char* IdentifyFormat (iDataBuffer* buf);
+  /// Get a plugin by class name, loading it if necessary
+  iImageIO* GetPlugin (const char* classname);
 
  public:
   csImageIOMultiplexer (iBase *pParent);
@@ -20,6 +20,10 @@
 
 #include "cssysdef.h"
 
+#include "csgfx/imagemanipulate.h"
+#include "csutil/platform.h"
+#include "csutil/threadjobqueue.h"
+#include "igraphic/deferredimage.h"
 #include "igraphic/imageio.h"
 #include "iutil/vfs.h"
 
@@ -35,7 +39,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(gl3d)
 CS_LEAKGUARD_IMPLEMENT(csGLTextureManager);
 
 static const csGLTextureClassSettings defaultSettings = 
-  {GL_RGB, GL_RGBA, false, false, true, true, false};
+  {GL_RGB, GL_RGBA, false, false, true, true, false,
+   csImageManipulate::mipFilterBox};
 
 csGLTextureManager::csGLTextureManager (iObjectRegistry* object_reg,
         iGraphics2D* iG2D, iConfigFile *config,
@@ -106,6 +111,8 @@ csGLTextureManager::csGLTextureManager (iObjectRegistry* object_reg,
 csGLTextureManager::~csGLTextureManager()
 {
   Clear ();
+  if (mipmapQueue && (csImageManipulate::GetJobQueue () == mipmapQueue))
+    csImageManipulate::SetJobQueue (0);
 }
   
 void csGLTextureManager::NextFrame (uint frameNum)
@@ -129,6 +136,8 @@ void csGLTextureManager::read_config (iConfigFile *config)
     ("Video.OpenGL.SharpenMipmaps", 0);
   texture_downsample = config->GetInt
     ("Video.OpenGL.TextureDownsample", 0);
+  downsample_on_decode = config->GetBool
+    ("Video.OpenGL.TextureDownsampleOnDecode", false);
   texture_filter_anisotropy = csMax(1.0f, config->GetFloat
     ("Video.OpenGL.TextureFilterAnisotropy", 1.0));
   tweaks.disableRECTTextureCompression = config->GetBool
@@ -139,6 +148,15 @@ void csGLTextureManager::read_config (iConfigFile *config)
     ("Video.OpenGL.DisableGenerateMipmap", false);
   tweaks.generateMipMapsExcessOne = config->GetBool
     ("Video.OpenGL.GenerateOneExcessMipMap", false);
+
+  int mipmapThreads = config->GetInt ("Video.OpenGL.MipmapThreads",
+    CS::Platform::GetProcessorCount ());
+  if ((mipmapThreads > 1) && !csImageManipulate::GetJobQueue ())
+  {
+    mipmapQueue.AttachNew (new ThreadedJobQueue (mipmapThreads,
+      THREAD_PRIO_NORMAL, "mipmap"));
+    csImageManipulate::SetJobQueue (mipmapQueue);
+  }
   
   const char* filterModeStr = config->GetStr (
     "Video.OpenGL.TextureFilter", "trilinear");
@@ -261,6 +279,31 @@ void csGLTextureManager::ReadTextureClasses (iConfigFile* config)
       {
 	settings->renormalizeGeneratedMips = it->GetBool ();
       } 
+      else if (strcasecmp (optionName, "MipmapFilter") == 0)
+      {
+	const char* filter = it->GetStr ();
+	settings->mipmapFlags &= ~csImageManipulate::mipFilterMask;
+	if (strcasecmp (filter, "kaiser") == 0)
+	  settings->mipmapFlags |= csImageManipulate::mipFilterKaiser;
+	else if (strcasecmp (filter, "box") != 0)
+	  G3D->Report (CS_REPORTER_SEVERITY_WARNING,
+	    "Unknown mipmap filter %s for %s", CS::Quote::Single (filter),
+	    CS::Quote::Single (extractedClass.GetData()));
+      } 
+      else if (strcasecmp (optionName, "GammaCorrectMips") == 0)
+      {
+	if (it->GetBool ())
+	  settings->mipmapFlags |= csImageManipulate::mipGammaCorrect;
+	else
+	  settings->mipmapFlags &= ~csImageManipulate::mipGammaCorrect;
+      } 
+      else if (strcasecmp (optionName, "PremultipliedAlphaMips") == 0)
+      {
+	if (it->GetBool ())
+	  settings->mipmapFlags |= csImageManipulate::mipPremultipliedAlpha;
+	else
+	  settings->mipmapFlags &= ~csImageManipulate::mipPremultipliedAlpha;
+      } 
       else
       {
 	G3D->Report (CS_REPORTER_SEVERITY_ERROR,
@@ -353,7 +396,23 @@ csPtr<iTextureHandle> csGLTextureManager::RegisterTexture (iImage *image,
   if (!ImageTypeSupported (image->GetImageType(), fail_reason))
     return 0;
 
-  csGLTextureHandle *txt = new csGLTextureHandle (image, flags, G3D);
+  int decodeReduced = 0;
+  csRef<iDeferredImage> deferred (scfQueryInterface<iDeferredImage> (image));
+  if (deferred.IsValid())
+  {
+    if (flags & CS_TEXTURE_2D)
+      // 2D textures are usually needed soon for drawing
+      deferred->SetDecodePriority (1);
+    else if (downsample_on_decode && (texture_downsample > 0)
+        && !(flags & CS_TEXTURE_NOMIPMAPS)
+        && (image->GetImageType() == csimg2D))
+      /* The top mipmaps would be dropped anyway, so if the image hasn't
+       * been decoded yet, let the loader skip them. */
+      decodeReduced = deferred->ReduceDecodeSize (texture_downsample);
+  }
+
+  csGLTextureHandle *txt = new csGLTextureHandle (image, flags, G3D,
+    decodeReduced);
 
   MutexScopedLock lock(texturesLock);
   CompactTextures ();
@@ -27,6 +27,7 @@
 #include "csutil/weakrefarr.h"
 
 #include "iutil/cfgfile.h"
+#include "iutil/job.h"
 #include "ivideo/txtmgr.h"
 
 #include "gl_txtmgr_basictex.h"
@@ -50,6 +51,8 @@ struct csGLTextureClassSettings
   bool allowDownsample;
   bool allowMipSharpen;
   bool renormalizeGeneratedMips;
+  /// Flags for csImageManipulate::Mipmap() when generating mipmaps
+  uint mipmapFlags;
 };
 
 /*
@@ -92,6 +95,9 @@ private:
   bool FormatSupported (GLenum srcFormat, GLenum srcType);
 
   void CompactTextures ();
+
+  /// Queue used to generate mipmaps in parallel
+  csRef<iJobQueue> mipmapQueue;
   
   bool ImageTypeSupported (csImageType imagetype, iString* fail_reason);
 public:
@@ -129,6 +135,8 @@ public:
   int sharpen_mipmaps;
   /// downsample textures?
   int texture_downsample;
+  /// Decode images at the downsampled size, if the loader supports it
+  bool downsample_on_decode;
   /// texture filtering anisotropy
   float texture_filter_anisotropy;
   /// Whether bilinear filtering should be used (0 = no, 1 = yes, 2 = trilinear)
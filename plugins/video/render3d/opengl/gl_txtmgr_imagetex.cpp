@@ -34,10 +34,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(gl3d)
 {
 
 csGLTextureHandle::csGLTextureHandle (iImage* image, int flags, 
-				      csGLGraphics3D *iG3D) : 
+				      csGLGraphics3D *iG3D,
+				      int decodeReduced) : 
   csGLBasicTextureHandle (image->GetWidth(), image->GetHeight(),
     image->GetDepth(), image->GetImageType (), flags, iG3D),
-  origName(0), transp_color (0, 0, 0)
+  origName(0), transp_color (0, 0, 0), decodeReduced (decodeReduced)
 {
 //printf ("image='%s' format='%08x' rawformat='%s' type=%d\n",
     //image->GetName (), image->GetFormat (), image->GetRawFormat (),
@@ -152,7 +153,8 @@ void csGLTextureHandle::CreateMipMaps()
   // Determine if and how many mipmaps we skip.
   const bool doReduce = !texFlags.Check (CS_TEXTURE_2D | CS_TEXTURE_NOMIPMAPS)
     && textureSettings->allowDownsample;
-  int mipskip = doReduce ? txtmgr->texture_downsample : 0;
+  int mipskip = doReduce
+    ? csMax (txtmgr->texture_downsample - decodeReduced, 0) : 0;
   while (((actual_width >> mipskip) > txtmgr->max_tex_size)
       || ((actual_height >> mipskip) > txtmgr->max_tex_size)
       || ((actual_d >> mipskip) > txtmgr->max_tex_size))
@@ -213,7 +215,8 @@ void csGLTextureHandle::CreateMipMaps()
 	}
 	else
 	{
-	  cimg = csImageManipulate::Mipmap (thisImage, 1, tc);
+	  cimg = csImageManipulate::Mipmap (thisImage, 1, tc,
+	    textureSettings->mipmapFlags);
 	}
 	origMip = cimg;
 	if (mipskip == 0) // don't postprocess when doing skip...
@@ -39,6 +39,8 @@ private:
 
   /// The transparent color
   csRGBpixel transp_color;
+  /// Number of mipmaps already skipped when decoding the image
+  int decodeReduced;
 
   /// Prepare a single image (rescale to po2 and make transparency).
   csRef<iImage> PrepareIntImage (int actual_width, int actual_height,
@@ -52,7 +54,8 @@ private:
   void CheckAlpha (int w, int h, int d, csRGBpixel *src, 
     const csRGBpixel* transp_color, csAlphaMode::AlphaType& alphaType);
 public:
-  csGLTextureHandle (iImage* image, int flags, csGLGraphics3D *iG3D);
+  csGLTextureHandle (iImage* image, int flags, csGLGraphics3D *iG3D,
+    int decodeReduced = 0);
 
   virtual ~csGLTextureHandle ();
 
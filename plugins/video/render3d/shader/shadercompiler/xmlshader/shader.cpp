@@ -23,6 +23,7 @@
 #include "imap/services.h"
 #include "iutil/hiercache.h"
 #include "iutil/vfs.h"
+#include "ivaria/profile.h"
 #include "ivaria/reporter.h"
 #include "ivideo/rendermesh.h"
 
@@ -46,6 +47,8 @@
 
 CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
 {
+  CS_DECLARE_PROFILER
+  CS_DECLARE_PROFILER_ZONE(csXMLShader_GetTicket);
 
   CS_LEAKGUARD_IMPLEMENT (csXMLShader);
 
@@ -1540,6 +1543,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(XMLShader)
   size_t csXMLShader::GetTicket (const csRenderMeshModes& modes, 
     const csShaderVariableStack& stack)
   {
+    CS_PROFILER_ZONE(csXMLShader_GetTicket);
+
     csRef<csConditionEvaluator::TicketEvaluator> eval (
       sharedEvaluator->BeginTicketEvaluationCaching (modes, &stack));
 